@@ -0,0 +1,64 @@
+#include "optix_util_bench.h"
+
+#include <optix_util_aabb_gen.h>
+
+#include <cmath>
+#include <cstdio>
+#include <vector>
+
+// AABB generation for procedural spheres, 100M by default or the number of primitives given as argument. Compares
+// #optixUtilGenerateAabbs() with a plain loop that writes the boxes and then validates them in a second pass.
+
+/// Spheres on a 1024 x 1024 grid of columns with radii between 0.1 and 0.4.
+struct SphereBounds
+{
+    void operator()( unsigned int primitive, unsigned int /*key*/, OptixAabb& box ) const
+    {
+        const float x = (float)( primitive & 1023 ), y = (float)( ( primitive >> 10 ) & 1023 );
+        const float z = (float)( primitive >> 20 );
+        const float r = 0.1f + 0.3f * (float)( ( primitive * 2654435761u ) >> 24 ) / 255.f;
+        box           = {x - r, y - r, z - r, x + r, y + r, z + r};
+    }
+};
+
+int main( int argc, char** argv )
+{
+    const unsigned int     n = (unsigned int)optix_util_bench::problemSize( argc, argv, 100000000 );
+    std::vector<OptixAabb> boxes( n );
+    void*                  buffers[1] = {boxes.data()};
+
+    // Reference: write, then validate and accumulate the bounds in a second pass over the buffer.
+    size_t       invalid     = 0;
+    const double referenceMs = optix_util_bench::milliseconds( [&] {
+        const SphereBounds bounds;
+        for( unsigned int i = 0; i < n; ++i )
+            bounds( i, 0, boxes[i] );
+        OptixAabb total = optix_util_impl::emptyAabb();
+        invalid         = 0;
+        for( unsigned int i = 0; i < n; ++i )
+        {
+            const OptixAabb& b = boxes[i];
+            if( !( b.minX <= b.maxX && b.minY <= b.maxY && b.minZ <= b.maxZ ) )
+                ++invalid;
+            else
+                optix_util_impl::growAabb( total, b );
+        }
+    } );
+
+    OptixUtilAabbGenOptions options = {0, false};
+    OptixUtilAabbGenReport  report;
+    OptixResult             result  = OPTIX_SUCCESS;
+    auto                    serial  = [&] {
+        result = optixUtilGenerateAabbs( n, 1, SphereBounds(), options, buffers, &report, 1 );
+    };
+    auto parallel = [&] { result = optixUtilGenerateAabbs( n, 1, SphereBounds(), options, buffers, &report ); };
+    const double serialMs   = optix_util_bench::milliseconds( serial );
+    const double parallelMs = optix_util_bench::milliseconds( parallel );
+
+    std::printf( "aabb generation: %u spheres, %.1f MiB, %u threads\n", n, n * sizeof( OptixAabb ) / 1048576.0,
+                 optixUtilGetDefaultThreadCount() );
+    std::printf( "  write + validate pass %10.2f ms %8.1f M/s\n", referenceMs, n / referenceMs / 1000.0 );
+    std::printf( "  generator, 1 thread   %10.2f ms %8.1f M/s\n", serialMs, n / serialMs / 1000.0 );
+    std::printf( "  generator, default    %10.2f ms %8.1f M/s\n", parallelMs, n / parallelMs / 1000.0 );
+    return result == OPTIX_SUCCESS && report.numInvertedBoxes == 0 && invalid == 0 ? 0 : 1;
+}
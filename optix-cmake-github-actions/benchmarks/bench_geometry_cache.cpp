@@ -0,0 +1,145 @@
+#include "optix_util_bench.h"
+
+#include <optix_util_geometry_cache.h>
+
+#include <cmath>
+#include <cstdio>
+#include <cstdlib>
+#include <string>
+#include <vector>
+
+// Load time of a triangle mesh with 2 motion keys: parsing a text file into build input arrays, against opening and
+// verifying a geometry cache file of the same mesh. The argument is the number of triangles, 4M by default.
+
+static const char* textPath  = "bench_geometry_cache.txt";
+static const char* cachePath = "bench_geometry_cache.bin";
+
+struct Mesh
+{
+    std::vector<float>        vertices[2];
+    std::vector<unsigned int> indices;
+};
+
+/// Text path: "v x y z" lines of both keys, then "f a b c" lines, as an OBJ-like exporter writes them.
+static bool parseText( const char* path, size_t numVertices, Mesh& mesh )
+{
+    FILE* file = std::fopen( path, "rb" );
+    if( !file )
+        return false;
+    std::fseek( file, 0, SEEK_END );
+    std::string text( (size_t)std::ftell( file ), '\0' );
+    std::fseek( file, 0, SEEK_SET );
+    const bool read = std::fread( &text[0], 1, text.size(), file ) == text.size();
+    std::fclose( file );
+    if( !read )
+        return false;
+
+    mesh.vertices[0].clear();
+    mesh.vertices[1].clear();
+    mesh.indices.clear();
+    const char* p = text.c_str();
+    while( *p )
+    {
+        char* end = nullptr;
+        if( p[0] == 'v' )
+        {
+            std::vector<float>& key = mesh.vertices[mesh.vertices[0].size() < 3 * numVertices ? 0 : 1];
+            for( int k = 0; k < 3; ++k, p = end )
+                key.push_back( std::strtof( p + 1, &end ) );
+        }
+        else if( p[0] == 'f' )
+        {
+            for( int k = 0; k < 3; ++k, p = end )
+                mesh.indices.push_back( (unsigned int)std::strtoul( p + 1, &end, 10 ) );
+        }
+        while( *p && *p++ != '\n' )
+        {
+        }
+    }
+    return true;
+}
+
+int main( int argc, char** argv )
+{
+    const size_t numTriangles = optix_util_bench::problemSize( argc, argv, 4u << 20 );
+    const size_t side         = (size_t)std::sqrt( (double)numTriangles / 2.0 ) + 1;
+    const size_t numVertices  = side * side;
+
+    // Grid mesh with a second key moved along z.
+    Mesh mesh;
+    for( int key = 0; key < 2; ++key )
+        for( size_t v = 0; v < numVertices; ++v )
+        {
+            mesh.vertices[key].push_back( (float)( v % side ) * 0.01f );
+            mesh.vertices[key].push_back( (float)( v / side ) * 0.01f );
+            mesh.vertices[key].push_back( (float)key * 0.1f + (float)( v % 7 ) * 0.001f );
+        }
+    for( size_t t = 0; t < numTriangles; ++t )
+    {
+        const size_t quad    = t / 2 % ( ( side - 1 ) * ( side - 1 ) );
+        const size_t v       = quad / ( side - 1 ) * side + quad % ( side - 1 );
+        const size_t c[2][3] = {{v, v + 1, v + side + 1}, {v, v + side + 1, v + side}};
+        for( int k = 0; k < 3; ++k )
+            mesh.indices.push_back( (unsigned int)c[t % 2][k] );
+    }
+
+    FILE* text = std::fopen( textPath, "wb" );
+    if( !text )
+        return 1;
+    for( int key = 0; key < 2; ++key )
+        for( size_t v = 0; v < numVertices; ++v )
+            std::fprintf( text, "v %.6f %.6f %.6f\n", mesh.vertices[key][3 * v], mesh.vertices[key][3 * v + 1],
+                          mesh.vertices[key][3 * v + 2] );
+    for( size_t t = 0; t < numTriangles; ++t )
+        std::fprintf( text, "f %u %u %u\n", mesh.indices[3 * t], mesh.indices[3 * t + 1], mesh.indices[3 * t + 2] );
+    std::fclose( text );
+
+    const void*             keys[2]  = {mesh.vertices[0].data(), mesh.vertices[1].data()};
+    const unsigned int      flags[1] = {OPTIX_GEOMETRY_FLAG_NONE};
+    OptixUtilCachedGeometry geometry = {};
+    geometry.type                    = OPTIX_BUILD_INPUT_TYPE_TRIANGLES;
+    geometry.numPrimitives           = (uint32_t)numTriangles;
+    geometry.numVertices             = (uint32_t)numVertices;
+    geometry.numMotionKeys           = 2;
+    geometry.vertexFormat            = OPTIX_VERTEX_FORMAT_FLOAT3;
+    geometry.indexFormat             = OPTIX_INDICES_FORMAT_UNSIGNED_INT3;
+    geometry.numSbtRecords           = 1;
+    OptixUtilCacheSource         source = {keys, mesh.indices.data(), nullptr, nullptr, nullptr, flags};
+    OptixUtilGeometryCacheWriter writer;
+    writer.addGeometry( geometry, source );
+    OptixResult  result  = OPTIX_SUCCESS;
+    const double writeMs = optix_util_bench::milliseconds( [&] { result = writer.write( cachePath ); } );
+    if( result != OPTIX_SUCCESS )
+        return 1;
+
+    // The parsed arrays must match the source, and the cache must open and verify.
+    Mesh         parsed;
+    bool         valid   = false;
+    auto         parse   = [&] { valid = parseText( textPath, numVertices, parsed ); };
+    const double parseMs = optix_util_bench::milliseconds( parse );
+    valid = valid && parsed.indices == mesh.indices && parsed.vertices[1].size() == mesh.vertices[1].size();
+
+    OptixUtilGeometryCache cache;
+    auto                   open = [&] {
+        cache.close();
+        result = cache.open( cachePath );
+    };
+    auto verify = [&] {
+        if( result == OPTIX_SUCCESS )
+            result = optixUtilVerifyGeometryCache( cache );
+    };
+    const double openMs   = optix_util_bench::milliseconds( open, 5 );
+    const double verifyMs = optix_util_bench::milliseconds( verify, 5 );
+    valid                 = valid && result == OPTIX_SUCCESS;
+
+    std::printf( "geometry cache: %zu triangles, %zu vertices, 2 motion keys, %.1f MiB data\n", numTriangles,
+                 numVertices, cache.dataRegionSize() / 1048576.0 );
+    std::printf( "  parse text       %10.2f ms\n", parseMs );
+    std::printf( "  write cache      %10.2f ms\n", writeMs );
+    std::printf( "  open cache       %10.2f ms\n", openMs );
+    std::printf( "  verify checksums %10.2f ms\n", verifyMs );
+    cache.close();
+    std::remove( textPath );
+    std::remove( cachePath );
+    return valid ? 0 : 1;
+}
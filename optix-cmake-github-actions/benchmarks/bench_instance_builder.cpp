@@ -0,0 +1,86 @@
+#include "optix_util_bench.h"
+
+#include <optix_util_instance_builder.h>
+
+#include <cstdio>
+#include <cstring>
+#include <random>
+#include <vector>
+
+// Instance packing from structure of arrays, 10M instances by default or the number given as argument. Compares a
+// naive loop that fills one #OptixInstance at a time with #optixUtilPackInstances() on one thread with regular and
+// non-temporal stores, and with the default thread count.
+
+int main( int argc, char** argv )
+{
+    const size_t n = optix_util_bench::problemSize( argc, argv, 10000000 );
+
+    // Random transforms, handles and SBT offsets; instance IDs and visibility masks keep their defaults.
+    OptixUtilInstanceStaging staging;
+    staging.resize( n );
+    std::mt19937                          rng( 1 );
+    std::uniform_real_distribution<float> uniform( -100.f, 100.f );
+    for( int k = 0; k < 12; ++k )
+    {
+        float* element = staging.transformElement( k );
+        for( size_t i = 0; i < n; ++i )
+            element[i] = uniform( rng );
+    }
+    for( size_t i = 0; i < n; ++i )
+    {
+        staging.traversableHandle()[i] = 0x10000 + 128 * ( i % 64 );
+        staging.sbtOffset()[i]         = (unsigned int)( i % 64 );
+    }
+    const OptixUtilInstanceSoA soa = staging.soa();
+
+    // Reference: fill each record member by member and copy it into the array.
+    std::vector<OptixInstance> naive( n );
+    const double               naiveMs = optix_util_bench::milliseconds(
+        [&] {
+            for( size_t i = 0; i < n; ++i )
+            {
+                OptixInstance instance = {};
+                for( int k = 0; k < 12; ++k )
+                    instance.transform[k] = soa.transform[k][i];
+                instance.instanceId        = soa.instanceId[i];
+                instance.sbtOffset         = soa.sbtOffset[i];
+                instance.visibilityMask    = soa.visibilityMask[i];
+                instance.flags             = soa.flags[i];
+                instance.traversableHandle = soa.traversableHandle[i];
+                naive[i]                   = instance;
+            }
+        },
+        3 );
+
+    // Best of 3 runs; every variant must write the reference records.
+    OptixUtilInstanceBuffer buffer;
+    buffer.resize( n );
+    OptixUtilInstanceSpan span  = buffer.span();
+    bool                  valid = true;
+    auto                  check = [&] {
+        valid = valid && std::memcmp( span.data, naive.data(), n * sizeof( OptixInstance ) ) == 0;
+    };
+    auto pack = [&]( bool streaming, unsigned int threads ) {
+        const double ms = optix_util_bench::milliseconds(
+            [&] {
+                const OptixResult result = optixUtilPackInstances( soa, 0, n, span.data, streaming, threads );
+                valid                    = valid && result == OPTIX_SUCCESS;
+            },
+            3 );
+        check();
+        return ms;
+    };
+    const double cachedMs    = pack( false, 1 );
+    const double streamingMs = pack( true, 1 );
+    const double parallelMs  = optix_util_bench::milliseconds(
+        [&] { valid = optixUtilPackInstances( staging, buffer, &span ) == OPTIX_SUCCESS && valid; }, 3 );
+    check();
+
+    std::printf( "instance packing: %zu instances, %.1f MiB, %u threads\n", n, n * sizeof( OptixInstance ) / 1048576.0,
+                 optixUtilGetDefaultThreadCount() );
+    std::printf( "  naive per-instance loop   %10.2f ms %8.1f M/s\n", naiveMs, n / naiveMs / 1000.0 );
+    std::printf( "  packer, 1 thread          %10.2f ms %8.1f M/s\n", cachedMs, n / cachedMs / 1000.0 );
+    std::printf( "  packer, 1 thread, stream  %10.2f ms %8.1f M/s\n", streamingMs, n / streamingMs / 1000.0 );
+    std::printf( "  packer, default           %10.2f ms %8.1f M/s\n", parallelMs, n / parallelMs / 1000.0 );
+    return valid ? 0 : 1;
+}
@@ -0,0 +1,73 @@
+#include "optix_util_bench.h"
+
+#include <optix_util_instance_sort.h>
+
+#include <cmath>
+#include <cstdio>
+#include <cstring>
+#include <random>
+#include <vector>
+
+// Spatial sorting of instance arrays, for 1%, 10% and 100% of 4M instances by default or of the number given as
+// argument. Compares the Morton and Hilbert curves with the scalar and AVX2 key kernels on one thread, and the
+// default thread count. The instances are randomly rotated and scattered in a box, so nearly every one moves.
+
+int main( int argc, char** argv )
+{
+    const size_t n = optix_util_bench::problemSize( argc, argv, 4000000 );
+
+    std::vector<OptixInstance>            instances( n ), sorted( n );
+    std::vector<OptixAabb>                childBounds( n );
+    std::vector<unsigned int>             permutation( n );
+    std::mt19937                          rng( 1 );
+    std::uniform_real_distribution<float> position( -1000.f, 1000.f );
+    std::uniform_real_distribution<float> unit( -1.f, 1.f );
+    for( size_t i = 0; i < n; ++i )
+    {
+        OptixInstance& instance = instances[i];
+        std::memset( &instance, 0, sizeof( instance ) );
+        const float c = unit( rng ), s = std::sqrt( 1.f - c * c );
+        const float m[12] = {c, -s, 0.f, position( rng ), s, c, 0.f, position( rng ), 0.f, 0.f, 1.f, position( rng )};
+        std::memcpy( instance.transform, m, sizeof( m ) );
+        instance.instanceId = (unsigned int)i;
+        const float r       = 1.f + unit( rng );
+        childBounds[i]      = {-r, -r, 0.f, r, r, 2.f * r};
+    }
+
+    std::printf( "instance sorting: up to %zu instances, %u threads\n", n, optixUtilGetDefaultThreadCount() );
+    OptixUtilSortScratch scratch;
+    bool                 valid     = true;
+    const size_t         counts[3] = {n / 100, n / 10, n};
+    for( size_t count : counts )
+    {
+        const OptixUtilSpatialCurve curves[2] = {OPTIX_UTIL_SPATIAL_CURVE_MORTON, OPTIX_UTIL_SPATIAL_CURVE_HILBERT};
+        for( OptixUtilSpatialCurve curve : curves )
+        {
+            // Best of 3 runs, reusing the scratch memory as a renderer does every frame.
+            auto sort = [&]( unsigned int threads, OptixUtilSimdIsa isa ) {
+                return optix_util_bench::milliseconds(
+                    [&] {
+                        const OptixResult result =
+                            optixUtilSortInstances( instances.data(), count, childBounds.data(), curve, sorted.data(),
+                                                    permutation.data(), &scratch, threads, isa );
+                        valid = valid && result == OPTIX_SUCCESS;
+                    },
+                    3 );
+            };
+            const double scalarMs   = sort( 1, OPTIX_UTIL_SIMD_ISA_SCALAR );
+            const double avx2Ms     = sort( 1, OPTIX_UTIL_SIMD_ISA_AVX2 );
+            const double parallelMs = sort( 0, OPTIX_UTIL_SIMD_ISA_AUTO );
+            for( size_t i = 0; i < count; ++i )
+                valid = valid && sorted[i].instanceId == permutation[i];
+
+            const char* name = curve == OPTIX_UTIL_SPATIAL_CURVE_MORTON ? "Morton " : "Hilbert";
+            std::printf( "  %9zu %s, scalar, 1 thread %10.2f ms %8.1f M/s\n", count, name, scalarMs,
+                         count / scalarMs / 1000.0 );
+            std::printf( "  %9zu %s, AVX2, 1 thread   %10.2f ms %8.1f M/s\n", count, name, avx2Ms,
+                         count / avx2Ms / 1000.0 );
+            std::printf( "  %9zu %s, default          %10.2f ms %8.1f M/s\n", count, name, parallelMs,
+                         count / parallelMs / 1000.0 );
+        }
+    }
+    return valid ? 0 : 1;
+}
@@ -0,0 +1,79 @@
+#include "optix_util_bench.h"
+
+#include <optix_util_invert_batch.h>
+
+#include <cmath>
+#include <cstdio>
+#include <random>
+#include <vector>
+
+// Batched 3x4 matrix inversion, 10M matrices by default or the number given as argument. Compares
+// #optixUtilInvertMatrix() on each matrix of an array with #optixUtilInvertMatrixBatch() using the scalar, AVX2 and
+// AVX-512 kernels on one thread, and the default thread count. Hosts without AVX-512 run the AVX2 kernel instead.
+
+int main( int argc, char** argv )
+{
+    const size_t n = optix_util_bench::problemSize( argc, argv, 10000000 );
+
+    // Rotations about z with scales between 0.5 and 2 and random translations. One in 1000 is singular.
+    std::vector<float>                    aos( 12 * n ), storage[12], inverseStorage[12];
+    std::mt19937                          rng( 1 );
+    std::uniform_real_distribution<float> uniform( -1.f, 1.f );
+    for( size_t i = 0; i < n; ++i )
+    {
+        const float s = 1.25f + 0.75f * uniform( rng ), angle = 3.f * uniform( rng );
+        const float c = s * std::cos( angle ), d = s * std::sin( angle );
+        const float m[12] = {c, -d, 0.f, uniform( rng ), d, c, 0.f, uniform( rng ), 0.f, 0.f, i % 1000 ? s : 0.f, 1.f};
+        for( int k = 0; k < 12; ++k )
+            aos[12 * i + k] = m[k];
+    }
+    OptixUtilMatrixSoA matrices, inverses;
+    for( int k = 0; k < 12; ++k )
+    {
+        storage[k].resize( n );
+        inverseStorage[k].resize( n );
+        for( size_t i = 0; i < n; ++i )
+            storage[k][i] = aos[12 * i + k];
+        matrices.element[k] = storage[k].data();
+        inverses.element[k] = inverseStorage[k].data();
+    }
+
+    // Reference: unchecked in-place inversion of a copy of the array, which gives inf or NaN for the singular matrices.
+    std::vector<float> reference( aos.size() );
+    const double       referenceMs = optix_util_bench::milliseconds(
+        [&] {
+            reference = aos;
+            for( size_t i = 0; i < n; ++i )
+                optixUtilInvertMatrix( &reference[12 * i] );
+        },
+        3 );
+
+    // Best of 3 runs; every run must find the singular matrices.
+    size_t numSingular = 0;
+    bool   consistent  = true;
+    auto   invert      = [&]( unsigned int threads, OptixUtilSimdIsa isa ) {
+        return optix_util_bench::milliseconds(
+            [&] {
+                const OptixResult result = optixUtilInvertMatrixBatch( matrices, inverses, n, nullptr, &numSingular,
+                                                                       OPTIX_UTIL_DEFAULT_SINGULAR_THRESHOLD, threads,
+                                                                       isa );
+                consistent = consistent && result == OPTIX_SUCCESS && numSingular == ( n + 999 ) / 1000;
+            },
+            3 );
+    };
+    const double scalarMs   = invert( 1, OPTIX_UTIL_SIMD_ISA_SCALAR );
+    const double avx2Ms     = invert( 1, OPTIX_UTIL_SIMD_ISA_AVX2 );
+    const double avx512Ms   = invert( 1, OPTIX_UTIL_SIMD_ISA_AVX512 );
+    const double parallelMs = invert( 0, OPTIX_UTIL_SIMD_ISA_AUTO );
+
+    std::printf( "matrix inversion: %zu matrices, %zu singular, %u threads, %s\n", n, numSingular,
+                 optixUtilGetDefaultThreadCount(),
+                 optixUtilSelectSimdIsa( OPTIX_UTIL_SIMD_ISA_AVX512 ) == OPTIX_UTIL_SIMD_ISA_AVX512 ? "AVX-512"
+                                                                                                     : "no AVX-512" );
+    std::printf( "  unchecked AoS loop    %10.2f ms %8.1f M/s\n", referenceMs, n / referenceMs / 1000.0 );
+    std::printf( "  scalar, 1 thread      %10.2f ms %8.1f M/s\n", scalarMs, n / scalarMs / 1000.0 );
+    std::printf( "  AVX2, 1 thread        %10.2f ms %8.1f M/s\n", avx2Ms, n / avx2Ms / 1000.0 );
+    std::printf( "  AVX-512, 1 thread     %10.2f ms %8.1f M/s\n", avx512Ms, n / avx512Ms / 1000.0 );
+    std::printf( "  default               %10.2f ms %8.1f M/s\n", parallelMs, n / parallelMs / 1000.0 );
+    return consistent ? 0 : 1;
+}
@@ -0,0 +1,163 @@
+#include "optix_util_bench.h"
+
+#include <optix_util_mesh_partition.h>
+
+#include <cmath>
+#include <cstdio>
+#include <cstring>
+#include <vector>
+
+// Partitioning of a height field mesh, 100M triangles by default or the number given as argument, with the CPU stub
+// backend. Partitions with the static and the dynamic policy, builds the dynamic partitions and an IAS over them, and
+// refits after a band of 1% of the vertices moved, against the whole mesh for a single GAS.
+
+/// Stub of optixAccelBuild() that writes only the header of the AccelImage of optix_util_test::accelBuild(), so the
+/// outputs of 100M triangles stay untouched host memory. Updates do not write and go to the test stub.
+static OptixResult headerOnlyBuild( OptixDeviceContext            context,
+                                    CUstream                      stream,
+                                    const OptixAccelBuildOptions* accelOptions,
+                                    const OptixBuildInput*        buildInputs,
+                                    unsigned int                  numBuildInputs,
+                                    CUdeviceptr                   tempBuffer,
+                                    size_t                        tempBufferSizeInBytes,
+                                    CUdeviceptr                   outputBuffer,
+                                    size_t                        outputBufferSizeInBytes,
+                                    OptixTraversableHandle*       outputHandle,
+                                    const OptixAccelEmitDesc*     emittedProperties,
+                                    unsigned int                  numEmittedProperties )
+{
+    using namespace optix_util_test;
+
+    if( accelOptions->operation == OPTIX_BUILD_OPERATION_UPDATE )
+        return accelBuild( context, stream, accelOptions, buildInputs, numBuildInputs, tempBuffer,
+                           tempBufferSizeInBytes, outputBuffer, outputBufferSizeInBytes, outputHandle,
+                           emittedProperties, numEmittedProperties );
+    OptixAccelBufferSizes sizes;
+    accelComputeMemoryUsage( context, accelOptions, buildInputs, numBuildInputs, &sizes );
+    if( outputBufferSizeInBytes < sizes.outputSizeInBytes || tempBufferSizeInBytes < sizes.tempSizeInBytes )
+        return OPTIX_ERROR_INVALID_VALUE;
+    AccelImage image = {0, 0};
+    for( unsigned int i = 0; i < numBuildInputs; ++i )
+        image.numPrimitives += buildInputPrimitives( buildInputs[i] );
+    image.compactedSize = 1024 + 32 * image.numPrimitives;
+    std::memcpy( (void*)(uintptr_t)outputBuffer, &image, sizeof( image ) );
+    for( unsigned int e = 0; e < numEmittedProperties; ++e )
+        std::memcpy( (void*)(uintptr_t)emittedProperties[e].result, &image.compactedSize, sizeof( uint64_t ) );
+    *outputHandle = outputBuffer;
+    return OPTIX_SUCCESS;
+}
+
+/// Stub of optixAccelCompact() that copies only the AccelImage header.
+static OptixResult headerOnlyCompact( OptixDeviceContext,
+                                      CUstream,
+                                      OptixTraversableHandle  inputHandle,
+                                      CUdeviceptr             outputBuffer,
+                                      size_t                  outputBufferSizeInBytes,
+                                      OptixTraversableHandle* outputHandle )
+{
+    optix_util_test::AccelImage image;
+    std::memcpy( &image, (const void*)(uintptr_t)inputHandle, sizeof( image ) );
+    if( outputBufferSizeInBytes < image.compactedSize )
+        return OPTIX_ERROR_INVALID_VALUE;
+    std::memcpy( (void*)(uintptr_t)outputBuffer, &image, sizeof( image ) );
+    *outputHandle = outputBuffer;
+    return OPTIX_SUCCESS;
+}
+
+int main( int argc, char** argv )
+{
+    const size_t numTriangles = optix_util_bench::problemSize( argc, argv, 100000000 );
+    const size_t side         = (size_t)std::sqrt( (double)numTriangles / 2.0 ) + 2;
+    const size_t numVertices  = side * side;
+
+    // Height field over a side x side grid, with the quads wrapped if the triangle count is not a full grid.
+    std::vector<float>        vertices( numVertices * 3 );
+    std::vector<unsigned int> indices( numTriangles * 3 );
+    for( size_t v = 0; v < numVertices; ++v )
+    {
+        const float x       = (float)( v % side ), y = (float)( v / side );
+        vertices[v * 3]     = x;
+        vertices[v * 3 + 1] = y;
+        vertices[v * 3 + 2] = 20.0f * std::sin( x * 0.01f ) * std::cos( y * 0.013f );
+    }
+    for( size_t t = 0; t < numTriangles; ++t )
+    {
+        const size_t quad    = t / 2 % ( ( side - 1 ) * ( side - 1 ) );
+        const size_t v       = quad / ( side - 1 ) * side + quad % ( side - 1 );
+        const size_t c[2][3] = {{v, v + 1, v + side + 1}, {v, v + side + 1, v + side}};
+        for( int k = 0; k < 3; ++k )
+            indices[t * 3 + k] = (unsigned int)c[t % 2][k];
+    }
+    const OptixUtilMeshInput mesh = {vertices.data(), (unsigned int)numVertices, 0, indices.data(),
+                                     (unsigned int)numTriangles};
+
+    OptixUtilPartitionPolicy policy      = {};
+    const unsigned int       staticCount = optixUtilChoosePartitionCount( (unsigned int)numTriangles, policy );
+    policy.updateFrequency               = 1.0f;
+    const unsigned int dynamicCount      = optixUtilChoosePartitionCount( (unsigned int)numTriangles, policy );
+
+    OptixUtilPartitionedMesh     partitioned;
+    OptixUtilMeshPartitionReport staticReport, dynamicReport;
+    OptixResult                  result   = OPTIX_SUCCESS;
+    const double                 staticMs = optix_util_bench::milliseconds(
+        [&] { result = optixUtilPartitionMesh( mesh, staticCount, partitioned, &staticReport ); } );
+    const double dynamicMs = optix_util_bench::milliseconds( [&] {
+        if( result == OPTIX_SUCCESS )
+            result = optixUtilPartitionMesh( mesh, dynamicCount, partitioned, &dynamicReport );
+    } );
+    if( result != OPTIX_SUCCESS )
+        return 1;
+
+    // Build the dynamic partitions with the stubs. Device pointers are only passed through.
+    const unsigned int           numPartitions = (unsigned int)partitioned.partitions.size();
+    const unsigned int           flags[1]      = {OPTIX_GEOMETRY_FLAG_NONE};
+    std::vector<OptixBuildInput> inputs( numPartitions );
+    result = optixUtilGetPartitionBuildInputs( partitioned, 0x10000, 0x20000, flags, inputs.data() );
+
+    OptixFunctionTable api = optix_util_test::stubFunctionTable();
+    api.optixAccelBuild    = headerOnlyBuild;
+    api.optixAccelCompact  = headerOnlyCompact;
+    OptixUtilAccelMemoryPool  pool( optixUtilHostAllocator() );
+    OptixAccelBuildOptions    gasOptions   = {};
+    OptixInstance             instance     = {};
+    OptixUtilGasBatchOptions  batchOptions = {512u << 20, 64u << 20};
+    OptixUtilPartitionedAccel accel;
+    OptixUtilGasBatchReport   batchReport  = {};
+    gasOptions.buildFlags = OPTIX_BUILD_FLAG_ALLOW_COMPACTION | OPTIX_BUILD_FLAG_ALLOW_UPDATE;
+    const double buildMs  = optix_util_bench::milliseconds( [&] {
+        if( result == OPTIX_SUCCESS )
+            result = optixUtilBuildPartitionedAccel( api, nullptr, nullptr, inputs.data(), numPartitions, gasOptions,
+                                                     instance, pool, optixUtilHostReadback(), optixUtilHostUpload(),
+                                                     batchOptions, accel, &batchReport );
+    } );
+
+    // Deform 1% of the vertices, a band of rows in the middle of the mesh, and refit the partitions that use them.
+    const unsigned int        firstVertex = (unsigned int)( numVertices / 2 );
+    const unsigned int        numMoved    = (unsigned int)( numVertices / 100 );
+    std::vector<unsigned int> affected;
+    const double              findMs = optix_util_bench::milliseconds(
+        [&] { optixUtilFindAffectedPartitions( partitioned, firstVertex, numMoved, affected ); } );
+    const double refitMs = optix_util_bench::milliseconds( [&] {
+        if( result == OPTIX_SUCCESS )
+            result = optixUtilUpdatePartitionedAccel( api, nullptr, nullptr, inputs.data(), affected.data(),
+                                                      (unsigned int)affected.size(), pool, accel );
+    } );
+    size_t refitTriangles = 0;
+    for( unsigned int p : affected )
+        refitTriangles += partitioned.partitions[p].numTriangles;
+
+    std::printf( "mesh partition: %zu triangles, %zu vertices, %u threads\n", numTriangles, numVertices,
+                 optixUtilGetDefaultThreadCount() );
+    std::printf( "  partition, static  %4u parts %10.2f ms  SAH ratio %.2f  max/min %u/%u\n",
+                 staticReport.numPartitions, staticMs, staticReport.surfaceAreaRatio,
+                 staticReport.maxPartitionTriangles, staticReport.minPartitionTriangles );
+    std::printf( "  partition, dynamic %4u parts %10.2f ms  SAH ratio %.2f  max/min %u/%u\n",
+                 dynamicReport.numPartitions, dynamicMs, dynamicReport.surfaceAreaRatio,
+                 dynamicReport.maxPartitionTriangles, dynamicReport.minPartitionTriangles );
+    std::printf( "  stub build + compact + IAS      %10.2f ms  %u chunks\n", buildMs, batchReport.numChunks );
+    std::printf( "  find affected partitions        %10.2f ms  %zu of %u\n", findMs, affected.size(), numPartitions );
+    std::printf( "  stub refit                      %10.2f ms  %.1f%% of the triangles of a single GAS\n", refitMs,
+                 100.0 * refitTriangles / numTriangles );
+    optixUtilReleasePartitionedAccel( pool, accel );
+    return result == OPTIX_SUCCESS ? 0 : 1;
+}
@@ -0,0 +1,64 @@
+#include "optix_util_bench.h"
+
+#include <optix_util_sbt_header_cache.h>
+
+#include <cstdio>
+#include <vector>
+
+// SBT record headers for 4M hitgroup records of 64 bytes by default, or the number given as argument, over 300 program
+// groups in runs of 1 to 16 records. Compares one optixSbtRecordPackHeader() call per record, the cost before the
+// header cache, with #optixUtilWriteSbtHeaders() on an empty cache and on a cache kept from a previous build. The stub
+// packs a header with four stores, so the per-record pack times are a lower bound for the driver call.
+
+/// 16 byte aligned storage for the records.
+struct Block
+{
+    alignas( OPTIX_SBT_RECORD_ALIGNMENT ) char bytes[OPTIX_SBT_RECORD_ALIGNMENT];
+};
+
+int main( int argc, char** argv )
+{
+    const size_t count  = optix_util_bench::problemSize( argc, argv, 4000000 );
+    const size_t stride = 64;
+
+    std::vector<OptixProgramGroup> programGroups( count );
+    for( size_t i = 0, run = 0; i < count; ++run )
+        for( size_t k = 0; k < 1 + run % 16 && i < count; ++k, ++i )
+            programGroups[i] = optix_util_test::programGroup( 1 + run * 37 % 300 );
+    std::vector<Block>       records( count * stride / sizeof( Block ) );
+    char*                    out = records[0].bytes;
+    const OptixFunctionTable api = optix_util_test::stubFunctionTable();
+
+    OptixResult  result   = OPTIX_SUCCESS;
+    const double packedMs = optix_util_bench::milliseconds(
+        [&] {
+            for( size_t i = 0; i < count && result == OPTIX_SUCCESS; ++i )
+                result = api.optixSbtRecordPackHeader( programGroups[i], out + i * stride );
+        },
+        3 );
+
+    OptixUtilSbtHeaderWriteReport report = {};
+    auto write = [&]( OptixUtilSbtHeaderCache& cache, unsigned int maxThreads ) {
+        if( result == OPTIX_SUCCESS )
+            result = optixUtilWriteSbtHeaders( cache, api, programGroups.data(), count, out, stride, &report,
+                                               maxThreads );
+    };
+    const double coldMs = optix_util_bench::milliseconds(
+        [&] {
+            OptixUtilSbtHeaderCache cache;
+            write( cache, 1 );
+        },
+        3 );
+    OptixUtilSbtHeaderCache warm;
+    write( warm, 1 );
+    const double warmMs     = optix_util_bench::milliseconds( [&] { write( warm, 1 ); }, 3 );
+    const double parallelMs = optix_util_bench::milliseconds( [&] { write( warm, 0 ); }, 3 );
+
+    std::printf( "sbt headers: %zu records of %zu bytes, %zu program groups, %u threads\n", count, stride, warm.size(),
+                 optixUtilGetDefaultThreadCount() );
+    std::printf( "  pack per record        %10.2f ms %8.2f ns/record\n", packedMs, packedMs * 1e6 / count );
+    std::printf( "  cache, empty, 1 thread %10.2f ms %8.2f ns/record\n", coldMs, coldMs * 1e6 / count );
+    std::printf( "  cache, warm, 1 thread  %10.2f ms %8.2f ns/record\n", warmMs, warmMs * 1e6 / count );
+    std::printf( "  cache, warm, default   %10.2f ms %8.2f ns/record\n", parallelMs, parallelMs * 1e6 / count );
+    return result == OPTIX_SUCCESS && report.numPacked == 0 ? 0 : 1;
+}
@@ -0,0 +1,92 @@
+#include "optix_util_bench.h"
+
+#include <optix_util_srt_batch.h>
+
+#include <algorithm>
+#include <cmath>
+#include <cstdio>
+#include <random>
+#include <vector>
+
+// SRT to 3x4 matrix conversion, 10M keys by default or the number given as argument. Compares the scalar, AVX2 and
+// AVX-512 kernels of #optixUtilConvertSrtToMatrixBatch() for keys stored as an array of #OptixSRTData and as
+// structure of arrays, and writing into #OptixInstance::transform with an 80 byte stride. Hosts without AVX-512 run
+// the AVX2 kernel instead.
+
+int main( int argc, char** argv )
+{
+    const size_t n = optix_util_bench::problemSize( argc, argv, 10000000 );
+
+    // Scales between 0.5 and 2, small shears and pivots, unit quaternions and translations in a box.
+    std::vector<OptixSRTData>             keys( n );
+    std::vector<float>                    fields[16];
+    std::mt19937                          rng( 1 );
+    std::uniform_real_distribution<float> uniform( -1.f, 1.f );
+    for( size_t i = 0; i < n; ++i )
+    {
+        const float qx = uniform( rng ), qy = uniform( rng ), qz = uniform( rng ), qw = uniform( rng );
+        const float q  = 1.f / std::sqrt( qx * qx + qy * qy + qz * qz + qw * qw + 1e-6f );
+        keys[i]        = {1.25f + 0.75f * uniform( rng ), 0.1f * uniform( rng ), 0.1f * uniform( rng ), uniform( rng ),
+                          1.25f + 0.75f * uniform( rng ), 0.1f * uniform( rng ), uniform( rng ),
+                          1.25f + 0.75f * uniform( rng ), uniform( rng ), qx * q, qy * q, qz * q, qw * q,
+                          100.f * uniform( rng ), 100.f * uniform( rng ), 100.f * uniform( rng )};
+    }
+    for( int k = 0; k < 16; ++k )
+    {
+        fields[k].resize( n );
+        for( size_t i = 0; i < n; ++i )
+            fields[k][i] = ( &keys[i].sx )[k];
+    }
+    const OptixUtilSRTDataSoA soa = {fields[0].data(),  fields[1].data(),  fields[2].data(),  fields[3].data(),
+                                     fields[4].data(),  fields[5].data(),  fields[6].data(),  fields[7].data(),
+                                     fields[8].data(),  fields[9].data(),  fields[10].data(), fields[11].data(),
+                                     fields[12].data(), fields[13].data(), fields[14].data(), fields[15].data()};
+
+    std::vector<float>         reference( 12 * n ), matrices( 12 * n );
+    std::vector<OptixInstance> instances( n );
+    for( size_t i = 0; i < n; ++i )
+        optixUtilGetMatrixFromSrt( &reference[12 * i], keys[i] );
+
+    // Best of 3 runs for the layouts AoS, SoA and SoA into instances. The matrices of every layout and instruction
+    // set must match the scalar conversion up to the rounding differences of fused multiply-adds.
+    bool valid   = true;
+    auto convert = [&]( int layout, OptixUtilSimdIsa isa ) {
+        float* const out    = layout == 2 ? instances[0].transform : matrices.data();
+        const size_t stride = layout == 2 ? sizeof( OptixInstance ) : 0;
+        const double ms     = optix_util_bench::milliseconds(
+            [&] {
+                const OptixResult result =
+                    layout == 0 ? optixUtilConvertSrtToMatrixBatch( keys.data(), n, out, stride, isa )
+                                : optixUtilConvertSrtToMatrixBatch( soa, n, out, stride, isa );
+                valid = valid && result == OPTIX_SUCCESS;
+            },
+            3 );
+        const size_t step = stride ? stride / sizeof( float ) : 12;
+        for( size_t i = 0; i < n; ++i )
+            for( int k = 0; k < 12; ++k )
+            {
+                const float r = reference[12 * i + k];
+                valid         = valid && std::fabs( out[step * i + k] - r ) <= 1e-4f * std::max( 1.f, std::fabs( r ) );
+            }
+        return ms;
+    };
+    const double aosScalarMs = convert( 0, OPTIX_UTIL_SIMD_ISA_SCALAR );
+    const double aosAvx2Ms   = convert( 0, OPTIX_UTIL_SIMD_ISA_AVX2 );
+    const double aosAvx512Ms = convert( 0, OPTIX_UTIL_SIMD_ISA_AVX512 );
+    const double soaScalarMs = convert( 1, OPTIX_UTIL_SIMD_ISA_SCALAR );
+    const double soaAvx2Ms   = convert( 1, OPTIX_UTIL_SIMD_ISA_AVX2 );
+    const double soaAvx512Ms = convert( 1, OPTIX_UTIL_SIMD_ISA_AVX512 );
+    const double instanceMs  = convert( 2, OPTIX_UTIL_SIMD_ISA_AUTO );
+
+    std::printf( "SRT conversion: %zu keys, %s\n", n,
+                 optixUtilSelectSimdIsa( OPTIX_UTIL_SIMD_ISA_AVX512 ) == OPTIX_UTIL_SIMD_ISA_AVX512 ? "AVX-512"
+                                                                                                     : "no AVX-512" );
+    std::printf( "  AoS, scalar               %10.2f ms %8.1f M/s\n", aosScalarMs, n / aosScalarMs / 1000.0 );
+    std::printf( "  AoS, AVX2                 %10.2f ms %8.1f M/s\n", aosAvx2Ms, n / aosAvx2Ms / 1000.0 );
+    std::printf( "  AoS, AVX-512              %10.2f ms %8.1f M/s\n", aosAvx512Ms, n / aosAvx512Ms / 1000.0 );
+    std::printf( "  SoA, scalar               %10.2f ms %8.1f M/s\n", soaScalarMs, n / soaScalarMs / 1000.0 );
+    std::printf( "  SoA, AVX2                 %10.2f ms %8.1f M/s\n", soaAvx2Ms, n / soaAvx2Ms / 1000.0 );
+    std::printf( "  SoA, AVX-512              %10.2f ms %8.1f M/s\n", soaAvx512Ms, n / soaAvx512Ms / 1000.0 );
+    std::printf( "  SoA into instances, auto  %10.2f ms %8.1f M/s\n", instanceMs, n / instanceMs / 1000.0 );
+    return valid ? 0 : 1;
+}
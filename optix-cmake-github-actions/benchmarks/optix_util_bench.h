@@ -0,0 +1,42 @@
+/// @file
+/// @brief  Benchmark support for the optix_util headers: timing and problem sizes
+///
+/// Benchmarks include this header first. It includes the test support header for the CUDA type stand-ins and the stub
+/// OptiX functions.
+
+#ifndef __optix_util_bench_h__
+#define __optix_util_bench_h__
+
+#include "optix_util_test.h"
+
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+
+namespace optix_util_bench {
+
+/// Milliseconds spent in f, best of the given number of runs.
+template <typename F>
+double milliseconds( F f, int runs = 1 )
+{
+    double best = 0.0;
+    for( int r = 0; r < runs; ++r )
+    {
+        const std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+        f();
+        const double elapsed =
+            std::chrono::duration<double, std::milli>( std::chrono::steady_clock::now() - start ).count();
+        best = r == 0 || elapsed < best ? elapsed : best;
+    }
+    return best;
+}
+
+/// Problem size from the first command line argument, or the default.
+inline size_t problemSize( int argc, char** argv, size_t defaultSize )
+{
+    return argc > 1 ? (size_t)std::strtoull( argv[1], nullptr, 10 ) : defaultSize;
+}
+
+}  // namespace optix_util_bench
+
+#endif  // __optix_util_bench_h__
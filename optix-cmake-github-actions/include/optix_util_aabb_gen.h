@@ -0,0 +1,234 @@
+/// @file
+/// @brief  OptiX host utilities: parallel AABB generation for custom primitive build inputs
+///
+/// Fills the per-motion-key aabbBuffers of an #OptixBuildInputCustomPrimitiveArray from a user bounds functor, e.g.,
+/// for spheres, SDF bricks or volume cells. The functor is called for every primitive and motion key, in parallel
+/// over blocks of primitives. The blocks are contiguous, so a functor that reads structure-of-arrays data
+/// auto-vectorizes. Each box is validated in registers and then written directly into the strided output.
+
+#ifndef __optix_optix_util_aabb_gen_h__
+#define __optix_optix_util_aabb_gen_h__
+
+#include "optix_util_motion_bounds.h"
+#include "optix_util_parallel.h"
+
+#include <optix_types.h>
+
+#include <cfloat>
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+#include <vector>
+
+/** \addtogroup optix_utilities
+@{
+*/
+
+/// Options for #optixUtilGenerateAabbs().
+struct OptixUtilAabbGenOptions
+{
+    /// Distance between consecutive AABBs in bytes, a multiple of OPTIX_AABB_BUFFER_BYTE_ALIGNMENT. 0 selects
+    /// sizeof( OptixAabb ). Use the same value for OptixBuildInputCustomPrimitiveArray::strideInBytes.
+    unsigned int strideInBytes;
+
+    /// Replaces boxes with NaN coordinates by an inverted empty box, which the build treats as an inactive
+    /// primitive. Inverted boxes from the functor are kept and only reported.
+    bool replaceNanBoxes;
+};
+
+/// Validation result of #optixUtilGenerateAabbs().
+struct OptixUtilAabbGenReport
+{
+    /// Number of boxes with at least one NaN coordinate, over all motion keys.
+    size_t numNanBoxes;
+
+    /// Number of NaN-free boxes with min > max on some axis, over all motion keys.
+    size_t numInvertedBoxes;
+
+    /// Primitive and motion key of the first invalid box in primitive order, ~0u if all boxes are valid.
+    unsigned int firstInvalidPrimitive;
+    unsigned int firstInvalidKey;
+
+    /// Union of the valid boxes of all primitives and motion keys.
+    OptixAabb bounds;
+};
+
+namespace optix_util_impl {
+
+/// Primitives per parallel task. Large enough to amortize scheduling, small enough to balance uneven functors.
+const size_t AABB_BLOCK_SIZE = 16384;
+
+/// Below this number of boxes the generator runs on the calling thread.
+const size_t AABB_PARALLEL_THRESHOLD = 65536;
+
+/// Validation state of one block of boxes.
+struct AabbBlockResult
+{
+    size_t       numNanBoxes;
+    size_t       numInvertedBoxes;
+    unsigned int firstInvalidPrimitive;
+    OptixAabb    bounds;
+};
+
+/// Stores a box field by field. Copying the whole struct goes through the stack and stalls on store forwarding.
+inline void storeAabb( unsigned char* dst, const OptixAabb& box )
+{
+    OptixAabb* out = (OptixAabb*)dst;
+    out->minX      = box.minX;
+    out->minY      = box.minY;
+    out->minZ      = box.minZ;
+    out->maxX      = box.maxX;
+    out->maxY      = box.maxY;
+    out->maxZ      = box.maxZ;
+}
+
+/// Generates and validates the boxes [begin, end) of one motion key. Each box is built and checked in registers before
+/// it is stored, so validation costs no second pass over the buffer.
+template <typename BoundsFn>
+inline AabbBlockResult generateAabbBlock( BoundsFn&      boundsFn,
+                                          unsigned int   key,
+                                          unsigned char* buffer,
+                                          size_t         stride,
+                                          unsigned int   begin,
+                                          unsigned int   end,
+                                          bool           replaceNanBoxes )
+{
+    AabbBlockResult result = {0, 0, ~0u, emptyAabb()};
+    OptixAabb&      bounds = result.bounds;
+    unsigned char*  out    = buffer + begin * stride;
+    for( unsigned int i = begin; i < end; ++i, out += stride )
+    {
+        OptixAabb box;
+        boundsFn( i, key, box );
+
+        // All comparisons fail for NaN, so a box passes only if it is NaN-free and not inverted. The comparisons are
+        // combined without short-circuiting, which keeps a single predictable branch per box.
+        if( ( box.minX <= box.maxX ) & ( box.minY <= box.maxY ) & ( box.minZ <= box.maxZ ) )
+        {
+            bounds.minX = std::min( bounds.minX, box.minX );
+            bounds.minY = std::min( bounds.minY, box.minY );
+            bounds.minZ = std::min( bounds.minZ, box.minZ );
+            bounds.maxX = std::max( bounds.maxX, box.maxX );
+            bounds.maxY = std::max( bounds.maxY, box.maxY );
+            bounds.maxZ = std::max( bounds.maxZ, box.maxZ );
+        }
+        else
+        {
+            const bool hasNan = box.minX != box.minX || box.minY != box.minY || box.minZ != box.minZ
+                                || box.maxX != box.maxX || box.maxY != box.maxY || box.maxZ != box.maxZ;
+            if( hasNan )
+            {
+                ++result.numNanBoxes;
+                if( replaceNanBoxes )
+                    box = emptyAabb();
+            }
+            else
+            {
+                ++result.numInvertedBoxes;
+            }
+            result.firstInvalidPrimitive = std::min( result.firstInvalidPrimitive, i );
+        }
+        storeAabb( out, box );
+    }
+    return result;
+}
+
+}  // namespace optix_util_impl
+
+/// Generates the AABBs of custom primitives for all motion keys.
+///
+/// The functor has the signature void( unsigned int primitive, unsigned int key, OptixAabb& aabb ). It is called
+/// once per primitive and key from several threads at once, with increasing primitives within a key and block, and
+/// must not throw.
+///
+/// \param[in]  numPrimitives   Number of primitives.
+/// \param[in]  numMotionKeys   Number of motion keys, at least 1.
+/// \param[in]  boundsFn        Bounds functor.
+/// \param[in]  options         Output stride and NaN handling.
+/// \param[out] aabbBuffers     Host buffer of each motion key, aligned to OPTIX_AABB_BUFFER_BYTE_ALIGNMENT and holding
+///                             numPrimitives boxes at the stride from options.
+/// \param[out] report          Optional validation result.
+/// \param[in]  maxThreads      Upper bound on the number of threads, 0 for #optixUtilGetDefaultThreadCount().
+template <typename BoundsFn>
+inline OptixResult optixUtilGenerateAabbs( unsigned int                   numPrimitives,
+                                           unsigned int                   numMotionKeys,
+                                           BoundsFn&&                     boundsFn,
+                                           const OptixUtilAabbGenOptions& options,
+                                           void* const*                   aabbBuffers,
+                                           OptixUtilAabbGenReport*        report     = nullptr,
+                                           unsigned int                   maxThreads = 0 )
+{
+    using namespace optix_util_impl;
+
+    const size_t stride = options.strideInBytes ? options.strideInBytes : sizeof( OptixAabb );
+    if( numMotionKeys == 0 || stride < sizeof( OptixAabb ) || stride % OPTIX_AABB_BUFFER_BYTE_ALIGNMENT != 0
+        || ( numPrimitives && !aabbBuffers ) )
+        return OPTIX_ERROR_INVALID_VALUE;
+    for( unsigned int k = 0; k < numMotionKeys && numPrimitives; ++k )
+        if( !aabbBuffers[k] || (uintptr_t)aabbBuffers[k] % OPTIX_AABB_BUFFER_BYTE_ALIGNMENT != 0 )
+            return OPTIX_ERROR_INVALID_VALUE;
+
+    // One task per block and key, so a few motion keys of a small primitive count still spread over threads.
+    const size_t numBlocks = ( (size_t)numPrimitives + AABB_BLOCK_SIZE - 1 ) / AABB_BLOCK_SIZE;
+    const size_t numTasks  = numBlocks * numMotionKeys;
+    if( (size_t)numPrimitives * numMotionKeys < AABB_PARALLEL_THRESHOLD )
+        maxThreads = 1;
+
+    std::vector<AabbBlockResult> results( numTasks );
+    optixUtilParallelFor( numTasks, 1,
+                          [&]( size_t first, size_t last ) {
+                              for( size_t t = first; t < last; ++t )
+                              {
+                                  const unsigned int key   = (unsigned int)( t / numBlocks );
+                                  const size_t       begin = ( t % numBlocks ) * AABB_BLOCK_SIZE;
+                                  const size_t       end   = std::min<size_t>( begin + AABB_BLOCK_SIZE, numPrimitives );
+                                  unsigned char*     out   = (unsigned char*)aabbBuffers[key];
+                                  results[t] = generateAabbBlock( boundsFn, key, out, stride, (unsigned int)begin,
+                                                                  (unsigned int)end, options.replaceNanBoxes );
+                              }
+                          },
+                          maxThreads );
+
+    if( report )
+    {
+        report->numNanBoxes           = 0;
+        report->numInvertedBoxes      = 0;
+        report->firstInvalidPrimitive = ~0u;
+        report->firstInvalidKey       = ~0u;
+        report->bounds                = emptyAabb();
+        for( size_t t = 0; t < numTasks; ++t )
+        {
+            const AabbBlockResult& r = results[t];
+            report->numNanBoxes += r.numNanBoxes;
+            report->numInvertedBoxes += r.numInvertedBoxes;
+            if( r.firstInvalidPrimitive < report->firstInvalidPrimitive )
+            {
+                report->firstInvalidPrimitive = r.firstInvalidPrimitive;
+                report->firstInvalidKey       = (unsigned int)( t / numBlocks );
+            }
+            growAabb( report->bounds, r.bounds );
+        }
+    }
+    return OPTIX_SUCCESS;
+}
+
+/// Sets the AABB buffers and stride of a custom primitive build input for the output of #optixUtilGenerateAabbs().
+///
+/// \param[out] customPrimitives   Build input to update.
+/// \param[in]  numPrimitives      Number of primitives.
+/// \param[in]  aabbBuffers        Device copies of the generated buffers, one per motion key. Must stay alive until the
+///                                build is done.
+/// \param[in]  options            Options passed to #optixUtilGenerateAabbs().
+inline void optixUtilSetGeneratedAabbs( OptixBuildInputCustomPrimitiveArray& customPrimitives,
+                                        unsigned int                         numPrimitives,
+                                        const CUdeviceptr*                   aabbBuffers,
+                                        const OptixUtilAabbGenOptions&       options )
+{
+    customPrimitives.aabbBuffers   = aabbBuffers;
+    customPrimitives.numPrimitives = numPrimitives;
+    customPrimitives.strideInBytes = options.strideInBytes ? options.strideInBytes : sizeof( OptixAabb );
+}
+
+/*@}*/  // end group optix_utilities
+
+#endif  // __optix_optix_util_aabb_gen_h__
@@ -0,0 +1,619 @@
+/// @file
+/// @brief  OptiX host utilities: persistent cache of compacted acceleration structures
+///
+/// Built GAS are relocatable. An accel cache file stores the compacted bytes and the OptixAccelRelocationInfo of each
+/// GAS, keyed by #optixUtilComputeAccelCacheKey(). At startup, cached GAS are uploaded and relocated instead of built:
+///
+/// - #OptixUtilAccelCache maps the file and validates its header and index,
+/// - #optixUtilLoadCachedGas() looks up a batch of keys, checks relocation compatibility, packs the hits into arenas
+///   from an #OptixUtilAccelMemoryPool, uploads and relocates them, and returns the misses,
+/// - the misses are built, e.g., with #optixUtilBuildCompactedGas(), added with #optixUtilAddAccelToCache() to an
+///   #OptixUtilAccelCacheWriter, together with the hits from #OptixUtilAccelCacheWriter::addCachedAccels(), and the
+///   file is rewritten.
+///
+/// Layout, all integers little endian:
+///
+/// - #OptixUtilAccelCacheHeader,
+/// - #OptixUtilCachedAccel index, sorted by key,
+/// - data sections, each aligned to OPTIX_UTIL_GEOMETRY_CACHE_ALIGNMENT relative to the start of the file.
+///
+/// Header and index are covered by checksums that are checked on open. Each data section has its own checksum, which
+/// is checked on load if requested, or for the whole file by #optixUtilVerifyAccelCache().
+///
+/// Files are written to a temporary file next to the target and renamed, so readers never see a partial file.
+
+#ifndef __optix_optix_util_accel_cache_h__
+#define __optix_optix_util_accel_cache_h__
+
+#include "optix_util_accel_compact.h"
+#include "optix_util_geometry_cache.h"
+
+#include <optix_function_table.h>
+#include <optix_types.h>
+
+#include <algorithm>
+#include <chrono>
+#include <cstddef>
+#include <cstdint>
+#include <cstdio>
+#include <cstring>
+#include <map>
+#include <string>
+#include <utility>
+#include <vector>
+
+/** \addtogroup optix_utilities
+@{
+*/
+
+/// Version of the accel cache format written by #OptixUtilAccelCacheWriter.
+#define OPTIX_UTIL_ACCEL_CACHE_VERSION 1u
+
+/// File header of an accel cache.
+struct OptixUtilAccelCacheHeader
+{
+    /// "OPXACCC" followed by a zero byte.
+    char     magic[8];
+    uint32_t version;
+    uint32_t headerSize;
+    uint32_t accelSize;
+    uint32_t numAccels;
+    uint64_t indexOffset;
+    uint64_t dataOffset;
+    uint64_t fileSize;
+    uint64_t indexChecksum;
+    /// Checksum of the preceding header bytes.
+    uint64_t headerChecksum;
+};
+
+/// Acceleration structure of an accel cache file.
+struct OptixUtilCachedAccel
+{
+    uint64_t                 key;
+    OptixUtilCacheRange      data;
+    OptixAccelRelocationInfo relocationInfo;
+    /// Checksum of the data.
+    uint64_t checksum;
+};
+
+namespace optix_util_impl {
+
+inline uint64_t accelCacheHeaderChecksum( const OptixUtilAccelCacheHeader& header )
+{
+    return hashBytes( &header, offsetof( OptixUtilAccelCacheHeader, headerChecksum ), 0 );
+}
+
+/// Hash of the fields of a build input that determine the acceleration structure, other than the data that device
+/// pointers refer to. Device pointers only contribute whether they are set. Geometry flags are host data and are
+/// hashed by value.
+inline uint64_t hashBuildInputLayout( const OptixBuildInput& input, uint64_t seed )
+{
+    std::vector<uint64_t> words;
+    words.push_back( input.type );
+    if( input.type == OPTIX_BUILD_INPUT_TYPE_TRIANGLES )
+    {
+        const OptixBuildInputTriangleArray& t = input.triangleArray;
+        words.insert( words.end(), {t.numVertices, t.vertexFormat, t.vertexStrideInBytes, t.numIndexTriplets,
+                                    t.indexFormat, t.indexStrideInBytes, t.preTransform != 0, t.numSbtRecords,
+                                    t.sbtIndexOffsetSizeInBytes, t.sbtIndexOffsetStrideInBytes, t.primitiveIndexOffset,
+                                    t.transformFormat} );
+        for( unsigned int r = 0; r < t.numSbtRecords && t.flags; ++r )
+            words.push_back( t.flags[r] );
+    }
+    else if( input.type == OPTIX_BUILD_INPUT_TYPE_CURVES )
+    {
+        const OptixBuildInputCurveArray& c = input.curveArray;
+        words.insert( words.end(), {c.curveType, c.numPrimitives, c.numVertices, c.vertexStrideInBytes,
+                                    c.widthStrideInBytes, c.normalBuffers != nullptr, c.normalStrideInBytes,
+                                    c.indexStrideInBytes, c.flag, c.primitiveIndexOffset} );
+    }
+    else if( input.type == OPTIX_BUILD_INPUT_TYPE_CUSTOM_PRIMITIVES )
+    {
+        const OptixBuildInputCustomPrimitiveArray& p = input.customPrimitiveArray;
+        words.insert( words.end(), {p.numPrimitives, p.strideInBytes, p.numSbtRecords, p.sbtIndexOffsetSizeInBytes,
+                                    p.sbtIndexOffsetStrideInBytes, p.primitiveIndexOffset} );
+        for( unsigned int r = 0; r < p.numSbtRecords && p.flags; ++r )
+            words.push_back( p.flags[r] );
+    }
+    else
+    {
+        words.push_back( input.instanceArray.numInstances );
+    }
+    return hashBytes( words.data(), words.size() * sizeof( uint64_t ), seed );
+}
+
+}  // namespace optix_util_impl
+
+/// Computes the cache key of a build.
+///
+/// The key covers the build flags and motion options, and the layout of the build inputs, i.e., types, counts,
+/// formats, strides, geometry flags and index offsets. The data that device pointers refer to is covered by
+/// contentHash only, e.g., the checksum of an #OptixUtilCachedGeometry or a hash of the host copies of the arrays.
+///
+/// \param[in]  options          Build options. The operation is ignored, and OPTIX_BUILD_FLAG_ALLOW_COMPACTION does not
+///                              change the key.
+/// \param[in]  buildInputs      Build inputs.
+/// \param[in]  numBuildInputs   Number of build inputs.
+/// \param[in]  contentHash      Hash of the data of all build inputs.
+inline uint64_t optixUtilComputeAccelCacheKey( const OptixAccelBuildOptions& options,
+                                               const OptixBuildInput*        buildInputs,
+                                               unsigned int                  numBuildInputs,
+                                               uint64_t                      contentHash )
+{
+    using namespace optix_util_impl;
+
+    uint32_t timeBegin, timeEnd;
+    std::memcpy( &timeBegin, &options.motionOptions.timeBegin, sizeof( timeBegin ) );
+    std::memcpy( &timeEnd, &options.motionOptions.timeEnd, sizeof( timeEnd ) );
+    const uint64_t fields[] = {options.buildFlags & ~(unsigned int)OPTIX_BUILD_FLAG_ALLOW_COMPACTION,
+                               options.motionOptions.numKeys,
+                               options.motionOptions.flags,
+                               timeBegin,
+                               timeEnd,
+                               numBuildInputs,
+                               contentHash};
+    uint64_t       key      = hashBytes( fields, sizeof( fields ), OPTIX_UTIL_ACCEL_CACHE_VERSION );
+    for( unsigned int i = 0; i < numBuildInputs; ++i )
+        key = hashBuildInputLayout( buildInputs[i], key );
+    return key;
+}
+
+/// Read-only view of an accel cache file, either memory mapped or borrowed from the caller.
+class OptixUtilAccelCache
+{
+  public:
+    OptixUtilAccelCache() = default;
+    ~OptixUtilAccelCache() { close(); }
+    OptixUtilAccelCache( const OptixUtilAccelCache& ) = delete;
+    OptixUtilAccelCache& operator=( const OptixUtilAccelCache& ) = delete;
+
+    /// Maps the file at path and validates it. Returns OPTIX_ERROR_FILE_IO_ERROR if the file cannot be mapped, e.g.,
+    /// because there is no cache yet, and OPTIX_ERROR_INVALID_FILE_FORMAT if it is not a valid cache of this version.
+    OptixResult open( const char* path )
+    {
+        close();
+        if( !path )
+            return OPTIX_ERROR_INVALID_VALUE;
+        const OptixResult mapResult = optix_util_impl::mapCacheFile( path, m_data, m_size );
+        if( mapResult != OPTIX_SUCCESS )
+            return mapResult;
+        m_mapped = true;
+
+        const OptixResult result = validate();
+        if( result != OPTIX_SUCCESS )
+            close();
+        return result;
+    }
+
+    /// Uses a file image in memory, which must stay alive while it is used. The image must be aligned to
+    /// OPTIX_UTIL_GEOMETRY_CACHE_ALIGNMENT.
+    OptixResult openMemory( const void* data, size_t size )
+    {
+        close();
+        if( !data || (uintptr_t)data % OPTIX_UTIL_GEOMETRY_CACHE_ALIGNMENT != 0 )
+            return OPTIX_ERROR_INVALID_VALUE;
+        m_data                   = (const unsigned char*)data;
+        m_size                   = size;
+        const OptixResult result = validate();
+        if( result != OPTIX_SUCCESS )
+            close();
+        return result;
+    }
+
+    void close()
+    {
+        if( m_mapped && m_data )
+            optix_util_impl::unmapCacheFile( m_data, m_size );
+        m_data   = nullptr;
+        m_size   = 0;
+        m_mapped = false;
+    }
+
+    bool         isOpen() const { return m_data != nullptr; }
+    unsigned int numAccels() const { return m_data ? header().numAccels : 0; }
+
+    const OptixUtilAccelCacheHeader& header() const { return *(const OptixUtilAccelCacheHeader*)m_data; }
+    const OptixUtilCachedAccel&      accel( unsigned int i ) const { return accels()[i]; }
+
+    /// Returns the acceleration structure with the given key, nullptr if there is none.
+    const OptixUtilCachedAccel* find( uint64_t key ) const
+    {
+        const OptixUtilCachedAccel* first = accels();
+        const OptixUtilCachedAccel* last  = first + numAccels();
+        const OptixUtilCachedAccel* it    = std::lower_bound(
+            first, last, key, []( const OptixUtilCachedAccel& a, uint64_t k ) { return a.key < k; } );
+        return it != last && it->key == key ? it : nullptr;
+    }
+
+    /// Host pointer to the data of an acceleration structure.
+    const void* data( const OptixUtilCachedAccel& accel ) const { return m_data + accel.data.offset; }
+
+  private:
+    const OptixUtilCachedAccel* accels() const
+    {
+        return m_data ? (const OptixUtilCachedAccel*)( m_data + header().indexOffset ) : nullptr;
+    }
+
+    OptixResult validate() const
+    {
+        using namespace optix_util_impl;
+
+        if( m_size < sizeof( OptixUtilAccelCacheHeader ) )
+            return OPTIX_ERROR_INVALID_FILE_FORMAT;
+        const OptixUtilAccelCacheHeader& h = header();
+        if( std::memcmp( h.magic, "OPXACCC", 8 ) != 0 || h.version != OPTIX_UTIL_ACCEL_CACHE_VERSION
+            || h.headerSize != sizeof( OptixUtilAccelCacheHeader ) || h.accelSize != sizeof( OptixUtilCachedAccel )
+            || h.headerChecksum != accelCacheHeaderChecksum( h ) || h.fileSize != m_size )
+            return OPTIX_ERROR_INVALID_FILE_FORMAT;
+
+        const uint64_t indexSize = (uint64_t)h.numAccels * sizeof( OptixUtilCachedAccel );
+        if( h.indexOffset % OPTIX_UTIL_GEOMETRY_CACHE_ALIGNMENT || h.indexOffset < h.headerSize
+            || h.indexOffset + indexSize > h.dataOffset || h.dataOffset % OPTIX_UTIL_GEOMETRY_CACHE_ALIGNMENT
+            || h.dataOffset > m_size )
+            return OPTIX_ERROR_INVALID_FILE_FORMAT;
+        if( hashBytes( m_data + h.indexOffset, (size_t)indexSize, 0 ) != h.indexChecksum )
+            return OPTIX_ERROR_INVALID_FILE_FORMAT;
+
+        for( unsigned int i = 0; i < h.numAccels; ++i )
+        {
+            const OptixUtilCachedAccel& a = accels()[i];
+            if( ( i > 0 && accels()[i - 1].key >= a.key ) || a.data.offset % OPTIX_UTIL_GEOMETRY_CACHE_ALIGNMENT
+                || a.data.offset < h.dataOffset || a.data.offset > m_size || a.data.size > m_size - a.data.offset )
+                return OPTIX_ERROR_INVALID_FILE_FORMAT;
+        }
+        return OPTIX_SUCCESS;
+    }
+
+    const unsigned char* m_data   = nullptr;
+    size_t               m_size   = 0;
+    bool                 m_mapped = false;
+};
+
+/// Checks the data checksums of all acceleration structures of an open cache in parallel. Returns
+/// OPTIX_ERROR_DISK_CACHE_INVALID_DATA on a mismatch.
+///
+/// \param[in] cache        Open cache.
+/// \param[in] maxThreads   Upper bound on the number of threads, 0 for #optixUtilGetDefaultThreadCount().
+inline OptixResult optixUtilVerifyAccelCache( const OptixUtilAccelCache& cache, unsigned int maxThreads = 0 )
+{
+    std::vector<unsigned char> valid( cache.numAccels() );
+    optixUtilParallelFor( valid.size(), 1,
+                          [&]( size_t first, size_t last ) {
+                              for( size_t i = first; i < last; ++i )
+                              {
+                                  const OptixUtilCachedAccel& a = cache.accel( (unsigned int)i );
+                                  valid[i] = optix_util_impl::hashBytes( cache.data( a ), (size_t)a.data.size, a.key )
+                                             == a.checksum;
+                              }
+                          },
+                          maxThreads );
+    for( unsigned char v : valid )
+        if( !v )
+            return OPTIX_ERROR_DISK_CACHE_INVALID_DATA;
+    return OPTIX_SUCCESS;
+}
+
+/// Collects acceleration structures and writes them as an accel cache file.
+class OptixUtilAccelCacheWriter
+{
+  public:
+    /// Adds an acceleration structure, replacing an earlier one with the same key.
+    ///
+    /// \param[in] key              Key from #optixUtilComputeAccelCacheKey().
+    /// \param[in] relocationInfo   Relocation info from optixAccelGetRelocationInfo().
+    /// \param[in] data             Host copy of the acceleration structure, typically compacted.
+    void addAccel( uint64_t key, const OptixAccelRelocationInfo& relocationInfo, std::vector<unsigned char> data )
+    {
+        Accel& accel         = m_accels[key];
+        accel.relocationInfo = relocationInfo;
+        accel.storage        = std::move( data );
+        accel.data           = accel.storage.data();
+        accel.size           = accel.storage.size();
+    }
+
+    /// Adds all acceleration structures of an open cache whose keys have not been added yet, e.g., to carry the hits
+    /// of a load over into the rewritten file. The data is not copied, so the cache must stay open until the file is
+    /// written. On Windows, a cache file cannot be replaced while it is mapped, so write to a different path there.
+    void addCachedAccels( const OptixUtilAccelCache& cache )
+    {
+        for( unsigned int i = 0; i < cache.numAccels(); ++i )
+        {
+            const OptixUtilCachedAccel& cached = cache.accel( i );
+            if( m_accels.count( cached.key ) )
+                continue;
+            Accel& accel         = m_accels[cached.key];
+            accel.relocationInfo = cached.relocationInfo;
+            accel.data           = (const unsigned char*)cache.data( cached );
+            accel.size           = (size_t)cached.data.size;
+        }
+    }
+
+    unsigned int numAccels() const { return (unsigned int)m_accels.size(); }
+
+    /// Writes the cache file to path. The data is checksummed in parallel and streamed to a temporary file, which then
+    /// replaces the file at path.
+    OptixResult write( const char* path, unsigned int maxThreads = 0 )
+    {
+        using namespace optix_util_impl;
+
+        if( !path )
+            return OPTIX_ERROR_INVALID_VALUE;
+
+        std::vector<const Accel*>         sources;
+        std::vector<OptixUtilCachedAccel> index;
+        OptixUtilAccelCacheHeader         header = {};
+        header.indexOffset                       = alignCacheOffset( sizeof( OptixUtilAccelCacheHeader ) );
+        uint64_t offset = alignCacheOffset( header.indexOffset + m_accels.size() * sizeof( OptixUtilCachedAccel ) );
+        header.dataOffset = offset;
+        for( const auto& entry : m_accels )
+        {
+            OptixUtilCachedAccel cached = {};
+            cached.key                  = entry.first;
+            cached.data.offset          = offset;
+            cached.data.size            = entry.second.size;
+            cached.relocationInfo       = entry.second.relocationInfo;
+            offset                      = alignCacheOffset( offset + entry.second.size );
+            index.push_back( cached );
+            sources.push_back( &entry.second );
+        }
+        optixUtilParallelFor( index.size(), 1,
+                              [&]( size_t first, size_t last ) {
+                                  for( size_t i = first; i < last; ++i )
+                                      index[i].checksum = hashBytes( sources[i]->data, sources[i]->size, index[i].key );
+                              },
+                              maxThreads );
+
+        std::memcpy( header.magic, "OPXACCC", 8 );
+        header.version        = OPTIX_UTIL_ACCEL_CACHE_VERSION;
+        header.headerSize     = sizeof( OptixUtilAccelCacheHeader );
+        header.accelSize      = sizeof( OptixUtilCachedAccel );
+        header.numAccels      = (uint32_t)index.size();
+        header.fileSize       = offset;
+        header.indexChecksum  = hashBytes( index.data(), index.size() * sizeof( OptixUtilCachedAccel ), 0 );
+        header.headerChecksum = accelCacheHeaderChecksum( header );
+
+        const std::string tempPath = cacheTempPath( path );
+        FILE*             file     = std::fopen( tempPath.c_str(), "wb" );
+        if( !file )
+            return OPTIX_ERROR_FILE_IO_ERROR;
+        const unsigned char zeros[OPTIX_UTIL_GEOMETRY_CACHE_ALIGNMENT] = {};
+        uint64_t            written                                   = 0;
+        auto                put = [&]( const void* data, uint64_t size, uint64_t padded ) {
+            bool ok = std::fwrite( data, 1, (size_t)size, file ) == size;
+            for( uint64_t pad = padded - size; ok && pad; pad -= std::min<uint64_t>( pad, sizeof( zeros ) ) )
+                ok = std::fwrite( zeros, 1, (size_t)std::min<uint64_t>( pad, sizeof( zeros ) ), file ) > 0;
+            written += padded;
+            return ok;
+        };
+        bool ok = put( &header, sizeof( header ), header.indexOffset );
+        ok      = ok && put( index.data(), index.size() * sizeof( OptixUtilCachedAccel ), header.dataOffset - written );
+        for( size_t i = 0; i < index.size() && ok; ++i )
+            ok = put( sources[i]->data, sources[i]->size, alignCacheOffset( sources[i]->size ) );
+        ok = std::fclose( file ) == 0 && ok && written == header.fileSize;
+        if( !ok || !replaceCacheFile( tempPath, path ) )
+        {
+            std::remove( tempPath.c_str() );
+            return OPTIX_ERROR_FILE_IO_ERROR;
+        }
+        return OPTIX_SUCCESS;
+    }
+
+  private:
+    struct Accel
+    {
+        OptixAccelRelocationInfo   relocationInfo;
+        const unsigned char*       data = nullptr;
+        size_t                     size = 0;
+        std::vector<unsigned char> storage;
+    };
+    std::map<uint64_t, Accel> m_accels;
+};
+
+/// Reads back a built acceleration structure and adds it to a writer.
+///
+/// \param[in]  api           OptiX function table.
+/// \param[in]  context       Device context that built the acceleration structure.
+/// \param[in]  stream        Stream the acceleration structure was built or compacted on.
+/// \param[in]  readback      Device to host copy.
+/// \param[in]  key           Key from #optixUtilComputeAccelCacheKey().
+/// \param[in]  handle        Handle of the acceleration structure.
+/// \param[in]  buffer        Buffer of the acceleration structure.
+/// \param[in]  sizeInBytes   Size of the acceleration structure, e.g., the compacted size.
+/// \param[out] writer        Writer to add to.
+inline OptixResult optixUtilAddAccelToCache( const OptixFunctionTable&      api,
+                                             OptixDeviceContext             context,
+                                             CUstream                       stream,
+                                             const OptixUtilDeviceReadback& readback,
+                                             uint64_t                       key,
+                                             OptixTraversableHandle         handle,
+                                             CUdeviceptr                    buffer,
+                                             size_t                         sizeInBytes,
+                                             OptixUtilAccelCacheWriter&     writer )
+{
+    if( !readback.read || !handle || !buffer )
+        return OPTIX_ERROR_INVALID_VALUE;
+    OptixAccelRelocationInfo relocationInfo;
+    OptixResult              result = api.optixAccelGetRelocationInfo( context, handle, &relocationInfo );
+    if( result != OPTIX_SUCCESS )
+        return result;
+    std::vector<unsigned char> data( sizeInBytes );
+    result = readback.read( readback.userData, stream, buffer, sizeInBytes, data.data() );
+    if( result != OPTIX_SUCCESS )
+        return result;
+    writer.addAccel( key, relocationInfo, std::move( data ) );
+    return OPTIX_SUCCESS;
+}
+
+/// Options of #optixUtilLoadCachedGas().
+struct OptixUtilAccelCacheLoadOptions
+{
+    /// Size of the arenas the loaded acceleration structures are packed into, see
+    /// OptixUtilAccelMemoryOptions::arenaSizeInBytes.
+    size_t arenaSizeInBytes;
+
+    /// Checks the data checksum of each hit before it is uploaded, in parallel. Hits with a mismatch are treated as
+    /// misses.
+    int verifyChecksums;
+};
+
+/// Result of #optixUtilLoadCachedGas().
+struct OptixUtilAccelCacheLoadReport
+{
+    unsigned int numHits;
+    /// Keys without an entry, with an incompatible entry, or with a checksum mismatch. All are included in numMisses.
+    unsigned int numMisses;
+    unsigned int numIncompatible;
+    unsigned int numCorrupt;
+    size_t       loadedBytes;
+    /// Host time of the call, including the checksums. Uploads may still be in flight.
+    double seconds;
+};
+
+/// Uploads and relocates the cached GAS of a batch of keys.
+///
+/// Hits are packed into arenas acquired from the pool, uploaded from the cache and relocated on stream. The cache must
+/// stay open until stream is synchronized, since uploads read from it.
+///
+/// \param[in]  api         OptiX function table.
+/// \param[in]  context     Device context.
+/// \param[in]  stream      Stream for uploads and relocations.
+/// \param[in]  cache       Open cache.
+/// \param[in]  keys        Keys from #optixUtilComputeAccelCacheKey().
+/// \param[in]  numKeys     Number of keys.
+/// \param[in]  pool        Pool for the loaded acceleration structures.
+/// \param[in]  upload      Host to device copy.
+/// \param[in]  options     Options.
+/// \param[out] batch       Loaded acceleration structures, with zero handles, buffers and sizes for misses. Release
+///                         with #optixUtilReleaseCompactedGasBatch(). Existing contents are replaced, without
+///                         releasing them.
+/// \param[out] misses      Indices of the keys that need to be built, in increasing order.
+/// \param[out] report      Optional result counts.
+/// \param[in]  maxThreads  Upper bound on the number of threads for checksums, 0 for #optixUtilGetDefaultThreadCount().
+inline OptixResult optixUtilLoadCachedGas( const OptixFunctionTable&             api,
+                                           OptixDeviceContext                    context,
+                                           CUstream                              stream,
+                                           const OptixUtilAccelCache&            cache,
+                                           const uint64_t*                       keys,
+                                           unsigned int                          numKeys,
+                                           OptixUtilAccelMemoryPool&             pool,
+                                           const OptixUtilDeviceUpload&          upload,
+                                           const OptixUtilAccelCacheLoadOptions& options,
+                                           OptixUtilCompactedGasBatch&           batch,
+                                           std::vector<unsigned int>&            misses,
+                                           OptixUtilAccelCacheLoadReport*        report     = nullptr,
+                                           unsigned int                          maxThreads = 0 )
+{
+    using namespace optix_util_impl;
+
+    if( ( numKeys && !keys ) || !upload.write )
+        return OPTIX_ERROR_INVALID_VALUE;
+    const auto start = std::chrono::steady_clock::now();
+
+    OptixUtilAccelCacheLoadReport loadReport = {};
+    std::vector<const OptixUtilCachedAccel*> entries( numKeys );
+    for( unsigned int i = 0; i < numKeys; ++i )
+    {
+        entries[i] = cache.find( keys[i] );
+        int compatible = 0;
+        if( entries[i] )
+        {
+            const OptixResult result =
+                api.optixAccelCheckRelocationCompatibility( context, &entries[i]->relocationInfo, &compatible );
+            if( result != OPTIX_SUCCESS )
+                return result;
+        }
+        if( entries[i] && !compatible )
+        {
+            entries[i] = nullptr;
+            ++loadReport.numIncompatible;
+        }
+    }
+    if( options.verifyChecksums )
+    {
+        std::vector<unsigned char> valid( numKeys, 1 );
+        optixUtilParallelFor( numKeys, 1,
+                              [&]( size_t first, size_t last ) {
+                                  for( size_t i = first; i < last; ++i )
+                                  {
+                                      const OptixUtilCachedAccel* entry = entries[i];
+                                      if( entry )
+                                          valid[i] = hashBytes( cache.data( *entry ), (size_t)entry->data.size,
+                                                                entry->key )
+                                                     == entry->checksum;
+                                  }
+                              },
+                              maxThreads );
+        for( unsigned int i = 0; i < numKeys; ++i )
+        {
+            if( !valid[i] )
+            {
+                entries[i] = nullptr;
+                ++loadReport.numCorrupt;
+            }
+        }
+    }
+
+    // Pack the hits like compacted outputs.
+    std::vector<unsigned int>          hits;
+    std::vector<OptixAccelBufferSizes> sizes;
+    misses.clear();
+    for( unsigned int i = 0; i < numKeys; ++i )
+    {
+        if( !entries[i] )
+        {
+            misses.push_back( i );
+            continue;
+        }
+        OptixAccelBufferSizes hitSizes = {};
+        hitSizes.outputSizeInBytes     = (size_t)entries[i]->data.size;
+        hits.push_back( i );
+        sizes.push_back( hitSizes );
+    }
+    OptixUtilAccelMemoryOptions memoryOptions = {};
+    memoryOptions.arenaSizeInBytes            = options.arenaSizeInBytes;
+    OptixUtilAccelMemoryPlan plan;
+    optixUtilPlanAccelMemory( sizes.data(), (unsigned int)hits.size(), memoryOptions, plan );
+    OptixUtilAccelMemory memory;
+    OptixResult          result = optixUtilAcquireAccelMemory( pool, plan, memory );
+    if( result != OPTIX_SUCCESS )
+        return result;
+
+    batch = OptixUtilCompactedGasBatch();
+    batch.handles.assign( numKeys, 0 );
+    batch.buffers.assign( numKeys, 0 );
+    batch.sizes.assign( numKeys, 0 );
+    batch.memory.push_back( memory );
+    for( unsigned int h = 0; h < hits.size() && result == OPTIX_SUCCESS; ++h )
+    {
+        const unsigned int          i     = hits[h];
+        const OptixUtilCachedAccel& entry = *entries[i];
+        OptixUtilAccelBuildBuffers  buffers = {};
+        result                              = optixUtilGetAccelBuildBuffers( plan, memory, h, buffers );
+        if( result == OPTIX_SUCCESS )
+            result = upload.write( upload.userData, stream, cache.data( entry ), buffers.outputBufferSizeInBytes,
+                                   buffers.outputBuffer );
+        if( result == OPTIX_SUCCESS )
+            result = api.optixAccelRelocate( context, stream, &entry.relocationInfo, 0, 0, buffers.outputBuffer,
+                                             buffers.outputBufferSizeInBytes, &batch.handles[i] );
+        batch.buffers[i] = buffers.outputBuffer;
+        batch.sizes[i]   = buffers.outputBufferSizeInBytes;
+        loadReport.loadedBytes += buffers.outputBufferSizeInBytes;
+    }
+    if( result != OPTIX_SUCCESS )
+    {
+        optixUtilReleaseCompactedGasBatch( pool, batch );
+        misses.clear();
+        return result;
+    }
+
+    loadReport.numHits   = (unsigned int)hits.size();
+    loadReport.numMisses = (unsigned int)misses.size();
+    loadReport.seconds   = std::chrono::duration<double>( std::chrono::steady_clock::now() - start ).count();
+    if( report )
+        *report = loadReport;
+    return OPTIX_SUCCESS;
+}
+
+/*@}*/  // end group optix_utilities
+
+#endif  // __optix_optix_util_accel_cache_h__
@@ -0,0 +1,333 @@
+/// @file
+/// @brief  OptiX host utilities: batched GAS build and compaction
+///
+/// Compacting one GAS at a time needs a readback of its compacted size between build and compaction, which serializes
+/// scene loading. #optixUtilBuildCompactedGas() pipelines a batch instead:
+///
+/// - all builds of a chunk are launched with OPTIX_BUILD_FLAG_ALLOW_COMPACTION, each emitting its compacted size into
+///   one shared buffer,
+/// - the compacted sizes of the chunk are read back with a single synchronizing copy,
+/// - the compacted outputs are packed into shared arenas with #optixUtilPlanAccelMemory(), all builds are compacted,
+///   and the uncompacted arenas are released to the pool together.
+///
+/// Memory comes from an #OptixUtilAccelMemoryPool, and the readback goes through an #OptixUtilDeviceReadback. With
+/// #optixUtilHostAllocator(), #optixUtilHostReadback() and a function table of stubs, the pipeline runs on the CPU.
+
+#ifndef __optix_optix_util_accel_compact_h__
+#define __optix_optix_util_accel_compact_h__
+
+#include "optix_util_accel_memory.h"
+
+#include <optix_function_table.h>
+#include <optix_types.h>
+
+#include <algorithm>
+#include <chrono>
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+#include <vector>
+
+/** \addtogroup optix_utilities
+@{
+*/
+
+/// Pluggable device to host copy. For CUDA, read() typically wraps cudaMemcpyAsync() and cudaStreamSynchronize().
+struct OptixUtilDeviceReadback
+{
+    /// Copies sizeInBytes bytes from src to dst after all work queued on stream has finished, and returns when the
+    /// copy is done.
+    OptixResult ( *read )( void* userData, CUstream stream, CUdeviceptr src, size_t sizeInBytes, void* dst );
+    void* userData;
+};
+
+/// Pluggable host to device copy. For CUDA, write() typically wraps cudaMemcpyAsync().
+struct OptixUtilDeviceUpload
+{
+    /// Queues a copy of sizeInBytes bytes from src to dst on stream. src stays valid until stream is synchronized.
+    OptixResult ( *write )( void* userData, CUstream stream, const void* src, size_t sizeInBytes, CUdeviceptr dst );
+    void* userData;
+};
+
+namespace optix_util_impl {
+
+inline OptixResult hostRead( void*, CUstream, CUdeviceptr src, size_t sizeInBytes, void* dst )
+{
+    std::memcpy( dst, (const void*)(uintptr_t)src, sizeInBytes );
+    return OPTIX_SUCCESS;
+}
+
+inline OptixResult hostWrite( void*, CUstream, const void* src, size_t sizeInBytes, CUdeviceptr dst )
+{
+    std::memcpy( (void*)(uintptr_t)dst, src, sizeInBytes );
+    return OPTIX_SUCCESS;
+}
+
+}  // namespace optix_util_impl
+
+/// Readback for memory from #optixUtilHostAllocator().
+inline OptixUtilDeviceReadback optixUtilHostReadback()
+{
+    OptixUtilDeviceReadback readback;
+    readback.read     = optix_util_impl::hostRead;
+    readback.userData = nullptr;
+    return readback;
+}
+
+/// Upload for memory from #optixUtilHostAllocator().
+inline OptixUtilDeviceUpload optixUtilHostUpload()
+{
+    OptixUtilDeviceUpload upload;
+    upload.write    = optix_util_impl::hostWrite;
+    upload.userData = nullptr;
+    return upload;
+}
+
+/// Options of #optixUtilBuildCompactedGas().
+struct OptixUtilGasBatchOptions
+{
+    /// Upper bound on the uncompacted output memory of one chunk. Builds are split into chunks in request order, each
+    /// with one readback. 0 builds the whole batch as one chunk. A single build larger than the bound forms a chunk of
+    /// its own.
+    size_t maxUncompactedBytes;
+
+    /// Size of the arenas for uncompacted and compacted outputs, see OptixUtilAccelMemoryOptions::arenaSizeInBytes.
+    size_t arenaSizeInBytes;
+};
+
+/// Compacted acceleration structures of #optixUtilBuildCompactedGas().
+struct OptixUtilCompactedGasBatch
+{
+    /// Handle, buffer and buffer size of each build.
+    std::vector<OptixTraversableHandle> handles;
+    std::vector<CUdeviceptr>            buffers;
+    std::vector<size_t>                 sizes;
+    /// Arenas of the compacted outputs, one entry per chunk. Release with #optixUtilReleaseCompactedGasBatch().
+    std::vector<OptixUtilAccelMemory> memory;
+};
+
+/// Memory and throughput of #optixUtilBuildCompactedGas().
+struct OptixUtilGasBatchReport
+{
+    unsigned int numBuilds;
+    unsigned int numChunks;
+    /// Sum of the uncompacted and compacted output sizes.
+    size_t uncompactedBytes;
+    size_t compactedBytes;
+    /// Size of the compacted arenas, including alignment padding.
+    size_t compactedArenaBytes;
+    /// Largest temp slot size of a chunk.
+    size_t tempBytes;
+    /// Host time from the first size query to the last compaction launch, including the readbacks.
+    double seconds;
+    double buildsPerSecond;
+};
+
+/// Releases the compacted arenas of a batch to the pool and clears the batch.
+inline OptixResult optixUtilReleaseCompactedGasBatch( OptixUtilAccelMemoryPool&   pool,
+                                                      OptixUtilCompactedGasBatch& batch )
+{
+    OptixResult result = OPTIX_SUCCESS;
+    for( OptixUtilAccelMemory& memory : batch.memory )
+    {
+        const OptixResult memoryResult = optixUtilReleaseAccelMemory( pool, memory );
+        result                         = result == OPTIX_SUCCESS ? memoryResult : result;
+    }
+    batch = OptixUtilCompactedGasBatch();
+    return result;
+}
+
+namespace optix_util_impl {
+
+/// Builds and compacts the requests [first, last), see #optixUtilBuildCompactedGas().
+inline OptixResult buildCompactedGasChunk( const OptixFunctionTable&         api,
+                                           OptixDeviceContext                context,
+                                           CUstream                          stream,
+                                           const OptixUtilAccelBuildRequest* requests,
+                                           const OptixAccelBufferSizes*      sizes,
+                                           unsigned int                      first,
+                                           unsigned int                      last,
+                                           OptixUtilAccelMemoryPool&         pool,
+                                           const OptixUtilDeviceReadback&    readback,
+                                           const OptixUtilGasBatchOptions&   options,
+                                           OptixUtilCompactedGasBatch&       batch,
+                                           OptixUtilGasBatchReport&          report )
+{
+    const unsigned int          count = last - first;
+    OptixUtilAccelMemoryOptions memoryOptions = {};
+    memoryOptions.arenaSizeInBytes            = options.arenaSizeInBytes;
+    OptixUtilAccelMemoryPlan buildPlan;
+    optixUtilPlanAccelMemory( sizes + first, count, memoryOptions, buildPlan );
+
+    OptixUtilAccelMemory buildMemory;
+    OptixResult          result = optixUtilAcquireAccelMemory( pool, buildPlan, buildMemory );
+    if( result != OPTIX_SUCCESS )
+        return result;
+    CUdeviceptr sizeBuffer = 0;
+    result                 = pool.acquire( count * sizeof( uint64_t ), &sizeBuffer );
+
+    // Launch all builds, each emitting its compacted size.
+    std::vector<OptixTraversableHandle> uncompacted( count );
+    for( unsigned int i = 0; i < count && result == OPTIX_SUCCESS; ++i )
+    {
+        const OptixUtilAccelBuildRequest& request      = requests[first + i];
+        OptixAccelBuildOptions            buildOptions = *request.options;
+        buildOptions.buildFlags |= OPTIX_BUILD_FLAG_ALLOW_COMPACTION;
+
+        OptixUtilAccelBuildBuffers buffers = {};
+        result                             = optixUtilGetAccelBuildBuffers( buildPlan, buildMemory, i, buffers );
+        if( result != OPTIX_SUCCESS )
+            break;
+        OptixAccelEmitDesc emit;
+        emit.type   = OPTIX_PROPERTY_TYPE_COMPACTED_SIZE;
+        emit.result = sizeBuffer + i * sizeof( uint64_t );
+        result      = api.optixAccelBuild( context, stream, &buildOptions, request.buildInputs, request.numBuildInputs,
+                                      buffers.tempBuffer, buffers.tempBufferSizeInBytes, buffers.outputBuffer,
+                                      buffers.outputBufferSizeInBytes, &uncompacted[i], &emit, 1 );
+    }
+
+    // One readback for the chunk, which also guarantees that the builds are done with their temp memory.
+    std::vector<uint64_t> compactedSizes( count );
+    if( result == OPTIX_SUCCESS )
+        result = readback.read( readback.userData, stream, sizeBuffer, count * sizeof( uint64_t ),
+                                compactedSizes.data() );
+    if( sizeBuffer )
+        pool.release( sizeBuffer );
+    optixUtilReleaseAccelTemp( pool, buildMemory );
+
+    std::vector<OptixAccelBufferSizes> compactedBufferSizes( count );
+    for( unsigned int i = 0; i < count; ++i )
+    {
+        compactedBufferSizes[i]                   = OptixAccelBufferSizes();
+        compactedBufferSizes[i].outputSizeInBytes = (size_t)compactedSizes[i];
+    }
+    OptixUtilAccelMemoryPlan compactPlan;
+    OptixUtilAccelMemory     compactMemory;
+    if( result == OPTIX_SUCCESS )
+    {
+        optixUtilPlanAccelMemory( compactedBufferSizes.data(), count, memoryOptions, compactPlan );
+        result = optixUtilAcquireAccelMemory( pool, compactPlan, compactMemory );
+    }
+
+    for( unsigned int i = 0; i < count && result == OPTIX_SUCCESS; ++i )
+    {
+        OptixUtilAccelBuildBuffers buffers = {};
+        result                             = optixUtilGetAccelBuildBuffers( compactPlan, compactMemory, i, buffers );
+        if( result != OPTIX_SUCCESS )
+            break;
+        result = api.optixAccelCompact( context, stream, uncompacted[i], buffers.outputBuffer,
+                                        buffers.outputBufferSizeInBytes, &batch.handles[first + i] );
+        batch.buffers[first + i] = buffers.outputBuffer;
+        batch.sizes[first + i]   = buffers.outputBufferSizeInBytes;
+    }
+
+    // The uncompacted arenas go back to the pool in bulk. Work queued later on the same stream runs after the
+    // compactions, so reusing them on this stream is safe.
+    optixUtilReleaseAccelMemory( pool, buildMemory );
+    if( result != OPTIX_SUCCESS )
+    {
+        optixUtilReleaseAccelMemory( pool, compactMemory );
+        return result;
+    }
+    batch.memory.push_back( compactMemory );
+
+    report.uncompactedBytes += buildPlan.outputBytes;
+    report.compactedBytes += compactPlan.outputBytes;
+    for( size_t arenaSize : compactPlan.arenaSizes )
+        report.compactedArenaBytes += arenaSize;
+    report.tempBytes = std::max( report.tempBytes, buildPlan.tempSlotSizeInBytes );
+    ++report.numChunks;
+    return OPTIX_SUCCESS;
+}
+
+}  // namespace optix_util_impl
+
+/// Builds and compacts a batch of GAS, see the file description.
+///
+/// All work is queued on one stream. Memory released to the pool during the call may be handed out again before that
+/// work has finished, so the pool must only be used with this stream or after synchronizing it.
+///
+/// \param[in]  api          OptiX function table.
+/// \param[in]  context      Device context.
+/// \param[in]  stream       Stream for builds and compactions.
+/// \param[in]  requests     Builds. Operations must be OPTIX_BUILD_OPERATION_BUILD. OPTIX_BUILD_FLAG_ALLOW_COMPACTION
+///                          is added to the build flags.
+/// \param[in]  numRequests  Number of builds.
+/// \param[in]  pool         Pool for all device memory.
+/// \param[in]  readback     Device to host copy for the compacted sizes.
+/// \param[in]  options      Options.
+/// \param[out] batch        Compacted acceleration structures. Existing contents are replaced, without releasing them.
+/// \param[out] report       Optional memory and throughput report.
+inline OptixResult optixUtilBuildCompactedGas( const OptixFunctionTable&         api,
+                                               OptixDeviceContext                context,
+                                               CUstream                          stream,
+                                               const OptixUtilAccelBuildRequest* requests,
+                                               unsigned int                      numRequests,
+                                               OptixUtilAccelMemoryPool&         pool,
+                                               const OptixUtilDeviceReadback&    readback,
+                                               const OptixUtilGasBatchOptions&   options,
+                                               OptixUtilCompactedGasBatch&       batch,
+                                               OptixUtilGasBatchReport*          report = nullptr )
+{
+    using namespace optix_util_impl;
+
+    if( ( numRequests && !requests ) || !readback.read )
+        return OPTIX_ERROR_INVALID_VALUE;
+    for( unsigned int i = 0; i < numRequests; ++i )
+        if( !requests[i].options || requests[i].options->operation != OPTIX_BUILD_OPERATION_BUILD )
+            return OPTIX_ERROR_INVALID_VALUE;
+
+    const auto start = std::chrono::steady_clock::now();
+
+    // Size queries see the compaction flag that the builds will use.
+    std::vector<OptixAccelBuildOptions>     buildOptions( numRequests );
+    std::vector<OptixUtilAccelBuildRequest> compactRequests( requests, requests + numRequests );
+    for( unsigned int i = 0; i < numRequests; ++i )
+    {
+        buildOptions[i] = *requests[i].options;
+        buildOptions[i].buildFlags |= OPTIX_BUILD_FLAG_ALLOW_COMPACTION;
+        compactRequests[i].options = &buildOptions[i];
+    }
+    std::vector<OptixAccelBufferSizes> sizes( numRequests );
+    OptixResult                        result =
+        optixUtilComputeAccelBufferSizes( api, context, compactRequests.data(), numRequests, sizes.data() );
+    if( result != OPTIX_SUCCESS )
+        return result;
+
+    batch = OptixUtilCompactedGasBatch();
+    batch.handles.assign( numRequests, 0 );
+    batch.buffers.assign( numRequests, 0 );
+    batch.sizes.assign( numRequests, 0 );
+    OptixUtilGasBatchReport batchReport = {};
+    batchReport.numBuilds               = numRequests;
+
+    for( unsigned int first = 0; first < numRequests && result == OPTIX_SUCCESS; )
+    {
+        unsigned int last  = first + 1;
+        size_t       bytes = alignAccelOffset( sizes[first].outputSizeInBytes );
+        while( last < numRequests && options.maxUncompactedBytes
+               && bytes + alignAccelOffset( sizes[last].outputSizeInBytes ) <= options.maxUncompactedBytes )
+            bytes += alignAccelOffset( sizes[last++].outputSizeInBytes );
+        if( !options.maxUncompactedBytes )
+            last = numRequests;
+
+        result = buildCompactedGasChunk( api, context, stream, compactRequests.data(), sizes.data(), first, last, pool,
+                                         readback, options, batch, batchReport );
+        first = last;
+    }
+    if( result != OPTIX_SUCCESS )
+    {
+        optixUtilReleaseCompactedGasBatch( pool, batch );
+        return result;
+    }
+
+    batchReport.seconds = std::chrono::duration<double>( std::chrono::steady_clock::now() - start ).count();
+    batchReport.buildsPerSecond = batchReport.seconds > 0.0 ? numRequests / batchReport.seconds : 0.0;
+    if( report )
+        *report = batchReport;
+    return OPTIX_SUCCESS;
+}
+
+/*@}*/  // end group optix_utilities
+
+#endif  // __optix_optix_util_accel_compact_h__
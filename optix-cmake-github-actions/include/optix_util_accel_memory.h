@@ -0,0 +1,417 @@
+/// @file
+/// @brief  OptiX host utilities: acceleration structure memory planning with pooled arenas
+///
+/// Building many small acceleration structures with one allocation per output and temp buffer makes allocator calls
+/// dominate. The utilities in this header plan the memory of a batch of builds instead:
+///
+/// - #optixUtilComputeAccelBufferSizes() queries the buffer sizes of all builds,
+/// - #optixUtilPlanAccelMemory() packs the outputs into a few arenas at offsets aligned to
+///   OPTIX_ACCEL_BUFFER_BYTE_ALIGNMENT, and assigns temp buffers to a small number of slots that builds reuse in turn,
+/// - #OptixUtilAccelMemoryPool allocates the arenas and keeps released ones for later batches.
+///
+/// Memory comes from an #OptixUtilDeviceAllocator. #optixUtilHostAllocator() returns one that uses host memory, which
+/// allows running and timing the planning and pooling logic without a device.
+
+#ifndef __optix_optix_util_accel_memory_h__
+#define __optix_optix_util_accel_memory_h__
+
+#include <optix_function_table.h>
+#include <optix_types.h>
+
+#include <algorithm>
+#include <cstddef>
+#include <cstdint>
+#include <cstdlib>
+#include <map>
+#include <unordered_map>
+#include <vector>
+
+/** \addtogroup optix_utilities
+@{
+*/
+
+/// Pluggable allocator for device memory. For CUDA, allocate() typically wraps cudaMalloc() and free() cudaFree().
+struct OptixUtilDeviceAllocator
+{
+    /// Allocates sizeInBytes bytes aligned to at least OPTIX_ACCEL_BUFFER_BYTE_ALIGNMENT.
+    OptixResult ( *allocate )( void* userData, size_t sizeInBytes, CUdeviceptr* ptr );
+    /// Frees memory returned by allocate().
+    void ( *free )( void* userData, CUdeviceptr ptr );
+    void* userData;
+};
+
+namespace optix_util_impl {
+
+inline OptixResult hostAllocate( void*, size_t sizeInBytes, CUdeviceptr* ptr )
+{
+    // Over-allocate to align the block and to store the pointer for free() in front of it.
+    const size_t   alignment = OPTIX_ACCEL_BUFFER_BYTE_ALIGNMENT;
+    unsigned char* raw       = (unsigned char*)std::malloc( sizeInBytes + alignment + sizeof( void* ) );
+    if( !raw )
+        return OPTIX_ERROR_HOST_OUT_OF_MEMORY;
+    const uintptr_t aligned = ( (uintptr_t)raw + sizeof( void* ) + alignment - 1 ) & ~( (uintptr_t)alignment - 1 );
+    ( (void**)aligned )[-1] = raw;
+    *ptr                    = (CUdeviceptr)aligned;
+    return OPTIX_SUCCESS;
+}
+
+inline void hostFree( void*, CUdeviceptr ptr )
+{
+    if( ptr )
+        std::free( ( (void**)(uintptr_t)ptr )[-1] );
+}
+
+inline size_t alignAccelOffset( size_t offset )
+{
+    return ( offset + OPTIX_ACCEL_BUFFER_BYTE_ALIGNMENT - 1 ) & ~( (size_t)OPTIX_ACCEL_BUFFER_BYTE_ALIGNMENT - 1 );
+}
+
+/// Pool blocks are rounded up to this size, so blocks of similar batches are interchangeable.
+const size_t ACCEL_POOL_GRANULARITY = 64 * 1024;
+
+}  // namespace optix_util_impl
+
+/// Allocator that returns host memory as CUdeviceptr, for running the planner and pool on the CPU.
+inline OptixUtilDeviceAllocator optixUtilHostAllocator()
+{
+    OptixUtilDeviceAllocator allocator;
+    allocator.allocate = optix_util_impl::hostAllocate;
+    allocator.free     = optix_util_impl::hostFree;
+    allocator.userData = nullptr;
+    return allocator;
+}
+
+/// One acceleration structure build of a batch.
+struct OptixUtilAccelBuildRequest
+{
+    const OptixAccelBuildOptions* options;
+    const OptixBuildInput*        buildInputs;
+    unsigned int                  numBuildInputs;
+};
+
+/// Queries the buffer sizes of a batch of builds with optixAccelComputeMemoryUsage().
+///
+/// \param[in]  api           OptiX function table.
+/// \param[in]  context       Device context.
+/// \param[in]  requests      Builds.
+/// \param[in]  numRequests   Number of builds.
+/// \param[out] sizes         Buffer sizes of each build.
+inline OptixResult optixUtilComputeAccelBufferSizes( const OptixFunctionTable&         api,
+                                                     OptixDeviceContext                context,
+                                                     const OptixUtilAccelBuildRequest* requests,
+                                                     unsigned int                      numRequests,
+                                                     OptixAccelBufferSizes*            sizes )
+{
+    if( numRequests && ( !requests || !sizes ) )
+        return OPTIX_ERROR_INVALID_VALUE;
+    for( unsigned int i = 0; i < numRequests; ++i )
+    {
+        const OptixUtilAccelBuildRequest& request = requests[i];
+        const OptixResult                 result  = api.optixAccelComputeMemoryUsage(
+            context, request.options, request.buildInputs, request.numBuildInputs, &sizes[i] );
+        if( result != OPTIX_SUCCESS )
+            return result;
+    }
+    return OPTIX_SUCCESS;
+}
+
+/// Options of #optixUtilPlanAccelMemory().
+struct OptixUtilAccelMemoryOptions
+{
+    /// Size of the output arenas. Outputs larger than this get an arena of their own. 0 selects 64 MiB.
+    size_t arenaSizeInBytes;
+
+    /// Number of temp buffers. Build i uses temp slot i modulo this number, so builds that run at the same time, e.g.,
+    /// on different streams, must have different slots. 0 selects 1, for builds that run one after another on one
+    /// stream.
+    unsigned int numTempSlots;
+
+    /// Sizes temp slots for OptixAccelBufferSizes::tempUpdateSizeInBytes too if nonzero, so the slots can be reused
+    /// for updates.
+    int includeUpdateTemp;
+};
+
+/// Location of the buffers of one build in an #OptixUtilAccelMemoryPlan.
+struct OptixUtilAccelBufferPlacement
+{
+    unsigned int outputArena;
+    size_t       outputOffset;
+    size_t       outputSizeInBytes;
+    unsigned int tempSlot;
+    size_t       tempSizeInBytes;
+};
+
+/// Output of #optixUtilPlanAccelMemory().
+struct OptixUtilAccelMemoryPlan
+{
+    /// Size of each output arena.
+    std::vector<size_t> arenaSizes;
+    /// Buffers of each build.
+    std::vector<OptixUtilAccelBufferPlacement> placements;
+    /// Size of each temp slot, a multiple of OPTIX_ACCEL_BUFFER_BYTE_ALIGNMENT.
+    size_t       tempSlotSizeInBytes;
+    unsigned int numTempSlots;
+
+    /// Sum of the output sizes, without alignment padding.
+    size_t outputBytes;
+    /// Sum of the temp sizes, the temp memory needed with one temp buffer per build.
+    size_t separateTempBytes;
+};
+
+/// Packs the buffers of a batch of builds into arenas.
+///
+/// Outputs are placed in request order into the current arena, and a new arena is started when an output does not
+/// fit. This keeps outputs of consecutive requests adjacent. Arenas are sized to their content.
+/// Temp slots are sized for the largest temp buffer of the batch.
+///
+/// \param[in]  sizes         Buffer sizes of each build, see #optixUtilComputeAccelBufferSizes().
+/// \param[in]  numBuilds     Number of builds.
+/// \param[in]  options       Options.
+/// \param[out] plan          Plan. Existing contents are replaced.
+inline OptixResult optixUtilPlanAccelMemory( const OptixAccelBufferSizes*       sizes,
+                                             unsigned int                       numBuilds,
+                                             const OptixUtilAccelMemoryOptions& options,
+                                             OptixUtilAccelMemoryPlan&          plan )
+{
+    using namespace optix_util_impl;
+
+    if( numBuilds && !sizes )
+        return OPTIX_ERROR_INVALID_VALUE;
+    const size_t arenaSize = alignAccelOffset( options.arenaSizeInBytes ? options.arenaSizeInBytes : 64u << 20 );
+
+    plan.arenaSizes.clear();
+    plan.placements.resize( numBuilds );
+    plan.numTempSlots        = std::max( options.numTempSlots, 1u );
+    plan.tempSlotSizeInBytes = 0;
+    plan.outputBytes         = 0;
+    plan.separateTempBytes   = 0;
+
+    unsigned int currentArena = ~0u;
+    for( unsigned int i = 0; i < numBuilds; ++i )
+    {
+        OptixUtilAccelBufferPlacement& placement = plan.placements[i];
+        placement.outputSizeInBytes              = sizes[i].outputSizeInBytes;
+        placement.tempSizeInBytes                = sizes[i].tempSizeInBytes;
+        if( options.includeUpdateTemp )
+            placement.tempSizeInBytes = std::max( placement.tempSizeInBytes, sizes[i].tempUpdateSizeInBytes );
+        placement.tempSlot = i % plan.numTempSlots;
+
+        const size_t outputSize = alignAccelOffset( placement.outputSizeInBytes );
+        if( outputSize > arenaSize )
+        {
+            // Dedicated arena, which leaves the current arena open for the following outputs.
+            placement.outputArena  = (unsigned int)plan.arenaSizes.size();
+            placement.outputOffset = 0;
+            plan.arenaSizes.push_back( outputSize );
+        }
+        else
+        {
+            if( currentArena == ~0u || plan.arenaSizes[currentArena] + outputSize > arenaSize )
+            {
+                currentArena = (unsigned int)plan.arenaSizes.size();
+                plan.arenaSizes.push_back( 0 );
+            }
+            placement.outputArena  = currentArena;
+            placement.outputOffset = plan.arenaSizes[currentArena];
+            plan.arenaSizes[currentArena] += outputSize;
+        }
+
+        plan.tempSlotSizeInBytes = std::max( plan.tempSlotSizeInBytes, alignAccelOffset( placement.tempSizeInBytes ) );
+        plan.outputBytes += placement.outputSizeInBytes;
+        plan.separateTempBytes += placement.tempSizeInBytes;
+    }
+    return OPTIX_SUCCESS;
+}
+
+/// Device memory of an #OptixUtilAccelMemoryPlan, acquired from an #OptixUtilAccelMemoryPool.
+struct OptixUtilAccelMemory
+{
+    /// Base pointer of each output arena.
+    std::vector<CUdeviceptr> arenas;
+    /// Base pointer of the temp slots, 0 if the plan needs no temp memory or after optixUtilReleaseAccelTemp().
+    CUdeviceptr  tempBuffer;
+    size_t       tempSlotSizeInBytes;
+};
+
+/// Buffers of one build, in the form optixAccelBuild() takes them.
+struct OptixUtilAccelBuildBuffers
+{
+    CUdeviceptr tempBuffer;
+    size_t      tempBufferSizeInBytes;
+    CUdeviceptr outputBuffer;
+    size_t      outputBufferSizeInBytes;
+};
+
+/// Pool of device memory blocks. Released blocks are kept and handed out again for requests of similar size, so
+/// repeated batches stop calling the allocator. Not thread-safe.
+class OptixUtilAccelMemoryPool
+{
+  public:
+    explicit OptixUtilAccelMemoryPool( const OptixUtilDeviceAllocator& allocator )
+        : m_allocator( allocator )
+    {
+    }
+    ~OptixUtilAccelMemoryPool()
+    {
+        trim();
+        for( const auto& block : m_used )
+            m_allocator.free( m_allocator.userData, block.first );
+    }
+    OptixUtilAccelMemoryPool( const OptixUtilAccelMemoryPool& ) = delete;
+    OptixUtilAccelMemoryPool& operator=( const OptixUtilAccelMemoryPool& ) = delete;
+
+    /// Returns a block of at least sizeInBytes bytes. A free block is reused if it is at most twice the rounded size.
+    OptixResult acquire( size_t sizeInBytes, CUdeviceptr* ptr )
+    {
+        using namespace optix_util_impl;
+
+        if( !ptr )
+            return OPTIX_ERROR_INVALID_VALUE;
+        const size_t size = std::max<size_t>( ( sizeInBytes + ACCEL_POOL_GRANULARITY - 1 ) / ACCEL_POOL_GRANULARITY, 1 )
+                            * ACCEL_POOL_GRANULARITY;
+        auto it = m_free.lower_bound( size );
+        if( it != m_free.end() && it->first <= 2 * size )
+        {
+            *ptr = it->second;
+            m_used.emplace( it->second, it->first );
+            m_freeBytes -= it->first;
+            m_free.erase( it );
+            return OPTIX_SUCCESS;
+        }
+
+        const OptixResult result = m_allocator.allocate( m_allocator.userData, size, ptr );
+        if( result != OPTIX_SUCCESS )
+            return result;
+        if( *ptr % OPTIX_ACCEL_BUFFER_BYTE_ALIGNMENT != 0 )
+        {
+            m_allocator.free( m_allocator.userData, *ptr );
+            *ptr = 0;
+            return OPTIX_ERROR_INVALID_VALUE;
+        }
+        m_used.emplace( *ptr, size );
+        ++m_numAllocations;
+        m_allocatedBytes += size;
+        return OPTIX_SUCCESS;
+    }
+
+    /// Returns a block from acquire() to the pool. Returns OPTIX_ERROR_INVALID_VALUE for unknown pointers.
+    OptixResult release( CUdeviceptr ptr )
+    {
+        auto it = m_used.find( ptr );
+        if( it == m_used.end() )
+            return OPTIX_ERROR_INVALID_VALUE;
+        m_free.emplace( it->second, it->first );
+        m_freeBytes += it->second;
+        m_used.erase( it );
+        return OPTIX_SUCCESS;
+    }
+
+    /// Frees all blocks that are not in use.
+    void trim()
+    {
+        for( const auto& block : m_free )
+            m_allocator.free( m_allocator.userData, block.second );
+        m_allocatedBytes -= m_freeBytes;
+        m_freeBytes = 0;
+        m_free.clear();
+    }
+
+    /// Number of allocator calls so far.
+    size_t numAllocations() const { return m_numAllocations; }
+    /// Bytes currently allocated from the allocator, in use or free.
+    size_t allocatedBytes() const { return m_allocatedBytes; }
+    /// Bytes of free blocks kept for reuse.
+    size_t freeBytes() const { return m_freeBytes; }
+
+  private:
+    OptixUtilDeviceAllocator                    m_allocator;
+    std::multimap<size_t, CUdeviceptr>          m_free;
+    std::unordered_map<CUdeviceptr, size_t>     m_used;
+    size_t                                      m_numAllocations = 0;
+    size_t                                      m_allocatedBytes = 0;
+    size_t                                      m_freeBytes      = 0;
+};
+
+/// Acquires the arenas and temp slots of a plan from a pool. On failure, blocks acquired so far are released.
+///
+/// \param[in]  pool     Pool.
+/// \param[in]  plan     Plan.
+/// \param[out] memory   Acquired memory.
+inline OptixResult optixUtilAcquireAccelMemory( OptixUtilAccelMemoryPool&       pool,
+                                                const OptixUtilAccelMemoryPlan& plan,
+                                                OptixUtilAccelMemory&           memory )
+{
+    memory.arenas.assign( plan.arenaSizes.size(), 0 );
+    memory.tempBuffer          = 0;
+    memory.tempSlotSizeInBytes = plan.tempSlotSizeInBytes;
+
+    OptixResult result = OPTIX_SUCCESS;
+    for( size_t a = 0; a < plan.arenaSizes.size() && result == OPTIX_SUCCESS; ++a )
+        result = pool.acquire( plan.arenaSizes[a], &memory.arenas[a] );
+    if( result == OPTIX_SUCCESS && plan.tempSlotSizeInBytes )
+        result = pool.acquire( plan.tempSlotSizeInBytes * plan.numTempSlots, &memory.tempBuffer );
+
+    if( result != OPTIX_SUCCESS )
+    {
+        for( CUdeviceptr arena : memory.arenas )
+            if( arena )
+                pool.release( arena );
+        memory.arenas.clear();
+        memory.tempBuffer = 0;
+    }
+    return result;
+}
+
+/// Returns the temp slots of acquired memory to the pool, once all builds of the plan have finished.
+inline OptixResult optixUtilReleaseAccelTemp( OptixUtilAccelMemoryPool& pool, OptixUtilAccelMemory& memory )
+{
+    if( !memory.tempBuffer )
+        return OPTIX_SUCCESS;
+    const OptixResult result = pool.release( memory.tempBuffer );
+    memory.tempBuffer        = 0;
+    return result;
+}
+
+/// Returns all arenas and temp slots of acquired memory to the pool, once the acceleration structures are no longer
+/// used.
+inline OptixResult optixUtilReleaseAccelMemory( OptixUtilAccelMemoryPool& pool, OptixUtilAccelMemory& memory )
+{
+    OptixResult result = optixUtilReleaseAccelTemp( pool, memory );
+    for( CUdeviceptr arena : memory.arenas )
+    {
+        const OptixResult arenaResult = pool.release( arena );
+        result                        = result == OPTIX_SUCCESS ? arenaResult : result;
+    }
+    memory.arenas.clear();
+    return result;
+}
+
+/// Returns the buffers of one build of a plan.
+///
+/// \param[in]  plan      Plan.
+/// \param[in]  memory    Memory acquired for the plan.
+/// \param[in]  build     Build index.
+/// \param[out] buffers   Temp and output buffer of the build.
+inline OptixResult optixUtilGetAccelBuildBuffers( const OptixUtilAccelMemoryPlan& plan,
+                                                  const OptixUtilAccelMemory&     memory,
+                                                  unsigned int                    build,
+                                                  OptixUtilAccelBuildBuffers&     buffers )
+{
+    if( build >= plan.placements.size() || memory.arenas.size() != plan.arenaSizes.size() )
+        return OPTIX_ERROR_INVALID_VALUE;
+    const OptixUtilAccelBufferPlacement& placement = plan.placements[build];
+    if( placement.tempSizeInBytes && !memory.tempBuffer )
+        return OPTIX_ERROR_INVALID_VALUE;
+
+    buffers.outputBuffer            = memory.arenas[placement.outputArena] + placement.outputOffset;
+    buffers.outputBufferSizeInBytes = placement.outputSizeInBytes;
+    buffers.tempBuffer              = 0;
+    buffers.tempBufferSizeInBytes   = placement.tempSizeInBytes;
+    if( placement.tempSizeInBytes )
+        buffers.tempBuffer = memory.tempBuffer + placement.tempSlot * plan.tempSlotSizeInBytes;
+    return OPTIX_SUCCESS;
+}
+
+/*@}*/  // end group optix_utilities
+
+#endif  // __optix_optix_util_accel_memory_h__
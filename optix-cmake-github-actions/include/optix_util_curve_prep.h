@@ -0,0 +1,704 @@
+/// @file
+/// @brief  OptiX host utilities: curve preprocessing for #OptixBuildInputCurveArray
+///
+/// #optixUtilPrepareCurves() rebuilds the vertex, width and index buffers of linear, quadratic B-spline or cubic
+/// B-spline curves so that segments bound tightly:
+///
+/// - segments that are long, strongly curved or vary much in width are split. A split segment is refined uniformly by
+///   knot insertion, which reproduces the input curve exactly. Its pieces get their own control points, while
+///   consecutive unsplit segments keep sharing theirs,
+/// - quadratic and cubic curves are converted to linear ones by refining until each piece deviates from its chord by
+///   at most a tolerance,
+/// - linear curves are converted to cubic B-splines that interpolate the polyline vertices. The polyline is refined
+///   until the spline deviates from it by at most the tolerance.
+///
+/// Strands are runs of segments whose start indices increase by one, as in the index buffers that OptiX expects.
+/// Strands are processed in parallel. Only a single motion key is supported.
+
+#ifndef __optix_optix_util_curve_prep_h__
+#define __optix_optix_util_curve_prep_h__
+
+#include "optix_util_parallel.h"
+
+#include <optix_types.h>
+
+#include <algorithm>
+#include <cmath>
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+#include <vector>
+
+/** \addtogroup optix_utilities
+@{
+*/
+
+/// Curves in the input layout of #optixUtilPrepareCurves(), the host equivalent of one motion key of an
+/// #OptixBuildInputCurveArray.
+struct OptixUtilCurveInput
+{
+    /// OPTIX_PRIMITIVE_TYPE_ROUND_LINEAR, OPTIX_PRIMITIVE_TYPE_ROUND_QUADRATIC_BSPLINE or
+    /// OPTIX_PRIMITIVE_TYPE_ROUND_CUBIC_BSPLINE.
+    OptixPrimitiveType curveType;
+    unsigned int       numPrimitives;
+
+    /// Control points as float x, y, z.
+    const float* vertices;
+    unsigned int numVertices;
+    /// Stride between vertices, 0 for tightly packed positions.
+    unsigned int vertexStrideInBytes;
+
+    /// Width of each control point.
+    const float* widths;
+    /// Stride between widths, 0 for tightly packed widths.
+    unsigned int widthStrideInBytes;
+
+    /// Index of the first control point of each segment.
+    const unsigned int* indices;
+    /// Stride between indices, 0 for tightly packed indices.
+    unsigned int indexStrideInBytes;
+};
+
+/// Options of #optixUtilPrepareCurves().
+struct OptixUtilCurvePrepOptions
+{
+    /// Type of the output curves. 0 keeps the input type. Quadratic and cubic curves can be converted to
+    /// OPTIX_PRIMITIVE_TYPE_ROUND_LINEAR, and linear curves to OPTIX_PRIMITIVE_TYPE_ROUND_CUBIC_BSPLINE.
+    OptixPrimitiveType outputType;
+
+    /// Segments are split until the control polygon of each piece in Bezier form is at most this long. 0 disables.
+    float maxSegmentLength;
+    /// Segments are split until the inner Bezier control points of each piece are at most this far from its chord,
+    /// measured over position and width. 0 disables.
+    float maxFlatness;
+    /// Segments are split until the width of each piece varies by at most this fraction of the largest width of the
+    /// segment. 0 disables.
+    float maxWidthVariation;
+
+    /// Largest deviation of converted curves from the input, over position and width. 0 selects a tenth of the
+    /// average input width.
+    float tolerance;
+
+    /// Maximum number of halvings per segment, or per strand for conversion to cubic curves. 0 selects 4, at most 10.
+    unsigned int maxSplitDepth;
+};
+
+/// Output of #optixUtilPrepareCurves().
+struct OptixUtilPreparedCurves
+{
+    OptixPrimitiveType curveType;
+    /// Control points as x, y, z with a stride of 12 bytes.
+    std::vector<float> vertices;
+    std::vector<float> widths;
+    /// Index of the first control point of each segment.
+    std::vector<unsigned int> indices;
+    /// Input segment index of each segment.
+    std::vector<unsigned int> segmentIds;
+    /// Vertex and width buffer pointers, referenced by the build input of #optixUtilGetCurveBuildInput().
+    CUdeviceptr vertexBuffer;
+    CUdeviceptr widthBuffer;
+};
+
+/// Segment counts and bound volumes before and after #optixUtilPrepareCurves().
+struct OptixUtilCurvePrepReport
+{
+    unsigned int numStrands;
+    unsigned int numInputSegments;
+    unsigned int numOutputSegments;
+    /// Number of input segments that were split.
+    unsigned int numSplitSegments;
+    unsigned int numInputVertices;
+    unsigned int numOutputVertices;
+
+    /// Sum of the volumes of the segment AABBs. Each AABB bounds the Bezier control points of the segment, grown by
+    /// their largest width.
+    double inputBoundVolume;
+    double outputBoundVolume;
+
+    /// Largest deviation of converted curves from the input that was measured, 0 without conversion.
+    float maxConversionError;
+};
+
+namespace optix_util_impl {
+
+/// Below this number of segments, curves are processed on the calling thread only.
+const size_t CURVE_PARALLEL_THRESHOLD = 65536;
+/// Strands are grouped into tasks of at least this many segments.
+const size_t CURVE_BLOCK_SEGMENTS = 8192;
+
+/// Control point with the width as fourth component.
+struct CurvePoint
+{
+    float x, y, z, w;
+};
+
+inline CurvePoint curveAdd( const CurvePoint& a, const CurvePoint& b )
+{
+    return {a.x + b.x, a.y + b.y, a.z + b.z, a.w + b.w};
+}
+
+inline CurvePoint curveScale( const CurvePoint& a, float s )
+{
+    return {a.x * s, a.y * s, a.z * s, a.w * s};
+}
+
+inline CurvePoint curveLerp( const CurvePoint& a, const CurvePoint& b, float t )
+{
+    return {a.x + t * ( b.x - a.x ), a.y + t * ( b.y - a.y ), a.z + t * ( b.z - a.z ), a.w + t * ( b.w - a.w )};
+}
+
+inline float curveDistance( const CurvePoint& a, const CurvePoint& b )
+{
+    const float dx = a.x - b.x, dy = a.y - b.y, dz = a.z - b.z, dw = a.w - b.w;
+    return std::sqrt( dx * dx + dy * dy + dz * dz + dw * dw );
+}
+
+inline unsigned int curveDegree( OptixPrimitiveType type )
+{
+    switch( type )
+    {
+        case OPTIX_PRIMITIVE_TYPE_ROUND_LINEAR:
+            return 1;
+        case OPTIX_PRIMITIVE_TYPE_ROUND_QUADRATIC_BSPLINE:
+            return 2;
+        case OPTIX_PRIMITIVE_TYPE_ROUND_CUBIC_BSPLINE:
+            return 3;
+        default:
+            return 0;
+    }
+}
+
+inline CurvePoint curveInputPoint( const OptixUtilCurveInput& curves, unsigned int v )
+{
+    const size_t vertexStride = curves.vertexStrideInBytes ? curves.vertexStrideInBytes : 3 * sizeof( float );
+    const size_t widthStride  = curves.widthStrideInBytes ? curves.widthStrideInBytes : sizeof( float );
+    const float* p            = (const float*)( (const char*)curves.vertices + v * vertexStride );
+    const float* w            = (const float*)( (const char*)curves.widths + v * widthStride );
+    return {p[0], p[1], p[2], *w};
+}
+
+inline unsigned int curveInputIndex( const OptixUtilCurveInput& curves, size_t segment )
+{
+    const size_t stride = curves.indexStrideInBytes ? curves.indexStrideInBytes : sizeof( unsigned int );
+    return *(const unsigned int*)( (const char*)curves.indices + segment * stride );
+}
+
+/// Bezier control points of the uniform B-spline segment with control points p.
+inline void bsplineToBezier( unsigned int degree, const CurvePoint* p, CurvePoint* b )
+{
+    if( degree == 1 )
+    {
+        b[0] = p[0];
+        b[1] = p[1];
+    }
+    else if( degree == 2 )
+    {
+        b[0] = curveLerp( p[0], p[1], 0.5f );
+        b[1] = p[1];
+        b[2] = curveLerp( p[1], p[2], 0.5f );
+    }
+    else
+    {
+        b[0] = curveScale( curveAdd( curveAdd( p[0], curveScale( p[1], 4.0f ) ), p[2] ), 1.0f / 6.0f );
+        b[1] = curveLerp( p[1], p[2], 1.0f / 3.0f );
+        b[2] = curveLerp( p[1], p[2], 2.0f / 3.0f );
+        b[3] = curveScale( curveAdd( curveAdd( p[1], curveScale( p[2], 4.0f ) ), p[3] ), 1.0f / 6.0f );
+    }
+}
+
+/// Point of the uniform cubic B-spline segment with control points p at parameter t.
+inline CurvePoint evaluateCubicBspline( const CurvePoint* p, float t )
+{
+    const float s  = 1.0f - t;
+    const float b0 = s * s * s / 6.0f;
+    const float b1 = ( 3.0f * t * t * t - 6.0f * t * t + 4.0f ) / 6.0f;
+    const float b2 = ( -3.0f * t * t * t + 3.0f * t * t + 3.0f * t + 1.0f ) / 6.0f;
+    const float b3 = t * t * t / 6.0f;
+    return curveAdd( curveAdd( curveScale( p[0], b0 ), curveScale( p[1], b1 ) ),
+                     curveAdd( curveScale( p[2], b2 ), curveScale( p[3], b3 ) ) );
+}
+
+/// Largest distance of the inner Bezier control points from the chord.
+inline float bezierFlatness( unsigned int degree, const CurvePoint* b )
+{
+    const CurvePoint& a      = b[0];
+    const CurvePoint& e      = b[degree];
+    const CurvePoint  chord  = {e.x - a.x, e.y - a.y, e.z - a.z, e.w - a.w};
+    const float       length = chord.x * chord.x + chord.y * chord.y + chord.z * chord.z + chord.w * chord.w;
+    float             result = 0.0f;
+    for( unsigned int i = 1; i < degree; ++i )
+    {
+        const CurvePoint d = {b[i].x - a.x, b[i].y - a.y, b[i].z - a.z, b[i].w - a.w};
+        const float      dot = d.x * chord.x + d.y * chord.y + d.z * chord.z + d.w * chord.w;
+        const float      t   = length > 0.0f ? std::min( std::max( dot / length, 0.0f ), 1.0f ) : 0.0f;
+        result             = std::max( result, curveDistance( b[i], curveLerp( a, e, t ) ) );
+    }
+    return result;
+}
+
+/// Volume of the AABB of the Bezier control points of a segment, grown by their largest width.
+inline double bezierBoundVolume( unsigned int degree, const CurvePoint* b )
+{
+    float lo[3] = {b[0].x, b[0].y, b[0].z};
+    float hi[3] = {b[0].x, b[0].y, b[0].z};
+    float width = std::fabs( b[0].w );
+    for( unsigned int i = 1; i <= degree; ++i )
+    {
+        lo[0] = std::min( lo[0], b[i].x );
+        lo[1] = std::min( lo[1], b[i].y );
+        lo[2] = std::min( lo[2], b[i].z );
+        hi[0] = std::max( hi[0], b[i].x );
+        hi[1] = std::max( hi[1], b[i].y );
+        hi[2] = std::max( hi[2], b[i].z );
+        width = std::max( width, std::fabs( b[i].w ) );
+    }
+    return ( (double)hi[0] - lo[0] + 2.0 * width ) * ( (double)hi[1] - lo[1] + 2.0 * width )
+           * ( (double)hi[2] - lo[2] + 2.0 * width );
+}
+
+/// One step of Lane-Riesenfeld subdivision: the m segments of a uniform B-spline with m + degree control points
+/// become 2m segments with 2m + degree control points that describe the same curve.
+inline void refineBspline( unsigned int degree, const std::vector<CurvePoint>& in, std::vector<CurvePoint>& out )
+{
+    const size_t n = in.size();
+    out.clear();
+    if( degree == 1 )
+    {
+        for( size_t i = 0; i + 1 < n; ++i )
+        {
+            out.push_back( in[i] );
+            out.push_back( curveLerp( in[i], in[i + 1], 0.5f ) );
+        }
+        out.push_back( in[n - 1] );
+    }
+    else if( degree == 2 )
+    {
+        for( size_t i = 0; i + 1 < n; ++i )
+        {
+            out.push_back( curveLerp( in[i], in[i + 1], 0.25f ) );
+            out.push_back( curveLerp( in[i], in[i + 1], 0.75f ) );
+        }
+    }
+    else
+    {
+        for( size_t i = 0; i + 1 < n; ++i )
+        {
+            if( i > 0 )
+            {
+                const CurvePoint sum = curveAdd( curveAdd( in[i - 1], curveScale( in[i], 6.0f ) ), in[i + 1] );
+                out.push_back( curveScale( sum, 0.125f ) );
+            }
+            out.push_back( curveLerp( in[i], in[i + 1], 0.5f ) );
+        }
+    }
+}
+
+/// Split criteria of one segment.
+struct CurveSplitLimits
+{
+    float        maxLength;
+    float        maxFlatness;
+    float        maxWidthVariation;
+    unsigned int maxDepth;
+};
+
+/// Refines the degree + 1 control points of one segment until all pieces meet the limits or the maximum depth is
+/// reached. Returns the depth, points then holds 2^depth + degree control points.
+inline unsigned int splitCurveSegment( unsigned int            degree,
+                                       const CurveSplitLimits& limits,
+                                       std::vector<CurvePoint>& points,
+                                       std::vector<CurvePoint>& scratch )
+{
+    float segmentWidth = 0.0f;
+    for( const CurvePoint& p : points )
+        segmentWidth = std::max( segmentWidth, std::fabs( p.w ) );
+
+    for( unsigned int depth = 0;; ++depth )
+    {
+        bool within = true;
+        for( size_t j = 0; j + degree < points.size() && within; ++j )
+        {
+            CurvePoint b[4];
+            bsplineToBezier( degree, &points[j], b );
+            float length = 0.0f, minWidth = b[0].w, maxWidth = b[0].w;
+            for( unsigned int i = 1; i <= degree; ++i )
+            {
+                const CurvePoint d = {b[i].x - b[i - 1].x, b[i].y - b[i - 1].y, b[i].z - b[i - 1].z, 0.0f};
+                length += std::sqrt( d.x * d.x + d.y * d.y + d.z * d.z );
+                minWidth = std::min( minWidth, b[i].w );
+                maxWidth = std::max( maxWidth, b[i].w );
+            }
+            within = ( !limits.maxLength || length <= limits.maxLength )
+                     && ( !limits.maxFlatness || bezierFlatness( degree, b ) <= limits.maxFlatness )
+                     && ( !limits.maxWidthVariation || maxWidth - minWidth <= limits.maxWidthVariation * segmentWidth );
+        }
+        if( within || depth == limits.maxDepth )
+            return depth;
+        refineBspline( degree, points, scratch );
+        points.swap( scratch );
+    }
+}
+
+/// Solves for the control points of the uniform cubic B-spline that interpolates the points p at its knots. The first
+/// and last control points are mirrored, so the spline starts at p[0] and ends at p[n - 1]. Returns n + 2 control
+/// points.
+inline void interpolateCubicBspline( const std::vector<CurvePoint>& p,
+                                     std::vector<CurvePoint>&       c,
+                                     std::vector<float>&            scratch )
+{
+    const size_t n = p.size();
+    c.assign( n + 2, CurvePoint() );
+    c[1] = p[0];
+    c[n] = p[n - 1];
+
+    // Thomas algorithm for c[i] + 4 c[i + 1] + c[i + 2] = 6 p[i] over the inner points. The forward pass leaves the
+    // eliminated right-hand sides in c, and the reciprocal pivots in scratch.
+    scratch.assign( n, 0.0f );
+    for( size_t i = 1; i + 1 < n; ++i )
+    {
+        CurvePoint rhs = curveAdd( curveScale( p[i], 6.0f ), curveScale( c[i], -1.0f ) );
+        if( i + 2 == n )
+            rhs = curveAdd( rhs, curveScale( c[n], -1.0f ) );
+        scratch[i] = 1.0f / ( 4.0f - ( i > 1 ? scratch[i - 1] : 0.0f ) );
+        c[i + 1]   = curveScale( rhs, scratch[i] );
+    }
+    for( size_t i = n - 2; i-- > 1; )
+        c[i + 1] = curveAdd( c[i + 1], curveScale( c[i + 2], -scratch[i] ) );
+
+    c[0]     = curveAdd( curveScale( c[1], 2.0f ), curveScale( c[2], -1.0f ) );
+    c[n + 1] = curveAdd( curveScale( c[n], 2.0f ), curveScale( c[n - 1], -1.0f ) );
+    for( CurvePoint& point : c )
+        point.w = std::max( point.w, 0.0f );
+}
+
+/// Output of one task, with control point indices relative to the task.
+struct CurveBlockOutput
+{
+    std::vector<CurvePoint>   points;
+    std::vector<unsigned int> indices;
+    std::vector<unsigned int> segmentIds;
+    unsigned int              numSplitSegments;
+    double                    inputBoundVolume;
+    double                    outputBoundVolume;
+    float                     maxError;
+};
+
+/// Appends control points and adds one segment per piece. Segment j starts at control point j and has the input
+/// segment ids[j].
+inline void addCurveSegments( CurveBlockOutput&               out,
+                              unsigned int                    degree,
+                              const std::vector<CurvePoint>&  points,
+                              const std::vector<unsigned int>& ids )
+{
+    const size_t firstPoint = out.points.size();
+    out.points.insert( out.points.end(), points.begin(), points.end() );
+    for( size_t j = 0; j < ids.size(); ++j )
+    {
+        CurvePoint b[4];
+        bsplineToBezier( degree, &points[j], b );
+        out.outputBoundVolume += bezierBoundVolume( degree, b );
+        out.indices.push_back( (unsigned int)( firstPoint + j ) );
+        out.segmentIds.push_back( ids[j] );
+    }
+}
+
+/// Processes the segments [first, last) of one strand.
+inline void prepareCurveStrand( const OptixUtilCurveInput& curves,
+                                unsigned int               outputDegree,
+                                const CurveSplitLimits&    limits,
+                                float                      tolerance,
+                                size_t                     first,
+                                size_t                     last,
+                                CurveBlockOutput&          out )
+{
+    const unsigned int        degree = curveDegree( curves.curveType );
+    std::vector<CurvePoint>   points, scratch, polyline;
+    std::vector<unsigned int> depths( last - first ), ids, polylineIds;
+
+    CurveSplitLimits segmentLimits = limits;
+    if( outputDegree == 1 && degree > 1 )
+        segmentLimits.maxFlatness = limits.maxFlatness ? std::min( limits.maxFlatness, tolerance ) : tolerance;
+    for( size_t s = first; s < last; ++s )
+    {
+        const unsigned int start = curveInputIndex( curves, s );
+        points.resize( degree + 1 );
+        for( unsigned int i = 0; i <= degree; ++i )
+            points[i] = curveInputPoint( curves, start + i );
+        CurvePoint b[4];
+        bsplineToBezier( degree, points.data(), b );
+        out.inputBoundVolume += bezierBoundVolume( degree, b );
+
+        depths[s - first] = splitCurveSegment( degree, segmentLimits, points, scratch );
+        out.numSplitSegments += depths[s - first] ? 1 : 0;
+    }
+
+    // Runs of segments with the same depth are refined together, so their pieces share control points as in the
+    // input. Only the boundaries between runs duplicate control points.
+    for( size_t s = first; s < last; )
+    {
+        size_t e = s + 1;
+        while( e < last && depths[e - first] == depths[s - first] )
+            ++e;
+        const unsigned int depth = depths[s - first];
+        const unsigned int start = curveInputIndex( curves, s );
+        points.resize( e - s + degree );
+        for( size_t i = 0; i < points.size(); ++i )
+            points[i] = curveInputPoint( curves, start + (unsigned int)i );
+        for( unsigned int k = 0; k < depth; ++k )
+        {
+            refineBspline( degree, points, scratch );
+            points.swap( scratch );
+        }
+        const size_t numPieces = points.size() - degree;
+
+        if( outputDegree == degree )
+        {
+            ids.resize( numPieces );
+            for( size_t j = 0; j < numPieces; ++j )
+                ids[j] = (unsigned int)( s + ( j >> depth ) );
+            addCurveSegments( out, degree, points, ids );
+        }
+        else
+        {
+            // Conversion, collect the strand as a polyline through the piece end points.
+            for( size_t j = 0; j < numPieces; ++j )
+            {
+                CurvePoint b[4];
+                bsplineToBezier( degree, &points[j], b );
+                if( polyline.empty() )
+                    polyline.push_back( b[0] );
+                polyline.push_back( b[degree] );
+                polylineIds.push_back( (unsigned int)( s + ( j >> depth ) ) );
+                if( degree > 1 )
+                    out.maxError = std::max( out.maxError, bezierFlatness( degree, b ) );
+            }
+        }
+        s = e;
+    }
+
+    if( outputDegree == 1 && degree > 1 )
+    {
+        addCurveSegments( out, 1, polyline, polylineIds );
+    }
+    else if( outputDegree == 3 && degree == 1 )
+    {
+        // Interpolate the polyline, and halve its segments while the spline strays too far from it.
+        std::vector<CurvePoint> control;
+        std::vector<float>      solverScratch;
+        for( unsigned int level = 0;; ++level )
+        {
+            interpolateCubicBspline( polyline, control, solverScratch );
+            float error = 0.0f;
+            for( size_t j = 0; j + 1 < polyline.size(); ++j )
+            {
+                for( int k = 1; k < 4; ++k )
+                {
+                    const CurvePoint spline = evaluateCubicBspline( &control[j], 0.25f * k );
+                    const CurvePoint chord  = curveLerp( polyline[j], polyline[j + 1], 0.25f * k );
+                    error                   = std::max( error, curveDistance( spline, chord ) );
+                }
+            }
+            if( error <= tolerance || level >= limits.maxDepth )
+            {
+                out.maxError = std::max( out.maxError, error );
+                break;
+            }
+            refineBspline( 1, polyline, scratch );
+            polyline.swap( scratch );
+            ids.clear();
+            for( unsigned int id : polylineIds )
+                ids.insert( ids.end(), 2, id );
+            polylineIds.swap( ids );
+        }
+        addCurveSegments( out, 3, control, polylineIds );
+    }
+}
+
+}  // namespace optix_util_impl
+
+/// Splits and converts curves, see the file description.
+///
+/// \param[in]  curves       Input curves. Control points of each segment must be smaller than numVertices.
+/// \param[in]  options      Options.
+/// \param[out] prepared     Output buffers. Existing contents are replaced.
+/// \param[out] report       Optional segment counts and bound volumes.
+/// \param[in]  maxThreads   Upper bound on the number of threads, 0 for #optixUtilGetDefaultThreadCount().
+inline OptixResult optixUtilPrepareCurves( const OptixUtilCurveInput&       curves,
+                                           const OptixUtilCurvePrepOptions& options,
+                                           OptixUtilPreparedCurves&         prepared,
+                                           OptixUtilCurvePrepReport*        report     = nullptr,
+                                           unsigned int                     maxThreads = 0 )
+{
+    using namespace optix_util_impl;
+
+    const unsigned int degree       = curveDegree( curves.curveType );
+    const unsigned int outputDegree = options.outputType ? curveDegree( options.outputType ) : degree;
+    if( !degree || !( outputDegree == degree || outputDegree == 1 || ( degree == 1 && outputDegree == 3 ) ) )
+        return OPTIX_ERROR_INVALID_VALUE;
+    if( curves.numPrimitives && ( !curves.vertices || !curves.widths || !curves.indices ) )
+        return OPTIX_ERROR_INVALID_VALUE;
+    if( ( curves.vertexStrideInBytes && curves.vertexStrideInBytes < 3 * sizeof( float ) )
+        || ( curves.widthStrideInBytes && curves.widthStrideInBytes < sizeof( float ) )
+        || ( curves.indexStrideInBytes && curves.indexStrideInBytes < sizeof( unsigned int ) ) )
+        return OPTIX_ERROR_INVALID_VALUE;
+    if( !( options.maxSegmentLength >= 0.0f ) || !( options.maxFlatness >= 0.0f )
+        || !( options.maxWidthVariation >= 0.0f ) || !( options.tolerance >= 0.0f ) || options.maxSplitDepth > 10 )
+        return OPTIX_ERROR_INVALID_VALUE;
+
+    // Strand boundaries, and validation of the indices.
+    std::vector<size_t> strandStarts;
+    for( size_t s = 0; s < curves.numPrimitives; ++s )
+    {
+        const unsigned int start = curveInputIndex( curves, s );
+        if( (uint64_t)start + degree >= curves.numVertices )
+            return OPTIX_ERROR_INVALID_VALUE;
+        if( s == 0 || start != curveInputIndex( curves, s - 1 ) + 1 )
+            strandStarts.push_back( s );
+    }
+    strandStarts.push_back( curves.numPrimitives );
+
+    float tolerance = options.tolerance;
+    if( !tolerance && outputDegree != degree )
+    {
+        double widthSum = 0.0;
+        for( unsigned int v = 0; v < curves.numVertices; ++v )
+            widthSum += std::fabs( curveInputPoint( curves, v ).w );
+        tolerance = curves.numVertices ? (float)( 0.1 * widthSum / curves.numVertices ) : 0.0f;
+    }
+
+    CurveSplitLimits limits;
+    limits.maxLength         = options.maxSegmentLength;
+    limits.maxFlatness       = options.maxFlatness;
+    limits.maxWidthVariation = options.maxWidthVariation;
+    limits.maxDepth          = options.maxSplitDepth ? options.maxSplitDepth : 4;
+
+    // Tasks of whole strands with at least CURVE_BLOCK_SEGMENTS segments each.
+    std::vector<size_t> blockStrands( 1, 0 );
+    for( size_t i = 1; i + 1 < strandStarts.size(); ++i )
+        if( strandStarts[i] - strandStarts[blockStrands.back()] >= CURVE_BLOCK_SEGMENTS )
+            blockStrands.push_back( i );
+    blockStrands.push_back( strandStarts.size() - 1 );
+    const size_t numBlocks = blockStrands.size() - 1;
+    if( curves.numPrimitives < CURVE_PARALLEL_THRESHOLD )
+        maxThreads = 1;
+
+    std::vector<CurveBlockOutput> blocks( numBlocks );
+    optixUtilParallelFor( numBlocks, 1,
+                          [&]( size_t firstBlock, size_t lastBlock ) {
+                              for( size_t b = firstBlock; b < lastBlock; ++b )
+                              {
+                                  CurveBlockOutput& out = blocks[b];
+                                  out.numSplitSegments  = 0;
+                                  out.inputBoundVolume  = 0.0;
+                                  out.outputBoundVolume = 0.0;
+                                  out.maxError          = 0.0f;
+                                  for( size_t i = blockStrands[b]; i < blockStrands[b + 1]; ++i )
+                                      prepareCurveStrand( curves, outputDegree, limits, tolerance, strandStarts[i],
+                                                          strandStarts[i + 1], out );
+                              }
+                          },
+                          maxThreads );
+
+    std::vector<size_t> pointOffsets( numBlocks + 1, 0 ), segmentOffsets( numBlocks + 1, 0 );
+    for( size_t b = 0; b < numBlocks; ++b )
+    {
+        pointOffsets[b + 1]   = pointOffsets[b] + blocks[b].points.size();
+        segmentOffsets[b + 1] = segmentOffsets[b] + blocks[b].indices.size();
+    }
+    if( pointOffsets[numBlocks] > 0xffffffffull )
+        return OPTIX_ERROR_INVALID_VALUE;
+
+    prepared.curveType = options.outputType ? options.outputType : curves.curveType;
+    prepared.vertices.resize( pointOffsets[numBlocks] * 3 );
+    prepared.widths.resize( pointOffsets[numBlocks] );
+    prepared.indices.resize( segmentOffsets[numBlocks] );
+    prepared.segmentIds.resize( segmentOffsets[numBlocks] );
+    prepared.vertexBuffer = 0;
+    prepared.widthBuffer  = 0;
+    optixUtilParallelFor( numBlocks, 1,
+                          [&]( size_t firstBlock, size_t lastBlock ) {
+                              for( size_t b = firstBlock; b < lastBlock; ++b )
+                              {
+                                  const CurveBlockOutput& out = blocks[b];
+                                  for( size_t i = 0; i < out.points.size(); ++i )
+                                  {
+                                      float* v = &prepared.vertices[( pointOffsets[b] + i ) * 3];
+                                      v[0]     = out.points[i].x;
+                                      v[1]     = out.points[i].y;
+                                      v[2]     = out.points[i].z;
+                                      prepared.widths[pointOffsets[b] + i] = out.points[i].w;
+                                  }
+                                  const unsigned int base = (unsigned int)pointOffsets[b];
+                                  for( size_t j = 0; j < out.indices.size(); ++j )
+                                  {
+                                      prepared.indices[segmentOffsets[b] + j]    = base + out.indices[j];
+                                      prepared.segmentIds[segmentOffsets[b] + j] = out.segmentIds[j];
+                                  }
+                              }
+                          },
+                          maxThreads );
+
+    if( report )
+    {
+        *report                   = OptixUtilCurvePrepReport();
+        report->numStrands        = (unsigned int)( strandStarts.size() - 1 );
+        report->numInputSegments  = curves.numPrimitives;
+        report->numOutputSegments = (unsigned int)prepared.indices.size();
+        report->numInputVertices  = curves.numVertices;
+        report->numOutputVertices = (unsigned int)prepared.widths.size();
+        for( const CurveBlockOutput& out : blocks )
+        {
+            report->numSplitSegments += out.numSplitSegments;
+            report->inputBoundVolume += out.inputBoundVolume;
+            report->outputBoundVolume += out.outputBoundVolume;
+            report->maxConversionError = std::max( report->maxConversionError, out.maxError );
+        }
+        if( outputDegree == degree )
+            report->maxConversionError = 0.0f;
+    }
+    return OPTIX_SUCCESS;
+}
+
+/// Creates the curve build input of prepared curves.
+///
+/// The build input references OptixUtilPreparedCurves::vertexBuffer and OptixUtilPreparedCurves::widthBuffer, so
+/// prepared must stay alive and unchanged until the build is done.
+///
+/// \param[in,out] prepared       Prepared curves.
+/// \param[in]     vertexBuffer   Device copy of OptixUtilPreparedCurves::vertices.
+/// \param[in]     widthBuffer    Device copy of OptixUtilPreparedCurves::widths.
+/// \param[in]     indexBuffer    Device copy of OptixUtilPreparedCurves::indices.
+/// \param[in]     flag           Geometry flags of the single SBT record.
+/// \param[out]    buildInput     Build input.
+inline OptixResult optixUtilGetCurveBuildInput( OptixUtilPreparedCurves& prepared,
+                                                CUdeviceptr              vertexBuffer,
+                                                CUdeviceptr              widthBuffer,
+                                                CUdeviceptr              indexBuffer,
+                                                unsigned int             flag,
+                                                OptixBuildInput&         buildInput )
+{
+    if( vertexBuffer % 4 != 0 || widthBuffer % 4 != 0 || indexBuffer % 4 != 0 )
+        return OPTIX_ERROR_INVALID_VALUE;
+
+    prepared.vertexBuffer = vertexBuffer;
+    prepared.widthBuffer  = widthBuffer;
+
+    buildInput                        = OptixBuildInput();
+    buildInput.type                   = OPTIX_BUILD_INPUT_TYPE_CURVES;
+    OptixBuildInputCurveArray& curves = buildInput.curveArray;
+    curves.curveType                  = prepared.curveType;
+    curves.numPrimitives              = (unsigned int)prepared.indices.size();
+    curves.vertexBuffers              = &prepared.vertexBuffer;
+    curves.numVertices                = (unsigned int)prepared.widths.size();
+    curves.vertexStrideInBytes        = 3 * sizeof( float );
+    curves.widthBuffers               = &prepared.widthBuffer;
+    curves.widthStrideInBytes         = sizeof( float );
+    curves.indexBuffer                = indexBuffer;
+    curves.indexStrideInBytes         = sizeof( unsigned int );
+    curves.flag                       = flag;
+    return OPTIX_SUCCESS;
+}
+
+/*@}*/  // end group optix_utilities
+
+#endif  // __optix_optix_util_curve_prep_h__
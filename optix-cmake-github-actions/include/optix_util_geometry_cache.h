@@ -0,0 +1,985 @@
+/// @file
+/// @brief  OptiX host utilities: memory mapped geometry cache files
+///
+/// A geometry cache file stores the arrays that triangle, curve and custom primitive build inputs point to, in the
+/// layout the build inputs describe. A loaded file is used without parsing or copying:
+///
+/// - #OptixUtilGeometryCache maps the file and validates its header and geometry table,
+/// - the data region, i.e., everything after the table, is registered as pinned memory and uploaded with one copy,
+/// - #optixUtilGetCachedBuildInput() points the build inputs into the device copy of the data region. Geometry flags
+///   are host arrays and point into the mapping directly.
+///
+/// Layout, all integers little endian:
+///
+/// - #OptixUtilGeometryCacheHeader,
+/// - #OptixUtilCachedGeometry table,
+/// - data sections, each aligned to OPTIX_UTIL_GEOMETRY_CACHE_ALIGNMENT relative to the start of the file. Sections
+///   with one block per motion key align each block.
+///
+/// Header and table are covered by checksums that are checked on open. The data of each geometry has its own checksum,
+/// which #optixUtilVerifyGeometryCache() checks in parallel. It reads the whole file, so it is optional.
+
+#ifndef __optix_optix_util_geometry_cache_h__
+#define __optix_optix_util_geometry_cache_h__
+
+#include "optix_util_parallel.h"
+
+#include <optix_types.h>
+
+#include <algorithm>
+#include <cstddef>
+#include <cstdint>
+#include <cstdio>
+#include <cstring>
+#include <string>
+#include <vector>
+
+#ifdef _WIN32
+#ifndef WIN32_LEAN_AND_MEAN
+#define WIN32_LEAN_AND_MEAN 1
+#endif
+#ifndef NOMINMAX
+#define NOMINMAX 1
+#endif
+#include <windows.h>
+#else
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+/** \addtogroup optix_utilities
+@{
+*/
+
+/// Version of the geometry cache format written by #OptixUtilGeometryCacheWriter.
+#define OPTIX_UTIL_GEOMETRY_CACHE_VERSION 1u
+
+/// Alignment of data sections and motion key blocks in a geometry cache file.
+#define OPTIX_UTIL_GEOMETRY_CACHE_ALIGNMENT 64ull
+
+/// File header of a geometry cache.
+struct OptixUtilGeometryCacheHeader
+{
+    /// "OPXGEOC" followed by a zero byte.
+    char     magic[8];
+    uint32_t version;
+    uint32_t headerSize;
+    uint32_t geometrySize;
+    uint32_t numGeometries;
+    uint64_t geometryTableOffset;
+    uint64_t dataOffset;
+    uint64_t fileSize;
+    uint64_t tableChecksum;
+    /// Checksum of the preceding header bytes.
+    uint64_t headerChecksum;
+};
+
+/// Byte range of a geometry cache file.
+struct OptixUtilCacheRange
+{
+    uint64_t offset;
+    uint64_t size;
+};
+
+/// Geometry of a cache file. The members mirror the build input of the given type. Strides are never 0 in a file.
+struct OptixUtilCachedGeometry
+{
+    /// OPTIX_BUILD_INPUT_TYPE_TRIANGLES, OPTIX_BUILD_INPUT_TYPE_CURVES or OPTIX_BUILD_INPUT_TYPE_CUSTOM_PRIMITIVES.
+    uint32_t type;
+    /// Number of triangles, curve segments or AABBs.
+    uint32_t numPrimitives;
+    /// Number of vertices per motion key, for triangles and curves.
+    uint32_t numVertices;
+    /// Number of motion keys, at least 1.
+    uint32_t numMotionKeys;
+
+    /// OptixVertexFormat of triangles.
+    uint32_t vertexFormat;
+    uint32_t vertexStrideInBytes;
+    /// OptixIndicesFormat of triangles, OPTIX_INDICES_FORMAT_NONE for unindexed triangles.
+    uint32_t indexFormat;
+    uint32_t indexStrideInBytes;
+
+    /// OptixPrimitiveType of curves.
+    uint32_t curveType;
+    uint32_t widthStrideInBytes;
+    uint32_t aabbStrideInBytes;
+
+    /// Number of SBT records. Curves always use one.
+    uint32_t numSbtRecords;
+    /// Size of the per-primitive SBT index offsets, 0 if there are none.
+    uint32_t sbtIndexOffsetSizeInBytes;
+    uint32_t primitiveIndexOffset;
+
+    /// Vertices of triangles and curves, one block per motion key.
+    OptixUtilCacheRange vertices;
+    /// Index triplets of triangles, or the first vertex of each curve segment as unsigned int.
+    OptixUtilCacheRange indices;
+    OptixUtilCacheRange sbtIndexOffsets;
+    /// Widths of curves as float, one block per motion key.
+    OptixUtilCacheRange widths;
+    /// AABBs of custom primitives, one block per motion key.
+    OptixUtilCacheRange aabbs;
+    /// Geometry flags as unsigned int, one per SBT record.
+    OptixUtilCacheRange flags;
+
+    /// Checksum of the ranges above.
+    uint64_t checksum;
+    /// Application data, e.g., to map geometries back to scene objects.
+    uint64_t userData;
+};
+
+/// Host arrays of a geometry for #OptixUtilGeometryCacheWriter::addGeometry(). Each array has the layout given by the
+/// #OptixUtilCachedGeometry it is added with, and must stay alive until the cache is written.
+struct OptixUtilCacheSource
+{
+    /// Vertex array of each motion key.
+    const void* const* vertices;
+    const void*        indices;
+    const void*        sbtIndexOffsets;
+    /// Width array of each motion key.
+    const void* const* widths;
+    /// AABB array of each motion key.
+    const void* const* aabbs;
+    const unsigned int* flags;
+};
+
+namespace optix_util_impl {
+
+/// Checksums are computed over chunks of this size, which are hashed in parallel and then combined.
+const size_t CACHE_CHECKSUM_CHUNK_SIZE = 1u << 20;
+
+inline uint64_t rotateLeft( uint64_t x, int r )
+{
+    return ( x << r ) | ( x >> ( 64 - r ) );
+}
+
+inline uint64_t hashRound( uint64_t acc, uint64_t input )
+{
+    acc += input * 0xc2b2ae3d27d4eb4full;
+    return rotateLeft( acc, 31 ) * 0x9e3779b185ebca87ull;
+}
+
+/// 64-bit hash of a byte range with four independent lanes of multiply-rotate rounds, after xxHash64.
+inline uint64_t hashBytes( const void* data, size_t size, uint64_t seed )
+{
+    const unsigned char* p   = (const unsigned char*)data;
+    const unsigned char* end = p + size;
+    uint64_t             h;
+
+    if( size >= 32 )
+    {
+        uint64_t v[4] = {seed + 0x9e3779b185ebca87ull + 0xc2b2ae3d27d4eb4full, seed + 0xc2b2ae3d27d4eb4full, seed,
+                         seed - 0x9e3779b185ebca87ull};
+        for( ; p + 32 <= end; p += 32 )
+        {
+            for( int k = 0; k < 4; ++k )
+            {
+                uint64_t word;
+                std::memcpy( &word, p + 8 * k, 8 );
+                v[k] = hashRound( v[k], word );
+            }
+        }
+        h = rotateLeft( v[0], 1 ) + rotateLeft( v[1], 7 ) + rotateLeft( v[2], 12 ) + rotateLeft( v[3], 18 );
+        for( int k = 0; k < 4; ++k )
+            h = ( h ^ hashRound( 0, v[k] ) ) * 0x9e3779b185ebca87ull + 0x85ebca77c2b2ae63ull;
+    }
+    else
+    {
+        h = seed + 0x27d4eb2f165667c5ull;
+    }
+
+    h += (uint64_t)size;
+    for( ; p + 8 <= end; p += 8 )
+    {
+        uint64_t word;
+        std::memcpy( &word, p, 8 );
+        h = rotateLeft( h ^ hashRound( 0, word ), 27 ) * 0x9e3779b185ebca87ull + 0x85ebca77c2b2ae63ull;
+    }
+    for( ; p < end; ++p )
+        h = rotateLeft( h ^ ( *p * 0x27d4eb2f165667c5ull ), 11 ) * 0x9e3779b185ebca87ull;
+
+    h ^= h >> 33;
+    h *= 0xc2b2ae3d27d4eb4full;
+    h ^= h >> 29;
+    h *= 0x165667b19e3779f9ull;
+    return h ^ ( h >> 32 );
+}
+
+inline uint64_t alignCacheOffset( uint64_t offset )
+{
+    return ( offset + OPTIX_UTIL_GEOMETRY_CACHE_ALIGNMENT - 1 ) & ~( OPTIX_UTIL_GEOMETRY_CACHE_ALIGNMENT - 1 );
+}
+
+/// Byte size of one vertex of the given format, 0 for unknown formats.
+inline uint32_t cacheVertexSize( uint32_t format )
+{
+    switch( format )
+    {
+        case OPTIX_VERTEX_FORMAT_FLOAT3:
+            return 12;
+        case OPTIX_VERTEX_FORMAT_FLOAT2:
+            return 8;
+        case OPTIX_VERTEX_FORMAT_HALF3:
+        case OPTIX_VERTEX_FORMAT_SNORM16_3:
+            return 6;
+        case OPTIX_VERTEX_FORMAT_HALF2:
+        case OPTIX_VERTEX_FORMAT_SNORM16_2:
+            return 4;
+        default:
+            return 0;
+    }
+}
+
+/// Size of the blocks of a range with one block per motion key, and the distance between their starts.
+struct CacheKeyBlocks
+{
+    uint64_t blockSize;
+    uint64_t pitch;
+    uint64_t totalSize( uint32_t numKeys ) const { return blockSize ? pitch * ( numKeys - 1 ) + blockSize : 0; }
+};
+
+inline CacheKeyBlocks cacheKeyBlocks( uint64_t blockSize )
+{
+    CacheKeyBlocks blocks;
+    blocks.blockSize = blockSize;
+    blocks.pitch     = alignCacheOffset( blockSize );
+    return blocks;
+}
+
+/// Expected sizes of the ranges of a geometry. Returns false for inconsistent descriptions.
+struct CacheRangeSizes
+{
+    CacheKeyBlocks vertices;
+    uint64_t       indices;
+    uint64_t       sbtIndexOffsets;
+    CacheKeyBlocks widths;
+    CacheKeyBlocks aabbs;
+    uint64_t       flags;
+};
+
+inline bool cacheRangeSizes( const OptixUtilCachedGeometry& g, CacheRangeSizes& sizes )
+{
+    sizes = CacheRangeSizes();
+    if( g.numMotionKeys == 0 || g.numSbtRecords == 0 )
+        return false;
+    if( g.sbtIndexOffsetSizeInBytes != 0 && g.sbtIndexOffsetSizeInBytes != 1 && g.sbtIndexOffsetSizeInBytes != 2
+        && g.sbtIndexOffsetSizeInBytes != 4 )
+        return false;
+
+    switch( g.type )
+    {
+        case OPTIX_BUILD_INPUT_TYPE_TRIANGLES:
+        {
+            const uint32_t vertexSize = cacheVertexSize( g.vertexFormat );
+            if( !vertexSize || g.vertexStrideInBytes < vertexSize )
+                return false;
+            sizes.vertices = cacheKeyBlocks( (uint64_t)g.numVertices * g.vertexStrideInBytes );
+            if( g.indexFormat == OPTIX_INDICES_FORMAT_UNSIGNED_SHORT3
+                || g.indexFormat == OPTIX_INDICES_FORMAT_UNSIGNED_INT3 )
+            {
+                const uint32_t indexSize = g.indexFormat == OPTIX_INDICES_FORMAT_UNSIGNED_SHORT3 ? 6 : 12;
+                if( g.indexStrideInBytes < indexSize )
+                    return false;
+                sizes.indices = (uint64_t)g.numPrimitives * g.indexStrideInBytes;
+            }
+            else if( g.indexFormat != OPTIX_INDICES_FORMAT_NONE || (uint64_t)g.numPrimitives * 3 > g.numVertices )
+            {
+                return false;
+            }
+            break;
+        }
+        case OPTIX_BUILD_INPUT_TYPE_CURVES:
+            if( g.vertexStrideInBytes < 12 || g.widthStrideInBytes < 4 || g.indexStrideInBytes < 4
+                || g.numSbtRecords != 1 )
+                return false;
+            sizes.vertices = cacheKeyBlocks( (uint64_t)g.numVertices * g.vertexStrideInBytes );
+            sizes.widths   = cacheKeyBlocks( (uint64_t)g.numVertices * g.widthStrideInBytes );
+            sizes.indices  = (uint64_t)g.numPrimitives * g.indexStrideInBytes;
+            break;
+        case OPTIX_BUILD_INPUT_TYPE_CUSTOM_PRIMITIVES:
+            if( g.aabbStrideInBytes < sizeof( OptixAabb ) || g.aabbStrideInBytes % OPTIX_AABB_BUFFER_BYTE_ALIGNMENT )
+                return false;
+            sizes.aabbs = cacheKeyBlocks( (uint64_t)g.numPrimitives * g.aabbStrideInBytes );
+            break;
+        default:
+            return false;
+    }
+    if( g.numSbtRecords > 1 && g.sbtIndexOffsetSizeInBytes )
+        sizes.sbtIndexOffsets = (uint64_t)g.numPrimitives * g.sbtIndexOffsetSizeInBytes;
+    sizes.flags = (uint64_t)g.numSbtRecords * sizeof( unsigned int );
+    return true;
+}
+
+/// Total sizes of the ranges of a geometry, in the order of #cacheRanges().
+inline void cacheRangeTotals( const OptixUtilCachedGeometry& g, const CacheRangeSizes& sizes, uint64_t totals[6] )
+{
+    totals[0] = sizes.vertices.totalSize( g.numMotionKeys );
+    totals[1] = sizes.indices;
+    totals[2] = sizes.sbtIndexOffsets;
+    totals[3] = sizes.widths.totalSize( g.numMotionKeys );
+    totals[4] = sizes.aabbs.totalSize( g.numMotionKeys );
+    totals[5] = sizes.flags;
+}
+
+/// Ranges of a geometry in the order they are laid out and checksummed.
+inline void cacheRanges( const OptixUtilCachedGeometry& g, const OptixUtilCacheRange* ranges[6] )
+{
+    ranges[0] = &g.vertices;
+    ranges[1] = &g.indices;
+    ranges[2] = &g.sbtIndexOffsets;
+    ranges[3] = &g.widths;
+    ranges[4] = &g.aabbs;
+    ranges[5] = &g.flags;
+}
+
+/// Checksum chunk of a geometry: bytes [begin, end) of the file.
+struct CacheChunk
+{
+    uint32_t geometry;
+    uint64_t begin;
+    uint64_t end;
+};
+
+/// Splits the ranges of all geometries into checksum chunks, in checksum order.
+inline void cacheChunks( const OptixUtilCachedGeometry* geometries,
+                         uint32_t                       numGeometries,
+                         std::vector<CacheChunk>&       chunks )
+{
+    chunks.clear();
+    for( uint32_t i = 0; i < numGeometries; ++i )
+    {
+        const OptixUtilCacheRange* ranges[6];
+        cacheRanges( geometries[i], ranges );
+        for( const OptixUtilCacheRange* r : ranges )
+        {
+            const uint64_t end = r->offset + r->size;
+            for( uint64_t begin = r->offset; begin < end; begin += CACHE_CHECKSUM_CHUNK_SIZE )
+                chunks.push_back( {i, begin, std::min<uint64_t>( begin + CACHE_CHECKSUM_CHUNK_SIZE, end )} );
+        }
+    }
+}
+
+/// Combines the hashes of the chunks from #cacheChunks() into the data checksum of each geometry: the hash of the chunk
+/// hashes of the geometry.
+inline void combineChunkHashes( const std::vector<CacheChunk>& chunks,
+                                const uint64_t*                hashes,
+                                uint32_t                       numGeometries,
+                                uint64_t*                      checksums )
+{
+    size_t c = 0;
+    for( uint32_t i = 0; i < numGeometries; ++i )
+    {
+        size_t first = c;
+        while( c < chunks.size() && chunks[c].geometry == i )
+            ++c;
+        checksums[i] = hashBytes( hashes + first, ( c - first ) * sizeof( uint64_t ), i );
+    }
+}
+
+/// Computes the data checksum of each geometry of a file image. Chunks are hashed in parallel, and each checksum is
+/// the hash of the chunk hashes of its geometry, so the result does not depend on the thread count.
+inline void cacheChecksums( const unsigned char*           file,
+                            const OptixUtilCachedGeometry* geometries,
+                            uint32_t                       numGeometries,
+                            uint64_t*                      checksums,
+                            unsigned int                   maxThreads )
+{
+    std::vector<CacheChunk> chunks;
+    cacheChunks( geometries, numGeometries, chunks );
+    std::vector<uint64_t> hashes( chunks.size() );
+    optixUtilParallelFor( chunks.size(), 1,
+                          [&]( size_t first, size_t last ) {
+                              for( size_t c = first; c < last; ++c )
+                                  hashes[c] = hashBytes( file + chunks[c].begin, chunks[c].end - chunks[c].begin, 0 );
+                          },
+                          maxThreads );
+    combineChunkHashes( chunks, hashes.data(), numGeometries, checksums );
+}
+
+/// Maps the file at path read-only. Empty files cannot be mapped and give OPTIX_ERROR_FILE_IO_ERROR.
+inline OptixResult mapCacheFile( const char* path, const unsigned char*& data, size_t& size )
+{
+#ifdef _WIN32
+    HANDLE file =
+        CreateFileA( path, GENERIC_READ, FILE_SHARE_READ, nullptr, OPEN_EXISTING, FILE_ATTRIBUTE_NORMAL, nullptr );
+    if( file == INVALID_HANDLE_VALUE )
+        return OPTIX_ERROR_FILE_IO_ERROR;
+    LARGE_INTEGER fileSize;
+    HANDLE        mapping = nullptr;
+    if( GetFileSizeEx( file, &fileSize ) && fileSize.QuadPart > 0 )
+        mapping = CreateFileMappingA( file, nullptr, PAGE_READONLY, 0, 0, nullptr );
+    CloseHandle( file );
+    if( !mapping )
+        return OPTIX_ERROR_FILE_IO_ERROR;
+    void* view = MapViewOfFile( mapping, FILE_MAP_READ, 0, 0, 0 );
+    CloseHandle( mapping );
+    if( !view )
+        return OPTIX_ERROR_FILE_IO_ERROR;
+    size = (size_t)fileSize.QuadPart;
+#else
+    const int fd = ::open( path, O_RDONLY );
+    if( fd < 0 )
+        return OPTIX_ERROR_FILE_IO_ERROR;
+    struct stat status;
+    void*       view = MAP_FAILED;
+    if( fstat( fd, &status ) == 0 && status.st_size > 0 )
+        view = mmap( nullptr, (size_t)status.st_size, PROT_READ, MAP_PRIVATE, fd, 0 );
+    ::close( fd );
+    if( view == MAP_FAILED )
+        return OPTIX_ERROR_FILE_IO_ERROR;
+    size = (size_t)status.st_size;
+#endif
+    data = (const unsigned char*)view;
+    return OPTIX_SUCCESS;
+}
+
+inline void unmapCacheFile( const unsigned char* data, size_t size )
+{
+#ifdef _WIN32
+    (void)size;
+    UnmapViewOfFile( data );
+#else
+    munmap( (void*)data, size );
+#endif
+}
+
+inline uint64_t cacheHeaderChecksum( const OptixUtilGeometryCacheHeader& header )
+{
+    return hashBytes( &header, offsetof( OptixUtilGeometryCacheHeader, headerChecksum ), 0 );
+}
+
+/// Name of the temporary file that a cache file is written to before it is renamed.
+inline std::string cacheTempPath( const char* path )
+{
+#ifdef _WIN32
+    const unsigned long processId = GetCurrentProcessId();
+#else
+    const unsigned long processId = (unsigned long)getpid();
+#endif
+    return std::string( path ) + ".tmp." + std::to_string( processId );
+}
+
+/// Replaces the file at path by the file at tempPath.
+inline bool replaceCacheFile( const std::string& tempPath, const char* path )
+{
+#ifdef _WIN32
+    return MoveFileExA( tempPath.c_str(), path, MOVEFILE_REPLACE_EXISTING ) != 0;
+#else
+    return std::rename( tempPath.c_str(), path ) == 0;
+#endif
+}
+
+}  // namespace optix_util_impl
+
+/// Collects geometries and writes them as a geometry cache file.
+class OptixUtilGeometryCacheWriter
+{
+  public:
+    /// Adds a geometry. The ranges and the checksum of the description are ignored and computed on write. A stride of
+    /// 0 selects the size of one element. Returns the index of the geometry, or ~0u for invalid descriptions.
+    unsigned int addGeometry( const OptixUtilCachedGeometry& description, const OptixUtilCacheSource& source )
+    {
+        using namespace optix_util_impl;
+
+        OptixUtilCachedGeometry g = description;
+        if( g.type == OPTIX_BUILD_INPUT_TYPE_TRIANGLES )
+        {
+            if( !g.vertexStrideInBytes )
+                g.vertexStrideInBytes = cacheVertexSize( g.vertexFormat );
+            if( !g.indexStrideInBytes && g.indexFormat != OPTIX_INDICES_FORMAT_NONE )
+                g.indexStrideInBytes = g.indexFormat == OPTIX_INDICES_FORMAT_UNSIGNED_SHORT3 ? 6 : 12;
+        }
+        else if( g.type == OPTIX_BUILD_INPUT_TYPE_CURVES )
+        {
+            g.vertexStrideInBytes = g.vertexStrideInBytes ? g.vertexStrideInBytes : 12;
+            g.widthStrideInBytes  = g.widthStrideInBytes ? g.widthStrideInBytes : 4;
+            g.indexStrideInBytes  = g.indexStrideInBytes ? g.indexStrideInBytes : 4;
+        }
+        else if( g.type == OPTIX_BUILD_INPUT_TYPE_CUSTOM_PRIMITIVES )
+        {
+            g.aabbStrideInBytes = g.aabbStrideInBytes ? g.aabbStrideInBytes : sizeof( OptixAabb );
+        }
+
+        CacheRangeSizes sizes;
+        if( !cacheRangeSizes( g, sizes ) || !source.flags )
+            return ~0u;
+        if( ( sizes.vertices.blockSize && !source.vertices ) || ( sizes.indices && !source.indices )
+            || ( sizes.sbtIndexOffsets && !source.sbtIndexOffsets ) || ( sizes.widths.blockSize && !source.widths )
+            || ( sizes.aabbs.blockSize && !source.aabbs ) )
+            return ~0u;
+
+        m_geometries.push_back( g );
+        m_sources.push_back( source );
+        return (unsigned int)m_geometries.size() - 1;
+    }
+
+    /// Lays out the file and returns its size in bytes.
+    size_t computeLayout()
+    {
+        using namespace optix_util_impl;
+
+        uint64_t offset = alignCacheOffset( sizeof( OptixUtilGeometryCacheHeader ) )
+                          + m_geometries.size() * sizeof( OptixUtilCachedGeometry );
+        offset          = alignCacheOffset( offset );
+        m_dataOffset    = offset;
+        for( OptixUtilCachedGeometry& g : m_geometries )
+        {
+            CacheRangeSizes sizes;
+            cacheRangeSizes( g, sizes );
+            uint64_t rangeSizes[6];
+            cacheRangeTotals( g, sizes, rangeSizes );
+            OptixUtilCacheRange* ranges[6] = {&g.vertices, &g.indices, &g.sbtIndexOffsets,
+                                              &g.widths,   &g.aabbs,   &g.flags};
+            for( int r = 0; r < 6; ++r )
+            {
+                ranges[r]->offset = rangeSizes[r] ? offset : 0;
+                ranges[r]->size   = rangeSizes[r];
+                offset            = alignCacheOffset( offset + rangeSizes[r] );
+            }
+        }
+        m_fileSize = offset;
+        return (size_t)m_fileSize;
+    }
+
+    /// Writes the file image to dst, which holds computeLayout() bytes, e.g., a mapping of the output file. Sections
+    /// are copied and checksummed in parallel.
+    void serialize( void* dst, unsigned int maxThreads = 0 )
+    {
+        using namespace optix_util_impl;
+
+        unsigned char* file = (unsigned char*)dst;
+        std::memset( file, 0, (size_t)m_dataOffset );
+
+        // Copies of all blocks, run in parallel. Padding between sections is zeroed by each copy.
+        std::vector<Block> blocks;
+        dataBlocks( blocks );
+        optixUtilParallelFor( blocks.size(), 1,
+                              [&]( size_t first, size_t last ) {
+                                  for( size_t b = first; b < last; ++b )
+                                  {
+                                      const Block& block = blocks[b];
+                                      std::memcpy( file + block.offset, block.src, block.size );
+                                      std::memset( file + block.offset + block.size, 0,
+                                                   (size_t)alignCacheOffset( block.size ) - block.size );
+                                  }
+                              },
+                              maxThreads );
+
+        std::vector<uint64_t> checksums( m_geometries.size() );
+        cacheChecksums( file, m_geometries.data(), (uint32_t)m_geometries.size(), checksums.data(), maxThreads );
+        const OptixUtilGeometryCacheHeader header = finishHeader( checksums.data() );
+        std::memcpy( file, &header, sizeof( header ) );
+        if( !m_geometries.empty() )
+            std::memcpy( file + header.geometryTableOffset, m_geometries.data(),
+                         m_geometries.size() * sizeof( OptixUtilCachedGeometry ) );
+    }
+
+    /// Writes the cache file to path. The file holds the same bytes as the image from #serialize(), but is streamed:
+    /// the data region is assembled in batches of two checksum chunks per thread, which are filled and hashed in
+    /// parallel and then appended. Header and table follow once all checksums are known. The file is written to a
+    /// temporary file next to path and renamed, so readers never see a partial file.
+    OptixResult write( const char* path, unsigned int maxThreads = 0 )
+    {
+        using namespace optix_util_impl;
+
+        if( !path )
+            return OPTIX_ERROR_FILE_IO_ERROR;
+        computeLayout();
+        std::vector<Block> blocks;
+        dataBlocks( blocks );
+        std::vector<CacheChunk> chunks;
+        cacheChunks( m_geometries.data(), (uint32_t)m_geometries.size(), chunks );
+        std::vector<uint64_t> hashes( chunks.size() );
+
+        const std::string tempPath = cacheTempPath( path );
+        FILE*             file     = std::fopen( tempPath.c_str(), "wb" );
+        if( !file )
+            return OPTIX_ERROR_FILE_IO_ERROR;
+        const unsigned char zeros[OPTIX_UTIL_GEOMETRY_CACHE_ALIGNMENT] = {};
+        uint64_t            written                                   = 0;
+        auto                put = [&]( const void* data, uint64_t size, uint64_t padded ) {
+            bool ok = std::fwrite( data, 1, (size_t)size, file ) == size;
+            for( uint64_t pad = padded - size; ok && pad; pad -= std::min<uint64_t>( pad, sizeof( zeros ) ) )
+                ok = std::fwrite( zeros, 1, (size_t)std::min<uint64_t>( pad, sizeof( zeros ) ), file ) > 0;
+            written += padded;
+            return ok;
+        };
+
+        // Header and table are written last; until then their space holds zeros.
+        const size_t batchSize = 2 * (size_t)( maxThreads ? maxThreads : optixUtilGetDefaultThreadCount() );
+        std::vector<unsigned char> buffer( std::min( batchSize, chunks.size() ) * CACHE_CHECKSUM_CHUNK_SIZE );
+        bool                       ok = put( zeros, 0, m_dataOffset );
+        for( size_t batch = 0; batch < chunks.size() && ok; batch += batchSize )
+        {
+            const size_t count = std::min( batchSize, chunks.size() - batch );
+            optixUtilParallelFor( count, 1,
+                                  [&]( size_t first, size_t last ) {
+                                      for( size_t c = first; c < last; ++c )
+                                      {
+                                          const CacheChunk& chunk = chunks[batch + c];
+                                          unsigned char*    dst   = &buffer[c * CACHE_CHECKSUM_CHUNK_SIZE];
+                                          fillChunk( blocks, chunk, dst );
+                                          hashes[batch + c] = hashBytes( dst, chunk.end - chunk.begin, 0 );
+                                      }
+                                  },
+                                  maxThreads );
+            for( size_t c = 0; c < count && ok; ++c )
+            {
+                const CacheChunk& chunk = chunks[batch + c];
+                ok = put( zeros, 0, chunk.begin - written )
+                     && put( &buffer[c * CACHE_CHECKSUM_CHUNK_SIZE], chunk.end - chunk.begin, chunk.end - chunk.begin );
+            }
+        }
+        ok = ok && put( zeros, 0, m_fileSize - written ) && written == m_fileSize;
+
+        std::vector<uint64_t> checksums( m_geometries.size() );
+        combineChunkHashes( chunks, hashes.data(), (uint32_t)m_geometries.size(), checksums.data() );
+        const OptixUtilGeometryCacheHeader header = finishHeader( checksums.data() );
+        const uint64_t tableSize = m_geometries.size() * sizeof( OptixUtilCachedGeometry );
+        ok = ok && std::fseek( file, 0, SEEK_SET ) == 0;
+        ok = ok && put( &header, sizeof( header ), header.geometryTableOffset );
+        ok = ok && ( m_geometries.empty() || put( m_geometries.data(), tableSize, tableSize ) );
+        ok = std::fclose( file ) == 0 && ok;
+        if( !ok || !replaceCacheFile( tempPath, path ) )
+        {
+            std::remove( tempPath.c_str() );
+            return OPTIX_ERROR_FILE_IO_ERROR;
+        }
+        return OPTIX_SUCCESS;
+    }
+
+  private:
+    /// Source block of the data region: size bytes at offset in the file, followed by zeros up to the next aligned
+    /// offset.
+    struct Block
+    {
+        uint64_t             offset;
+        const unsigned char* src;
+        size_t               size;
+    };
+
+    /// Collects the blocks of all geometries in file order. Requires #computeLayout().
+    void dataBlocks( std::vector<Block>& blocks ) const
+    {
+        using namespace optix_util_impl;
+
+        blocks.clear();
+        auto addBlocks = [&]( const OptixUtilCacheRange& range, const CacheKeyBlocks& keyBlocks, uint32_t numKeys,
+                              const void* const* src ) {
+            for( uint32_t k = 0; k < numKeys && keyBlocks.blockSize; ++k )
+            {
+                Block block;
+                block.offset = range.offset + k * keyBlocks.pitch;
+                block.src    = (const unsigned char*)src[k];
+                block.size   = (size_t)keyBlocks.blockSize;
+                blocks.push_back( block );
+            }
+        };
+        for( size_t i = 0; i < m_geometries.size(); ++i )
+        {
+            const OptixUtilCachedGeometry& g = m_geometries[i];
+            const OptixUtilCacheSource&    s = m_sources[i];
+            CacheRangeSizes                sizes;
+            cacheRangeSizes( g, sizes );
+            addBlocks( g.vertices, sizes.vertices, g.numMotionKeys, s.vertices );
+            addBlocks( g.indices, cacheKeyBlocks( sizes.indices ), 1, &s.indices );
+            addBlocks( g.sbtIndexOffsets, cacheKeyBlocks( sizes.sbtIndexOffsets ), 1, &s.sbtIndexOffsets );
+            addBlocks( g.widths, sizes.widths, g.numMotionKeys, s.widths );
+            addBlocks( g.aabbs, sizes.aabbs, g.numMotionKeys, s.aabbs );
+            const void* flags = s.flags;
+            addBlocks( g.flags, cacheKeyBlocks( sizes.flags ), 1, &flags );
+        }
+    }
+
+    /// Writes bytes [chunk.begin, chunk.end) of the file image to dst: the parts of the blocks that overlap the chunk,
+    /// and zeros in between.
+    static void fillChunk( const std::vector<Block>&          blocks,
+                           const optix_util_impl::CacheChunk& chunk,
+                           unsigned char*                     dst )
+    {
+        std::memset( dst, 0, (size_t)( chunk.end - chunk.begin ) );
+        std::vector<Block>::const_iterator block =
+            std::upper_bound( blocks.begin(), blocks.end(), chunk.begin,
+                              []( uint64_t offset, const Block& b ) { return offset < b.offset; } );
+        if( block != blocks.begin() )
+            --block;
+        for( ; block != blocks.end() && block->offset < chunk.end; ++block )
+        {
+            const uint64_t begin = std::max( block->offset, chunk.begin );
+            const uint64_t end   = std::min( block->offset + block->size, chunk.end );
+            if( begin < end )
+                std::memcpy( dst + ( begin - chunk.begin ), block->src + ( begin - block->offset ),
+                             (size_t)( end - begin ) );
+        }
+    }
+
+    /// Stores the data checksums in the table and returns the header.
+    OptixUtilGeometryCacheHeader finishHeader( const uint64_t* checksums )
+    {
+        using namespace optix_util_impl;
+
+        for( size_t i = 0; i < m_geometries.size(); ++i )
+            m_geometries[i].checksum = checksums[i];
+
+        OptixUtilGeometryCacheHeader header = {};
+        std::memcpy( header.magic, "OPXGEOC", 8 );
+        header.version             = OPTIX_UTIL_GEOMETRY_CACHE_VERSION;
+        header.headerSize          = sizeof( OptixUtilGeometryCacheHeader );
+        header.geometrySize        = sizeof( OptixUtilCachedGeometry );
+        header.numGeometries       = (uint32_t)m_geometries.size();
+        header.geometryTableOffset = alignCacheOffset( sizeof( OptixUtilGeometryCacheHeader ) );
+        header.dataOffset          = m_dataOffset;
+        header.fileSize            = m_fileSize;
+        header.tableChecksum =
+            hashBytes( m_geometries.data(), m_geometries.size() * sizeof( OptixUtilCachedGeometry ), 0 );
+        header.headerChecksum = cacheHeaderChecksum( header );
+        return header;
+    }
+
+    std::vector<OptixUtilCachedGeometry> m_geometries;
+    std::vector<OptixUtilCacheSource>    m_sources;
+    uint64_t                             m_dataOffset = 0;
+    uint64_t                             m_fileSize   = 0;
+};
+
+/// Read-only view of a geometry cache file, either memory mapped or borrowed from the caller.
+class OptixUtilGeometryCache
+{
+  public:
+    OptixUtilGeometryCache() = default;
+    ~OptixUtilGeometryCache() { close(); }
+    OptixUtilGeometryCache( const OptixUtilGeometryCache& ) = delete;
+    OptixUtilGeometryCache& operator=( const OptixUtilGeometryCache& ) = delete;
+
+    /// Maps the file at path and validates it. Returns OPTIX_ERROR_FILE_IO_ERROR if the file cannot be mapped, and
+    /// OPTIX_ERROR_INVALID_FILE_FORMAT if it is not a valid cache of this version.
+    OptixResult open( const char* path )
+    {
+        close();
+        if( !path )
+            return OPTIX_ERROR_INVALID_VALUE;
+        const OptixResult mapResult = optix_util_impl::mapCacheFile( path, m_data, m_size );
+        if( mapResult != OPTIX_SUCCESS )
+            return mapResult;
+        m_mapped = true;
+
+        const OptixResult result = validate();
+        if( result != OPTIX_SUCCESS )
+            close();
+        return result;
+    }
+
+    /// Uses a file image in memory, which must stay alive while it is used. The image must be aligned to
+    /// OPTIX_UTIL_GEOMETRY_CACHE_ALIGNMENT.
+    OptixResult openMemory( const void* data, size_t size )
+    {
+        close();
+        if( !data || (uintptr_t)data % OPTIX_UTIL_GEOMETRY_CACHE_ALIGNMENT != 0 )
+            return OPTIX_ERROR_INVALID_VALUE;
+        m_data                   = (const unsigned char*)data;
+        m_size                   = size;
+        const OptixResult result = validate();
+        if( result != OPTIX_SUCCESS )
+            close();
+        return result;
+    }
+
+    void close()
+    {
+        if( m_mapped && m_data )
+            optix_util_impl::unmapCacheFile( m_data, m_size );
+        m_data   = nullptr;
+        m_size   = 0;
+        m_mapped = false;
+    }
+
+    bool         isOpen() const { return m_data != nullptr; }
+    unsigned int numGeometries() const { return m_data ? header().numGeometries : 0; }
+
+    const OptixUtilGeometryCacheHeader& header() const { return *(const OptixUtilGeometryCacheHeader*)m_data; }
+    const OptixUtilCachedGeometry&      geometry( unsigned int i ) const { return geometries()[i]; }
+
+    /// Host pointer to a range of the file, nullptr for empty ranges.
+    const void* data( const OptixUtilCacheRange& range ) const { return range.size ? m_data + range.offset : nullptr; }
+
+    /// The data region, which holds all ranges. Upload it in one copy for #optixUtilGetCachedBuildInput().
+    const void* dataRegion() const { return m_data ? m_data + header().dataOffset : nullptr; }
+    size_t      dataRegionSize() const { return m_data ? m_size - (size_t)header().dataOffset : 0; }
+
+  private:
+    const OptixUtilCachedGeometry* geometries() const
+    {
+        return (const OptixUtilCachedGeometry*)( m_data + header().geometryTableOffset );
+    }
+
+    OptixResult validate() const
+    {
+        using namespace optix_util_impl;
+
+        if( m_size < sizeof( OptixUtilGeometryCacheHeader ) )
+            return OPTIX_ERROR_INVALID_FILE_FORMAT;
+        const OptixUtilGeometryCacheHeader& h = header();
+        if( std::memcmp( h.magic, "OPXGEOC", 8 ) != 0 || h.version != OPTIX_UTIL_GEOMETRY_CACHE_VERSION
+            || h.headerSize != sizeof( OptixUtilGeometryCacheHeader )
+            || h.geometrySize != sizeof( OptixUtilCachedGeometry )
+            || h.headerChecksum != cacheHeaderChecksum( h ) || h.fileSize != m_size )
+            return OPTIX_ERROR_INVALID_FILE_FORMAT;
+
+        const uint64_t tableSize = (uint64_t)h.numGeometries * sizeof( OptixUtilCachedGeometry );
+        if( h.geometryTableOffset % OPTIX_UTIL_GEOMETRY_CACHE_ALIGNMENT || h.geometryTableOffset < h.headerSize
+            || h.geometryTableOffset + tableSize > h.dataOffset || h.dataOffset % OPTIX_UTIL_GEOMETRY_CACHE_ALIGNMENT
+            || h.dataOffset > m_size )
+            return OPTIX_ERROR_INVALID_FILE_FORMAT;
+        if( hashBytes( m_data + h.geometryTableOffset, (size_t)tableSize, 0 ) != h.tableChecksum )
+            return OPTIX_ERROR_INVALID_FILE_FORMAT;
+
+        for( unsigned int i = 0; i < h.numGeometries; ++i )
+        {
+            const OptixUtilCachedGeometry& g = geometries()[i];
+            CacheRangeSizes                sizes;
+            if( !cacheRangeSizes( g, sizes ) )
+                return OPTIX_ERROR_INVALID_FILE_FORMAT;
+            uint64_t expected[6];
+            cacheRangeTotals( g, sizes, expected );
+            const OptixUtilCacheRange* ranges[6];
+            cacheRanges( g, ranges );
+            for( int r = 0; r < 6; ++r )
+            {
+                if( ranges[r]->size != expected[r] )
+                    return OPTIX_ERROR_INVALID_FILE_FORMAT;
+                if( ranges[r]->size
+                    && ( ranges[r]->offset % OPTIX_UTIL_GEOMETRY_CACHE_ALIGNMENT || ranges[r]->offset < h.dataOffset
+                         || ranges[r]->offset > m_size || ranges[r]->size > m_size - ranges[r]->offset ) )
+                    return OPTIX_ERROR_INVALID_FILE_FORMAT;
+            }
+        }
+        return OPTIX_SUCCESS;
+    }
+
+    const unsigned char* m_data   = nullptr;
+    size_t               m_size   = 0;
+    bool                 m_mapped = false;
+
+    friend OptixResult optixUtilVerifyGeometryCache( const OptixUtilGeometryCache& cache, unsigned int maxThreads );
+};
+
+/// Checks the data checksums of all geometries of an open cache. Reads the whole data region in parallel. Returns
+/// OPTIX_ERROR_DISK_CACHE_INVALID_DATA on a mismatch.
+///
+/// \param[in] cache        Open cache.
+/// \param[in] maxThreads   Upper bound on the number of threads, 0 for #optixUtilGetDefaultThreadCount().
+inline OptixResult optixUtilVerifyGeometryCache( const OptixUtilGeometryCache& cache, unsigned int maxThreads = 0 )
+{
+    if( !cache.isOpen() )
+        return OPTIX_ERROR_INVALID_VALUE;
+    const unsigned int    n = cache.numGeometries();
+    std::vector<uint64_t> checksums( n );
+    optix_util_impl::cacheChecksums( cache.m_data, cache.geometries(), n, checksums.data(), maxThreads );
+    for( unsigned int i = 0; i < n; ++i )
+        if( checksums[i] != cache.geometry( i ).checksum )
+            return OPTIX_ERROR_DISK_CACHE_INVALID_DATA;
+    return OPTIX_SUCCESS;
+}
+
+/// Device pointer arrays referenced by a build input from #optixUtilGetCachedBuildInput(). Must stay alive until the
+/// build is done.
+struct OptixUtilCachedBuildInputStorage
+{
+    std::vector<CUdeviceptr> vertexBuffers;
+    std::vector<CUdeviceptr> widthBuffers;
+    std::vector<CUdeviceptr> aabbBuffers;
+};
+
+/// Creates the build input of a cached geometry.
+///
+/// \param[in]  cache        Open cache, which must stay open until the build is done since the geometry flags point
+///                          into it.
+/// \param[in]  i            Geometry index.
+/// \param[in]  dataBuffer   Device copy of the data region of the cache, aligned to
+///                          OPTIX_UTIL_GEOMETRY_CACHE_ALIGNMENT.
+/// \param[out] storage      Device pointer arrays of the build input.
+/// \param[out] buildInput   Build input.
+inline OptixResult optixUtilGetCachedBuildInput( const OptixUtilGeometryCache&     cache,
+                                                 unsigned int                      i,
+                                                 CUdeviceptr                       dataBuffer,
+                                                 OptixUtilCachedBuildInputStorage& storage,
+                                                 OptixBuildInput&                  buildInput )
+{
+    using namespace optix_util_impl;
+
+    if( i >= cache.numGeometries() || dataBuffer % OPTIX_UTIL_GEOMETRY_CACHE_ALIGNMENT != 0 )
+        return OPTIX_ERROR_INVALID_VALUE;
+
+    const OptixUtilCachedGeometry& g    = cache.geometry( i );
+    const uint64_t                 base = cache.header().dataOffset;
+    CacheRangeSizes                sizes;
+    cacheRangeSizes( g, sizes );
+    auto device = [&]( const OptixUtilCacheRange& range ) -> CUdeviceptr {
+        return range.size ? dataBuffer + ( range.offset - base ) : 0;
+    };
+    auto keys = [&]( const OptixUtilCacheRange& range, const CacheKeyBlocks& blocks, std::vector<CUdeviceptr>& out ) {
+        out.resize( g.numMotionKeys );
+        for( uint32_t k = 0; k < g.numMotionKeys; ++k )
+            out[k] = range.size ? device( range ) + k * blocks.pitch : 0;
+    };
+    const unsigned int* flags = (const unsigned int*)cache.data( g.flags );
+
+    buildInput      = OptixBuildInput();
+    buildInput.type = (OptixBuildInputType)g.type;
+    if( g.type == OPTIX_BUILD_INPUT_TYPE_TRIANGLES )
+    {
+        keys( g.vertices, sizes.vertices, storage.vertexBuffers );
+        OptixBuildInputTriangleArray& t = buildInput.triangleArray;
+        t.vertexBuffers                 = storage.vertexBuffers.data();
+        t.numVertices                   = g.numVertices;
+        t.vertexFormat                  = (OptixVertexFormat)g.vertexFormat;
+        t.vertexStrideInBytes           = g.vertexStrideInBytes;
+        t.indexBuffer                   = device( g.indices );
+        t.numIndexTriplets              = g.indexFormat != OPTIX_INDICES_FORMAT_NONE ? g.numPrimitives : 0;
+        t.indexFormat                   = (OptixIndicesFormat)g.indexFormat;
+        t.indexStrideInBytes            = g.indexStrideInBytes;
+        t.flags                         = flags;
+        t.numSbtRecords                 = g.numSbtRecords;
+        t.sbtIndexOffsetBuffer          = device( g.sbtIndexOffsets );
+        t.sbtIndexOffsetSizeInBytes     = t.sbtIndexOffsetBuffer ? g.sbtIndexOffsetSizeInBytes : 0;
+        t.primitiveIndexOffset          = g.primitiveIndexOffset;
+    }
+    else if( g.type == OPTIX_BUILD_INPUT_TYPE_CURVES )
+    {
+        keys( g.vertices, sizes.vertices, storage.vertexBuffers );
+        keys( g.widths, sizes.widths, storage.widthBuffers );
+        OptixBuildInputCurveArray& c = buildInput.curveArray;
+        c.curveType                  = (OptixPrimitiveType)g.curveType;
+        c.numPrimitives              = g.numPrimitives;
+        c.vertexBuffers              = storage.vertexBuffers.data();
+        c.numVertices                = g.numVertices;
+        c.vertexStrideInBytes        = g.vertexStrideInBytes;
+        c.widthBuffers               = storage.widthBuffers.data();
+        c.widthStrideInBytes         = g.widthStrideInBytes;
+        c.indexBuffer                = device( g.indices );
+        c.indexStrideInBytes         = g.indexStrideInBytes;
+        c.flag                       = flags[0];
+        c.primitiveIndexOffset       = g.primitiveIndexOffset;
+    }
+    else
+    {
+        keys( g.aabbs, sizes.aabbs, storage.aabbBuffers );
+        OptixBuildInputCustomPrimitiveArray& a = buildInput.customPrimitiveArray;
+        a.aabbBuffers                          = storage.aabbBuffers.data();
+        a.numPrimitives                        = g.numPrimitives;
+        a.strideInBytes                        = g.aabbStrideInBytes;
+        a.flags                                = flags;
+        a.numSbtRecords                        = g.numSbtRecords;
+        a.sbtIndexOffsetBuffer                 = device( g.sbtIndexOffsets );
+        a.sbtIndexOffsetSizeInBytes            = a.sbtIndexOffsetBuffer ? g.sbtIndexOffsetSizeInBytes : 0;
+        a.primitiveIndexOffset                 = g.primitiveIndexOffset;
+    }
+    return OPTIX_SUCCESS;
+}
+
+/*@}*/  // end group optix_utilities
+
+#endif  // __optix_optix_util_geometry_cache_h__
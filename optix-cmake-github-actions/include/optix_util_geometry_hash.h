@@ -0,0 +1,500 @@
+/// @file
+/// @brief  OptiX host utilities: content hashing and deduplication of GAS builds
+///
+/// Scenes often contain identical meshes that were imported separately. #optixUtilDeduplicateGeometry() hashes the
+/// host copies of the build inputs of a batch of builds, i.e., vertices, indices, pre-transforms, widths, normals,
+/// AABBs, SBT index offsets and geometry flags, and maps each build to the first identical one. Only these
+/// representatives need to be built. Instances of a duplicate reference the GAS of its representative.
+///
+/// Hashing is streaming and parallel: every array is split into fixed-size chunks that are hashed independently with
+/// an AVX2 or scalar kernel, and the chunk hashes are combined in order. Results do not depend on the thread count or
+/// the instruction set. The hash of a build is its #optixUtilComputeAccelCacheKey(), with the combined chunk hashes as
+/// content hash, so it can also be used to look up the build in an accel cache.
+
+#ifndef __optix_optix_util_geometry_hash_h__
+#define __optix_optix_util_geometry_hash_h__
+
+#include "optix_util_accel_cache.h"
+#include "optix_util_parallel.h"
+#include "optix_util_simd.h"
+
+#include <optix_types.h>
+
+#include <algorithm>
+#include <chrono>
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+#include <unordered_map>
+#include <vector>
+
+/** \addtogroup optix_utilities
+@{
+*/
+
+/// Options of #optixUtilDeduplicateGeometry().
+struct OptixUtilGeometryHashOptions
+{
+    /// Compares the data of each duplicate with its representative, so that a hash collision never merges different
+    /// geometry. Colliding builds stay separate. Reads the data of all duplicates a second time.
+    int verifyDuplicates;
+
+    /// Build throughput in primitives per second, e.g., from a previous #OptixUtilGasBatchReport, used to estimate the
+    /// build time saved. 0 skips the estimate.
+    double buildPrimitivesPerSecond;
+};
+
+/// Result of #optixUtilDeduplicateGeometry().
+struct OptixUtilGeometryDedupReport
+{
+    unsigned int numBuilds;
+    unsigned int numUniqueBuilds;
+    /// Builds with equal hashes but different data, only detected with verifyDuplicates.
+    unsigned int numCollisions;
+    /// Primitives of all builds, and of the duplicates.
+    size_t numPrimitives;
+    size_t numPrimitivesSaved;
+    /// Bytes of input data of all builds, and of the duplicates.
+    size_t inputBytes;
+    size_t inputBytesSaved;
+    /// Output and temp bytes of the duplicates, if buffer sizes were passed.
+    size_t outputBytesSaved;
+    size_t tempBytesSaved;
+    /// Estimated with OptixUtilGeometryHashOptions::buildPrimitivesPerSecond, 0 without it.
+    double buildSecondsSaved;
+    /// Host time of the call and hashing throughput over inputBytes.
+    double seconds;
+    double bytesPerSecond;
+};
+
+namespace optix_util_impl {
+
+/// Bytes per independently hashed chunk. Fixed, so hashes do not depend on the thread count.
+const size_t GEOMETRY_HASH_CHUNK_SIZE = 1u << 20;
+
+/// Stripes of 64 bytes between accumulator scrambles.
+const size_t GEOMETRY_HASH_STRIPES_PER_BLOCK = 16;
+
+const uint64_t GEOMETRY_HASH_KEYS[8] = {0xbe4ba423396cfeb8ull, 0x1cad21f72c81017cull, 0xdb979083e96dd4deull,
+                                        0x1f67b3b7a4a44072ull, 0x78e5c0cc4ee679cbull, 0x2172ffcc7dd05a82ull,
+                                        0x8e2443f7744608b8ull, 0x4c263a81e69035e0ull};
+
+const uint64_t GEOMETRY_HASH_SCRAMBLE_KEYS[8] = {0xcb00c391bb52283cull, 0xa32e531b8b65d088ull, 0x4ef90da297486471ull,
+                                                 0xd8acdea946ef1938ull, 0x3f349ce33f76faa8ull, 0x1d4f0bc7c7bbdcf9ull,
+                                                 0x3159b4cd4be0518aull, 0x647378d9c97e9fc8ull};
+
+/// Strided array of a build input, in host memory.
+struct HashArray
+{
+    const unsigned char* data;
+    size_t               count;
+    size_t               elementSize;
+    size_t               stride;
+};
+
+/// Element range [begin, end) of an array, hashed as one unit.
+struct HashChunk
+{
+    unsigned int array;
+    size_t       begin;
+    size_t       end;
+};
+
+/// Accumulates the 64-byte stripes [0, numStripes) of p, after the XXH3 accumulation: each 64-bit lane adds the
+/// product of the low and high halves of the keyed word, and the word itself to the neighbouring lane.
+inline void hashStripesScalar( uint64_t acc[8], const unsigned char* p, size_t numStripes )
+{
+    for( size_t s = 0; s < numStripes; ++s, p += 64 )
+    {
+        for( int j = 0; j < 8; ++j )
+        {
+            uint64_t word;
+            std::memcpy( &word, p + 8 * j, 8 );
+            const uint64_t keyed = word ^ GEOMETRY_HASH_KEYS[j];
+            acc[j ^ 1] += word;
+            acc[j] += ( keyed & 0xffffffffull ) * ( keyed >> 32 );
+        }
+    }
+}
+
+inline void scrambleAccumulatorsScalar( uint64_t acc[8] )
+{
+    for( int j = 0; j < 8; ++j )
+        acc[j] = ( acc[j] ^ ( acc[j] >> 47 ) ^ GEOMETRY_HASH_SCRAMBLE_KEYS[j] ) * 0x9e3779b1ull;
+}
+
+#if OPTIX_UTIL_SIMD_X86
+OPTIX_UTIL_TARGET_AVX2 inline __m256i hashAccumulateAvx2( __m256i acc, __m256i word, __m256i key )
+{
+    const __m256i keyed   = _mm256_xor_si256( word, key );
+    const __m256i product = _mm256_mul_epu32( keyed, _mm256_srli_epi64( keyed, 32 ) );
+    const __m256i swapped = _mm256_shuffle_epi32( word, _MM_SHUFFLE( 1, 0, 3, 2 ) );
+    return _mm256_add_epi64( acc, _mm256_add_epi64( product, swapped ) );
+}
+
+/// 64-bit multiply by a 32-bit constant, from two 32x32 bit products.
+OPTIX_UTIL_TARGET_AVX2 inline __m256i hashScrambleAvx2( __m256i acc, __m256i key )
+{
+    const __m256i prime = _mm256_set1_epi64x( 0x9e3779b1ll );
+    acc                 = _mm256_xor_si256( _mm256_xor_si256( acc, _mm256_srli_epi64( acc, 47 ) ), key );
+    const __m256i low   = _mm256_mul_epu32( acc, prime );
+    const __m256i high  = _mm256_mul_epu32( _mm256_srli_epi64( acc, 32 ), prime );
+    return _mm256_add_epi64( low, _mm256_slli_epi64( high, 32 ) );
+}
+
+/// AVX2 version of hashStripesScalar() followed by scrambleAccumulatorsScalar() for whole blocks, with the same result.
+OPTIX_UTIL_TARGET_AVX2 inline void hashBlocksAvx2( uint64_t acc[8], const unsigned char* p, size_t numBlocks )
+{
+    __m256i       a0 = _mm256_loadu_si256( (const __m256i*)acc );
+    __m256i       a1 = _mm256_loadu_si256( (const __m256i*)( acc + 4 ) );
+    const __m256i k0 = _mm256_loadu_si256( (const __m256i*)GEOMETRY_HASH_KEYS );
+    const __m256i k1 = _mm256_loadu_si256( (const __m256i*)( GEOMETRY_HASH_KEYS + 4 ) );
+    const __m256i s0 = _mm256_loadu_si256( (const __m256i*)GEOMETRY_HASH_SCRAMBLE_KEYS );
+    const __m256i s1 = _mm256_loadu_si256( (const __m256i*)( GEOMETRY_HASH_SCRAMBLE_KEYS + 4 ) );
+
+    for( size_t b = 0; b < numBlocks; ++b )
+    {
+        for( size_t s = 0; s < GEOMETRY_HASH_STRIPES_PER_BLOCK; ++s, p += 64 )
+        {
+            a0 = hashAccumulateAvx2( a0, _mm256_loadu_si256( (const __m256i*)p ), k0 );
+            a1 = hashAccumulateAvx2( a1, _mm256_loadu_si256( (const __m256i*)( p + 32 ) ), k1 );
+        }
+        a0 = hashScrambleAvx2( a0, s0 );
+        a1 = hashScrambleAvx2( a1, s1 );
+    }
+    _mm256_storeu_si256( (__m256i*)acc, a0 );
+    _mm256_storeu_si256( (__m256i*)( acc + 4 ), a1 );
+}
+#endif
+
+/// Streaming hash of a byte sequence. Whole blocks are hashed in place, the remainder is buffered.
+class GeometryHasher
+{
+  public:
+    GeometryHasher( uint64_t seed, OptixUtilSimdIsa isa )
+        : m_isa( isa )
+    {
+        for( int j = 0; j < 8; ++j )
+            m_acc[j] = GEOMETRY_HASH_KEYS[j] + seed * ( 2 * j + 1 );
+    }
+
+    void update( const void* data, size_t size )
+    {
+        const unsigned char* p = (const unsigned char*)data;
+        m_length += size;
+        if( m_buffered )
+        {
+            const size_t n = std::min( size, BLOCK_BYTES - m_buffered );
+            std::memcpy( m_buffer + m_buffered, p, n );
+            m_buffered += n;
+            p += n;
+            size -= n;
+            if( m_buffered < BLOCK_BYTES )
+                return;
+            hashBlocks( m_buffer, 1 );
+            m_buffered = 0;
+        }
+        const size_t numBlocks = size / BLOCK_BYTES;
+        hashBlocks( p, numBlocks );
+        p += numBlocks * BLOCK_BYTES;
+        size -= numBlocks * BLOCK_BYTES;
+        std::memcpy( m_buffer, p, size );
+        m_buffered = size;
+    }
+
+    uint64_t digest() const
+    {
+        uint64_t acc[8];
+        std::memcpy( acc, m_acc, sizeof( acc ) );
+        const size_t numStripes = m_buffered / 64;
+        hashStripesScalar( acc, m_buffer, numStripes );
+        if( m_buffered % 64 )
+        {
+            unsigned char last[64] = {};
+            std::memcpy( last, m_buffer + numStripes * 64, m_buffered % 64 );
+            hashStripesScalar( acc, last, 1 );
+        }
+        return hashBytes( acc, sizeof( acc ), m_length );
+    }
+
+  private:
+    static const size_t BLOCK_BYTES = 64 * GEOMETRY_HASH_STRIPES_PER_BLOCK;
+
+    void hashBlocks( const unsigned char* p, size_t numBlocks )
+    {
+#if OPTIX_UTIL_SIMD_X86
+        if( m_isa >= OPTIX_UTIL_SIMD_ISA_AVX2 )
+        {
+            hashBlocksAvx2( m_acc, p, numBlocks );
+            return;
+        }
+#endif
+        for( size_t b = 0; b < numBlocks; ++b, p += BLOCK_BYTES )
+        {
+            hashStripesScalar( m_acc, p, GEOMETRY_HASH_STRIPES_PER_BLOCK );
+            scrambleAccumulatorsScalar( m_acc );
+        }
+    }
+
+    OptixUtilSimdIsa m_isa;
+    uint64_t         m_acc[8];
+    uint64_t         m_length   = 0;
+    size_t           m_buffered = 0;
+    unsigned char    m_buffer[BLOCK_BYTES];
+};
+
+/// Hashes the elements of a chunk. Dense arrays are hashed in place, strided ones are gathered first.
+inline uint64_t hashChunk( const HashArray& array, const HashChunk& chunk, uint64_t seed, OptixUtilSimdIsa isa )
+{
+    GeometryHasher hasher( seed, isa );
+    if( array.stride == array.elementSize )
+    {
+        hasher.update( array.data + chunk.begin * array.stride, ( chunk.end - chunk.begin ) * array.elementSize );
+        return hasher.digest();
+    }
+    unsigned char gathered[16384];
+    const size_t  perGather = std::max<size_t>( sizeof( gathered ) / array.elementSize, 1 );
+    for( size_t i = chunk.begin; i < chunk.end; )
+    {
+        const size_t n = std::min( perGather, chunk.end - i );
+        if( array.elementSize > sizeof( gathered ) )
+        {
+            hasher.update( array.data + i * array.stride, array.elementSize );
+        }
+        else
+        {
+            for( size_t e = 0; e < n; ++e )
+                std::memcpy( gathered + e * array.elementSize, array.data + ( i + e ) * array.stride,
+                             array.elementSize );
+            hasher.update( gathered, n * array.elementSize );
+        }
+        i += n;
+    }
+    return hasher.digest();
+}
+
+inline bool hashArraysEqual( const HashArray& a, const HashArray& b )
+{
+    if( a.count != b.count || a.elementSize != b.elementSize )
+        return false;
+    if( a.stride == a.elementSize && b.stride == b.elementSize )
+        return !a.count || std::memcmp( a.data, b.data, a.count * a.elementSize ) == 0;
+    for( size_t i = 0; i < a.count; ++i )
+        if( std::memcmp( a.data + i * a.stride, b.data + i * b.stride, a.elementSize ) != 0 )
+            return false;
+    return true;
+}
+
+inline void addHashArray( std::vector<HashArray>& arrays, CUdeviceptr data, size_t count, size_t elementSize,
+                          size_t stride )
+{
+    if( data && count && elementSize )
+        arrays.push_back( {(const unsigned char*)(uintptr_t)data, count, elementSize, stride ? stride : elementSize} );
+}
+
+/// Collects the data arrays of a build input in host memory. Returns false for inputs with missing arrays or unknown
+/// formats. Geometry flags are covered by the layout hash of the cache key.
+inline bool collectHashArrays( const OptixBuildInput& input,
+                               unsigned int           numMotionKeys,
+                               std::vector<HashArray>& arrays,
+                               size_t&                 numPrimitives )
+{
+    if( input.type == OPTIX_BUILD_INPUT_TYPE_TRIANGLES )
+    {
+        const OptixBuildInputTriangleArray& t          = input.triangleArray;
+        const size_t                        vertexSize = cacheVertexSize( t.vertexFormat );
+        if( t.numVertices && ( !vertexSize || !t.vertexBuffers ) )
+            return false;
+        for( unsigned int k = 0; k < numMotionKeys && t.numVertices; ++k )
+            addHashArray( arrays, t.vertexBuffers[k], t.numVertices, vertexSize, t.vertexStrideInBytes );
+        const size_t indexSize = t.indexFormat == OPTIX_INDICES_FORMAT_UNSIGNED_SHORT3 ? 6
+                                 : t.indexFormat == OPTIX_INDICES_FORMAT_UNSIGNED_INT3 ? 12 : 0;
+        addHashArray( arrays, t.indexBuffer, t.numIndexTriplets, indexSize, t.indexStrideInBytes );
+        addHashArray( arrays, t.preTransform, 1, 12 * sizeof( float ), 0 );
+        numPrimitives = indexSize ? t.numIndexTriplets : t.numVertices / 3;
+        if( t.numSbtRecords > 1 )
+            addHashArray( arrays, t.sbtIndexOffsetBuffer, numPrimitives, t.sbtIndexOffsetSizeInBytes,
+                          t.sbtIndexOffsetStrideInBytes );
+    }
+    else if( input.type == OPTIX_BUILD_INPUT_TYPE_CURVES )
+    {
+        const OptixBuildInputCurveArray& c = input.curveArray;
+        if( c.numVertices && ( !c.vertexBuffers || !c.widthBuffers ) )
+            return false;
+        for( unsigned int k = 0; k < numMotionKeys && c.numVertices; ++k )
+        {
+            addHashArray( arrays, c.vertexBuffers[k], c.numVertices, 3 * sizeof( float ), c.vertexStrideInBytes );
+            addHashArray( arrays, c.widthBuffers[k], c.numVertices, sizeof( float ), c.widthStrideInBytes );
+            if( c.normalBuffers )
+                addHashArray( arrays, c.normalBuffers[k], c.numVertices, 3 * sizeof( float ), c.normalStrideInBytes );
+        }
+        addHashArray( arrays, c.indexBuffer, c.numPrimitives, sizeof( unsigned int ), c.indexStrideInBytes );
+        numPrimitives = c.numPrimitives;
+    }
+    else if( input.type == OPTIX_BUILD_INPUT_TYPE_CUSTOM_PRIMITIVES )
+    {
+        const OptixBuildInputCustomPrimitiveArray& p = input.customPrimitiveArray;
+        if( p.numPrimitives && !p.aabbBuffers )
+            return false;
+        for( unsigned int k = 0; k < numMotionKeys && p.numPrimitives; ++k )
+            addHashArray( arrays, p.aabbBuffers[k], p.numPrimitives, sizeof( OptixAabb ), p.strideInBytes );
+        if( p.numSbtRecords > 1 )
+            addHashArray( arrays, p.sbtIndexOffsetBuffer, p.numPrimitives, p.sbtIndexOffsetSizeInBytes,
+                          p.sbtIndexOffsetStrideInBytes );
+        numPrimitives = p.numPrimitives;
+    }
+    else
+    {
+        return false;
+    }
+    return true;
+}
+
+}  // namespace optix_util_impl
+
+/// Hashes a batch of GAS builds and maps each build to the first build with identical inputs.
+///
+/// The build inputs describe host copies of the data: their CUdeviceptr members hold host addresses. Instance build
+/// inputs are not supported.
+///
+/// \param[in]  hostRequests      Builds, with build inputs in host memory.
+/// \param[in]  numBuilds         Number of builds.
+/// \param[in]  options           Options.
+/// \param[out] representatives   For each build, the index of the first identical build, which is the build itself
+///                               for unique builds.
+/// \param[out] keys              Optional hash of each build, see #optixUtilComputeAccelCacheKey().
+/// \param[in]  sizes             Optional buffer sizes of each build, for the saved bytes in the report.
+/// \param[out] report            Optional deduplication result.
+/// \param[in]  maxThreads        Upper bound on the number of threads, 0 for #optixUtilGetDefaultThreadCount().
+/// \param[in]  isa               Instruction set to use, see #optixUtilSelectSimdIsa().
+inline OptixResult optixUtilDeduplicateGeometry( const OptixUtilAccelBuildRequest*   hostRequests,
+                                                 unsigned int                        numBuilds,
+                                                 const OptixUtilGeometryHashOptions& options,
+                                                 unsigned int*                       representatives,
+                                                 uint64_t*                           keys       = nullptr,
+                                                 const OptixAccelBufferSizes*        sizes      = nullptr,
+                                                 OptixUtilGeometryDedupReport*       report     = nullptr,
+                                                 unsigned int                        maxThreads = 0,
+                                                 OptixUtilSimdIsa                    isa = OPTIX_UTIL_SIMD_ISA_AUTO )
+{
+    using namespace optix_util_impl;
+
+    if( numBuilds && ( !hostRequests || !representatives ) )
+        return OPTIX_ERROR_INVALID_VALUE;
+    const auto             start    = std::chrono::steady_clock::now();
+    const OptixUtilSimdIsa selected = optixUtilSelectSimdIsa( isa );
+
+    // Arrays of all builds, and the first array of each build.
+    std::vector<HashArray>    arrays;
+    std::vector<size_t>       firstArray( numBuilds + 1 );
+    std::vector<size_t>       primitives( numBuilds, 0 );
+    OptixUtilGeometryDedupReport dedupReport = {};
+    for( unsigned int b = 0; b < numBuilds; ++b )
+    {
+        const OptixUtilAccelBuildRequest& request = hostRequests[b];
+        if( !request.options || ( request.numBuildInputs && !request.buildInputs ) )
+            return OPTIX_ERROR_INVALID_VALUE;
+        const unsigned int numMotionKeys = std::max<unsigned int>( request.options->motionOptions.numKeys, 1 );
+        firstArray[b]                    = arrays.size();
+        for( unsigned int i = 0; i < request.numBuildInputs; ++i )
+        {
+            size_t numPrimitives = 0;
+            if( !collectHashArrays( request.buildInputs[i], numMotionKeys, arrays, numPrimitives ) )
+                return OPTIX_ERROR_INVALID_VALUE;
+            primitives[b] += numPrimitives;
+        }
+    }
+    firstArray[numBuilds] = arrays.size();
+
+    // Chunks of all arrays, hashed in parallel.
+    std::vector<HashChunk> chunks;
+    std::vector<size_t>    firstChunk( arrays.size() + 1 );
+    for( size_t a = 0; a < arrays.size(); ++a )
+    {
+        firstChunk[a]               = chunks.size();
+        const size_t perChunk       = std::max<size_t>( GEOMETRY_HASH_CHUNK_SIZE / arrays[a].elementSize, 1 );
+        for( size_t begin = 0; begin < arrays[a].count; begin += perChunk )
+            chunks.push_back( {(unsigned int)a, begin, std::min( begin + perChunk, arrays[a].count )} );
+        dedupReport.inputBytes += arrays[a].count * arrays[a].elementSize;
+    }
+    firstChunk[arrays.size()] = chunks.size();
+    std::vector<uint64_t> chunkHashes( chunks.size() );
+    optixUtilParallelFor( chunks.size(), 1,
+                          [&]( size_t first, size_t last ) {
+                              // Chunks are seeded with their index within the array.
+                              for( size_t c = first; c < last; ++c )
+                              {
+                                  const unsigned int a = chunks[c].array;
+                                  chunkHashes[c]       = hashChunk( arrays[a], chunks[c], c - firstChunk[a], selected );
+                              }
+                          },
+                          maxThreads );
+
+    // Combine the chunk hashes of each build into its key, and group builds by key.
+    std::vector<uint64_t>                                         buildKeys( numBuilds );
+    std::unordered_map<uint64_t, std::vector<unsigned int>> groups;
+    for( unsigned int b = 0; b < numBuilds; ++b )
+    {
+        const size_t   beginChunk  = firstChunk[firstArray[b]];
+        const size_t   endChunk    = firstChunk[firstArray[b + 1]];
+        const uint64_t contentHash = hashBytes( chunkHashes.data() + beginChunk,
+                                                ( endChunk - beginChunk ) * sizeof( uint64_t ),
+                                                firstArray[b + 1] - firstArray[b] );
+        const OptixUtilAccelBuildRequest& request = hostRequests[b];
+        buildKeys[b] = optixUtilComputeAccelCacheKey( *request.options, request.buildInputs, request.numBuildInputs,
+                                                      contentHash );
+
+        std::vector<unsigned int>& group = groups[buildKeys[b]];
+        representatives[b]               = b;
+        for( unsigned int candidate : group )
+        {
+            bool equal = true;
+            if( options.verifyDuplicates )
+            {
+                equal = firstArray[b + 1] - firstArray[b] == firstArray[candidate + 1] - firstArray[candidate];
+                for( size_t a = 0; equal && a < firstArray[b + 1] - firstArray[b]; ++a )
+                    equal = hashArraysEqual( arrays[firstArray[b] + a], arrays[firstArray[candidate] + a] );
+            }
+            if( equal )
+            {
+                representatives[b] = candidate;
+                break;
+            }
+        }
+        if( representatives[b] == b )
+        {
+            dedupReport.numCollisions += group.empty() ? 0 : 1;
+            group.push_back( b );
+            ++dedupReport.numUniqueBuilds;
+            continue;
+        }
+
+        dedupReport.numPrimitivesSaved += primitives[b];
+        for( size_t a = firstArray[b]; a < firstArray[b + 1]; ++a )
+            dedupReport.inputBytesSaved += arrays[a].count * arrays[a].elementSize;
+        if( sizes )
+        {
+            dedupReport.outputBytesSaved += sizes[b].outputSizeInBytes;
+            dedupReport.tempBytesSaved += sizes[b].tempSizeInBytes;
+        }
+    }
+
+    if( keys )
+        std::copy( buildKeys.begin(), buildKeys.end(), keys );
+    if( report )
+    {
+        dedupReport.numBuilds = numBuilds;
+        for( size_t p : primitives )
+            dedupReport.numPrimitives += p;
+        if( options.buildPrimitivesPerSecond > 0.0 )
+            dedupReport.buildSecondsSaved = dedupReport.numPrimitivesSaved / options.buildPrimitivesPerSecond;
+        dedupReport.seconds = std::chrono::duration<double>( std::chrono::steady_clock::now() - start ).count();
+        dedupReport.bytesPerSecond = dedupReport.seconds > 0.0 ? dedupReport.inputBytes / dedupReport.seconds : 0.0;
+        *report                    = dedupReport;
+    }
+    return OPTIX_SUCCESS;
+}
+
+/*@}*/  // end group optix_utilities
+
+#endif  // __optix_optix_util_geometry_hash_h__
@@ -0,0 +1,399 @@
+/// @file
+/// @brief  OptiX host utilities: traversable graph flattening
+///
+/// Every #OptixStaticTransform and every instance level adds an entry to the transform list of a hit (see
+/// optixGetTransformListSize()). #optixUtilFlattenGraph() rewrites a host-side description of the traversable graph:
+///
+/// - chains of static transforms below an instance are multiplied into #OptixInstance::transform,
+/// - instances of nested IASs are pulled up into the parent IAS with the composed transform, as long as the
+///   parent stays within an instance budget.
+///
+/// Motion transforms are time dependent and are kept. Graphs that end up as one IAS over GASs can be traced with
+/// OPTIX_TRAVERSABLE_GRAPH_FLAG_ALLOW_SINGLE_LEVEL_INSTANCING.
+///
+/// The optimizer only rewrites the description. The application builds the resulting IASs bottom up and sets
+/// #OptixInstance::traversableHandle of instances whose child is an IAS, static or motion transform node it creates.
+
+#ifndef __optix_optix_util_graph_flatten_h__
+#define __optix_optix_util_graph_flatten_h__
+
+#include "optix_util_transform.h"
+
+#include <algorithm>
+#include <cstddef>
+#include <vector>
+
+/** \addtogroup optix_utilities
+@{
+*/
+
+/// Kinds of nodes in an #OptixUtilGraph.
+enum OptixUtilGraphNodeType
+{
+    /// Geometry acceleration structure, a leaf referenced through OptixUtilGraphNode::handle.
+    OPTIX_UTIL_GRAPH_NODE_TYPE_GAS = 0,
+    /// Instance acceleration structure over OptixUtilGraph::instances[firstInstance, firstInstance + numInstances).
+    OPTIX_UTIL_GRAPH_NODE_TYPE_IAS = 1,
+    /// #OptixStaticTransform with the matrix OptixUtilGraphNode::transform over OptixUtilGraphNode::child.
+    OPTIX_UTIL_GRAPH_NODE_TYPE_STATIC_TRANSFORM = 2,
+    /// Matrix or SRT motion transform over OptixUtilGraphNode::child. The keys are opaque to the optimizer.
+    OPTIX_UTIL_GRAPH_NODE_TYPE_MOTION_TRANSFORM = 3,
+};
+
+/// Node of an #OptixUtilGraph.
+struct OptixUtilGraphNode
+{
+    OptixUtilGraphNodeType type;
+
+    /// Handle of GAS and motion transform nodes, passed through unchanged.
+    OptixTraversableHandle handle;
+
+    /// Child node index of transform nodes.
+    unsigned int child;
+
+    /// Object-to-world matrix of static transform nodes.
+    float transform[12];
+
+    /// Instance range of IAS nodes.
+    unsigned int firstInstance;
+    unsigned int numInstances;
+
+    /// Application data passed through to the flattened graph, e.g. to map nodes back to scene objects.
+    unsigned long long userData;
+};
+
+/// Instance of an IAS node in an #OptixUtilGraph.
+struct OptixUtilGraphInstance
+{
+    /// Instance record. traversableHandle is set from the child node for GAS children.
+    OptixInstance instance;
+
+    /// Child node index.
+    unsigned int child;
+};
+
+/// Host-side description of a traversable graph. Must be acyclic.
+struct OptixUtilGraph
+{
+    std::vector<OptixUtilGraphNode>     nodes;
+    std::vector<OptixUtilGraphInstance> instances;
+
+    /// Node index passed to optixTrace().
+    unsigned int root;
+};
+
+/// Options for #optixUtilFlattenGraph().
+struct OptixUtilGraphFlattenOptions
+{
+    /// Upper limit on the instance count of any IAS after flattening. Nested IASs that would exceed it stay separate
+    /// levels. 0 means no limit.
+    size_t maxInstancesPerIas;
+
+    /// If non-zero, pulled-up instances keep the instanceId of the outer instance. Otherwise they keep the inner
+    /// instanceId, which is what optixGetInstanceId() reported for the unflattened graph.
+    int keepOuterInstanceId;
+};
+
+/// Transform list statistics over all root-to-GAS paths of a graph.
+struct OptixUtilGraphDepthStats
+{
+    /// Number of distinct paths from the root to a GAS, i.e., GAS instantiations.
+    double numPaths;
+    /// Average transform list size (see optixGetTransformListSize()) over all paths.
+    double averageDepth;
+    /// Largest transform list size.
+    unsigned int maxDepth;
+    /// Graph flags that the graph satisfies, see #OptixTraversableGraphFlags.
+    unsigned int graphFlags;
+};
+
+namespace optix_util_impl {
+
+const unsigned int GRAPH_MAX_RECURSION = 64;
+
+struct GraphPathStats
+{
+    double       numPaths;
+    double       sumDepth;
+    unsigned int maxDepth;
+    bool         onlyInstances;
+};
+
+inline bool graphPathStats( const OptixUtilGraph& graph, unsigned int node, unsigned int recursion, std::vector<GraphPathStats>& memo, std::vector<char>& done, GraphPathStats& out )
+{
+    if( node >= graph.nodes.size() || recursion > GRAPH_MAX_RECURSION )
+        return false;
+    if( done[node] )
+    {
+        out = memo[node];
+        return true;
+    }
+
+    const OptixUtilGraphNode& n     = graph.nodes[node];
+    GraphPathStats            stats = {0.0, 0.0, 0, true};
+    switch( n.type )
+    {
+        case OPTIX_UTIL_GRAPH_NODE_TYPE_GAS:
+            stats = {1.0, 0.0, 0, true};
+            break;
+        case OPTIX_UTIL_GRAPH_NODE_TYPE_IAS:
+            if( (size_t)n.firstInstance + n.numInstances > graph.instances.size() )
+                return false;
+            for( unsigned int i = 0; i < n.numInstances; ++i )
+            {
+                GraphPathStats child;
+                if( !graphPathStats( graph, graph.instances[n.firstInstance + i].child, recursion + 1, memo, done, child ) )
+                    return false;
+                stats.numPaths += child.numPaths;
+                stats.sumDepth += child.sumDepth + child.numPaths;
+                stats.maxDepth = std::max( stats.maxDepth, child.maxDepth + 1 );
+                // A GAS child has depth 0, anything else below an instance breaks single level instancing.
+                stats.onlyInstances = stats.onlyInstances && child.maxDepth == 0 && child.numPaths == 1.0
+                                      && graph.nodes[graph.instances[n.firstInstance + i].child].type == OPTIX_UTIL_GRAPH_NODE_TYPE_GAS;
+            }
+            break;
+        case OPTIX_UTIL_GRAPH_NODE_TYPE_STATIC_TRANSFORM:
+        case OPTIX_UTIL_GRAPH_NODE_TYPE_MOTION_TRANSFORM:
+        {
+            GraphPathStats child;
+            if( !graphPathStats( graph, n.child, recursion + 1, memo, done, child ) )
+                return false;
+            stats = {child.numPaths, child.sumDepth + child.numPaths, child.maxDepth + 1, false};
+            break;
+        }
+        default:
+            return false;
+    }
+
+    memo[node] = stats;
+    done[node] = 1;
+    out        = stats;
+    return true;
+}
+
+// Number of GAS/motion leaves an IAS expands to when all of its nested IAS levels are pulled up.
+inline double graphExpandedInstanceCount( const OptixUtilGraph& graph, unsigned int node, unsigned int recursion, std::vector<double>& memo )
+{
+    if( node >= graph.nodes.size() || recursion > GRAPH_MAX_RECURSION )
+        return 0.0;
+    if( memo[node] >= 0.0 )
+        return memo[node];
+
+    const OptixUtilGraphNode& n     = graph.nodes[node];
+    double                    count = 1.0;
+    if( n.type == OPTIX_UTIL_GRAPH_NODE_TYPE_IAS )
+    {
+        count = 0.0;
+        for( unsigned int i = 0; i < n.numInstances; ++i )
+            count += graphExpandedInstanceCount( graph, graph.instances[n.firstInstance + i].child, recursion + 1, memo );
+    }
+    else if( n.type == OPTIX_UTIL_GRAPH_NODE_TYPE_STATIC_TRANSFORM )
+    {
+        count = graphExpandedInstanceCount( graph, n.child, recursion + 1, memo );
+    }
+    memo[node] = count;
+    return count;
+}
+
+class GraphFlattener
+{
+  public:
+    GraphFlattener( const OptixUtilGraph& in, OptixUtilGraph& out, const OptixUtilGraphFlattenOptions& options )
+        : m_in( in )
+        , m_out( out )
+        , m_options( options )
+        , m_remap( in.nodes.size(), ~0u )
+        , m_expanded( in.nodes.size(), -1.0 )
+    {
+    }
+
+    bool run()
+    {
+        m_out.nodes.clear();
+        m_out.instances.clear();
+        m_out.root = emitNode( m_in.root, 0 );
+        return !m_failed;
+    }
+
+  private:
+    // Copies node into the output graph, flattening IAS nodes. Shared nodes are emitted once.
+    unsigned int emitNode( unsigned int node, unsigned int recursion )
+    {
+        if( node >= m_in.nodes.size() || recursion > GRAPH_MAX_RECURSION )
+        {
+            m_failed = true;
+            return 0;
+        }
+        if( m_remap[node] != ~0u )
+            return m_remap[node];
+
+        OptixUtilGraphNode n = m_in.nodes[node];
+        if( n.type == OPTIX_UTIL_GRAPH_NODE_TYPE_IAS )
+        {
+            if( (size_t)n.firstInstance + n.numInstances > m_in.instances.size() )
+            {
+                m_failed = true;
+                return 0;
+            }
+            std::vector<OptixUtilGraphInstance> flattened;
+            const size_t                        savedRemaining = m_remaining;
+            for( unsigned int i = 0; i < n.numInstances; ++i )
+            {
+                const OptixUtilGraphInstance& inst = m_in.instances[n.firstInstance + i];
+                m_remaining                        = n.numInstances - i - 1;
+                expandInstance( inst.instance, inst.child, flattened, recursion + 1 );
+            }
+            m_remaining = savedRemaining;
+            n.firstInstance = (unsigned int)m_out.instances.size();
+            n.numInstances  = (unsigned int)flattened.size();
+            m_out.instances.insert( m_out.instances.end(), flattened.begin(), flattened.end() );
+        }
+        else if( n.type != OPTIX_UTIL_GRAPH_NODE_TYPE_GAS )
+        {
+            n.child = emitNode( n.child, recursion + 1 );
+        }
+
+        m_remap[node] = (unsigned int)m_out.nodes.size();
+        m_out.nodes.push_back( n );
+        return m_remap[node];
+    }
+
+    void expandInstance( OptixInstance instance, unsigned int child, std::vector<OptixUtilGraphInstance>& out, unsigned int recursion )
+    {
+        if( instance.flags & OPTIX_INSTANCE_FLAG_DISABLE_TRANSFORM )
+        {
+            optixUtilSetIdentityMatrix( instance.transform );
+            instance.flags &= ~OPTIX_INSTANCE_FLAG_DISABLE_TRANSFORM;
+        }
+
+        // Fold static transform chains into the instance transform.
+        while( child < m_in.nodes.size() && m_in.nodes[child].type == OPTIX_UTIL_GRAPH_NODE_TYPE_STATIC_TRANSFORM
+               && recursion <= GRAPH_MAX_RECURSION )
+        {
+            optixUtilMultiplyMatrix( instance.transform, instance.transform, m_in.nodes[child].transform );
+            child = m_in.nodes[child].child;
+            ++recursion;
+        }
+        if( child >= m_in.nodes.size() || recursion > GRAPH_MAX_RECURSION )
+        {
+            m_failed = true;
+            return;
+        }
+
+        const OptixUtilGraphNode& node = m_in.nodes[child];
+        if( node.type == OPTIX_UTIL_GRAPH_NODE_TYPE_IAS && canPullUp( instance, child, out.size() ) )
+        {
+            for( unsigned int i = 0; i < node.numInstances; ++i )
+            {
+                const OptixUtilGraphInstance& inner    = m_in.instances[node.firstInstance + i];
+                OptixInstance                 composed = inner.instance;
+                if( composed.flags & OPTIX_INSTANCE_FLAG_DISABLE_TRANSFORM )
+                {
+                    optixUtilSetIdentityMatrix( composed.transform );
+                    composed.flags &= ~OPTIX_INSTANCE_FLAG_DISABLE_TRANSFORM;
+                }
+                optixUtilMultiplyMatrix( composed.transform, instance.transform, composed.transform );
+                composed.visibilityMask &= instance.visibilityMask;
+                if( m_options.keepOuterInstanceId )
+                    composed.instanceId = instance.instanceId;
+                expandInstance( composed, inner.child, out, recursion + 1 );
+            }
+            return;
+        }
+
+        OptixUtilGraphInstance result;
+        result.instance = instance;
+        result.child    = emitNode( child, recursion + 1 );
+        if( node.type == OPTIX_UTIL_GRAPH_NODE_TYPE_GAS )
+            result.instance.traversableHandle = node.handle;
+        out.push_back( result );
+    }
+
+    // Instance flags other than DISABLE_TRANSFORM only affect the GAS level, so an outer instance can only be folded
+    // into the inner ones if it has none.
+    bool canPullUp( const OptixInstance& instance, unsigned int ias, size_t currentCount )
+    {
+        if( instance.flags != OPTIX_INSTANCE_FLAG_NONE )
+            return false;
+        if( m_options.maxInstancesPerIas == 0 )
+            return true;
+        // Reserve room for the instances of the IAS being emitted that have not been expanded yet.
+        const double expanded = graphExpandedInstanceCount( m_in, ias, 0, m_expanded );
+        return (double)currentCount + expanded + (double)m_remaining <= (double)m_options.maxInstancesPerIas;
+    }
+
+    const OptixUtilGraph&               m_in;
+    OptixUtilGraph&                     m_out;
+    const OptixUtilGraphFlattenOptions& m_options;
+    std::vector<unsigned int>           m_remap;
+    std::vector<double>                 m_expanded;
+    size_t                              m_remaining = 0;
+    bool                                m_failed = false;
+};
+
+}  // namespace optix_util_impl
+
+/// Computes transform list statistics over all root-to-GAS paths of graph.
+inline OptixResult optixUtilComputeGraphDepthStats( const OptixUtilGraph& graph, OptixUtilGraphDepthStats* stats )
+{
+    if( !stats )
+        return OPTIX_ERROR_INVALID_VALUE;
+
+    std::vector<optix_util_impl::GraphPathStats> memo( graph.nodes.size() );
+    std::vector<char>                            done( graph.nodes.size(), 0 );
+    optix_util_impl::GraphPathStats              root;
+    if( !optix_util_impl::graphPathStats( graph, graph.root, 0, memo, done, root ) )
+        return OPTIX_ERROR_INVALID_VALUE;
+
+    const OptixUtilGraphNodeType rootType = graph.nodes[graph.root].type;
+
+    stats->numPaths     = root.numPaths;
+    stats->averageDepth = root.numPaths > 0.0 ? root.sumDepth / root.numPaths : 0.0;
+    stats->maxDepth     = root.maxDepth;
+    if( rootType == OPTIX_UTIL_GRAPH_NODE_TYPE_GAS )
+        stats->graphFlags = OPTIX_TRAVERSABLE_GRAPH_FLAG_ALLOW_SINGLE_GAS;
+    else if( rootType == OPTIX_UTIL_GRAPH_NODE_TYPE_IAS && root.onlyInstances )
+        stats->graphFlags = OPTIX_TRAVERSABLE_GRAPH_FLAG_ALLOW_SINGLE_LEVEL_INSTANCING;
+    else
+        stats->graphFlags = OPTIX_TRAVERSABLE_GRAPH_FLAG_ALLOW_ANY;
+    return OPTIX_SUCCESS;
+}
+
+/// Flattens graph into flattened, see the file description.
+///
+/// Nodes of flattened are a subset of the nodes of graph (static transforms folded into instances and fully pulled-up
+/// IASs disappear), renumbered, with OptixUtilGraphNode::userData preserved. Shared subgraphs stay shared.
+///
+/// \param[in]  graph       Graph to flatten.
+/// \param[in]  options     Flattening options.
+/// \param[out] flattened   Resulting graph, must not be graph.
+/// \param[out] before      Optional depth statistics of graph.
+/// \param[out] after       Optional depth statistics of flattened.
+inline OptixResult optixUtilFlattenGraph( const OptixUtilGraph&               graph,
+                                          const OptixUtilGraphFlattenOptions& options,
+                                          OptixUtilGraph&                     flattened,
+                                          OptixUtilGraphDepthStats*           before = nullptr,
+                                          OptixUtilGraphDepthStats*           after  = nullptr )
+{
+    if( &graph == &flattened || graph.root >= graph.nodes.size() )
+        return OPTIX_ERROR_INVALID_VALUE;
+
+    if( before )
+    {
+        const OptixResult result = optixUtilComputeGraphDepthStats( graph, before );
+        if( result != OPTIX_SUCCESS )
+            return result;
+    }
+
+    optix_util_impl::GraphFlattener flattener( graph, flattened, options );
+    if( !flattener.run() )
+        return OPTIX_ERROR_INVALID_VALUE;
+
+    if( after )
+        return optixUtilComputeGraphDepthStats( flattened, after );
+    return OPTIX_SUCCESS;
+}
+
+/*@}*/  // end group optix_utilities
+
+#endif  // __optix_optix_util_graph_flatten_h__
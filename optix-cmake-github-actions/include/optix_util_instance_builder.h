@@ -0,0 +1,319 @@
+/// @file
+/// @brief  OptiX host utilities: OptixInstance array packing from structure-of-arrays scene data
+///
+/// Scenes with many instances are cheaper to update in structure-of-arrays form, while instance build inputs need an
+/// array of 80 byte #OptixInstance records aligned to OPTIX_INSTANCE_BYTE_ALIGNMENT. #optixUtilPackInstances()
+/// converts between the two four instances at a time with SSE2 transposes, across threads for large batches, and
+/// writes the records with non-temporal stores so that packing into pinned upload memory does not evict the caches.
+///
+/// #OptixUtilInstanceStaging owns structure-of-arrays storage and #OptixUtilInstanceBuffer owns an aligned
+/// destination array whose span can be passed to cudaMemcpyAsync(). The packer also accepts any other aligned
+/// destination, e.g. memory from cudaHostAlloc().
+
+#ifndef __optix_optix_util_instance_builder_h__
+#define __optix_optix_util_instance_builder_h__
+
+#include "optix_util_parallel.h"
+#include "optix_util_simd.h"
+
+#include <optix_types.h>
+
+#include <algorithm>
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <vector>
+
+/** \addtogroup optix_utilities
+@{
+*/
+
+/// Structure-of-arrays view of instances. Member arrays are indexed by instance.
+///
+/// Null members select a default: the identity value for a transform element, the instance index for instanceId,
+/// 0 for sbtOffset, 255 for visibilityMask, #OPTIX_INSTANCE_FLAG_NONE for flags and 0 for traversableHandle.
+struct OptixUtilInstanceSoA
+{
+    /// transform[k] points to row-major element k of the 3x4 object-to-world matrices.
+    const float*                  transform[12];
+    const unsigned int*           instanceId;
+    const unsigned int*           sbtOffset;
+    const unsigned int*           visibilityMask;
+    const unsigned int*           flags;
+    const OptixTraversableHandle* traversableHandle;
+};
+
+/// Non-owning view of a packed instance array.
+struct OptixUtilInstanceSpan
+{
+    OptixInstance* data;
+    size_t         count;
+
+    /// Number of bytes to upload, e.g. with cudaMemcpyAsync().
+    size_t sizeInBytes() const { return count * sizeof( OptixInstance ); }
+};
+
+/// Owning structure-of-arrays instance storage.
+class OptixUtilInstanceStaging
+{
+  public:
+    /// Resizes all arrays. New instances get identity transforms, index instance IDs, visibility mask 255 and no
+    /// flags.
+    void resize( size_t count )
+    {
+        const size_t oldCount = size();
+        for( int k = 0; k < 12; ++k )
+            m_transform[k].resize( count, ( k % 5 == 0 ) ? 1.0f : 0.0f );
+        m_instanceId.resize( count );
+        for( size_t i = oldCount; i < count; ++i )
+            m_instanceId[i] = (unsigned int)i;
+        m_sbtOffset.resize( count, 0u );
+        m_visibilityMask.resize( count, 255u );
+        m_flags.resize( count, OPTIX_INSTANCE_FLAG_NONE );
+        m_traversableHandle.resize( count, 0 );
+    }
+
+    size_t size() const { return m_instanceId.size(); }
+
+    /// Sets the transform of instance i from a 3x4 row-major matrix.
+    void setTransform( size_t i, const float* m )
+    {
+        for( int k = 0; k < 12; ++k )
+            m_transform[k][i] = m[k];
+    }
+
+    void getTransform( size_t i, float* m ) const
+    {
+        for( int k = 0; k < 12; ++k )
+            m[k] = m_transform[k][i];
+    }
+
+    /// Row-major element k of all transforms.
+    float* transformElement( int k ) { return m_transform[k].data(); }
+
+    unsigned int*           instanceId() { return m_instanceId.data(); }
+    unsigned int*           sbtOffset() { return m_sbtOffset.data(); }
+    unsigned int*           visibilityMask() { return m_visibilityMask.data(); }
+    unsigned int*           flags() { return m_flags.data(); }
+    OptixTraversableHandle* traversableHandle() { return m_traversableHandle.data(); }
+
+    /// Returns a view for #optixUtilPackInstances(). The view is invalidated by resize().
+    OptixUtilInstanceSoA soa() const
+    {
+        OptixUtilInstanceSoA soa;
+        for( int k = 0; k < 12; ++k )
+            soa.transform[k] = m_transform[k].data();
+        soa.instanceId        = m_instanceId.data();
+        soa.sbtOffset         = m_sbtOffset.data();
+        soa.visibilityMask    = m_visibilityMask.data();
+        soa.flags             = m_flags.data();
+        soa.traversableHandle = m_traversableHandle.data();
+        return soa;
+    }
+
+  private:
+    std::vector<float>                  m_transform[12];
+    std::vector<unsigned int>           m_instanceId;
+    std::vector<unsigned int>           m_sbtOffset;
+    std::vector<unsigned int>           m_visibilityMask;
+    std::vector<unsigned int>           m_flags;
+    std::vector<OptixTraversableHandle> m_traversableHandle;
+};
+
+/// Owning #OptixInstance array aligned to a cache line, which satisfies OPTIX_INSTANCE_BYTE_ALIGNMENT.
+class OptixUtilInstanceBuffer
+{
+  public:
+    /// Resizes the array. Contents are not preserved. Memory is only reallocated when the array grows beyond its
+    /// capacity and is not initialized, since packing overwrites it anyway.
+    void resize( size_t count )
+    {
+        if( count > m_capacity )
+        {
+            m_storage.reset( new unsigned char[count * sizeof( OptixInstance ) + ALIGNMENT] );
+            m_capacity = count;
+        }
+        m_count = count;
+    }
+
+    OptixUtilInstanceSpan span()
+    {
+        const uintptr_t base = reinterpret_cast<uintptr_t>( m_storage.get() );
+        const uintptr_t data = ( base + ALIGNMENT - 1 ) & ~uintptr_t( ALIGNMENT - 1 );
+        return {m_count ? reinterpret_cast<OptixInstance*>( data ) : nullptr, m_count};
+    }
+
+  private:
+    static const size_t ALIGNMENT = 64;
+
+    std::unique_ptr<unsigned char[]> m_storage;
+    size_t                           m_count    = 0;
+    size_t                           m_capacity = 0;
+};
+
+namespace optix_util_impl {
+
+inline void packInstanceScalar( const OptixUtilInstanceSoA& soa, size_t i, OptixInstance& instance )
+{
+    for( int k = 0; k < 12; ++k )
+        instance.transform[k] = soa.transform[k] ? soa.transform[k][i] : ( ( k % 5 == 0 ) ? 1.0f : 0.0f );
+    instance.instanceId        = soa.instanceId ? soa.instanceId[i] : (unsigned int)i;
+    instance.sbtOffset         = soa.sbtOffset ? soa.sbtOffset[i] : 0u;
+    instance.visibilityMask    = soa.visibilityMask ? soa.visibilityMask[i] : 255u;
+    instance.flags             = soa.flags ? soa.flags[i] : (unsigned int)OPTIX_INSTANCE_FLAG_NONE;
+    instance.traversableHandle = soa.traversableHandle ? soa.traversableHandle[i] : 0;
+    instance.pad[0]            = 0;
+    instance.pad[1]            = 0;
+}
+
+#if OPTIX_UTIL_SIMD_X86
+
+// Loads 4 consecutive values of a member array, or broadcasts its default if the array is null.
+inline __m128 loadInstanceFloats( const float* p, size_t i, float defaultValue )
+{
+    return p ? _mm_loadu_ps( p + i ) : _mm_set1_ps( defaultValue );
+}
+
+inline __m128 loadInstanceUints( const unsigned int* p, size_t i, unsigned int defaultValue )
+{
+    return _mm_castsi128_ps( p ? _mm_loadu_si128( reinterpret_cast<const __m128i*>( p + i ) ) : _mm_set1_epi32( (int)defaultValue ) );
+}
+
+// Packs instances [begin, end) into dst, 4 at a time. Each 80 byte record is five 16 byte chunks: the three matrix
+// rows, the four 32 bit members and the handle with padding. A 4x4 transpose of four member arrays yields one chunk
+// for each of the four instances.
+inline void packInstancesSse2( const OptixUtilInstanceSoA& soa, size_t begin, size_t end, OptixInstance* dst, bool streaming )
+{
+    size_t i = begin;
+    for( ; i + 4 <= end; i += 4 )
+    {
+        __m128 chunk[4][4];
+        for( int row = 0; row < 3; ++row )
+        {
+            for( int c = 0; c < 4; ++c )
+            {
+                const int k   = 4 * row + c;
+                chunk[row][c] = loadInstanceFloats( soa.transform[k], i, ( k % 5 == 0 ) ? 1.0f : 0.0f );
+            }
+            _MM_TRANSPOSE4_PS( chunk[row][0], chunk[row][1], chunk[row][2], chunk[row][3] );
+        }
+
+        if( soa.instanceId )
+            chunk[3][0] = loadInstanceUints( soa.instanceId, i, 0 );
+        else
+            chunk[3][0] = _mm_castsi128_ps( _mm_add_epi32( _mm_set1_epi32( (int)i ), _mm_setr_epi32( 0, 1, 2, 3 ) ) );
+        chunk[3][1] = loadInstanceUints( soa.sbtOffset, i, 0u );
+        chunk[3][2] = loadInstanceUints( soa.visibilityMask, i, 255u );
+        chunk[3][3] = loadInstanceUints( soa.flags, i, OPTIX_INSTANCE_FLAG_NONE );
+        _MM_TRANSPOSE4_PS( chunk[3][0], chunk[3][1], chunk[3][2], chunk[3][3] );
+
+        for( int j = 0; j < 4; ++j )
+        {
+            __m128i* out = reinterpret_cast<__m128i*>( dst + i + j );
+            const long long handle = soa.traversableHandle ? (long long)soa.traversableHandle[i + j] : 0;
+            const __m128i   tail   = _mm_set_epi64x( 0, handle );
+            if( streaming )
+            {
+                _mm_stream_si128( out + 0, _mm_castps_si128( chunk[0][j] ) );
+                _mm_stream_si128( out + 1, _mm_castps_si128( chunk[1][j] ) );
+                _mm_stream_si128( out + 2, _mm_castps_si128( chunk[2][j] ) );
+                _mm_stream_si128( out + 3, _mm_castps_si128( chunk[3][j] ) );
+                _mm_stream_si128( out + 4, tail );
+            }
+            else
+            {
+                _mm_store_si128( out + 0, _mm_castps_si128( chunk[0][j] ) );
+                _mm_store_si128( out + 1, _mm_castps_si128( chunk[1][j] ) );
+                _mm_store_si128( out + 2, _mm_castps_si128( chunk[2][j] ) );
+                _mm_store_si128( out + 3, _mm_castps_si128( chunk[3][j] ) );
+                _mm_store_si128( out + 4, tail );
+            }
+        }
+    }
+    for( ; i < end; ++i )
+        packInstanceScalar( soa, i, dst[i] );
+
+    // Non-temporal stores are weakly ordered, make them visible before the caller starts the upload.
+    if( streaming )
+        _mm_sfence();
+}
+
+#endif  // OPTIX_UTIL_SIMD_X86
+
+}  // namespace optix_util_impl
+
+/// Packs instances [first, first + count) of soa into dst[0, count).
+///
+/// Batches of at least 65536 instances are split across threads. The function returns after all records are written
+/// and visible to other threads, so dst can be uploaded right away.
+///
+/// \param[in]  soa         Instance data.
+/// \param[in]  first       Index of the first instance to pack.
+/// \param[in]  count       Number of instances to pack.
+/// \param[out] dst         Destination records, aligned to OPTIX_INSTANCE_BYTE_ALIGNMENT.
+/// \param[in]  streaming   Use non-temporal stores. Preferable unless dst is read by the CPU right after packing.
+/// \param[in]  maxThreads  Upper bound on the number of threads, 0 for #optixUtilGetDefaultThreadCount().
+inline OptixResult optixUtilPackInstances( const OptixUtilInstanceSoA& soa,
+                                           size_t                      first,
+                                           size_t                      count,
+                                           OptixInstance*              dst,
+                                           bool                        streaming  = true,
+                                           unsigned int                maxThreads = 0 )
+{
+    if( count == 0 )
+        return OPTIX_SUCCESS;
+    if( !dst || reinterpret_cast<uintptr_t>( dst ) % OPTIX_INSTANCE_BYTE_ALIGNMENT != 0 )
+        return OPTIX_ERROR_INVALID_VALUE;
+
+    // Shift the source view so that dst[0] corresponds to index 0. Default instance IDs still count from first.
+    OptixUtilInstanceSoA view = soa;
+    for( int k = 0; k < 12; ++k )
+        view.transform[k] = soa.transform[k] ? soa.transform[k] + first : nullptr;
+    view.sbtOffset         = soa.sbtOffset ? soa.sbtOffset + first : nullptr;
+    view.visibilityMask    = soa.visibilityMask ? soa.visibilityMask + first : nullptr;
+    view.flags             = soa.flags ? soa.flags + first : nullptr;
+    view.traversableHandle = soa.traversableHandle ? soa.traversableHandle + first : nullptr;
+    view.instanceId        = soa.instanceId ? soa.instanceId + first : nullptr;
+
+    std::vector<unsigned int> defaultIds;
+    if( !soa.instanceId && first != 0 )
+    {
+        defaultIds.resize( count );
+        for( size_t i = 0; i < count; ++i )
+            defaultIds[i] = (unsigned int)( first + i );
+        view.instanceId = defaultIds.data();
+    }
+
+    const size_t parallelThreshold = 65536;
+    const size_t grainSize         = 16384;
+
+    optixUtilParallelFor( count, grainSize,
+                          [&]( size_t begin, size_t end ) {
+#if OPTIX_UTIL_SIMD_X86
+                              optix_util_impl::packInstancesSse2( view, begin, end, dst, streaming );
+#else
+                              (void)streaming;
+                              for( size_t i = begin; i < end; ++i )
+                                  optix_util_impl::packInstanceScalar( view, i, dst[i] );
+#endif
+                          },
+                          count < parallelThreshold ? 1u : maxThreads );
+    return OPTIX_SUCCESS;
+}
+
+/// Packs all instances of staging into buffer, resizing it, and returns the span to upload.
+inline OptixResult optixUtilPackInstances( const OptixUtilInstanceStaging& staging,
+                                           OptixUtilInstanceBuffer&        buffer,
+                                           OptixUtilInstanceSpan*          span,
+                                           unsigned int                    maxThreads = 0 )
+{
+    if( !span )
+        return OPTIX_ERROR_INVALID_VALUE;
+    buffer.resize( staging.size() );
+    *span = buffer.span();
+    return optixUtilPackInstances( staging.soa(), 0, staging.size(), span->data, true, maxThreads );
+}
+
+/*@}*/  // end group optix_utilities
+
+#endif  // __optix_optix_util_instance_builder_h__
@@ -0,0 +1,484 @@
+/// @file
+/// @brief  OptiX host utilities: instance frustum, distance and size culling with LOD selection
+///
+/// #optixUtilCullInstances() runs before an IAS build and keeps invisible instances out of the instance array, instead
+/// of relying on #OptixInstance::visibilityMask. Each instance references a #OptixUtilLodGroup, which provides the
+/// object space bounds and a list of level of detail children. An instance is culled if the bounding sphere of its
+/// transformed group bounds is:
+///
+/// - outside one of the frustum planes,
+/// - farther than the maximum distance,
+/// - smaller than the minimum projected size in pixels.
+///
+/// Otherwise the LOD level is picked from the projected size, and the instance is written with the level's
+/// traversable handle.
+///
+/// The sphere tests run 8 instances at a time with AVX2. The survivors are compacted into an aligned instance array in
+/// their input order, across threads for large batches.
+
+#ifndef __optix_optix_util_instance_cull_h__
+#define __optix_optix_util_instance_cull_h__
+
+#include "optix_util_instance_builder.h"
+#include "optix_util_parallel.h"
+#include "optix_util_simd.h"
+#include "optix_util_transform.h"
+
+#include <algorithm>
+#include <cmath>
+#include <cstddef>
+#include <vector>
+
+/** \addtogroup optix_utilities
+@{
+*/
+
+/// Level of detail child of a #OptixUtilLodGroup.
+struct OptixUtilLodLevel
+{
+    /// Traversable handle written to #OptixInstance::traversableHandle.
+    OptixTraversableHandle handle;
+    /// Added to the sbtOffset of the instance, for levels with their own SBT records.
+    unsigned int sbtOffset;
+    /// Smallest projected size in pixels at which this level is used.
+    float minPixelSize;
+};
+
+/// Object space bounds shared by a list of LOD levels. Levels are ordered from finest to coarsest, i.e., by decreasing
+/// OptixUtilLodLevel::minPixelSize. The coarsest level is used for all sizes below the previous levels.
+struct OptixUtilLodGroup
+{
+    OptixAabb    bounds;
+    unsigned int firstLevel;
+    unsigned int numLevels;
+};
+
+/// View parameters for #optixUtilCullInstances().
+struct OptixUtilCullParams
+{
+    /// World space planes (nx, ny, nz, d) with normals pointing into the frustum. A point p is inside if
+    /// nx * px + ny * py + nz * pz + d >= 0 for all planes.
+    float planes[6][4];
+    /// Number of planes used, at most 6.
+    unsigned int numPlanes;
+
+    /// World space eye position for distance and size tests.
+    float eye[3];
+    /// Cull instances farther than this. 0 means no limit.
+    float maxDistance;
+
+    /// Projected size in pixels of a sphere of radius r at distance d is r * pixelScale / d, e.g. pixelScale =
+    /// viewportHeight / ( 2 * tan( fovY / 2 ) ) for a perspective camera.
+    float pixelScale;
+    /// Cull instances smaller than this many pixels. 0 disables size culling.
+    float minPixelSize;
+};
+
+namespace optix_util_impl {
+
+const unsigned int CULL_REJECTED           = ~0u;
+const size_t       CULL_BLOCK_SIZE         = 1 << 9;
+const size_t       CULL_GRAIN_SIZE         = 1 << 14;
+const size_t       CULL_PARALLEL_THRESHOLD = 1 << 16;
+
+// Per-call state shared by the kernels. groupSphere holds the object space bounding sphere of each group as
+// (cx, cy, cz, radius).
+struct CullContext
+{
+    const OptixUtilInstanceSoA* instances;
+    const unsigned int*         lodGroups;
+    const OptixUtilLodGroup*    groups;
+    const OptixUtilLodLevel*    levels;
+    const OptixUtilCullParams*  params;
+    std::vector<float>          groupSphere;
+    float                       maxDistance;
+};
+
+inline float cullTransformElement( const CullContext& ctx, int k, size_t i )
+{
+    const float* p = ctx.instances->transform[k];
+    return p ? p[i] : ( ( k % 5 == 0 ) ? 1.0f : 0.0f );
+}
+
+// Upper bound on the squared stretch of the 3x3 part of m, i.e., on the largest eigenvalue of M^T M: by Gershgorin's
+// theorem, the largest absolute row sum of M^T M. Unlike the largest column norm it bounds shears and rotated
+// non-uniform scales, and unlike the Frobenius norm it is exact for rotations with a uniform scale.
+inline float cullScaleSquared( const float* m )
+{
+    const float a00 = m[0] * m[0] + m[4] * m[4] + m[8] * m[8];
+    const float a11 = m[1] * m[1] + m[5] * m[5] + m[9] * m[9];
+    const float a22 = m[2] * m[2] + m[6] * m[6] + m[10] * m[10];
+    const float a01 = std::fabs( m[0] * m[1] + m[4] * m[5] + m[8] * m[9] );
+    const float a02 = std::fabs( m[0] * m[2] + m[4] * m[6] + m[8] * m[10] );
+    const float a12 = std::fabs( m[1] * m[2] + m[5] * m[6] + m[9] * m[10] );
+    return std::max( std::max( a00 + a01 + a02, a01 + a11 + a12 ), a02 + a12 + a22 );
+}
+
+inline unsigned int selectLodLevel( const CullContext& ctx, unsigned int group, float pixelSize )
+{
+    const OptixUtilLodGroup& g = ctx.groups[group];
+    for( unsigned int l = 0; l + 1 < g.numLevels; ++l )
+        if( pixelSize >= ctx.levels[g.firstLevel + l].minPixelSize )
+            return g.firstLevel + l;
+    return g.firstLevel + g.numLevels - 1;
+}
+
+// Returns the selected level index of instance i, or CULL_REJECTED.
+inline unsigned int cullInstanceScalar( const CullContext& ctx, size_t i )
+{
+    const OptixUtilCullParams& p     = *ctx.params;
+    const unsigned int         group = ctx.lodGroups[i];
+    if( ctx.groups[group].numLevels == 0 )
+        return CULL_REJECTED;
+    if( ctx.instances->visibilityMask && ctx.instances->visibilityMask[i] == 0 )
+        return CULL_REJECTED;
+
+    float m[12];
+    for( int k = 0; k < 12; ++k )
+        m[k] = cullTransformElement( ctx, k, i );
+    if( ctx.instances->flags && ( ctx.instances->flags[i] & OPTIX_INSTANCE_FLAG_DISABLE_TRANSFORM ) )
+        optixUtilSetIdentityMatrix( m );
+
+    const float* c = &ctx.groupSphere[4 * group];
+    float       wc[3];
+    optixUtilTransformPoint( m, c, wc );
+
+    const float r = c[3] * std::sqrt( cullScaleSquared( m ) );
+
+    for( unsigned int k = 0; k < p.numPlanes; ++k )
+        if( p.planes[k][0] * wc[0] + p.planes[k][1] * wc[1] + p.planes[k][2] * wc[2] + p.planes[k][3] < -r )
+            return CULL_REJECTED;
+
+    const float dx = wc[0] - p.eye[0], dy = wc[1] - p.eye[1], dz = wc[2] - p.eye[2];
+    const float d  = std::sqrt( dx * dx + dy * dy + dz * dz );
+    if( d - r > ctx.maxDistance )
+        return CULL_REJECTED;
+
+    // Inside the sphere the projected size is unbounded.
+    const float pixelSize = d > r ? r * p.pixelScale / d : INFINITY;
+    if( pixelSize < p.minPixelSize )
+        return CULL_REJECTED;
+    return selectLodLevel( ctx, group, pixelSize );
+}
+
+#if OPTIX_UTIL_SIMD_X86
+
+OPTIX_UTIL_TARGET_AVX2 inline __m256 cullLoadTransform( const CullContext& ctx, int k, size_t i )
+{
+    const float* p = ctx.instances->transform[k];
+    return p ? _mm256_loadu_ps( p + i ) : _mm256_set1_ps( ( k % 5 == 0 ) ? 1.0f : 0.0f );
+}
+
+// SIMD version of cullScaleSquared() for 8 matrices.
+OPTIX_UTIL_TARGET_AVX2 inline __m256 cullScaleSquaredAvx2( const __m256* m )
+{
+    const __m256 absMask = _mm256_castsi256_ps( _mm256_set1_epi32( 0x7fffffff ) );
+    __m256       a[3][3];
+    for( int j = 0; j < 3; ++j )
+        for( int k = j; k < 3; ++k )
+        {
+            const __m256 dot =
+                _mm256_fmadd_ps( m[j], m[k], _mm256_fmadd_ps( m[4 + j], m[4 + k], _mm256_mul_ps( m[8 + j], m[8 + k] ) ) );
+            a[j][k] = a[k][j] = _mm256_and_ps( absMask, dot );
+        }
+    __m256 scale2 = _mm256_setzero_ps();
+    for( int j = 0; j < 3; ++j )
+        scale2 = _mm256_max_ps( scale2, _mm256_add_ps( _mm256_add_ps( a[j][0], a[j][1] ), a[j][2] ) );
+    return scale2;
+}
+
+// Culls instances [begin, end) 8 at a time into selected[0, end - begin) and returns the first index left for the
+// scalar tail.
+OPTIX_UTIL_TARGET_AVX2 inline size_t cullRangeAvx2( const CullContext& ctx, size_t begin, size_t end, unsigned int* selected )
+{
+    const OptixUtilCullParams& p = *ctx.params;
+
+    const __m256 eyeX         = _mm256_set1_ps( p.eye[0] );
+    const __m256 eyeY         = _mm256_set1_ps( p.eye[1] );
+    const __m256 eyeZ         = _mm256_set1_ps( p.eye[2] );
+    const __m256 maxDistance  = _mm256_set1_ps( ctx.maxDistance );
+    const __m256 pixelScale   = _mm256_set1_ps( p.pixelScale );
+    const __m256 minPixelSize = _mm256_set1_ps( p.minPixelSize );
+
+    size_t i = begin;
+    for( ; i + 8 <= end; i += 8 )
+    {
+        __m256 m[12];
+        for( int k = 0; k < 12; ++k )
+            m[k] = cullLoadTransform( ctx, k, i );
+
+        // Load the 8 group spheres and transpose them, which is faster than four gathers.
+        __m256 sphere[4];
+        for( int l = 0; l < 4; ++l )
+        {
+            const __m128 lo = _mm_loadu_ps( &ctx.groupSphere[4 * ctx.lodGroups[i + l]] );
+            const __m128 hi = _mm_loadu_ps( &ctx.groupSphere[4 * ctx.lodGroups[i + l + 4]] );
+            sphere[l]       = _mm256_insertf128_ps( _mm256_castps128_ps256( lo ), hi, 1 );
+        }
+        const __m256 t0 = _mm256_unpacklo_ps( sphere[0], sphere[1] );
+        const __m256 t1 = _mm256_unpackhi_ps( sphere[0], sphere[1] );
+        const __m256 t2 = _mm256_unpacklo_ps( sphere[2], sphere[3] );
+        const __m256 t3 = _mm256_unpackhi_ps( sphere[2], sphere[3] );
+        const __m256 cx = _mm256_shuffle_ps( t0, t2, _MM_SHUFFLE( 1, 0, 1, 0 ) );
+        const __m256 cy = _mm256_shuffle_ps( t0, t2, _MM_SHUFFLE( 3, 2, 3, 2 ) );
+        const __m256 cz = _mm256_shuffle_ps( t1, t3, _MM_SHUFFLE( 1, 0, 1, 0 ) );
+        const __m256 gr = _mm256_shuffle_ps( t1, t3, _MM_SHUFFLE( 3, 2, 3, 2 ) );
+
+        const __m256 wx = _mm256_fmadd_ps( m[0], cx, _mm256_fmadd_ps( m[1], cy, _mm256_fmadd_ps( m[2], cz, m[3] ) ) );
+        const __m256 wy = _mm256_fmadd_ps( m[4], cx, _mm256_fmadd_ps( m[5], cy, _mm256_fmadd_ps( m[6], cz, m[7] ) ) );
+        const __m256 wz = _mm256_fmadd_ps( m[8], cx, _mm256_fmadd_ps( m[9], cy, _mm256_fmadd_ps( m[10], cz, m[11] ) ) );
+
+        const __m256 r    = _mm256_mul_ps( gr, _mm256_sqrt_ps( cullScaleSquaredAvx2( m ) ) );
+        const __m256 negR = _mm256_sub_ps( _mm256_setzero_ps(), r );
+
+        __m256 visible = _mm256_castsi256_ps( _mm256_set1_epi32( -1 ) );
+        for( unsigned int k = 0; k < p.numPlanes; ++k )
+        {
+            const __m256 dist = _mm256_fmadd_ps( _mm256_set1_ps( p.planes[k][0] ), wx,
+                                                 _mm256_fmadd_ps( _mm256_set1_ps( p.planes[k][1] ), wy,
+                                                                  _mm256_fmadd_ps( _mm256_set1_ps( p.planes[k][2] ), wz,
+                                                                                   _mm256_set1_ps( p.planes[k][3] ) ) ) );
+            visible = _mm256_and_ps( visible, _mm256_cmp_ps( dist, negR, _CMP_GE_OQ ) );
+        }
+
+        const __m256 dx = _mm256_sub_ps( wx, eyeX );
+        const __m256 dy = _mm256_sub_ps( wy, eyeY );
+        const __m256 dz = _mm256_sub_ps( wz, eyeZ );
+        const __m256 d  = _mm256_sqrt_ps( _mm256_fmadd_ps( dx, dx, _mm256_fmadd_ps( dy, dy, _mm256_mul_ps( dz, dz ) ) ) );
+        visible         = _mm256_and_ps( visible, _mm256_cmp_ps( _mm256_sub_ps( d, r ), maxDistance, _CMP_LE_OQ ) );
+
+        // r * pixelScale / d >= minPixelSize without the division; inside the sphere the size is unbounded.
+        const __m256 rScaled = _mm256_mul_ps( r, pixelScale );
+        const __m256 inside  = _mm256_cmp_ps( d, r, _CMP_LE_OQ );
+        visible = _mm256_and_ps( visible, _mm256_or_ps( inside, _mm256_cmp_ps( rScaled, _mm256_mul_ps( minPixelSize, d ), _CMP_GE_OQ ) ) );
+
+        // Lanes the sphere test cannot decide alone are finished by the scalar kernel. Empty groups have a negative
+        // radius.
+        __m256 special = _mm256_cmp_ps( gr, _mm256_setzero_ps(), _CMP_LT_OQ );
+        if( ctx.instances->visibilityMask )
+        {
+            const __m256i mask = _mm256_loadu_si256( reinterpret_cast<const __m256i*>( ctx.instances->visibilityMask + i ) );
+            special = _mm256_or_ps( special, _mm256_castsi256_ps( _mm256_cmpeq_epi32( mask, _mm256_setzero_si256() ) ) );
+        }
+        if( ctx.instances->flags )
+        {
+            const __m256i flags    = _mm256_loadu_si256( reinterpret_cast<const __m256i*>( ctx.instances->flags + i ) );
+            const __m256i disabled = _mm256_and_si256( flags, _mm256_set1_epi32( OPTIX_INSTANCE_FLAG_DISABLE_TRANSFORM ) );
+            special = _mm256_or_ps( special, _mm256_castsi256_ps( _mm256_cmpgt_epi32( disabled, _mm256_setzero_si256() ) ) );
+        }
+
+        const unsigned int specialMask = (unsigned int)_mm256_movemask_ps( special );
+        const unsigned int visibleMask = (unsigned int)_mm256_movemask_ps( visible ) & ~specialMask;
+        if( !( visibleMask | specialMask ) )
+        {
+            for( int l = 0; l < 8; ++l )
+                selected[i + l - begin] = CULL_REJECTED;
+            continue;
+        }
+
+        alignas( 32 ) float pixelSize[8];
+        _mm256_store_ps( pixelSize, _mm256_blendv_ps( _mm256_div_ps( rScaled, d ), _mm256_set1_ps( INFINITY ), inside ) );
+        for( int l = 0; l < 8; ++l )
+        {
+            const size_t index = i + l;
+            if( ( specialMask >> l ) & 1u )
+                selected[index - begin] = cullInstanceScalar( ctx, index );
+            else if( ( visibleMask >> l ) & 1u )
+                selected[index - begin] = selectLodLevel( ctx, ctx.lodGroups[index], pixelSize[l] );
+            else
+                selected[index - begin] = CULL_REJECTED;
+        }
+    }
+    return i;
+}
+
+#endif  // OPTIX_UTIL_SIMD_X86
+
+// Survivors of one range, packed while the range is still in cache. The vectors only grow, so that reused scratch
+// memory is not cleared every call; count is the number of valid entries.
+struct CullRangeResult
+{
+    std::vector<OptixInstance> instances;
+    std::vector<unsigned int>  indices;
+    size_t                     count;
+};
+
+// Culls instances [begin, end) and packs the survivors into result. Blocks are small enough that the instance data
+// read by the culling kernel is still in L1 when the survivors are packed.
+inline void cullRange( const CullContext& ctx, size_t begin, size_t end, CullRangeResult& result, bool wantIndices, OptixUtilSimdIsa isa )
+{
+    result.count = 0;
+
+    unsigned int selected[CULL_BLOCK_SIZE];
+    for( size_t blockBegin = begin; blockBegin < end; blockBegin += CULL_BLOCK_SIZE )
+    {
+        const size_t blockEnd = std::min( blockBegin + CULL_BLOCK_SIZE, end );
+
+        size_t i = blockBegin;
+#if OPTIX_UTIL_SIMD_X86
+        // The AVX2 kernel is bound by loads, so it also serves AVX-512 hosts.
+        if( isa >= OPTIX_UTIL_SIMD_ISA_AVX2 )
+            i = cullRangeAvx2( ctx, blockBegin, blockEnd, selected );
+#else
+        (void)isa;
+#endif
+        for( ; i < blockEnd; ++i )
+            selected[i - blockBegin] = cullInstanceScalar( ctx, i );
+
+        size_t k     = result.count;
+        size_t total = k;
+        for( size_t j = blockBegin; j < blockEnd; ++j )
+            total += selected[j - blockBegin] != CULL_REJECTED;
+        if( result.instances.size() < total )
+            result.instances.resize( std::max( total, 2 * result.instances.size() ) );
+        if( wantIndices && result.indices.size() < total )
+            result.indices.resize( result.instances.size() );
+
+        for( size_t j = blockBegin; j < blockEnd; ++j )
+        {
+            if( selected[j - blockBegin] == CULL_REJECTED )
+                continue;
+            OptixInstance& instance = result.instances[k];
+            packInstanceScalar( *ctx.instances, j, instance );
+            const OptixUtilLodLevel& level = ctx.levels[selected[j - blockBegin]];
+            instance.traversableHandle     = level.handle;
+            instance.sbtOffset += level.sbtOffset;
+            if( wantIndices )
+                result.indices[k] = (unsigned int)j;
+            ++k;
+        }
+        result.count = k;
+    }
+}
+
+// Copies packed instances to dst with non-temporal stores.
+inline void streamInstances( const OptixInstance* src, size_t count, OptixInstance* dst )
+{
+#if OPTIX_UTIL_SIMD_X86
+    const __m128i* s = reinterpret_cast<const __m128i*>( src );
+    __m128i*       d = reinterpret_cast<__m128i*>( dst );
+    for( size_t c = 0; c < count * 5; ++c )
+        _mm_stream_si128( d + c, _mm_loadu_si128( s + c ) );
+    _mm_sfence();
+#else
+    std::copy( src, src + count, dst );
+#endif
+}
+
+}  // namespace optix_util_impl
+
+/// Scratch memory of #optixUtilCullInstances(). Passing the same object every frame keeps the per-range survivor
+/// buffers allocated, which saves a significant part of the run time.
+class OptixUtilCullScratch
+{
+  public:
+    std::vector<optix_util_impl::CullRangeResult> ranges;
+};
+
+/// Culls instances and writes the visible ones, with the traversable handle of their LOD level, to output.
+///
+/// \param[in]  instances           Instance data. The traversableHandle member is ignored.
+/// \param[in]  lodGroups           LOD group index of each instance.
+/// \param[in]  count               Number of instances.
+/// \param[in]  groups              LOD groups.
+/// \param[in]  numGroups           Number of LOD groups.
+/// \param[in]  levels              LOD levels referenced by the groups.
+/// \param[in]  numLevels           Number of LOD levels.
+/// \param[in]  params              View parameters.
+/// \param[out] output              Resized to the visible instances, in input order.
+/// \param[out] span                Span of the visible instances in output.
+/// \param[out] survivorIndices     Optional input index of each visible instance.
+/// \param[in]  scratch             Optional scratch memory to reuse across calls.
+/// \param[in]  maxThreads          Upper bound on worker threads for large batches, 0 for automatic.
+/// \param[in]  isa                 Instruction set to use, see #optixUtilSelectSimdIsa().
+inline OptixResult optixUtilCullInstances( const OptixUtilInstanceSoA&  instances,
+                                           const unsigned int*          lodGroups,
+                                           size_t                       count,
+                                           const OptixUtilLodGroup*     groups,
+                                           unsigned int                 numGroups,
+                                           const OptixUtilLodLevel*     levels,
+                                           unsigned int                 numLevels,
+                                           const OptixUtilCullParams&   params,
+                                           OptixUtilInstanceBuffer&     output,
+                                           OptixUtilInstanceSpan*       span,
+                                           std::vector<unsigned int>*   survivorIndices = nullptr,
+                                           OptixUtilCullScratch*        scratch         = nullptr,
+                                           unsigned int                 maxThreads      = 0,
+                                           OptixUtilSimdIsa             isa             = OPTIX_UTIL_SIMD_ISA_AUTO )
+{
+    using namespace optix_util_impl;
+
+    if( !span || ( count && ( !lodGroups || !groups ) ) || params.numPlanes > 6 || !( params.minPixelSize >= 0.0f ) )
+        return OPTIX_ERROR_INVALID_VALUE;
+    for( unsigned int g = 0; g < numGroups; ++g )
+        if( ( groups[g].numLevels && !levels ) || (size_t)groups[g].firstLevel + groups[g].numLevels > numLevels )
+            return OPTIX_ERROR_INVALID_VALUE;
+    for( size_t i = 0; i < count; ++i )
+        if( lodGroups[i] >= numGroups )
+            return OPTIX_ERROR_INVALID_VALUE;
+
+    CullContext ctx;
+    ctx.instances   = &instances;
+    ctx.lodGroups   = lodGroups;
+    ctx.groups      = groups;
+    ctx.levels      = levels;
+    ctx.params      = &params;
+    ctx.maxDistance = params.maxDistance > 0.0f ? params.maxDistance : INFINITY;
+    ctx.groupSphere.resize( 4 * (size_t)numGroups );
+    for( unsigned int g = 0; g < numGroups; ++g )
+    {
+        const OptixAabb& b  = groups[g].bounds;
+        const float      hx = 0.5f * ( b.maxX - b.minX ), hy = 0.5f * ( b.maxY - b.minY ), hz = 0.5f * ( b.maxZ - b.minZ );
+        ctx.groupSphere[4 * g + 0] = 0.5f * ( b.minX + b.maxX );
+        ctx.groupSphere[4 * g + 1] = 0.5f * ( b.minY + b.maxY );
+        ctx.groupSphere[4 * g + 2] = 0.5f * ( b.minZ + b.maxZ );
+        ctx.groupSphere[4 * g + 3] = groups[g].numLevels ? std::sqrt( hx * hx + hy * hy + hz * hz ) : -1.0f;
+    }
+
+    const OptixUtilSimdIsa selected = optixUtilSelectSimdIsa( isa );
+    if( count < CULL_PARALLEL_THRESHOLD )
+        maxThreads = 1;
+
+    // Pass 1: cull and pack the survivors of each range.
+    const size_t                  numRanges = ( count + CULL_GRAIN_SIZE - 1 ) / CULL_GRAIN_SIZE;
+    OptixUtilCullScratch          localScratch;
+    std::vector<CullRangeResult>& ranges = scratch ? scratch->ranges : localScratch.ranges;
+    if( ranges.size() < numRanges )
+        ranges.resize( numRanges );
+    optixUtilParallelFor( numRanges, 1,
+                          [&]( size_t first, size_t last ) {
+                              for( size_t r = first; r < last; ++r )
+                              {
+                                  const size_t begin = r * CULL_GRAIN_SIZE;
+                                  const size_t end   = std::min( begin + CULL_GRAIN_SIZE, count );
+                                  cullRange( ctx, begin, end, ranges[r], survivorIndices != nullptr, selected );
+                              }
+                          },
+                          maxThreads );
+    std::vector<size_t> rangeOffset( numRanges + 1, 0 );
+    for( size_t r = 0; r < numRanges; ++r )
+        rangeOffset[r + 1] = rangeOffset[r] + ranges[r].count;
+
+    // Pass 2: concatenate the ranges at their prefix sum offsets.
+    const size_t numVisible = rangeOffset[numRanges];
+    output.resize( numVisible );
+    *span = output.span();
+    if( survivorIndices )
+        survivorIndices->resize( numVisible );
+    optixUtilParallelFor( numRanges, 1,
+                          [&]( size_t first, size_t last ) {
+                              for( size_t r = first; r < last; ++r )
+                              {
+                                  streamInstances( ranges[r].instances.data(), ranges[r].count, span->data + rangeOffset[r] );
+                                  if( survivorIndices )
+                                      std::copy( ranges[r].indices.begin(), ranges[r].indices.begin() + ranges[r].count,
+                                                 survivorIndices->begin() + rangeOffset[r] );
+                              }
+                          },
+                          maxThreads );
+    return OPTIX_SUCCESS;
+}
+
+/*@}*/  // end group optix_utilities
+
+#endif  // __optix_optix_util_instance_cull_h__
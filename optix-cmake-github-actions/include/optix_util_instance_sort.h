@@ -0,0 +1,569 @@
+/// @file
+/// @brief  OptiX host utilities: spatial reordering of instance arrays along Morton or Hilbert curves
+///
+/// Instance arrays usually follow scene graph order, which is spatially random. #optixUtilSortInstances() reorders
+/// them by the space filling curve index of their world space centers, so neighbouring instances are close in memory.
+/// This gives the IAS builder coherent input.
+///
+/// Centers are quantized to 10 bits per axis inside their common bounds, and the curve indices are computed 8 at a time
+/// with AVX2. The resulting 30 bit keys are sorted with a stable LSD radix sort in three passes, split into blocks
+/// across threads. Passes whose digit is the same for all keys are skipped.
+///
+/// Instances are moved as a whole, so #OptixInstance::instanceId keeps its value. The index returned by
+/// optixGetInstanceIndex() does change. The permutation written by the sort maps each new position to the old index,
+/// and #optixUtilApplyPermutation() reorders other per-instance arrays the same way.
+
+#ifndef __optix_optix_util_instance_sort_h__
+#define __optix_optix_util_instance_sort_h__
+
+#include "optix_util_parallel.h"
+#include "optix_util_simd.h"
+#include "optix_util_transform.h"
+
+#include <optix_types.h>
+
+#include <algorithm>
+#include <climits>
+#include <cmath>
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+/** \addtogroup optix_utilities
+@{
+*/
+
+/// Space filling curve used to order instances.
+enum OptixUtilSpatialCurve
+{
+    /// Z-order curve. The keys are cheaper, but the curve jumps between distant cells at power of two boundaries.
+    OPTIX_UTIL_SPATIAL_CURVE_MORTON = 0,
+    /// Hilbert curve. Consecutive cells are always adjacent, which gives slightly tighter groups.
+    OPTIX_UTIL_SPATIAL_CURVE_HILBERT = 1
+};
+
+namespace optix_util_impl {
+
+/// Number of keys per block of the radix sort. Each block is one parallel work item.
+const size_t SORT_BLOCK_SIZE = 65536;
+/// Below this number of keys, sorting runs on the calling thread only.
+const size_t SORT_PARALLEL_THRESHOLD = 65536;
+/// Number of instances between a prefetch and the copy of the instance in the final gather.
+const size_t SORT_PREFETCH_DISTANCE = 16;
+/// Number of bits per axis of the curve index.
+const unsigned int SORT_BITS_PER_AXIS = 10;
+/// Digit size of the radix sort. Three passes cover the 30 bit curve index, and the per block histograms still fit in
+/// L1.
+const unsigned int SORT_RADIX_BITS = 11;
+const unsigned int SORT_RADIX      = 1u << SORT_RADIX_BITS;
+
+/// Spreads the low 10 bits of v so that there are two zero bits between each of them.
+inline uint32_t expandBits10( uint32_t v )
+{
+    v &= 0x3ffu;
+    v = ( v | ( v << 16 ) ) & 0x030000ffu;
+    v = ( v | ( v << 8 ) ) & 0x0300f00fu;
+    v = ( v | ( v << 4 ) ) & 0x030c30c3u;
+    v = ( v | ( v << 2 ) ) & 0x09249249u;
+    return v;
+}
+
+inline uint32_t mortonCode( uint32_t x, uint32_t y, uint32_t z )
+{
+    return ( expandBits10( x ) << 2 ) | ( expandBits10( y ) << 1 ) | expandBits10( z );
+}
+
+/// Hilbert index of a cell, after J. Skilling, "Programming the Hilbert curve", AIP Conf. Proc. 707 (2004). The axes
+/// are converted to the transposed Hilbert index, whose interleaved bits are the index.
+inline uint32_t hilbertCode( uint32_t x, uint32_t y, uint32_t z )
+{
+    uint32_t X[3] = {x, y, z};
+
+    // Inverse undo. The branches of the reference code are turned into masks, because they are unpredictable for
+    // scattered points.
+    for( uint32_t q = 1u << ( SORT_BITS_PER_AXIS - 1 ); q > 1; q >>= 1 )
+    {
+        const uint32_t p = q - 1;
+        for( int i = 0; i < 3; ++i )
+        {
+            const uint32_t invert = 0u - (uint32_t)( ( X[i] & q ) != 0 );
+            const uint32_t t      = ( X[0] ^ X[i] ) & p & ~invert;
+            X[0] ^= ( p & invert ) | t;
+            X[i] ^= t;
+        }
+    }
+
+    // Gray encode.
+    X[1] ^= X[0];
+    X[2] ^= X[1];
+    uint32_t t = 0;
+    for( uint32_t q = 1u << ( SORT_BITS_PER_AXIS - 1 ); q > 1; q >>= 1 )
+        t ^= ( q - 1 ) & ( 0u - (uint32_t)( ( X[2] & q ) != 0 ) );
+    X[0] ^= t;
+    X[1] ^= t;
+    X[2] ^= t;
+
+    return mortonCode( X[0], X[1], X[2] );
+}
+
+/// Maps a coordinate to a cell index in [0, 1023]. NaN maps to 0.
+inline uint32_t quantizeAxis( float value, float origin, float scale )
+{
+    const float cell = ( value - origin ) * scale;
+    return cell > 0.0f ? (uint32_t)std::min( cell, 1023.0f ) : 0u;
+}
+
+}  // namespace optix_util_impl
+
+/// Scratch memory of #optixUtilSortInstances() and #optixUtilSortByCenters(). Passing the same object every frame
+/// avoids reallocating the key buffers.
+class OptixUtilSortScratch
+{
+  public:
+    std::vector<float>        centers;
+    std::vector<uint64_t>     keys;
+    std::vector<uint64_t>     keysAlt;
+    std::vector<unsigned int> histograms;
+    std::vector<float>        blockBounds;
+};
+
+namespace optix_util_impl {
+
+/// World space center of the child of an instance, or its translation if the child bounds are missing or empty.
+inline void instanceCenter( const OptixInstance& instance, const OptixAabb* box, float* center )
+{
+    const float* m = instance.transform;
+    if( box && box->minX <= box->maxX && box->minY <= box->maxY && box->minZ <= box->maxZ )
+    {
+        const float p[3] = {0.5f * ( box->minX + box->maxX ), 0.5f * ( box->minY + box->maxY ),
+                            0.5f * ( box->minZ + box->maxZ )};
+        optixUtilTransformPoint( m, p, center );
+    }
+    else
+    {
+        center[0] = m[3];
+        center[1] = m[7];
+        center[2] = m[11];
+    }
+}
+
+/// Calls fn( block, begin, end ) for each block of SORT_BLOCK_SIZE indices in [0, count).
+template <typename Fn>
+inline void forEachSortBlock( size_t count, const Fn& fn, unsigned int maxThreads )
+{
+    const size_t numBlocks = ( count + SORT_BLOCK_SIZE - 1 ) / SORT_BLOCK_SIZE;
+    optixUtilParallelFor( numBlocks, 1,
+                          [&]( size_t first, size_t last ) {
+                              for( size_t b = first; b < last; ++b )
+                                  fn( b, b * SORT_BLOCK_SIZE, std::min( ( b + 1 ) * SORT_BLOCK_SIZE, count ) );
+                          },
+                          maxThreads );
+}
+
+/// Grows lo and hi by the points in [begin, end). Four points are reduced independently, so the min and max chains
+/// do not limit the loop.
+inline void centerBounds( const float* centers, size_t begin, size_t end, float* lo, float* hi )
+{
+    float l[4][3], h[4][3];
+    for( int j = 0; j < 4; ++j )
+    {
+        std::copy( lo, lo + 3, l[j] );
+        std::copy( hi, hi + 3, h[j] );
+    }
+    size_t i = begin;
+    for( ; i + 4 <= end; i += 4 )
+    {
+        for( int j = 0; j < 4; ++j )
+        {
+            for( int k = 0; k < 3; ++k )
+            {
+                l[j][k] = std::min( l[j][k], centers[( i + j ) * 3 + k] );
+                h[j][k] = std::max( h[j][k], centers[( i + j ) * 3 + k] );
+            }
+        }
+    }
+    for( ; i < end; ++i )
+    {
+        for( int k = 0; k < 3; ++k )
+        {
+            l[0][k] = std::min( l[0][k], centers[i * 3 + k] );
+            h[0][k] = std::max( h[0][k], centers[i * 3 + k] );
+        }
+    }
+    for( int k = 0; k < 3; ++k )
+    {
+        lo[k] = std::min( std::min( l[0][k], l[1][k] ), std::min( l[2][k], l[3][k] ) );
+        hi[k] = std::max( std::max( h[0][k], h[1][k] ), std::max( h[2][k], h[3][k] ) );
+    }
+}
+
+/// Writes the sort keys of the points in [begin, end) and counts their lowest digits into histogram.
+inline void sortKeysScalar( const float*  centers,
+                            size_t        begin,
+                            size_t        end,
+                            const float*  origin,
+                            const float*  scale,
+                            bool          hilbert,
+                            uint64_t*     keys,
+                            unsigned int* histogram )
+{
+    for( size_t i = begin; i < end; ++i )
+    {
+        const float*   c    = centers + i * 3;
+        const uint32_t x    = quantizeAxis( c[0], origin[0], scale[0] );
+        const uint32_t y    = quantizeAxis( c[1], origin[1], scale[1] );
+        const uint32_t z    = quantizeAxis( c[2], origin[2], scale[2] );
+        const uint32_t code = hilbert ? hilbertCode( x, y, z ) : mortonCode( x, y, z );
+        keys[i]             = ( (uint64_t)code << 32 ) | (uint64_t)i;
+        ++histogram[code & ( SORT_RADIX - 1 )];
+    }
+}
+
+#if OPTIX_UTIL_SIMD_X86
+
+OPTIX_UTIL_TARGET_AVX2 inline __m256i expandBits10Avx2( __m256i v )
+{
+    v = _mm256_and_si256( v, _mm256_set1_epi32( 0x3ff ) );
+    v = _mm256_and_si256( _mm256_or_si256( v, _mm256_slli_epi32( v, 16 ) ), _mm256_set1_epi32( 0x030000ff ) );
+    v = _mm256_and_si256( _mm256_or_si256( v, _mm256_slli_epi32( v, 8 ) ), _mm256_set1_epi32( 0x0300f00f ) );
+    v = _mm256_and_si256( _mm256_or_si256( v, _mm256_slli_epi32( v, 4 ) ), _mm256_set1_epi32( 0x030c30c3 ) );
+    v = _mm256_and_si256( _mm256_or_si256( v, _mm256_slli_epi32( v, 2 ) ), _mm256_set1_epi32( 0x09249249 ) );
+    return v;
+}
+
+OPTIX_UTIL_TARGET_AVX2 inline __m256i mortonCodeAvx2( __m256i x, __m256i y, __m256i z )
+{
+    return _mm256_or_si256( _mm256_or_si256( _mm256_slli_epi32( expandBits10Avx2( x ), 2 ),
+                                             _mm256_slli_epi32( expandBits10Avx2( y ), 1 ) ),
+                            expandBits10Avx2( z ) );
+}
+
+/// #hilbertCode() for 8 cells.
+OPTIX_UTIL_TARGET_AVX2 inline __m256i hilbertCodeAvx2( __m256i x, __m256i y, __m256i z )
+{
+    __m256i       X[3] = {x, y, z};
+    const __m256i zero = _mm256_setzero_si256();
+    for( uint32_t q = 1u << ( SORT_BITS_PER_AXIS - 1 ); q > 1; q >>= 1 )
+    {
+        const __m256i vq = _mm256_set1_epi32( (int)q );
+        const __m256i p  = _mm256_set1_epi32( (int)( q - 1 ) );
+        for( int i = 0; i < 3; ++i )
+        {
+            const __m256i keep = _mm256_cmpeq_epi32( _mm256_and_si256( X[i], vq ), zero );
+            const __m256i t    = _mm256_and_si256( _mm256_and_si256( _mm256_xor_si256( X[0], X[i] ), p ), keep );
+            X[0]               = _mm256_xor_si256( X[0], _mm256_or_si256( _mm256_andnot_si256( keep, p ), t ) );
+            X[i]               = _mm256_xor_si256( X[i], t );
+        }
+    }
+
+    X[1]      = _mm256_xor_si256( X[1], X[0] );
+    X[2]      = _mm256_xor_si256( X[2], X[1] );
+    __m256i t = zero;
+    for( uint32_t q = 1u << ( SORT_BITS_PER_AXIS - 1 ); q > 1; q >>= 1 )
+    {
+        const __m256i set = _mm256_cmpeq_epi32( _mm256_and_si256( X[2], _mm256_set1_epi32( (int)q ) ), zero );
+        t                 = _mm256_xor_si256( t, _mm256_andnot_si256( set, _mm256_set1_epi32( (int)( q - 1 ) ) ) );
+    }
+    return mortonCodeAvx2( _mm256_xor_si256( X[0], t ), _mm256_xor_si256( X[1], t ), _mm256_xor_si256( X[2], t ) );
+}
+
+/// #sortKeysScalar() for 8 points at a time.
+OPTIX_UTIL_TARGET_AVX2 inline void sortKeysAvx2( const float*  centers,
+                                                 size_t        begin,
+                                                 size_t        end,
+                                                 const float*  origin,
+                                                 const float*  scale,
+                                                 bool          hilbert,
+                                                 uint64_t*     keys,
+                                                 unsigned int* histogram )
+{
+    const __m256i stride = _mm256_setr_epi32( 0, 3, 6, 9, 12, 15, 18, 21 );
+    const __m256  zero   = _mm256_setzero_ps();
+    const __m256  last   = _mm256_set1_ps( 1023.0f );
+    __m256i       cell[3];
+    alignas( 32 ) uint32_t codes[8];
+
+    size_t i = begin;
+    for( ; i + 8 <= end; i += 8 )
+    {
+        for( int k = 0; k < 3; ++k )
+        {
+            const __m256 c = _mm256_i32gather_ps( centers + i * 3 + k, stride, 4 );
+            // max_ps returns its second operand for NaN, which maps NaN to cell 0 like quantizeAxis().
+            __m256 v = _mm256_mul_ps( _mm256_sub_ps( c, _mm256_set1_ps( origin[k] ) ), _mm256_set1_ps( scale[k] ) );
+            v        = _mm256_min_ps( _mm256_max_ps( v, zero ), last );
+            cell[k]  = _mm256_cvttps_epi32( v );
+        }
+        const __m256i code =
+            hilbert ? hilbertCodeAvx2( cell[0], cell[1], cell[2] ) : mortonCodeAvx2( cell[0], cell[1], cell[2] );
+        _mm256_store_si256( (__m256i*)codes, code );
+        for( int j = 0; j < 8; ++j )
+        {
+            keys[i + j] = ( (uint64_t)codes[j] << 32 ) | (uint64_t)( i + j );
+            ++histogram[codes[j] & ( SORT_RADIX - 1 )];
+        }
+    }
+    sortKeysScalar( centers, i, end, origin, scale, hilbert, keys, histogram );
+}
+
+#endif  // OPTIX_UTIL_SIMD_X86
+
+/// Sorts the indices of count points by curve index and writes them to permutation.
+inline void sortByCenters( const float*          centers,
+                           size_t                count,
+                           OptixUtilSpatialCurve curve,
+                           unsigned int*         permutation,
+                           OptixUtilSortScratch& scratch,
+                           unsigned int          maxThreads,
+                           OptixUtilSimdIsa      isa )
+{
+    const size_t numBlocks = ( count + SORT_BLOCK_SIZE - 1 ) / SORT_BLOCK_SIZE;
+
+    // Bounds of the centers, reduced per block and then serially.
+    std::vector<float>& blockBounds = scratch.blockBounds;
+    blockBounds.resize( numBlocks * 6 );
+    forEachSortBlock( count,
+                      [&]( size_t b, size_t begin, size_t end ) {
+                          float* box = &blockBounds[b * 6];
+                          std::fill( box, box + 3, INFINITY );
+                          std::fill( box + 3, box + 6, -INFINITY );
+                          centerBounds( centers, begin, end, box, box + 3 );
+                      },
+                      maxThreads );
+    float origin[3] = {INFINITY, INFINITY, INFINITY};
+    float scale[3]  = {-INFINITY, -INFINITY, -INFINITY};
+    for( size_t b = 0; b < numBlocks; ++b )
+    {
+        for( int k = 0; k < 3; ++k )
+        {
+            origin[k] = std::min( origin[k], blockBounds[b * 6 + k] );
+            scale[k]  = std::max( scale[k], blockBounds[b * 6 + 3 + k] );
+        }
+    }
+    for( int k = 0; k < 3; ++k )
+    {
+        const float extent = scale[k] - origin[k];
+        scale[k]           = extent > 0.0f && std::isfinite( extent ) ? 1024.0f / extent : 0.0f;
+        if( !std::isfinite( origin[k] ) )
+            origin[k] = 0.0f;
+    }
+
+    // Keys hold the curve index in the high and the point index in the low 32 bits, so one 8 byte move per pass
+    // carries both. The histograms of the first pass are counted while the keys are written.
+    std::vector<uint64_t>&     keys       = scratch.keys;
+    std::vector<uint64_t>&     keysAlt    = scratch.keysAlt;
+    std::vector<unsigned int>& histograms = scratch.histograms;
+    keys.resize( count );
+    keysAlt.resize( count );
+    histograms.resize( numBlocks * SORT_RADIX );
+    const bool hilbert = curve == OPTIX_UTIL_SPATIAL_CURVE_HILBERT;
+    forEachSortBlock( count,
+                      [&]( size_t b, size_t begin, size_t end ) {
+                          unsigned int* h = &histograms[b * SORT_RADIX];
+                          std::fill( h, h + SORT_RADIX, 0u );
+#if OPTIX_UTIL_SIMD_X86
+                          if( isa >= OPTIX_UTIL_SIMD_ISA_AVX2 )
+                          {
+                              sortKeysAvx2( centers, begin, end, origin, scale, hilbert, keys.data(), h );
+                              return;
+                          }
+#else
+                          (void)isa;
+#endif
+                          sortKeysScalar( centers, begin, end, origin, scale, hilbert, keys.data(), h );
+                      },
+                      maxThreads );
+
+    // LSD radix sort on the 30 bit curve index. The per block histograms are turned into scatter offsets in digit
+    // major order, which keeps the sort stable.
+    for( unsigned int shift = 32; shift < 32 + 3 * SORT_BITS_PER_AXIS; shift += SORT_RADIX_BITS )
+    {
+        if( shift != 32 )
+        {
+            forEachSortBlock( count,
+                              [&]( size_t b, size_t begin, size_t end ) {
+                                  unsigned int* h = &histograms[b * SORT_RADIX];
+                                  std::fill( h, h + SORT_RADIX, 0u );
+                                  for( size_t i = begin; i < end; ++i )
+                                      ++h[( keys[i] >> shift ) & ( SORT_RADIX - 1 )];
+                              },
+                              maxThreads );
+        }
+
+        bool         trivial = false;
+        unsigned int running = 0;
+        for( unsigned int d = 0; d < SORT_RADIX && !trivial; ++d )
+        {
+            const unsigned int start = running;
+            for( size_t b = 0; b < numBlocks; ++b )
+            {
+                const unsigned int n           = histograms[b * SORT_RADIX + d];
+                histograms[b * SORT_RADIX + d] = running;
+                running += n;
+            }
+            trivial = running - start == count;
+        }
+        if( trivial )
+            continue;
+
+        forEachSortBlock( count,
+                          [&]( size_t b, size_t begin, size_t end ) {
+                              unsigned int* offsets = &histograms[b * SORT_RADIX];
+                              for( size_t i = begin; i < end; ++i )
+                                  keysAlt[offsets[( keys[i] >> shift ) & ( SORT_RADIX - 1 )]++] = keys[i];
+                          },
+                          maxThreads );
+        keys.swap( keysAlt );
+    }
+
+    if( permutation )
+    {
+        forEachSortBlock( count,
+                          [&]( size_t, size_t begin, size_t end ) {
+                              for( size_t i = begin; i < end; ++i )
+                                  permutation[i] = (unsigned int)keys[i];
+                          },
+                          maxThreads );
+    }
+}
+
+}  // namespace optix_util_impl
+
+/// Computes the order of count points along a space filling curve through their common bounds.
+///
+/// \param[in]  centers       Points as x, y, z triples.
+/// \param[in]  count         Number of points, at most UINT_MAX.
+/// \param[in]  curve         Space filling curve.
+/// \param[out] permutation   Old index of each point in curve order, count elements.
+/// \param[in]  scratch       Optional scratch memory kept between calls.
+/// \param[in]  maxThreads    Upper bound on the number of threads, 0 for #optixUtilGetDefaultThreadCount().
+/// \param[in]  isa           Instruction set to use, see #optixUtilSelectSimdIsa().
+inline OptixResult optixUtilSortByCenters( const float*          centers,
+                                           size_t                count,
+                                           OptixUtilSpatialCurve curve,
+                                           unsigned int*         permutation,
+                                           OptixUtilSortScratch* scratch    = nullptr,
+                                           unsigned int          maxThreads = 0,
+                                           OptixUtilSimdIsa      isa        = OPTIX_UTIL_SIMD_ISA_AUTO )
+{
+    if( count > UINT_MAX || ( count && ( !centers || !permutation ) ) )
+        return OPTIX_ERROR_INVALID_VALUE;
+    if( curve != OPTIX_UTIL_SPATIAL_CURVE_MORTON && curve != OPTIX_UTIL_SPATIAL_CURVE_HILBERT )
+        return OPTIX_ERROR_INVALID_VALUE;
+    if( count < optix_util_impl::SORT_PARALLEL_THRESHOLD )
+        maxThreads = 1;
+
+    OptixUtilSortScratch localScratch;
+    optix_util_impl::sortByCenters( centers, count, curve, permutation, scratch ? *scratch : localScratch, maxThreads,
+                                    optixUtilSelectSimdIsa( isa ) );
+    return OPTIX_SUCCESS;
+}
+
+/// Reorders instances along a space filling curve through the world space centers of their children.
+///
+/// The center of an instance is its transform applied to the center of its child bounds. Without child bounds, or if
+/// the child bounds are empty, the translation of the transform is used.
+///
+/// \param[in]  instances     Instances to sort.
+/// \param[in]  count         Number of instances, at most UINT_MAX.
+/// \param[in]  childBounds   Optional object space bounds of the child of each instance.
+/// \param[in]  curve         Space filling curve.
+/// \param[out] sorted        Sorted instances, count elements. Must not overlap instances.
+/// \param[out] permutation   Optional old index of each instance in sorted, count elements.
+/// \param[in]  scratch       Optional scratch memory kept between calls.
+/// \param[in]  maxThreads    Upper bound on the number of threads, 0 for #optixUtilGetDefaultThreadCount().
+/// \param[in]  isa           Instruction set to use, see #optixUtilSelectSimdIsa().
+inline OptixResult optixUtilSortInstances( const OptixInstance*  instances,
+                                           size_t                count,
+                                           const OptixAabb*      childBounds,
+                                           OptixUtilSpatialCurve curve,
+                                           OptixInstance*        sorted,
+                                           unsigned int*         permutation = nullptr,
+                                           OptixUtilSortScratch* scratch     = nullptr,
+                                           unsigned int          maxThreads  = 0,
+                                           OptixUtilSimdIsa      isa         = OPTIX_UTIL_SIMD_ISA_AUTO )
+{
+    using namespace optix_util_impl;
+
+    if( count > UINT_MAX || ( count && ( !instances || !sorted ) ) )
+        return OPTIX_ERROR_INVALID_VALUE;
+    if( curve != OPTIX_UTIL_SPATIAL_CURVE_MORTON && curve != OPTIX_UTIL_SPATIAL_CURVE_HILBERT )
+        return OPTIX_ERROR_INVALID_VALUE;
+    if( count && sorted < instances + count && instances < sorted + count )
+        return OPTIX_ERROR_INVALID_VALUE;
+    if( count < SORT_PARALLEL_THRESHOLD )
+        maxThreads = 1;
+
+    OptixUtilSortScratch  localScratch;
+    OptixUtilSortScratch& s = scratch ? *scratch : localScratch;
+
+    s.centers.resize( count * 3 );
+    optixUtilParallelFor( count, SORT_BLOCK_SIZE,
+                          [&]( size_t begin, size_t end ) {
+                              for( size_t i = begin; i < end; ++i )
+                              {
+                                  const OptixAabb* box = childBounds ? &childBounds[i] : nullptr;
+                                  instanceCenter( instances[i], box, &s.centers[i * 3] );
+                              }
+                          },
+                          maxThreads );
+
+    // The sorted keys carry the old indices, so the gather reads them directly. The reads are random, so the
+    // instances a few iterations ahead are prefetched.
+    sortByCenters( s.centers.data(), count, curve, permutation, s, maxThreads, optixUtilSelectSimdIsa( isa ) );
+    const std::vector<uint64_t>& keys = s.keys;
+    optixUtilParallelFor( count, SORT_BLOCK_SIZE,
+                          [&]( size_t begin, size_t end ) {
+                              for( size_t i = begin; i < end; ++i )
+                              {
+#if OPTIX_UTIL_SIMD_X86
+                                  if( i + SORT_PREFETCH_DISTANCE < end )
+                                  {
+                                      const unsigned int j     = (unsigned int)keys[i + SORT_PREFETCH_DISTANCE];
+                                      const char*        ahead = (const char*)&instances[j];
+                                      _mm_prefetch( ahead, _MM_HINT_T0 );
+                                      _mm_prefetch( ahead + sizeof( OptixInstance ) - 1, _MM_HINT_T0 );
+                                  }
+#endif
+                                  sorted[i] = instances[(unsigned int)keys[i]];
+                              }
+                          },
+                          maxThreads );
+    return OPTIX_SUCCESS;
+}
+
+/// Reorders a per-instance array with a permutation from #optixUtilSortInstances() or #optixUtilSortByCenters(), i.e.,
+/// dst[i] = src[permutation[i]].
+///
+/// \param[in]  src           Array in the old order.
+/// \param[in]  permutation   Old index of each element, count elements.
+/// \param[in]  count         Number of elements.
+/// \param[out] dst           Array in the new order. Must not overlap src.
+/// \param[in]  maxThreads    Upper bound on the number of threads, 0 for #optixUtilGetDefaultThreadCount().
+template <typename T>
+inline OptixResult optixUtilApplyPermutation( const T*            src,
+                                              const unsigned int* permutation,
+                                              size_t              count,
+                                              T*                  dst,
+                                              unsigned int        maxThreads = 0 )
+{
+    if( count && ( !src || !permutation || !dst ) )
+        return OPTIX_ERROR_INVALID_VALUE;
+    if( count < optix_util_impl::SORT_PARALLEL_THRESHOLD )
+        maxThreads = 1;
+    for( size_t i = 0; i < count; ++i )
+        if( permutation[i] >= count )
+            return OPTIX_ERROR_INVALID_VALUE;
+
+    optixUtilParallelFor( count, optix_util_impl::SORT_BLOCK_SIZE,
+                          [&]( size_t begin, size_t end ) {
+                              for( size_t i = begin; i < end; ++i )
+                                  dst[i] = src[permutation[i]];
+                          },
+                          maxThreads );
+    return OPTIX_SUCCESS;
+}
+
+/*@}*/  // end group optix_utilities
+
+#endif  // __optix_optix_util_instance_sort_h__
@@ -0,0 +1,311 @@
+/// @file
+/// @brief  OptiX host utilities: incremental instance buffer updates
+///
+/// #OptixUtilInstanceStore is a host mirror of an #OptixBuildInputInstanceArray::instances buffer with a dirty bit per
+/// instance. Once per frame, #optixUtilPrepareInstanceUpload() does three things:
+///
+/// - it turns the dirty bits into a short list of byte ranges to copy to the device buffer,
+/// - it chooses between OPTIX_BUILD_OPERATION_UPDATE and OPTIX_BUILD_OPERATION_BUILD,
+/// - it clears the dirty bits and accumulates upload statistics.
+///
+/// Refitting keeps the hierarchy of the last build, so its quality degrades as instances move away from where they
+/// were at that build. The store estimates this from the world bounds of each instance at the last build and now.
+/// That needs the object space bounds of the instance children, see OptixUtilInstanceStore::setChildBounds().
+
+#ifndef __optix_optix_util_instance_update_h__
+#define __optix_optix_util_instance_update_h__
+
+#include "optix_util_motion_bounds.h"
+
+#include <optix_types.h>
+
+#include <chrono>
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+#include <vector>
+
+/** \addtogroup optix_utilities
+@{
+*/
+
+/// Byte range to copy from OptixUtilInstanceStore::data() to the device instance buffer at the same offset.
+struct OptixUtilCopyRange
+{
+    size_t offsetInBytes;
+    size_t sizeInBytes;
+};
+
+/// Thresholds for choosing between updating and rebuilding an IAS.
+struct OptixUtilInstanceUpdatePolicy
+{
+    /// Rebuild if more than this fraction of the instances changed. 0 selects 0.25.
+    float maxDirtyFraction;
+
+    /// Rebuild if the summed surface area of the per-instance unions of build-time and current world bounds exceeds
+    /// the summed build-time surface area by more than this fraction. 0 selects 0.5.
+    float maxBoundsGrowth;
+
+    /// Rebuild after this many consecutive updates. 0 means no limit.
+    unsigned int maxConsecutiveUpdates;
+
+    /// Dirty ranges separated by at most this many clean instances are merged into one copy, trading a few redundant
+    /// bytes for fewer copy calls.
+    unsigned int mergeGapInInstances;
+};
+
+/// Result of #optixUtilPrepareInstanceUpload().
+struct OptixUtilInstanceUploadReport
+{
+    /// Build operation to pass to optixAccelBuild().
+    OptixBuildOperation operation;
+    /// Number of instances changed since the previous call.
+    size_t numDirty;
+    /// numDirty relative to the instance count.
+    float dirtyFraction;
+    /// Bounds growth relative to the last build, see OptixUtilInstanceUpdatePolicy::maxBoundsGrowth.
+    float boundsGrowth;
+    /// Sum of the sizes of the copy ranges.
+    size_t bytesToUpload;
+    /// Host time spent in #optixUtilPrepareInstanceUpload().
+    double hostMilliseconds;
+};
+
+/// Upload statistics accumulated over all calls to #optixUtilPrepareInstanceUpload() on a store.
+struct OptixUtilInstanceUploadStats
+{
+    size_t numUpdates;
+    size_t numBuilds;
+    /// Bytes in the returned copy ranges.
+    size_t bytesUploaded;
+    /// Bytes that re-uploading the full buffer every time would have transferred.
+    size_t bytesFullUpload;
+    double hostMilliseconds;
+};
+
+/// Host mirror of an instance buffer with per-instance dirty tracking.
+class OptixUtilInstanceStore
+{
+  public:
+    /// Resizes the store. Contents of new instances are zero. The next upload is a full build.
+    void resize( size_t count )
+    {
+        m_instances.resize( count, OptixInstance() );
+        m_childBounds.resize( count, optix_util_impl::emptyAabb() );
+        m_buildBounds.resize( count, optix_util_impl::emptyAabb() );
+        m_unionArea.resize( count, 0.0 );
+        m_dirty.assign( ( count + 63 ) / 64, ~0ull );
+        m_resized = true;
+    }
+
+    size_t size() const { return m_instances.size(); }
+
+    const OptixInstance* data() const { return m_instances.data(); }
+
+    const OptixInstance& get( size_t i ) const { return m_instances[i]; }
+
+    /// Replaces instance i and marks it dirty if any byte changed.
+    void set( size_t i, const OptixInstance& instance )
+    {
+        if( std::memcmp( &m_instances[i], &instance, sizeof( OptixInstance ) ) != 0 )
+        {
+            m_instances[i] = instance;
+            markDirty( i );
+        }
+    }
+
+    /// Replaces the transform of instance i and marks it dirty if it changed.
+    void setTransform( size_t i, const float* m )
+    {
+        if( std::memcmp( m_instances[i].transform, m, sizeof( float ) * 12 ) != 0 )
+        {
+            std::memcpy( m_instances[i].transform, m, sizeof( float ) * 12 );
+            markDirty( i );
+        }
+    }
+
+    /// Sets the object space bounds of the child of instance i. Instances without child bounds do not contribute to
+    /// the bounds growth estimate.
+    void setChildBounds( size_t i, const OptixAabb& bounds )
+    {
+        m_childBounds[i] = bounds;
+        markDirty( i );
+    }
+
+    void markDirty( size_t i ) { m_dirty[i / 64] |= 1ull << ( i % 64 ); }
+
+    bool isDirty( size_t i ) const { return ( m_dirty[i / 64] >> ( i % 64 ) ) & 1ull; }
+
+    const OptixUtilInstanceUploadStats& stats() const { return m_stats; }
+
+  private:
+    friend OptixResult optixUtilPrepareInstanceUpload( OptixUtilInstanceStore&,
+                                                       const OptixUtilInstanceUpdatePolicy&,
+                                                       std::vector<OptixUtilCopyRange>&,
+                                                       OptixUtilInstanceUploadReport* );
+
+    std::vector<OptixInstance>   m_instances;
+    std::vector<OptixAabb>       m_childBounds;
+    std::vector<OptixAabb>       m_buildBounds;
+    std::vector<double>          m_unionArea;
+    std::vector<uint64_t>        m_dirty;
+    double                       m_buildArea          = 0.0;
+    double                       m_totalUnionArea     = 0.0;
+    unsigned int                 m_consecutiveUpdates = 0;
+    bool                         m_resized            = true;
+    OptixUtilInstanceUploadStats m_stats              = {};
+};
+
+namespace optix_util_impl {
+
+inline double aabbSurfaceArea( const OptixAabb& box )
+{
+    if( box.minX > box.maxX || box.minY > box.maxY || box.minZ > box.maxZ )
+        return 0.0;
+    const double dx = (double)box.maxX - box.minX;
+    const double dy = (double)box.maxY - box.minY;
+    const double dz = (double)box.maxZ - box.minZ;
+    return 2.0 * ( dx * dy + dy * dz + dz * dx );
+}
+
+inline OptixAabb instanceWorldBounds( const OptixInstance& instance, const OptixAabb& childBounds )
+{
+    if( childBounds.minX > childBounds.maxX )
+        return emptyAabb();
+    if( instance.flags & OPTIX_INSTANCE_FLAG_DISABLE_TRANSFORM )
+        return childBounds;
+    return transformAabb( instance.transform, childBounds );
+}
+
+}  // namespace optix_util_impl
+
+/// Prepares the upload of the changes since the previous call and chooses the build operation.
+///
+/// ranges receives the byte ranges of OptixUtilInstanceStore::data() to copy to the device instance buffer, sorted by
+/// offset. After a resize it is the whole buffer. All dirty bits are cleared, so the caller must perform the copies
+/// and the build before modifying the store again.
+///
+/// \param[in,out] store    Instance store.
+/// \param[in]     policy   Update-versus-rebuild thresholds.
+/// \param[out]    ranges   Byte ranges to copy.
+/// \param[out]    report   Optional details of the decision.
+inline OptixResult optixUtilPrepareInstanceUpload( OptixUtilInstanceStore&              store,
+                                                   const OptixUtilInstanceUpdatePolicy& policy,
+                                                   std::vector<OptixUtilCopyRange>&     ranges,
+                                                   OptixUtilInstanceUploadReport*       report = nullptr )
+{
+    using namespace optix_util_impl;
+
+    const auto   start = std::chrono::steady_clock::now();
+    const size_t count = store.size();
+    ranges.clear();
+
+    // Collect dirty runs and refresh the bounds growth estimate of dirty instances.
+    size_t numDirty = 0;
+    size_t runBegin = 0, runEnd = 0;
+    bool   inRun    = false;
+    for( size_t w = 0; w < store.m_dirty.size(); ++w )
+    {
+        const uint64_t bits = store.m_dirty[w];
+        for( size_t bit = 0; bits != 0 && bit < 64; ++bit )
+        {
+            const size_t i = w * 64 + bit;
+            if( !( ( bits >> bit ) & 1ull ) )
+                continue;
+            if( i >= count )
+                break;
+            ++numDirty;
+
+            const OptixAabb world = instanceWorldBounds( store.m_instances[i], store.m_childBounds[i] );
+            OptixAabb       both  = store.m_buildBounds[i];
+            growAabb( both, world );
+            store.m_totalUnionArea -= store.m_unionArea[i];
+            store.m_unionArea[i] = aabbSurfaceArea( both );
+            store.m_totalUnionArea += store.m_unionArea[i];
+
+            if( inRun && i <= runEnd + policy.mergeGapInInstances )
+            {
+                runEnd = i + 1;
+                continue;
+            }
+            if( inRun )
+                ranges.push_back( {runBegin * sizeof( OptixInstance ), ( runEnd - runBegin ) * sizeof( OptixInstance )} );
+            runBegin = i;
+            runEnd   = i + 1;
+            inRun    = true;
+        }
+    }
+    if( inRun )
+        ranges.push_back( {runBegin * sizeof( OptixInstance ), ( runEnd - runBegin ) * sizeof( OptixInstance )} );
+
+    const float maxDirtyFraction = policy.maxDirtyFraction > 0.f ? policy.maxDirtyFraction : 0.25f;
+    const float maxBoundsGrowth  = policy.maxBoundsGrowth > 0.f ? policy.maxBoundsGrowth : 0.5f;
+    const float dirtyFraction    = count ? (float)numDirty / (float)count : 0.f;
+    const float boundsGrowth =
+        store.m_buildArea > 0.0 ? (float)std::max( 0.0, store.m_totalUnionArea / store.m_buildArea - 1.0 ) : 0.f;
+
+    const bool rebuild = store.m_resized || dirtyFraction > maxDirtyFraction || boundsGrowth > maxBoundsGrowth
+                         || ( policy.maxConsecutiveUpdates && store.m_consecutiveUpdates >= policy.maxConsecutiveUpdates );
+
+    if( store.m_resized )
+    {
+        ranges.clear();
+        if( count )
+            ranges.push_back( {0, count * sizeof( OptixInstance )} );
+    }
+
+    if( rebuild )
+    {
+        // The new build starts from the current bounds.
+        store.m_buildArea = 0.0;
+        for( size_t i = 0; i < count; ++i )
+        {
+            store.m_buildBounds[i] = instanceWorldBounds( store.m_instances[i], store.m_childBounds[i] );
+            store.m_unionArea[i]   = aabbSurfaceArea( store.m_buildBounds[i] );
+            store.m_buildArea += store.m_unionArea[i];
+        }
+        store.m_totalUnionArea     = store.m_buildArea;
+        store.m_consecutiveUpdates = 0;
+        ++store.m_stats.numBuilds;
+    }
+    else
+    {
+        ++store.m_consecutiveUpdates;
+        ++store.m_stats.numUpdates;
+    }
+    std::fill( store.m_dirty.begin(), store.m_dirty.end(), 0ull );
+    store.m_resized = false;
+
+    size_t bytesToUpload = 0;
+    for( const OptixUtilCopyRange& range : ranges )
+        bytesToUpload += range.sizeInBytes;
+
+    const double ms = std::chrono::duration<double, std::milli>( std::chrono::steady_clock::now() - start ).count();
+    store.m_stats.bytesUploaded += bytesToUpload;
+    store.m_stats.bytesFullUpload += count * sizeof( OptixInstance );
+    store.m_stats.hostMilliseconds += ms;
+
+    if( report )
+    {
+        report->operation        = rebuild ? OPTIX_BUILD_OPERATION_BUILD : OPTIX_BUILD_OPERATION_UPDATE;
+        report->numDirty         = numDirty;
+        report->dirtyFraction    = dirtyFraction;
+        report->boundsGrowth     = boundsGrowth;
+        report->bytesToUpload    = bytesToUpload;
+        report->hostMilliseconds = ms;
+    }
+    return OPTIX_SUCCESS;
+}
+
+/// Estimates the transfer time saved by incremental uploads, in milliseconds, for a host-to-device bandwidth in bytes
+/// per second.
+inline double optixUtilEstimateUploadTimeSaved( const OptixUtilInstanceUploadStats& stats, double bytesPerSecond )
+{
+    if( bytesPerSecond <= 0.0 )
+        return 0.0;
+    return 1000.0 * (double)( stats.bytesFullUpload - stats.bytesUploaded ) / bytesPerSecond;
+}
+
+/*@}*/  // end group optix_utilities
+
+#endif  // __optix_optix_util_instance_update_h__
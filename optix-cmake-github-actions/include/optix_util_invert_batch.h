@@ -0,0 +1,455 @@
+/// @file
+/// @brief  OptiX host utilities: batched 3x4 affine matrix inversion
+///
+/// Computes inverse matrices, e.g. for #OptixStaticTransform::invTransform, 8 (AVX2) or 16 (AVX-512) matrices at a
+/// time and across threads for large batches. Unlike #optixUtilInvertMatrix(), near-singular matrices are detected
+/// and reported instead of producing inf or NaN.
+///
+/// A matrix is considered near-singular if |det| <= singularThreshold * |r0| * |r1| * |r2|, where ri are the rows of
+/// its linear 3x3 part. Both sides scale with the cube of a uniform scale and are compared without squaring, so the
+/// test flags degenerate shapes, not small or large ones, as long as det is a normal float (uniform scales between
+/// about 1e-12 and 1e12).
+
+#ifndef __optix_optix_util_invert_batch_h__
+#define __optix_optix_util_invert_batch_h__
+
+#include "optix_util_parallel.h"
+#include "optix_util_simd.h"
+#include "optix_util_transform.h"
+
+#include <algorithm>
+#include <atomic>
+#include <bitset>
+#include <cmath>
+#include <cstddef>
+
+/** \addtogroup optix_utilities
+@{
+*/
+
+/// Default relative determinant threshold below which a matrix is reported as near-singular.
+#define OPTIX_UTIL_DEFAULT_SINGULAR_THRESHOLD 1e-6f
+
+/// Structure-of-arrays view of 3x4 row-major matrices. element[k] points to row-major element k of all matrices.
+struct OptixUtilMatrixSoA
+{
+    float* element[12];
+};
+
+/// Error statistics of computed inverses with respect to a double precision reference.
+///
+/// \see #optixUtilMeasureInverseAccuracy()
+struct OptixUtilInverseAccuracyReport
+{
+    /// Number of matrices compared, i.e., not flagged as near-singular.
+    size_t numCompared;
+    /// Number of matrices skipped because they were flagged as near-singular.
+    size_t numSingular;
+    /// Largest absolute element error.
+    double maxAbsError;
+    /// Largest element error relative to max( 1, |reference element| ).
+    double maxRelError;
+    /// Mean absolute element error.
+    double meanAbsError;
+};
+
+namespace optix_util_impl {
+
+// Inverts the matrix in (row-major float[12]) into out. Returns false and writes zeros if it is near-singular.
+inline bool invertMatrixChecked( const float* m, float* out, float threshold )
+{
+    const float c00 = m[5] * m[10] - m[6] * m[9];
+    const float c01 = m[2] * m[9] - m[10] * m[1];
+    const float c02 = m[1] * m[6] - m[5] * m[2];
+    const float c10 = m[6] * m[8] - m[10] * m[4];
+    const float c11 = m[0] * m[10] - m[8] * m[2];
+    const float c12 = m[2] * m[4] - m[6] * m[0];
+    const float c20 = m[4] * m[9] - m[8] * m[5];
+    const float c21 = m[1] * m[8] - m[9] * m[0];
+    const float c22 = m[0] * m[5] - m[4] * m[1];
+
+    const float det = m[0] * c00 + m[1] * c10 + m[2] * c20;
+    const float n0  = m[0] * m[0] + m[1] * m[1] + m[2] * m[2];
+    const float n1  = m[4] * m[4] + m[5] * m[5] + m[6] * m[6];
+    const float n2  = m[8] * m[8] + m[9] * m[9] + m[10] * m[10];
+
+    // Written so that NaN input fails the test.
+    if( !( std::fabs( det ) > threshold * ( std::sqrt( n0 ) * std::sqrt( n1 ) * std::sqrt( n2 ) ) ) )
+    {
+        std::fill( out, out + 12, 0.0f );
+        return false;
+    }
+
+    const float inv = 1.0f / det;
+    const float b0 = m[3], b1 = m[7], b2 = m[11];
+    const float r[9] = {c00 * inv, c01 * inv, c02 * inv, c10 * inv, c11 * inv, c12 * inv, c20 * inv, c21 * inv, c22 * inv};
+    for( int i = 0; i < 3; ++i )
+    {
+        out[4 * i + 0] = r[3 * i + 0];
+        out[4 * i + 1] = r[3 * i + 1];
+        out[4 * i + 2] = r[3 * i + 2];
+        out[4 * i + 3] = -r[3 * i + 0] * b0 - r[3 * i + 1] * b1 - r[3 * i + 2] * b2;
+    }
+    return true;
+}
+
+#if OPTIX_UTIL_SIMD_X86
+
+// SIMD version of invertMatrixChecked() for 8 matrices. Returns a bit mask of near-singular lanes. Their outputs are
+// masked to zero at the end, since a zero inverse of the determinant still gives NaN for inf or NaN input.
+OPTIX_UTIL_TARGET_AVX2 inline unsigned int invertMatrices8Avx2( const __m256* m, __m256* out, __m256 threshold )
+{
+    const __m256 c00 = _mm256_sub_ps( _mm256_mul_ps( m[5], m[10] ), _mm256_mul_ps( m[6], m[9] ) );
+    const __m256 c01 = _mm256_sub_ps( _mm256_mul_ps( m[2], m[9] ), _mm256_mul_ps( m[10], m[1] ) );
+    const __m256 c02 = _mm256_sub_ps( _mm256_mul_ps( m[1], m[6] ), _mm256_mul_ps( m[5], m[2] ) );
+    const __m256 c10 = _mm256_sub_ps( _mm256_mul_ps( m[6], m[8] ), _mm256_mul_ps( m[10], m[4] ) );
+    const __m256 c11 = _mm256_sub_ps( _mm256_mul_ps( m[0], m[10] ), _mm256_mul_ps( m[8], m[2] ) );
+    const __m256 c12 = _mm256_sub_ps( _mm256_mul_ps( m[2], m[4] ), _mm256_mul_ps( m[6], m[0] ) );
+    const __m256 c20 = _mm256_sub_ps( _mm256_mul_ps( m[4], m[9] ), _mm256_mul_ps( m[8], m[5] ) );
+    const __m256 c21 = _mm256_sub_ps( _mm256_mul_ps( m[1], m[8] ), _mm256_mul_ps( m[9], m[0] ) );
+    const __m256 c22 = _mm256_sub_ps( _mm256_mul_ps( m[0], m[5] ), _mm256_mul_ps( m[4], m[1] ) );
+
+    const __m256 det = _mm256_add_ps( _mm256_add_ps( _mm256_mul_ps( m[0], c00 ), _mm256_mul_ps( m[1], c10 ) ),
+                                      _mm256_mul_ps( m[2], c20 ) );
+    const __m256 n0 = _mm256_add_ps( _mm256_add_ps( _mm256_mul_ps( m[0], m[0] ), _mm256_mul_ps( m[1], m[1] ) ),
+                                     _mm256_mul_ps( m[2], m[2] ) );
+    const __m256 n1 = _mm256_add_ps( _mm256_add_ps( _mm256_mul_ps( m[4], m[4] ), _mm256_mul_ps( m[5], m[5] ) ),
+                                     _mm256_mul_ps( m[6], m[6] ) );
+    const __m256 n2 = _mm256_add_ps( _mm256_add_ps( _mm256_mul_ps( m[8], m[8] ), _mm256_mul_ps( m[9], m[9] ) ),
+                                     _mm256_mul_ps( m[10], m[10] ) );
+
+    const __m256 absDet = _mm256_andnot_ps( _mm256_set1_ps( -0.0f ), det );
+    const __m256 norms =
+        _mm256_mul_ps( _mm256_mul_ps( _mm256_sqrt_ps( n0 ), _mm256_sqrt_ps( n1 ) ), _mm256_sqrt_ps( n2 ) );
+    const __m256 ok = _mm256_cmp_ps( absDet, _mm256_mul_ps( threshold, norms ), _CMP_GT_OQ );
+    const __m256 inv = _mm256_and_ps( ok, _mm256_div_ps( _mm256_set1_ps( 1.0f ), det ) );
+
+    const __m256 c[9] = {c00, c01, c02, c10, c11, c12, c20, c21, c22};
+    for( int i = 0; i < 3; ++i )
+    {
+        const __m256 r0 = _mm256_mul_ps( c[3 * i + 0], inv );
+        const __m256 r1 = _mm256_mul_ps( c[3 * i + 1], inv );
+        const __m256 r2 = _mm256_mul_ps( c[3 * i + 2], inv );
+        const __m256 t  = _mm256_sub_ps( _mm256_setzero_ps(),
+                                        _mm256_add_ps( _mm256_add_ps( _mm256_mul_ps( r0, m[3] ), _mm256_mul_ps( r1, m[7] ) ),
+                                                       _mm256_mul_ps( r2, m[11] ) ) );
+        out[4 * i + 0]  = _mm256_and_ps( ok, r0 );
+        out[4 * i + 1]  = _mm256_and_ps( ok, r1 );
+        out[4 * i + 2]  = _mm256_and_ps( ok, r2 );
+        out[4 * i + 3]  = _mm256_and_ps( ok, t );
+    }
+    return ~(unsigned int)_mm256_movemask_ps( ok ) & 0xffu;
+}
+
+OPTIX_UTIL_TARGET_AVX2 inline size_t invertRangeAvx2( const OptixUtilMatrixSoA& in,
+                                                      const OptixUtilMatrixSoA& out,
+                                                      size_t                    begin,
+                                                      size_t                    end,
+                                                      unsigned char*            singularFlags,
+                                                      size_t&                   numSingular,
+                                                      float                     threshold )
+{
+    const __m256 t = _mm256_set1_ps( threshold );
+    size_t       i = begin;
+    for( ; i + 8 <= end; i += 8 )
+    {
+        __m256 m[12], r[12];
+        for( int k = 0; k < 12; ++k )
+            m[k] = _mm256_loadu_ps( in.element[k] + i );
+        const unsigned int singular = invertMatrices8Avx2( m, r, t );
+        for( int k = 0; k < 12; ++k )
+            _mm256_storeu_ps( out.element[k] + i, r[k] );
+
+        numSingular += std::bitset<16>( singular ).count();
+        if( singularFlags )
+            for( int l = 0; l < 8; ++l )
+                singularFlags[i + l] = (unsigned char)( ( singular >> l ) & 1u );
+    }
+    return i;
+}
+
+// AVX-512 version of invertMatrices8Avx2().
+OPTIX_UTIL_TARGET_AVX512 inline unsigned int invertMatrices16Avx512( const __m512* m, __m512* out, __m512 threshold )
+{
+    const __m512 c00 = _mm512_sub_ps( _mm512_mul_ps( m[5], m[10] ), _mm512_mul_ps( m[6], m[9] ) );
+    const __m512 c01 = _mm512_sub_ps( _mm512_mul_ps( m[2], m[9] ), _mm512_mul_ps( m[10], m[1] ) );
+    const __m512 c02 = _mm512_sub_ps( _mm512_mul_ps( m[1], m[6] ), _mm512_mul_ps( m[5], m[2] ) );
+    const __m512 c10 = _mm512_sub_ps( _mm512_mul_ps( m[6], m[8] ), _mm512_mul_ps( m[10], m[4] ) );
+    const __m512 c11 = _mm512_sub_ps( _mm512_mul_ps( m[0], m[10] ), _mm512_mul_ps( m[8], m[2] ) );
+    const __m512 c12 = _mm512_sub_ps( _mm512_mul_ps( m[2], m[4] ), _mm512_mul_ps( m[6], m[0] ) );
+    const __m512 c20 = _mm512_sub_ps( _mm512_mul_ps( m[4], m[9] ), _mm512_mul_ps( m[8], m[5] ) );
+    const __m512 c21 = _mm512_sub_ps( _mm512_mul_ps( m[1], m[8] ), _mm512_mul_ps( m[9], m[0] ) );
+    const __m512 c22 = _mm512_sub_ps( _mm512_mul_ps( m[0], m[5] ), _mm512_mul_ps( m[4], m[1] ) );
+
+    const __m512 det = _mm512_add_ps( _mm512_add_ps( _mm512_mul_ps( m[0], c00 ), _mm512_mul_ps( m[1], c10 ) ),
+                                      _mm512_mul_ps( m[2], c20 ) );
+    const __m512 n0 = _mm512_add_ps( _mm512_add_ps( _mm512_mul_ps( m[0], m[0] ), _mm512_mul_ps( m[1], m[1] ) ),
+                                     _mm512_mul_ps( m[2], m[2] ) );
+    const __m512 n1 = _mm512_add_ps( _mm512_add_ps( _mm512_mul_ps( m[4], m[4] ), _mm512_mul_ps( m[5], m[5] ) ),
+                                     _mm512_mul_ps( m[6], m[6] ) );
+    const __m512 n2 = _mm512_add_ps( _mm512_add_ps( _mm512_mul_ps( m[8], m[8] ), _mm512_mul_ps( m[9], m[9] ) ),
+                                     _mm512_mul_ps( m[10], m[10] ) );
+
+    // The zero-masked square root has no undefined pass-through operand, which GCC flags as maybe uninitialized.
+    const __mmask16 all   = 0xffff;
+    const __m512    s0    = _mm512_maskz_sqrt_ps( all, n0 );
+    const __m512    s1    = _mm512_maskz_sqrt_ps( all, n1 );
+    const __m512    s2    = _mm512_maskz_sqrt_ps( all, n2 );
+    const __m512    norms = _mm512_mul_ps( _mm512_mul_ps( s0, s1 ), s2 );
+    const __mmask16 ok    = _mm512_cmp_ps_mask( _mm512_abs_ps( det ), _mm512_mul_ps( threshold, norms ), _CMP_GT_OQ );
+    const __m512 inv = _mm512_maskz_div_ps( ok, _mm512_set1_ps( 1.0f ), det );
+
+    const __m512 c[9] = {c00, c01, c02, c10, c11, c12, c20, c21, c22};
+    for( int i = 0; i < 3; ++i )
+    {
+        const __m512 r0 = _mm512_mul_ps( c[3 * i + 0], inv );
+        const __m512 r1 = _mm512_mul_ps( c[3 * i + 1], inv );
+        const __m512 r2 = _mm512_mul_ps( c[3 * i + 2], inv );
+        const __m512 t  = _mm512_sub_ps( _mm512_setzero_ps(),
+                                        _mm512_add_ps( _mm512_add_ps( _mm512_mul_ps( r0, m[3] ), _mm512_mul_ps( r1, m[7] ) ),
+                                                       _mm512_mul_ps( r2, m[11] ) ) );
+        out[4 * i + 0]  = _mm512_maskz_mov_ps( ok, r0 );
+        out[4 * i + 1]  = _mm512_maskz_mov_ps( ok, r1 );
+        out[4 * i + 2]  = _mm512_maskz_mov_ps( ok, r2 );
+        out[4 * i + 3]  = _mm512_maskz_mov_ps( ok, t );
+    }
+    return ~(unsigned int)ok & 0xffffu;
+}
+
+OPTIX_UTIL_TARGET_AVX512 inline size_t invertRangeAvx512( const OptixUtilMatrixSoA& in,
+                                                          const OptixUtilMatrixSoA& out,
+                                                          size_t                    begin,
+                                                          size_t                    end,
+                                                          unsigned char*            singularFlags,
+                                                          size_t&                   numSingular,
+                                                          float                     threshold )
+{
+    const __m512 t = _mm512_set1_ps( threshold );
+    size_t       i = begin;
+    for( ; i + 16 <= end; i += 16 )
+    {
+        __m512 m[12], r[12];
+        for( int k = 0; k < 12; ++k )
+            m[k] = _mm512_loadu_ps( in.element[k] + i );
+        const unsigned int singular = invertMatrices16Avx512( m, r, t );
+        for( int k = 0; k < 12; ++k )
+            _mm512_storeu_ps( out.element[k] + i, r[k] );
+
+        numSingular += std::bitset<16>( singular ).count();
+        if( singularFlags )
+            for( int l = 0; l < 16; ++l )
+                singularFlags[i + l] = (unsigned char)( ( singular >> l ) & 1u );
+    }
+    return i;
+}
+
+#endif  // OPTIX_UTIL_SIMD_X86
+
+// Inverts matrices [begin, end) and returns the number of near-singular ones.
+inline size_t invertRange( const OptixUtilMatrixSoA& in,
+                           const OptixUtilMatrixSoA& out,
+                           size_t                    begin,
+                           size_t                    end,
+                           unsigned char*            singularFlags,
+                           float                     threshold,
+                           OptixUtilSimdIsa          isa )
+{
+    size_t numSingular = 0;
+    size_t i           = begin;
+#if OPTIX_UTIL_SIMD_X86
+    if( isa == OPTIX_UTIL_SIMD_ISA_AVX512 )
+        i = invertRangeAvx512( in, out, begin, end, singularFlags, numSingular, threshold );
+    else if( isa == OPTIX_UTIL_SIMD_ISA_AVX2 )
+        i = invertRangeAvx2( in, out, begin, end, singularFlags, numSingular, threshold );
+#else
+    (void)isa;
+#endif
+
+    for( ; i < end; ++i )
+    {
+        float m[12], r[12];
+        for( int k = 0; k < 12; ++k )
+            m[k] = in.element[k][i];
+        const bool ok = invertMatrixChecked( m, r, threshold );
+        for( int k = 0; k < 12; ++k )
+            out.element[k][i] = r[k];
+
+        numSingular += ok ? 0 : 1;
+        if( singularFlags )
+            singularFlags[i] = ok ? 0 : 1;
+    }
+    return numSingular;
+}
+
+// Batches below this size are inverted on the calling thread only.
+const size_t INVERT_PARALLEL_THRESHOLD = 1 << 16;
+const size_t INVERT_GRAIN_SIZE         = 1 << 14;
+
+}  // namespace optix_util_impl
+
+/// Inverts count 3x4 matrices stored as structure of arrays.
+///
+/// Near-singular matrices get an all-zero inverse and are reported through singularFlags and numSingular. matrices
+/// and inverses may be the same arrays for in-place inversion; otherwise they must not overlap.
+///
+/// \param[in]  matrices            Input matrices.
+/// \param[out] inverses            Output matrices.
+/// \param[in]  count               Number of matrices.
+/// \param[out] singularFlags       Optional array of count bytes, set to 1 for near-singular matrices and 0 otherwise.
+/// \param[out] numSingular         Optional number of near-singular matrices.
+/// \param[in]  singularThreshold   Relative determinant threshold, see the file description.
+/// \param[in]  maxThreads          Upper bound on worker threads for large batches, 0 for automatic.
+/// \param[in]  isa                 Instruction set to use, see #optixUtilSelectSimdIsa().
+inline OptixResult optixUtilInvertMatrixBatch( const OptixUtilMatrixSoA& matrices,
+                                               const OptixUtilMatrixSoA& inverses,
+                                               size_t                    count,
+                                               unsigned char*            singularFlags     = nullptr,
+                                               size_t*                   numSingular       = nullptr,
+                                               float                     singularThreshold = OPTIX_UTIL_DEFAULT_SINGULAR_THRESHOLD,
+                                               unsigned int              maxThreads        = 0,
+                                               OptixUtilSimdIsa          isa               = OPTIX_UTIL_SIMD_ISA_AUTO )
+{
+    if( numSingular )
+        *numSingular = 0;
+    if( count == 0 )
+        return OPTIX_SUCCESS;
+    if( !( singularThreshold >= 0.0f ) )
+        return OPTIX_ERROR_INVALID_VALUE;
+    for( int k = 0; k < 12; ++k )
+        if( !matrices.element[k] || !inverses.element[k] )
+            return OPTIX_ERROR_INVALID_VALUE;
+
+    const OptixUtilSimdIsa selected = optixUtilSelectSimdIsa( isa );
+    if( count < optix_util_impl::INVERT_PARALLEL_THRESHOLD )
+        maxThreads = 1;
+
+    std::atomic<size_t> singular( 0 );
+    optixUtilParallelFor( count, optix_util_impl::INVERT_GRAIN_SIZE,
+                          [&]( size_t begin, size_t end ) {
+                              singular += optix_util_impl::invertRange( matrices, inverses, begin, end, singularFlags,
+                                                                        singularThreshold, selected );
+                          },
+                          maxThreads );
+
+    if( numSingular )
+        *numSingular = singular;
+    return OPTIX_SUCCESS;
+}
+
+/// Fills #OptixStaticTransform::invTransform from #OptixStaticTransform::transform for count transforms.
+///
+/// Uses the same kernels as #optixUtilInvertMatrixBatch() on small staged blocks. See there for the parameters.
+inline OptixResult optixUtilComputeStaticTransformInverses( OptixStaticTransform* transforms,
+                                                            size_t                count,
+                                                            unsigned char*        singularFlags     = nullptr,
+                                                            size_t*               numSingular       = nullptr,
+                                                            float                 singularThreshold = OPTIX_UTIL_DEFAULT_SINGULAR_THRESHOLD,
+                                                            unsigned int          maxThreads        = 0,
+                                                            OptixUtilSimdIsa      isa = OPTIX_UTIL_SIMD_ISA_AUTO )
+{
+    if( numSingular )
+        *numSingular = 0;
+    if( count == 0 )
+        return OPTIX_SUCCESS;
+    if( !transforms || !( singularThreshold >= 0.0f ) )
+        return OPTIX_ERROR_INVALID_VALUE;
+
+    const OptixUtilSimdIsa selected = optixUtilSelectSimdIsa( isa );
+    if( count < optix_util_impl::INVERT_PARALLEL_THRESHOLD )
+        maxThreads = 1;
+
+    std::atomic<size_t> singular( 0 );
+    optixUtilParallelFor( count, optix_util_impl::INVERT_GRAIN_SIZE,
+                          [&]( size_t begin, size_t end ) {
+                              const size_t BLOCK = 64;
+                              float        in[12][BLOCK];
+                              float        out[12][BLOCK];
+                              OptixUtilMatrixSoA inSoA, outSoA;
+                              for( int k = 0; k < 12; ++k )
+                              {
+                                  inSoA.element[k]  = in[k];
+                                  outSoA.element[k] = out[k];
+                              }
+
+                              size_t localSingular = 0;
+                              for( size_t b = begin; b < end; b += BLOCK )
+                              {
+                                  const size_t n = std::min( BLOCK, end - b );
+                                  for( size_t i = 0; i < n; ++i )
+                                      for( int k = 0; k < 12; ++k )
+                                          in[k][i] = transforms[b + i].transform[k];
+
+                                  localSingular += optix_util_impl::invertRange(
+                                      inSoA, outSoA, 0, n, singularFlags ? singularFlags + b : nullptr, singularThreshold,
+                                      selected );
+
+                                  for( size_t i = 0; i < n; ++i )
+                                      for( int k = 0; k < 12; ++k )
+                                          transforms[b + i].invTransform[k] = out[k][i];
+                              }
+                              singular += localSingular;
+                          },
+                          maxThreads );
+
+    if( numSingular )
+        *numSingular = singular;
+    return OPTIX_SUCCESS;
+}
+
+/// Compares inverses computed by #optixUtilInvertMatrixBatch() with a double precision cofactor inverse of matrices.
+///
+/// Matrices flagged in singularFlags (may be NULL) are skipped.
+inline OptixResult optixUtilMeasureInverseAccuracy( const OptixUtilMatrixSoA&       matrices,
+                                                    const OptixUtilMatrixSoA&       inverses,
+                                                    size_t                          count,
+                                                    const unsigned char*            singularFlags,
+                                                    OptixUtilInverseAccuracyReport* report )
+{
+    if( !report )
+        return OPTIX_ERROR_INVALID_VALUE;
+    *report = {};
+
+    double sumAbsError = 0.0;
+    for( size_t i = 0; i < count; ++i )
+    {
+        if( singularFlags && singularFlags[i] )
+        {
+            ++report->numSingular;
+            continue;
+        }
+
+        double m[12];
+        for( int k = 0; k < 12; ++k )
+            m[k] = matrices.element[k][i];
+
+        const double c[9] = {m[5] * m[10] - m[6] * m[9], m[2] * m[9] - m[10] * m[1], m[1] * m[6] - m[5] * m[2],
+                             m[6] * m[8] - m[10] * m[4], m[0] * m[10] - m[8] * m[2], m[2] * m[4] - m[6] * m[0],
+                             m[4] * m[9] - m[8] * m[5], m[1] * m[8] - m[9] * m[0], m[0] * m[5] - m[4] * m[1]};
+        const double inv = 1.0 / ( m[0] * c[0] + m[1] * c[3] + m[2] * c[6] );
+
+        for( int r = 0; r < 3; ++r )
+        {
+            double ref[4];
+            ref[0] = c[3 * r + 0] * inv;
+            ref[1] = c[3 * r + 1] * inv;
+            ref[2] = c[3 * r + 2] * inv;
+            ref[3] = -( ref[0] * m[3] + ref[1] * m[7] + ref[2] * m[11] );
+            for( int k = 0; k < 4; ++k )
+            {
+                const double absError = std::fabs( (double)inverses.element[4 * r + k][i] - ref[k] );
+                report->maxAbsError   = std::max( report->maxAbsError, absError );
+                report->maxRelError   = std::max( report->maxRelError, absError / std::max( 1.0, std::fabs( ref[k] ) ) );
+                sumAbsError += absError;
+            }
+        }
+        ++report->numCompared;
+    }
+
+    if( report->numCompared )
+        report->meanAbsError = sumAbsError / ( 12.0 * (double)report->numCompared );
+    return OPTIX_SUCCESS;
+}
+
+/*@}*/  // end group optix_utilities
+
+#endif  // __optix_optix_util_invert_batch_h__
@@ -0,0 +1,682 @@
+/// @file
+/// @brief  OptiX host utilities: spatial partitioning of large triangle meshes into several GAS
+///
+/// A single build input for a huge mesh gives one monolithic GAS, which is built on one stream and can only be updated
+/// as a whole. #optixUtilPartitionMesh() splits the triangles of a mesh into spatially coherent partitions:
+///
+/// - triangle centroids are mapped to cells of a 64^3 grid over the mesh, ordered along a Hilbert curve,
+/// - the cell histogram is cut into ranges of about equal triangle counts, one per partition,
+/// - triangles are scattered into the partitions in input order, in parallel.
+///
+/// Partitions share the vertex buffer of the mesh and use 32-bit indices into it. Each partition is one GAS, and
+/// #optixUtilBuildPartitionedAccel() builds and compacts all of them in one batch and puts an IAS over them.
+/// #optixUtilUpdatePartitionedAccel() refits only the partitions whose vertices moved, and then the IAS.
+///
+/// Triangles are reordered, so the build inputs set #OptixBuildInputTriangleArray::primitiveIndexOffset to the first
+/// triangle of their partition. optixGetPrimitiveIndex() then returns the index into
+/// OptixUtilPartitionedMesh::triangleIds, which maps back to the input triangle.
+///
+/// #optixUtilChoosePartitionCount() picks the number of partitions from the triangle count and how often the mesh is
+/// updated: static meshes get few large partitions for the best trace performance, deforming meshes many small ones
+/// that are cheap to refit.
+
+#ifndef __optix_optix_util_mesh_partition_h__
+#define __optix_optix_util_mesh_partition_h__
+
+#include "optix_util_accel_compact.h"
+#include "optix_util_instance_sort.h"
+#include "optix_util_instance_update.h"
+#include "optix_util_mesh_prep.h"
+#include "optix_util_motion_bounds.h"
+#include "optix_util_parallel.h"
+
+#include <optix_function_table.h>
+#include <optix_types.h>
+
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+/** \addtogroup optix_utilities
+@{
+*/
+
+/// Policy of #optixUtilChoosePartitionCount().
+struct OptixUtilPartitionPolicy
+{
+    /// Triangles per partition of a mesh that is never updated. 0 selects 1 << 24.
+    unsigned int staticTrianglesPerPartition;
+    /// Triangles per partition of a mesh that is updated every frame. 0 selects 1 << 20.
+    unsigned int dynamicTrianglesPerPartition;
+    /// Fraction of frames in which the mesh is updated, in [0, 1]. The partition size is interpolated geometrically
+    /// between the static and the dynamic size.
+    float updateFrequency;
+    /// Lower bound on the number of partitions, e.g., the number of build streams. 0 selects 1.
+    unsigned int minPartitions;
+    /// Upper bound on the triangles of one partition, e.g., OPTIX_DEVICE_PROPERTY_LIMIT_MAX_PRIMITIVES_PER_GAS.
+    /// 0 selects 1 << 28.
+    unsigned int maxTrianglesPerPartition;
+};
+
+/// Range of triangles of an #OptixUtilPartitionedMesh that is built as one GAS.
+struct OptixUtilMeshPartition
+{
+    unsigned int firstTriangle;
+    unsigned int numTriangles;
+    OptixAabb    bounds;
+};
+
+/// Output of #optixUtilPartitionMesh().
+struct OptixUtilPartitionedMesh
+{
+    /// Triplets of vertex indices into the input vertices. Triangles of each partition are contiguous.
+    std::vector<unsigned int> indices;
+    /// Input triangle index of each triangle.
+    std::vector<unsigned int>           triangleIds;
+    std::vector<OptixUtilMeshPartition> partitions;
+    /// Vertex count and stride of the input.
+    unsigned int numVertices;
+    unsigned int vertexStrideInBytes;
+    /// Vertex buffer pointer referenced by the build inputs of #optixUtilGetPartitionBuildInputs().
+    CUdeviceptr vertexBuffer;
+};
+
+/// Result of #optixUtilPartitionMesh().
+struct OptixUtilMeshPartitionReport
+{
+    unsigned int numTriangles;
+    /// Number of partitions, which can be below the requested number if the triangles fall into few grid cells.
+    unsigned int numPartitions;
+    unsigned int minPartitionTriangles;
+    unsigned int maxPartitionTriangles;
+    /// Sum of the surface areas of the partition bounds over the surface area of the mesh bounds. Lower is better, a
+    /// perfect split of a compact mesh into K slabs gives about 1 + (K - 1) / 3.
+    float surfaceAreaRatio;
+    double seconds;
+};
+
+namespace optix_util_impl {
+
+/// Bits per axis of the partitioning grid. The top bits of the Hilbert index identify the grid cell.
+const unsigned int PARTITION_BITS_PER_AXIS = 6;
+const unsigned int PARTITION_NUM_CELLS     = 1u << ( 3 * PARTITION_BITS_PER_AXIS );
+
+/// Triangles per parallel task. Each task has its own cell histogram.
+const size_t PARTITION_TASK_SIZE = 1u << 20;
+
+/// Checks that the vertex indices of a triangle are below the vertex count.
+inline bool validTriangle( const OptixUtilMeshInput& mesh, size_t triangle )
+{
+    if( !mesh.indices )
+        return true;
+    const unsigned int* t = mesh.indices + triangle * 3;
+    return t[0] < mesh.numVertices && t[1] < mesh.numVertices && t[2] < mesh.numVertices;
+}
+
+inline void triangleBounds( const OptixUtilMeshInput& mesh, size_t triangle, OptixAabb& box )
+{
+    box = emptyAabb();
+    for( int corner = 0; corner < 3; ++corner )
+    {
+        const float* v = meshVertex( mesh, meshIndex( mesh, triangle, corner ) );
+        box.minX       = std::min( box.minX, v[0] );
+        box.minY       = std::min( box.minY, v[1] );
+        box.minZ       = std::min( box.minZ, v[2] );
+        box.maxX       = std::max( box.maxX, v[0] );
+        box.maxY       = std::max( box.maxY, v[1] );
+        box.maxZ       = std::max( box.maxZ, v[2] );
+    }
+}
+
+/// Grid cell of a triangle, as the Hilbert index of its centroid. Uses the bounds of the triangle, which are needed
+/// for the partition bounds anyway. The leading bits of a Hilbert index only depend on the leading bits of the
+/// coordinates, so large meshes look the cell up in a table from #partitionCellTable().
+inline uint32_t partitionCell( const OptixAabb& box,
+                               const float      origin[3],
+                               const float      scale[3],
+                               const uint32_t*  table )
+{
+    const uint32_t x     = quantizeAxis( 0.5f * ( box.minX + box.maxX ), origin[0], scale[0] );
+    const uint32_t y     = quantizeAxis( 0.5f * ( box.minY + box.maxY ), origin[1], scale[1] );
+    const uint32_t z     = quantizeAxis( 0.5f * ( box.minZ + box.maxZ ), origin[2], scale[2] );
+    const uint32_t shift = SORT_BITS_PER_AXIS - PARTITION_BITS_PER_AXIS;
+    if( table )
+        return table[( x >> shift ) << ( 2 * PARTITION_BITS_PER_AXIS ) | ( y >> shift ) << PARTITION_BITS_PER_AXIS
+                     | z >> shift];
+    return hilbertCode( x, y, z ) >> ( 3 * shift );
+}
+
+/// Hilbert index of every grid cell, indexed by x, y and z concatenated.
+inline void partitionCellTable( std::vector<uint32_t>& table, unsigned int maxThreads )
+{
+    const uint32_t shift = SORT_BITS_PER_AXIS - PARTITION_BITS_PER_AXIS;
+    const uint32_t mask  = ( 1u << PARTITION_BITS_PER_AXIS ) - 1;
+    table.resize( PARTITION_NUM_CELLS );
+    optixUtilParallelFor( PARTITION_NUM_CELLS, 4096,
+                          [&]( size_t first, size_t last ) {
+                              for( size_t c = first; c < last; ++c )
+                              {
+                                  const uint32_t x = (uint32_t)c >> ( 2 * PARTITION_BITS_PER_AXIS );
+                                  const uint32_t y = ( (uint32_t)c >> PARTITION_BITS_PER_AXIS ) & mask;
+                                  const uint32_t z = (uint32_t)c & mask;
+                                  table[c] = hilbertCode( x << shift, y << shift, z << shift ) >> ( 3 * shift );
+                              }
+                          },
+                          maxThreads );
+}
+
+}  // namespace optix_util_impl
+
+/// Picks the number of partitions of a mesh, see #OptixUtilPartitionPolicy.
+///
+/// \param[in] numTriangles   Number of triangles of the mesh.
+/// \param[in] policy         Policy.
+inline unsigned int optixUtilChoosePartitionCount( unsigned int numTriangles, const OptixUtilPartitionPolicy& policy )
+{
+    const double staticSize  = policy.staticTrianglesPerPartition ? policy.staticTrianglesPerPartition : 1 << 24;
+    const double dynamicSize = policy.dynamicTrianglesPerPartition ? policy.dynamicTrianglesPerPartition : 1 << 20;
+    const double maxSize     = policy.maxTrianglesPerPartition ? policy.maxTrianglesPerPartition : 1 << 28;
+    const double frequency   = std::min( std::max( (double)policy.updateFrequency, 0.0 ), 1.0 );
+
+    const double logSize = ( 1.0 - frequency ) * std::log( staticSize ) + frequency * std::log( dynamicSize );
+    const double target  = std::min( std::exp( logSize ), maxSize );
+    double       count   = std::ceil( numTriangles / target );
+    count                = std::max( count, std::ceil( numTriangles / maxSize ) );
+    count                = std::max( count, (double)std::max( policy.minPartitions, 1u ) );
+    count                = std::min( count, (double)std::max( numTriangles, 1u ) );
+    return (unsigned int)std::min( count, (double)optix_util_impl::PARTITION_NUM_CELLS );
+}
+
+/// Splits the triangles of a mesh into spatially coherent partitions of about equal size.
+///
+/// \param[in]  mesh            Mesh, with or without indices. Returns OPTIX_ERROR_INVALID_VALUE if an index is not
+///                             below the vertex count, or if a mesh without indices has too few vertices.
+/// \param[in]  numPartitions   Requested number of partitions, e.g., from #optixUtilChoosePartitionCount(). At most
+///                             2^18.
+/// \param[out] partitioned     Partitioned mesh. Existing contents are replaced.
+/// \param[out] report          Optional partition statistics.
+/// \param[in]  maxThreads      Upper bound on the number of threads, 0 for #optixUtilGetDefaultThreadCount().
+inline OptixResult optixUtilPartitionMesh( const OptixUtilMeshInput&     mesh,
+                                           unsigned int                  numPartitions,
+                                           OptixUtilPartitionedMesh&     partitioned,
+                                           OptixUtilMeshPartitionReport* report     = nullptr,
+                                           unsigned int                  maxThreads = 0 )
+{
+    using namespace optix_util_impl;
+
+    if( !mesh.vertices || numPartitions == 0 || numPartitions > PARTITION_NUM_CELLS
+        || ( mesh.vertexStrideInBytes && mesh.vertexStrideInBytes < 3 * sizeof( float ) ) )
+        return OPTIX_ERROR_INVALID_VALUE;
+    if( !mesh.indices && (size_t)mesh.numTriangles * 3 > mesh.numVertices )
+        return OPTIX_ERROR_INVALID_VALUE;
+    const auto   start        = std::chrono::steady_clock::now();
+    const size_t numTriangles = mesh.numTriangles;
+    const size_t numTasks     = std::max<size_t>( ( numTriangles + PARTITION_TASK_SIZE - 1 ) / PARTITION_TASK_SIZE, 1 );
+    if( numTriangles < MESH_PARALLEL_THRESHOLD )
+        maxThreads = 1;
+
+    // The grid spans the vertex bounds, which reads the vertices in order instead of through the indices. Centroids
+    // are within these bounds, and the grid only gets coarser if the mesh has unused vertices far away.
+    const size_t           numVertices    = mesh.numVertices;
+    const size_t           numVertexTasks = ( numVertices + PARTITION_TASK_SIZE - 1 ) / PARTITION_TASK_SIZE;
+    std::vector<OptixAabb> taskBounds( numVertexTasks, emptyAabb() );
+    optixUtilParallelFor( numVertexTasks, 1,
+                          [&]( size_t first, size_t last ) {
+                              for( size_t t = first; t < last; ++t )
+                              {
+                                  const size_t end = std::min( ( t + 1 ) * PARTITION_TASK_SIZE, numVertices );
+                                  OptixAabb&   c   = taskBounds[t];
+                                  for( size_t i = t * PARTITION_TASK_SIZE; i < end; ++i )
+                                  {
+                                      const float* v = meshVertex( mesh, (unsigned int)i );
+                                      c.minX         = std::min( c.minX, v[0] );
+                                      c.minY         = std::min( c.minY, v[1] );
+                                      c.minZ         = std::min( c.minZ, v[2] );
+                                      c.maxX         = std::max( c.maxX, v[0] );
+                                      c.maxY         = std::max( c.maxY, v[1] );
+                                      c.maxZ         = std::max( c.maxZ, v[2] );
+                                  }
+                              }
+                          },
+                          numVertices < MESH_PARALLEL_THRESHOLD ? 1 : maxThreads );
+    OptixAabb vertexBounds = emptyAabb();
+    for( const OptixAabb& box : taskBounds )
+        growAabb( vertexBounds, box );
+    const float lo[3] = {vertexBounds.minX, vertexBounds.minY, vertexBounds.minZ};
+    const float hi[3] = {vertexBounds.maxX, vertexBounds.maxY, vertexBounds.maxZ};
+    float       origin[3], scale[3];
+    for( int k = 0; k < 3; ++k )
+    {
+        const float extent = hi[k] - lo[k];
+        origin[k]          = std::isfinite( lo[k] ) ? lo[k] : 0.0f;
+        scale[k]           = extent > 0.0f && std::isfinite( extent ) ? 1024.0f / extent : 0.0f;
+    }
+
+    std::vector<uint32_t> cellTable;
+    if( numTriangles >= PARTITION_NUM_CELLS )
+        partitionCellTable( cellTable, maxThreads );
+    const uint32_t* table = cellTable.empty() ? nullptr : cellTable.data();
+
+    // Cell histogram, one per task, summed into the first. Indices are validated here, before any later pass reads
+    // vertices through them.
+    std::vector<unsigned int>  histograms( numTasks * PARTITION_NUM_CELLS, 0 );
+    std::vector<unsigned char> taskValid( numTasks, 1 );
+    optixUtilParallelFor( numTasks, 1,
+                          [&]( size_t first, size_t last ) {
+                              for( size_t t = first; t < last; ++t )
+                              {
+                                  const size_t  end = std::min( ( t + 1 ) * PARTITION_TASK_SIZE, numTriangles );
+                                  unsigned int* h   = &histograms[t * PARTITION_NUM_CELLS];
+                                  for( size_t i = t * PARTITION_TASK_SIZE; i < end; ++i )
+                                  {
+                                      taskValid[t] = validTriangle( mesh, i );
+                                      if( !taskValid[t] )
+                                          break;
+                                      OptixAabb box;
+                                      triangleBounds( mesh, i, box );
+                                      ++h[partitionCell( box, origin, scale, table )];
+                                  }
+                              }
+                          },
+                          maxThreads );
+    for( unsigned char valid : taskValid )
+        if( !valid )
+            return OPTIX_ERROR_INVALID_VALUE;
+    for( size_t t = 1; t < numTasks; ++t )
+        for( unsigned int c = 0; c < PARTITION_NUM_CELLS; ++c )
+            histograms[c] += histograms[t * PARTITION_NUM_CELLS + c];
+
+    // Cut the curve into ranges of about numTriangles / numPartitions. A cell goes to the partition that holds its
+    // middle triangle, and partitions that get no cell are dropped.
+    std::vector<unsigned int> cellPartition( PARTITION_NUM_CELLS );
+    unsigned int              numUsed   = 0;
+    unsigned int              lastRaw   = ~0u;
+    size_t                    before    = 0;
+    for( unsigned int c = 0; c < PARTITION_NUM_CELLS; ++c )
+    {
+        const size_t       n   = histograms[c];
+        const unsigned int raw = numTriangles ? (unsigned int)( ( before + n / 2 ) * numPartitions / numTriangles ) : 0;
+        if( n && raw != lastRaw )
+        {
+            lastRaw = raw;
+            ++numUsed;
+        }
+        cellPartition[c] = numUsed ? numUsed - 1 : 0;
+        before += n;
+    }
+    numUsed = std::max( numUsed, 1u );
+
+    // Per task and partition counts, turned into scatter offsets in partition major order, which keeps the input
+    // order within each partition.
+    std::vector<unsigned int> offsets( numTasks * numUsed, 0 );
+    std::vector<OptixAabb>    partitionBounds( numTasks * numUsed, emptyAabb() );
+    optixUtilParallelFor( numTasks, 1,
+                          [&]( size_t first, size_t last ) {
+                              for( size_t t = first; t < last; ++t )
+                              {
+                                  const size_t  end    = std::min( ( t + 1 ) * PARTITION_TASK_SIZE, numTriangles );
+                                  unsigned int* counts = &offsets[t * numUsed];
+                                  for( size_t i = t * PARTITION_TASK_SIZE; i < end; ++i )
+                                  {
+                                      OptixAabb box;
+                                      triangleBounds( mesh, i, box );
+                                      ++counts[cellPartition[partitionCell( box, origin, scale, table )]];
+                                  }
+                              }
+                          },
+                          maxThreads );
+    partitioned.partitions.assign( numUsed, OptixUtilMeshPartition() );
+    unsigned int running = 0;
+    for( unsigned int p = 0; p < numUsed; ++p )
+    {
+        partitioned.partitions[p].firstTriangle = running;
+        for( size_t t = 0; t < numTasks; ++t )
+        {
+            const unsigned int n      = offsets[t * numUsed + p];
+            offsets[t * numUsed + p] = running;
+            running += n;
+        }
+        partitioned.partitions[p].numTriangles = running - partitioned.partitions[p].firstTriangle;
+    }
+
+    partitioned.indices.resize( numTriangles * 3 );
+    partitioned.triangleIds.resize( numTriangles );
+    partitioned.numVertices         = mesh.numVertices;
+    partitioned.vertexStrideInBytes = mesh.vertexStrideInBytes ? mesh.vertexStrideInBytes : 3 * sizeof( float );
+    partitioned.vertexBuffer        = 0;
+    optixUtilParallelFor( numTasks, 1,
+                          [&]( size_t first, size_t last ) {
+                              for( size_t t = first; t < last; ++t )
+                              {
+                                  const size_t  end     = std::min( ( t + 1 ) * PARTITION_TASK_SIZE, numTriangles );
+                                  unsigned int* next    = &offsets[t * numUsed];
+                                  OptixAabb*    bounds  = &partitionBounds[t * numUsed];
+                                  unsigned int* indices = partitioned.indices.data();
+                                  for( size_t i = t * PARTITION_TASK_SIZE; i < end; ++i )
+                                  {
+                                      OptixAabb box;
+                                      triangleBounds( mesh, i, box );
+                                      const unsigned int cell = partitionCell( box, origin, scale, table );
+                                      const unsigned int p    = cellPartition[cell];
+                                      const size_t       dst  = next[p]++;
+                                      for( int corner = 0; corner < 3; ++corner )
+                                          indices[dst * 3 + corner] = meshIndex( mesh, i, corner );
+                                      partitioned.triangleIds[dst] = (unsigned int)i;
+                                      growAabb( bounds[p], box );
+                                  }
+                              }
+                          },
+                          maxThreads );
+
+    OptixAabb meshBounds = emptyAabb();
+    for( unsigned int p = 0; p < numUsed; ++p )
+    {
+        OptixAabb& box = partitioned.partitions[p].bounds;
+        box            = emptyAabb();
+        for( size_t t = 0; t < numTasks; ++t )
+            growAabb( box, partitionBounds[t * numUsed + p] );
+        growAabb( meshBounds, box );
+    }
+
+    if( report )
+    {
+        report->numTriangles          = mesh.numTriangles;
+        report->numPartitions         = numUsed;
+        report->minPartitionTriangles = ~0u;
+        report->maxPartitionTriangles = 0;
+        double area                   = 0.0;
+        for( const OptixUtilMeshPartition& partition : partitioned.partitions )
+        {
+            report->minPartitionTriangles = std::min( report->minPartitionTriangles, partition.numTriangles );
+            report->maxPartitionTriangles = std::max( report->maxPartitionTriangles, partition.numTriangles );
+            area += aabbSurfaceArea( partition.bounds );
+        }
+        const double meshArea    = aabbSurfaceArea( meshBounds );
+        report->surfaceAreaRatio = meshArea > 0.0 ? (float)( area / meshArea ) : 1.0f;
+        report->seconds = std::chrono::duration<double>( std::chrono::steady_clock::now() - start ).count();
+    }
+    return OPTIX_SUCCESS;
+}
+
+/// Creates one triangle build input per partition.
+///
+/// The build inputs reference OptixUtilPartitionedMesh::vertexBuffer, so partitioned must stay alive and unchanged
+/// until the build is done.
+///
+/// \param[in,out] partitioned    Partitioned mesh.
+/// \param[in]     vertexBuffer   Device copy of the input vertices, with the input stride.
+/// \param[in]     indexBuffer    Device copy of OptixUtilPartitionedMesh::indices.
+/// \param[in]     flags          Geometry flags of the single SBT record of each build input. Must stay alive until the
+///                               build is done.
+/// \param[out]    buildInputs    Build inputs, one per partition.
+inline OptixResult optixUtilGetPartitionBuildInputs( OptixUtilPartitionedMesh& partitioned,
+                                                     CUdeviceptr               vertexBuffer,
+                                                     CUdeviceptr               indexBuffer,
+                                                     const unsigned int*       flags,
+                                                     OptixBuildInput*          buildInputs )
+{
+    if( !flags || ( !partitioned.partitions.empty() && !buildInputs ) || vertexBuffer % 4 != 0 || indexBuffer % 4 != 0 )
+        return OPTIX_ERROR_INVALID_VALUE;
+
+    partitioned.vertexBuffer = vertexBuffer;
+    for( size_t p = 0; p < partitioned.partitions.size(); ++p )
+    {
+        const OptixUtilMeshPartition& partition = partitioned.partitions[p];
+
+        OptixBuildInput input = {};
+        input.type            = OPTIX_BUILD_INPUT_TYPE_TRIANGLES;
+        OptixBuildInputTriangleArray& triangles = input.triangleArray;
+        triangles.vertexBuffers                 = &partitioned.vertexBuffer;
+        triangles.numVertices                   = partitioned.numVertices;
+        triangles.vertexFormat                  = OPTIX_VERTEX_FORMAT_FLOAT3;
+        triangles.vertexStrideInBytes           = partitioned.vertexStrideInBytes;
+        triangles.indexBuffer = indexBuffer + (CUdeviceptr)partition.firstTriangle * 3 * sizeof( unsigned int );
+        triangles.numIndexTriplets     = partition.numTriangles;
+        triangles.indexFormat          = OPTIX_INDICES_FORMAT_UNSIGNED_INT3;
+        triangles.indexStrideInBytes   = 3 * sizeof( unsigned int );
+        triangles.flags                = flags;
+        triangles.numSbtRecords        = 1;
+        triangles.primitiveIndexOffset = partition.firstTriangle;
+        buildInputs[p]                 = input;
+    }
+    return OPTIX_SUCCESS;
+}
+
+/// Marks the partitions that use any vertex in [firstVertex, firstVertex + numVertices), e.g., the vertices touched
+/// by a deformer, for #optixUtilUpdatePartitionedAccel().
+///
+/// \param[in]  partitioned   Partitioned mesh.
+/// \param[in]  firstVertex   First changed vertex.
+/// \param[in]  numVertices   Number of changed vertices.
+/// \param[out] partitions    Indices of the affected partitions, in increasing order. Existing contents are replaced.
+/// \param[in]  maxThreads    Upper bound on the number of threads, 0 for #optixUtilGetDefaultThreadCount().
+inline OptixResult optixUtilFindAffectedPartitions( const OptixUtilPartitionedMesh& partitioned,
+                                                    unsigned int                    firstVertex,
+                                                    unsigned int                    numVertices,
+                                                    std::vector<unsigned int>&      partitions,
+                                                    unsigned int                    maxThreads = 0 )
+{
+    const size_t              numPartitions = partitioned.partitions.size();
+    std::vector<unsigned char> affected( numPartitions, 0 );
+    optixUtilParallelFor( numPartitions, 1,
+                          [&]( size_t first, size_t last ) {
+                              for( size_t p = first; p < last; ++p )
+                              {
+                                  const OptixUtilMeshPartition& partition = partitioned.partitions[p];
+                                  const unsigned int* indices = &partitioned.indices[partition.firstTriangle * 3ull];
+                                  for( size_t i = 0; i < partition.numTriangles * 3ull && !affected[p]; ++i )
+                                      affected[p] = indices[i] - firstVertex < numVertices;
+                              }
+                          },
+                          maxThreads );
+    partitions.clear();
+    for( size_t p = 0; p < numPartitions; ++p )
+        if( affected[p] )
+            partitions.push_back( (unsigned int)p );
+    return OPTIX_SUCCESS;
+}
+
+/// GAS of the partitions of a mesh and an IAS over them, from #optixUtilBuildPartitionedAccel().
+struct OptixUtilPartitionedAccel
+{
+    /// Compacted GAS, one per partition.
+    OptixUtilCompactedGasBatch gas;
+    /// Build options of the GAS, reused for updates.
+    OptixAccelBuildOptions gasOptions;
+
+    /// Host copy of the instances, one per partition.
+    std::vector<OptixInstance> instances;
+    CUdeviceptr                instanceBuffer;
+    /// Build options, buffer and handle of the IAS.
+    OptixAccelBuildOptions iasOptions;
+    CUdeviceptr            iasBuffer;
+    size_t                 iasSizeInBytes;
+    OptixTraversableHandle handle;
+};
+
+namespace optix_util_impl {
+
+/// Builds or updates the IAS of a partitioned accel. Temp memory is acquired from the pool for the call.
+inline OptixResult buildPartitionIas( const OptixFunctionTable&  api,
+                                      OptixDeviceContext         context,
+                                      CUstream                   stream,
+                                      OptixUtilAccelMemoryPool&  pool,
+                                      OptixUtilPartitionedAccel& accel,
+                                      OptixBuildOperation        operation )
+{
+    OptixBuildInput input            = {};
+    input.type                       = OPTIX_BUILD_INPUT_TYPE_INSTANCES;
+    input.instanceArray.instances    = accel.instanceBuffer;
+    input.instanceArray.numInstances = (unsigned int)accel.instances.size();
+
+    OptixAccelBuildOptions options = accel.iasOptions;
+    options.operation              = operation;
+    OptixAccelBufferSizes sizes;
+    OptixResult           result = api.optixAccelComputeMemoryUsage( context, &options, &input, 1, &sizes );
+    if( result != OPTIX_SUCCESS )
+        return result;
+    const bool build = operation == OPTIX_BUILD_OPERATION_BUILD;
+    if( build )
+    {
+        accel.iasSizeInBytes = sizes.outputSizeInBytes;
+        result               = pool.acquire( accel.iasSizeInBytes, &accel.iasBuffer );
+        if( result != OPTIX_SUCCESS )
+            return result;
+    }
+
+    const size_t tempSize = build ? sizes.tempSizeInBytes : sizes.tempUpdateSizeInBytes;
+    CUdeviceptr  temp     = 0;
+    if( tempSize )
+        result = pool.acquire( tempSize, &temp );
+    if( result == OPTIX_SUCCESS )
+        result = api.optixAccelBuild( context, stream, &options, &input, 1, temp, tempSize, accel.iasBuffer,
+                                      accel.iasSizeInBytes, &accel.handle, nullptr, 0 );
+    if( temp )
+        pool.release( temp );
+    return result;
+}
+
+}  // namespace optix_util_impl
+
+/// Releases the GAS, instances and IAS of a partitioned accel to the pool and clears it.
+inline OptixResult optixUtilReleasePartitionedAccel( OptixUtilAccelMemoryPool& pool, OptixUtilPartitionedAccel& accel )
+{
+    OptixResult result = optixUtilReleaseCompactedGasBatch( pool, accel.gas );
+    for( CUdeviceptr buffer : {accel.instanceBuffer, accel.iasBuffer} )
+    {
+        const OptixResult bufferResult = buffer ? pool.release( buffer ) : OPTIX_SUCCESS;
+        result                         = result == OPTIX_SUCCESS ? bufferResult : result;
+    }
+    accel = OptixUtilPartitionedAccel();
+    return result;
+}
+
+/// Builds and compacts the GAS of all partitions with #optixUtilBuildCompactedGas() and builds an IAS over them.
+///
+/// All work is queued on one stream, with the stream ordering rules of #optixUtilBuildCompactedGas().
+///
+/// \param[in]  api                OptiX function table.
+/// \param[in]  context            Device context.
+/// \param[in]  stream             Stream for all builds.
+/// \param[in]  buildInputs        Build inputs from #optixUtilGetPartitionBuildInputs().
+/// \param[in]  numPartitions      Number of partitions.
+/// \param[in]  gasOptions         Build options of the GAS. Set OPTIX_BUILD_FLAG_ALLOW_UPDATE for partial updates.
+/// \param[in]  instanceTemplate   Transform, instance id, SBT offset, visibility mask and flags of all instances. All
+///                                partitions use the same SBT records.
+/// \param[in]  pool               Pool for all device memory.
+/// \param[in]  readback           Device to host copy for the compacted sizes.
+/// \param[in]  upload             Host to device copy for the instances.
+/// \param[in]  batchOptions       Options of the GAS batch.
+/// \param[out] accel              GAS and IAS. Existing contents are replaced, without releasing them.
+/// \param[out] report             Optional report of the GAS batch.
+inline OptixResult optixUtilBuildPartitionedAccel( const OptixFunctionTable&       api,
+                                                   OptixDeviceContext              context,
+                                                   CUstream                        stream,
+                                                   const OptixBuildInput*          buildInputs,
+                                                   unsigned int                    numPartitions,
+                                                   const OptixAccelBuildOptions&   gasOptions,
+                                                   const OptixInstance&            instanceTemplate,
+                                                   OptixUtilAccelMemoryPool&       pool,
+                                                   const OptixUtilDeviceReadback&  readback,
+                                                   const OptixUtilDeviceUpload&    upload,
+                                                   const OptixUtilGasBatchOptions& batchOptions,
+                                                   OptixUtilPartitionedAccel&      accel,
+                                                   OptixUtilGasBatchReport*        report = nullptr )
+{
+    if( ( numPartitions && !buildInputs ) || !upload.write )
+        return OPTIX_ERROR_INVALID_VALUE;
+
+    accel                      = OptixUtilPartitionedAccel();
+    accel.gasOptions           = gasOptions;
+    accel.gasOptions.operation = OPTIX_BUILD_OPERATION_BUILD;
+    std::vector<OptixUtilAccelBuildRequest> requests( numPartitions );
+    for( unsigned int p = 0; p < numPartitions; ++p )
+        requests[p] = {&accel.gasOptions, &buildInputs[p], 1};
+    OptixResult result = optixUtilBuildCompactedGas( api, context, stream, requests.data(), numPartitions, pool,
+                                                     readback, batchOptions, accel.gas, report );
+    if( result != OPTIX_SUCCESS )
+        return result;
+
+    accel.instances.assign( numPartitions, instanceTemplate );
+    for( unsigned int p = 0; p < numPartitions; ++p )
+        accel.instances[p].traversableHandle = accel.gas.handles[p];
+    accel.iasOptions            = OptixAccelBuildOptions();
+    accel.iasOptions.buildFlags = OPTIX_BUILD_FLAG_PREFER_FAST_TRACE;
+    if( gasOptions.buildFlags & OPTIX_BUILD_FLAG_ALLOW_UPDATE )
+        accel.iasOptions.buildFlags |= OPTIX_BUILD_FLAG_ALLOW_UPDATE;
+
+    const size_t instanceBytes = accel.instances.size() * sizeof( OptixInstance );
+    if( instanceBytes )
+        result = pool.acquire( instanceBytes, &accel.instanceBuffer );
+    if( result == OPTIX_SUCCESS && instanceBytes )
+        result = upload.write( upload.userData, stream, accel.instances.data(), instanceBytes, accel.instanceBuffer );
+    if( result == OPTIX_SUCCESS )
+        result = optix_util_impl::buildPartitionIas( api, context, stream, pool, accel, OPTIX_BUILD_OPERATION_BUILD );
+    if( result != OPTIX_SUCCESS )
+        optixUtilReleasePartitionedAccel( pool, accel );
+    return result;
+}
+
+/// Refits the GAS of some partitions after their vertices moved, and then the IAS.
+///
+/// The GAS and the IAS must have been built with OPTIX_BUILD_FLAG_ALLOW_UPDATE. Handles do not change. Temp memory is
+/// acquired from the pool for the call, sized for the largest update.
+///
+/// \param[in]     api             OptiX function table.
+/// \param[in]     context         Device context.
+/// \param[in]     stream          Stream for the updates.
+/// \param[in]     buildInputs     Build inputs of all partitions, with the same layout as for the build.
+/// \param[in]     partitions      Partitions to refit, e.g., from #optixUtilFindAffectedPartitions().
+/// \param[in]     numPartitions   Number of partitions to refit.
+/// \param[in]     pool            Pool for temp memory.
+/// \param[in,out] accel           Accel from #optixUtilBuildPartitionedAccel().
+inline OptixResult optixUtilUpdatePartitionedAccel( const OptixFunctionTable&  api,
+                                                    OptixDeviceContext         context,
+                                                    CUstream                   stream,
+                                                    const OptixBuildInput*     buildInputs,
+                                                    const unsigned int*        partitions,
+                                                    unsigned int               numPartitions,
+                                                    OptixUtilAccelMemoryPool&  pool,
+                                                    OptixUtilPartitionedAccel& accel )
+{
+    if( !( accel.gasOptions.buildFlags & OPTIX_BUILD_FLAG_ALLOW_UPDATE ) || !accel.handle
+        || ( numPartitions && ( !buildInputs || !partitions ) ) )
+        return OPTIX_ERROR_INVALID_VALUE;
+
+    OptixAccelBuildOptions options = accel.gasOptions;
+    options.operation              = OPTIX_BUILD_OPERATION_UPDATE;
+    size_t tempSize                = 0;
+    for( unsigned int i = 0; i < numPartitions; ++i )
+    {
+        if( partitions[i] >= accel.gas.handles.size() )
+            return OPTIX_ERROR_INVALID_VALUE;
+        OptixAccelBufferSizes sizes;
+        const OptixResult     result =
+            api.optixAccelComputeMemoryUsage( context, &options, &buildInputs[partitions[i]], 1, &sizes );
+        if( result != OPTIX_SUCCESS )
+            return result;
+        tempSize = std::max( tempSize, sizes.tempUpdateSizeInBytes );
+    }
+
+    // Updates on one stream run one after another, so they share one temp buffer.
+    CUdeviceptr temp   = 0;
+    OptixResult result = tempSize ? pool.acquire( tempSize, &temp ) : OPTIX_SUCCESS;
+    for( unsigned int i = 0; i < numPartitions && result == OPTIX_SUCCESS; ++i )
+    {
+        const unsigned int p = partitions[i];
+        result = api.optixAccelBuild( context, stream, &options, &buildInputs[p], 1, temp, tempSize,
+                                      accel.gas.buffers[p], accel.gas.sizes[p], &accel.gas.handles[p], nullptr, 0 );
+    }
+    if( temp )
+        pool.release( temp );
+    if( result == OPTIX_SUCCESS && numPartitions )
+        result = optix_util_impl::buildPartitionIas( api, context, stream, pool, accel, OPTIX_BUILD_OPERATION_UPDATE );
+    return result;
+}
+
+/*@}*/  // end group optix_utilities
+
+#endif  // __optix_optix_util_mesh_partition_h__
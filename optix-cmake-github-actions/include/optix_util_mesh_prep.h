@@ -0,0 +1,513 @@
+/// @file
+/// @brief  OptiX host utilities: triangle mesh preprocessing for #OptixBuildInputTriangleArray
+///
+/// #optixUtilPrepareMesh() converts an indexed or unindexed triangle mesh with 32-bit indices and tightly packed
+/// positions into the layout recommended for GAS builds:
+///
+/// - vertices closer than a tolerance are welded, using a hash grid that is queried in parallel,
+/// - the mesh is split into clusters of at most 65536 vertices, so each cluster uses
+///   OPTIX_INDICES_FORMAT_UNSIGNED_SHORT3,
+/// - positions are padded to a 16 byte stride.
+///
+/// The result holds one vertex and one index array for the whole mesh. #optixUtilGetMeshBuildInputs() creates one
+/// build input per cluster from their device copies. Each build input gets its own SBT records, so a mesh with several
+/// clusters needs the material records repeated for each of them. Clusters cover consecutive triangles, and the build
+/// inputs set #OptixBuildInputTriangleArray::primitiveIndexOffset so that optixGetPrimitiveIndex() returns the
+/// triangle index in the prepared mesh.
+
+#ifndef __optix_optix_util_mesh_prep_h__
+#define __optix_optix_util_mesh_prep_h__
+
+#include "optix_util_parallel.h"
+
+#include <optix_types.h>
+
+#include <algorithm>
+#include <atomic>
+#include <cmath>
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+#include <vector>
+
+/** \addtogroup optix_utilities
+@{
+*/
+
+/// Triangle mesh in the input layout of #optixUtilPrepareMesh().
+struct OptixUtilMeshInput
+{
+    /// Vertex positions as float x, y, z.
+    const float* vertices;
+    unsigned int numVertices;
+    /// Stride between vertices, 0 for tightly packed positions.
+    unsigned int vertexStrideInBytes;
+
+    /// Optional triplets of vertex indices, one per triangle. Without indices, triangle i uses vertices 3 * i to
+    /// 3 * i + 2.
+    const unsigned int* indices;
+    unsigned int        numTriangles;
+};
+
+/// Options of #optixUtilPrepareMesh().
+struct OptixUtilMeshPrepOptions
+{
+    /// Vertices closer than this distance are welded. 0 only welds vertices with identical positions.
+    float weldTolerance;
+    /// Keeps all vertices separate if nonzero.
+    int disableWelding;
+    /// Removes triangles that use a vertex twice after welding if nonzero. Triangle indices then change, see
+    /// OptixUtilPreparedMesh::triangleIds.
+    int removeDegenerateTriangles;
+    /// Maximum number of vertices per cluster. 0 selects 65536, the limit of 16-bit indices.
+    unsigned int maxClusterVertices;
+};
+
+/// Range of an #OptixUtilPreparedMesh that is built as one #OptixBuildInputTriangleArray.
+struct OptixUtilMeshCluster
+{
+    unsigned int firstVertex;
+    unsigned int numVertices;
+    unsigned int firstTriangle;
+    unsigned int numTriangles;
+};
+
+/// Output of #optixUtilPrepareMesh().
+struct OptixUtilPreparedMesh
+{
+    /// Positions as x, y, z, 0 with a stride of 16 bytes. Vertices of each cluster are contiguous.
+    std::vector<float> vertices;
+    /// Triplets of 16-bit indices relative to the first vertex of the cluster of the triangle.
+    std::vector<unsigned short> indices;
+    std::vector<OptixUtilMeshCluster> clusters;
+    /// Input triangle index of each triangle. Empty unless degenerate triangles were removed.
+    std::vector<unsigned int> triangleIds;
+    /// Vertex buffer pointer of each cluster, referenced by the build inputs of #optixUtilGetMeshBuildInputs().
+    std::vector<CUdeviceptr> clusterVertexBuffers;
+};
+
+/// Memory use of a mesh before and after #optixUtilPrepareMesh().
+struct OptixUtilMeshPrepReport
+{
+    unsigned int numInputVertices;
+    /// Number of vertices after welding that are referenced by a triangle.
+    unsigned int numWeldedVertices;
+    /// Number of vertices in the output. Vertices shared between clusters are stored once per cluster.
+    unsigned int numOutputVertices;
+    unsigned int numInputTriangles;
+    unsigned int numOutputTriangles;
+    unsigned int numClusters;
+
+    /// Size of the vertex and index buffers of the input, with its vertex stride.
+    size_t inputBytes;
+    /// Size of OptixUtilPreparedMesh::vertices and OptixUtilPreparedMesh::indices.
+    size_t outputBytes;
+};
+
+namespace optix_util_impl {
+
+/// Below this number of vertices, welding runs on the calling thread only.
+const size_t MESH_PARALLEL_THRESHOLD = 65536;
+const size_t MESH_GRAIN_SIZE         = 16384;
+
+inline const float* meshVertex( const OptixUtilMeshInput& mesh, unsigned int v )
+{
+    const size_t stride = mesh.vertexStrideInBytes ? mesh.vertexStrideInBytes : 3 * sizeof( float );
+    return (const float*)( (const char*)mesh.vertices + v * stride );
+}
+
+inline unsigned int meshIndex( const OptixUtilMeshInput& mesh, size_t triangle, int corner )
+{
+    return mesh.indices ? mesh.indices[triangle * 3 + corner] : (unsigned int)( triangle * 3 + corner );
+}
+
+/// Cell coordinate of a scaled position. Values outside the int64 range, including NaN, map to cell 0.
+inline int64_t cellCoordinate( double scaled )
+{
+    const double c = std::floor( scaled );
+    return c > -4.0e18 && c < 4.0e18 ? (int64_t)c : 0;
+}
+
+inline uint32_t hashCell( int64_t x, int64_t y, int64_t z )
+{
+    uint64_t h = (uint64_t)x * 0x9e3779b97f4a7c15ull;
+    h ^= (uint64_t)y * 0xc2b2ae3d27d4eb4full + ( h >> 29 );
+    h ^= (uint64_t)z * 0x165667b19e3779f9ull + ( h >> 32 );
+    return (uint32_t)( h ^ ( h >> 31 ) );
+}
+
+/// Hash grid over the input vertices, with a cell size of twice the weld tolerance. Points are stored sorted by bucket,
+/// and by index within a bucket, so a query reads them contiguously. An occupancy bitmap, which is small enough to stay
+/// in cache, skips empty buckets without touching the bucket table.
+class WeldGrid
+{
+  public:
+    WeldGrid( const OptixUtilMeshInput& mesh, float tolerance, unsigned int maxThreads )
+        : m_mesh( mesh )
+        , m_tolerance( tolerance )
+        , m_invCellSize( tolerance > 0.0f ? 0.5 / tolerance : 0.0 )
+    {
+        size_t numBuckets = 64;
+        while( numBuckets < 2 * (size_t)mesh.numVertices )
+            numBuckets *= 2;
+        m_mask = (uint32_t)( numBuckets - 1 );
+
+        std::vector<uint32_t> bucket( mesh.numVertices );
+        optixUtilParallelFor( mesh.numVertices, MESH_GRAIN_SIZE,
+                              [&]( size_t begin, size_t end ) {
+                                  for( size_t v = begin; v < end; ++v )
+                                  {
+                                      int64_t cell[3];
+                                      cellOf( meshVertex( m_mesh, (unsigned int)v ), cell );
+                                      bucket[v] = hashCell( cell[0], cell[1], cell[2] ) & m_mask;
+                                  }
+                              },
+                              maxThreads );
+
+        m_occupied.assign( numBuckets / 64, 0ull );
+        m_bucketStart.assign( numBuckets + 1, 0u );
+        for( unsigned int v = 0; v < mesh.numVertices; ++v )
+        {
+            ++m_bucketStart[bucket[v] + 1];
+            m_occupied[bucket[v] / 64] |= 1ull << ( bucket[v] % 64 );
+        }
+        for( size_t b = 0; b < numBuckets; ++b )
+            m_bucketStart[b + 1] += m_bucketStart[b];
+        m_points.resize( mesh.numVertices );
+        std::vector<uint32_t> next( m_bucketStart.begin(), m_bucketStart.end() - 1 );
+        for( unsigned int v = 0; v < mesh.numVertices; ++v )
+        {
+            const float* p = meshVertex( mesh, v );
+            GridPoint&   g = m_points[next[bucket[v]]++];
+            g.x            = p[0];
+            g.y            = p[1];
+            g.z            = p[2];
+            g.index        = v;
+        }
+    }
+
+    /// Writes the representative of each vertex: the smallest index among the vertices connected to it by chains of
+    /// vertices within the tolerance of each other.
+    ///
+    /// The components are found with a concurrent union-find. Each vertex is united with every vertex of smaller index
+    /// within the tolerance, and roots are always linked to the smaller root, so the root of a component is its
+    /// smallest index whatever the thread count. Since cells are twice as large as the tolerance, candidates are at
+    /// most half a cell away on each axis. They lie in the cell of a vertex and in the neighbours towards the closer
+    /// cell border on each axis, i.e., in 8 cells. Vertices are visited in grid order, so the points of their own cell
+    /// are in cache.
+    void weld( unsigned int* rep, unsigned int maxThreads ) const
+    {
+        std::vector<std::atomic<unsigned int>> parent( m_points.size() );
+        optixUtilParallelFor( parent.size(), MESH_GRAIN_SIZE,
+                              [&]( size_t begin, size_t end ) {
+                                  for( size_t v = begin; v < end; ++v )
+                                      parent[v].store( (unsigned int)v, std::memory_order_relaxed );
+                              },
+                              maxThreads );
+        optixUtilParallelFor( m_points.size(), MESH_GRAIN_SIZE,
+                              [&]( size_t begin, size_t end ) {
+                                  for( size_t j = begin; j < end; ++j )
+                                      uniteNeighbours( m_points[j], parent );
+                              },
+                              maxThreads );
+        optixUtilParallelFor( parent.size(), MESH_GRAIN_SIZE,
+                              [&]( size_t begin, size_t end ) {
+                                  for( size_t v = begin; v < end; ++v )
+                                      rep[v] = findRoot( parent, (unsigned int)v );
+                              },
+                              maxThreads );
+    }
+
+  private:
+    struct GridPoint
+    {
+        float        x, y, z;
+        unsigned int index;
+    };
+
+    /// Root of v, halving the path on the way. Parents always have a smaller index than their children, so replacing
+    /// a parent by the grandparent keeps the forest valid while other threads link roots.
+    static unsigned int findRoot( std::vector<std::atomic<unsigned int>>& parent, unsigned int v )
+    {
+        for( ;; )
+        {
+            unsigned int p = parent[v].load();
+            if( p == v )
+                return v;
+            const unsigned int g = parent[p].load();
+            if( g != p )
+                parent[v].compare_exchange_weak( p, g );
+            v = g;
+        }
+    }
+
+    /// Links the roots of a and b, the larger one below the smaller one.
+    static void unite( std::vector<std::atomic<unsigned int>>& parent, unsigned int a, unsigned int b )
+    {
+        for( ;; )
+        {
+            a = findRoot( parent, a );
+            b = findRoot( parent, b );
+            if( a == b )
+                return;
+            if( a < b )
+                std::swap( a, b );
+            unsigned int expected = a;
+            if( parent[a].compare_exchange_strong( expected, b ) )
+                return;
+        }
+    }
+
+    void uniteNeighbours( const GridPoint& point, std::vector<std::atomic<unsigned int>>& parent ) const
+    {
+        const float p[3] = {point.x, point.y, point.z};
+        int64_t     cell[3];
+        int         side[3] = {0, 0, 0};
+        cellOf( p, cell );
+        if( m_tolerance > 0.0f )
+            for( int k = 0; k < 3; ++k )
+                side[k] = (double)p[k] * m_invCellSize - (double)cell[k] < 0.5 ? -1 : 1;
+
+        for( int n = 0; n < ( m_tolerance > 0.0f ? 8 : 1 ); ++n )
+        {
+            const uint32_t b = hashCell( cell[0] + ( n & 1 ? side[0] : 0 ), cell[1] + ( n & 2 ? side[1] : 0 ),
+                                         cell[2] + ( n & 4 ? side[2] : 0 ) )
+                               & m_mask;
+            if( !( m_occupied[b / 64] & ( 1ull << ( b % 64 ) ) ) )
+                continue;
+            for( uint32_t j = m_bucketStart[b]; j < m_bucketStart[b + 1] && m_points[j].index < point.index; ++j )
+                if( isWithinTolerance( p, m_points[j] ) )
+                    unite( parent, point.index, m_points[j].index );
+        }
+    }
+
+    /// Cell of p. Without a tolerance, the cell is the position itself, with -0 mapped to 0.
+    void cellOf( const float* p, int64_t* cell ) const
+    {
+        for( int k = 0; k < 3; ++k )
+        {
+            if( m_tolerance > 0.0f )
+            {
+                cell[k] = cellCoordinate( (double)p[k] * m_invCellSize );
+            }
+            else
+            {
+                const float c    = p[k] == 0.0f ? 0.0f : p[k];
+                uint32_t    bits = 0;
+                std::memcpy( &bits, &c, sizeof( float ) );
+                cell[k] = bits;
+            }
+        }
+    }
+
+    bool isWithinTolerance( const float* a, const GridPoint& b ) const
+    {
+        if( m_tolerance == 0.0f )
+            return a[0] == b.x && a[1] == b.y && a[2] == b.z;
+        const float dx = a[0] - b.x, dy = a[1] - b.y, dz = a[2] - b.z;
+        return dx * dx + dy * dy + dz * dz <= m_tolerance * m_tolerance;
+    }
+
+    const OptixUtilMeshInput& m_mesh;
+    float                     m_tolerance;
+    double                    m_invCellSize;
+    uint32_t                  m_mask;
+    std::vector<uint64_t>     m_occupied;
+    std::vector<uint32_t>     m_bucketStart;
+    std::vector<GridPoint>    m_points;
+};
+
+}  // namespace optix_util_impl
+
+/// Welds, clusters and pads a triangle mesh, see the file description.
+///
+/// Vertices connected by chains of vertices that are each within the tolerance of the next are welded to a single
+/// vertex, the one with the smallest index. Vertices not referenced by any triangle are dropped. Clusters are formed
+/// greedily in triangle order.
+///
+/// \param[in]  mesh         Input mesh. Indices must be smaller than numVertices.
+/// \param[in]  options      Options.
+/// \param[out] prepared     Output buffers. Existing contents are replaced.
+/// \param[out] report       Optional memory report.
+/// \param[in]  maxThreads   Upper bound on the number of threads, 0 for #optixUtilGetDefaultThreadCount().
+inline OptixResult optixUtilPrepareMesh( const OptixUtilMeshInput&       mesh,
+                                         const OptixUtilMeshPrepOptions& options,
+                                         OptixUtilPreparedMesh&          prepared,
+                                         OptixUtilMeshPrepReport*        report     = nullptr,
+                                         unsigned int                    maxThreads = 0 )
+{
+    using namespace optix_util_impl;
+
+    if( mesh.numVertices && !mesh.vertices )
+        return OPTIX_ERROR_INVALID_VALUE;
+    if( mesh.vertexStrideInBytes && mesh.vertexStrideInBytes < 3 * sizeof( float ) )
+        return OPTIX_ERROR_INVALID_VALUE;
+    if( !( options.weldTolerance >= 0.0f ) || options.maxClusterVertices > 65536 )
+        return OPTIX_ERROR_INVALID_VALUE;
+    if( !mesh.indices && (size_t)mesh.numTriangles * 3 > mesh.numVertices )
+        return OPTIX_ERROR_INVALID_VALUE;
+    if( mesh.indices )
+        for( size_t i = 0; i < (size_t)mesh.numTriangles * 3; ++i )
+            if( mesh.indices[i] >= mesh.numVertices )
+                return OPTIX_ERROR_INVALID_VALUE;
+
+    const unsigned int maxClusterVertices = options.maxClusterVertices ? options.maxClusterVertices : 65536;
+    if( maxClusterVertices < 3 )
+        return OPTIX_ERROR_INVALID_VALUE;
+    if( mesh.numVertices < MESH_PARALLEL_THRESHOLD )
+        maxThreads = 1;
+
+    // Representative of each vertex, the smallest index of the vertices welded to it.
+    std::vector<unsigned int> rep( mesh.numVertices );
+    if( options.disableWelding )
+    {
+        for( unsigned int v = 0; v < mesh.numVertices; ++v )
+            rep[v] = v;
+    }
+    else
+    {
+        const WeldGrid grid( mesh, options.weldTolerance, maxThreads );
+        grid.weld( rep.data(), maxThreads );
+    }
+
+    // Clusters, local indices and the input vertex of each output vertex. localIndex is valid for a vertex while
+    // clusterOf holds the current cluster.
+    prepared.indices.clear();
+    prepared.clusters.clear();
+    prepared.triangleIds.clear();
+    prepared.indices.reserve( (size_t)mesh.numTriangles * 3 );
+
+    std::vector<unsigned int> clusterOf( mesh.numVertices, ~0u );
+    std::vector<unsigned int> localIndex( mesh.numVertices );
+    std::vector<char>         referenced( mesh.numVertices, 0 );
+    std::vector<unsigned int> sourceVertex;
+    sourceVertex.reserve( mesh.numVertices );
+    OptixUtilMeshCluster cluster = {0, 0, 0, 0};
+    unsigned int         numOutputTriangles = 0;
+
+    for( unsigned int t = 0; t < mesh.numTriangles; ++t )
+    {
+        const unsigned int v[3] = {rep[meshIndex( mesh, t, 0 )], rep[meshIndex( mesh, t, 1 )],
+                                   rep[meshIndex( mesh, t, 2 )]};
+        if( options.removeDegenerateTriangles && ( v[0] == v[1] || v[1] == v[2] || v[0] == v[2] ) )
+            continue;
+
+        const unsigned int c = (unsigned int)prepared.clusters.size();
+        unsigned int       numNew = 0;
+        for( int k = 0; k < 3; ++k )
+            numNew += clusterOf[v[k]] != c && ( k < 1 || v[k] != v[0] ) && ( k < 2 || v[k] != v[1] );
+        if( cluster.numVertices + numNew > maxClusterVertices )
+        {
+            prepared.clusters.push_back( cluster );
+            cluster.firstVertex += cluster.numVertices;
+            cluster.firstTriangle += cluster.numTriangles;
+            cluster.numVertices  = 0;
+            cluster.numTriangles = 0;
+        }
+
+        const unsigned int current = (unsigned int)prepared.clusters.size();
+        for( int k = 0; k < 3; ++k )
+        {
+            if( clusterOf[v[k]] != current )
+            {
+                clusterOf[v[k]]  = current;
+                localIndex[v[k]] = cluster.numVertices++;
+                sourceVertex.push_back( v[k] );
+                referenced[v[k]] = 1;
+            }
+            prepared.indices.push_back( (unsigned short)localIndex[v[k]] );
+        }
+        ++cluster.numTriangles;
+        ++numOutputTriangles;
+        if( options.removeDegenerateTriangles )
+            prepared.triangleIds.push_back( t );
+    }
+    if( cluster.numTriangles )
+        prepared.clusters.push_back( cluster );
+    if( options.removeDegenerateTriangles && numOutputTriangles == mesh.numTriangles )
+        prepared.triangleIds.clear();
+
+    // Padded positions, gathered in parallel.
+    const size_t numOutputVertices = sourceVertex.size();
+    prepared.vertices.resize( numOutputVertices * 4 );
+    optixUtilParallelFor( numOutputVertices, MESH_GRAIN_SIZE,
+                          [&]( size_t begin, size_t end ) {
+                              for( size_t i = begin; i < end; ++i )
+                              {
+                                  const float* p   = meshVertex( mesh, sourceVertex[i] );
+                                  float*       dst = &prepared.vertices[i * 4];
+                                  dst[0]           = p[0];
+                                  dst[1]           = p[1];
+                                  dst[2]           = p[2];
+                                  dst[3]           = 0.0f;
+                              }
+                          },
+                          numOutputVertices < MESH_PARALLEL_THRESHOLD ? 1 : maxThreads );
+    prepared.clusterVertexBuffers.assign( prepared.clusters.size(), 0 );
+
+    if( report )
+    {
+        const size_t inputStride    = mesh.vertexStrideInBytes ? mesh.vertexStrideInBytes : 3 * sizeof( float );
+        report->numInputVertices    = mesh.numVertices;
+        report->numWeldedVertices   = (unsigned int)std::count( referenced.begin(), referenced.end(), 1 );
+        report->numOutputVertices   = (unsigned int)numOutputVertices;
+        report->numInputTriangles   = mesh.numTriangles;
+        report->numOutputTriangles  = numOutputTriangles;
+        report->numClusters         = (unsigned int)prepared.clusters.size();
+        report->inputBytes          = mesh.numVertices * inputStride;
+        if( mesh.indices )
+            report->inputBytes += (size_t)mesh.numTriangles * 3 * sizeof( unsigned int );
+        report->outputBytes = prepared.vertices.size() * sizeof( float );
+        report->outputBytes += prepared.indices.size() * sizeof( unsigned short );
+    }
+    return OPTIX_SUCCESS;
+}
+
+/// Creates one triangle build input per cluster of a prepared mesh.
+///
+/// The build inputs reference OptixUtilPreparedMesh::clusterVertexBuffers, so prepared must stay alive and unchanged
+/// until the build is done.
+///
+/// \param[in,out] prepared       Prepared mesh.
+/// \param[in]     vertexBuffer   Device copy of OptixUtilPreparedMesh::vertices, 16 byte aligned.
+/// \param[in]     indexBuffer    Device copy of OptixUtilPreparedMesh::indices.
+/// \param[in]     flags          Geometry flags of the single SBT record of each build input. Must stay alive until the
+///                               build is done.
+/// \param[out]    buildInputs    Build inputs, one per cluster.
+inline OptixResult optixUtilGetMeshBuildInputs( OptixUtilPreparedMesh& prepared,
+                                                CUdeviceptr            vertexBuffer,
+                                                CUdeviceptr            indexBuffer,
+                                                const unsigned int*    flags,
+                                                OptixBuildInput*       buildInputs )
+{
+    if( !flags || ( !prepared.clusters.empty() && !buildInputs ) || vertexBuffer % 16 != 0 || indexBuffer % 2 != 0 )
+        return OPTIX_ERROR_INVALID_VALUE;
+
+    prepared.clusterVertexBuffers.resize( prepared.clusters.size() );
+    for( size_t c = 0; c < prepared.clusters.size(); ++c )
+    {
+        const OptixUtilMeshCluster& cluster = prepared.clusters[c];
+        prepared.clusterVertexBuffers[c]    = vertexBuffer + (CUdeviceptr)cluster.firstVertex * 4 * sizeof( float );
+
+        OptixBuildInput input = {};
+        input.type            = OPTIX_BUILD_INPUT_TYPE_TRIANGLES;
+        OptixBuildInputTriangleArray& triangles = input.triangleArray;
+        triangles.vertexBuffers                 = &prepared.clusterVertexBuffers[c];
+        triangles.numVertices                   = cluster.numVertices;
+        triangles.vertexFormat                  = OPTIX_VERTEX_FORMAT_FLOAT3;
+        triangles.vertexStrideInBytes           = 4 * sizeof( float );
+        triangles.indexBuffer = indexBuffer + (CUdeviceptr)cluster.firstTriangle * 3 * sizeof( unsigned short );
+        triangles.numIndexTriplets     = cluster.numTriangles;
+        triangles.indexFormat          = OPTIX_INDICES_FORMAT_UNSIGNED_SHORT3;
+        triangles.indexStrideInBytes   = 3 * sizeof( unsigned short );
+        triangles.flags                = flags;
+        triangles.numSbtRecords        = 1;
+        triangles.primitiveIndexOffset = cluster.firstTriangle;
+        buildInputs[c]                 = input;
+    }
+    return OPTIX_SUCCESS;
+}
+
+/*@}*/  // end group optix_utilities
+
+#endif  // __optix_optix_util_mesh_prep_h__
@@ -0,0 +1,367 @@
+/// @file
+/// @brief  OptiX host utilities: parallel module compilation with a content-keyed module cache
+///
+/// optixModuleCreateFromPTX() dominates the startup time of applications with hundreds of modules. It is thread safe,
+/// so #optixUtilCompileModules() compiles a batch of modules on up to maxThreads threads:
+///
+/// - each request is keyed by #optixUtilComputeModuleCacheKey(), a hash of the PTX and of the module and pipeline
+///   compile options by value, so keys do not depend on pointers and are the same in every process,
+/// - requests whose key is in the #OptixUtilModuleCache, or appears earlier in the batch, are not compiled,
+/// - the remaining modules are compiled largest PTX first, which keeps the threads busy until the end of the batch
+///   when a few modules are much larger than the rest,
+/// - hits, misses and the compile latency of every module are reported.
+///
+/// OptiX does not export compiled modules, so the cache holds modules of one device context in memory. Compiling the
+/// module list of a scene once at startup also warms the driver's disk cache, see
+/// optixDeviceContextSetCacheLocation(). All OptiX calls go through the function table, so the scheduling and keying
+/// can be exercised with a stub table.
+
+#ifndef __optix_optix_util_module_cache_h__
+#define __optix_optix_util_module_cache_h__
+
+#include "optix_util_geometry_cache.h"
+#include "optix_util_parallel.h"
+
+#include <optix_function_table.h>
+#include <optix_types.h>
+
+#include <algorithm>
+#include <chrono>
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+/** \addtogroup optix_utilities
+@{
+*/
+
+/// Version of the module cache key derivation. Changing it invalidates all keys.
+#define OPTIX_UTIL_MODULE_CACHE_VERSION 1u
+
+/// Module to compile.
+struct OptixUtilModuleRequest
+{
+    const OptixModuleCompileOptions*   moduleCompileOptions;
+    const OptixPipelineCompileOptions* pipelineCompileOptions;
+    const char*                        ptx;
+    /// Size of ptx in bytes. 0 for a null-terminated string.
+    size_t ptxSize;
+};
+
+/// Outcome of one request of #optixUtilCompileModules().
+struct OptixUtilModuleResult
+{
+    /// Module owned by the cache, null if compilation failed.
+    OptixModule module;
+    OptixResult result;
+    uint64_t    key;
+    /// True if the module came from the cache or from an earlier request of the batch with the same key.
+    bool cacheHit;
+    /// Time spent in optixModuleCreateFromPTX() for this request, 0 for hits.
+    double compileMilliseconds;
+};
+
+/// Result of #optixUtilCompileModules().
+struct OptixUtilModuleCompileReport
+{
+    size_t numRequests;
+    /// Requests found in the cache.
+    size_t numHits;
+    /// Requests with the same key as an earlier request of the batch.
+    size_t numDeduplicated;
+    /// Modules compiled, including failures.
+    size_t numCompiled;
+    size_t numFailed;
+    /// Sum and maximum of the compile latencies.
+    double compileMilliseconds;
+    double maxCompileMilliseconds;
+    /// Compile time the hits took when they were compiled.
+    double savedMilliseconds;
+    /// Host time of the call, including hashing.
+    double hostMilliseconds;
+};
+
+/// Statistics accumulated over all batches compiled into a cache.
+struct OptixUtilModuleCacheStats
+{
+    size_t numHits;
+    size_t numMisses;
+    size_t numFailed;
+    double compileMilliseconds;
+    double savedMilliseconds;
+};
+
+namespace optix_util_impl {
+
+/// Hash of the compile options by value. Pointers are followed: bound values contribute their offset, size and
+/// bytes, the launch parameter variable contributes its name. Annotations only affect diagnostics and are skipped.
+inline uint64_t hashModuleCompileOptions( const OptixModuleCompileOptions&   moduleOptions,
+                                          const OptixPipelineCompileOptions& pipelineOptions,
+                                          uint64_t                           seed )
+{
+    const uint64_t fields[] = {(uint64_t)(int64_t)moduleOptions.maxRegisterCount,
+                               (uint64_t)moduleOptions.optLevel,
+                               (uint64_t)moduleOptions.debugLevel,
+                               moduleOptions.numBoundValues,
+                               (uint64_t)(int64_t)pipelineOptions.usesMotionBlur,
+                               pipelineOptions.traversableGraphFlags,
+                               (uint64_t)(int64_t)pipelineOptions.numPayloadValues,
+                               (uint64_t)(int64_t)pipelineOptions.numAttributeValues,
+                               pipelineOptions.exceptionFlags,
+                               pipelineOptions.usesPrimitiveTypeFlags};
+    uint64_t       key      = hashBytes( fields, sizeof( fields ), seed );
+    for( unsigned int i = 0; i < moduleOptions.numBoundValues; ++i )
+    {
+        const OptixModuleCompileBoundValueEntry& entry    = moduleOptions.boundValues[i];
+        const uint64_t                           range[2] = {entry.pipelineParamOffsetInBytes, entry.sizeInBytes};
+        key = hashBytes( range, sizeof( range ), key );
+        key = hashBytes( entry.boundValuePtr, entry.sizeInBytes, key );
+    }
+    const char* name = pipelineOptions.pipelineLaunchParamsVariableName;
+    return hashBytes( name ? name : "", name ? std::strlen( name ) + 1 : 0, key );
+}
+
+inline size_t modulePtxSize( const OptixUtilModuleRequest& request )
+{
+    return request.ptxSize ? request.ptxSize : std::strlen( request.ptx );
+}
+
+}  // namespace optix_util_impl
+
+/// Returns the cache key of a module: a hash of the PTX and of the module and pipeline compile options.
+///
+/// \param[in]  moduleOptions     Module compile options.
+/// \param[in]  pipelineOptions   Pipeline compile options.
+/// \param[in]  ptx               PTX source.
+/// \param[in]  ptxSize           Size of ptx in bytes.
+inline uint64_t optixUtilComputeModuleCacheKey( const OptixModuleCompileOptions&   moduleOptions,
+                                                const OptixPipelineCompileOptions& pipelineOptions,
+                                                const char*                        ptx,
+                                                size_t                             ptxSize )
+{
+    using namespace optix_util_impl;
+
+    const uint64_t version[] = {OPTIX_UTIL_MODULE_CACHE_VERSION, OPTIX_ABI_VERSION, ptxSize};
+    const uint64_t key       = hashBytes( version, sizeof( version ), 0 );
+    return hashBytes( ptx, ptxSize, hashModuleCompileOptions( moduleOptions, pipelineOptions, key ) );
+}
+
+/// Compiled modules of one device context, keyed by #optixUtilComputeModuleCacheKey().
+///
+/// The cache owns its modules. Release them with #optixUtilReleaseModuleCache() before destroying the context.
+class OptixUtilModuleCache
+{
+  public:
+    /// Returns the module with the given key, null if there is none.
+    OptixModule find( uint64_t key ) const
+    {
+        const auto it = m_entries.find( key );
+        return it != m_entries.end() ? it->second.module : nullptr;
+    }
+
+    size_t size() const { return m_entries.size(); }
+
+    /// Compile logs of the failed requests of the last batch, each preceded by the request index.
+    const std::string& errorLog() const { return m_errorLog; }
+
+    const OptixUtilModuleCacheStats& stats() const { return m_stats; }
+
+  private:
+    friend OptixResult optixUtilCompileModules( const OptixFunctionTable&,
+                                                OptixDeviceContext,
+                                                OptixUtilModuleCache&,
+                                                const OptixUtilModuleRequest*,
+                                                size_t,
+                                                OptixUtilModuleResult*,
+                                                OptixUtilModuleCompileReport*,
+                                                unsigned int );
+    friend OptixResult optixUtilReleaseModuleCache( const OptixFunctionTable&, OptixUtilModuleCache& );
+
+    struct Entry
+    {
+        OptixModule module;
+        double      compileMilliseconds;
+    };
+
+    std::unordered_map<uint64_t, Entry> m_entries;
+    OptixDeviceContext                  m_context = nullptr;
+    std::string                         m_errorLog;
+    OptixUtilModuleCacheStats           m_stats = {};
+};
+
+/// Returns the modules of a batch of requests, compiling the ones that are not in the cache in parallel.
+///
+/// Compiled modules are added to the cache. Failed compilations are not cached, their logs are available from
+/// OptixUtilModuleCache::errorLog(). results is filled for every request even if some fail.
+///
+/// \param[in]     api          OptiX function table, see optixInit().
+/// \param[in]     context      Device context. Must be the same for all batches compiled into a cache.
+/// \param[in,out] cache        Module cache.
+/// \param[in]     requests     Modules to compile.
+/// \param[in]     count        Number of requests.
+/// \param[out]    results      Module and statistics of each request.
+/// \param[out]    report       Optional statistics of the batch.
+/// \param[in]     maxThreads   Upper bound on the number of concurrent compilations, 0 for
+///                             #optixUtilGetDefaultThreadCount().
+/// \return OPTIX_SUCCESS, or the error of the first failed request.
+inline OptixResult optixUtilCompileModules( const OptixFunctionTable&     api,
+                                            OptixDeviceContext            context,
+                                            OptixUtilModuleCache&         cache,
+                                            const OptixUtilModuleRequest* requests,
+                                            size_t                        count,
+                                            OptixUtilModuleResult*        results,
+                                            OptixUtilModuleCompileReport* report     = nullptr,
+                                            unsigned int                  maxThreads = 0 )
+{
+    using namespace optix_util_impl;
+
+    if( count && ( !requests || !results ) )
+        return OPTIX_ERROR_INVALID_VALUE;
+    for( size_t i = 0; i < count; ++i )
+        if( !requests[i].moduleCompileOptions || !requests[i].pipelineCompileOptions || !requests[i].ptx )
+            return OPTIX_ERROR_INVALID_VALUE;
+    if( cache.m_context && cache.m_context != context )
+        return OPTIX_ERROR_INVALID_VALUE;
+    cache.m_context = context;
+    const auto start = std::chrono::steady_clock::now();
+
+    // PTX of a module is typically hundreds of kilobytes, so hash the requests in parallel.
+    std::vector<size_t> ptxSizes( count );
+    optixUtilParallelFor( count, 1,
+                          [&]( size_t first, size_t last ) {
+                              for( size_t i = first; i < last; ++i )
+                              {
+                                  const OptixUtilModuleRequest& request = requests[i];
+                                  ptxSizes[i]                           = modulePtxSize( request );
+                                  results[i]                            = OptixUtilModuleResult();
+                                  results[i].key = optixUtilComputeModuleCacheKey( *request.moduleCompileOptions,
+                                                                                   *request.pipelineCompileOptions,
+                                                                                   request.ptx, ptxSizes[i] );
+                              }
+                          },
+                          maxThreads );
+
+    // Resolve hits and collect one request per missing key.
+    OptixUtilModuleCompileReport        batch = {};
+    std::unordered_map<uint64_t, size_t> firstRequest;
+    std::vector<size_t>                  misses;
+    for( size_t i = 0; i < count; ++i )
+    {
+        const auto entry = cache.m_entries.find( results[i].key );
+        if( entry != cache.m_entries.end() )
+        {
+            results[i].module   = entry->second.module;
+            results[i].result   = OPTIX_SUCCESS;
+            results[i].cacheHit = true;
+            batch.savedMilliseconds += entry->second.compileMilliseconds;
+            ++batch.numHits;
+        }
+        else if( firstRequest.emplace( results[i].key, i ).second )
+            misses.push_back( i );
+    }
+
+    // Largest first, so that a large module compiled last does not leave the other threads idle.
+    std::stable_sort( misses.begin(), misses.end(), [&]( size_t a, size_t b ) { return ptxSizes[a] > ptxSizes[b]; } );
+
+    std::vector<std::string> logs( misses.size() );
+    optixUtilParallelFor( misses.size(), 1,
+                          [&]( size_t first, size_t last ) {
+                              for( size_t m = first; m < last; ++m )
+                              {
+                                  const size_t                  i       = misses[m];
+                                  const OptixUtilModuleRequest& request = requests[i];
+                                  OptixUtilModuleResult&        result  = results[i];
+                                  char                          log[2048];
+                                  size_t                        logSize = sizeof( log );
+                                  const auto                    begin   = std::chrono::steady_clock::now();
+                                  result.result                         = api.optixModuleCreateFromPTX(
+                                      context, request.moduleCompileOptions, request.pipelineCompileOptions,
+                                      request.ptx, ptxSizes[i], log, &logSize, &result.module );
+                                  const std::chrono::duration<double, std::milli> elapsed =
+                                      std::chrono::steady_clock::now() - begin;
+                                  result.compileMilliseconds = elapsed.count();
+                                  if( result.result != OPTIX_SUCCESS )
+                                  {
+                                      const size_t size = std::min( logSize, sizeof( log ) );
+                                      const void*  nul  = std::memchr( log, 0, size );
+                                      result.module     = nullptr;
+                                      logs[m].assign( log, nul ? static_cast<const char*>( nul ) - log : size );
+                                  }
+                              }
+                          },
+                          maxThreads );
+
+    cache.m_errorLog.clear();
+    OptixResult firstError = OPTIX_SUCCESS;
+    for( size_t m = 0; m < misses.size(); ++m )
+    {
+        const size_t i = misses[m];
+        ++batch.numCompiled;
+        batch.compileMilliseconds += results[i].compileMilliseconds;
+        batch.maxCompileMilliseconds = std::max( batch.maxCompileMilliseconds, results[i].compileMilliseconds );
+        if( results[i].result == OPTIX_SUCCESS )
+        {
+            cache.m_entries[results[i].key] = {results[i].module, results[i].compileMilliseconds};
+            continue;
+        }
+        ++batch.numFailed;
+        cache.m_errorLog += "request " + std::to_string( i ) + ":\n";
+        cache.m_errorLog += logs[m];
+        cache.m_errorLog += '\n';
+    }
+
+    // Later requests with the key of a compiled request share its module, or its failure.
+    for( size_t i = 0; i < count; ++i )
+    {
+        if( results[i].cacheHit )
+            continue;
+        const size_t compiled = firstRequest[results[i].key];
+        if( compiled != i )
+        {
+            results[i].module   = results[compiled].module;
+            results[i].result   = results[compiled].result;
+            results[i].cacheHit = true;
+            ++batch.numDeduplicated;
+        }
+        if( results[i].result != OPTIX_SUCCESS && firstError == OPTIX_SUCCESS )
+            firstError = results[i].result;
+    }
+
+    cache.m_stats.numHits += batch.numHits + batch.numDeduplicated;
+    cache.m_stats.numMisses += batch.numCompiled;
+    cache.m_stats.numFailed += batch.numFailed;
+    cache.m_stats.compileMilliseconds += batch.compileMilliseconds;
+    cache.m_stats.savedMilliseconds += batch.savedMilliseconds;
+
+    if( report )
+    {
+        *report             = batch;
+        report->numRequests = count;
+        report->hostMilliseconds =
+            std::chrono::duration<double, std::milli>( std::chrono::steady_clock::now() - start ).count();
+    }
+    return firstError;
+}
+
+/// Destroys all modules of cache and empties it. Returns the first error of optixModuleDestroy().
+inline OptixResult optixUtilReleaseModuleCache( const OptixFunctionTable& api, OptixUtilModuleCache& cache )
+{
+    OptixResult firstError = OPTIX_SUCCESS;
+    for( const auto& entry : cache.m_entries )
+    {
+        const OptixResult result = api.optixModuleDestroy( entry.second.module );
+        if( result != OPTIX_SUCCESS && firstError == OPTIX_SUCCESS )
+            firstError = result;
+    }
+    cache.m_entries.clear();
+    cache.m_context = nullptr;
+    cache.m_errorLog.clear();
+    return firstError;
+}
+
+/*@}*/  // end group optix_utilities
+
+#endif  // __optix_optix_util_module_cache_h__
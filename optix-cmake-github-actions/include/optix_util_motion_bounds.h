@@ -0,0 +1,337 @@
+/// @file
+/// @brief  OptiX host utilities: conservative world bounds of children under motion transforms
+///
+/// Computes AABBs that contain a child's bounds over the whole motion range of an #OptixMatrixMotionTransform,
+/// #OptixSRTMotionTransform or #OptixStaticTransform, e.g. as input for instance AABBs when building a motion IAS.
+///
+/// For matrix motion every point moves linearly between keys, so the union of the per-key boxes is already exact.
+/// SRT motion renormalizes the interpolated quaternion (see optixLoadInterpolatedSrtKey()), so points travel on
+/// curved paths that can leave the per-key boxes. Each SRT key interval is therefore subdivided adaptively. For a
+/// sub-interval [a, b] the transformed point differs from the chord between its positions at a and b by at most
+/// rho * 2 sin( theta / 2 ), where rho bounds |S(t) p| over the child box and theta is the rotation angle between the
+/// interpolated rotations at a and b. The sub-interval box is the union of the boxes at a and b grown by that amount.
+
+#ifndef __optix_optix_util_motion_bounds_h__
+#define __optix_optix_util_motion_bounds_h__
+
+#include "optix_util_parallel.h"
+#include "optix_util_transform.h"
+
+#include <algorithm>
+#include <atomic>
+#include <cfloat>
+#include <cmath>
+#include <cstddef>
+
+/** \addtogroup optix_utilities
+@{
+*/
+
+/// One transform whose motion bounds are computed by #optixUtilComputeMotionBounds().
+struct OptixUtilMotionBoundsInput
+{
+    /// OPTIX_TRAVERSABLE_TYPE_STATIC_TRANSFORM, OPTIX_TRAVERSABLE_TYPE_MATRIX_MOTION_TRANSFORM or
+    /// OPTIX_TRAVERSABLE_TYPE_SRT_MOTION_TRANSFORM.
+    OptixTraversableType type;
+
+    /// Host copy of the transform struct of the given type, including all motion keys.
+    const void* transform;
+
+    /// Object-space bounds of the child. To bound a chain of transforms, pass the result for the inner transform as
+    /// child bounds of the outer one.
+    OptixAabb childBounds;
+};
+
+/// Options for #optixUtilComputeMotionBounds().
+struct OptixUtilMotionBoundsOptions
+{
+    /// SRT intervals are subdivided until the curvature padding is at most this world-space distance.
+    float tolerance;
+
+    /// Maximum subdivision depth per SRT key interval, 0 means 12 (4096 sub-intervals).
+    unsigned int maxDepth;
+
+    /// Upper bound on worker threads, 0 for automatic.
+    unsigned int maxThreads;
+};
+
+/// Bound quality of one transform.
+struct OptixUtilMotionBoundsReport
+{
+    /// Volume of the conservative motion bounds.
+    double volume;
+
+    /// Volume of the union of the child bounds transformed at the motion keys only. For SRT motion this box is
+    /// not conservative.
+    double keyUnionVolume;
+
+    /// Volume of the union of the boxes at all sub-interval end points, without padding. The true swept bounds lie
+    /// between this lower bound and the conservative bounds, so volume / sampledVolume is a measure of tightness.
+    double sampledVolume;
+
+    /// Number of sub-intervals evaluated over all keys.
+    unsigned int numSubIntervals;
+};
+
+namespace optix_util_impl {
+
+inline OptixAabb emptyAabb()
+{
+    return {FLT_MAX, FLT_MAX, FLT_MAX, -FLT_MAX, -FLT_MAX, -FLT_MAX};
+}
+
+inline void growAabb( OptixAabb& box, const OptixAabb& other )
+{
+    box.minX = std::min( box.minX, other.minX );
+    box.minY = std::min( box.minY, other.minY );
+    box.minZ = std::min( box.minZ, other.minZ );
+    box.maxX = std::max( box.maxX, other.maxX );
+    box.maxY = std::max( box.maxY, other.maxY );
+    box.maxZ = std::max( box.maxZ, other.maxZ );
+}
+
+inline void padAabb( OptixAabb& box, float pad )
+{
+    box.minX -= pad;
+    box.minY -= pad;
+    box.minZ -= pad;
+    box.maxX += pad;
+    box.maxY += pad;
+    box.maxZ += pad;
+}
+
+inline double aabbVolume( const OptixAabb& box )
+{
+    if( box.maxX < box.minX || box.maxY < box.minY || box.maxZ < box.minZ )
+        return 0.0;
+    return ( (double)box.maxX - box.minX ) * ( (double)box.maxY - box.minY ) * ( (double)box.maxZ - box.minZ );
+}
+
+// Bounds of box under the affine matrix m, exact for boxes (Arvo's method).
+inline OptixAabb transformAabb( const float* m, const OptixAabb& box )
+{
+    const float lo[3] = {box.minX, box.minY, box.minZ};
+    const float hi[3] = {box.maxX, box.maxY, box.maxZ};
+    float       rmin[3], rmax[3];
+    for( int i = 0; i < 3; ++i )
+    {
+        rmin[i] = rmax[i] = m[4 * i + 3];
+        for( int j = 0; j < 3; ++j )
+        {
+            const float a = m[4 * i + j] * lo[j];
+            const float b = m[4 * i + j] * hi[j];
+            rmin[i] += std::min( a, b );
+            rmax[i] += std::max( a, b );
+        }
+    }
+    return {rmin[0], rmin[1], rmin[2], rmax[0], rmax[1], rmax[2]};
+}
+
+// Largest |S p| over the corners of box, where S is the scale/shear/pivot part of srt.
+inline float srtScaledRadius( const OptixSRTData& srt, const OptixAabb& box )
+{
+    float radius = 0.0f;
+    for( int c = 0; c < 8; ++c )
+    {
+        const float x = ( c & 1 ) ? box.maxX : box.minX;
+        const float y = ( c & 2 ) ? box.maxY : box.minY;
+        const float z = ( c & 4 ) ? box.maxZ : box.minZ;
+        const float px = srt.sx * x + srt.a * y + srt.b * z + srt.pvx;
+        const float py = srt.sy * y + srt.c * z + srt.pvy;
+        const float pz = srt.sz * z + srt.pvz;
+        radius = std::max( radius, std::sqrt( px * px + py * py + pz * pz ) );
+    }
+    return radius;
+}
+
+// Upper bound on the operator norm of R(a) - R(b) for the rotations of two SRT keys.
+inline float srtRotationDistance( const OptixSRTData& a, const OptixSRTData& b )
+{
+    const float la  = std::sqrt( a.qx * a.qx + a.qy * a.qy + a.qz * a.qz + a.qw * a.qw );
+    const float lb  = std::sqrt( b.qx * b.qx + b.qy * b.qy + b.qz * b.qz + b.qw * b.qw );
+    const float dot = ( a.qx * b.qx + a.qy * b.qy + a.qz * b.qz + a.qw * b.qw ) / ( la * lb );
+    // The rotation angle is twice the quaternion angle, |R(a) - R(b)| = 2 sin( angle / 2 ). The interpolated path
+    // goes the long way for negative dot products, where the bound saturates at 2.
+    if( !( dot > 0.0f ) )
+        return 2.0f;
+    const float halfAngle = std::acos( std::min( dot, 1.0f ) );
+    return 2.0f * std::sin( halfAngle ) + 4.0f * FLT_EPSILON;
+}
+
+struct SrtBoundsState
+{
+    const OptixAabb* child;
+    float            tolerance;
+    unsigned int     maxDepth;
+    OptixAabb        bounds;
+    OptixAabb        sampled;
+    unsigned int     numSubIntervals;
+};
+
+inline void boundSrtSubInterval( SrtBoundsState& state, const OptixSRTData& k0, const OptixSRTData& k1, float ta, float tb,
+                                 const OptixSRTData& sa, const OptixSRTData& sb, const OptixAabb& boxA, const OptixAabb& boxB, unsigned int depth )
+{
+    const float rho     = std::max( srtScaledRadius( sa, *state.child ), srtScaledRadius( sb, *state.child ) );
+    const float padding = rho * srtRotationDistance( sa, sb );
+
+    if( padding > state.tolerance && depth < state.maxDepth )
+    {
+        const float  tm = 0.5f * ( ta + tb );
+        OptixSRTData sm;
+        optixUtilInterpolateSrtKey( sm, k0, k1, tm );
+        float m[12];
+        optixUtilGetMatrixFromSrt( m, sm );
+        const OptixAabb boxM = transformAabb( m, *state.child );
+        growAabb( state.sampled, boxM );
+
+        boundSrtSubInterval( state, k0, k1, ta, tm, sa, sm, boxA, boxM, depth + 1 );
+        boundSrtSubInterval( state, k0, k1, tm, tb, sm, sb, boxM, boxB, depth + 1 );
+        return;
+    }
+
+    OptixAabb box = boxA;
+    growAabb( box, boxB );
+    padAabb( box, padding );
+    growAabb( state.bounds, box );
+    ++state.numSubIntervals;
+}
+
+// Conservative float rounding margin relative to the magnitude of the box.
+inline void padForRounding( OptixAabb& box )
+{
+    const float magnitude = std::max( std::max( std::max( std::fabs( box.minX ), std::fabs( box.maxX ) ),
+                                                std::max( std::fabs( box.minY ), std::fabs( box.maxY ) ) ),
+                                      std::max( std::fabs( box.minZ ), std::fabs( box.maxZ ) ) );
+    padAabb( box, magnitude * 8.0f * FLT_EPSILON );
+}
+
+inline OptixResult computeMotionBounds( const OptixUtilMotionBoundsInput&   input,
+                                        const OptixUtilMotionBoundsOptions& options,
+                                        OptixAabb&                          bounds,
+                                        OptixUtilMotionBoundsReport*        report )
+{
+    if( !input.transform )
+        return OPTIX_ERROR_INVALID_VALUE;
+
+    OptixAabb    keyUnion        = emptyAabb();
+    OptixAabb    sampled         = emptyAabb();
+    unsigned int numSubIntervals = 0;
+    bounds                       = emptyAabb();
+
+    switch( input.type )
+    {
+        case OPTIX_TRAVERSABLE_TYPE_STATIC_TRANSFORM:
+        {
+            const OptixStaticTransform* transform = static_cast<const OptixStaticTransform*>( input.transform );
+            keyUnion = sampled = bounds = transformAabb( transform->transform, input.childBounds );
+            break;
+        }
+        case OPTIX_TRAVERSABLE_TYPE_MATRIX_MOTION_TRANSFORM:
+        {
+            const OptixMatrixMotionTransform* transform = static_cast<const OptixMatrixMotionTransform*>( input.transform );
+            const unsigned int numKeys = std::max<unsigned int>( transform->motionOptions.numKeys, 1 );
+            for( unsigned int k = 0; k < numKeys; ++k )
+                growAabb( keyUnion, transformAabb( transform->transform[k], input.childBounds ) );
+            // Points move linearly between matrix keys, so the key union is exact.
+            sampled = bounds = keyUnion;
+            numSubIntervals  = numKeys - 1;
+            break;
+        }
+        case OPTIX_TRAVERSABLE_TYPE_SRT_MOTION_TRANSFORM:
+        {
+            const OptixSRTMotionTransform* transform = static_cast<const OptixSRTMotionTransform*>( input.transform );
+            const unsigned int numKeys = std::max<unsigned int>( transform->motionOptions.numKeys, 1 );
+
+            SrtBoundsState state;
+            state.child           = &input.childBounds;
+            state.tolerance       = options.tolerance;
+            state.maxDepth        = options.maxDepth ? options.maxDepth : 12u;
+            state.bounds          = emptyAabb();
+            state.sampled         = emptyAabb();
+            state.numSubIntervals = 0;
+
+            float m[12];
+            optixUtilGetMatrixFromSrt( m, transform->srtData[0] );
+            OptixAabb box0 = transformAabb( m, input.childBounds );
+            growAabb( keyUnion, box0 );
+            growAabb( state.sampled, box0 );
+            growAabb( state.bounds, box0 );
+
+            for( unsigned int k = 0; k + 1 < numKeys; ++k )
+            {
+                // Normalized like the device does after interpolation, so the end points match sub-interval keys.
+                OptixSRTData s0, s1;
+                optixUtilInterpolateSrtKey( s0, transform->srtData[k], transform->srtData[k + 1], 0.0f );
+                optixUtilInterpolateSrtKey( s1, transform->srtData[k], transform->srtData[k + 1], 1.0f );
+                optixUtilGetMatrixFromSrt( m, s1 );
+                const OptixAabb box1 = transformAabb( m, input.childBounds );
+                growAabb( keyUnion, box1 );
+                growAabb( state.sampled, box1 );
+
+                boundSrtSubInterval( state, transform->srtData[k], transform->srtData[k + 1], 0.0f, 1.0f, s0, s1, box0,
+                                     box1, 0 );
+                box0 = box1;
+            }
+
+            bounds          = state.bounds;
+            sampled         = state.sampled;
+            numSubIntervals = state.numSubIntervals;
+            break;
+        }
+        default:
+            return OPTIX_ERROR_INVALID_VALUE;
+    }
+
+    padForRounding( bounds );
+
+    if( report )
+    {
+        report->volume          = aabbVolume( bounds );
+        report->keyUnionVolume  = aabbVolume( keyUnion );
+        report->sampledVolume   = aabbVolume( sampled );
+        report->numSubIntervals = numSubIntervals;
+    }
+    return OPTIX_SUCCESS;
+}
+
+}  // namespace optix_util_impl
+
+/// Computes conservative world-space bounds of each input's child over the full motion range of its transform.
+///
+/// Inputs are processed in parallel.
+///
+/// \param[in]  inputs       Array of numInputs transforms.
+/// \param[in]  numInputs    Number of inputs.
+/// \param[in]  options      Subdivision and threading options.
+/// \param[out] bounds       Array of numInputs boxes.
+/// \param[out] reports      Optional array of numInputs bound quality reports.
+inline OptixResult optixUtilComputeMotionBounds( const OptixUtilMotionBoundsInput*   inputs,
+                                                 size_t                              numInputs,
+                                                 const OptixUtilMotionBoundsOptions& options,
+                                                 OptixAabb*                          bounds,
+                                                 OptixUtilMotionBoundsReport*        reports = nullptr )
+{
+    if( numInputs == 0 )
+        return OPTIX_SUCCESS;
+    if( !inputs || !bounds || !( options.tolerance >= 0.0f ) )
+        return OPTIX_ERROR_INVALID_VALUE;
+
+    std::atomic<int> failure( OPTIX_SUCCESS );
+    optixUtilParallelFor( numInputs, 64,
+                          [&]( size_t begin, size_t end ) {
+                              for( size_t i = begin; i < end; ++i )
+                              {
+                                  const OptixResult result = optix_util_impl::computeMotionBounds(
+                                      inputs[i], options, bounds[i], reports ? &reports[i] : nullptr );
+                                  if( result != OPTIX_SUCCESS )
+                                      failure = result;
+                              }
+                          },
+                          options.maxThreads );
+
+    return (OptixResult)failure.load();
+}
+
+/*@}*/  // end group optix_utilities
+
+#endif  // __optix_optix_util_motion_bounds_h__
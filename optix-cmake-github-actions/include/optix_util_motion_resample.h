@@ -0,0 +1,453 @@
+/// @file
+/// @brief  OptiX host utilities: motion transform key resampling and blob emission
+///
+/// #OptixMatrixMotionTransform and #OptixSRTMotionTransform require keys uniformly spaced between
+/// OptixMotionOptions::timeBegin and OptixMotionOptions::timeEnd. The resamplers in this header take keys at arbitrary
+/// times and find the smallest uniform key count whose device-side interpolation (see optixResolveMotionKey(),
+/// optixLoadInterpolatedMatrixKey() and optixLoadInterpolatedSrtKey()) stays within a world-space distance tolerance of
+/// the source animation. The append functions write the result as motion transform structs ready for upload.
+
+#ifndef __optix_optix_util_motion_resample_h__
+#define __optix_optix_util_motion_resample_h__
+
+#include "optix_util_transform.h"
+
+#include <algorithm>
+#include <cmath>
+#include <cstddef>
+#include <cstring>
+#include <vector>
+
+/** \addtogroup optix_utilities
+@{
+*/
+
+/// Default for OptixUtilMotionResampleOptions::maxKeys.
+#define OPTIX_UTIL_DEFAULT_MAX_MOTION_KEYS 256u
+
+/// Options for #optixUtilResampleMatrixMotionKeys() and #optixUtilResampleSrtMotionKeys().
+struct OptixUtilMotionResampleOptions
+{
+    /// Maximum allowed distance between the source and the resampled animation, measured at the corners of bounds.
+    float tolerance;
+
+    /// Object-space bounds of the transformed child. The error is measured at its 8 corners, so the tolerance applies
+    /// to world-space positions of the geometry rather than to raw matrix elements.
+    OptixAabb bounds;
+
+    /// Upper limit on the number of output keys. 0 means #OPTIX_UTIL_DEFAULT_MAX_MOTION_KEYS. Larger values are clamped
+    /// to 65535, the limit of OptixMotionOptions::numKeys.
+    unsigned int maxKeys;
+
+    /// Number of time samples per output key interval at which the error is evaluated, in addition to all source key
+    /// times. 0 means 8.
+    unsigned int samplesPerInterval;
+};
+
+/// Outcome of resampling one animated transform.
+struct OptixUtilMotionResampleReport
+{
+    /// Number of source keys.
+    unsigned int inputKeyCount;
+    /// Number of uniform keys emitted.
+    unsigned int outputKeyCount;
+    /// Size of a motion transform holding the source key count, see #optixUtilMatrixMotionTransformSize().
+    size_t inputSizeInBytes;
+    /// Size of the emitted motion transform.
+    size_t outputSizeInBytes;
+    /// Largest measured distance between source and resampled animation.
+    float maxError;
+    /// Whether maxError is within the tolerance. False if maxKeys was reached first.
+    bool withinTolerance;
+};
+
+/// Size in bytes of an #OptixMatrixMotionTransform with numKeys keys, padded to OPTIX_TRANSFORM_BYTE_ALIGNMENT so that
+/// consecutive transforms in one buffer stay aligned.
+inline size_t optixUtilMatrixMotionTransformSize( unsigned int numKeys )
+{
+    const size_t size = sizeof( OptixMatrixMotionTransform ) + ( std::max( numKeys, 2u ) - 2 ) * 12 * sizeof( float );
+    return ( size + OPTIX_TRANSFORM_BYTE_ALIGNMENT - 1 ) & ~( OPTIX_TRANSFORM_BYTE_ALIGNMENT - 1 );
+}
+
+/// Size in bytes of an #OptixSRTMotionTransform with numKeys keys, padded to OPTIX_TRANSFORM_BYTE_ALIGNMENT.
+inline size_t optixUtilSrtMotionTransformSize( unsigned int numKeys )
+{
+    const size_t size = sizeof( OptixSRTMotionTransform ) + ( std::max( numKeys, 2u ) - 2 ) * sizeof( OptixSRTData );
+    return ( size + OPTIX_TRANSFORM_BYTE_ALIGNMENT - 1 ) & ~( OPTIX_TRANSFORM_BYTE_ALIGNMENT - 1 );
+}
+
+namespace optix_util_impl {
+
+// Evaluates a matrix animation with keys at arbitrary, increasing times.
+struct MatrixKeySource
+{
+    const float* times;
+    const float* keys;
+    unsigned int count;
+
+    void evaluate( float time, float* m ) const
+    {
+        const unsigned int i = sourceInterval( times, count, time );
+        const float        t = intervalTime( times, i, time );
+        optixUtilInterpolateMatrixKey( m, keys + 12 * i, keys + 12 * ( i + 1 ), t );
+    }
+
+    static unsigned int sourceInterval( const float* times, unsigned int count, float time )
+    {
+        const float* upper = std::upper_bound( times, times + count, time );
+        const long   i     = (long)( upper - times ) - 1;
+        return (unsigned int)std::max( 0l, std::min( i, (long)count - 2 ) );
+    }
+
+    static float intervalTime( const float* times, unsigned int i, float time )
+    {
+        const float length = times[i + 1] - times[i];
+        return length > 0.0f ? std::max( 0.0f, std::min( 1.0f, ( time - times[i] ) / length ) ) : 0.0f;
+    }
+};
+
+// Evaluates an SRT animation with keys at arbitrary, increasing times.
+struct SrtKeySource
+{
+    const float*        times;
+    const OptixSRTData* keys;
+    unsigned int        count;
+
+    void evaluate( float time, OptixSRTData& srt ) const
+    {
+        const unsigned int i = MatrixKeySource::sourceInterval( times, count, time );
+        const float        t = MatrixKeySource::intervalTime( times, i, time );
+        optixUtilInterpolateSrtKey( srt, keys[i], keys[i + 1], t );
+    }
+};
+
+// Largest distance of the 8 corners of bounds under the matrices a and b.
+inline float cornerDistance( const float* a, const float* b, const OptixAabb& bounds )
+{
+    float maxDistance = 0.0f;
+    for( int c = 0; c < 8; ++c )
+    {
+        const float p[3] = {( c & 1 ) ? bounds.maxX : bounds.minX, ( c & 2 ) ? bounds.maxY : bounds.minY,
+                            ( c & 4 ) ? bounds.maxZ : bounds.minZ};
+        float       pa[3], pb[3];
+        optixUtilTransformPoint( a, p, pa );
+        optixUtilTransformPoint( b, p, pb );
+        const float dx = pa[0] - pb[0], dy = pa[1] - pb[1], dz = pa[2] - pb[2];
+        maxDistance    = std::max( maxDistance, std::sqrt( dx * dx + dy * dy + dz * dz ) );
+    }
+    return maxDistance;
+}
+
+// Evaluates the source at numKeys uniform times into keys (numKeys * stride floats / SRT structs), then measures the
+// error of their device interpolation against the source. Key is float for matrices and OptixSRTData for SRT.
+template <typename Source, typename Key, typename SampleFn, typename MatrixFn>
+inline float resampleAndMeasure( const Source&                         source,
+                                 unsigned int                          numKeys,
+                                 const OptixUtilMotionResampleOptions& options,
+                                 std::vector<Key>&                     keys,
+                                 SampleFn                              sample,
+                                 MatrixFn                              evaluateResampled )
+{
+    const float timeBegin = source.times[0];
+    const float timeEnd   = source.times[source.count - 1];
+
+    sample( numKeys, timeBegin, timeEnd, keys );
+
+    OptixMotionOptions motion = {};
+    motion.numKeys            = (unsigned short)numKeys;
+    motion.timeBegin          = timeBegin;
+    motion.timeEnd            = timeEnd;
+
+    const unsigned int samples = options.samplesPerInterval ? options.samplesPerInterval : 8u;
+    float              error   = 0.0f;
+    auto               measure = [&]( float time ) {
+        float expected[12], actual[12];
+        source.evaluateMatrix( time, expected );
+        evaluateResampled( motion, time, actual );
+        error = std::max( error, cornerDistance( expected, actual, options.bounds ) );
+    };
+
+    for( unsigned int i = 0; i < source.count; ++i )
+        measure( source.times[i] );
+    for( unsigned int i = 0; i + 1 < numKeys; ++i )
+        for( unsigned int s = 1; s <= samples; ++s )
+            measure( timeBegin
+                     + ( timeEnd - timeBegin ) * ( (float)i + (float)s / (float)( samples + 1 ) )
+                           / (float)( numKeys - 1 ) );
+    return error;
+}
+
+struct MatrixSource : MatrixKeySource
+{
+    void evaluateMatrix( float time, float* m ) const { evaluate( time, m ); }
+};
+
+struct SrtSource : SrtKeySource
+{
+    void evaluateMatrix( float time, float* m ) const
+    {
+        OptixSRTData srt;
+        evaluate( time, srt );
+        optixUtilGetMatrixFromSrt( m, srt );
+    }
+};
+
+// Finds the smallest key count in [2, maxKeys] whose error is within tolerance. The error is assumed not to grow
+// with the key count, so the count is doubled until the tolerance is met and the last interval is then bisected,
+// which takes O(log n) calls of measure( n ) instead of n. The last call is for the returned count.
+template <typename MeasureFn>
+inline unsigned int findMotionKeyCount( unsigned int maxKeys, float tolerance, float& error, MeasureFn measure )
+{
+    unsigned int failed = 1;  // largest count known to exceed the tolerance
+    unsigned int count  = 2;
+    error               = measure( count );
+    while( !( error <= tolerance ) && count < maxKeys )
+    {
+        failed = count;
+        count  = std::min( 2 * count, maxKeys );
+        error  = measure( count );
+    }
+    if( !( error <= tolerance ) )
+        return count;
+
+    unsigned int measured = count;
+    while( count - failed > 1 )
+    {
+        const unsigned int mid      = failed + ( count - failed ) / 2;
+        const float        midError = measure( mid );
+        measured                    = mid;
+        if( midError <= tolerance )
+        {
+            count = mid;
+            error = midError;
+        }
+        else
+            failed = mid;
+    }
+    if( measured != count )
+        error = measure( count );
+    return count;
+}
+
+inline unsigned int maxMotionKeys( const OptixUtilMotionResampleOptions& options )
+{
+    return std::min( options.maxKeys ? options.maxKeys : OPTIX_UTIL_DEFAULT_MAX_MOTION_KEYS, 65535u );
+}
+
+inline OptixResult validateResampleInput( const float*                          keyTimes,
+                                          const void*                           keys,
+                                          unsigned int                          keyCount,
+                                          const OptixUtilMotionResampleOptions& options )
+{
+    if( !keyTimes || !keys || keyCount < 2 || !( options.tolerance >= 0.0f ) )
+        return OPTIX_ERROR_INVALID_VALUE;
+    for( unsigned int i = 0; i + 1 < keyCount; ++i )
+        if( !( keyTimes[i] <= keyTimes[i + 1] ) )
+            return OPTIX_ERROR_INVALID_VALUE;
+    if( !( keyTimes[0] < keyTimes[keyCount - 1] ) )
+        return OPTIX_ERROR_INVALID_VALUE;
+    return OPTIX_SUCCESS;
+}
+
+}  // namespace optix_util_impl
+
+/// Resamples a matrix animation with keys at arbitrary times to the smallest number of uniformly spaced keys.
+///
+/// Emits the smallest key count whose error is within options.tolerance, or options.maxKeys if none is. The error is
+/// assumed to decrease with the key count, which lets the search bisect; for animations where it does not, the result
+/// is still within the tolerance but may not be the smallest such count. The uniform keys span
+/// [keyTimes[0], keyTimes[keyCount-1]], which is written to outMotionOptions.
+///
+/// \param[in]  keyTimes           keyCount non-decreasing key times.
+/// \param[in]  keyMatrices        keyCount 3x4 row-major matrices.
+/// \param[in]  keyCount           Number of source keys, at least 2.
+/// \param[in]  options            Resampling options.
+/// \param[out] outMatrices        Resampled keys, 12 floats each.
+/// \param[out] outMotionOptions   Motion options for the resampled keys (numKeys, timeBegin, timeEnd; flags are 0).
+/// \param[out] report             Optional statistics.
+inline OptixResult optixUtilResampleMatrixMotionKeys( const float*                          keyTimes,
+                                                      const float*                          keyMatrices,
+                                                      unsigned int                          keyCount,
+                                                      const OptixUtilMotionResampleOptions& options,
+                                                      std::vector<float>&                   outMatrices,
+                                                      OptixMotionOptions*                   outMotionOptions,
+                                                      OptixUtilMotionResampleReport*        report = nullptr )
+{
+    OptixResult result = optix_util_impl::validateResampleInput( keyTimes, keyMatrices, keyCount, options );
+    if( result != OPTIX_SUCCESS )
+        return result;
+    if( !outMotionOptions )
+        return OPTIX_ERROR_INVALID_VALUE;
+
+    optix_util_impl::MatrixSource source;
+    source.times = keyTimes;
+    source.keys  = keyMatrices;
+    source.count = keyCount;
+
+    auto sample = [&]( unsigned int n, float timeBegin, float timeEnd, std::vector<float>& keys ) {
+        keys.resize( 12 * (size_t)n );
+        for( unsigned int k = 0; k < n; ++k )
+            source.evaluate( timeBegin + ( timeEnd - timeBegin ) * (float)k / (float)( n - 1 ), &keys[12 * (size_t)k] );
+    };
+
+    std::vector<float> keys;
+    auto evaluateResampled = [&]( const OptixMotionOptions& motion, float time, float* m ) {
+        float localt;
+        int   key;
+        optixUtilResolveMotionKey( localt, key, motion, time );
+        const int next = std::min( key + 1, (int)motion.numKeys - 1 );
+        optixUtilInterpolateMatrixKey( m, &keys[12 * (size_t)key], &keys[12 * (size_t)next], localt );
+    };
+
+    float              error = 0.0f;
+    const unsigned int n     = optix_util_impl::findMotionKeyCount(
+        optix_util_impl::maxMotionKeys( options ), options.tolerance, error, [&]( unsigned int count ) {
+            return optix_util_impl::resampleAndMeasure( source, count, options, keys, sample, evaluateResampled );
+        } );
+
+    outMatrices.swap( keys );
+    *outMotionOptions           = {};
+    outMotionOptions->numKeys   = (unsigned short)n;
+    outMotionOptions->timeBegin = keyTimes[0];
+    outMotionOptions->timeEnd   = keyTimes[keyCount - 1];
+
+    if( report )
+    {
+        report->inputKeyCount     = keyCount;
+        report->outputKeyCount    = n;
+        report->inputSizeInBytes  = optixUtilMatrixMotionTransformSize( keyCount );
+        report->outputSizeInBytes = optixUtilMatrixMotionTransformSize( n );
+        report->maxError          = error;
+        report->withinTolerance   = error <= options.tolerance;
+    }
+    return OPTIX_SUCCESS;
+}
+
+/// Resamples an SRT animation with keys at arbitrary times to the smallest number of uniformly spaced keys.
+///
+/// Source and output keys are interpolated like optixLoadInterpolatedSrtKey(), i.e., component-wise linear
+/// interpolation followed by quaternion renormalization. See #optixUtilResampleMatrixMotionKeys() for the parameters.
+inline OptixResult optixUtilResampleSrtMotionKeys( const float*                          keyTimes,
+                                                   const OptixSRTData*                   keys,
+                                                   unsigned int                          keyCount,
+                                                   const OptixUtilMotionResampleOptions& options,
+                                                   std::vector<OptixSRTData>&            outKeys,
+                                                   OptixMotionOptions*                   outMotionOptions,
+                                                   OptixUtilMotionResampleReport*        report = nullptr )
+{
+    OptixResult result = optix_util_impl::validateResampleInput( keyTimes, keys, keyCount, options );
+    if( result != OPTIX_SUCCESS )
+        return result;
+    if( !outMotionOptions )
+        return OPTIX_ERROR_INVALID_VALUE;
+
+    optix_util_impl::SrtSource source;
+    source.times = keyTimes;
+    source.keys  = keys;
+    source.count = keyCount;
+
+    auto sample = [&]( unsigned int n, float timeBegin, float timeEnd, std::vector<OptixSRTData>& out ) {
+        out.resize( n );
+        for( unsigned int k = 0; k < n; ++k )
+            source.evaluate( timeBegin + ( timeEnd - timeBegin ) * (float)k / (float)( n - 1 ), out[k] );
+    };
+
+    std::vector<OptixSRTData> resampled;
+    auto evaluateResampled = [&]( const OptixMotionOptions& motion, float time, float* m ) {
+        float localt;
+        int   key;
+        optixUtilResolveMotionKey( localt, key, motion, time );
+        const int    next = std::min( key + 1, (int)motion.numKeys - 1 );
+        OptixSRTData srt;
+        optixUtilInterpolateSrtKey( srt, resampled[key], resampled[next], localt );
+        optixUtilGetMatrixFromSrt( m, srt );
+    };
+
+    float              error = 0.0f;
+    const unsigned int n     = optix_util_impl::findMotionKeyCount(
+        optix_util_impl::maxMotionKeys( options ), options.tolerance, error, [&]( unsigned int count ) {
+            return optix_util_impl::resampleAndMeasure( source, count, options, resampled, sample, evaluateResampled );
+        } );
+
+    outKeys.swap( resampled );
+    *outMotionOptions           = {};
+    outMotionOptions->numKeys   = (unsigned short)n;
+    outMotionOptions->timeBegin = keyTimes[0];
+    outMotionOptions->timeEnd   = keyTimes[keyCount - 1];
+
+    if( report )
+    {
+        report->inputKeyCount     = keyCount;
+        report->outputKeyCount    = n;
+        report->inputSizeInBytes  = optixUtilSrtMotionTransformSize( keyCount );
+        report->outputSizeInBytes = optixUtilSrtMotionTransformSize( n );
+        report->maxError          = error;
+        report->withinTolerance   = error <= options.tolerance;
+    }
+    return OPTIX_SUCCESS;
+}
+
+/// Appends an #OptixMatrixMotionTransform with motionOptions.numKeys keys to blob.
+///
+/// The transform starts at a multiple of OPTIX_TRANSFORM_BYTE_ALIGNMENT relative to the start of blob and is padded
+/// to that alignment, so blob can be uploaded to a suitably aligned device allocation as a whole.
+///
+/// \param[in,out] blob            Byte buffer to append to.
+/// \param[in]     child           Traversable transformed by the motion transform.
+/// \param[in]     motionOptions   Motion options, numKeys must be at least 2.
+/// \param[in]     matrices        motionOptions.numKeys 3x4 row-major matrices.
+/// \param[out]    offset          Optional byte offset of the new transform within blob.
+inline OptixResult optixUtilAppendMatrixMotionTransform( std::vector<unsigned char>& blob,
+                                                         OptixTraversableHandle      child,
+                                                         const OptixMotionOptions&   motionOptions,
+                                                         const float*                matrices,
+                                                         size_t*                     offset = nullptr )
+{
+    if( !matrices || motionOptions.numKeys < 2 )
+        return OPTIX_ERROR_INVALID_VALUE;
+
+    const size_t start = ( blob.size() + OPTIX_TRANSFORM_BYTE_ALIGNMENT - 1 ) & ~( OPTIX_TRANSFORM_BYTE_ALIGNMENT - 1 );
+    blob.resize( start + optixUtilMatrixMotionTransformSize( motionOptions.numKeys ), 0 );
+
+    OptixMatrixMotionTransform header = {};
+    header.child                      = child;
+    header.motionOptions              = motionOptions;
+    std::memcpy( &blob[start], &header, offsetof( OptixMatrixMotionTransform, transform ) );
+    std::memcpy( &blob[start + offsetof( OptixMatrixMotionTransform, transform )], matrices,
+                 motionOptions.numKeys * 12 * sizeof( float ) );
+
+    if( offset )
+        *offset = start;
+    return OPTIX_SUCCESS;
+}
+
+/// Appends an #OptixSRTMotionTransform with motionOptions.numKeys keys to blob.
+///
+/// See #optixUtilAppendMatrixMotionTransform() for alignment and parameters.
+inline OptixResult optixUtilAppendSrtMotionTransform( std::vector<unsigned char>& blob,
+                                                      OptixTraversableHandle      child,
+                                                      const OptixMotionOptions&   motionOptions,
+                                                      const OptixSRTData*         keys,
+                                                      size_t*                     offset = nullptr )
+{
+    if( !keys || motionOptions.numKeys < 2 )
+        return OPTIX_ERROR_INVALID_VALUE;
+
+    const size_t start = ( blob.size() + OPTIX_TRANSFORM_BYTE_ALIGNMENT - 1 ) & ~( OPTIX_TRANSFORM_BYTE_ALIGNMENT - 1 );
+    blob.resize( start + optixUtilSrtMotionTransformSize( motionOptions.numKeys ), 0 );
+
+    OptixSRTMotionTransform header = {};
+    header.child                   = child;
+    header.motionOptions           = motionOptions;
+    std::memcpy( &blob[start], &header, offsetof( OptixSRTMotionTransform, srtData ) );
+    std::memcpy( &blob[start + offsetof( OptixSRTMotionTransform, srtData )], keys,
+                 motionOptions.numKeys * sizeof( OptixSRTData ) );
+
+    if( offset )
+        *offset = start;
+    return OPTIX_SUCCESS;
+}
+
+/*@}*/  // end group optix_utilities
+
+#endif  // __optix_optix_util_motion_resample_h__
@@ -0,0 +1,75 @@
+/// @file
+/// @brief  OptiX host utilities: minimal fork-join parallel loop
+///
+/// The optix_util headers only need to split independent index ranges over CPU cores, so this header provides a
+/// single blocking parallel-for on top of std::thread instead of depending on a task library.
+
+#ifndef __optix_optix_util_parallel_h__
+#define __optix_optix_util_parallel_h__
+
+#include <algorithm>
+#include <atomic>
+#include <cstddef>
+#include <thread>
+#include <vector>
+
+/** \addtogroup optix_utilities
+@{
+*/
+
+/// Returns the number of worker threads used when a parallel utility is asked for 0 (automatic) threads.
+inline unsigned int optixUtilGetDefaultThreadCount()
+{
+    const unsigned int n = std::thread::hardware_concurrency();
+    return n ? n : 1u;
+}
+
+/// Calls fn( begin, end ) on disjoint ranges covering [0, count) and returns when all calls have finished.
+///
+/// Ranges hold grainSize indices (the last one may be shorter) and are handed out dynamically, so uneven work
+/// balances across threads. The calling thread participates. If there is at most one range or maxThreads is 1, fn
+/// runs on the calling thread only. fn must not throw.
+///
+/// \param[in] count        Number of indices.
+/// \param[in] grainSize    Number of indices per range, 0 is treated as 1.
+/// \param[in] fn           Callable with signature void( size_t begin, size_t end ).
+/// \param[in] maxThreads   Upper bound on the number of threads, 0 for #optixUtilGetDefaultThreadCount().
+template <typename Fn>
+inline void optixUtilParallelFor( size_t count, size_t grainSize, Fn&& fn, unsigned int maxThreads = 0 )
+{
+    if( count == 0 )
+        return;
+    grainSize = std::max<size_t>( grainSize, 1 );
+
+    const size_t numRanges = ( count + grainSize - 1 ) / grainSize;
+    if( maxThreads == 0 )
+        maxThreads = optixUtilGetDefaultThreadCount();
+    const size_t numThreads = std::min<size_t>( maxThreads, numRanges );
+
+    if( numThreads <= 1 )
+    {
+        fn( size_t( 0 ), count );
+        return;
+    }
+
+    std::atomic<size_t> next( 0 );
+    auto                worker = [&]() {
+        for( size_t r = next.fetch_add( 1 ); r < numRanges; r = next.fetch_add( 1 ) )
+        {
+            const size_t begin = r * grainSize;
+            fn( begin, std::min( begin + grainSize, count ) );
+        }
+    };
+
+    std::vector<std::thread> threads;
+    threads.reserve( numThreads - 1 );
+    for( size_t t = 1; t < numThreads; ++t )
+        threads.emplace_back( worker );
+    worker();
+    for( std::thread& thread : threads )
+        thread.join();
+}
+
+/*@}*/  // end group optix_utilities
+
+#endif  // __optix_optix_util_parallel_h__
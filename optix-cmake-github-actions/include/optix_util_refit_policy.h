@@ -0,0 +1,558 @@
+/// @file
+/// @brief  OptiX host utilities: choosing between refitting and rebuilding the GAS of deforming meshes
+///
+/// OPTIX_BUILD_OPERATION_UPDATE keeps the hierarchy of the last build and only recomputes its bounds. This is cheap,
+/// but the hierarchy degrades as triangles move relative to the neighbors they were grouped with at that build.
+/// Rebuilding after a fixed number of frames either rebuilds meshes that barely deform or traces through degraded
+/// hierarchies of meshes that deform a lot.
+///
+/// #OptixUtilRefitTracker instead measures the degradation on the host, from the same vertex data that is uploaded
+/// for the build:
+///
+/// - At each build, the triangles are sorted along a Morton curve and grouped into clusters of a few triangles, which
+///   approximates the leaves of the hierarchy the builder produces.
+/// - Each frame, the clusters are refit to the current vertices. The bounds inflation is the growth of the summed
+///   cluster surface area relative to the mesh bounds, so rigid motion and uniform scaling do not count.
+/// - The triangle centroids are compared to their positions at the build, after scaling both by the mesh diagonal of
+///   their time. The spread of the displacements around their mean is the relative motion of the triangles, again
+///   independent of rigid translation and uniform scaling.
+///
+/// #optixUtilDecideRefit() compares these against an #OptixUtilRefitPolicy. The statistics of every decision can be
+/// collected in a log and written with #optixUtilWriteRefitLog() to tune the policy.
+///
+/// Only GAS that refit in a frame need OptixAccelBufferSizes::tempUpdateSizeInBytes of temp memory, see
+/// #optixUtilComputeRefitTempSizes().
+
+#ifndef __optix_optix_util_refit_policy_h__
+#define __optix_optix_util_refit_policy_h__
+
+#include "optix_util_instance_sort.h"
+#include "optix_util_instance_update.h"
+#include "optix_util_mesh_partition.h"
+#include "optix_util_mesh_prep.h"
+#include "optix_util_motion_bounds.h"
+#include "optix_util_parallel.h"
+
+#include <optix_types.h>
+
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <cstddef>
+#include <cstdint>
+#include <cstdio>
+#include <vector>
+
+/** \addtogroup optix_utilities
+@{
+*/
+
+/// Thresholds for choosing between refitting and rebuilding a GAS.
+struct OptixUtilRefitPolicy
+{
+    /// Rebuild if the bounds inflation exceeds this fraction. 0 selects 0.5.
+    float maxBoundsInflation;
+
+    /// Rebuild if the relative displacement exceeds this fraction of the mesh diagonal. 0 selects 0.1.
+    float maxRelativeDisplacement;
+
+    /// Rebuild after this many consecutive refits. 0 means no limit.
+    unsigned int maxConsecutiveRefits;
+
+    /// Triangles per cluster of the inflation estimate. 0 selects 16.
+    unsigned int clusterSize;
+};
+
+/// Reason of a decision of #optixUtilDecideRefit().
+enum OptixUtilRefitReason
+{
+    /// Refit, all measures are within the policy.
+    OPTIX_UTIL_REFIT_REASON_NONE = 0,
+    /// Build, because the tracker has no reference yet, was reset or the triangle count changed.
+    OPTIX_UTIL_REFIT_REASON_NEW_GEOMETRY,
+    /// Build, because of OptixUtilRefitPolicy::maxBoundsInflation.
+    OPTIX_UTIL_REFIT_REASON_BOUNDS_INFLATION,
+    /// Build, because of OptixUtilRefitPolicy::maxRelativeDisplacement.
+    OPTIX_UTIL_REFIT_REASON_DISPLACEMENT,
+    /// Build, because of OptixUtilRefitPolicy::maxConsecutiveRefits.
+    OPTIX_UTIL_REFIT_REASON_MAX_REFITS
+};
+
+/// Result of #optixUtilDecideRefit().
+struct OptixUtilRefitReport
+{
+    /// Build operation to pass to optixAccelBuild().
+    OptixBuildOperation  operation;
+    OptixUtilRefitReason reason;
+    /// Bounds inflation since the last build, see OptixUtilRefitPolicy::maxBoundsInflation.
+    float boundsInflation;
+    /// RMS of the displacements of the scaled triangle centroids around their mean, relative to the mesh diagonal.
+    float relativeDisplacement;
+    /// Largest triangle displacement, relative to the mesh diagonal at the last build.
+    float maxDisplacement;
+    /// Refits since the last build, including this one.
+    unsigned int consecutiveRefits;
+    /// Host time spent in #optixUtilDecideRefit().
+    double hostMilliseconds;
+};
+
+/// Per-GAS state of the refit heuristics: the triangle clusters and centroids of the last build.
+class OptixUtilRefitTracker
+{
+  public:
+    /// Makes the next decision a build, e.g., after the topology changed without changing the triangle count.
+    void reset() { m_order.clear(); }
+
+    /// Refits since the last build.
+    unsigned int consecutiveRefits() const { return m_consecutiveRefits; }
+
+    /// Host memory of the reference data in bytes, 16 bytes per triangle.
+    size_t memoryInBytes() const
+    {
+        return m_order.capacity() * sizeof( unsigned int ) + m_centroids.capacity() * sizeof( float );
+    }
+
+  private:
+    friend OptixResult optixUtilDecideRefit( OptixUtilRefitTracker&,
+                                             const OptixUtilMeshInput&,
+                                             const OptixUtilRefitPolicy&,
+                                             OptixUtilRefitReport*,
+                                             unsigned int );
+
+    /// Triangles in curve order, clusters are consecutive runs.
+    std::vector<unsigned int> m_order;
+    /// Centroid of each triangle at the last build, in curve order.
+    std::vector<float>        m_centroids;
+    unsigned int              m_clusterSize = 0;
+    /// Summed cluster surface area over the mesh surface area at the last build.
+    double                    m_buildAreaRatio = 0.0;
+    double                    m_buildDiagonal  = 0.0;
+    /// Center of the mesh bounds at the last build, and sums of the centroids and squared centroids relative to it.
+    double                    m_buildCenter[3]    = {};
+    double                    m_referenceSum[3]   = {};
+    double                    m_referenceSquares  = 0.0;
+    unsigned int              m_consecutiveRefits = 0;
+};
+
+namespace optix_util_impl {
+
+/// Clusters per parallel task of the refit statistics.
+const size_t REFIT_TASK_CLUSTERS = 4096;
+
+/// Statistics of a range of clusters.
+struct RefitStats
+{
+    double clusterArea;
+    /// Sums of u, |u|^2 and u . r over the triangles, for the current centroids u and the build-time centroids r,
+    /// both relative to the build-time center.
+    double    sum[3];
+    double    squares;
+    double    products;
+    double    maxSquaredDisplacement;
+    OptixAabb bounds;
+};
+
+inline void triangleCentroid( const OptixAabb& box, float* c )
+{
+    c[0] = 0.5f * ( box.minX + box.maxX );
+    c[1] = 0.5f * ( box.minY + box.maxY );
+    c[2] = 0.5f * ( box.minZ + box.maxZ );
+}
+
+/// Refits clusters [begin, end) to the current vertices. If reference is null, only the cluster areas and bounds are
+/// computed.
+inline void refitClusters( const OptixUtilMeshInput& mesh,
+                           const unsigned int*       order,
+                           const float*              reference,
+                           const double*             center,
+                           size_t                    numTriangles,
+                           size_t                    clusterSize,
+                           size_t                    begin,
+                           size_t                    end,
+                           RefitStats&               stats )
+{
+    stats        = RefitStats();
+    stats.bounds = emptyAabb();
+    for( size_t cluster = begin; cluster < end; ++cluster )
+    {
+        OptixAabb    clusterBounds = emptyAabb();
+        const size_t last          = std::min( ( cluster + 1 ) * clusterSize, numTriangles );
+        for( size_t k = cluster * clusterSize; k < last; ++k )
+        {
+            OptixAabb box;
+            triangleBounds( mesh, order[k], box );
+            growAabb( clusterBounds, box );
+            if( !reference )
+                continue;
+            float c[3];
+            triangleCentroid( box, c );
+            double squared = 0.0;
+            for( int axis = 0; axis < 3; ++axis )
+            {
+                const double u = (double)c[axis] - center[axis];
+                const double r = (double)reference[k * 3 + axis] - center[axis];
+                stats.sum[axis] += u;
+                stats.squares += u * u;
+                stats.products += u * r;
+                squared += ( u - r ) * ( u - r );
+            }
+            stats.maxSquaredDisplacement = std::max( stats.maxSquaredDisplacement, squared );
+        }
+        stats.clusterArea += aabbSurfaceArea( clusterBounds );
+        growAabb( stats.bounds, clusterBounds );
+    }
+}
+
+/// Refits all clusters in parallel and sums the statistics in task order, so results do not depend on the thread
+/// count.
+inline RefitStats refitAllClusters( const OptixUtilMeshInput&        mesh,
+                                    const std::vector<unsigned int>& order,
+                                    const float*                     reference,
+                                    const double*                    center,
+                                    size_t                           clusterSize,
+                                    unsigned int                     maxThreads )
+{
+    const size_t            numTriangles = order.size();
+    const size_t            numClusters  = ( numTriangles + clusterSize - 1 ) / clusterSize;
+    const size_t            numTasks     = ( numClusters + REFIT_TASK_CLUSTERS - 1 ) / REFIT_TASK_CLUSTERS;
+    std::vector<RefitStats> taskStats( numTasks );
+    optixUtilParallelFor( numTasks, 1,
+                          [&]( size_t first, size_t last ) {
+                              for( size_t t = first; t < last; ++t )
+                                  refitClusters( mesh, order.data(), reference, center, numTriangles, clusterSize,
+                                                 t * REFIT_TASK_CLUSTERS,
+                                                 std::min( ( t + 1 ) * REFIT_TASK_CLUSTERS, numClusters ),
+                                                 taskStats[t] );
+                          },
+                          maxThreads );
+
+    RefitStats total = RefitStats();
+    total.bounds     = emptyAabb();
+    for( const RefitStats& stats : taskStats )
+    {
+        total.clusterArea += stats.clusterArea;
+        for( int axis = 0; axis < 3; ++axis )
+            total.sum[axis] += stats.sum[axis];
+        total.squares += stats.squares;
+        total.products += stats.products;
+        total.maxSquaredDisplacement = std::max( total.maxSquaredDisplacement, stats.maxSquaredDisplacement );
+        growAabb( total.bounds, stats.bounds );
+    }
+    return total;
+}
+
+inline double aabbDiagonal( const OptixAabb& box )
+{
+    if( box.minX > box.maxX || box.minY > box.maxY || box.minZ > box.maxZ )
+        return 0.0;
+    const double dx = (double)box.maxX - box.minX;
+    const double dy = (double)box.maxY - box.minY;
+    const double dz = (double)box.maxZ - box.minZ;
+    return std::sqrt( dx * dx + dy * dy + dz * dz );
+}
+
+}  // namespace optix_util_impl
+
+/// Decides whether to refit or rebuild the GAS of a mesh for its current vertices.
+///
+/// A build decision makes the current vertices the new reference, so the caller must perform the build with the
+/// same vertices. Builds must set OPTIX_BUILD_FLAG_ALLOW_UPDATE for later refits.
+///
+/// \param[in,out] tracker      State of the GAS.
+/// \param[in]     mesh         Current vertices and indices of the GAS.
+/// \param[in]     policy       Refit-versus-rebuild thresholds.
+/// \param[out]    report       Optional details of the decision.
+/// \param[in]     maxThreads   Upper bound on the number of threads, 0 for #optixUtilGetDefaultThreadCount().
+inline OptixResult optixUtilDecideRefit( OptixUtilRefitTracker&      tracker,
+                                         const OptixUtilMeshInput&   mesh,
+                                         const OptixUtilRefitPolicy& policy,
+                                         OptixUtilRefitReport*       report     = nullptr,
+                                         unsigned int                maxThreads = 0 )
+{
+    using namespace optix_util_impl;
+
+    if( !mesh.vertices || ( mesh.vertexStrideInBytes && mesh.vertexStrideInBytes < 3 * sizeof( float ) ) )
+        return OPTIX_ERROR_INVALID_VALUE;
+    if( !mesh.indices && (size_t)mesh.numTriangles * 3 > mesh.numVertices )
+        return OPTIX_ERROR_INVALID_VALUE;
+    // Both passes read the vertices through the indices, so these are checked once up front.
+    for( size_t i = 0; i < mesh.numTriangles; ++i )
+        if( !validTriangle( mesh, i ) )
+            return OPTIX_ERROR_INVALID_VALUE;
+    const auto   start        = std::chrono::steady_clock::now();
+    const size_t numTriangles = mesh.numTriangles;
+    if( numTriangles < MESH_PARALLEL_THRESHOLD )
+        maxThreads = 1;
+
+    const float        maxInflation    = policy.maxBoundsInflation > 0.f ? policy.maxBoundsInflation : 0.5f;
+    const float        maxDisplacement = policy.maxRelativeDisplacement > 0.f ? policy.maxRelativeDisplacement : 0.1f;
+    const unsigned int clusterSize     = policy.clusterSize ? policy.clusterSize : 16;
+
+    OptixUtilRefitReason reason               = OPTIX_UTIL_REFIT_REASON_NONE;
+    float                boundsInflation      = 0.f;
+    float                relativeDisplacement = 0.f;
+    float                maxRelative          = 0.f;
+    if( tracker.m_order.size() != numTriangles || tracker.m_order.empty() || tracker.m_clusterSize != clusterSize )
+    {
+        reason = OPTIX_UTIL_REFIT_REASON_NEW_GEOMETRY;
+    }
+    else
+    {
+        const RefitStats stats = refitAllClusters( mesh, tracker.m_order, tracker.m_centroids.data(),
+                                                   tracker.m_buildCenter, clusterSize, maxThreads );
+        const double meshArea  = aabbSurfaceArea( stats.bounds );
+        const double areaRatio = meshArea > 0.0 ? stats.clusterArea / meshArea : 0.0;
+        if( tracker.m_buildAreaRatio > 0.0 )
+            boundsInflation = (float)std::max( 0.0, areaRatio / tracker.m_buildAreaRatio - 1.0 );
+
+        // Spread of d = u / s - r around its mean, E[|d|^2] - |E[d]|^2, with the scale s of the mesh since the build.
+        const double n    = (double)numTriangles;
+        const double diag = aabbDiagonal( stats.bounds );
+        if( tracker.m_buildDiagonal > 0.0 && diag > 0.0 )
+        {
+            const double s      = diag / tracker.m_buildDiagonal;
+            double       spread = stats.squares / ( s * s ) - 2.0 * stats.products / s + tracker.m_referenceSquares;
+            spread /= n;
+            for( int axis = 0; axis < 3; ++axis )
+            {
+                const double mean = ( stats.sum[axis] / s - tracker.m_referenceSum[axis] ) / n;
+                spread -= mean * mean;
+            }
+            relativeDisplacement = (float)( std::sqrt( std::max( spread, 0.0 ) ) / tracker.m_buildDiagonal );
+            maxRelative          = (float)( std::sqrt( stats.maxSquaredDisplacement ) / tracker.m_buildDiagonal );
+        }
+
+        if( boundsInflation > maxInflation )
+            reason = OPTIX_UTIL_REFIT_REASON_BOUNDS_INFLATION;
+        else if( relativeDisplacement > maxDisplacement )
+            reason = OPTIX_UTIL_REFIT_REASON_DISPLACEMENT;
+        else if( policy.maxConsecutiveRefits && tracker.m_consecutiveRefits >= policy.maxConsecutiveRefits )
+            reason = OPTIX_UTIL_REFIT_REASON_MAX_REFITS;
+    }
+
+    if( reason != OPTIX_UTIL_REFIT_REASON_NONE )
+    {
+        // The new build starts from the current vertices.
+        std::vector<float> centroids( numTriangles * 3 );
+        optixUtilParallelFor( numTriangles, MESH_GRAIN_SIZE,
+                              [&]( size_t first, size_t last ) {
+                                  for( size_t i = first; i < last; ++i )
+                                  {
+                                      OptixAabb box;
+                                      triangleBounds( mesh, i, box );
+                                      triangleCentroid( box, &centroids[i * 3] );
+                                  }
+                              },
+                              maxThreads );
+        tracker.m_order.resize( numTriangles );
+        const OptixResult result = optixUtilSortByCenters( centroids.data(), numTriangles,
+                                                           OPTIX_UTIL_SPATIAL_CURVE_MORTON, tracker.m_order.data(),
+                                                           nullptr, maxThreads );
+        if( result != OPTIX_SUCCESS )
+        {
+            tracker.reset();
+            return result;
+        }
+        tracker.m_centroids.resize( numTriangles * 3 );
+        optixUtilParallelFor( numTriangles, MESH_GRAIN_SIZE,
+                              [&]( size_t first, size_t last ) {
+                                  for( size_t k = first; k < last; ++k )
+                                      for( int axis = 0; axis < 3; ++axis )
+                                          tracker.m_centroids[k * 3 + axis] =
+                                              centroids[tracker.m_order[k] * 3ull + axis];
+                              },
+                              maxThreads );
+
+        const RefitStats stats = refitAllClusters( mesh, tracker.m_order, nullptr, nullptr, clusterSize, maxThreads );
+        const OptixAabb& b     = stats.bounds;
+        const double meshArea  = aabbSurfaceArea( b );
+        tracker.m_buildCenter[0]   = b.minX <= b.maxX ? 0.5 * ( (double)b.minX + b.maxX ) : 0.0;
+        tracker.m_buildCenter[1]   = b.minY <= b.maxY ? 0.5 * ( (double)b.minY + b.maxY ) : 0.0;
+        tracker.m_buildCenter[2]   = b.minZ <= b.maxZ ? 0.5 * ( (double)b.minZ + b.maxZ ) : 0.0;
+        tracker.m_referenceSquares = 0.0;
+        for( int axis = 0; axis < 3; ++axis )
+            tracker.m_referenceSum[axis] = 0.0;
+        for( size_t k = 0; k < numTriangles * 3; ++k )
+        {
+            const double r = (double)tracker.m_centroids[k] - tracker.m_buildCenter[k % 3];
+            tracker.m_referenceSum[k % 3] += r;
+            tracker.m_referenceSquares += r * r;
+        }
+        tracker.m_clusterSize       = clusterSize;
+        tracker.m_buildAreaRatio    = meshArea > 0.0 ? stats.clusterArea / meshArea : 0.0;
+        tracker.m_buildDiagonal     = aabbDiagonal( b );
+        tracker.m_consecutiveRefits = 0;
+    }
+    else
+    {
+        ++tracker.m_consecutiveRefits;
+    }
+
+    if( report )
+    {
+        const bool refit             = reason == OPTIX_UTIL_REFIT_REASON_NONE;
+        report->operation            = refit ? OPTIX_BUILD_OPERATION_UPDATE : OPTIX_BUILD_OPERATION_BUILD;
+        report->reason               = reason;
+        report->boundsInflation      = boundsInflation;
+        report->relativeDisplacement = relativeDisplacement;
+        report->maxDisplacement      = maxRelative;
+        report->consecutiveRefits    = tracker.m_consecutiveRefits;
+        report->hostMilliseconds =
+            std::chrono::duration<double, std::milli>( std::chrono::steady_clock::now() - start ).count();
+    }
+    return OPTIX_SUCCESS;
+}
+
+/// One decision of #optixUtilDecideRefits(), for tuning the policy.
+struct OptixUtilRefitLogEntry
+{
+    unsigned long long   frame;
+    unsigned int         gasIndex;
+    OptixUtilRefitReport report;
+};
+
+/// Decides between refitting and rebuilding for a batch of GAS, see #optixUtilDecideRefit().
+///
+/// Batches of many small meshes are spread over threads per mesh, large meshes are processed one after another with
+/// all threads.
+///
+/// \param[in,out] trackers     State of each GAS.
+/// \param[in]     meshes       Current vertices and indices of each GAS.
+/// \param[in]     numGas       Number of GAS.
+/// \param[in]     policy       Refit-versus-rebuild thresholds.
+/// \param[out]    reports      Decision of each GAS.
+/// \param[out]    log          Optional log, one entry per GAS is appended.
+/// \param[in]     frame        Frame number of the log entries.
+/// \param[in]     maxThreads   Upper bound on the number of threads, 0 for #optixUtilGetDefaultThreadCount().
+inline OptixResult optixUtilDecideRefits( OptixUtilRefitTracker*               trackers,
+                                          const OptixUtilMeshInput*            meshes,
+                                          unsigned int                         numGas,
+                                          const OptixUtilRefitPolicy&          policy,
+                                          OptixUtilRefitReport*                reports,
+                                          std::vector<OptixUtilRefitLogEntry>* log        = nullptr,
+                                          unsigned long long                   frame      = 0,
+                                          unsigned int                         maxThreads = 0 )
+{
+    if( numGas && ( !trackers || !meshes || !reports ) )
+        return OPTIX_ERROR_INVALID_VALUE;
+
+    size_t maxTriangles = 0;
+    for( unsigned int i = 0; i < numGas; ++i )
+        maxTriangles = std::max<size_t>( maxTriangles, meshes[i].numTriangles );
+
+    std::vector<OptixResult> results( numGas, OPTIX_SUCCESS );
+    if( maxTriangles < optix_util_impl::MESH_PARALLEL_THRESHOLD )
+    {
+        optixUtilParallelFor( numGas, 1,
+                              [&]( size_t first, size_t last ) {
+                                  for( size_t i = first; i < last; ++i )
+                                      results[i] =
+                                          optixUtilDecideRefit( trackers[i], meshes[i], policy, &reports[i], 1 );
+                              },
+                              maxThreads );
+    }
+    else
+    {
+        for( unsigned int i = 0; i < numGas; ++i )
+            results[i] = optixUtilDecideRefit( trackers[i], meshes[i], policy, &reports[i], maxThreads );
+    }
+
+    for( unsigned int i = 0; i < numGas; ++i )
+    {
+        if( results[i] != OPTIX_SUCCESS )
+            return results[i];
+        if( log )
+            log->push_back( {frame, i, reports[i]} );
+    }
+    return OPTIX_SUCCESS;
+}
+
+/// Computes the temp memory of the builds and refits of a frame.
+///
+/// GAS that refit need OptixAccelBufferSizes::tempUpdateSizeInBytes, GAS that build need
+/// OptixAccelBufferSizes::tempSizeInBytes. Sizing temp buffers per frame from the decisions avoids reserving the
+/// larger of both for every GAS.
+///
+/// \param[in]  reports     Decision of each GAS.
+/// \param[in]  sizes       Buffer sizes of each GAS from optixAccelComputeMemoryUsage().
+/// \param[in]  numGas      Number of GAS.
+/// \param[out] tempSizes   Optional temp size of each GAS for its operation.
+/// \param[out] maxTemp     Largest temp size, the size of a temp buffer shared by builds on one stream.
+/// \param[out] totalTemp   Optional sum of the temp sizes, the size of separate temp buffers per GAS.
+inline OptixResult optixUtilComputeRefitTempSizes( const OptixUtilRefitReport*  reports,
+                                                   const OptixAccelBufferSizes* sizes,
+                                                   unsigned int                 numGas,
+                                                   size_t*                      tempSizes,
+                                                   size_t&                      maxTemp,
+                                                   size_t*                      totalTemp = nullptr )
+{
+    if( numGas && ( !reports || !sizes ) )
+        return OPTIX_ERROR_INVALID_VALUE;
+
+    maxTemp      = 0;
+    size_t total = 0;
+    for( unsigned int i = 0; i < numGas; ++i )
+    {
+        const bool   refit = reports[i].operation == OPTIX_BUILD_OPERATION_UPDATE;
+        const size_t temp  = refit ? sizes[i].tempUpdateSizeInBytes : sizes[i].tempSizeInBytes;
+        if( tempSizes )
+            tempSizes[i] = temp;
+        maxTemp = std::max( maxTemp, temp );
+        total += temp;
+    }
+    if( totalTemp )
+        *totalTemp = total;
+    return OPTIX_SUCCESS;
+}
+
+/// Returns the name of a refit reason, e.g., for logs.
+inline const char* optixUtilRefitReasonString( OptixUtilRefitReason reason )
+{
+    switch( reason )
+    {
+        case OPTIX_UTIL_REFIT_REASON_NONE:
+            return "refit";
+        case OPTIX_UTIL_REFIT_REASON_NEW_GEOMETRY:
+            return "new geometry";
+        case OPTIX_UTIL_REFIT_REASON_BOUNDS_INFLATION:
+            return "bounds inflation";
+        case OPTIX_UTIL_REFIT_REASON_DISPLACEMENT:
+            return "displacement";
+        case OPTIX_UTIL_REFIT_REASON_MAX_REFITS:
+            return "max refits";
+    }
+    return "unknown";
+}
+
+/// Writes log entries as tab separated text, one line per entry, with an optional header line.
+///
+/// \param[in] file         Output file.
+/// \param[in] entries      Log entries.
+/// \param[in] numEntries   Number of log entries.
+/// \param[in] header       Writes the column names first if nonzero.
+inline OptixResult optixUtilWriteRefitLog( FILE*                         file,
+                                           const OptixUtilRefitLogEntry* entries,
+                                           size_t                        numEntries,
+                                           int                           header )
+{
+    if( !file || ( numEntries && !entries ) )
+        return OPTIX_ERROR_INVALID_VALUE;
+    const char* columns = "frame\tgas\toperation\treason\tinflation\tdisplacement\tmaxDisplacement\trefits\tms\n";
+    if( header && fputs( columns, file ) < 0 )
+        return OPTIX_ERROR_FILE_IO_ERROR;
+    for( size_t i = 0; i < numEntries; ++i )
+    {
+        const OptixUtilRefitReport& report = entries[i].report;
+        if( fprintf( file, "%llu\t%u\t%s\t%s\t%.4f\t%.4f\t%.4f\t%u\t%.3f\n", entries[i].frame, entries[i].gasIndex,
+                     report.operation == OPTIX_BUILD_OPERATION_UPDATE ? "update" : "build",
+                     optixUtilRefitReasonString( report.reason ), report.boundsInflation, report.relativeDisplacement,
+                     report.maxDisplacement, report.consecutiveRefits, report.hostMilliseconds )
+            < 0 )
+            return OPTIX_ERROR_FILE_IO_ERROR;
+    }
+    return OPTIX_SUCCESS;
+}
+
+/*@}*/  // end group optix_utilities
+
+#endif  // __optix_optix_util_refit_policy_h__
@@ -0,0 +1,419 @@
+/// @file
+/// @brief  OptiX host utilities: typed shader binding table construction into a single upload blob
+///
+/// Each SBT record is an OPTIX_SBT_RECORD_HEADER_SIZE header from optixSbtRecordPackHeader() followed by the record
+/// data, which optixGetSbtDataPointer() returns on the device. #OptixUtilSbtRecord lays this out for a data type, and
+/// its size is the record stride, a multiple of OPTIX_SBT_RECORD_ALIGNMENT known at compile time.
+///
+/// #OptixUtilSbtBuilder collects the raygen, exception, miss, hitgroup and callable records with one data type per
+/// record kind. #optixUtilWriteSbt() then writes all records into one contiguous blob and fills in an
+/// #OptixShaderBindingTable for the device address the blob is uploaded to:
+///
+/// - headers are packed once per distinct program group through an #OptixUtilSbtHeaderCache, which callers can keep
+///   across builds so rebuilds pack no headers at all,
+/// - records are assembled in parallel, so thousands of hitgroups cost a few memcpy per record,
+/// - findOrAdd variants return the index of an identical record instead of adding another one.
+///
+/// The sections are placed in the order raygen, exception, miss, hitgroup, callables, each at a multiple of
+/// OPTIX_SBT_RECORD_ALIGNMENT.
+
+#ifndef __optix_optix_util_sbt_builder_h__
+#define __optix_optix_util_sbt_builder_h__
+
+#include "optix_util_parallel.h"
+#include "optix_util_sbt_header_cache.h"
+
+#include <optix_function_table.h>
+
+#include <algorithm>
+#include <chrono>
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+#include <string>
+#include <type_traits>
+#include <unordered_map>
+#include <vector>
+
+/** \addtogroup optix_utilities
+@{
+*/
+
+/// Data type of records without data. Their records are just the header.
+struct OptixUtilSbtEmptyData
+{
+};
+
+/// SBT record with data of type T. sizeof() is the record stride.
+template <typename T>
+struct OptixUtilSbtRecord
+{
+    static_assert( std::is_trivially_copyable<T>::value, "SBT record data must be trivially copyable" );
+    static_assert( alignof( T ) <= OPTIX_SBT_RECORD_HEADER_SIZE, "SBT record data must start right after the header" );
+
+    alignas( OPTIX_SBT_RECORD_ALIGNMENT ) char header[OPTIX_SBT_RECORD_HEADER_SIZE];
+    T data;
+};
+
+template <>
+struct OptixUtilSbtRecord<OptixUtilSbtEmptyData>
+{
+    alignas( OPTIX_SBT_RECORD_ALIGNMENT ) char header[OPTIX_SBT_RECORD_HEADER_SIZE];
+};
+
+/// Result of #optixUtilWriteSbt().
+struct OptixUtilSbtBuildReport
+{
+    /// Records in the blob.
+    size_t numRecords;
+    /// Program groups that were not in the header cache, i.e., calls to optixSbtRecordPackHeader().
+    size_t numProgramGroups;
+    /// findOrAdd calls that resolved to an existing record.
+    size_t numDeduplicated;
+    size_t sizeInBytes;
+    double hostMilliseconds;
+};
+
+namespace optix_util_impl {
+
+/// Below this number of records, the SBT is written on the calling thread only.
+const size_t SBT_PARALLEL_THRESHOLD = 4096;
+const size_t SBT_GRAIN_SIZE         = 1024;
+
+/// Program groups and data of one kind of record.
+template <typename T>
+class SbtSection
+{
+  public:
+    static const size_t dataSize     = std::is_same<T, OptixUtilSbtEmptyData>::value ? 0 : sizeof( T );
+    static const size_t recordStride = sizeof( OptixUtilSbtRecord<T> );
+
+    unsigned int add( OptixProgramGroup programGroup, const T& data )
+    {
+        m_programGroups.push_back( programGroup );
+        m_data.push_back( data );
+        return (unsigned int)m_programGroups.size() - 1;
+    }
+
+    /// Returns the index of an identical record, comparing the data bytewise, or adds the record.
+    unsigned int findOrAdd( OptixProgramGroup programGroup, const T& data, size_t& numDeduplicated )
+    {
+        std::string key( reinterpret_cast<const char*>( &programGroup ), sizeof( OptixProgramGroup ) );
+        key.append( reinterpret_cast<const char*>( &data ), dataSize );
+        const auto it = m_index.find( key );
+        if( it != m_index.end() )
+        {
+            ++numDeduplicated;
+            return it->second;
+        }
+        const unsigned int index = add( programGroup, data );
+        m_index.emplace( std::move( key ), index );
+        return index;
+    }
+
+    void clear()
+    {
+        m_programGroups.clear();
+        m_data.clear();
+        m_index.clear();
+    }
+
+    void reserve( size_t count )
+    {
+        m_programGroups.reserve( count );
+        m_data.reserve( count );
+    }
+
+    size_t                   size() const { return m_programGroups.size(); }
+    const OptixProgramGroup* programGroups() const { return m_programGroups.data(); }
+    const T*                 data() const { return m_data.data(); }
+    T&                       data( unsigned int index ) { return m_data[index]; }
+
+  private:
+    std::vector<OptixProgramGroup>                m_programGroups;
+    std::vector<T>                                m_data;
+    std::unordered_map<std::string, unsigned int> m_index;
+};
+
+/// Program groups and records of a section for #packSbtHeaders().
+struct SbtSectionPrograms
+{
+    const OptixProgramGroup* programGroups;
+    size_t                   count;
+    char*                    records;
+    size_t                   recordStrideInBytes;
+};
+
+/// Writes the headers of the records of all sections. Headers come from cache, or from a cache local to the call if
+/// cache is null, so each distinct program group is packed at most once. numPacked receives the calls to
+/// optixSbtRecordPackHeader().
+inline OptixResult packSbtHeaders( const OptixFunctionTable& api,
+                                   const SbtSectionPrograms* sections,
+                                   size_t                    numSections,
+                                   OptixUtilSbtHeaderCache*  cache,
+                                   size_t&                   numPacked,
+                                   unsigned int              maxThreads )
+{
+    OptixUtilSbtHeaderCache  localCache;
+    OptixUtilSbtHeaderCache& headers = cache ? *cache : localCache;
+    const size_t             before  = headers.numPacked();
+    for( size_t s = 0; s < numSections; ++s )
+    {
+        const OptixResult result =
+            optixUtilWriteSbtHeaders( headers, api, sections[s].programGroups, sections[s].count,
+                                      sections[s].records, sections[s].recordStrideInBytes, nullptr, maxThreads );
+        if( result != OPTIX_SUCCESS )
+            return result;
+    }
+    numPacked = headers.numPacked() - before;
+    return OPTIX_SUCCESS;
+}
+
+template <typename T>
+inline void setSbtRecordData( OptixUtilSbtRecord<T>& record, const T& data )
+{
+    record.data = data;
+}
+
+inline void setSbtRecordData( OptixUtilSbtRecord<OptixUtilSbtEmptyData>&, const OptixUtilSbtEmptyData& )
+{
+}
+
+/// Writes the data of the records of a section, everything after the header, which #packSbtHeaders() writes. Records
+/// are assembled on the stack, so padding is zero and all copies have compile time sizes.
+template <typename T>
+inline void writeSbtRecords( const SbtSection<T>& section, char* out, unsigned int maxThreads )
+{
+    typedef OptixUtilSbtRecord<T> Record;
+    const size_t                  dataBytes = sizeof( Record ) - OPTIX_SBT_RECORD_HEADER_SIZE;
+    if( dataBytes == 0 )
+        return;
+    optixUtilParallelFor( section.size(), SBT_GRAIN_SIZE,
+                          [&]( size_t first, size_t last ) {
+                              for( size_t i = first; i < last; ++i )
+                              {
+                                  Record record;
+                                  std::memset( &record, 0, sizeof( Record ) );
+                                  setSbtRecordData( record, section.data()[i] );
+                                  std::memcpy( out + i * sizeof( Record ) + OPTIX_SBT_RECORD_HEADER_SIZE,
+                                               reinterpret_cast<const char*>( &record ) + OPTIX_SBT_RECORD_HEADER_SIZE,
+                                               dataBytes );
+                              }
+                          },
+                          section.size() < SBT_PARALLEL_THRESHOLD ? 1 : maxThreads );
+}
+
+}  // namespace optix_util_impl
+
+/// Collects the records of a shader binding table, with one data type per kind of record.
+///
+/// Data types must be trivially copyable. Use #OptixUtilSbtEmptyData for records without data. findOrAdd compares
+/// data bytewise, so padding bytes in the data type should be zero-initialized.
+template <typename RaygenData,
+          typename MissData,
+          typename HitgroupData,
+          typename CallablesData = OptixUtilSbtEmptyData,
+          typename ExceptionData = OptixUtilSbtEmptyData>
+class OptixUtilSbtBuilder
+{
+  public:
+    typedef OptixUtilSbtRecord<RaygenData>    RaygenRecord;
+    typedef OptixUtilSbtRecord<MissData>      MissRecord;
+    typedef OptixUtilSbtRecord<HitgroupData>  HitgroupRecord;
+    typedef OptixUtilSbtRecord<CallablesData> CallablesRecord;
+    typedef OptixUtilSbtRecord<ExceptionData> ExceptionRecord;
+
+    /// Record strides, i.e., the stride fields of #OptixShaderBindingTable.
+    static const unsigned int missRecordStrideInBytes      = sizeof( MissRecord );
+    static const unsigned int hitgroupRecordStrideInBytes  = sizeof( HitgroupRecord );
+    static const unsigned int callablesRecordStrideInBytes = sizeof( CallablesRecord );
+
+    void setRaygen( OptixProgramGroup programGroup, const RaygenData& data = RaygenData() )
+    {
+        m_raygen.clear();
+        m_raygen.add( programGroup, data );
+    }
+
+    /// Sets the optional exception record.
+    void setException( OptixProgramGroup programGroup, const ExceptionData& data = ExceptionData() )
+    {
+        m_exception.clear();
+        m_exception.add( programGroup, data );
+    }
+
+    /// Adds a miss record and returns its index, the miss index passed to optixTrace().
+    unsigned int addMiss( OptixProgramGroup programGroup, const MissData& data = MissData() )
+    {
+        return m_miss.add( programGroup, data );
+    }
+
+    /// Adds a hitgroup record and returns its index in the hitgroup records.
+    unsigned int addHitgroup( OptixProgramGroup programGroup, const HitgroupData& data = HitgroupData() )
+    {
+        return m_hitgroups.add( programGroup, data );
+    }
+
+    /// Returns the index of an identical hitgroup record that was added with findOrAddHitgroup(), or adds it.
+    unsigned int findOrAddHitgroup( OptixProgramGroup programGroup, const HitgroupData& data = HitgroupData() )
+    {
+        return m_hitgroups.findOrAdd( programGroup, data, m_numDeduplicated );
+    }
+
+    /// Adds a callable record and returns its index, the SBT index passed to optixDirectCall() or
+    /// optixContinuationCall().
+    unsigned int addCallables( OptixProgramGroup programGroup, const CallablesData& data = CallablesData() )
+    {
+        return m_callables.add( programGroup, data );
+    }
+
+    /// Returns the index of an identical callable record that was added with findOrAddCallables(), or adds it.
+    unsigned int findOrAddCallables( OptixProgramGroup programGroup, const CallablesData& data = CallablesData() )
+    {
+        return m_callables.findOrAdd( programGroup, data, m_numDeduplicated );
+    }
+
+    void reserveHitgroups( size_t count ) { m_hitgroups.reserve( count ); }
+
+    /// Data of an added record, for changes before #optixUtilWriteSbt(). Changing data of records added with a
+    /// findOrAdd function makes later findOrAdd calls miss them.
+    MissData&      missData( unsigned int index ) { return m_miss.data( index ); }
+    HitgroupData&  hitgroupData( unsigned int index ) { return m_hitgroups.data( index ); }
+    CallablesData& callablesData( unsigned int index ) { return m_callables.data( index ); }
+
+    size_t numMissRecords() const { return m_miss.size(); }
+    size_t numHitgroupRecords() const { return m_hitgroups.size(); }
+    size_t numCallablesRecords() const { return m_callables.size(); }
+    bool   hasRaygen() const { return m_raygen.size() != 0; }
+    bool   hasException() const { return m_exception.size() != 0; }
+    size_t numDeduplicated() const { return m_numDeduplicated; }
+
+    /// Byte offsets of the sections in the blob: raygen, exception, miss, hitgroup, callables, end.
+    void sectionOffsets( size_t offsets[6] ) const
+    {
+        offsets[0] = 0;
+        offsets[1] = offsets[0] + m_raygen.size() * sizeof( RaygenRecord );
+        offsets[2] = offsets[1] + m_exception.size() * sizeof( ExceptionRecord );
+        offsets[3] = offsets[2] + m_miss.size() * sizeof( MissRecord );
+        offsets[4] = offsets[3] + m_hitgroups.size() * sizeof( HitgroupRecord );
+        offsets[5] = offsets[4] + m_callables.size() * sizeof( CallablesRecord );
+    }
+
+    /// Size of the blob written by #optixUtilWriteSbt().
+    size_t sizeInBytes() const
+    {
+        size_t offsets[6];
+        sectionOffsets( offsets );
+        return offsets[5];
+    }
+
+    /// Removes all records.
+    void clear()
+    {
+        m_raygen.clear();
+        m_exception.clear();
+        m_miss.clear();
+        m_hitgroups.clear();
+        m_callables.clear();
+        m_numDeduplicated = 0;
+    }
+
+    const optix_util_impl::SbtSection<RaygenData>&    raygenSection() const { return m_raygen; }
+    const optix_util_impl::SbtSection<ExceptionData>& exceptionSection() const { return m_exception; }
+    const optix_util_impl::SbtSection<MissData>&      missSection() const { return m_miss; }
+    const optix_util_impl::SbtSection<HitgroupData>&  hitgroupSection() const { return m_hitgroups; }
+    const optix_util_impl::SbtSection<CallablesData>& callablesSection() const { return m_callables; }
+
+  private:
+    optix_util_impl::SbtSection<RaygenData>    m_raygen;
+    optix_util_impl::SbtSection<ExceptionData> m_exception;
+    optix_util_impl::SbtSection<MissData>      m_miss;
+    optix_util_impl::SbtSection<HitgroupData>  m_hitgroups;
+    optix_util_impl::SbtSection<CallablesData> m_callables;
+    size_t                                     m_numDeduplicated = 0;
+};
+
+/// Writes all records of a builder into one blob and fills in the shader binding table for its device address.
+///
+/// The blob is typically a host staging buffer that is then copied to deviceBase in one transfer.
+///
+/// \param[in]  builder      Records. Must have a raygen record.
+/// \param[in]  api          OptiX function table, see optixInit().
+/// \param[out] blob         Host memory of builder.sizeInBytes() bytes, aligned to OPTIX_SBT_RECORD_ALIGNMENT.
+/// \param[in]  deviceBase   Device address the blob is copied to, a multiple of OPTIX_SBT_RECORD_ALIGNMENT.
+/// \param[out] sbt          Shader binding table referencing deviceBase.
+/// \param[out] report       Optional statistics.
+/// \param[in]  maxThreads   Upper bound on the number of threads, 0 for #optixUtilGetDefaultThreadCount().
+/// \param[in]  headerCache  Optional header cache shared with other builds and #optixUtilPrepareSbtUpload(). Without
+///                          it, every call packs the header of each distinct program group once.
+template <typename RaygenData, typename MissData, typename HitgroupData, typename CallablesData, typename ExceptionData>
+inline OptixResult optixUtilWriteSbt(
+    const OptixUtilSbtBuilder<RaygenData, MissData, HitgroupData, CallablesData, ExceptionData>& builder,
+    const OptixFunctionTable&                                                                    api,
+    void*                                                                                        blob,
+    CUdeviceptr                                                                                  deviceBase,
+    OptixShaderBindingTable&                                                                     sbt,
+    OptixUtilSbtBuildReport*                                                                     report      = nullptr,
+    unsigned int                                                                                 maxThreads  = 0,
+    OptixUtilSbtHeaderCache*                                                                     headerCache = nullptr )
+{
+    using namespace optix_util_impl;
+    typedef OptixUtilSbtBuilder<RaygenData, MissData, HitgroupData, CallablesData, ExceptionData> Builder;
+
+    if( !builder.hasRaygen() || !blob || (size_t)blob % OPTIX_SBT_RECORD_ALIGNMENT != 0
+        || deviceBase % OPTIX_SBT_RECORD_ALIGNMENT != 0 )
+        return OPTIX_ERROR_INVALID_VALUE;
+    const auto start = std::chrono::steady_clock::now();
+
+    size_t offsets[6];
+    builder.sectionOffsets( offsets );
+    char*                    out         = static_cast<char*>( blob );
+    const SbtSectionPrograms sections[5] = {
+        {builder.raygenSection().programGroups(), builder.raygenSection().size(), out + offsets[0],
+         sizeof( typename Builder::RaygenRecord )},
+        {builder.exceptionSection().programGroups(), builder.exceptionSection().size(), out + offsets[1],
+         sizeof( typename Builder::ExceptionRecord )},
+        {builder.missSection().programGroups(), builder.missSection().size(), out + offsets[2],
+         sizeof( typename Builder::MissRecord )},
+        {builder.hitgroupSection().programGroups(), builder.hitgroupSection().size(), out + offsets[3],
+         sizeof( typename Builder::HitgroupRecord )},
+        {builder.callablesSection().programGroups(), builder.callablesSection().size(), out + offsets[4],
+         sizeof( typename Builder::CallablesRecord )}};
+    writeSbtRecords( builder.raygenSection(), sections[0].records, maxThreads );
+    writeSbtRecords( builder.exceptionSection(), sections[1].records, maxThreads );
+    writeSbtRecords( builder.missSection(), sections[2].records, maxThreads );
+    writeSbtRecords( builder.hitgroupSection(), sections[3].records, maxThreads );
+    writeSbtRecords( builder.callablesSection(), sections[4].records, maxThreads );
+    size_t            numPacked = 0;
+    const OptixResult result    = packSbtHeaders( api, sections, 5, headerCache, numPacked, maxThreads );
+    if( result != OPTIX_SUCCESS )
+        return result;
+
+    sbt                              = OptixShaderBindingTable();
+    sbt.raygenRecord                 = deviceBase + offsets[0];
+    sbt.exceptionRecord              = builder.hasException() ? deviceBase + offsets[1] : 0;
+    sbt.missRecordBase               = builder.numMissRecords() ? deviceBase + offsets[2] : 0;
+    sbt.missRecordStrideInBytes      = Builder::missRecordStrideInBytes;
+    sbt.missRecordCount              = (unsigned int)builder.numMissRecords();
+    sbt.hitgroupRecordBase           = builder.numHitgroupRecords() ? deviceBase + offsets[3] : 0;
+    sbt.hitgroupRecordStrideInBytes  = Builder::hitgroupRecordStrideInBytes;
+    sbt.hitgroupRecordCount          = (unsigned int)builder.numHitgroupRecords();
+    sbt.callablesRecordBase          = builder.numCallablesRecords() ? deviceBase + offsets[4] : 0;
+    sbt.callablesRecordStrideInBytes = builder.numCallablesRecords() ? Builder::callablesRecordStrideInBytes : 0;
+    sbt.callablesRecordCount         = (unsigned int)builder.numCallablesRecords();
+
+    if( report )
+    {
+        report->numRecords       = 1 + builder.hasException() + builder.numMissRecords() + builder.numHitgroupRecords()
+                             + builder.numCallablesRecords();
+        report->numProgramGroups = numPacked;
+        report->numDeduplicated  = builder.numDeduplicated();
+        report->sizeInBytes      = offsets[5];
+        report->hostMilliseconds =
+            std::chrono::duration<double, std::milli>( std::chrono::steady_clock::now() - start ).count();
+    }
+    return OPTIX_SUCCESS;
+}
+
+/*@}*/  // end group optix_utilities
+
+#endif  // __optix_optix_util_sbt_builder_h__
@@ -0,0 +1,294 @@
+/// @file
+/// @brief  OptiX host utilities: SBT record header cache keyed by program group
+///
+/// The OPTIX_SBT_RECORD_HEADER_SIZE header of an SBT record depends only on its program group, but
+/// optixSbtRecordPackHeader() goes through the function table into the driver for every call. Scenes with millions
+/// of hitgroup records typically use a few hundred program groups. #OptixUtilSbtHeaderCache packs each program group
+/// once and keeps the header until the program group is destroyed, across builds and frames.
+/// #optixUtilWriteSbtHeaders() copies the cached headers into record arrays of any stride with 16 byte vector stores,
+/// keeping the header of a run of records with the same program group in registers.
+///
+/// Program group handles can be reused by the driver after optixProgramGroupDestroy(), so a stale entry would silently
+/// produce the header of another program. Destroy program groups with #optixUtilDestroyProgramGroup(), or call
+/// OptixUtilSbtHeaderCache::invalidate() before destroying them.
+
+#ifndef __optix_optix_util_sbt_header_cache_h__
+#define __optix_optix_util_sbt_header_cache_h__
+
+#include "optix_util_parallel.h"
+#include "optix_util_simd.h"
+
+#include <optix_function_table.h>
+
+#include <chrono>
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+#include <utility>
+#include <vector>
+
+/** \addtogroup optix_utilities
+@{
+*/
+
+/// Result of #optixUtilWriteSbtHeaders().
+struct OptixUtilSbtHeaderWriteReport
+{
+    size_t numRecords;
+    /// Program groups that were not cached yet, i.e., calls to optixSbtRecordPackHeader().
+    size_t numPacked;
+    double hostMilliseconds;
+};
+
+/// Packed SBT record headers of program groups.
+class OptixUtilSbtHeaderCache
+{
+  public:
+    /// Returns the header of programGroup in header, packing it on the first request. The pointer stays valid until
+    /// the next call that packs a header, invalidate() or clear().
+    OptixResult get( const OptixFunctionTable& api, OptixProgramGroup programGroup, const char** header )
+    {
+        unsigned int index;
+        const OptixResult result = find( api, programGroup, index );
+        if( result == OPTIX_SUCCESS )
+            *header = m_headers[index].bytes;
+        return result;
+    }
+
+    /// Drops the header of programGroup. Must be called before the program group is destroyed.
+    void invalidate( OptixProgramGroup programGroup )
+    {
+        for( size_t i = 0; i < m_programGroups.size(); ++i )
+        {
+            if( m_programGroups[i] != programGroup )
+                continue;
+            m_programGroups[i] = m_programGroups.back();
+            m_headers[i]       = m_headers.back();
+            m_programGroups.pop_back();
+            m_headers.pop_back();
+            rehash( m_bits );
+            return;
+        }
+    }
+
+    void clear()
+    {
+        m_programGroups.clear();
+        m_headers.clear();
+        m_keys.clear();
+        m_values.clear();
+    }
+
+    /// Number of cached program groups.
+    size_t size() const { return m_programGroups.size(); }
+
+    /// Calls to optixSbtRecordPackHeader() over the lifetime of the cache.
+    size_t numPacked() const { return m_numPacked; }
+
+  private:
+    friend OptixResult optixUtilWriteSbtHeaders( OptixUtilSbtHeaderCache&,
+                                                 const OptixFunctionTable&,
+                                                 const OptixProgramGroup*,
+                                                 size_t,
+                                                 void*,
+                                                 size_t,
+                                                 OptixUtilSbtHeaderWriteReport*,
+                                                 unsigned int );
+
+    struct Header
+    {
+        alignas( OPTIX_SBT_RECORD_ALIGNMENT ) char bytes[OPTIX_SBT_RECORD_HEADER_SIZE];
+    };
+
+    // Open addressing slot of programGroup in a table of 2^m_bits slots, at most half full. Program groups are
+    // pointers, so a multiplicative hash of the address spreads them well.
+    size_t slotOf( OptixProgramGroup programGroup ) const
+    {
+        const size_t mask = ( size_t( 1 ) << m_bits ) - 1;
+        size_t slot = (size_t)( ( (uint64_t)(uintptr_t)programGroup * 0x9E3779B97F4A7C15ull ) >> ( 64 - m_bits ) );
+        while( m_values[slot] != ~0u && m_keys[slot] != programGroup )
+            slot = ( slot + 1 ) & mask;
+        return slot;
+    }
+
+    void rehash( unsigned int bits )
+    {
+        m_bits = bits;
+        m_keys.assign( size_t( 1 ) << bits, nullptr );
+        m_values.assign( size_t( 1 ) << bits, ~0u );
+        for( size_t i = 0; i < m_programGroups.size(); ++i )
+        {
+            const size_t slot = slotOf( m_programGroups[i] );
+            m_keys[slot]      = m_programGroups[i];
+            m_values[slot]    = (unsigned int)i;
+        }
+    }
+
+    // Returns the header index of programGroup, packing the header if it is not cached yet.
+    OptixResult find( const OptixFunctionTable& api, OptixProgramGroup programGroup, unsigned int& index )
+    {
+        if( m_keys.empty() )
+            rehash( m_bits );
+        size_t slot = slotOf( programGroup );
+        if( m_values[slot] != ~0u )
+        {
+            index = m_values[slot];
+            return OPTIX_SUCCESS;
+        }
+
+        Header            header;
+        const OptixResult result = api.optixSbtRecordPackHeader( programGroup, header.bytes );
+        if( result != OPTIX_SUCCESS )
+            return result;
+        ++m_numPacked;
+
+        if( 2 * ( m_programGroups.size() + 1 ) > m_keys.size() )
+        {
+            rehash( m_bits + 1 );
+            slot = slotOf( programGroup );
+        }
+        index          = (unsigned int)m_programGroups.size();
+        m_keys[slot]   = programGroup;
+        m_values[slot] = index;
+        m_programGroups.push_back( programGroup );
+        m_headers.push_back( header );
+        return OPTIX_SUCCESS;
+    }
+
+    // Copies the header of programGroups[i] to records + i * stride for i in [begin, end). Stops at the first record
+    // whose program group is not cached and returns its index, or end. Only reads the cache, so ranges can be
+    // processed concurrently.
+    size_t broadcast( const OptixProgramGroup* programGroups,
+                      size_t                   begin,
+                      size_t                   end,
+                      char*                    records,
+                      size_t                   stride ) const
+    {
+        if( m_keys.empty() )
+            return begin;
+        OptixProgramGroup current = nullptr;
+        const Header*     header  = nullptr;
+#if OPTIX_UTIL_SIMD_X86
+        // Records and headers are 16 byte aligned, so each header is two aligned 16 byte stores from registers that
+        // are only reloaded when the program group changes.
+        __m128i lo = _mm_setzero_si128();
+        __m128i hi = _mm_setzero_si128();
+#endif
+        for( size_t i = begin; i < end; ++i )
+        {
+            if( programGroups[i] != current || !header )
+            {
+                const unsigned int index = m_values[slotOf( programGroups[i] )];
+                if( index == ~0u )
+                    return i;
+                current = programGroups[i];
+                header  = &m_headers[index];
+#if OPTIX_UTIL_SIMD_X86
+                lo = _mm_load_si128( reinterpret_cast<const __m128i*>( header->bytes ) );
+                hi = _mm_load_si128( reinterpret_cast<const __m128i*>( header->bytes ) + 1 );
+#endif
+            }
+#if OPTIX_UTIL_SIMD_X86
+            __m128i* out = reinterpret_cast<__m128i*>( records + i * stride );
+            _mm_store_si128( out, lo );
+            _mm_store_si128( out + 1, hi );
+#else
+            std::memcpy( records + i * stride, header->bytes, OPTIX_SBT_RECORD_HEADER_SIZE );
+#endif
+        }
+        return end;
+    }
+
+    std::vector<OptixProgramGroup> m_programGroups;
+    std::vector<Header>            m_headers;
+    std::vector<OptixProgramGroup> m_keys;
+    std::vector<unsigned int>      m_values;
+    unsigned int                   m_bits      = 6;
+    size_t                         m_numPacked = 0;
+};
+
+namespace optix_util_impl {
+
+/// Below this number of records, headers are written on the calling thread only.
+const size_t SBT_HEADER_PARALLEL_THRESHOLD = 65536;
+const size_t SBT_HEADER_GRAIN_SIZE         = 16384;
+
+}  // namespace optix_util_impl
+
+/// Writes the header of programGroups[i] to the start of record i, for count records of recordStrideInBytes bytes.
+/// The record data after the headers is not touched.
+///
+/// Headers missing from the cache are packed once. Batches of at least 65536 records are copied by several threads.
+///
+/// \param[in,out] cache                Header cache.
+/// \param[in]     api                  OptiX function table, see optixInit().
+/// \param[in]     programGroups        Program group of each record.
+/// \param[in]     count                Number of records.
+/// \param[out]    records              Records, aligned to OPTIX_SBT_RECORD_ALIGNMENT.
+/// \param[in]     recordStrideInBytes  Stride between records, a multiple of OPTIX_SBT_RECORD_ALIGNMENT.
+/// \param[out]    report               Optional statistics.
+/// \param[in]     maxThreads           Upper bound on the number of threads, 0 for #optixUtilGetDefaultThreadCount().
+inline OptixResult optixUtilWriteSbtHeaders( OptixUtilSbtHeaderCache&       cache,
+                                             const OptixFunctionTable&      api,
+                                             const OptixProgramGroup*       programGroups,
+                                             size_t                         count,
+                                             void*                          records,
+                                             size_t                         recordStrideInBytes,
+                                             OptixUtilSbtHeaderWriteReport* report     = nullptr,
+                                             unsigned int                   maxThreads = 0 )
+{
+    using namespace optix_util_impl;
+
+    if( count && ( !programGroups || !records || (size_t)records % OPTIX_SBT_RECORD_ALIGNMENT != 0
+                   || recordStrideInBytes < OPTIX_SBT_RECORD_HEADER_SIZE
+                   || recordStrideInBytes % OPTIX_SBT_RECORD_ALIGNMENT != 0 ) )
+        return OPTIX_ERROR_INVALID_VALUE;
+    const auto   start     = std::chrono::steady_clock::now();
+    const size_t numPacked = cache.numPacked();
+    char*        out       = static_cast<char*>( records );
+
+    // Ranges are grain aligned, or the single range [0, count) on one thread, so begin / grain identifies a range.
+    // A range stops at the first record whose program group is not cached and leaves the rest to the calling thread,
+    // since packing modifies the cache.
+    std::vector<std::pair<size_t, size_t>> remaining( ( count + SBT_HEADER_GRAIN_SIZE - 1 ) / SBT_HEADER_GRAIN_SIZE );
+    optixUtilParallelFor( count, SBT_HEADER_GRAIN_SIZE,
+                          [&]( size_t begin, size_t end ) {
+                              const size_t i = cache.broadcast( programGroups, begin, end, out, recordStrideInBytes );
+                              remaining[begin / SBT_HEADER_GRAIN_SIZE] = std::make_pair( i, end );
+                          },
+                          count < SBT_HEADER_PARALLEL_THRESHOLD ? 1u : maxThreads );
+
+    for( const std::pair<size_t, size_t>& range : remaining )
+    {
+        for( size_t i = range.first; i < range.second; )
+        {
+            unsigned int      index;
+            const OptixResult result = cache.find( api, programGroups[i], index );
+            if( result != OPTIX_SUCCESS )
+                return result;
+            i = cache.broadcast( programGroups, i, range.second, out, recordStrideInBytes );
+        }
+    }
+
+    if( report )
+    {
+        report->numRecords = count;
+        report->numPacked  = cache.numPacked() - numPacked;
+        report->hostMilliseconds =
+            std::chrono::duration<double, std::milli>( std::chrono::steady_clock::now() - start ).count();
+    }
+    return OPTIX_SUCCESS;
+}
+
+/// Drops programGroup from cache and destroys it.
+inline OptixResult optixUtilDestroyProgramGroup( OptixUtilSbtHeaderCache&  cache,
+                                                 const OptixFunctionTable& api,
+                                                 OptixProgramGroup         programGroup )
+{
+    cache.invalidate( programGroup );
+    return api.optixProgramGroupDestroy( programGroup );
+}
+
+/*@}*/  // end group optix_utilities
+
+#endif  // __optix_optix_util_sbt_header_cache_h__
@@ -0,0 +1,465 @@
+/// @file
+/// @brief  OptiX host utilities: hitgroup SBT layout and per-instance sbtOffset and visibilityMask assignment
+///
+/// With an SBT stride of numRayTypes in optixTrace(), the hitgroup record of a hit is
+///
+///     instance sbtOffset + GAS SBT index * numRayTypes + ray type.
+///
+/// #OptixUtilSbtRegistry owns this arithmetic. Materials provide one hitgroup (program group and record data) per ray
+/// type. A binding assigns a material to each SBT index of a GAS and owns a contiguous block of numSlots *
+/// numRayTypes records, whose first record is the sbtOffset of all instances using the binding. Identical materials
+/// and identical bindings are registered once, so instances that look the same share records.
+///
+/// Visibility is described with up to 64 logical categories per instance (e.g. "camera", "shadow caster") and a
+/// logical category mask per ray. #optixUtilPackSbtVisibility() maps the categories onto the few bits of
+/// #OptixInstance::visibilityMask: categories tested by exactly the same rays are interchangeable and share a bit.
+///
+/// Registration is append-only, so the sbtOffset of existing bindings never changes. Instance assignments are tracked
+/// with dirty bits and #optixUtilUpdateInstanceSbt() only rewrites changed instances.
+
+#ifndef __optix_optix_util_sbt_registry_h__
+#define __optix_optix_util_sbt_registry_h__
+
+#include "optix_util_parallel.h"
+#include "optix_util_sbt_header_cache.h"
+
+#include <optix_function_table.h>
+
+#include <algorithm>
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+#include <map>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+/** \addtogroup optix_utilities
+@{
+*/
+
+/// Hitgroup of one material for one ray type.
+struct OptixUtilSbtHitgroup
+{
+    /// Program group whose header is packed into the record.
+    OptixProgramGroup programGroup;
+    /// Record data of OptixUtilSbtRegistry::recordDataSize() bytes, copied at registration. May be null for
+    /// zero-filled data.
+    const void* data;
+};
+
+/// Size statistics of an #OptixUtilSbtRegistry.
+struct OptixUtilSbtRegistryStats
+{
+    unsigned int numMaterials;
+    unsigned int numBindings;
+    /// Hitgroup records in the SBT.
+    size_t numRecords;
+    /// Distinct (program group, data) pairs among the records.
+    size_t numDistinctRecords;
+    /// Requests for materials or bindings that resolved to an existing one.
+    size_t numDeduplicated;
+    size_t numInstances;
+};
+
+/// Material, binding and instance registry for the hitgroup part of an SBT.
+class OptixUtilSbtRegistry
+{
+  public:
+    /// \param[in] numRayTypes      SBT stride passed to optixTrace().
+    /// \param[in] recordDataSize   Size of the data following the header in each hitgroup record.
+    OptixUtilSbtRegistry( unsigned int numRayTypes, size_t recordDataSize )
+        : m_numRayTypes( std::max( numRayTypes, 1u ) )
+        , m_recordDataSize( recordDataSize )
+    {
+    }
+
+    unsigned int numRayTypes() const { return m_numRayTypes; }
+    size_t       recordDataSize() const { return m_recordDataSize; }
+
+    /// Size of a hitgroup record including the header, rounded up to OPTIX_SBT_RECORD_ALIGNMENT.
+    size_t recordStrideInBytes() const
+    {
+        const size_t size = OPTIX_SBT_RECORD_HEADER_SIZE + m_recordDataSize;
+        return ( size + OPTIX_SBT_RECORD_ALIGNMENT - 1 ) / OPTIX_SBT_RECORD_ALIGNMENT * OPTIX_SBT_RECORD_ALIGNMENT;
+    }
+
+    /// Registers a material from numRayTypes() hitgroups and returns its ID. Returns the existing ID if an identical
+    /// material was registered before.
+    unsigned int addMaterial( const OptixUtilSbtHitgroup* hitgroups )
+    {
+        std::string key;
+        for( unsigned int r = 0; r < m_numRayTypes; ++r )
+            key += recordKey( hitgroups[r] );
+
+        const auto it = m_materialIds.find( key );
+        if( it != m_materialIds.end() )
+        {
+            ++m_numDeduplicated;
+            return it->second;
+        }
+
+        const unsigned int id = (unsigned int)m_materialIds.size();
+        m_materialIds.emplace( key, id );
+        for( unsigned int r = 0; r < m_numRayTypes; ++r )
+            m_materialRecords.push_back( recordContent( hitgroups[r] ) );
+        return id;
+    }
+
+    unsigned int numMaterials() const { return (unsigned int)m_materialIds.size(); }
+
+    /// Registers the material of each SBT index of a GAS and returns the binding ID. Returns the existing ID if the
+    /// same material list was registered before. Returns ~0u if a material ID is invalid.
+    unsigned int addBinding( const unsigned int* materials, unsigned int numSlots )
+    {
+        std::string key( reinterpret_cast<const char*>( materials ), numSlots * sizeof( unsigned int ) );
+        for( unsigned int s = 0; s < numSlots; ++s )
+            if( materials[s] >= numMaterials() )
+                return ~0u;
+
+        const auto it = m_bindingIds.find( key );
+        if( it != m_bindingIds.end() )
+        {
+            ++m_numDeduplicated;
+            return it->second;
+        }
+
+        const unsigned int id = (unsigned int)m_bindingOffsets.size();
+        m_bindingIds.emplace( key, id );
+        m_bindingOffsets.push_back( (unsigned int)m_records.size() );
+        for( unsigned int s = 0; s < numSlots; ++s )
+            for( unsigned int r = 0; r < m_numRayTypes; ++r )
+                m_records.push_back( materials[s] * m_numRayTypes + r );
+        return id;
+    }
+
+    unsigned int numBindings() const { return (unsigned int)m_bindingOffsets.size(); }
+
+    /// #OptixInstance::sbtOffset of instances using binding.
+    unsigned int sbtOffset( unsigned int binding ) const { return m_bindingOffsets[binding]; }
+
+    /// Number of hitgroup records, i.e., OptixShaderBindingTable::hitgroupRecordCount.
+    size_t numRecords() const { return m_records.size(); }
+
+    /// Resizes the instance arrays. New instances use binding 0, which must be registered before the next update, and
+    /// no visibility categories.
+    void resizeInstances( size_t count )
+    {
+        m_instanceBinding.resize( count, 0u );
+        m_instanceCategories.resize( count, 0ull );
+        m_dirty.resize( ( count + 63 ) / 64, 0ull );
+        m_allDirty = true;
+    }
+
+    size_t numInstances() const { return m_instanceBinding.size(); }
+
+    /// Sets the binding and logical visibility categories of instance i. Returns false and leaves the instance
+    /// unchanged if binding is not registered.
+    bool setInstance( size_t i, unsigned int binding, uint64_t categories )
+    {
+        if( binding >= numBindings() )
+            return false;
+        if( m_instanceBinding[i] == binding && m_instanceCategories[i] == categories )
+            return true;
+        m_instanceBinding[i]    = binding;
+        m_instanceCategories[i] = categories;
+        m_dirty[i / 64] |= 1ull << ( i % 64 );
+        return true;
+    }
+
+    unsigned int instanceBinding( size_t i ) const { return m_instanceBinding[i]; }
+    uint64_t     instanceCategories( size_t i ) const { return m_instanceCategories[i]; }
+
+    /// Registers the logical categories tested by a ray and returns its ID for #optixUtilPackSbtVisibility().
+    unsigned int addRayVisibility( uint64_t categories )
+    {
+        m_rayCategories.push_back( categories );
+        m_visibilityPacked = false;
+        return (unsigned int)m_rayCategories.size() - 1;
+    }
+
+    unsigned int numRayVisibilities() const { return (unsigned int)m_rayCategories.size(); }
+
+    /// Physical visibility bit of each logical category, valid after #optixUtilPackSbtVisibility(). Categories not
+    /// tested by any ray map to no bit.
+    const unsigned char* categoryBits() const { return m_categoryBit; }
+
+    OptixUtilSbtRegistryStats stats() const
+    {
+        OptixUtilSbtRegistryStats stats;
+        stats.numMaterials       = numMaterials();
+        stats.numBindings        = numBindings();
+        stats.numRecords         = m_records.size();
+        stats.numDistinctRecords = m_distinctRecords.size();
+        stats.numDeduplicated    = m_numDeduplicated;
+        stats.numInstances       = numInstances();
+        return stats;
+    }
+
+  private:
+    friend OptixResult optixUtilPackSbtVisibility( OptixUtilSbtRegistry&, unsigned int, unsigned int* );
+    friend OptixResult optixUtilUpdateInstanceSbt( OptixUtilSbtRegistry&,
+                                                   unsigned int*,
+                                                   unsigned int*,
+                                                   size_t*,
+                                                   unsigned int );
+    friend OptixResult optixUtilWriteHitgroupRecords( const OptixUtilSbtRegistry&,
+                                                      const OptixFunctionTable&,
+                                                      void*,
+                                                      size_t,
+                                                      OptixUtilSbtHeaderCache* );
+
+    static const unsigned char NO_BIT = 0xff;
+
+    std::string recordKey( const OptixUtilSbtHitgroup& hitgroup ) const
+    {
+        std::string key( reinterpret_cast<const char*>( &hitgroup.programGroup ), sizeof( OptixProgramGroup ) );
+        if( hitgroup.data )
+            key.append( reinterpret_cast<const char*>( hitgroup.data ), m_recordDataSize );
+        else
+            key.append( m_recordDataSize, '\0' );
+        return key;
+    }
+
+    // Returns the index of the distinct record content, registering it if needed.
+    unsigned int recordContent( const OptixUtilSbtHitgroup& hitgroup )
+    {
+        const std::string key = recordKey( hitgroup );
+        const auto        it  = m_distinctRecords.find( key );
+        if( it != m_distinctRecords.end() )
+            return it->second;
+
+        const unsigned int index = (unsigned int)m_contentPrograms.size();
+        m_distinctRecords.emplace( key, index );
+        m_contentPrograms.push_back( hitgroup.programGroup );
+        m_contentData.insert( m_contentData.end(), key.begin() + sizeof( OptixProgramGroup ), key.end() );
+        return index;
+    }
+
+    unsigned int m_numRayTypes;
+    size_t       m_recordDataSize;
+    size_t       m_numDeduplicated = 0;
+
+    // Distinct record contents: program group and data.
+    std::unordered_map<std::string, unsigned int> m_distinctRecords;
+    std::vector<OptixProgramGroup>                m_contentPrograms;
+    std::vector<char>                             m_contentData;
+
+    // Materials: numRayTypes content indices each.
+    std::unordered_map<std::string, unsigned int> m_materialIds;
+    std::vector<unsigned int>                     m_materialRecords;
+
+    // Bindings and the SBT: each record refers to a material record.
+    std::unordered_map<std::string, unsigned int> m_bindingIds;
+    std::vector<unsigned int>                     m_bindingOffsets;
+    std::vector<unsigned int>                     m_records;
+
+    // Instances.
+    std::vector<unsigned int> m_instanceBinding;
+    std::vector<uint64_t>     m_instanceCategories;
+    std::vector<uint64_t>     m_dirty;
+    bool                      m_allDirty = true;
+
+    // Visibility.
+    std::vector<uint64_t> m_rayCategories;
+    unsigned char         m_categoryBit[64] = {};
+    bool                  m_visibilityPacked = false;
+};
+
+/// Assigns visibility bits to the logical categories of registry.
+///
+/// Categories tested by the same set of rays share a bit. The function fails with OPTIX_ERROR_INVALID_VALUE if more
+/// than numBits bits are needed; numBits is typically OPTIX_DEVICE_PROPERTY_LIMIT_NUM_BITS_INSTANCE_VISIBILITY_MASK.
+/// Changing the assignment marks all instances dirty.
+///
+/// \param[in,out] registry     Registry with registered rays.
+/// \param[in]     numBits      Number of available visibility mask bits, at most 32.
+/// \param[out]    rayMasks     Optional visibility mask to pass to optixTrace() for each registered ray.
+inline OptixResult optixUtilPackSbtVisibility( OptixUtilSbtRegistry& registry,
+                                               unsigned int          numBits,
+                                               unsigned int*         rayMasks )
+{
+    if( numBits > 32 )
+        return OPTIX_ERROR_INVALID_VALUE;
+
+    // Signature of a category: the set of rays testing it.
+    std::map<std::vector<bool>, unsigned int> bitOfSignature;
+    unsigned char                             categoryBit[64];
+    for( unsigned int c = 0; c < 64; ++c )
+    {
+        std::vector<bool> signature( registry.m_rayCategories.size() );
+        bool              tested = false;
+        for( size_t r = 0; r < registry.m_rayCategories.size(); ++r )
+        {
+            signature[r] = ( registry.m_rayCategories[r] >> c ) & 1ull;
+            tested       = tested || signature[r];
+        }
+        if( !tested )
+        {
+            categoryBit[c] = OptixUtilSbtRegistry::NO_BIT;
+            continue;
+        }
+        const auto it = bitOfSignature.find( signature );
+        if( it != bitOfSignature.end() )
+        {
+            categoryBit[c] = (unsigned char)it->second;
+            continue;
+        }
+        const unsigned int bit = (unsigned int)bitOfSignature.size();
+        if( bit >= numBits )
+            return OPTIX_ERROR_INVALID_VALUE;
+        bitOfSignature.emplace( signature, bit );
+        categoryBit[c] = (unsigned char)bit;
+    }
+
+    if( rayMasks )
+    {
+        for( size_t r = 0; r < registry.m_rayCategories.size(); ++r )
+        {
+            rayMasks[r] = 0;
+            for( unsigned int c = 0; c < 64; ++c )
+                if( ( ( registry.m_rayCategories[r] >> c ) & 1ull ) && categoryBit[c] != OptixUtilSbtRegistry::NO_BIT )
+                    rayMasks[r] |= 1u << categoryBit[c];
+        }
+    }
+
+    if( !registry.m_visibilityPacked || std::memcmp( categoryBit, registry.m_categoryBit, sizeof( categoryBit ) ) != 0 )
+        registry.m_allDirty = true;
+    std::memcpy( registry.m_categoryBit, categoryBit, sizeof( categoryBit ) );
+    registry.m_visibilityPacked = true;
+    return OPTIX_SUCCESS;
+}
+
+/// Writes #OptixInstance::sbtOffset and #OptixInstance::visibilityMask of changed instances into structure-of-arrays
+/// instance data, e.g. #OptixUtilInstanceStaging, and clears the dirty state.
+///
+/// All instances are written after a resize or a change of the visibility bit assignment. Large updates are split
+/// across threads.
+///
+/// \param[in,out] registry         Registry with packed visibility, see #optixUtilPackSbtVisibility().
+/// \param[out]    sbtOffsets       sbtOffset of each instance.
+/// \param[out]    visibilityMasks  visibilityMask of each instance.
+/// \param[out]    numWritten       Optional number of instances written.
+/// \param[in]     maxThreads       Upper bound on worker threads, 0 for automatic.
+inline OptixResult optixUtilUpdateInstanceSbt( OptixUtilSbtRegistry& registry,
+                                               unsigned int*         sbtOffsets,
+                                               unsigned int*         visibilityMasks,
+                                               size_t*               numWritten = nullptr,
+                                               unsigned int          maxThreads = 0 )
+{
+    if( !registry.m_visibilityPacked && !registry.m_rayCategories.empty() )
+        return OPTIX_ERROR_INVALID_VALUE;
+    const size_t count = registry.numInstances();
+    if( count && ( !sbtOffsets || !visibilityMasks ) )
+        return OPTIX_ERROR_INVALID_VALUE;
+    if( count && registry.numBindings() == 0 )
+        return OPTIX_ERROR_INVALID_VALUE;
+
+    // Per-byte lookup tables turn 64 logical categories into a physical mask with 8 loads.
+    unsigned int byteMasks[8][256];
+    for( unsigned int b = 0; b < 8; ++b )
+    {
+        for( unsigned int v = 0; v < 256; ++v )
+        {
+            unsigned int mask = 0;
+            for( unsigned int k = 0; k < 8; ++k )
+            {
+                const unsigned char bit = registry.m_categoryBit[8 * b + k];
+                if( ( ( v >> k ) & 1u ) && registry.m_visibilityPacked && bit != OptixUtilSbtRegistry::NO_BIT )
+                    mask |= 1u << bit;
+            }
+            byteMasks[b][v] = mask;
+        }
+    }
+
+    const bool          all = registry.m_allDirty;
+    std::atomic<size_t> written( 0 );
+    const size_t        numWords = registry.m_dirty.size();
+    optixUtilParallelFor( numWords, 1024,
+                          [&]( size_t wordBegin, size_t wordEnd ) {
+                              size_t n = 0;
+                              for( size_t w = wordBegin; w < wordEnd; ++w )
+                              {
+                                  const uint64_t bits = all ? ~0ull : registry.m_dirty[w];
+                                  for( size_t k = 0; bits && k < 64; ++k )
+                                  {
+                                      const size_t i = w * 64 + k;
+                                      if( i >= count )
+                                          break;
+                                      if( !( ( bits >> k ) & 1ull ) )
+                                          continue;
+                                      const uint64_t categories = registry.m_instanceCategories[i];
+                                      unsigned int   mask       = 0;
+                                      for( unsigned int b = 0; b < 8; ++b )
+                                          mask |= byteMasks[b][( categories >> ( 8 * b ) ) & 0xff];
+                                      sbtOffsets[i]      = registry.m_bindingOffsets[registry.m_instanceBinding[i]];
+                                      visibilityMasks[i] = mask;
+                                      ++n;
+                                  }
+                                  registry.m_dirty[w] = 0;
+                              }
+                              written += n;
+                          },
+                          numWords < 64 ? 1u : maxThreads );
+
+    registry.m_allDirty = false;
+    if( numWritten )
+        *numWritten = written;
+    return OPTIX_SUCCESS;
+}
+
+/// Writes the hitgroup records of registry to records, e.g. a host staging copy of
+/// OptixShaderBindingTable::hitgroupRecordBase.
+///
+/// Headers are packed once per distinct program group with optixSbtRecordPackHeader(), or not at all for program
+/// groups already in headerCache.
+///
+/// \param[in]     registry            Registry.
+/// \param[in]     api                 OptiX function table, see optixInit().
+/// \param[out]    records             numRecords() records of recordStrideInBytes bytes.
+/// \param[in]     recordStrideInBytes Stride between records. 0 selects OptixUtilSbtRegistry::recordStrideInBytes().
+/// \param[in,out] headerCache         Optional header cache shared with other SBT writes.
+inline OptixResult optixUtilWriteHitgroupRecords( const OptixUtilSbtRegistry& registry,
+                                                  const OptixFunctionTable&   api,
+                                                  void*                       records,
+                                                  size_t                      recordStrideInBytes = 0,
+                                                  OptixUtilSbtHeaderCache*    headerCache         = nullptr )
+{
+    if( recordStrideInBytes == 0 )
+        recordStrideInBytes = registry.recordStrideInBytes();
+    if( recordStrideInBytes < OPTIX_SBT_RECORD_HEADER_SIZE + registry.m_recordDataSize
+        || recordStrideInBytes % OPTIX_SBT_RECORD_ALIGNMENT != 0 || ( !records && !registry.m_records.empty() ) )
+        return OPTIX_ERROR_INVALID_VALUE;
+
+    // One lookup per content entry. Packing a later header can move the cached ones, so each header is copied out
+    // right away instead of keeping the pointer.
+    OptixUtilSbtHeaderCache  localCache;
+    OptixUtilSbtHeaderCache& cache = headerCache ? *headerCache : localCache;
+    std::vector<char>        headers( registry.m_contentPrograms.size() * OPTIX_SBT_RECORD_HEADER_SIZE );
+    for( size_t content = 0; content < registry.m_contentPrograms.size(); ++content )
+    {
+        const char*       header;
+        const OptixResult result = cache.get( api, registry.m_contentPrograms[content], &header );
+        if( result != OPTIX_SUCCESS )
+            return result;
+        std::memcpy( &headers[content * OPTIX_SBT_RECORD_HEADER_SIZE], header, OPTIX_SBT_RECORD_HEADER_SIZE );
+    }
+
+    char* out = static_cast<char*>( records );
+    for( size_t i = 0; i < registry.m_records.size(); ++i )
+    {
+        const unsigned int content = registry.m_materialRecords[registry.m_records[i]];
+        char*              record  = out + i * recordStrideInBytes;
+        std::memcpy( record, &headers[content * OPTIX_SBT_RECORD_HEADER_SIZE], OPTIX_SBT_RECORD_HEADER_SIZE );
+        std::memcpy( record + OPTIX_SBT_RECORD_HEADER_SIZE,
+                     registry.m_contentData.data() + content * registry.m_recordDataSize, registry.m_recordDataSize );
+        std::memset( record + OPTIX_SBT_RECORD_HEADER_SIZE + registry.m_recordDataSize, 0,
+                     recordStrideInBytes - OPTIX_SBT_RECORD_HEADER_SIZE - registry.m_recordDataSize );
+    }
+    return OPTIX_SUCCESS;
+}
+
+/*@}*/  // end group optix_utilities
+
+#endif  // __optix_optix_util_sbt_registry_h__
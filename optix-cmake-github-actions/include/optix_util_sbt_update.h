@@ -0,0 +1,352 @@
+/// @file
+/// @brief  OptiX host utilities: incremental shader binding table updates
+///
+/// #OptixUtilSbtTable is a host shadow copy of one record array of an SBT, typically the hitgroup records behind
+/// #OptixShaderBindingTable::hitgroupRecordBase, with a dirty bit per record. Once per frame,
+/// #optixUtilPrepareSbtUpload() does three things:
+///
+/// - it writes the headers of records whose program group changed, and only of those, from an
+///   #OptixUtilSbtHeaderCache that can be shared with #optixUtilWriteSbt() and kept across frames,
+/// - it turns the dirty bits into a short list of byte ranges to copy to the device record array,
+/// - it decides whether the device array must grow, and accumulates upload statistics.
+///
+/// Record indices are stable: removed records go to a free list and are reused by later additions, and growth only
+/// appends. The device capacity grows geometrically, so a table growing by a few records per frame is reallocated a
+/// logarithmic number of times. After a reallocation all records are uploaded, at the same offsets as before.
+
+#ifndef __optix_optix_util_sbt_update_h__
+#define __optix_optix_util_sbt_update_h__
+
+#include "optix_util_instance_update.h"
+#include "optix_util_sbt_builder.h"
+
+#include <optix_function_table.h>
+
+#include <algorithm>
+#include <chrono>
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+#include <vector>
+
+/** \addtogroup optix_utilities
+@{
+*/
+
+/// Result of #optixUtilPrepareSbtUpload().
+struct OptixUtilSbtUploadReport
+{
+    /// True if the device record array must be reallocated to capacityInBytes before the copies. The ranges then
+    /// cover all records.
+    bool reallocate;
+    /// Size of the device record array.
+    size_t capacityInBytes;
+    /// Records changed since the previous call.
+    size_t numDirty;
+    /// Calls to optixSbtRecordPackHeader().
+    size_t numHeadersPacked;
+    /// Sum of the sizes of the copy ranges, i.e., the bytes uploaded this frame.
+    size_t bytesToUpload;
+    /// Host time spent in #optixUtilPrepareSbtUpload().
+    double hostMilliseconds;
+};
+
+/// Upload statistics accumulated over all calls to #optixUtilPrepareSbtUpload() on a table.
+struct OptixUtilSbtUploadStats
+{
+    size_t numFrames;
+    size_t numReallocations;
+    size_t numHeadersPacked;
+    /// Bytes in the returned copy ranges.
+    size_t bytesUploaded;
+    /// Bytes that re-uploading all records every frame would have transferred.
+    size_t bytesFullUpload;
+    double hostMilliseconds;
+};
+
+namespace optix_util_impl {
+
+/// Device capacity of an SBT table is at least this many records.
+const size_t SBT_TABLE_MIN_CAPACITY = 64;
+
+/// Copies data into the record and returns whether any byte changed.
+template <typename T>
+inline bool storeSbtRecordData( OptixUtilSbtRecord<T>& record, const T& data )
+{
+    if( std::memcmp( &record.data, &data, sizeof( T ) ) == 0 )
+        return false;
+    std::memcpy( &record.data, &data, sizeof( T ) );
+    return true;
+}
+
+inline bool storeSbtRecordData( OptixUtilSbtRecord<OptixUtilSbtEmptyData>&, const OptixUtilSbtEmptyData& )
+{
+    return false;
+}
+
+}  // namespace optix_util_impl
+
+/// Host shadow copy of an SBT record array with per-record dirty tracking.
+///
+/// T is the record data type as for #OptixUtilSbtBuilder. Data is compared bytewise, so padding bytes in T should be
+/// zero-initialized.
+template <typename T>
+class OptixUtilSbtTable
+{
+  public:
+    typedef OptixUtilSbtRecord<T> Record;
+
+    /// Record stride, i.e., OptixShaderBindingTable::hitgroupRecordStrideInBytes.
+    static const unsigned int strideInBytes = sizeof( Record );
+
+    /// Adds a record and returns its index. Reuses the index of a removed record if there is one.
+    unsigned int add( OptixProgramGroup programGroup, const T& data = T() )
+    {
+        unsigned int index;
+        if( !m_free.empty() )
+        {
+            index = m_free.back();
+            m_free.pop_back();
+        }
+        else
+        {
+            index = (unsigned int)m_records.size();
+            m_records.emplace_back();
+            m_programGroups.push_back( nullptr );
+            if( m_records.size() > m_dirty.size() * 64 )
+            {
+                m_dirty.push_back( 0ull );
+                m_headerDirty.push_back( 0ull );
+                m_removed.push_back( 0ull );
+            }
+        }
+        m_removed[index / 64] &= ~( 1ull << ( index % 64 ) );
+        std::memset( &m_records[index], 0, sizeof( Record ) );
+        optix_util_impl::setSbtRecordData( m_records[index], data );
+        m_programGroups[index] = programGroup;
+        markDirty( index );
+        m_headerDirty[index / 64] |= 1ull << ( index % 64 );
+        return index;
+    }
+
+    /// Releases a record index for reuse by add(). The record stays in the table until then, so its device copy
+    /// stays valid for instances that still reference it. Returns false and does nothing if i is out of range or
+    /// already removed, so a record index is never handed out twice.
+    bool remove( unsigned int i )
+    {
+        if( i >= m_records.size() || isRemoved( i ) )
+            return false;
+        m_removed[i / 64] |= 1ull << ( i % 64 );
+        m_free.push_back( i );
+        return true;
+    }
+
+    /// Replaces the data of record i and marks it dirty if any byte changed.
+    void setData( unsigned int i, const T& data )
+    {
+        if( optix_util_impl::storeSbtRecordData( m_records[i], data ) )
+            markDirty( i );
+    }
+
+    /// Replaces the program group of record i. Its header is repacked by the next #optixUtilPrepareSbtUpload().
+    void setProgramGroup( unsigned int i, OptixProgramGroup programGroup )
+    {
+        if( m_programGroups[i] != programGroup )
+        {
+            m_programGroups[i] = programGroup;
+            markDirty( i );
+            m_headerDirty[i / 64] |= 1ull << ( i % 64 );
+        }
+    }
+
+    void set( unsigned int i, OptixProgramGroup programGroup, const T& data )
+    {
+        setProgramGroup( i, programGroup );
+        setData( i, data );
+    }
+
+    /// Reserves host memory for count records. The device capacity is chosen by #optixUtilPrepareSbtUpload().
+    void reserve( size_t count )
+    {
+        m_records.reserve( count );
+        m_programGroups.reserve( count );
+    }
+
+    /// Number of records including removed ones, i.e., OptixShaderBindingTable::hitgroupRecordCount.
+    size_t size() const { return m_records.size(); }
+
+    /// Records in the device array, see OptixUtilSbtUploadReport::capacityInBytes.
+    size_t deviceCapacity() const { return m_deviceCapacity; }
+
+    const Record* records() const { return m_records.data(); }
+
+    const T& data( unsigned int i ) const { return m_records[i].data; }
+
+    OptixProgramGroup programGroup( unsigned int i ) const { return m_programGroups[i]; }
+
+    void markDirty( unsigned int i ) { m_dirty[i / 64] |= 1ull << ( i % 64 ); }
+
+    bool isDirty( unsigned int i ) const { return ( m_dirty[i / 64] >> ( i % 64 ) ) & 1ull; }
+
+    /// True if record i was removed and not reused by add() since.
+    bool isRemoved( unsigned int i ) const { return ( m_removed[i / 64] >> ( i % 64 ) ) & 1ull; }
+
+    /// Forces a full upload on the next #optixUtilPrepareSbtUpload(), e.g., after the device array was lost.
+    void invalidateDevice() { m_deviceCapacity = 0; }
+
+    const OptixUtilSbtUploadStats& stats() const { return m_stats; }
+
+  private:
+    template <typename U>
+    friend OptixResult optixUtilPrepareSbtUpload( OptixUtilSbtTable<U>&,
+                                                  const OptixFunctionTable&,
+                                                  unsigned int,
+                                                  std::vector<OptixUtilCopyRange>&,
+                                                  OptixUtilSbtUploadReport*,
+                                                  OptixUtilSbtHeaderCache* );
+
+    std::vector<Record>            m_records;
+    std::vector<OptixProgramGroup> m_programGroups;
+    std::vector<uint64_t>          m_dirty;
+    std::vector<uint64_t>          m_headerDirty;
+    std::vector<uint64_t>          m_removed;
+    std::vector<unsigned int>      m_free;
+    size_t                         m_deviceCapacity = 0;
+    OptixUtilSbtUploadStats        m_stats          = {};
+};
+
+template <typename T>
+const unsigned int OptixUtilSbtTable<T>::strideInBytes;
+
+/// Prepares the upload of the changes since the previous call.
+///
+/// ranges receives the byte ranges of OptixUtilSbtTable::records() to copy to the device record array at the same
+/// offsets, sorted by offset. If the report asks for a reallocation, the device array must be reallocated first and
+/// the ranges cover all records. On success all dirty bits are cleared, so the caller must perform the copies before
+/// modifying the table again. On failure the table is unchanged apart from the headers packed so far.
+///
+/// \param[in,out] table                Record table.
+/// \param[in]     api                  Function table providing optixSbtRecordPackHeader().
+/// \param[in]     mergeGapInRecords    Dirty ranges separated by at most this many clean records are merged into one
+///                                     copy, trading a few redundant bytes for fewer copy calls.
+/// \param[out]    ranges               Byte ranges to copy.
+/// \param[out]    report               Optional details, including the device capacity.
+/// \param[in,out] headerCache          Optional header cache kept across frames. Without it, every call packs the
+///                                     header of each distinct program group of the changed records once.
+template <typename T>
+inline OptixResult optixUtilPrepareSbtUpload( OptixUtilSbtTable<T>&            table,
+                                              const OptixFunctionTable&        api,
+                                              unsigned int                     mergeGapInRecords,
+                                              std::vector<OptixUtilCopyRange>& ranges,
+                                              OptixUtilSbtUploadReport*        report      = nullptr,
+                                              OptixUtilSbtHeaderCache*         headerCache = nullptr )
+{
+    using namespace optix_util_impl;
+    typedef typename OptixUtilSbtTable<T>::Record Record;
+
+    const auto   start = std::chrono::steady_clock::now();
+    const size_t count = table.size();
+    ranges.clear();
+
+    // Rewrite the headers of records whose program group changed. Material switches often move many records to the
+    // same program group, which the cache packs once.
+    OptixUtilSbtHeaderCache  localCache;
+    OptixUtilSbtHeaderCache& cache     = headerCache ? *headerCache : localCache;
+    const size_t             numPacked = cache.numPacked();
+    for( size_t w = 0; w < table.m_headerDirty.size(); ++w )
+    {
+        const uint64_t bits = table.m_headerDirty[w];
+        for( size_t bit = 0; bit < 64 && ( bits >> bit ) != 0; ++bit )
+        {
+            const size_t i = w * 64 + bit;
+            if( !( ( bits >> bit ) & 1ull ) )
+                continue;
+
+            const char*       header;
+            const OptixResult result = cache.get( api, table.m_programGroups[i], &header );
+            if( result != OPTIX_SUCCESS )
+                return result;
+            std::memcpy( table.m_records[i].header, header, OPTIX_SBT_RECORD_HEADER_SIZE );
+        }
+    }
+    const size_t numHeadersPacked = cache.numPacked() - numPacked;
+
+    // Grow the device array geometrically, so record offsets never change and reallocations stay rare.
+    const bool reallocate = count > table.m_deviceCapacity;
+    if( reallocate )
+        table.m_deviceCapacity = std::max( std::max( count, SBT_TABLE_MIN_CAPACITY ), 2 * table.m_deviceCapacity );
+
+    size_t numDirty = 0;
+    size_t runBegin = 0, runEnd = 0;
+    bool   inRun    = false;
+    for( size_t w = 0; w < table.m_dirty.size(); ++w )
+    {
+        const uint64_t bits = table.m_dirty[w];
+        for( size_t bit = 0; bit < 64 && ( bits >> bit ) != 0; ++bit )
+        {
+            const size_t i = w * 64 + bit;
+            if( !( ( bits >> bit ) & 1ull ) )
+                continue;
+            ++numDirty;
+
+            if( inRun && i <= runEnd + mergeGapInRecords )
+            {
+                runEnd = i + 1;
+                continue;
+            }
+            if( inRun )
+                ranges.push_back( {runBegin * sizeof( Record ), ( runEnd - runBegin ) * sizeof( Record )} );
+            runBegin = i;
+            runEnd   = i + 1;
+            inRun    = true;
+        }
+    }
+    if( inRun )
+        ranges.push_back( {runBegin * sizeof( Record ), ( runEnd - runBegin ) * sizeof( Record )} );
+
+    if( reallocate )
+    {
+        ranges.clear();
+        ranges.push_back( {0, count * sizeof( Record )} );
+    }
+    std::fill( table.m_dirty.begin(), table.m_dirty.end(), 0ull );
+    std::fill( table.m_headerDirty.begin(), table.m_headerDirty.end(), 0ull );
+
+    size_t bytesToUpload = 0;
+    for( const OptixUtilCopyRange& range : ranges )
+        bytesToUpload += range.sizeInBytes;
+
+    const double ms = std::chrono::duration<double, std::milli>( std::chrono::steady_clock::now() - start ).count();
+    ++table.m_stats.numFrames;
+    table.m_stats.numReallocations += reallocate;
+    table.m_stats.numHeadersPacked += numHeadersPacked;
+    table.m_stats.bytesUploaded += bytesToUpload;
+    table.m_stats.bytesFullUpload += count * sizeof( Record );
+    table.m_stats.hostMilliseconds += ms;
+
+    if( report )
+    {
+        report->reallocate       = reallocate;
+        report->capacityInBytes  = table.m_deviceCapacity * sizeof( Record );
+        report->numDirty         = numDirty;
+        report->numHeadersPacked = numHeadersPacked;
+        report->bytesToUpload    = bytesToUpload;
+        report->hostMilliseconds = ms;
+    }
+    return OPTIX_SUCCESS;
+}
+
+/// Points the hitgroup records of sbt at the device array of table.
+template <typename T>
+inline void optixUtilSetSbtHitgroupRecords( const OptixUtilSbtTable<T>& table,
+                                            CUdeviceptr                 deviceBase,
+                                            OptixShaderBindingTable&    sbt )
+{
+    sbt.hitgroupRecordBase          = table.size() ? deviceBase : 0;
+    sbt.hitgroupRecordStrideInBytes = OptixUtilSbtTable<T>::strideInBytes;
+    sbt.hitgroupRecordCount         = (unsigned int)table.size();
+}
+
+/*@}*/  // end group optix_utilities
+
+#endif  // __optix_optix_util_sbt_update_h__
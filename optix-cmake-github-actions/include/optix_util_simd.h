@@ -0,0 +1,98 @@
+/// @file
+/// @brief  OptiX host utilities: SIMD instruction set detection and dispatch helpers
+///
+/// Kernels in the optix_util headers are compiled for several instruction sets in the same translation unit by
+/// annotating them with #OPTIX_UTIL_TARGET_AVX2 or #OPTIX_UTIL_TARGET_AVX512. The instruction set to run is
+/// selected at runtime with #optixUtilSelectSimdIsa(), so no special compiler flags are needed.
+
+#ifndef __optix_optix_util_simd_h__
+#define __optix_optix_util_simd_h__
+
+#if defined( __x86_64__ ) || defined( _M_X64 )
+#define OPTIX_UTIL_SIMD_X86 1
+#include <immintrin.h>
+#if defined( _MSC_VER ) && !defined( __clang__ )
+#include <intrin.h>
+#else
+#include <cpuid.h>
+#endif
+#else
+#define OPTIX_UTIL_SIMD_X86 0
+#endif
+
+#if OPTIX_UTIL_SIMD_X86 && ( defined( __GNUC__ ) || defined( __clang__ ) )
+#define OPTIX_UTIL_TARGET_AVX2 __attribute__( ( target( "avx2,fma,f16c" ) ) )
+#define OPTIX_UTIL_TARGET_AVX512 __attribute__( ( target( "avx512f,avx512dq,avx2,fma,f16c" ) ) )
+#else
+#define OPTIX_UTIL_TARGET_AVX2
+#define OPTIX_UTIL_TARGET_AVX512
+#endif
+
+/** \addtogroup optix_utilities
+@{
+*/
+
+/// Instruction sets the optix_util kernels are specialized for, ordered by capability.
+enum OptixUtilSimdIsa
+{
+    /// Portable scalar code, always available.
+    OPTIX_UTIL_SIMD_ISA_SCALAR = 0,
+    /// 8-wide AVX2 with FMA and F16C. Every AVX2 processor also implements F16C.
+    OPTIX_UTIL_SIMD_ISA_AVX2 = 1,
+    /// 16-wide AVX-512 (F and DQ subsets).
+    OPTIX_UTIL_SIMD_ISA_AVX512 = 2,
+    /// Use the best instruction set supported by the host.
+    OPTIX_UTIL_SIMD_ISA_AUTO = 0x7fffffff
+};
+
+/// Queries the CPU (and OS register state support) for the best available instruction set.
+inline OptixUtilSimdIsa optixUtilDetectSimdIsa()
+{
+#if OPTIX_UTIL_SIMD_X86 && defined( _MSC_VER ) && !defined( __clang__ )
+    int info[4];
+    __cpuid( info, 0 );
+    if( info[0] < 7 )
+        return OPTIX_UTIL_SIMD_ISA_SCALAR;
+
+    __cpuid( info, 1 );
+    const bool osxsave = ( info[2] & ( 1 << 27 ) ) != 0;
+    const bool fma     = ( info[2] & ( 1 << 12 ) ) != 0;
+    const bool f16c    = ( info[2] & ( 1 << 29 ) ) != 0;
+    if( !osxsave )
+        return OPTIX_UTIL_SIMD_ISA_SCALAR;
+
+    const unsigned long long xcr0 = _xgetbv( 0 );
+    __cpuidex( info, 7, 0 );
+    const bool avx2    = ( info[1] & ( 1 << 5 ) ) != 0 && fma && f16c && ( xcr0 & 0x6 ) == 0x6;
+    const bool avx512  = ( info[1] & ( 1 << 16 ) ) != 0 && ( info[1] & ( 1 << 17 ) ) != 0 && ( xcr0 & 0xe6 ) == 0xe6;
+    if( avx2 && avx512 )
+        return OPTIX_UTIL_SIMD_ISA_AVX512;
+    return avx2 ? OPTIX_UTIL_SIMD_ISA_AVX2 : OPTIX_UTIL_SIMD_ISA_SCALAR;
+#elif OPTIX_UTIL_SIMD_X86
+    __builtin_cpu_init();
+    unsigned int eax = 0, ebx = 0, ecx = 0, edx = 0;
+    const bool   f16c = __get_cpuid( 1, &eax, &ebx, &ecx, &edx ) && ( ecx & bit_F16C ) != 0;
+    const bool avx2 = __builtin_cpu_supports( "avx2" ) && __builtin_cpu_supports( "fma" ) && f16c;
+    if( avx2 && __builtin_cpu_supports( "avx512f" ) && __builtin_cpu_supports( "avx512dq" ) )
+        return OPTIX_UTIL_SIMD_ISA_AVX512;
+    return avx2 ? OPTIX_UTIL_SIMD_ISA_AVX2 : OPTIX_UTIL_SIMD_ISA_SCALAR;
+#else
+    return OPTIX_UTIL_SIMD_ISA_SCALAR;
+#endif
+}
+
+/// Returns the instruction set to dispatch to for the requested one.
+///
+/// The request is clamped to what the host supports, so passing a specific instruction set is safe on any machine
+/// and can be used to force the scalar fallback for validation. Detection runs once per process.
+///
+/// \param[in] requested   Instruction set to use, or OPTIX_UTIL_SIMD_ISA_AUTO for the best available one.
+inline OptixUtilSimdIsa optixUtilSelectSimdIsa( OptixUtilSimdIsa requested = OPTIX_UTIL_SIMD_ISA_AUTO )
+{
+    static const OptixUtilSimdIsa detected = optixUtilDetectSimdIsa();
+    return requested < detected ? requested : detected;
+}
+
+/*@}*/  // end group optix_utilities
+
+#endif  // __optix_optix_util_simd_h__
@@ -0,0 +1,418 @@
+/// @file
+/// @brief  OptiX host utilities: batched SRT to 3x4 matrix conversion
+///
+/// Converts arrays of #OptixSRTData keys to 3x4 row-major matrices 8 (AVX2) or 16 (AVX-512) keys at a time. The
+/// result matches #optixUtilGetMatrixFromSrt() up to rounding differences from fused multiply-adds.
+
+#ifndef __optix_optix_util_srt_batch_h__
+#define __optix_optix_util_srt_batch_h__
+
+#include "optix_util_simd.h"
+#include "optix_util_transform.h"
+
+#include <cstddef>
+
+/** \addtogroup optix_utilities
+@{
+*/
+
+/// Structure-of-arrays view of #OptixSRTData keys. Each member points to one component of all keys.
+struct OptixUtilSRTDataSoA
+{
+    const float* sx;
+    const float* a;
+    const float* b;
+    const float* pvx;
+    const float* sy;
+    const float* c;
+    const float* pvy;
+    const float* sz;
+    const float* pvz;
+    const float* qx;
+    const float* qy;
+    const float* qz;
+    const float* qw;
+    const float* tx;
+    const float* ty;
+    const float* tz;
+};
+
+namespace optix_util_impl {
+
+inline void loadSrtSoA( const OptixUtilSRTDataSoA& soa, size_t i, OptixSRTData& srt )
+{
+    srt = {soa.sx[i],  soa.a[i],  soa.b[i],  soa.pvx[i], soa.sy[i], soa.c[i],  soa.pvy[i], soa.sz[i],
+           soa.pvz[i], soa.qx[i], soa.qy[i], soa.qz[i],  soa.qw[i], soa.tx[i], soa.ty[i],  soa.tz[i]};
+}
+
+#if OPTIX_UTIL_SIMD_X86
+
+// Same operation order as optixUtilGetMatrixFromSrt(). f holds the 16 OptixSRTData components in declaration order,
+// m receives the 12 matrix elements in row-major order.
+OPTIX_UTIL_TARGET_AVX2 inline void srtToMatrixAvx2( const __m256* f, __m256* m )
+{
+    const __m256 qx = f[9], qy = f[10], qz = f[11], qw = f[12];
+
+    const __m256 sql = _mm256_add_ps( _mm256_add_ps( _mm256_add_ps( _mm256_mul_ps( qx, qx ), _mm256_mul_ps( qy, qy ) ),
+                                                     _mm256_mul_ps( qz, qz ) ),
+                                      _mm256_mul_ps( qw, qw ) );
+    const __m256 inv_sql = _mm256_div_ps( _mm256_set1_ps( 1.f ), sql );
+    const __m256 nqx     = _mm256_mul_ps( qx, inv_sql );
+    const __m256 nqy     = _mm256_mul_ps( qy, inv_sql );
+    const __m256 nqz     = _mm256_mul_ps( qz, inv_sql );
+    const __m256 nqw     = _mm256_mul_ps( qw, inv_sql );
+
+    const __m256 sqw = _mm256_mul_ps( qw, nqw );
+    const __m256 sqx = _mm256_mul_ps( qx, nqx );
+    const __m256 sqy = _mm256_mul_ps( qy, nqy );
+    const __m256 sqz = _mm256_mul_ps( qz, nqz );
+
+    const __m256 xy = _mm256_mul_ps( qx, nqy );
+    const __m256 zw = _mm256_mul_ps( qz, nqw );
+    const __m256 xz = _mm256_mul_ps( qx, nqz );
+    const __m256 yw = _mm256_mul_ps( qy, nqw );
+    const __m256 yz = _mm256_mul_ps( qy, nqz );
+    const __m256 xw = _mm256_mul_ps( qx, nqw );
+
+    const __m256 two = _mm256_set1_ps( 2.0f );
+
+    const __m256 r00 = _mm256_add_ps( _mm256_sub_ps( _mm256_sub_ps( sqx, sqy ), sqz ), sqw );
+    const __m256 r01 = _mm256_mul_ps( two, _mm256_sub_ps( xy, zw ) );
+    const __m256 r02 = _mm256_mul_ps( two, _mm256_add_ps( xz, yw ) );
+
+    const __m256 r10 = _mm256_mul_ps( two, _mm256_add_ps( xy, zw ) );
+    const __m256 r11 = _mm256_add_ps( _mm256_sub_ps( _mm256_sub_ps( sqy, sqx ), sqz ), sqw );
+    const __m256 r12 = _mm256_mul_ps( two, _mm256_sub_ps( yz, xw ) );
+
+    const __m256 r20 = _mm256_mul_ps( two, _mm256_sub_ps( xz, yw ) );
+    const __m256 r21 = _mm256_mul_ps( two, _mm256_add_ps( yz, xw ) );
+    const __m256 r22 = _mm256_add_ps( _mm256_sub_ps( _mm256_sub_ps( sqz, sqx ), sqy ), sqw );
+
+    const __m256 sx = f[0], a = f[1], b = f[2], pvx = f[3], sy = f[4], c = f[5], pvy = f[6], sz = f[7], pvz = f[8];
+
+    m[3] = _mm256_add_ps(
+        _mm256_add_ps( _mm256_add_ps( _mm256_mul_ps( r00, pvx ), _mm256_mul_ps( r01, pvy ) ), _mm256_mul_ps( r02, pvz ) ), f[13] );
+    m[7] = _mm256_add_ps(
+        _mm256_add_ps( _mm256_add_ps( _mm256_mul_ps( r10, pvx ), _mm256_mul_ps( r11, pvy ) ), _mm256_mul_ps( r12, pvz ) ), f[14] );
+    m[11] = _mm256_add_ps(
+        _mm256_add_ps( _mm256_add_ps( _mm256_mul_ps( r20, pvx ), _mm256_mul_ps( r21, pvy ) ), _mm256_mul_ps( r22, pvz ) ), f[15] );
+
+    m[2]  = _mm256_add_ps( _mm256_add_ps( _mm256_mul_ps( r00, b ), _mm256_mul_ps( r01, c ) ), _mm256_mul_ps( r02, sz ) );
+    m[6]  = _mm256_add_ps( _mm256_add_ps( _mm256_mul_ps( r10, b ), _mm256_mul_ps( r11, c ) ), _mm256_mul_ps( r12, sz ) );
+    m[10] = _mm256_add_ps( _mm256_add_ps( _mm256_mul_ps( r20, b ), _mm256_mul_ps( r21, c ) ), _mm256_mul_ps( r22, sz ) );
+
+    m[1] = _mm256_add_ps( _mm256_mul_ps( r00, a ), _mm256_mul_ps( r01, sy ) );
+    m[5] = _mm256_add_ps( _mm256_mul_ps( r10, a ), _mm256_mul_ps( r11, sy ) );
+    m[9] = _mm256_add_ps( _mm256_mul_ps( r20, a ), _mm256_mul_ps( r21, sy ) );
+
+    m[0] = _mm256_mul_ps( r00, sx );
+    m[4] = _mm256_mul_ps( r10, sx );
+    m[8] = _mm256_mul_ps( r20, sx );
+}
+
+// In-place transpose of the 8x8 matrix held in r[0..7].
+OPTIX_UTIL_TARGET_AVX2 inline void transpose8x8Avx2( __m256* r )
+{
+    const __m256 t0 = _mm256_unpacklo_ps( r[0], r[1] );
+    const __m256 t1 = _mm256_unpackhi_ps( r[0], r[1] );
+    const __m256 t2 = _mm256_unpacklo_ps( r[2], r[3] );
+    const __m256 t3 = _mm256_unpackhi_ps( r[2], r[3] );
+    const __m256 t4 = _mm256_unpacklo_ps( r[4], r[5] );
+    const __m256 t5 = _mm256_unpackhi_ps( r[4], r[5] );
+    const __m256 t6 = _mm256_unpacklo_ps( r[6], r[7] );
+    const __m256 t7 = _mm256_unpackhi_ps( r[6], r[7] );
+
+    const __m256 s0 = _mm256_shuffle_ps( t0, t2, _MM_SHUFFLE( 1, 0, 1, 0 ) );
+    const __m256 s1 = _mm256_shuffle_ps( t0, t2, _MM_SHUFFLE( 3, 2, 3, 2 ) );
+    const __m256 s2 = _mm256_shuffle_ps( t1, t3, _MM_SHUFFLE( 1, 0, 1, 0 ) );
+    const __m256 s3 = _mm256_shuffle_ps( t1, t3, _MM_SHUFFLE( 3, 2, 3, 2 ) );
+    const __m256 s4 = _mm256_shuffle_ps( t4, t6, _MM_SHUFFLE( 1, 0, 1, 0 ) );
+    const __m256 s5 = _mm256_shuffle_ps( t4, t6, _MM_SHUFFLE( 3, 2, 3, 2 ) );
+    const __m256 s6 = _mm256_shuffle_ps( t5, t7, _MM_SHUFFLE( 1, 0, 1, 0 ) );
+    const __m256 s7 = _mm256_shuffle_ps( t5, t7, _MM_SHUFFLE( 3, 2, 3, 2 ) );
+
+    r[0] = _mm256_permute2f128_ps( s0, s4, 0x20 );
+    r[1] = _mm256_permute2f128_ps( s1, s5, 0x20 );
+    r[2] = _mm256_permute2f128_ps( s2, s6, 0x20 );
+    r[3] = _mm256_permute2f128_ps( s3, s7, 0x20 );
+    r[4] = _mm256_permute2f128_ps( s0, s4, 0x31 );
+    r[5] = _mm256_permute2f128_ps( s1, s5, 0x31 );
+    r[6] = _mm256_permute2f128_ps( s2, s6, 0x31 );
+    r[7] = _mm256_permute2f128_ps( s3, s7, 0x31 );
+}
+
+// Writes 8 matrices held as 12 component vectors to rows of matrixStride floats.
+OPTIX_UTIL_TARGET_AVX2 inline void storeMatrices8Avx2( __m256* m, float* out, size_t matrixStride )
+{
+    transpose8x8Avx2( m );
+    __m256 hi[8] = {m[8], m[9], m[10], m[11], _mm256_setzero_ps(), _mm256_setzero_ps(), _mm256_setzero_ps(),
+                    _mm256_setzero_ps()};
+    transpose8x8Avx2( hi );
+    for( int l = 0; l < 8; ++l )
+    {
+        _mm256_storeu_ps( out + l * matrixStride, m[l] );
+        _mm_storeu_ps( out + l * matrixStride + 8, _mm256_castps256_ps128( hi[l] ) );
+    }
+}
+
+OPTIX_UTIL_TARGET_AVX2 inline size_t srtToMatrixAoSAvx2( const OptixSRTData* srt, size_t count, float* out, size_t matrixStride )
+{
+    size_t i = 0;
+    for( ; i + 8 <= count; i += 8 )
+    {
+        // Two 8x8 transposes turn 8 consecutive keys into 16 component vectors.
+        __m256 f[16];
+        for( int l = 0; l < 8; ++l )
+        {
+            f[l]     = _mm256_loadu_ps( &srt[i + l].sx );
+            f[l + 8] = _mm256_loadu_ps( &srt[i + l].pvz );
+        }
+        transpose8x8Avx2( f );
+        transpose8x8Avx2( f + 8 );
+
+        __m256 m[12];
+        srtToMatrixAvx2( f, m );
+        storeMatrices8Avx2( m, out + i * matrixStride, matrixStride );
+    }
+    return i;
+}
+
+OPTIX_UTIL_TARGET_AVX2 inline size_t srtToMatrixSoAAvx2( const OptixUtilSRTDataSoA& soa, size_t count, float* out, size_t matrixStride )
+{
+    const float* const fields[16] = {soa.sx,  soa.a,  soa.b,  soa.pvx, soa.sy, soa.c,  soa.pvy, soa.sz,
+                                     soa.pvz, soa.qx, soa.qy, soa.qz,  soa.qw, soa.tx, soa.ty,  soa.tz};
+    size_t i = 0;
+    for( ; i + 8 <= count; i += 8 )
+    {
+        __m256 f[16];
+        for( int k = 0; k < 16; ++k )
+            f[k] = _mm256_loadu_ps( fields[k] + i );
+
+        __m256 m[12];
+        srtToMatrixAvx2( f, m );
+        storeMatrices8Avx2( m, out + i * matrixStride, matrixStride );
+    }
+    return i;
+}
+
+// AVX-512 variant of srtToMatrixAvx2(), same operation order.
+OPTIX_UTIL_TARGET_AVX512 inline void srtToMatrixAvx512( const __m512* f, __m512* m )
+{
+    const __m512 qx = f[9], qy = f[10], qz = f[11], qw = f[12];
+
+    const __m512 sql = _mm512_add_ps( _mm512_add_ps( _mm512_add_ps( _mm512_mul_ps( qx, qx ), _mm512_mul_ps( qy, qy ) ),
+                                                     _mm512_mul_ps( qz, qz ) ),
+                                      _mm512_mul_ps( qw, qw ) );
+    const __m512 inv_sql = _mm512_div_ps( _mm512_set1_ps( 1.f ), sql );
+    const __m512 nqx     = _mm512_mul_ps( qx, inv_sql );
+    const __m512 nqy     = _mm512_mul_ps( qy, inv_sql );
+    const __m512 nqz     = _mm512_mul_ps( qz, inv_sql );
+    const __m512 nqw     = _mm512_mul_ps( qw, inv_sql );
+
+    const __m512 sqw = _mm512_mul_ps( qw, nqw );
+    const __m512 sqx = _mm512_mul_ps( qx, nqx );
+    const __m512 sqy = _mm512_mul_ps( qy, nqy );
+    const __m512 sqz = _mm512_mul_ps( qz, nqz );
+
+    const __m512 xy = _mm512_mul_ps( qx, nqy );
+    const __m512 zw = _mm512_mul_ps( qz, nqw );
+    const __m512 xz = _mm512_mul_ps( qx, nqz );
+    const __m512 yw = _mm512_mul_ps( qy, nqw );
+    const __m512 yz = _mm512_mul_ps( qy, nqz );
+    const __m512 xw = _mm512_mul_ps( qx, nqw );
+
+    const __m512 two = _mm512_set1_ps( 2.0f );
+
+    const __m512 r00 = _mm512_add_ps( _mm512_sub_ps( _mm512_sub_ps( sqx, sqy ), sqz ), sqw );
+    const __m512 r01 = _mm512_mul_ps( two, _mm512_sub_ps( xy, zw ) );
+    const __m512 r02 = _mm512_mul_ps( two, _mm512_add_ps( xz, yw ) );
+
+    const __m512 r10 = _mm512_mul_ps( two, _mm512_add_ps( xy, zw ) );
+    const __m512 r11 = _mm512_add_ps( _mm512_sub_ps( _mm512_sub_ps( sqy, sqx ), sqz ), sqw );
+    const __m512 r12 = _mm512_mul_ps( two, _mm512_sub_ps( yz, xw ) );
+
+    const __m512 r20 = _mm512_mul_ps( two, _mm512_sub_ps( xz, yw ) );
+    const __m512 r21 = _mm512_mul_ps( two, _mm512_add_ps( yz, xw ) );
+    const __m512 r22 = _mm512_add_ps( _mm512_sub_ps( _mm512_sub_ps( sqz, sqx ), sqy ), sqw );
+
+    const __m512 sx = f[0], a = f[1], b = f[2], pvx = f[3], sy = f[4], c = f[5], pvy = f[6], sz = f[7], pvz = f[8];
+
+    m[3] = _mm512_add_ps(
+        _mm512_add_ps( _mm512_add_ps( _mm512_mul_ps( r00, pvx ), _mm512_mul_ps( r01, pvy ) ), _mm512_mul_ps( r02, pvz ) ), f[13] );
+    m[7] = _mm512_add_ps(
+        _mm512_add_ps( _mm512_add_ps( _mm512_mul_ps( r10, pvx ), _mm512_mul_ps( r11, pvy ) ), _mm512_mul_ps( r12, pvz ) ), f[14] );
+    m[11] = _mm512_add_ps(
+        _mm512_add_ps( _mm512_add_ps( _mm512_mul_ps( r20, pvx ), _mm512_mul_ps( r21, pvy ) ), _mm512_mul_ps( r22, pvz ) ), f[15] );
+
+    m[2]  = _mm512_add_ps( _mm512_add_ps( _mm512_mul_ps( r00, b ), _mm512_mul_ps( r01, c ) ), _mm512_mul_ps( r02, sz ) );
+    m[6]  = _mm512_add_ps( _mm512_add_ps( _mm512_mul_ps( r10, b ), _mm512_mul_ps( r11, c ) ), _mm512_mul_ps( r12, sz ) );
+    m[10] = _mm512_add_ps( _mm512_add_ps( _mm512_mul_ps( r20, b ), _mm512_mul_ps( r21, c ) ), _mm512_mul_ps( r22, sz ) );
+
+    m[1] = _mm512_add_ps( _mm512_mul_ps( r00, a ), _mm512_mul_ps( r01, sy ) );
+    m[5] = _mm512_add_ps( _mm512_mul_ps( r10, a ), _mm512_mul_ps( r11, sy ) );
+    m[9] = _mm512_add_ps( _mm512_mul_ps( r20, a ), _mm512_mul_ps( r21, sy ) );
+
+    m[0] = _mm512_mul_ps( r00, sx );
+    m[4] = _mm512_mul_ps( r10, sx );
+    m[8] = _mm512_mul_ps( r20, sx );
+}
+
+// Scatters 16 matrices held as 12 component vectors to rows of matrixStride floats.
+OPTIX_UTIL_TARGET_AVX512 inline void storeMatrices16Avx512( const __m512* m, float* out, size_t matrixStride )
+{
+    const __m512i rows = _mm512_mullo_epi32( _mm512_setr_epi32( 0, 1, 2, 3, 4, 5, 6, 7, 8, 9, 10, 11, 12, 13, 14, 15 ),
+                                             _mm512_set1_epi32( (int)matrixStride ) );
+    for( int k = 0; k < 12; ++k )
+        _mm512_i32scatter_ps( out + k, rows, m[k], 4 );
+}
+
+OPTIX_UTIL_TARGET_AVX512 inline size_t srtToMatrixAoSAvx512( const OptixSRTData* srt, size_t count, float* out, size_t matrixStride )
+{
+    const __m512i keys = _mm512_mullo_epi32( _mm512_setr_epi32( 0, 1, 2, 3, 4, 5, 6, 7, 8, 9, 10, 11, 12, 13, 14, 15 ),
+                                             _mm512_set1_epi32( 16 ) );
+    size_t i = 0;
+    for( ; i + 16 <= count; i += 16 )
+    {
+        const float* base = &srt[i].sx;
+        __m512       f[16];
+        for( int k = 0; k < 16; ++k )
+            f[k] = _mm512_mask_i32gather_ps( _mm512_setzero_ps(), 0xffff, keys, base + k, 4 );
+
+        __m512 m[12];
+        srtToMatrixAvx512( f, m );
+        storeMatrices16Avx512( m, out + i * matrixStride, matrixStride );
+    }
+    return i;
+}
+
+OPTIX_UTIL_TARGET_AVX512 inline size_t srtToMatrixSoAAvx512( const OptixUtilSRTDataSoA& soa, size_t count, float* out, size_t matrixStride )
+{
+    const float* const fields[16] = {soa.sx,  soa.a,  soa.b,  soa.pvx, soa.sy, soa.c,  soa.pvy, soa.sz,
+                                     soa.pvz, soa.qx, soa.qy, soa.qz,  soa.qw, soa.tx, soa.ty,  soa.tz};
+    size_t i = 0;
+    for( ; i + 16 <= count; i += 16 )
+    {
+        __m512 f[16];
+        for( int k = 0; k < 16; ++k )
+            f[k] = _mm512_loadu_ps( fields[k] + i );
+
+        __m512 m[12];
+        srtToMatrixAvx512( f, m );
+        storeMatrices16Avx512( m, out + i * matrixStride, matrixStride );
+    }
+    return i;
+}
+
+#endif  // OPTIX_UTIL_SIMD_X86
+
+inline bool resolveMatrixStride( size_t matrixStrideInBytes, size_t& matrixStride )
+{
+    if( matrixStrideInBytes == 0 )
+        matrixStrideInBytes = 12 * sizeof( float );
+    if( matrixStrideInBytes % sizeof( float ) != 0 || matrixStrideInBytes < 12 * sizeof( float ) )
+        return false;
+    matrixStride = matrixStrideInBytes / sizeof( float );
+    return true;
+}
+
+}  // namespace optix_util_impl
+
+/// Converts count SRT keys stored as an array of #OptixSRTData into 3x4 row-major matrices.
+///
+/// \param[in]  srt                   Array of count SRT keys.
+/// \param[in]  count                 Number of keys to convert.
+/// \param[out] matrices              Destination of the first matrix. Matrix i starts at
+///                                   matrices + i * matrixStrideInBytes / sizeof( float ).
+/// \param[in]  matrixStrideInBytes   Distance between consecutive matrices. Zero means tightly packed (48 bytes). Pass
+///                                   sizeof( OptixInstance ) to write into #OptixInstance::transform directly.
+/// \param[in]  isa                   Instruction set to use, see #optixUtilSelectSimdIsa().
+inline OptixResult optixUtilConvertSrtToMatrixBatch( const OptixSRTData* srt,
+                                                     size_t              count,
+                                                     float*              matrices,
+                                                     size_t              matrixStrideInBytes = 0,
+                                                     OptixUtilSimdIsa    isa                 = OPTIX_UTIL_SIMD_ISA_AUTO )
+{
+    size_t matrixStride;
+    if( !optix_util_impl::resolveMatrixStride( matrixStrideInBytes, matrixStride ) )
+        return OPTIX_ERROR_INVALID_VALUE;
+    if( count == 0 )
+        return OPTIX_SUCCESS;
+    if( !srt || !matrices )
+        return OPTIX_ERROR_INVALID_VALUE;
+
+    size_t done = 0;
+#if OPTIX_UTIL_SIMD_X86
+    switch( optixUtilSelectSimdIsa( isa ) )
+    {
+        case OPTIX_UTIL_SIMD_ISA_AVX512:
+            done = optix_util_impl::srtToMatrixAoSAvx512( srt, count, matrices, matrixStride );
+            break;
+        case OPTIX_UTIL_SIMD_ISA_AVX2:
+            done = optix_util_impl::srtToMatrixAoSAvx2( srt, count, matrices, matrixStride );
+            break;
+        default:
+            break;
+    }
+#else
+    (void)isa;
+#endif
+
+    for( size_t i = done; i < count; ++i )
+        optixUtilGetMatrixFromSrt( matrices + i * matrixStride, srt[i] );
+
+    return OPTIX_SUCCESS;
+}
+
+/// Converts count SRT keys stored as structure of arrays into 3x4 row-major matrices.
+///
+/// See #optixUtilConvertSrtToMatrixBatch( const OptixSRTData*, size_t, float*, size_t, OptixUtilSimdIsa ) for the
+/// remaining parameters. All component arrays of srt must hold at least count elements.
+inline OptixResult optixUtilConvertSrtToMatrixBatch( const OptixUtilSRTDataSoA& srt,
+                                                     size_t                     count,
+                                                     float*                     matrices,
+                                                     size_t                     matrixStrideInBytes = 0,
+                                                     OptixUtilSimdIsa           isa = OPTIX_UTIL_SIMD_ISA_AUTO )
+{
+    size_t matrixStride;
+    if( !optix_util_impl::resolveMatrixStride( matrixStrideInBytes, matrixStride ) )
+        return OPTIX_ERROR_INVALID_VALUE;
+    if( count == 0 )
+        return OPTIX_SUCCESS;
+    if( !matrices )
+        return OPTIX_ERROR_INVALID_VALUE;
+    const float* const fields[16] = {srt.sx,  srt.a,  srt.b,  srt.pvx, srt.sy, srt.c,  srt.pvy, srt.sz,
+                                     srt.pvz, srt.qx, srt.qy, srt.qz,  srt.qw, srt.tx, srt.ty,  srt.tz};
+    for( const float* field : fields )
+        if( !field )
+            return OPTIX_ERROR_INVALID_VALUE;
+
+    size_t done = 0;
+#if OPTIX_UTIL_SIMD_X86
+    switch( optixUtilSelectSimdIsa( isa ) )
+    {
+        case OPTIX_UTIL_SIMD_ISA_AVX512:
+            done = optix_util_impl::srtToMatrixSoAAvx512( srt, count, matrices, matrixStride );
+            break;
+        case OPTIX_UTIL_SIMD_ISA_AVX2:
+            done = optix_util_impl::srtToMatrixSoAAvx2( srt, count, matrices, matrixStride );
+            break;
+        default:
+            break;
+    }
+#else
+    (void)isa;
+#endif
+
+    for( size_t i = done; i < count; ++i )
+    {
+        OptixSRTData key;
+        optix_util_impl::loadSrtSoA( srt, i, key );
+        optixUtilGetMatrixFromSrt( matrices + i * matrixStride, key );
+    }
+
+    return OPTIX_SUCCESS;
+}
+
+/*@}*/  // end group optix_utilities
+
+#endif  // __optix_optix_util_srt_batch_h__
@@ -0,0 +1,180 @@
+/// @file
+/// @brief  OptiX host utilities: scalar 3x4 transformation math
+///
+/// Host counterparts of the transformation helpers in internal/optix_7_device_impl_transformations.h. Matrices are
+/// 3x4 row-major float[12] arrays, the layout of #OptixInstance::transform and #OptixStaticTransform::transform.
+/// The functions follow the device formulas operation by operation so host-computed data matches what traversal
+/// evaluates.
+
+#ifndef __optix_optix_util_transform_h__
+#define __optix_optix_util_transform_h__
+
+#include <optix_types.h>
+
+#include <algorithm>
+#include <cmath>
+
+/** \addtogroup optix_utilities
+@{
+*/
+
+/// Converts the SRT transformation srt into a 3x4 row-major matrix. Mirrors optixGetMatrixFromSrt().
+inline void optixUtilGetMatrixFromSrt( float* m, const OptixSRTData& srt )
+{
+    // normalize
+    const float inv_sql = 1.f / ( srt.qx * srt.qx + srt.qy * srt.qy + srt.qz * srt.qz + srt.qw * srt.qw );
+    const float nqx     = srt.qx * inv_sql;
+    const float nqy     = srt.qy * inv_sql;
+    const float nqz     = srt.qz * inv_sql;
+    const float nqw     = srt.qw * inv_sql;
+
+    const float sqw = srt.qw * nqw;
+    const float sqx = srt.qx * nqx;
+    const float sqy = srt.qy * nqy;
+    const float sqz = srt.qz * nqz;
+
+    const float xy = srt.qx * nqy;
+    const float zw = srt.qz * nqw;
+    const float xz = srt.qx * nqz;
+    const float yw = srt.qy * nqw;
+    const float yz = srt.qy * nqz;
+    const float xw = srt.qx * nqw;
+
+    const float r00 = ( sqx - sqy - sqz + sqw );
+    const float r01 = 2.0f * ( xy - zw );
+    const float r02 = 2.0f * ( xz + yw );
+
+    const float r10 = 2.0f * ( xy + zw );
+    const float r11 = ( -sqx + sqy - sqz + sqw );
+    const float r12 = 2.0f * ( yz - xw );
+
+    const float r20 = 2.0f * ( xz - yw );
+    const float r21 = 2.0f * ( yz + xw );
+    const float r22 = ( -sqx - sqy + sqz + sqw );
+
+    m[3]  = r00 * srt.pvx + r01 * srt.pvy + r02 * srt.pvz + srt.tx;
+    m[7]  = r10 * srt.pvx + r11 * srt.pvy + r12 * srt.pvz + srt.ty;
+    m[11] = r20 * srt.pvx + r21 * srt.pvy + r22 * srt.pvz + srt.tz;
+
+    m[2]  = r00 * srt.b + r01 * srt.c + r02 * srt.sz;
+    m[6]  = r10 * srt.b + r11 * srt.c + r12 * srt.sz;
+    m[10] = r20 * srt.b + r21 * srt.c + r22 * srt.sz;
+
+    m[1] = r00 * srt.a + r01 * srt.sy;
+    m[5] = r10 * srt.a + r11 * srt.sy;
+    m[9] = r20 * srt.a + r21 * srt.sy;
+
+    m[0] = r00 * srt.sx;
+    m[4] = r10 * srt.sx;
+    m[8] = r20 * srt.sx;
+}
+
+/// Inverts a 3x4 row-major matrix in place. Mirrors optixInvertMatrix(), including its behavior for singular input.
+inline void optixUtilInvertMatrix( float* m )
+{
+    const float det3 = m[0] * ( m[5] * m[10] - m[6] * m[9] ) - m[1] * ( m[4] * m[10] - m[6] * m[8] )
+                       + m[2] * ( m[4] * m[9] - m[5] * m[8] );
+
+    const float inv_det3 = 1.0f / det3;
+
+    float inv3[3][3];
+    inv3[0][0] = inv_det3 * ( m[5] * m[10] - m[9] * m[6] );
+    inv3[0][1] = inv_det3 * ( m[2] * m[9] - m[10] * m[1] );
+    inv3[0][2] = inv_det3 * ( m[1] * m[6] - m[5] * m[2] );
+
+    inv3[1][0] = inv_det3 * ( m[6] * m[8] - m[10] * m[4] );
+    inv3[1][1] = inv_det3 * ( m[0] * m[10] - m[8] * m[2] );
+    inv3[1][2] = inv_det3 * ( m[2] * m[4] - m[6] * m[0] );
+
+    inv3[2][0] = inv_det3 * ( m[4] * m[9] - m[8] * m[5] );
+    inv3[2][1] = inv_det3 * ( m[1] * m[8] - m[9] * m[0] );
+    inv3[2][2] = inv_det3 * ( m[0] * m[5] - m[4] * m[1] );
+
+    const float b[3] = {m[3], m[7], m[11]};
+
+    for( int r = 0; r < 3; ++r )
+    {
+        m[4 * r + 0] = inv3[r][0];
+        m[4 * r + 1] = inv3[r][1];
+        m[4 * r + 2] = inv3[r][2];
+        m[4 * r + 3] = -inv3[r][0] * b[0] - inv3[r][1] * b[1] - inv3[r][2] * b[2];
+    }
+}
+
+/// Sets m to the 3x4 identity matrix.
+inline void optixUtilSetIdentityMatrix( float* m )
+{
+    for( int k = 0; k < 12; ++k )
+        m[k] = ( k % 5 == 0 ) ? 1.0f : 0.0f;
+}
+
+/// Computes the 3x4 matrix product result = a * b, i.e., the transformation that applies b first. result may alias
+/// a or b.
+inline void optixUtilMultiplyMatrix( float* result, const float* a, const float* b )
+{
+    float r[12];
+    for( int i = 0; i < 3; ++i )
+    {
+        for( int j = 0; j < 4; ++j )
+            r[4 * i + j] = a[4 * i + 0] * b[j] + a[4 * i + 1] * b[4 + j] + a[4 * i + 2] * b[8 + j];
+        r[4 * i + 3] += a[4 * i + 3];
+    }
+    std::copy( r, r + 12, result );
+}
+
+/// Multiplies the 3x4 matrix m with the point p. Mirrors optixTransformPoint().
+inline void optixUtilTransformPoint( const float* m, const float* p, float* result )
+{
+    const float x = p[0], y = p[1], z = p[2];
+    result[0]     = m[0] * x + m[1] * y + m[2] * z + m[3];
+    result[1]     = m[4] * x + m[5] * y + m[6] * z + m[7];
+    result[2]     = m[8] * x + m[9] * y + m[10] * z + m[11];
+}
+
+/// Computes the key index and the time within the key interval for globalt. Mirrors optixResolveMotionKey().
+inline void optixUtilResolveMotionKey( float& localt, int& key, const OptixMotionOptions& options, const float globalt )
+{
+    const float timeBegin    = options.timeBegin;
+    const float timeEnd      = options.timeEnd;
+    const float numIntervals = (float)( options.numKeys - 1 );
+
+    const float time   = std::max( 0.f, std::min( numIntervals, ( globalt - timeBegin ) * numIntervals / ( timeEnd - timeBegin ) ) );
+    const float fltKey = std::floor( time );
+
+    localt = time - fltKey;
+    key    = (int)fltKey;
+}
+
+/// Linearly interpolates two 3x4 matrix keys. Mirrors optixLoadInterpolatedMatrixKey().
+inline void optixUtilInterpolateMatrixKey( float* result, const float* key0, const float* key1, const float t1 )
+{
+    const float t0 = 1.0f - t1;
+    for( int k = 0; k < 12; ++k )
+        result[k] = t1 > 0.0f ? key0[k] * t0 + key1[k] * t1 : key0[k];
+}
+
+/// Linearly interpolates two SRT keys and renormalizes the quaternion. Mirrors optixLoadInterpolatedSrtKey().
+inline void optixUtilInterpolateSrtKey( OptixSRTData& result, const OptixSRTData& key0, const OptixSRTData& key1, const float t1 )
+{
+    result = key0;
+    if( t1 > 0.0f )
+    {
+        const float  t0 = 1.0f - t1;
+        const float* a  = &key0.sx;
+        const float* b  = &key1.sx;
+        float*       r  = &result.sx;
+        for( int k = 0; k < 16; ++k )
+            r[k] = a[k] * t0 + b[k] * t1;
+
+        const float inv_length =
+            1.f / std::sqrt( result.qx * result.qx + result.qy * result.qy + result.qz * result.qz + result.qw * result.qw );
+        result.qx *= inv_length;
+        result.qy *= inv_length;
+        result.qz *= inv_length;
+        result.qw *= inv_length;
+    }
+}
+
+/*@}*/  // end group optix_utilities
+
+#endif  // __optix_optix_util_transform_h__
@@ -0,0 +1,397 @@
+/// @file
+/// @brief  OptiX host utilities: quantization of triangle vertices to HALF3 and SNORM16_3
+///
+/// OPTIX_VERTEX_FORMAT_HALF3 and OPTIX_VERTEX_FORMAT_SNORM16_3 store a vertex in 6 instead of 12 bytes. Positions are
+/// mapped from their local bounds to [-1, 1] before conversion, and the inverse mapping is returned as a 3x4 matrix for
+/// #OptixBuildInputTriangleArray::preTransform. The build applies it, so the GAS stays in the original object space.
+///
+/// SNORM16 keeps 16 bits on each axis, i.e., a maximum error of about 1.5e-5 times the half extent of the bounds. HALF
+/// has an 11 bit significand, and its error grows to about 2.4e-4 times the half extent near the bounds. SNORM16 is the
+/// better choice unless the device code reads the vertices as halfs.
+///
+/// #optixUtilQuantizeVertices() converts a list of meshes in parallel, one mesh per work item. Within a mesh, the x,
+/// y, z stream is converted 8 vertices at a time with AVX2 and F16C.
+
+#ifndef __optix_optix_util_vertex_quantize_h__
+#define __optix_optix_util_vertex_quantize_h__
+
+#include "optix_util_parallel.h"
+#include "optix_util_simd.h"
+
+#include <optix_types.h>
+
+#include <algorithm>
+#include <cmath>
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+#include <vector>
+
+/** \addtogroup optix_utilities
+@{
+*/
+
+/// Vertex positions of one mesh for #optixUtilQuantizeVertices().
+struct OptixUtilQuantizeInput
+{
+    /// Positions as float x, y, z. Must be finite.
+    const float* vertices;
+    unsigned int numVertices;
+    /// Stride between vertices, 0 for tightly packed positions. Must be a multiple of 4.
+    unsigned int vertexStrideInBytes;
+    /// Optional bounds to quantize into, e.g., the union over all motion keys of a mesh, which share a preTransform.
+    /// Must contain all vertices. nullptr uses the bounds of the vertices.
+    const OptixAabb* bounds;
+};
+
+/// Quantized vertices of one mesh.
+struct OptixUtilQuantizedVertices
+{
+    /// Row major 3x4 matrix from the quantized space to object space. Aligned for a direct copy to a device buffer at
+    /// a multiple of OPTIX_GEOMETRY_TRANSFORM_BYTE_ALIGNMENT.
+    alignas( OPTIX_GEOMETRY_TRANSFORM_BYTE_ALIGNMENT ) float preTransform[12];
+
+    /// Three 16-bit values per vertex, halfs or signed normalized integers depending on format.
+    std::vector<unsigned short> data;
+    OptixVertexFormat           format;
+    unsigned int                numVertices;
+    unsigned int                vertexStrideInBytes;
+
+    /// Bounds that were mapped to [-1, 1].
+    OptixAabb bounds;
+    /// Largest difference between an input position and its decoded and transformed value, per axis.
+    float maxAxisError[3];
+    /// Length of maxAxisError, a bound for the distance between any input position and its decoded value.
+    float maxError;
+};
+
+namespace optix_util_impl {
+
+/// Converts a float to a half with round to nearest even, like _mm256_cvtps_ph() with _MM_FROUND_TO_NEAREST_INT.
+inline unsigned short floatToHalf( float value )
+{
+    uint32_t bits;
+    std::memcpy( &bits, &value, sizeof( float ) );
+    const uint32_t sign = ( bits >> 16 ) & 0x8000u;
+    const uint32_t abs  = bits & 0x7fffffffu;
+
+    if( abs >= 0x7f800000u )
+        return (unsigned short)( sign | ( abs > 0x7f800000u ? 0x7e00u : 0x7c00u ) );
+    // Values from 65520 up round to infinity.
+    if( abs >= 0x477ff000u )
+        return (unsigned short)( sign | 0x7c00u );
+    // Below 2^-14, halfs are subnormal with a unit of 2^-24. The scaling is exact and rint() rounds to even.
+    if( abs < 0x38800000u )
+    {
+        float a;
+        std::memcpy( &a, &abs, sizeof( float ) );
+        return (unsigned short)( sign | (uint32_t)std::rint( a * 16777216.0f ) );
+    }
+
+    const uint32_t rebiased  = abs - 0x38000000u;
+    uint32_t       half      = rebiased >> 13;
+    const uint32_t remainder = rebiased & 0x1fffu;
+    half += remainder > 0x1000u || ( remainder == 0x1000u && ( half & 1 ) );
+    return (unsigned short)( sign | half );
+}
+
+inline float halfToFloat( unsigned short half )
+{
+    const uint32_t sign     = (uint32_t)( half & 0x8000u ) << 16;
+    const uint32_t exponent = ( half >> 10 ) & 0x1fu;
+    const uint32_t mantissa = half & 0x3ffu;
+
+    uint32_t bits;
+    if( exponent == 0 )
+    {
+        const float value = (float)mantissa * ( 1.0f / 16777216.0f );
+        std::memcpy( &bits, &value, sizeof( float ) );
+        bits |= sign;
+    }
+    else if( exponent == 31 )
+    {
+        bits = sign | 0x7f800000u | ( mantissa << 13 );
+    }
+    else
+    {
+        bits = sign | ( ( exponent + 112 ) << 23 ) | ( mantissa << 13 );
+    }
+    float value;
+    std::memcpy( &value, &bits, sizeof( float ) );
+    return value;
+}
+
+/// Largest magnitude of SNORM16, which decodes to 1.
+const float QUANTIZE_SNORM16_MAX = 32767.0f;
+
+/// Per-axis mapping of a mesh: t = ( p - center ) * scale is converted, and p' = extent * decode( t ) + center.
+struct QuantizeMapping
+{
+    float center[3];
+    float extent[3];
+    float scale[3];
+    bool  snorm;
+};
+
+inline float decodeQuantized( const QuantizeMapping& mapping, unsigned short value )
+{
+    return mapping.snorm ? (float)(short)value * ( 1.0f / QUANTIZE_SNORM16_MAX ) : halfToFloat( value );
+}
+
+inline unsigned short encodeQuantized( const QuantizeMapping& mapping, float t )
+{
+    if( !mapping.snorm )
+        return floatToHalf( t );
+    // Clamps to the symmetric range. NaN maps to the lower bound like the SIMD conversion.
+    const float clamped = t > -QUANTIZE_SNORM16_MAX ? std::min( t, QUANTIZE_SNORM16_MAX ) : -QUANTIZE_SNORM16_MAX;
+    return (unsigned short)(short)std::lrint( clamped );
+}
+
+/// Quantizes vertices [begin, end) and grows error by their per-axis error. The error is evaluated in double, where
+/// the product of extent and decoded value is exact, so it does not depend on whether the compiler fuses the
+/// multiply-add, and all instruction sets report the same error.
+inline void quantizeScalar( const OptixUtilQuantizeInput& input,
+                            const QuantizeMapping&        mapping,
+                            size_t                        begin,
+                            size_t                        end,
+                            unsigned short*               dst,
+                            float*                        error )
+{
+    const size_t stride = input.vertexStrideInBytes ? input.vertexStrideInBytes : 3 * sizeof( float );
+    for( size_t i = begin; i < end; ++i )
+    {
+        const float* p = (const float*)( (const char*)input.vertices + i * stride );
+        for( int k = 0; k < 3; ++k )
+        {
+            const unsigned short q = encodeQuantized( mapping, ( p[k] - mapping.center[k] ) * mapping.scale[k] );
+            const double decoded = (double)mapping.extent[k] * decodeQuantized( mapping, q ) + mapping.center[k];
+            dst[i * 3 + k]       = q;
+            error[k]             = std::max( error[k], (float)std::fabs( decoded - p[k] ) );
+        }
+    }
+}
+
+#if OPTIX_UTIL_SIMD_X86
+
+/// Lower (h = 0) or upper (h = 1) four lanes of v.
+OPTIX_UTIL_TARGET_AVX2 inline __m128 extractHalf( __m256 v, int h )
+{
+    return h ? _mm256_extractf128_ps( v, 1 ) : _mm256_castps256_ps128( v );
+}
+
+/// Quantizes the x, y, z stream 24 values, i.e., 8 vertices, at a time. Value e of a group belongs to axis e % 3, so
+/// the per-axis constants are repeated in three vectors with a period of 3 lanes.
+OPTIX_UTIL_TARGET_AVX2 inline size_t quantizeAvx2( const OptixUtilQuantizeInput& input,
+                                                   const QuantizeMapping&        mapping,
+                                                   unsigned short*               dst,
+                                                   float*                        error )
+{
+    const size_t stride = input.vertexStrideInBytes ? input.vertexStrideInBytes : 3 * sizeof( float );
+    const bool   packed = stride == 3 * sizeof( float );
+
+    alignas( 32 ) float center[24], extent[24], scale[24];
+    alignas( 32 ) int   offset[24];
+    for( int e = 0; e < 24; ++e )
+    {
+        center[e] = mapping.center[e % 3];
+        extent[e] = mapping.extent[e % 3];
+        scale[e]  = mapping.scale[e % 3];
+        offset[e] = (int)( ( e / 3 ) * ( stride / sizeof( float ) ) + e % 3 );
+    }
+
+    const __m256  absMask = _mm256_castsi256_ps( _mm256_set1_epi32( 0x7fffffff ) );
+    const __m256i lo      = _mm256_set1_epi32( -32767 );
+    const __m256i hi      = _mm256_set1_epi32( 32767 );
+    const __m256  inv     = _mm256_set1_ps( 1.0f / QUANTIZE_SNORM16_MAX );
+    __m256        err[3]  = {_mm256_setzero_ps(), _mm256_setzero_ps(), _mm256_setzero_ps()};
+
+    size_t i = 0;
+    for( ; i + 8 <= input.numVertices; i += 8 )
+    {
+        const float* src = (const float*)( (const char*)input.vertices + i * stride );
+        __m256i      q[3] = {_mm256_setzero_si256(), _mm256_setzero_si256(), _mm256_setzero_si256()};
+        for( int r = 0; r < 3; ++r )
+        {
+            const __m256i index = _mm256_load_si256( (const __m256i*)&offset[r * 8] );
+            const __m256  p     = packed ? _mm256_loadu_ps( src + r * 8 ) : _mm256_i32gather_ps( src, index, 4 );
+            const __m256 c = _mm256_load_ps( &center[r * 8] );
+            const __m256 t = _mm256_mul_ps( _mm256_sub_ps( p, c ), _mm256_load_ps( &scale[r * 8] ) );
+            __m256       decoded;
+            if( mapping.snorm )
+            {
+                q[r]    = _mm256_min_epi32( _mm256_max_epi32( _mm256_cvtps_epi32( t ), lo ), hi );
+                decoded = _mm256_mul_ps( _mm256_cvtepi32_ps( q[r] ), inv );
+            }
+            else
+            {
+                const __m128i h = _mm256_cvtps_ph( t, _MM_FROUND_TO_NEAREST_INT );
+                _mm_storeu_si128( (__m128i*)( dst + i * 3 + r * 8 ), h );
+                decoded = _mm256_cvtph_ps( h );
+            }
+            // Error in double like quantizeScalar(), four lanes at a time.
+            const __m256 e     = _mm256_load_ps( &extent[r * 8] );
+            __m128       half[2];
+            for( int h = 0; h < 2; ++h )
+            {
+                const __m256d position = _mm256_add_pd( _mm256_mul_pd( _mm256_cvtps_pd( extractHalf( e, h ) ),
+                                                                       _mm256_cvtps_pd( extractHalf( decoded, h ) ) ),
+                                                        _mm256_cvtps_pd( extractHalf( c, h ) ) );
+                half[h] = _mm256_cvtpd_ps( _mm256_sub_pd( position, _mm256_cvtps_pd( extractHalf( p, h ) ) ) );
+            }
+            const __m256 difference = _mm256_insertf128_ps( _mm256_castps128_ps256( half[0] ), half[1], 1 );
+            err[r] = _mm256_max_ps( err[r], _mm256_and_ps( difference, absMask ) );
+        }
+        if( mapping.snorm )
+        {
+            // packs works within 128-bit lanes, the permutation restores the order.
+            const __m256i q01 = _mm256_permute4x64_epi64( _mm256_packs_epi32( q[0], q[1] ), 0xd8 );
+            const __m256i q22 = _mm256_permute4x64_epi64( _mm256_packs_epi32( q[2], q[2] ), 0xd8 );
+            _mm256_storeu_si256( (__m256i*)( dst + i * 3 ), q01 );
+            _mm_storeu_si128( (__m128i*)( dst + i * 3 + 16 ), _mm256_castsi256_si128( q22 ) );
+        }
+    }
+
+    alignas( 32 ) float lanes[24];
+    for( int r = 0; r < 3; ++r )
+        _mm256_store_ps( &lanes[r * 8], err[r] );
+    for( int e = 0; e < 24; ++e )
+        error[e % 3] = std::max( error[e % 3], lanes[e] );
+    return i;
+}
+
+#endif  // OPTIX_UTIL_SIMD_X86
+
+inline bool quantizeMesh( const OptixUtilQuantizeInput& input,
+                          OptixVertexFormat             format,
+                          OptixUtilQuantizedVertices&   output,
+                          OptixUtilSimdIsa              isa )
+{
+    const size_t stride = input.vertexStrideInBytes ? input.vertexStrideInBytes : 3 * sizeof( float );
+
+    OptixAabb box = {INFINITY, INFINITY, INFINITY, -INFINITY, -INFINITY, -INFINITY};
+    if( input.bounds )
+    {
+        box = *input.bounds;
+    }
+    else
+    {
+        for( size_t i = 0; i < input.numVertices; ++i )
+        {
+            const float* p = (const float*)( (const char*)input.vertices + i * stride );
+            box.minX = std::min( box.minX, p[0] );
+            box.minY = std::min( box.minY, p[1] );
+            box.minZ = std::min( box.minZ, p[2] );
+            box.maxX = std::max( box.maxX, p[0] );
+            box.maxY = std::max( box.maxY, p[1] );
+            box.maxZ = std::max( box.maxZ, p[2] );
+        }
+        if( input.numVertices == 0 )
+            box = OptixAabb{0.0f, 0.0f, 0.0f, 0.0f, 0.0f, 0.0f};
+    }
+
+    const float lower[3] = {box.minX, box.minY, box.minZ};
+    const float upper[3] = {box.maxX, box.maxY, box.maxZ};
+    QuantizeMapping mapping;
+    mapping.snorm = format == OPTIX_VERTEX_FORMAT_SNORM16_3;
+    for( int k = 0; k < 3; ++k )
+    {
+        if( !std::isfinite( lower[k] ) || !std::isfinite( upper[k] ) || lower[k] > upper[k] )
+            return false;
+        mapping.center[k] = 0.5f * lower[k] + 0.5f * upper[k];
+        mapping.extent[k] = std::max( upper[k] - mapping.center[k], mapping.center[k] - lower[k] );
+        const float range = mapping.snorm ? QUANTIZE_SNORM16_MAX : 1.0f;
+        mapping.scale[k]  = mapping.extent[k] > 0.0f ? range / mapping.extent[k] : 0.0f;
+    }
+
+    output.format              = format;
+    output.numVertices         = input.numVertices;
+    output.vertexStrideInBytes = 3 * sizeof( unsigned short );
+    output.bounds              = box;
+    output.data.resize( (size_t)input.numVertices * 3 );
+    std::fill( output.preTransform, output.preTransform + 12, 0.0f );
+    for( int k = 0; k < 3; ++k )
+    {
+        output.preTransform[k * 4 + k] = mapping.extent[k];
+        output.preTransform[k * 4 + 3] = mapping.center[k];
+        output.maxAxisError[k]         = 0.0f;
+    }
+
+    size_t done = 0;
+#if OPTIX_UTIL_SIMD_X86
+    if( isa >= OPTIX_UTIL_SIMD_ISA_AVX2 )
+        done = quantizeAvx2( input, mapping, output.data.data(), output.maxAxisError );
+#else
+    (void)isa;
+#endif
+    quantizeScalar( input, mapping, done, input.numVertices, output.data.data(), output.maxAxisError );
+
+    const float* e  = output.maxAxisError;
+    output.maxError = std::sqrt( e[0] * e[0] + e[1] * e[1] + e[2] * e[2] );
+    return true;
+}
+
+}  // namespace optix_util_impl
+
+/// Quantizes the vertices of several meshes, see the file description.
+///
+/// \param[in]  inputs       Meshes.
+/// \param[in]  numMeshes    Number of meshes.
+/// \param[in]  format       OPTIX_VERTEX_FORMAT_SNORM16_3 or OPTIX_VERTEX_FORMAT_HALF3.
+/// \param[out] outputs      Quantized vertices, one per mesh.
+/// \param[in]  maxThreads   Upper bound on the number of threads, 0 for #optixUtilGetDefaultThreadCount().
+/// \param[in]  isa          Instruction set to use, see #optixUtilSelectSimdIsa().
+///
+/// Returns OPTIX_ERROR_INVALID_VALUE if a mesh has non-finite bounds. The outputs of the other meshes are valid.
+inline OptixResult optixUtilQuantizeVertices( const OptixUtilQuantizeInput* inputs,
+                                              size_t                        numMeshes,
+                                              OptixVertexFormat             format,
+                                              OptixUtilQuantizedVertices*   outputs,
+                                              unsigned int                  maxThreads = 0,
+                                              OptixUtilSimdIsa              isa        = OPTIX_UTIL_SIMD_ISA_AUTO )
+{
+    if( numMeshes && ( !inputs || !outputs ) )
+        return OPTIX_ERROR_INVALID_VALUE;
+    if( format != OPTIX_VERTEX_FORMAT_SNORM16_3 && format != OPTIX_VERTEX_FORMAT_HALF3 )
+        return OPTIX_ERROR_INVALID_VALUE;
+    for( size_t m = 0; m < numMeshes; ++m )
+    {
+        const unsigned int stride = inputs[m].vertexStrideInBytes;
+        if( ( inputs[m].numVertices && !inputs[m].vertices ) || ( stride && ( stride < 12 || stride % 4 ) ) )
+            return OPTIX_ERROR_INVALID_VALUE;
+    }
+
+    const OptixUtilSimdIsa selected = optixUtilSelectSimdIsa( isa );
+    std::vector<char>      failed( numMeshes, 0 );
+    optixUtilParallelFor( numMeshes, 1,
+                          [&]( size_t begin, size_t end ) {
+                              for( size_t m = begin; m < end; ++m )
+                                  failed[m] = !optix_util_impl::quantizeMesh( inputs[m], format, outputs[m], selected );
+                          },
+                          maxThreads );
+    return std::find( failed.begin(), failed.end(), 1 ) == failed.end() ? OPTIX_SUCCESS : OPTIX_ERROR_INVALID_VALUE;
+}
+
+/// Sets the vertex format, stride, count and pre-transform of a triangle build input for quantized vertices. The
+/// vertex buffers are left to the caller.
+///
+/// \param[in,out] triangles      Build input.
+/// \param[in]     quantized      Quantized vertices.
+/// \param[in]     preTransform   Device copy of OptixUtilQuantizedVertices::preTransform, aligned to
+///                               OPTIX_GEOMETRY_TRANSFORM_BYTE_ALIGNMENT.
+inline OptixResult optixUtilSetQuantizedVertices( OptixBuildInputTriangleArray&     triangles,
+                                                  const OptixUtilQuantizedVertices& quantized,
+                                                  CUdeviceptr                       preTransform )
+{
+    if( !preTransform || preTransform % OPTIX_GEOMETRY_TRANSFORM_BYTE_ALIGNMENT != 0 )
+        return OPTIX_ERROR_INVALID_VALUE;
+    triangles.vertexFormat        = quantized.format;
+    triangles.vertexStrideInBytes = quantized.vertexStrideInBytes;
+    triangles.numVertices         = quantized.numVertices;
+    triangles.preTransform        = preTransform;
+    triangles.transformFormat     = OPTIX_TRANSFORM_FORMAT_MATRIX_FLOAT12;
+    return OPTIX_SUCCESS;
+}
+
+/*@}*/  // end group optix_utilities
+
+#endif  // __optix_optix_util_vertex_quantize_h__
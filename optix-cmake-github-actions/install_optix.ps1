@@ -34,9 +34,15 @@ $OptiX_INSTALL_DIR="$(Get-Location)\optix-cmake-github-actions\$DIR"
 $env:OptiX_INSTALL_DIR = "$($OptiX_INSTALL_DIR)"
 Write-Output "OptiX_INSTALL_DIR $($OptiX_INSTALL_DIR)"
 
+# Header-only host utilities shared by all OptiX versions.
+$OptiX_UTILS_INCLUDE_DIR="$(Get-Location)\optix-cmake-github-actions\include"
+$env:OptiX_UTILS_INCLUDE_DIR = "$($OptiX_UTILS_INCLUDE_DIR)"
+Write-Output "OptiX_UTILS_INCLUDE_DIR $($OptiX_UTILS_INCLUDE_DIR)"
+
 # If executing on github actions, emit the appropriate echo statements to update environment variables
 if (Test-Path "env:GITHUB_ACTIONS") {
     # Set paths for subsequent steps, using ${OptiX_INSTALL_DIR}
     echo "Adding OptiX to OptiX_INSTALL_DIR"
     echo "OptiX_INSTALL_DIR=$env:OptiX_INSTALL_DIR" | Out-File -FilePath $env:GITHUB_ENV -Encoding utf8 -Append
+    echo "OptiX_UTILS_INCLUDE_DIR=$env:OptiX_UTILS_INCLUDE_DIR" | Out-File -FilePath $env:GITHUB_ENV -Encoding utf8 -Append
 }
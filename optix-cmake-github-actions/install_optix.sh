@@ -51,9 +51,14 @@ DIR="${OPTIX_ALLVERSIONS[${OPTIX_VERSION_MAJOR_MINOR}]}"
 export OptiX_INSTALL_DIR="${PWD}/optix-cmake-github-actions/${DIR}"
 echo export OptiX_INSTALL_DIR="${PWD}/optix-cmake-github-actions/${DIR}"
 
+# Header-only host utilities shared by all OptiX versions.
+export OptiX_UTILS_INCLUDE_DIR="${PWD}/optix-cmake-github-actions/include"
+echo export OptiX_UTILS_INCLUDE_DIR="${OptiX_UTILS_INCLUDE_DIR}"
+
 # If executed on github actions, make the appropriate echo statements to update the environment
 if [[ $GITHUB_ACTIONS ]]; then
     # Set paths for subsequent steps, using ${OptiX_INSTALL_DIR}
     echo "Adding OptiX to OptiX_INSTALL_DIR"
     echo "OptiX_INSTALL_DIR=${OptiX_INSTALL_DIR}" >> $GITHUB_ENV
+    echo "OptiX_UTILS_INCLUDE_DIR=${OptiX_UTILS_INCLUDE_DIR}" >> $GITHUB_ENV
 fi
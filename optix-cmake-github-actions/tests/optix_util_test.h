@@ -0,0 +1,250 @@
+/// @file
+/// @brief  Test support for the optix_util headers: CUDA type stand-ins, checks and stub OptiX functions
+///
+/// Tests include this header first. It declares the few CUDA driver types the OptiX headers need, so tests build
+/// without the CUDA toolkit, and provides function table entries that emulate OptiX on the host.
+
+#ifndef __optix_util_test_h__
+#define __optix_util_test_h__
+
+#define OPTIX_DONT_INCLUDE_CUDA
+typedef struct CUctx_st*    CUcontext;
+typedef struct CUstream_st* CUstream;
+
+#include <optix_function_table.h>
+
+#include <cstdint>
+#include <cstdio>
+#include <cstring>
+
+namespace optix_util_test {
+
+inline int& failureCount()
+{
+    static int count = 0;
+    return count;
+}
+
+/// Stub of optixSbtRecordPackHeader(): the header is the program group address repeated four times.
+inline OptixResult packHeader( OptixProgramGroup programGroup, void* header )
+{
+    const uint64_t value = (uint64_t)(uintptr_t)programGroup;
+    for( int k = 0; k < 4; ++k )
+        std::memcpy( static_cast<char*>( header ) + 8 * k, &value, 8 );
+    return OPTIX_SUCCESS;
+}
+
+/// First word of a header written by packHeader().
+inline uint64_t headerProgramGroup( const void* header )
+{
+    uint64_t value;
+    std::memcpy( &value, header, 8 );
+    return value;
+}
+
+inline OptixProgramGroup programGroup( uintptr_t id )
+{
+    return reinterpret_cast<OptixProgramGroup>( id * 16 );
+}
+
+/// Number of primitives of a triangle, custom primitive or instance build input.
+inline size_t buildInputPrimitives( const OptixBuildInput& input )
+{
+    if( input.type == OPTIX_BUILD_INPUT_TYPE_INSTANCES )
+        return input.instanceArray.numInstances;
+    if( input.type == OPTIX_BUILD_INPUT_TYPE_CUSTOM_PRIMITIVES )
+        return input.customPrimitiveArray.numPrimitives;
+    const OptixBuildInputTriangleArray& triangles = input.triangleArray;
+    return triangles.indexFormat != OPTIX_INDICES_FORMAT_NONE ? triangles.numIndexTriplets : triangles.numVertices / 3;
+}
+
+/// Stub of optixAccelComputeMemoryUsage(): the output takes 1 KiB plus 64 bytes per primitive, the temp buffer half as
+/// much and updates a quarter as much.
+inline OptixResult accelComputeMemoryUsage( OptixDeviceContext,
+                                            const OptixAccelBuildOptions*,
+                                            const OptixBuildInput* buildInputs,
+                                            unsigned int           numBuildInputs,
+                                            OptixAccelBufferSizes* bufferSizes )
+{
+    size_t numPrimitives = 0;
+    for( unsigned int i = 0; i < numBuildInputs; ++i )
+        numPrimitives += buildInputPrimitives( buildInputs[i] );
+    bufferSizes->outputSizeInBytes     = 1024 + 64 * numPrimitives;
+    bufferSizes->tempSizeInBytes       = bufferSizes->outputSizeInBytes / 2;
+    bufferSizes->tempUpdateSizeInBytes = bufferSizes->outputSizeInBytes / 4;
+    return OPTIX_SUCCESS;
+}
+
+/// Header of an acceleration structure written by accelBuild(), followed by compactedSize - sizeof( AccelImage ) bytes
+/// that hold the low byte of the primitive count.
+struct AccelImage
+{
+    uint64_t numPrimitives;
+    uint64_t compactedSize;
+};
+
+/// Stub of optixAccelBuild(): checks the buffer sizes and alignment against accelComputeMemoryUsage(), writes an
+/// AccelImage to the output and emits its compacted size, which is 1 KiB plus 32 bytes per primitive. Updates keep the
+/// image, which must have the same primitive count and may be compacted. The handle is the output address.
+inline OptixResult accelBuild( OptixDeviceContext            context,
+                               CUstream,
+                               const OptixAccelBuildOptions* accelOptions,
+                               const OptixBuildInput*        buildInputs,
+                               unsigned int                  numBuildInputs,
+                               CUdeviceptr                   tempBuffer,
+                               size_t                        tempBufferSizeInBytes,
+                               CUdeviceptr                   outputBuffer,
+                               size_t                        outputBufferSizeInBytes,
+                               OptixTraversableHandle*       outputHandle,
+                               const OptixAccelEmitDesc*     emittedProperties,
+                               unsigned int                  numEmittedProperties )
+{
+    OptixAccelBufferSizes sizes;
+    accelComputeMemoryUsage( context, accelOptions, buildInputs, numBuildInputs, &sizes );
+    if( outputBuffer % OPTIX_ACCEL_BUFFER_BYTE_ALIGNMENT || tempBuffer % OPTIX_ACCEL_BUFFER_BYTE_ALIGNMENT )
+        return OPTIX_ERROR_INVALID_VALUE;
+
+    AccelImage image = {0, 0};
+    for( unsigned int i = 0; i < numBuildInputs; ++i )
+        image.numPrimitives += buildInputPrimitives( buildInputs[i] );
+    image.compactedSize = 1024 + 32 * image.numPrimitives;
+    unsigned char* out  = (unsigned char*)(uintptr_t)outputBuffer;
+    if( accelOptions->operation == OPTIX_BUILD_OPERATION_UPDATE )
+    {
+        AccelImage built;
+        std::memcpy( &built, out, sizeof( built ) );
+        if( !( accelOptions->buildFlags & OPTIX_BUILD_FLAG_ALLOW_UPDATE ) || built.numPrimitives != image.numPrimitives
+            || outputBufferSizeInBytes < built.compactedSize || tempBufferSizeInBytes < sizes.tempUpdateSizeInBytes
+            || numEmittedProperties )
+            return OPTIX_ERROR_INVALID_VALUE;
+        *outputHandle = outputBuffer;
+        return OPTIX_SUCCESS;
+    }
+    if( outputBufferSizeInBytes < sizes.outputSizeInBytes || tempBufferSizeInBytes < sizes.tempSizeInBytes )
+        return OPTIX_ERROR_INVALID_VALUE;
+    std::memcpy( out, &image, sizeof( image ) );
+    std::memset( out + sizeof( image ), (int)( image.numPrimitives & 255 ), image.compactedSize - sizeof( image ) );
+
+    for( unsigned int e = 0; e < numEmittedProperties; ++e )
+    {
+        if( emittedProperties[e].type != OPTIX_PROPERTY_TYPE_COMPACTED_SIZE
+            || !( accelOptions->buildFlags & OPTIX_BUILD_FLAG_ALLOW_COMPACTION ) )
+            return OPTIX_ERROR_INVALID_VALUE;
+        std::memcpy( (void*)(uintptr_t)emittedProperties[e].result, &image.compactedSize, sizeof( uint64_t ) );
+    }
+    *outputHandle = outputBuffer;
+    return OPTIX_SUCCESS;
+}
+
+/// Stub of optixAccelCompact(): copies the compacted part of an AccelImage.
+inline OptixResult accelCompact( OptixDeviceContext,
+                                 CUstream,
+                                 OptixTraversableHandle  inputHandle,
+                                 CUdeviceptr             outputBuffer,
+                                 size_t                  outputBufferSizeInBytes,
+                                 OptixTraversableHandle* outputHandle )
+{
+    AccelImage image;
+    std::memcpy( &image, (const void*)(uintptr_t)inputHandle, sizeof( image ) );
+    if( outputBufferSizeInBytes < image.compactedSize || outputBuffer % OPTIX_ACCEL_BUFFER_BYTE_ALIGNMENT )
+        return OPTIX_ERROR_INVALID_VALUE;
+    std::memmove( (void*)(uintptr_t)outputBuffer, (const void*)(uintptr_t)inputHandle, image.compactedSize );
+    *outputHandle = outputBuffer;
+    return OPTIX_SUCCESS;
+}
+
+inline OptixDeviceContext deviceContext( uintptr_t id )
+{
+    return reinterpret_cast<OptixDeviceContext>( id * 16 );
+}
+
+/// Stub of optixAccelGetRelocationInfo(): the info holds the context address and the compacted size of the AccelImage.
+inline OptixResult accelGetRelocationInfo( OptixDeviceContext        context,
+                                           OptixTraversableHandle    handle,
+                                           OptixAccelRelocationInfo* info )
+{
+    AccelImage image;
+    std::memcpy( &image, (const void*)(uintptr_t)handle, sizeof( image ) );
+    *info = {{(uint64_t)(uintptr_t)context, image.compactedSize, 0, 0}};
+    return OPTIX_SUCCESS;
+}
+
+/// Stub of optixAccelCheckRelocationCompatibility(): acceleration structures are compatible with the context that
+/// built them only.
+inline OptixResult accelCheckRelocationCompatibility( OptixDeviceContext              context,
+                                                      const OptixAccelRelocationInfo* info,
+                                                      int*                            compatible )
+{
+    *compatible = info->info[0] == (uint64_t)(uintptr_t)context;
+    return OPTIX_SUCCESS;
+}
+
+/// Stub of optixAccelRelocate(): checks that the target holds the AccelImage described by info. The handle is the
+/// target address.
+inline OptixResult accelRelocate( OptixDeviceContext context,
+                                  CUstream,
+                                  const OptixAccelRelocationInfo* info,
+                                  CUdeviceptr,
+                                  size_t,
+                                  CUdeviceptr             targetAccel,
+                                  size_t                  targetAccelSizeInBytes,
+                                  OptixTraversableHandle* targetHandle )
+{
+    AccelImage image;
+    std::memcpy( &image, (const void*)(uintptr_t)targetAccel, sizeof( image ) );
+    if( info->info[0] != (uint64_t)(uintptr_t)context || targetAccel % OPTIX_ACCEL_BUFFER_BYTE_ALIGNMENT
+        || targetAccelSizeInBytes < info->info[1] || image.compactedSize != info->info[1] )
+        return OPTIX_ERROR_INVALID_VALUE;
+    *targetHandle = targetAccel;
+    return OPTIX_SUCCESS;
+}
+
+/// Checks that an acceleration structure holds the AccelImage of numPrimitives primitives.
+inline bool isAccelImage( CUdeviceptr buffer, uint64_t numPrimitives )
+{
+    AccelImage image;
+    std::memcpy( &image, (const void*)(uintptr_t)buffer, sizeof( image ) );
+    const unsigned char* data = (const unsigned char*)(uintptr_t)buffer + sizeof( image );
+    return image.numPrimitives == numPrimitives && image.compactedSize == 1024 + 32 * numPrimitives
+           && data[0] == ( numPrimitives & 255 ) && data[image.compactedSize - sizeof( image ) - 1] == data[0];
+}
+
+/// Function table with the stubs above. Other entries are null, tests install the ones they exercise.
+inline OptixFunctionTable stubFunctionTable()
+{
+    OptixFunctionTable api;
+    std::memset( &api, 0, sizeof( api ) );
+    api.optixSbtRecordPackHeader     = packHeader;
+    api.optixAccelComputeMemoryUsage = accelComputeMemoryUsage;
+    api.optixAccelBuild              = accelBuild;
+    api.optixAccelCompact            = accelCompact;
+
+    api.optixAccelGetRelocationInfo            = accelGetRelocationInfo;
+    api.optixAccelCheckRelocationCompatibility = accelCheckRelocationCompatibility;
+    api.optixAccelRelocate                     = accelRelocate;
+    return api;
+}
+
+/// Returns the exit code of the test.
+inline int finish()
+{
+    if( failureCount() )
+        std::fprintf( stderr, "%d check(s) failed\n", failureCount() );
+    return failureCount() ? 1 : 0;
+}
+
+}  // namespace optix_util_test
+
+#define OPTIX_UTIL_CHECK( condition )                                                                                  \
+    do                                                                                                                 \
+    {                                                                                                                  \
+        if( !( condition ) )                                                                                           \
+        {                                                                                                              \
+            std::fprintf( stderr, "%s:%d: check failed: %s\n", __FILE__, __LINE__, #condition );                      \
+            ++optix_util_test::failureCount();                                                                         \
+        }                                                                                                              \
+    } while( 0 )
+
+#define OPTIX_UTIL_CHECK_SUCCESS( call ) OPTIX_UTIL_CHECK( ( call ) == OPTIX_SUCCESS )
+
+#endif  // __optix_util_test_h__
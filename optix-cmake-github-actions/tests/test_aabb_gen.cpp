@@ -0,0 +1,96 @@
+#include "optix_util_test.h"
+
+#include <optix_util_aabb_gen.h>
+
+#include <cmath>
+#include <cstring>
+#include <limits>
+#include <vector>
+
+/// Spheres along x with radius 0.5, moving by 1 along y per motion key.
+struct SphereBounds
+{
+    void operator()( unsigned int primitive, unsigned int key, OptixAabb& box ) const
+    {
+        const float x = (float)primitive, y = (float)key;
+        box           = {x - 0.5f, y - 0.5f, -0.5f, x + 0.5f, y + 0.5f, 0.5f};
+    }
+};
+
+int main()
+{
+    // Known answer over several blocks and 2 motion keys, with a stride that leaves padding between the boxes. The
+    // padding is not written. 64-bit words keep the buffers aligned to OPTIX_AABB_BUFFER_BYTE_ALIGNMENT.
+    const unsigned int    n      = 100003;
+    const size_t          stride = 32;
+    std::vector<uint64_t> storage[2];
+    void*                 buffers[2];
+    for( int k = 0; k < 2; ++k )
+    {
+        storage[k].assign( n * stride / sizeof( uint64_t ), 0xcdcdcdcdcdcdcdcdull );
+        buffers[k] = storage[k].data();
+    }
+    OptixUtilAabbGenOptions options = {(unsigned int)stride, false};
+    OptixUtilAabbGenReport  report;
+    OPTIX_UTIL_CHECK_SUCCESS( optixUtilGenerateAabbs( n, 2, SphereBounds(), options, buffers, &report ) );
+    bool expected = true;
+    for( unsigned int k = 0; k < 2; ++k )
+        for( unsigned int i = 0; i < n; i += 997 )
+        {
+            const unsigned char* record = (const unsigned char*)buffers[k] + i * stride;
+            OptixAabb            box;
+            std::memcpy( &box, record, sizeof( box ) );
+            expected = expected && box.minX == (float)i - 0.5f && box.maxY == (float)k + 0.5f && box.minZ == -0.5f;
+            expected = expected && record[sizeof( OptixAabb )] == 0xcd && record[stride - 1] == 0xcd;
+        }
+    OPTIX_UTIL_CHECK( expected );
+    OPTIX_UTIL_CHECK( report.numNanBoxes == 0 && report.numInvertedBoxes == 0 && report.firstInvalidPrimitive == ~0u );
+    OPTIX_UTIL_CHECK( report.bounds.minX == -0.5f && report.bounds.maxX == (float)( n - 1 ) + 0.5f );
+    OPTIX_UTIL_CHECK( report.bounds.minY == -0.5f && report.bounds.maxY == 1.5f );
+
+    // The output does not depend on the thread count.
+    std::vector<uint64_t> serial( storage[1] );
+    OPTIX_UTIL_CHECK_SUCCESS( optixUtilGenerateAabbs( n, 2, SphereBounds(), options, buffers, nullptr, 1 ) );
+    OPTIX_UTIL_CHECK( serial == storage[1] );
+
+    // Edge cases: NaN boxes are counted and optionally replaced by an empty box, inverted boxes are counted and kept,
+    // and neither grows the bounds. The first invalid box is reported in primitive order.
+    const float nan      = std::numeric_limits<float>::quiet_NaN();
+    auto        invalids = [nan]( unsigned int primitive, unsigned int key, OptixAabb& box ) {
+        SphereBounds()( primitive, key, box );
+        if( primitive == 70000 && key == 0 )
+            box.maxZ = nan;
+        if( primitive == 50000 && key == 1 )
+            box = {1e6f, 0.f, 0.f, 0.f, 1.f, 1.f};
+    };
+    options.replaceNanBoxes = true;
+    OPTIX_UTIL_CHECK_SUCCESS( optixUtilGenerateAabbs( n, 2, invalids, options, buffers, &report ) );
+    OPTIX_UTIL_CHECK( report.numNanBoxes == 1 && report.numInvertedBoxes == 1 );
+    OPTIX_UTIL_CHECK( report.firstInvalidPrimitive == 50000 && report.firstInvalidKey == 1 );
+    OPTIX_UTIL_CHECK( report.bounds.maxX == (float)( n - 1 ) + 0.5f );
+    OptixAabb replaced, inverted;
+    std::memcpy( &replaced, (const unsigned char*)buffers[0] + 70000 * stride, sizeof( replaced ) );
+    std::memcpy( &inverted, (const unsigned char*)buffers[1] + 50000 * stride, sizeof( inverted ) );
+    OPTIX_UTIL_CHECK( replaced.minX > replaced.maxX && !std::isnan( replaced.maxZ ) );
+    OPTIX_UTIL_CHECK( inverted.minX == 1e6f );
+
+    // Invalid strides, misaligned buffers and zero motion keys are rejected, empty inputs succeed.
+    options.strideInBytes = 24 + 4;
+    OPTIX_UTIL_CHECK( optixUtilGenerateAabbs( n, 2, SphereBounds(), options, buffers ) == OPTIX_ERROR_INVALID_VALUE );
+    options.strideInBytes = 0;
+    void* misaligned[1]   = {(unsigned char*)buffers[0] + 4};
+    OPTIX_UTIL_CHECK( optixUtilGenerateAabbs( n, 1, SphereBounds(), options, misaligned )
+                      == OPTIX_ERROR_INVALID_VALUE );
+    OPTIX_UTIL_CHECK( optixUtilGenerateAabbs( n, 0, SphereBounds(), options, buffers ) == OPTIX_ERROR_INVALID_VALUE );
+    OPTIX_UTIL_CHECK_SUCCESS( optixUtilGenerateAabbs( 0, 1, SphereBounds(), options, nullptr, &report ) );
+    OPTIX_UTIL_CHECK( report.numNanBoxes == 0 && report.bounds.minX > report.bounds.maxX );
+
+    // The build input uses the same stride.
+    OptixBuildInputCustomPrimitiveArray custom    = {};
+    const CUdeviceptr                   device[2] = {0x1000, 0x2000};
+    options.strideInBytes                         = (unsigned int)stride;
+    optixUtilSetGeneratedAabbs( custom, n, device, options );
+    OPTIX_UTIL_CHECK( custom.aabbBuffers == device && custom.numPrimitives == n && custom.strideInBytes == stride );
+
+    return optix_util_test::finish();
+}
@@ -0,0 +1,209 @@
+#include "optix_util_test.h"
+
+#include <optix_util_accel_cache.h>
+
+#include <cstdio>
+#include <cstring>
+#include <vector>
+
+using optix_util_test::isAccelImage;
+
+/// File image in a buffer aligned to OPTIX_UTIL_GEOMETRY_CACHE_ALIGNMENT, for openMemory().
+struct AlignedImage
+{
+    std::vector<unsigned char> storage;
+    unsigned char*             data = nullptr;
+    size_t                     size = 0;
+
+    bool read( const char* path )
+    {
+        FILE* file = std::fopen( path, "rb" );
+        if( !file )
+            return false;
+        std::fseek( file, 0, SEEK_END );
+        size = (size_t)std::ftell( file );
+        std::fseek( file, 0, SEEK_SET );
+        storage.assign( size + OPTIX_UTIL_GEOMETRY_CACHE_ALIGNMENT, 0 );
+        const uintptr_t address = (uintptr_t)storage.data();
+        data = storage.data() + ( OPTIX_UTIL_GEOMETRY_CACHE_ALIGNMENT - address % OPTIX_UTIL_GEOMETRY_CACHE_ALIGNMENT )
+                                    % OPTIX_UTIL_GEOMETRY_CACHE_ALIGNMENT;
+        const bool ok = std::fread( data, 1, size, file ) == size;
+        std::fclose( file );
+        return ok;
+    }
+};
+
+int main()
+{
+    const char* path      = "test_accel_cache.bin";
+    const char* rewritten = "test_accel_cache_rewritten.bin";
+
+    // 5 compacted GAS, built on context 1 and cached under keys that depend on the mesh index.
+    const unsigned int         n            = 5;
+    const unsigned int         triangles[n] = {10, 200, 3, 4000, 77};
+    const OptixFunctionTable   api          = optix_util_test::stubFunctionTable();
+    const OptixDeviceContext   context      = optix_util_test::deviceContext( 1 );
+    OptixAccelBuildOptions     buildOptions = {};
+    OptixBuildInput            inputs[n]    = {};
+    OptixUtilAccelBuildRequest requests[n];
+    uint64_t                   keys[n];
+    buildOptions.buildFlags = OPTIX_BUILD_FLAG_ALLOW_COMPACTION;
+    buildOptions.operation  = OPTIX_BUILD_OPERATION_BUILD;
+    for( unsigned int i = 0; i < n; ++i )
+    {
+        inputs[i].type                           = OPTIX_BUILD_INPUT_TYPE_TRIANGLES;
+        inputs[i].triangleArray.indexFormat      = OPTIX_INDICES_FORMAT_UNSIGNED_INT3;
+        inputs[i].triangleArray.numIndexTriplets = triangles[i];
+        requests[i]                              = {&buildOptions, &inputs[i], 1};
+        keys[i]                                  = optixUtilComputeAccelCacheKey( buildOptions, &inputs[i], 1, i + 1 );
+    }
+    OptixUtilAccelMemoryPool   pool( optixUtilHostAllocator() );
+    OptixUtilCompactedGasBatch built;
+    OptixUtilGasBatchOptions   batchOptions = {0, 0};
+    OPTIX_UTIL_CHECK_SUCCESS( optixUtilBuildCompactedGas( api, context, nullptr, requests, n, pool,
+                                                          optixUtilHostReadback(), batchOptions, built ) );
+
+    OptixUtilAccelCacheWriter writer;
+    for( unsigned int i = 0; i < n; ++i )
+        OPTIX_UTIL_CHECK_SUCCESS( optixUtilAddAccelToCache( api, context, nullptr, optixUtilHostReadback(), keys[i],
+                                                            built.handles[i], built.buffers[i], built.sizes[i],
+                                                            writer ) );
+    OPTIX_UTIL_CHECK( optixUtilAddAccelToCache( api, context, nullptr, optixUtilHostReadback(), keys[0], 0,
+                                                built.buffers[0], built.sizes[0], writer )
+                      == OPTIX_ERROR_INVALID_VALUE );
+    OPTIX_UTIL_CHECK( writer.numAccels() == n );
+    OPTIX_UTIL_CHECK_SUCCESS( writer.write( path ) );
+
+    // Round trip: every GAS comes back with its size, bytes and relocation info, the index is sorted by key, and the
+    // data sections are aligned.
+    {
+        OptixUtilAccelCache cache;
+        OPTIX_UTIL_CHECK_SUCCESS( cache.open( path ) );
+        OPTIX_UTIL_CHECK( cache.numAccels() == n && optixUtilVerifyAccelCache( cache ) == OPTIX_SUCCESS );
+        bool roundTrip = true;
+        for( unsigned int i = 0; i < n; ++i )
+        {
+            const OptixUtilCachedAccel* accel = cache.find( keys[i] );
+            roundTrip = roundTrip && accel && accel->data.size == 1024 + 32 * triangles[i];
+            roundTrip = roundTrip && accel->data.offset % OPTIX_UTIL_GEOMETRY_CACHE_ALIGNMENT == 0;
+            roundTrip = roundTrip && std::memcmp( cache.data( *accel ), (const void*)(uintptr_t)built.buffers[i],
+                                                  (size_t)accel->data.size )
+                                         == 0;
+            roundTrip = roundTrip && accel->relocationInfo.info[0] == (uintptr_t)context;
+            roundTrip = roundTrip && ( i == 0 || cache.accel( i - 1 ).key < cache.accel( i ).key );
+        }
+        OPTIX_UTIL_CHECK( roundTrip && cache.find( keys[0] ^ 1 ) == nullptr );
+
+        // Load: hits are relocated into 128-byte aligned pool memory, unknown keys are misses.
+        const uint64_t                 batchKeys[6] = {keys[3], keys[0] ^ 1, keys[0], keys[1], keys[2], keys[4]};
+        const unsigned int             meshes[6]    = {3, 0, 0, 1, 2, 4};
+        OptixUtilAccelCacheLoadOptions loadOptions  = {64 * 1024, 1};
+        OptixUtilCompactedGasBatch     loaded;
+        std::vector<unsigned int>      misses;
+        OptixUtilAccelCacheLoadReport  report;
+        OPTIX_UTIL_CHECK_SUCCESS( optixUtilLoadCachedGas( api, context, nullptr, cache, batchKeys, 6, pool,
+                                                          optixUtilHostUpload(), loadOptions, loaded, misses,
+                                                          &report ) );
+        bool   hits        = loaded.handles.size() == 6 && loaded.handles[1] == 0 && loaded.buffers[1] == 0;
+        size_t loadedBytes = 0;
+        for( unsigned int j = 0; j < 6 && hits; ++j )
+        {
+            if( j == 1 )
+                continue;
+            loadedBytes += 1024 + 32 * triangles[meshes[j]];
+            hits = hits && loaded.handles[j] == loaded.buffers[j] && loaded.buffers[j] != built.buffers[meshes[j]];
+            hits = hits && loaded.buffers[j] % OPTIX_ACCEL_BUFFER_BYTE_ALIGNMENT == 0;
+            hits = hits && isAccelImage( loaded.buffers[j], triangles[meshes[j]] );
+        }
+        OPTIX_UTIL_CHECK( hits && misses == std::vector<unsigned int>( 1, 1 ) );
+        OPTIX_UTIL_CHECK( report.numHits == 5 && report.numMisses == 1 && report.numIncompatible == 0 );
+        OPTIX_UTIL_CHECK( report.numCorrupt == 0 && report.loadedBytes == loadedBytes );
+        OPTIX_UTIL_CHECK_SUCCESS( optixUtilReleaseCompactedGasBatch( pool, loaded ) );
+
+        // A different device context cannot relocate the cached GAS, all keys are misses.
+        OPTIX_UTIL_CHECK_SUCCESS( optixUtilLoadCachedGas( api, optix_util_test::deviceContext( 2 ), nullptr, cache,
+                                                          batchKeys, 6, pool, optixUtilHostUpload(), loadOptions,
+                                                          loaded, misses, &report ) );
+        OPTIX_UTIL_CHECK( report.numHits == 0 && report.numIncompatible == 5 && misses.size() == 6 );
+        OPTIX_UTIL_CHECK_SUCCESS( optixUtilReleaseCompactedGasBatch( pool, loaded ) );
+
+        // Rewriting carries the cached GAS over, keeps GAS added before them and adds new ones.
+        OptixUtilAccelCacheWriter  next;
+        std::vector<unsigned char> replacement( 1024 + 32 * 9 );
+        next.addAccel( keys[2], cache.find( keys[0] )->relocationInfo, replacement );
+        next.addAccel( 42, cache.find( keys[0] )->relocationInfo, replacement );
+        next.addCachedAccels( cache );
+        OPTIX_UTIL_CHECK( next.numAccels() == n + 1 );
+        OPTIX_UTIL_CHECK_SUCCESS( next.write( rewritten ) );
+    }
+    {
+        OptixUtilAccelCache cache;
+        OPTIX_UTIL_CHECK_SUCCESS( cache.open( rewritten ) );
+        OPTIX_UTIL_CHECK( cache.numAccels() == n + 1 && cache.find( 42 ) && cache.find( keys[4] ) );
+        OPTIX_UTIL_CHECK( cache.find( keys[2] )->data.size == 1024 + 32 * 9 );
+        OPTIX_UTIL_CHECK( cache.find( keys[3] )->data.size == 1024 + 32 * triangles[3] );
+        OPTIX_UTIL_CHECK_SUCCESS( optixUtilVerifyAccelCache( cache ) );
+    }
+    std::remove( rewritten );
+
+    // The key ignores the operation, compaction and device pointer values, and covers counts, flags and content.
+    OptixAccelBuildOptions variant = buildOptions;
+    variant.operation              = OPTIX_BUILD_OPERATION_UPDATE;
+    variant.buildFlags             = OPTIX_BUILD_FLAG_NONE;
+    OPTIX_UTIL_CHECK( optixUtilComputeAccelCacheKey( variant, &inputs[0], 1, 1 ) == keys[0] );
+    variant.buildFlags = OPTIX_BUILD_FLAG_PREFER_FAST_TRACE;
+    OPTIX_UTIL_CHECK( optixUtilComputeAccelCacheKey( variant, &inputs[0], 1, 1 ) != keys[0] );
+    OPTIX_UTIL_CHECK( optixUtilComputeAccelCacheKey( buildOptions, &inputs[0], 1, 2 ) != keys[0] );
+    OptixBuildInput moved           = inputs[0];
+    moved.triangleArray.indexBuffer = 0x1000;
+    OPTIX_UTIL_CHECK( optixUtilComputeAccelCacheKey( buildOptions, &moved, 1, 1 ) == keys[0] );
+    moved.triangleArray.preTransform = 0x2000;
+    const uint64_t transformed       = optixUtilComputeAccelCacheKey( buildOptions, &moved, 1, 1 );
+    moved.triangleArray.preTransform = 0x3000;
+    OPTIX_UTIL_CHECK( transformed != keys[0] );
+    OPTIX_UTIL_CHECK( optixUtilComputeAccelCacheKey( buildOptions, &moved, 1, 1 ) == transformed );
+    moved.triangleArray.numIndexTriplets = 11;
+    OPTIX_UTIL_CHECK( optixUtilComputeAccelCacheKey( buildOptions, &moved, 1, 1 ) != transformed );
+
+    // Corruption: a damaged data section opens but fails verification and turns its key into a miss when checksums
+    // are checked on load, a damaged index or a truncated file does not open.
+    AlignedImage image;
+    OPTIX_UTIL_CHECK( image.read( path ) );
+    {
+        OptixUtilAccelCache cache;
+        OPTIX_UTIL_CHECK_SUCCESS( cache.openMemory( image.data, image.size ) );
+        const uint64_t dataOffset  = cache.find( keys[1] )->data.offset;
+        const uint64_t indexOffset = cache.header().indexOffset;
+        cache.close();
+
+        image.data[dataOffset + 100] ^= 1;
+        OPTIX_UTIL_CHECK_SUCCESS( cache.openMemory( image.data, image.size ) );
+        OPTIX_UTIL_CHECK( optixUtilVerifyAccelCache( cache ) == OPTIX_ERROR_DISK_CACHE_INVALID_DATA );
+        OptixUtilAccelCacheLoadOptions loadOptions = {0, 1};
+        OptixUtilCompactedGasBatch     loaded;
+        std::vector<unsigned int>      misses;
+        OptixUtilAccelCacheLoadReport  report;
+        OPTIX_UTIL_CHECK_SUCCESS( optixUtilLoadCachedGas( api, context, nullptr, cache, keys, n, pool,
+                                                          optixUtilHostUpload(), loadOptions, loaded, misses,
+                                                          &report ) );
+        OPTIX_UTIL_CHECK( report.numCorrupt == 1 && report.numHits == n - 1 );
+        OPTIX_UTIL_CHECK( misses == std::vector<unsigned int>( 1, 1 ) && loaded.handles[1] == 0 );
+        OPTIX_UTIL_CHECK_SUCCESS( optixUtilReleaseCompactedGasBatch( pool, loaded ) );
+        image.data[dataOffset + 100] ^= 1;
+
+        image.data[indexOffset + 8] ^= 1;
+        OPTIX_UTIL_CHECK( cache.openMemory( image.data, image.size ) == OPTIX_ERROR_INVALID_FILE_FORMAT );
+        image.data[indexOffset + 8] ^= 1;
+
+        OPTIX_UTIL_CHECK( cache.openMemory( image.data, image.size - 64 ) == OPTIX_ERROR_INVALID_FILE_FORMAT );
+        OPTIX_UTIL_CHECK( cache.openMemory( image.data + 8, image.size ) == OPTIX_ERROR_INVALID_VALUE );
+        OPTIX_UTIL_CHECK( cache.open( "missing_accel_cache.bin" ) == OPTIX_ERROR_FILE_IO_ERROR );
+        OPTIX_UTIL_CHECK( !cache.isOpen() && cache.numAccels() == 0 );
+    }
+    std::remove( path );
+
+    OPTIX_UTIL_CHECK_SUCCESS( optixUtilReleaseCompactedGasBatch( pool, built ) );
+    OPTIX_UTIL_CHECK( pool.freeBytes() == pool.allocatedBytes() );
+
+    return optix_util_test::finish();
+}
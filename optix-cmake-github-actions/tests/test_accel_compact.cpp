@@ -0,0 +1,112 @@
+#include "optix_util_test.h"
+
+#include <optix_util_accel_compact.h>
+
+#include <vector>
+
+using optix_util_test::isAccelImage;
+
+/// Host readback that counts its calls and fails on request.
+struct CountingReadback
+{
+    size_t numReads = 0;
+    bool   fail     = false;
+
+    static OptixResult read( void* userData, CUstream stream, CUdeviceptr src, size_t sizeInBytes, void* dst )
+    {
+        CountingReadback& self = *(CountingReadback*)userData;
+        ++self.numReads;
+        return self.fail ? OPTIX_ERROR_CUDA_ERROR : optix_util_impl::hostRead( nullptr, stream, src, sizeInBytes, dst );
+    }
+
+    OptixUtilDeviceReadback readback() { return {read, this}; }
+};
+
+int main()
+{
+    // 50 meshes of 1 to 2451 triangles. Each uncompacted output takes 1 KiB plus 64 bytes per triangle.
+    const unsigned int                      n            = 50;
+    OptixAccelBuildOptions                  buildOptions = {};
+    std::vector<OptixBuildInput>            inputs( n );
+    std::vector<OptixUtilAccelBuildRequest> requests( n );
+    buildOptions.buildFlags = OPTIX_BUILD_FLAG_PREFER_FAST_TRACE;
+    buildOptions.operation  = OPTIX_BUILD_OPERATION_BUILD;
+    for( unsigned int i = 0; i < n; ++i )
+    {
+        inputs[i]                                = OptixBuildInput();
+        inputs[i].type                           = OPTIX_BUILD_INPUT_TYPE_TRIANGLES;
+        inputs[i].triangleArray.indexFormat      = OPTIX_INDICES_FORMAT_UNSIGNED_INT3;
+        inputs[i].triangleArray.numIndexTriplets = 1 + i * i;
+        requests[i]                              = {&buildOptions, &inputs[i], 1};
+    }
+
+    // Chunks of at most 1 MiB of uncompacted output, each with one readback. Every build gets its own compacted
+    // image in 128-byte aligned memory, and the uncompacted arenas go back to the pool.
+    const OptixFunctionTable   api      = optix_util_test::stubFunctionTable();
+    OptixUtilAccelMemoryPool   pool( optixUtilHostAllocator() );
+    CountingReadback           counting;
+    OptixUtilGasBatchOptions   options  = {1u << 20, 256 * 1024};
+    OptixUtilCompactedGasBatch batch;
+    OptixUtilGasBatchReport    report;
+    OPTIX_UTIL_CHECK_SUCCESS( optixUtilBuildCompactedGas( api, nullptr, nullptr, requests.data(), n, pool,
+                                                          counting.readback(), options, batch, &report ) );
+    size_t uncompacted = 0, compacted = 0;
+    bool   valid       = batch.handles.size() == n;
+    for( unsigned int i = 0; i < n && valid; ++i )
+    {
+        const uint64_t triangles = 1 + i * i;
+        uncompacted += 1024 + 64 * triangles;
+        compacted += 1024 + 32 * triangles;
+        valid = valid && batch.handles[i] == batch.buffers[i] && batch.sizes[i] == 1024 + 32 * triangles;
+        valid = valid && batch.buffers[i] % OPTIX_ACCEL_BUFFER_BYTE_ALIGNMENT == 0;
+        valid = valid && isAccelImage( batch.buffers[i], triangles );
+    }
+    OPTIX_UTIL_CHECK( valid );
+    OPTIX_UTIL_CHECK( report.numBuilds == n && report.numChunks > 1 && counting.numReads == report.numChunks );
+    OPTIX_UTIL_CHECK( report.uncompactedBytes == uncompacted && report.compactedBytes == compacted );
+    OPTIX_UTIL_CHECK( report.compactedArenaBytes >= compacted && report.compactedArenaBytes < compacted + n * 128 );
+    OPTIX_UTIL_CHECK( batch.memory.size() == report.numChunks );
+    OPTIX_UTIL_CHECK( pool.allocatedBytes() - pool.freeBytes() < report.compactedArenaBytes + 64 * 1024 * n );
+
+    // Rebuilding the batch after releasing it reuses the pooled blocks.
+    OPTIX_UTIL_CHECK_SUCCESS( optixUtilReleaseCompactedGasBatch( pool, batch ) );
+    OPTIX_UTIL_CHECK( batch.handles.empty() && pool.freeBytes() == pool.allocatedBytes() );
+    const size_t allocations = pool.numAllocations();
+    OPTIX_UTIL_CHECK_SUCCESS( optixUtilBuildCompactedGas( api, nullptr, nullptr, requests.data(), n, pool,
+                                                          counting.readback(), options, batch ) );
+    OPTIX_UTIL_CHECK( pool.numAllocations() == allocations );
+    OPTIX_UTIL_CHECK_SUCCESS( optixUtilReleaseCompactedGasBatch( pool, batch ) );
+
+    // Without a chunk bound the batch is one chunk, and a build larger than the bound forms a chunk of its own.
+    counting.numReads = 0;
+    options           = {0, 0};
+    OPTIX_UTIL_CHECK_SUCCESS( optixUtilBuildCompactedGas( api, nullptr, nullptr, requests.data(), n, pool,
+                                                          counting.readback(), options, batch, &report ) );
+    OPTIX_UTIL_CHECK( report.numChunks == 1 && counting.numReads == 1 && batch.memory.size() == 1 );
+    OPTIX_UTIL_CHECK_SUCCESS( optixUtilReleaseCompactedGasBatch( pool, batch ) );
+    options = {2048, 0};
+    OPTIX_UTIL_CHECK_SUCCESS( optixUtilBuildCompactedGas( api, nullptr, nullptr, requests.data(), 3, pool,
+                                                          counting.readback(), options, batch, &report ) );
+    OPTIX_UTIL_CHECK( report.numChunks == 3 && isAccelImage( batch.buffers[2], 5 ) );
+    OPTIX_UTIL_CHECK_SUCCESS( optixUtilReleaseCompactedGasBatch( pool, batch ) );
+
+    // Edge cases: a failed readback returns all memory to the pool and leaves an empty batch, updates are rejected.
+    counting.fail = true;
+    OPTIX_UTIL_CHECK( optixUtilBuildCompactedGas( api, nullptr, nullptr, requests.data(), n, pool, counting.readback(),
+                                                  options, batch )
+                      == OPTIX_ERROR_CUDA_ERROR );
+    OPTIX_UTIL_CHECK( batch.handles.empty() && batch.memory.empty() && pool.freeBytes() == pool.allocatedBytes() );
+    counting.fail = false;
+
+    OptixAccelBuildOptions update = buildOptions;
+    update.operation              = OPTIX_BUILD_OPERATION_UPDATE;
+    requests[7].options           = &update;
+    OPTIX_UTIL_CHECK( optixUtilBuildCompactedGas( api, nullptr, nullptr, requests.data(), n, pool, counting.readback(),
+                                                  options, batch )
+                      == OPTIX_ERROR_INVALID_VALUE );
+    OPTIX_UTIL_CHECK_SUCCESS( optixUtilBuildCompactedGas( api, nullptr, nullptr, nullptr, 0, pool, counting.readback(),
+                                                          options, batch, &report ) );
+    OPTIX_UTIL_CHECK( batch.handles.empty() && report.numChunks == 0 );
+
+    return optix_util_test::finish();
+}
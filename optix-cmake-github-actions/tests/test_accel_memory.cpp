@@ -0,0 +1,161 @@
+#include "optix_util_test.h"
+
+#include <optix_util_accel_memory.h>
+
+#include <vector>
+
+/// Host allocator that counts its calls and can fail or return misaligned blocks on request.
+struct CountingAllocator
+{
+    size_t numAllocations = 0;
+    size_t numFrees       = 0;
+    size_t failAfter      = ~(size_t)0;
+    bool   misalign       = false;
+
+    static OptixResult allocate( void* userData, size_t sizeInBytes, CUdeviceptr* ptr )
+    {
+        CountingAllocator& self = *(CountingAllocator*)userData;
+        if( self.numAllocations == self.failAfter )
+            return OPTIX_ERROR_HOST_OUT_OF_MEMORY;
+        ++self.numAllocations;
+        const OptixResult result = optix_util_impl::hostAllocate( nullptr, sizeInBytes + 64, ptr );
+        if( self.misalign )
+            *ptr += 64;
+        return result;
+    }
+
+    static void free( void* userData, CUdeviceptr ptr )
+    {
+        CountingAllocator& self = *(CountingAllocator*)userData;
+        ++self.numFrees;
+        optix_util_impl::hostFree( nullptr, self.misalign ? ptr - 64 : ptr );
+    }
+
+    OptixUtilDeviceAllocator allocator() { return {allocate, free, this}; }
+};
+
+int main()
+{
+    // Known answer: 3 builds of 10, 20 and 2000 triangles. With 64 KiB arenas, the first two share an arena at
+    // 128-byte aligned offsets and the third gets one of its own.
+    OptixFunctionTable         api          = optix_util_test::stubFunctionTable();
+    OptixAccelBuildOptions     buildOptions = {};
+    OptixBuildInput            inputs[3]    = {};
+    const unsigned int         triangles[3] = {10, 20, 2000};
+    OptixUtilAccelBuildRequest requests[3];
+    for( int i = 0; i < 3; ++i )
+    {
+        inputs[i].type                           = OPTIX_BUILD_INPUT_TYPE_TRIANGLES;
+        inputs[i].triangleArray.indexFormat      = OPTIX_INDICES_FORMAT_UNSIGNED_INT3;
+        inputs[i].triangleArray.numIndexTriplets = triangles[i];
+        requests[i]                              = {&buildOptions, &inputs[i], 1};
+    }
+    OptixAccelBufferSizes sizes[3];
+    OPTIX_UTIL_CHECK_SUCCESS( optixUtilComputeAccelBufferSizes( api, nullptr, requests, 3, sizes ) );
+    OPTIX_UTIL_CHECK( sizes[0].outputSizeInBytes == 1024 + 640 && sizes[2].tempSizeInBytes == ( 1024 + 128000 ) / 2 );
+
+    OptixUtilAccelMemoryOptions options = {64 * 1024, 2, 0};
+    OptixUtilAccelMemoryPlan    plan;
+    OPTIX_UTIL_CHECK_SUCCESS( optixUtilPlanAccelMemory( sizes, 3, options, plan ) );
+    OPTIX_UTIL_CHECK( plan.arenaSizes.size() == 2 && plan.arenaSizes[0] == 1664 + 2304 );
+    OPTIX_UTIL_CHECK( plan.placements[0].outputArena == 0 && plan.placements[0].outputOffset == 0 );
+    OPTIX_UTIL_CHECK( plan.placements[1].outputArena == 0 && plan.placements[1].outputOffset == 1664 );
+    OPTIX_UTIL_CHECK( plan.placements[2].outputArena == 1 && plan.placements[2].outputOffset == 0 );
+    OPTIX_UTIL_CHECK( plan.placements[2].tempSlot == 0 && plan.placements[1].tempSlot == 1 );
+    OPTIX_UTIL_CHECK( plan.tempSlotSizeInBytes == 64512 && plan.numTempSlots == 2 );
+    OPTIX_UTIL_CHECK( plan.outputBytes == 1664 + 2304 + 129024 );
+
+    // Update temp memory counts only on request.
+    OptixAccelBufferSizes updateHeavy = sizes[0];
+    updateHeavy.tempUpdateSizeInBytes = 10000;
+    options.includeUpdateTemp         = 1;
+    OptixUtilAccelMemoryPlan updatePlan;
+    OPTIX_UTIL_CHECK_SUCCESS( optixUtilPlanAccelMemory( &updateHeavy, 1, options, updatePlan ) );
+    OPTIX_UTIL_CHECK( updatePlan.placements[0].tempSizeInBytes == 10000 && updatePlan.tempSlotSizeInBytes == 10112 );
+    options.includeUpdateTemp = 0;
+
+    // Every buffer handed to a build is aligned to OPTIX_ACCEL_BUFFER_BYTE_ALIGNMENT, and temp slots do not overlap.
+    CountingAllocator counting;
+    {
+        OptixUtilAccelMemoryPool pool( counting.allocator() );
+        OptixUtilAccelMemory     memory;
+        OPTIX_UTIL_CHECK_SUCCESS( optixUtilAcquireAccelMemory( pool, plan, memory ) );
+        OPTIX_UTIL_CHECK( counting.numAllocations == 3 && pool.numAllocations() == 3 );
+        bool                       aligned = true;
+        OptixUtilAccelBuildBuffers buffers[3] = {};
+        for( unsigned int i = 0; i < 3; ++i )
+        {
+            OPTIX_UTIL_CHECK_SUCCESS( optixUtilGetAccelBuildBuffers( plan, memory, i, buffers[i] ) );
+            aligned = aligned && buffers[i].outputBuffer % OPTIX_ACCEL_BUFFER_BYTE_ALIGNMENT == 0
+                      && buffers[i].tempBuffer % OPTIX_ACCEL_BUFFER_BYTE_ALIGNMENT == 0;
+        }
+        OPTIX_UTIL_CHECK( aligned && OPTIX_ACCEL_BUFFER_BYTE_ALIGNMENT == 128 );
+        OPTIX_UTIL_CHECK( buffers[1].outputBuffer == buffers[0].outputBuffer + 1664 );
+        OPTIX_UTIL_CHECK( buffers[1].tempBuffer == buffers[0].tempBuffer + plan.tempSlotSizeInBytes );
+        OPTIX_UTIL_CHECK( buffers[2].tempBuffer == buffers[0].tempBuffer );
+        OPTIX_UTIL_CHECK( optixUtilGetAccelBuildBuffers( plan, memory, 3, buffers[0] ) == OPTIX_ERROR_INVALID_VALUE );
+
+        // Releasing the temp slots early makes them unavailable to the builds.
+        OPTIX_UTIL_CHECK_SUCCESS( optixUtilReleaseAccelTemp( pool, memory ) );
+        OPTIX_UTIL_CHECK( optixUtilGetAccelBuildBuffers( plan, memory, 0, buffers[0] ) == OPTIX_ERROR_INVALID_VALUE );
+
+        // Pool reuse: a second batch of the same plan takes the released blocks without calling the allocator.
+        OPTIX_UTIL_CHECK_SUCCESS( optixUtilReleaseAccelMemory( pool, memory ) );
+        OPTIX_UTIL_CHECK( pool.freeBytes() == pool.allocatedBytes() && pool.freeBytes() > 0 );
+        for( int batch = 0; batch < 10; ++batch )
+        {
+            OPTIX_UTIL_CHECK_SUCCESS( optixUtilAcquireAccelMemory( pool, plan, memory ) );
+            OPTIX_UTIL_CHECK_SUCCESS( optixUtilReleaseAccelMemory( pool, memory ) );
+        }
+        OPTIX_UTIL_CHECK( pool.numAllocations() == 3 && counting.numAllocations == 3 );
+
+        pool.trim();
+        OPTIX_UTIL_CHECK( pool.freeBytes() == 0 && pool.allocatedBytes() == 0 && counting.numFrees == 3 );
+    }
+
+    // Blocks are rounded to 64 KiB, and a free block is reused for requests of at least half its size.
+    CountingAllocator sized;
+    {
+        OptixUtilAccelMemoryPool pool( sized.allocator() );
+        CUdeviceptr              large = 0, reused = 0, small = 0, other = 0;
+        OPTIX_UTIL_CHECK_SUCCESS( pool.acquire( 1u << 20, &large ) );
+        OPTIX_UTIL_CHECK_SUCCESS( pool.release( large ) );
+        OPTIX_UTIL_CHECK_SUCCESS( pool.acquire( 600 * 1024, &reused ) );
+        OPTIX_UTIL_CHECK( reused == large && pool.numAllocations() == 1 );
+        OPTIX_UTIL_CHECK_SUCCESS( pool.release( reused ) );
+        OPTIX_UTIL_CHECK_SUCCESS( pool.acquire( 100, &small ) );
+        OPTIX_UTIL_CHECK( small != large && pool.numAllocations() == 2 );
+        OPTIX_UTIL_CHECK( pool.allocatedBytes() == ( 1u << 20 ) + 64 * 1024 && pool.freeBytes() == 1u << 20 );
+
+        // Edge cases: unknown and repeated releases are rejected, trim frees only unused blocks.
+        OPTIX_UTIL_CHECK( pool.release( small + 128 ) == OPTIX_ERROR_INVALID_VALUE );
+        OPTIX_UTIL_CHECK( pool.release( large ) == OPTIX_ERROR_INVALID_VALUE );
+        OPTIX_UTIL_CHECK( pool.acquire( 100, nullptr ) == OPTIX_ERROR_INVALID_VALUE );
+        pool.trim();
+        OPTIX_UTIL_CHECK( pool.allocatedBytes() == 64 * 1024 && sized.numFrees == 1 );
+        OPTIX_UTIL_CHECK_SUCCESS( pool.acquire( 100, &other ) );
+        OPTIX_UTIL_CHECK( other != small && sized.numAllocations == 3 );
+        OPTIX_UTIL_CHECK_SUCCESS( pool.release( other ) );
+    }
+    // The destructor frees blocks in use and free blocks.
+    OPTIX_UTIL_CHECK( sized.numFrees == 3 );
+
+    // A failed allocation releases the arenas acquired so far, a misaligned allocation is rejected and freed.
+    {
+        CountingAllocator failing;
+        failing.failAfter = 1;
+        OptixUtilAccelMemoryPool pool( failing.allocator() );
+        OptixUtilAccelMemory     memory;
+        OPTIX_UTIL_CHECK( optixUtilAcquireAccelMemory( pool, plan, memory ) == OPTIX_ERROR_HOST_OUT_OF_MEMORY );
+        OPTIX_UTIL_CHECK( memory.arenas.empty() && pool.freeBytes() == pool.allocatedBytes() );
+
+        CountingAllocator misaligned;
+        misaligned.misalign = true;
+        OptixUtilAccelMemoryPool misalignedPool( misaligned.allocator() );
+        CUdeviceptr              ptr = 1;
+        OPTIX_UTIL_CHECK( misalignedPool.acquire( 100, &ptr ) == OPTIX_ERROR_INVALID_VALUE );
+        OPTIX_UTIL_CHECK( ptr == 0 && misaligned.numFrees == 1 && misalignedPool.allocatedBytes() == 0 );
+    }
+
+    return optix_util_test::finish();
+}
@@ -0,0 +1,182 @@
+#include "optix_util_test.h"
+
+#include <optix_util_curve_prep.h>
+
+#include <cmath>
+#include <vector>
+
+/// Curves with tightly packed buffers.
+static OptixUtilCurveInput curveInput( OptixPrimitiveType               type,
+                                       const std::vector<float>&        vertices,
+                                       const std::vector<float>&        widths,
+                                       const std::vector<unsigned int>& indices )
+{
+    return {type, (unsigned int)indices.size(), vertices.data(), (unsigned int)widths.size(), 0, widths.data(), 0,
+            indices.data(), 0};
+}
+
+int main()
+{
+    using optix_util_impl::CurvePoint;
+    using optix_util_impl::evaluateCubicBspline;
+
+    OptixUtilCurvePrepOptions options = {};
+    OptixUtilPreparedCurves   prepared;
+    OptixUtilCurvePrepReport  report;
+
+    // Known answer: a strand of three linear segments with lengths 4, 0.5 and 0.5. Only the first is split, into four
+    // pieces with their own control points, while the two short segments keep sharing theirs.
+    std::vector<float>        vertices = {0.f, 0.f, 0.f, 4.f, 0.f, 0.f, 4.5f, 0.f, 0.f, 5.f, 0.f, 0.f};
+    std::vector<float>        widths   = {1.f, 1.f, 1.f, 1.f};
+    std::vector<unsigned int> indices  = {0, 1, 2};
+    OptixUtilCurveInput       curves   = curveInput( OPTIX_PRIMITIVE_TYPE_ROUND_LINEAR, vertices, widths, indices );
+    options.maxSegmentLength           = 1.f;
+    OPTIX_UTIL_CHECK_SUCCESS( optixUtilPrepareCurves( curves, options, prepared, &report ) );
+    OPTIX_UTIL_CHECK( prepared.curveType == OPTIX_PRIMITIVE_TYPE_ROUND_LINEAR );
+    OPTIX_UTIL_CHECK( prepared.widths.size() == 8 && prepared.vertices.size() == 24 );
+    OPTIX_UTIL_CHECK( prepared.vertices[3] == 1.f && prepared.vertices[12] == 4.f && prepared.vertices[15] == 4.f );
+    OPTIX_UTIL_CHECK( prepared.indices == std::vector<unsigned int>( {0, 1, 2, 3, 5, 6} ) );
+    OPTIX_UTIL_CHECK( prepared.segmentIds == std::vector<unsigned int>( {0, 0, 0, 0, 1, 2} ) );
+    OPTIX_UTIL_CHECK( report.numStrands == 1 && report.numSplitSegments == 1 && report.numOutputSegments == 6 );
+    OPTIX_UTIL_CHECK( report.numOutputVertices == 8 && report.maxConversionError == 0.f );
+
+    // Known answer: the spline through evenly spaced points on a line is the line, with mirrored end control points.
+    options            = {};
+    options.outputType = OPTIX_PRIMITIVE_TYPE_ROUND_CUBIC_BSPLINE;
+    vertices           = {0.f, 0.f, 0.f, 1.f, 0.f, 0.f, 2.f, 0.f, 0.f};
+    widths             = {1.f, 1.f, 1.f};
+    indices            = {0, 1};
+    curves             = curveInput( OPTIX_PRIMITIVE_TYPE_ROUND_LINEAR, vertices, widths, indices );
+    OPTIX_UTIL_CHECK_SUCCESS( optixUtilPrepareCurves( curves, options, prepared, &report ) );
+    OPTIX_UTIL_CHECK( prepared.curveType == OPTIX_PRIMITIVE_TYPE_ROUND_CUBIC_BSPLINE );
+    OPTIX_UTIL_CHECK( prepared.widths.size() == 5 && prepared.indices == std::vector<unsigned int>( {0, 1} ) );
+    bool mirrored = true;
+    for( int i = 0; i < 5; ++i )
+        mirrored = mirrored && std::fabs( prepared.vertices[i * 3] - ( i - 1.f ) ) < 1e-6f && prepared.widths[i] == 1.f;
+    OPTIX_UTIL_CHECK( mirrored && report.maxConversionError < 1e-6f );
+
+    // Known answer: a cubic B-spline segment of collinear, evenly spaced points is flat and becomes one line from its
+    // second to its third control point.
+    options.outputType = OPTIX_PRIMITIVE_TYPE_ROUND_LINEAR;
+    vertices           = {0.f, 0.f, 0.f, 1.f, 0.f, 0.f, 2.f, 0.f, 0.f, 3.f, 0.f, 0.f};
+    widths             = {1.f, 1.f, 1.f, 1.f};
+    indices            = {0};
+    curves             = curveInput( OPTIX_PRIMITIVE_TYPE_ROUND_CUBIC_BSPLINE, vertices, widths, indices );
+    OPTIX_UTIL_CHECK_SUCCESS( optixUtilPrepareCurves( curves, options, prepared, &report ) );
+    OPTIX_UTIL_CHECK( prepared.vertices == std::vector<float>( {1.f, 0.f, 0.f, 2.f, 0.f, 0.f} ) );
+    OPTIX_UTIL_CHECK( prepared.indices.size() == 1 && report.numSplitSegments == 0 );
+
+    // A curved cubic strand converted to lines: the line vertices lie on the curve, and the pieces are within the
+    // tolerance of their chords.
+    vertices.clear();
+    widths.clear();
+    for( int i = 0; i < 8; ++i )
+    {
+        vertices.insert( vertices.end(), {std::cos( 0.5f * i ), std::sin( 0.5f * i ), 0.1f * i} );
+        widths.push_back( 0.05f );
+    }
+    indices           = {0, 1, 2, 3, 4};
+    curves            = curveInput( OPTIX_PRIMITIVE_TYPE_ROUND_CUBIC_BSPLINE, vertices, widths, indices );
+    options.tolerance = 0.001f;
+    OPTIX_UTIL_CHECK_SUCCESS( optixUtilPrepareCurves( curves, options, prepared, &report ) );
+    OPTIX_UTIL_CHECK( report.numSplitSegments == 5 && report.maxConversionError <= options.tolerance );
+    OPTIX_UTIL_CHECK( prepared.indices.size() > 5 && prepared.segmentIds.back() == 4 );
+    bool onCurve = true;
+    for( size_t v = 0; v < prepared.widths.size(); ++v )
+    {
+        const float* p       = &prepared.vertices[v * 3];
+        float        nearest = INFINITY;
+        for( unsigned int s = 0; s < 5; ++s )
+        {
+            CurvePoint control[4];
+            for( int i = 0; i < 4; ++i )
+                control[i] = {vertices[( s + i ) * 3], vertices[( s + i ) * 3 + 1], vertices[( s + i ) * 3 + 2], 0.05f};
+            for( int k = 0; k <= 1024; ++k )
+            {
+                const CurvePoint c = evaluateCubicBspline( control, k / 1024.f );
+                const float      d = std::sqrt( ( c.x - p[0] ) * ( c.x - p[0] ) + ( c.y - p[1] ) * ( c.y - p[1] )
+                                           + ( c.z - p[2] ) * ( c.z - p[2] ) );
+                nearest = std::min( nearest, d );
+            }
+        }
+        onCurve = onCurve && nearest < 1e-4f;
+    }
+    OPTIX_UTIL_CHECK( onCurve );
+
+    // 10000 strands of 7 cubic segments, enough for parallel processing. Any thread count gives the serial result, and
+    // splitting tightens the bounds.
+    const unsigned int numStrands = 10000;
+    vertices.clear();
+    widths.clear();
+    indices.clear();
+    for( unsigned int s = 0; s < numStrands; ++s )
+    {
+        for( unsigned int i = 0; i < 10; ++i )
+        {
+            vertices.insert( vertices.end(), {0.1f * i, std::sin( 0.7f * ( s + i ) ), std::cos( 1.3f * ( s + i ) )} );
+            widths.push_back( 0.05f + 0.01f * ( ( s + i ) % 5 ) );
+        }
+        for( unsigned int i = 0; i < 7; ++i )
+            indices.push_back( s * 10 + i );
+    }
+    curves                    = curveInput( OPTIX_PRIMITIVE_TYPE_ROUND_CUBIC_BSPLINE, vertices, widths, indices );
+    options                   = {};
+    options.maxSegmentLength  = 0.5f;
+    options.maxFlatness       = 0.05f;
+    options.maxWidthVariation = 0.2f;
+    OptixUtilPreparedCurves  parallel;
+    OptixUtilCurvePrepReport parallelReport;
+    OPTIX_UTIL_CHECK_SUCCESS( optixUtilPrepareCurves( curves, options, prepared, &report, 1 ) );
+    OPTIX_UTIL_CHECK_SUCCESS( optixUtilPrepareCurves( curves, options, parallel, &parallelReport, 4 ) );
+    OPTIX_UTIL_CHECK( prepared.vertices == parallel.vertices && prepared.widths == parallel.widths );
+    OPTIX_UTIL_CHECK( prepared.indices == parallel.indices && prepared.segmentIds == parallel.segmentIds );
+    OPTIX_UTIL_CHECK( report.numOutputSegments == parallelReport.numOutputSegments
+                      && report.numSplitSegments == parallelReport.numSplitSegments
+                      && report.outputBoundVolume == parallelReport.outputBoundVolume );
+    OPTIX_UTIL_CHECK( report.numStrands == numStrands && report.numInputSegments == 7 * numStrands );
+    OPTIX_UTIL_CHECK( report.numSplitSegments > 0 && report.numOutputSegments > report.numInputSegments );
+    OPTIX_UTIL_CHECK( report.outputBoundVolume < report.inputBoundVolume );
+
+    // Edge cases: unsupported types and conversions, indices past the vertices, missing buffers, short strides and bad
+    // options are rejected. Empty curves succeed.
+    curves             = curveInput( OPTIX_PRIMITIVE_TYPE_ROUND_CUBIC_BSPLINE, vertices, widths, indices );
+    options            = {};
+    options.outputType = OPTIX_PRIMITIVE_TYPE_ROUND_QUADRATIC_BSPLINE;
+    OPTIX_UTIL_CHECK( optixUtilPrepareCurves( curves, options, prepared ) == OPTIX_ERROR_INVALID_VALUE );
+    options.outputType = OPTIX_PRIMITIVE_TYPE_TRIANGLE;
+    OPTIX_UTIL_CHECK( optixUtilPrepareCurves( curves, options, prepared ) == OPTIX_ERROR_INVALID_VALUE );
+    options          = {};
+    curves.curveType = OPTIX_PRIMITIVE_TYPE_TRIANGLE;
+    OPTIX_UTIL_CHECK( optixUtilPrepareCurves( curves, options, prepared ) == OPTIX_ERROR_INVALID_VALUE );
+    curves             = curveInput( OPTIX_PRIMITIVE_TYPE_ROUND_CUBIC_BSPLINE, vertices, widths, indices );
+    curves.numVertices = 9;
+    OPTIX_UTIL_CHECK( optixUtilPrepareCurves( curves, options, prepared ) == OPTIX_ERROR_INVALID_VALUE );
+    curves        = curveInput( OPTIX_PRIMITIVE_TYPE_ROUND_CUBIC_BSPLINE, vertices, widths, indices );
+    curves.widths = nullptr;
+    OPTIX_UTIL_CHECK( optixUtilPrepareCurves( curves, options, prepared ) == OPTIX_ERROR_INVALID_VALUE );
+    curves                     = curveInput( OPTIX_PRIMITIVE_TYPE_ROUND_CUBIC_BSPLINE, vertices, widths, indices );
+    curves.vertexStrideInBytes = 8;
+    OPTIX_UTIL_CHECK( optixUtilPrepareCurves( curves, options, prepared ) == OPTIX_ERROR_INVALID_VALUE );
+    curves            = curveInput( OPTIX_PRIMITIVE_TYPE_ROUND_CUBIC_BSPLINE, vertices, widths, indices );
+    options.tolerance = -1.f;
+    OPTIX_UTIL_CHECK( optixUtilPrepareCurves( curves, options, prepared ) == OPTIX_ERROR_INVALID_VALUE );
+    options               = {};
+    options.maxSplitDepth = 11;
+    OPTIX_UTIL_CHECK( optixUtilPrepareCurves( curves, options, prepared ) == OPTIX_ERROR_INVALID_VALUE );
+    options = {};
+    curves  = {OPTIX_PRIMITIVE_TYPE_ROUND_LINEAR, 0, nullptr, 0, 0, nullptr, 0, nullptr, 0};
+    OPTIX_UTIL_CHECK_SUCCESS( optixUtilPrepareCurves( curves, options, prepared, &report ) );
+    OPTIX_UTIL_CHECK( prepared.indices.empty() && prepared.widths.empty() && report.numStrands == 0 );
+
+    // The build input references the prepared buffers, which must be 4 byte aligned.
+    OptixBuildInput buildInput;
+    OPTIX_UTIL_CHECK( optixUtilGetCurveBuildInput( parallel, 0x1002, 0x2000, 0x3000, 0, buildInput )
+                      == OPTIX_ERROR_INVALID_VALUE );
+    OPTIX_UTIL_CHECK_SUCCESS( optixUtilGetCurveBuildInput( parallel, 0x1000, 0x2000, 0x3000, 0, buildInput ) );
+    OPTIX_UTIL_CHECK( buildInput.type == OPTIX_BUILD_INPUT_TYPE_CURVES );
+    OPTIX_UTIL_CHECK( buildInput.curveArray.numPrimitives == parallel.indices.size() );
+    OPTIX_UTIL_CHECK( *buildInput.curveArray.vertexBuffers == 0x1000 && *buildInput.curveArray.widthBuffers == 0x2000 );
+    OPTIX_UTIL_CHECK( buildInput.curveArray.indexBuffer == 0x3000 && buildInput.curveArray.vertexStrideInBytes == 12 );
+
+    return optix_util_test::finish();
+}
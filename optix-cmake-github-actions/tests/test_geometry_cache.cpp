@@ -0,0 +1,246 @@
+#include "optix_util_test.h"
+
+#include <optix_util_geometry_cache.h>
+
+#include <cstdio>
+#include <cstring>
+#include <vector>
+
+/// File image in a buffer aligned to OPTIX_UTIL_GEOMETRY_CACHE_ALIGNMENT, for openMemory().
+struct AlignedImage
+{
+    std::vector<unsigned char> storage;
+    unsigned char*             data;
+
+    explicit AlignedImage( size_t size )
+        : storage( size + OPTIX_UTIL_GEOMETRY_CACHE_ALIGNMENT )
+    {
+        const uintptr_t address = (uintptr_t)storage.data();
+        data = storage.data() + ( OPTIX_UTIL_GEOMETRY_CACHE_ALIGNMENT - address % OPTIX_UTIL_GEOMETRY_CACHE_ALIGNMENT )
+                                    % OPTIX_UTIL_GEOMETRY_CACHE_ALIGNMENT;
+    }
+};
+
+/// Contents of the file at path, empty if it cannot be read.
+static std::vector<unsigned char> readFile( const char* path )
+{
+    std::vector<unsigned char> contents;
+    FILE*                      file = std::fopen( path, "rb" );
+    if( !file )
+        return contents;
+    unsigned char buffer[4096];
+    for( size_t n; ( n = std::fread( buffer, 1, sizeof( buffer ), file ) ) > 0; )
+        contents.insert( contents.end(), buffer, buffer + n );
+    std::fclose( file );
+    return contents;
+}
+
+int main()
+{
+    using optix_util_impl::alignCacheOffset;
+
+    // Triangles with 2 motion keys and 2 SBT records, linear curves with widths, and AABBs with 2 motion keys.
+    const float         key0[15] = {0.f, 0.f, 0.f, 1.f, 0.f, 0.f, 1.f, 1.f, 0.f, 0.f, 1.f, 0.f, 2.f, 2.f, 2.f};
+    const float         key1[15] = {0.f, 0.f, 1.f, 1.f, 0.f, 1.f, 1.f, 1.f, 1.f, 0.f, 1.f, 1.f, 2.f, 2.f, 3.f};
+    const void*         triangleKeys[2]    = {key0, key1};
+    const unsigned int  triangleIndices[9] = {0, 1, 2, 0, 2, 3, 2, 4, 3};
+    const unsigned char sbtIndexOffsets[3] = {0, 1, 1};
+    const unsigned int  triangleFlags[2]   = {OPTIX_GEOMETRY_FLAG_NONE, OPTIX_GEOMETRY_FLAG_DISABLE_ANYHIT};
+
+    const float        curvePoints[12]  = {0.f, 0.f, 0.f, 0.f, 1.f, 0.f, 0.f, 2.f, 0.f, 0.f, 3.f, 0.f};
+    const float        curveWidths[4]   = {0.1f, 0.2f, 0.3f, 0.4f};
+    const void*        curveKeys[1]     = {curvePoints};
+    const void*        widthKeys[1]     = {curveWidths};
+    const unsigned int curveSegments[3] = {0, 1, 2};
+    const unsigned int curveFlags[1]    = {OPTIX_GEOMETRY_FLAG_NONE};
+
+    const OptixAabb    boxes0[3]   = {{0, 0, 0, 1, 1, 1}, {1, 1, 1, 2, 2, 2}, {-1, -1, -1, 0, 0, 0}};
+    const OptixAabb    boxes1[3]   = {{0, 0, 1, 1, 1, 2}, {1, 1, 2, 2, 2, 3}, {-1, -1, 0, 0, 0, 1}};
+    const void*        boxKeys[2]  = {boxes0, boxes1};
+    const unsigned int boxFlags[1] = {OPTIX_GEOMETRY_FLAG_REQUIRE_SINGLE_ANYHIT_CALL};
+
+    OptixUtilCachedGeometry triangles   = {};
+    triangles.type                      = OPTIX_BUILD_INPUT_TYPE_TRIANGLES;
+    triangles.numPrimitives             = 3;
+    triangles.numVertices               = 5;
+    triangles.numMotionKeys             = 2;
+    triangles.vertexFormat              = OPTIX_VERTEX_FORMAT_FLOAT3;
+    triangles.indexFormat               = OPTIX_INDICES_FORMAT_UNSIGNED_INT3;
+    triangles.numSbtRecords             = 2;
+    triangles.sbtIndexOffsetSizeInBytes = 1;
+    triangles.userData                  = 42;
+    OptixUtilCacheSource triangleSource = {triangleKeys, triangleIndices, sbtIndexOffsets, nullptr, nullptr,
+                                           triangleFlags};
+
+    OptixUtilCachedGeometry curves   = {};
+    curves.type                      = OPTIX_BUILD_INPUT_TYPE_CURVES;
+    curves.numPrimitives             = 3;
+    curves.numVertices               = 4;
+    curves.numMotionKeys             = 1;
+    curves.curveType                 = OPTIX_PRIMITIVE_TYPE_ROUND_LINEAR;
+    curves.numSbtRecords             = 1;
+    curves.primitiveIndexOffset      = 3;
+    OptixUtilCacheSource curveSource = {curveKeys, curveSegments, nullptr, widthKeys, nullptr, curveFlags};
+
+    OptixUtilCachedGeometry custom    = {};
+    custom.type                       = OPTIX_BUILD_INPUT_TYPE_CUSTOM_PRIMITIVES;
+    custom.numPrimitives              = 3;
+    custom.numMotionKeys              = 2;
+    custom.numSbtRecords              = 1;
+    OptixUtilCacheSource customSource = {nullptr, nullptr, nullptr, nullptr, boxKeys, boxFlags};
+
+    OptixUtilGeometryCacheWriter writer;
+    OPTIX_UTIL_CHECK( writer.addGeometry( triangles, triangleSource ) == 0 );
+    OPTIX_UTIL_CHECK( writer.addGeometry( curves, curveSource ) == 1 );
+    OPTIX_UTIL_CHECK( writer.addGeometry( custom, customSource ) == 2 );
+
+    // Edge case: descriptions without motion keys, curves with several SBT records and missing arrays are rejected.
+    OptixUtilCachedGeometry invalid = triangles;
+    invalid.numMotionKeys           = 0;
+    OPTIX_UTIL_CHECK( writer.addGeometry( invalid, triangleSource ) == ~0u );
+    invalid               = curves;
+    invalid.numSbtRecords = 2;
+    OPTIX_UTIL_CHECK( writer.addGeometry( invalid, curveSource ) == ~0u );
+    OptixUtilCacheSource missing = customSource;
+    missing.aabbs                = nullptr;
+    OPTIX_UTIL_CHECK( writer.addGeometry( custom, missing ) == ~0u );
+
+    // Round trip through a file: the mapped ranges hold the source arrays, each motion key block is aligned and the
+    // data checksums match.
+    const char* path = "test_geometry_cache.bin";
+    OPTIX_UTIL_CHECK_SUCCESS( writer.write( path ) );
+    {
+        OptixUtilGeometryCache cache;
+        OPTIX_UTIL_CHECK_SUCCESS( cache.open( path ) );
+        OPTIX_UTIL_CHECK( cache.numGeometries() == 3 && cache.geometry( 0 ).userData == 42 );
+        OPTIX_UTIL_CHECK_SUCCESS( optixUtilVerifyGeometryCache( cache ) );
+
+        // Known answer: the data region starts after the header and table, 5 float3 vertices take 60 bytes and the
+        // second key starts 64 bytes after the first.
+        const OptixUtilCachedGeometry& t           = cache.geometry( 0 );
+        const uint64_t                 tableOffset = alignCacheOffset( sizeof( OptixUtilGeometryCacheHeader ) );
+        const uint64_t                 tableSize   = 3 * sizeof( OptixUtilCachedGeometry );
+        OPTIX_UTIL_CHECK( cache.header().dataOffset == alignCacheOffset( tableOffset + tableSize ) );
+        OPTIX_UTIL_CHECK( t.vertices.offset == cache.header().dataOffset && t.vertices.size == 64 + 60 );
+        OPTIX_UTIL_CHECK( t.vertexStrideInBytes == 12 && t.indexStrideInBytes == 12 );
+        const unsigned char* vertices = (const unsigned char*)cache.data( t.vertices );
+        OPTIX_UTIL_CHECK( std::memcmp( vertices, key0, sizeof( key0 ) ) == 0 );
+        OPTIX_UTIL_CHECK( std::memcmp( vertices + 64, key1, sizeof( key1 ) ) == 0 );
+        OPTIX_UTIL_CHECK( std::memcmp( cache.data( t.indices ), triangleIndices, sizeof( triangleIndices ) ) == 0 );
+        OPTIX_UTIL_CHECK( std::memcmp( cache.data( t.sbtIndexOffsets ), sbtIndexOffsets, 3 ) == 0 );
+
+        const OptixUtilCachedGeometry& c = cache.geometry( 1 );
+        OPTIX_UTIL_CHECK( std::memcmp( cache.data( c.widths ), curveWidths, sizeof( curveWidths ) ) == 0 );
+        OPTIX_UTIL_CHECK( c.aabbs.size == 0 && cache.data( c.aabbs ) == nullptr );
+
+        const OptixUtilCachedGeometry& a     = cache.geometry( 2 );
+        const unsigned char*           boxes = (const unsigned char*)cache.data( a.aabbs );
+        OPTIX_UTIL_CHECK( a.aabbStrideInBytes == sizeof( OptixAabb ) && a.aabbs.size == 128 + sizeof( boxes1 ) );
+        OPTIX_UTIL_CHECK( std::memcmp( boxes + 128, boxes1, sizeof( boxes1 ) ) == 0 );
+
+        bool aligned = true;
+        for( unsigned int i = 0; i < cache.numGeometries(); ++i )
+        {
+            const OptixUtilCacheRange* ranges[6];
+            optix_util_impl::cacheRanges( cache.geometry( i ), ranges );
+            for( int r = 0; r < 6; ++r )
+                aligned = aligned && ranges[r]->offset % OPTIX_UTIL_GEOMETRY_CACHE_ALIGNMENT == 0;
+        }
+        OPTIX_UTIL_CHECK( aligned );
+
+        // Build inputs point into the device copy of the data region, geometry flags into the mapping.
+        const CUdeviceptr                dataBuffer = 0x100000;
+        OptixUtilCachedBuildInputStorage storage;
+        OptixBuildInput                  input;
+        OPTIX_UTIL_CHECK_SUCCESS( optixUtilGetCachedBuildInput( cache, 0, dataBuffer, storage, input ) );
+        const OptixBuildInputTriangleArray& ta = input.triangleArray;
+        OPTIX_UTIL_CHECK( input.type == OPTIX_BUILD_INPUT_TYPE_TRIANGLES && ta.vertexBuffers[0] == dataBuffer );
+        OPTIX_UTIL_CHECK( ta.vertexBuffers[1] == dataBuffer + 64 && ta.numVertices == 5 && ta.numIndexTriplets == 3 );
+        OPTIX_UTIL_CHECK( ta.indexBuffer == dataBuffer + ( t.indices.offset - cache.header().dataOffset ) );
+        OPTIX_UTIL_CHECK( ta.flags == cache.data( t.flags ) && ta.flags[1] == OPTIX_GEOMETRY_FLAG_DISABLE_ANYHIT );
+        OPTIX_UTIL_CHECK( ta.sbtIndexOffsetSizeInBytes == 1 && ta.numSbtRecords == 2 );
+
+        OPTIX_UTIL_CHECK_SUCCESS( optixUtilGetCachedBuildInput( cache, 1, dataBuffer, storage, input ) );
+        OPTIX_UTIL_CHECK( input.curveArray.numPrimitives == 3 && input.curveArray.primitiveIndexOffset == 3 );
+        OPTIX_UTIL_CHECK( input.curveArray.widthBuffers[0]
+                          == dataBuffer + ( c.widths.offset - cache.header().dataOffset ) );
+        OPTIX_UTIL_CHECK_SUCCESS( optixUtilGetCachedBuildInput( cache, 2, dataBuffer, storage, input ) );
+        const CUdeviceptr* aabbBuffers = input.customPrimitiveArray.aabbBuffers;
+        OPTIX_UTIL_CHECK( aabbBuffers[1] - aabbBuffers[0] == 128 );
+
+        OPTIX_UTIL_CHECK( optixUtilGetCachedBuildInput( cache, 3, dataBuffer, storage, input )
+                          == OPTIX_ERROR_INVALID_VALUE );
+        OPTIX_UTIL_CHECK( optixUtilGetCachedBuildInput( cache, 0, dataBuffer + 16, storage, input )
+                          == OPTIX_ERROR_INVALID_VALUE );
+    }
+    std::remove( path );
+
+    // The image does not depend on the thread count.
+    const size_t size = writer.computeLayout();
+    AlignedImage serial( size ), parallel( size );
+    writer.serialize( serial.data, 1 );
+    writer.serialize( parallel.data, 4 );
+    OPTIX_UTIL_CHECK( std::memcmp( serial.data, parallel.data, size ) == 0 );
+
+    // Streaming: the written file holds the serialized image, also for AABB keys that span several checksum chunks
+    // and write batches, and no temporary file is left behind.
+    {
+        std::vector<OptixAabb> largeBoxes0( 50000 ), largeBoxes1( 50000 );
+        for( size_t i = 0; i < largeBoxes0.size(); ++i )
+        {
+            const float x  = (float)i;
+            largeBoxes0[i] = {x, 0.f, 0.f, x + 1.f, 1.f, 1.f};
+            largeBoxes1[i] = {x, 1.f, 0.f, x + 1.f, 2.f, 1.f};
+        }
+        const void*             largeBoxKeys[2] = {largeBoxes0.data(), largeBoxes1.data()};
+        OptixUtilCachedGeometry large           = custom;
+        large.numPrimitives                     = (unsigned int)largeBoxes0.size();
+        OptixUtilCacheSource largeSource        = {nullptr, nullptr, nullptr, nullptr, largeBoxKeys, boxFlags};
+        OptixUtilGeometryCacheWriter streamed   = writer;
+        OPTIX_UTIL_CHECK( streamed.addGeometry( large, largeSource ) == 3 );
+
+        const size_t largeSize = streamed.computeLayout();
+        AlignedImage image( largeSize );
+        streamed.serialize( image.data );
+        OPTIX_UTIL_CHECK( largeSize > 2 * optix_util_impl::CACHE_CHECKSUM_CHUNK_SIZE );
+        const unsigned int threadCounts[2] = {1, 4};
+        for( unsigned int threads : threadCounts )
+        {
+            OPTIX_UTIL_CHECK_SUCCESS( streamed.write( path, threads ) );
+            const std::vector<unsigned char> contents = readFile( path );
+            OPTIX_UTIL_CHECK( contents.size() == largeSize
+                              && std::memcmp( contents.data(), image.data, largeSize ) == 0 );
+        }
+        OPTIX_UTIL_CHECK( readFile( optix_util_impl::cacheTempPath( path ).c_str() ).empty() );
+        std::remove( path );
+
+        // Edge cases: a missing directory or no path fail.
+        OPTIX_UTIL_CHECK( streamed.write( "missing_directory/test_geometry_cache.bin" ) == OPTIX_ERROR_FILE_IO_ERROR );
+        OPTIX_UTIL_CHECK( streamed.write( nullptr ) == OPTIX_ERROR_FILE_IO_ERROR );
+    }
+
+    // Corruption: damaged data opens but fails verification, a damaged table or a truncated file does not open.
+    {
+        OptixUtilGeometryCache cache;
+        OPTIX_UTIL_CHECK_SUCCESS( cache.openMemory( parallel.data, size ) );
+        const uint64_t dataOffset  = cache.header().dataOffset;
+        const uint64_t tableOffset = cache.header().geometryTableOffset;
+        cache.close();
+
+        parallel.data[dataOffset + 5] ^= 1;
+        OPTIX_UTIL_CHECK_SUCCESS( cache.openMemory( parallel.data, size ) );
+        OPTIX_UTIL_CHECK( optixUtilVerifyGeometryCache( cache ) == OPTIX_ERROR_DISK_CACHE_INVALID_DATA );
+        parallel.data[dataOffset + 5] ^= 1;
+
+        parallel.data[tableOffset + 4] ^= 1;
+        OPTIX_UTIL_CHECK( cache.openMemory( parallel.data, size ) == OPTIX_ERROR_INVALID_FILE_FORMAT );
+        parallel.data[tableOffset + 4] ^= 1;
+
+        OPTIX_UTIL_CHECK( cache.openMemory( parallel.data, size - 64 ) == OPTIX_ERROR_INVALID_FILE_FORMAT );
+        OPTIX_UTIL_CHECK( cache.openMemory( parallel.data + 8, size ) == OPTIX_ERROR_INVALID_VALUE );
+        OPTIX_UTIL_CHECK( cache.open( "missing_geometry_cache.bin" ) == OPTIX_ERROR_FILE_IO_ERROR );
+        OPTIX_UTIL_CHECK( !cache.isOpen() && optixUtilVerifyGeometryCache( cache ) != OPTIX_SUCCESS );
+    }
+
+    return optix_util_test::finish();
+}
@@ -0,0 +1,168 @@
+#include "optix_util_test.h"
+
+#include <optix_util_geometry_hash.h>
+
+#include <cmath>
+#include <vector>
+
+/// Host copy of a triangle mesh and its build input. The vertices are padded to vertexStride floats.
+struct Mesh
+{
+    std::vector<float>        vertices;
+    std::vector<unsigned int> indices;
+    CUdeviceptr               vertexBuffer = 0;
+    unsigned int              flags        = OPTIX_GEOMETRY_FLAG_NONE;
+    OptixBuildInput           input        = {};
+
+    Mesh( unsigned int numVertices, unsigned int vertexStride, float phase, float padding )
+        : vertices( numVertices * vertexStride, padding )
+        , indices( numVertices / 2 * 3 )
+    {
+        for( unsigned int v = 0; v < numVertices; ++v )
+        {
+            vertices[v * vertexStride]     = std::sin( 0.01f * v + phase );
+            vertices[v * vertexStride + 1] = std::cos( 0.03f * v );
+            vertices[v * vertexStride + 2] = 0.001f * v;
+        }
+        for( size_t i = 0; i < indices.size(); ++i )
+            indices[i] = (unsigned int)( i * 7 % numVertices );
+
+        vertexBuffer = (CUdeviceptr)(uintptr_t)vertices.data();
+        input.type   = OPTIX_BUILD_INPUT_TYPE_TRIANGLES;
+
+        OptixBuildInputTriangleArray& t = input.triangleArray;
+        t.vertexBuffers                 = &vertexBuffer;
+        t.numVertices                   = numVertices;
+        t.vertexFormat                  = OPTIX_VERTEX_FORMAT_FLOAT3;
+        t.vertexStrideInBytes           = vertexStride * sizeof( float );
+        t.indexBuffer                   = (CUdeviceptr)(uintptr_t)indices.data();
+        t.numIndexTriplets              = (unsigned int)indices.size() / 3;
+        t.indexFormat                   = OPTIX_INDICES_FORMAT_UNSIGNED_INT3;
+        t.flags                         = &flags;
+        t.numSbtRecords                 = 1;
+    }
+    Mesh( const Mesh& ) = delete;
+};
+
+int main()
+{
+    using optix_util_impl::GeometryHasher;
+
+    // Known answer: the streaming hash does not depend on how the data is split into updates, or on the instruction
+    // set, for lengths around the stripe and block sizes. Changing one byte changes it.
+    std::vector<unsigned char> bytes( 5000 );
+    for( size_t i = 0; i < bytes.size(); ++i )
+        bytes[i] = (unsigned char)( i * 131 + ( i >> 7 ) );
+    bool streaming = true, sensitive = true;
+    for( size_t size : {0, 1, 63, 64, 65, 1023, 1024, 1025, 3000, 5000} )
+    {
+        GeometryHasher whole( 7, OPTIX_UTIL_SIMD_ISA_SCALAR );
+        whole.update( bytes.data(), size );
+        const uint64_t digest = whole.digest();
+        for( int isa = OPTIX_UTIL_SIMD_ISA_SCALAR; isa <= OPTIX_UTIL_SIMD_ISA_AVX512; ++isa )
+        {
+            GeometryHasher pieces( 7, optixUtilSelectSimdIsa( (OptixUtilSimdIsa)isa ) );
+            for( size_t offset = 0, step = 1; offset < size; offset += step, step = step * 3 + 1 )
+                pieces.update( bytes.data() + offset, std::min( step, size - offset ) );
+            streaming = streaming && pieces.digest() == digest;
+        }
+        if( size )
+        {
+            bytes[size / 2] ^= 1;
+            GeometryHasher changed( 7, OPTIX_UTIL_SIMD_ISA_AVX2 );
+            changed.update( bytes.data(), size );
+            sensitive = sensitive && changed.digest() != digest;
+            bytes[size / 2] ^= 1;
+        }
+    }
+    OPTIX_UTIL_CHECK( streaming && sensitive );
+
+    // 8 builds of meshes with 200000 vertices, several hash chunks each. Separate copies of a mesh are duplicates,
+    // also with strided vertices that differ in their padding only. Other data or build flags keep builds separate.
+    const unsigned int n = 200000;
+    Mesh               a( n, 3, 0.f, 0.f ), b( n, 3, 1.f, 0.f ), copyOfA( n, 3, 0.f, 0.f ), copyOfB( n, 3, 1.f, 0.f );
+    Mesh               stridedA( n, 4, 0.f, 1.f ), paddedA( n, 4, 0.f, 2.f ), changedA( n, 3, 0.f, 0.f );
+    changedA.vertices[3 * n - 1] = 1.f;
+
+    OptixAccelBuildOptions options = {}, fastTrace = {};
+    fastTrace.buildFlags           = OPTIX_BUILD_FLAG_PREFER_FAST_TRACE;
+    const unsigned int               numBuilds           = 8;
+    const OptixUtilAccelBuildRequest requests[numBuilds] = {
+        {&options, &a.input, 1},        {&options, &b.input, 1},       {&options, &copyOfA.input, 1},
+        {&options, &stridedA.input, 1}, {&options, &paddedA.input, 1}, {&fastTrace, &a.input, 1},
+        {&options, &changedA.input, 1}, {&options, &copyOfB.input, 1}};
+    const OptixAccelBufferSizes      sizes[numBuilds]    = {{100, 10, 1}, {200, 20, 2}, {300, 30, 3}, {400, 40, 4},
+                                                            {500, 50, 5}, {600, 60, 6}, {700, 70, 7}, {800, 80, 8}};
+    OptixUtilGeometryHashOptions     hashOptions         = {1, 1e6};
+    unsigned int                     representatives[numBuilds];
+    uint64_t                         keys[numBuilds], serialKeys[numBuilds];
+    OptixUtilGeometryDedupReport     report;
+    OPTIX_UTIL_CHECK_SUCCESS( optixUtilDeduplicateGeometry( requests, numBuilds, hashOptions, representatives, keys,
+                                                            sizes, &report ) );
+    const unsigned int expected[numBuilds] = {0, 1, 0, 3, 3, 5, 6, 1};
+    OPTIX_UTIL_CHECK( std::memcmp( representatives, expected, sizeof( expected ) ) == 0 );
+    OPTIX_UTIL_CHECK( keys[0] == keys[2] && keys[3] == keys[4] && keys[1] == keys[7] );
+    OPTIX_UTIL_CHECK( keys[0] != keys[3] && keys[0] != keys[5] && keys[0] != keys[6] );
+    const size_t triangles = n / 2;
+    OPTIX_UTIL_CHECK( report.numBuilds == 8 && report.numUniqueBuilds == 5 && report.numCollisions == 0 );
+    OPTIX_UTIL_CHECK( report.numPrimitives == 8 * triangles && report.numPrimitivesSaved == 3 * triangles );
+    OPTIX_UTIL_CHECK( report.inputBytes == 8 * ( n * 12 + triangles * 12 ) );
+    OPTIX_UTIL_CHECK( report.inputBytesSaved == 3 * ( n * 12 + triangles * 12 ) );
+    OPTIX_UTIL_CHECK( report.outputBytesSaved == 300 + 500 + 800 && report.tempBytesSaved == 30 + 50 + 80 );
+    OPTIX_UTIL_CHECK( std::fabs( report.buildSecondsSaved - 0.3 ) < 1e-9 );
+
+    // The keys do not depend on the thread count or the instruction set, and without verification the same builds
+    // are merged.
+    hashOptions.verifyDuplicates = 0;
+    OPTIX_UTIL_CHECK_SUCCESS( optixUtilDeduplicateGeometry( requests, numBuilds, hashOptions, representatives,
+                                                            serialKeys, nullptr, nullptr, 1,
+                                                            OPTIX_UTIL_SIMD_ISA_SCALAR ) );
+    OPTIX_UTIL_CHECK( std::memcmp( keys, serialKeys, sizeof( keys ) ) == 0 );
+    OPTIX_UTIL_CHECK( std::memcmp( representatives, expected, sizeof( expected ) ) == 0 );
+    OPTIX_UTIL_CHECK_SUCCESS( optixUtilDeduplicateGeometry( requests, numBuilds, hashOptions, representatives,
+                                                            serialKeys, nullptr, nullptr, 4,
+                                                            OPTIX_UTIL_SIMD_ISA_AVX512 ) );
+    OPTIX_UTIL_CHECK( std::memcmp( keys, serialKeys, sizeof( keys ) ) == 0 );
+
+    // Custom primitives: AABB arrays are compared by content as well.
+    std::vector<OptixAabb> aabbs( 1000 ), otherAabbs( 1000 );
+    for( size_t i = 0; i < aabbs.size(); ++i )
+        aabbs[i] = otherAabbs[i] = {(float)i, 0.f, 0.f, i + 1.f, 1.f, 1.f};
+    const CUdeviceptr aabbBuffers[2] = {(CUdeviceptr)(uintptr_t)aabbs.data(),
+                                        (CUdeviceptr)(uintptr_t)otherAabbs.data()};
+    OptixBuildInput   custom[2]      = {};
+    for( int i = 0; i < 2; ++i )
+    {
+        custom[i].type                               = OPTIX_BUILD_INPUT_TYPE_CUSTOM_PRIMITIVES;
+        custom[i].customPrimitiveArray.aabbBuffers   = &aabbBuffers[i];
+        custom[i].customPrimitiveArray.numPrimitives = 1000;
+        custom[i].customPrimitiveArray.flags         = &a.flags;
+        custom[i].customPrimitiveArray.numSbtRecords = 1;
+    }
+    const OptixUtilAccelBuildRequest customRequests[2] = {{&options, &custom[0], 1}, {&options, &custom[1], 1}};
+    OPTIX_UTIL_CHECK_SUCCESS( optixUtilDeduplicateGeometry( customRequests, 2, hashOptions, representatives ) );
+    OPTIX_UTIL_CHECK( representatives[0] == 0 && representatives[1] == 0 );
+
+    // Edge cases: missing requests, options or vertex buffers and instance inputs are rejected. An empty batch
+    // succeeds.
+    OPTIX_UTIL_CHECK( optixUtilDeduplicateGeometry( nullptr, 1, hashOptions, representatives )
+                      == OPTIX_ERROR_INVALID_VALUE );
+    const OptixUtilAccelBuildRequest noOptions = {nullptr, &a.input, 1};
+    OPTIX_UTIL_CHECK( optixUtilDeduplicateGeometry( &noOptions, 1, hashOptions, representatives )
+                      == OPTIX_ERROR_INVALID_VALUE );
+    OptixBuildInput noVertices             = a.input;
+    noVertices.triangleArray.vertexBuffers = nullptr;
+    const OptixUtilAccelBuildRequest missing = {&options, &noVertices, 1};
+    OPTIX_UTIL_CHECK( optixUtilDeduplicateGeometry( &missing, 1, hashOptions, representatives )
+                      == OPTIX_ERROR_INVALID_VALUE );
+    OptixBuildInput instances = {};
+    instances.type            = OPTIX_BUILD_INPUT_TYPE_INSTANCES;
+    const OptixUtilAccelBuildRequest instanceRequest = {&options, &instances, 1};
+    OPTIX_UTIL_CHECK( optixUtilDeduplicateGeometry( &instanceRequest, 1, hashOptions, representatives )
+                      == OPTIX_ERROR_INVALID_VALUE );
+    OPTIX_UTIL_CHECK_SUCCESS( optixUtilDeduplicateGeometry( nullptr, 0, hashOptions, nullptr, nullptr, nullptr,
+                                                            &report ) );
+    OPTIX_UTIL_CHECK( report.numBuilds == 0 && report.inputBytes == 0 );
+
+    return optix_util_test::finish();
+}
@@ -0,0 +1,99 @@
+#include "optix_util_test.h"
+
+#include <optix_util_graph_flatten.h>
+
+#include <cstring>
+
+static OptixUtilGraphNode node( OptixUtilGraphNodeType type )
+{
+    OptixUtilGraphNode n;
+    std::memset( &n, 0, sizeof( n ) );
+    n.type = type;
+    optixUtilSetIdentityMatrix( n.transform );
+    return n;
+}
+
+static OptixUtilGraphInstance instance( unsigned int child, float tx, unsigned int id )
+{
+    OptixUtilGraphInstance i;
+    std::memset( &i, 0, sizeof( i ) );
+    optixUtilSetIdentityMatrix( i.instance.transform );
+    i.instance.transform[3]   = tx;
+    i.instance.instanceId     = id;
+    i.instance.visibilityMask = 255;
+    i.child                   = child;
+    return i;
+}
+
+int main()
+{
+    // root IAS (2 instances, x + 100 and x + 200) -> inner IAS (3 instances, x + 0, 1, 2)
+    //   -> static transform (z + 2) -> static transform (scale x by 2, y + 5) -> GAS
+    OptixUtilGraph graph;
+    graph.nodes.push_back( node( OPTIX_UTIL_GRAPH_NODE_TYPE_GAS ) );
+    graph.nodes[0].handle = 42;
+    graph.nodes.push_back( node( OPTIX_UTIL_GRAPH_NODE_TYPE_STATIC_TRANSFORM ) );
+    graph.nodes[1].child        = 0;
+    graph.nodes[1].transform[0] = 2.f;
+    graph.nodes[1].transform[7] = 5.f;
+    graph.nodes.push_back( node( OPTIX_UTIL_GRAPH_NODE_TYPE_STATIC_TRANSFORM ) );
+    graph.nodes[2].child         = 1;
+    graph.nodes[2].transform[11] = 2.f;
+    graph.nodes.push_back( node( OPTIX_UTIL_GRAPH_NODE_TYPE_IAS ) );
+    graph.nodes[3].firstInstance = 0;
+    graph.nodes[3].numInstances  = 3;
+    for( unsigned int i = 0; i < 3; ++i )
+        graph.instances.push_back( instance( 2, (float)i, i ) );
+    graph.nodes.push_back( node( OPTIX_UTIL_GRAPH_NODE_TYPE_IAS ) );
+    graph.nodes[4].firstInstance = 3;
+    graph.nodes[4].numInstances  = 2;
+    graph.instances.push_back( instance( 3, 100.f, 7 ) );
+    graph.instances.push_back( instance( 3, 200.f, 8 ) );
+    graph.root = 4;
+
+    // Known answer: without a budget everything collapses into one IAS over the GAS with composed transforms.
+    OptixUtilGraphFlattenOptions options = {};
+    OptixUtilGraph               flat;
+    OptixUtilGraphDepthStats     before, after;
+    OPTIX_UTIL_CHECK_SUCCESS( optixUtilFlattenGraph( graph, options, flat, &before, &after ) );
+    OPTIX_UTIL_CHECK( before.numPaths == 6 && before.averageDepth == 4 && before.maxDepth == 4 );
+    OPTIX_UTIL_CHECK( before.graphFlags == 0 );
+    OPTIX_UTIL_CHECK( after.numPaths == 6 && after.averageDepth == 1 && after.maxDepth == 1 );
+    OPTIX_UTIL_CHECK( after.graphFlags == OPTIX_TRAVERSABLE_GRAPH_FLAG_ALLOW_SINGLE_LEVEL_INSTANCING );
+    OPTIX_UTIL_CHECK( flat.nodes.size() == 2 && flat.instances.size() == 6 );
+    const OptixUtilGraphNode& root = flat.nodes[flat.root];
+    OPTIX_UTIL_CHECK( root.type == OPTIX_UTIL_GRAPH_NODE_TYPE_IAS && root.numInstances == 6 );
+    for( unsigned int i = 0; i < root.numInstances && root.firstInstance + i < flat.instances.size(); ++i )
+    {
+        const OptixInstance& inst = flat.instances[root.firstInstance + i].instance;
+        OPTIX_UTIL_CHECK( inst.traversableHandle == 42 && inst.instanceId == i % 3 );
+        OPTIX_UTIL_CHECK( inst.transform[0] == 2.f && inst.transform[5] == 1.f && inst.transform[10] == 1.f );
+        OPTIX_UTIL_CHECK( inst.transform[3] == 100.f * ( 1 + i / 3 ) + i % 3 );
+        OPTIX_UTIL_CHECK( inst.transform[7] == 5.f && inst.transform[11] == 2.f );
+    }
+
+    // keepOuterInstanceId reports the ids of the root instances instead.
+    options.keepOuterInstanceId = 1;
+    OPTIX_UTIL_CHECK_SUCCESS( optixUtilFlattenGraph( graph, options, flat ) );
+    for( unsigned int i = 0; i < flat.instances.size(); ++i )
+        OPTIX_UTIL_CHECK( flat.instances[i].instance.instanceId == ( i < 3 ? 7u : 8u ) );
+
+    // A budget of 5 instances pulls up the first inner IAS only; the other stays a separate level.
+    options.keepOuterInstanceId = 0;
+    options.maxInstancesPerIas  = 5;
+    OPTIX_UTIL_CHECK_SUCCESS( optixUtilFlattenGraph( graph, options, flat, nullptr, &after ) );
+    OPTIX_UTIL_CHECK( flat.nodes.size() == 3 && after.maxDepth == 2 && after.numPaths == 6 );
+    OPTIX_UTIL_CHECK( flat.nodes[flat.root].numInstances == 4 );
+    OPTIX_UTIL_CHECK( after.graphFlags == 0 );
+
+    // Edge cases: out-of-range children, cycles and flattening in place are rejected.
+    options.maxInstancesPerIas = 0;
+    OptixUtilGraph broken      = graph;
+    broken.nodes[1].child      = 99;
+    OPTIX_UTIL_CHECK( optixUtilFlattenGraph( broken, options, flat ) == OPTIX_ERROR_INVALID_VALUE );
+    broken.nodes[1].child = 2;
+    OPTIX_UTIL_CHECK( optixUtilFlattenGraph( broken, options, flat ) == OPTIX_ERROR_INVALID_VALUE );
+    OPTIX_UTIL_CHECK( optixUtilFlattenGraph( graph, options, graph ) == OPTIX_ERROR_INVALID_VALUE );
+
+    return optix_util_test::finish();
+}
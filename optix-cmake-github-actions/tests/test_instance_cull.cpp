@@ -0,0 +1,137 @@
+#include "optix_util_test.h"
+
+#include <optix_util_instance_cull.h>
+
+#include <cmath>
+#include <cstring>
+#include <random>
+#include <vector>
+
+int main()
+{
+    const OptixUtilLodGroup groups[3] = {{{-1.f, -1.f, -1.f, 1.f, 1.f, 1.f}, 0, 3},
+                                         {{0.f, 0.f, 0.f, 4.f, 2.f, 2.f}, 3, 1},
+                                         {{-5.f, -5.f, -5.f, 5.f, 5.f, 5.f}, 4, 0}};
+    const OptixUtilLodLevel levels[4] = {{100, 0, 50.f}, {101, 1, 10.f}, {102, 2, 0.f}, {200, 0, 0.f}};
+
+    // A rotated non-uniform scale, diag( 2, 1, 1 ) * Rz( 45 degrees), stretches the unit cube of group 0 to
+    // x = 2 * sqrt( 2 ) ~ 2.83. The largest column norm is only sqrt( 2.5 ) ~ 1.58, which used to cull these
+    // instances against the plane x >= 2.78 although they cross it.
+    {
+        const size_t             n = 16;
+        const float              h = std::sqrt( 0.5f );
+        OptixUtilInstanceStaging staging;
+        staging.resize( n );
+        const float m[12] = {2.f * h, -2.f * h, 0.f, 0.f, h, h, 0.f, 0.f, 0.f, 0.f, 1.f, 0.f};
+        for( size_t i = 0; i < n; ++i )
+            staging.setTransform( i, m );
+        std::vector<unsigned int> lodGroups( n, 0 );
+        OptixUtilCullParams       params   = {};
+        const float               plane[4] = {1.f, 0.f, 0.f, -2.78f};
+        std::memcpy( params.planes[0], plane, sizeof( plane ) );
+        params.numPlanes = 1;
+        for( int isa = OPTIX_UTIL_SIMD_ISA_SCALAR; isa <= OPTIX_UTIL_SIMD_ISA_AVX2; ++isa )
+        {
+            OptixUtilInstanceBuffer output;
+            OptixUtilInstanceSpan   span;
+            OPTIX_UTIL_CHECK_SUCCESS( optixUtilCullInstances( staging.soa(), lodGroups.data(), n, groups, 3, levels, 4,
+                                                              params, output, &span, nullptr, nullptr, 0,
+                                                              (OptixUtilSimdIsa)isa ) );
+            OPTIX_UTIL_CHECK( span.count == n );
+        }
+    }
+
+    // Known answer: an identity instance of group 0 at distance 10 along +z has radius sqrt( 3 ) and projects to
+    // sqrt( 3 ) * 540 / 10 ~ 93.5 pixels, level 100. At distance 50, 18.7 pixels, level 101. Behind the eye, culled.
+    {
+        const float               z[3] = {10.f, 50.f, -10.f};
+        OptixUtilInstanceStaging  staging;
+        std::vector<unsigned int> lodGroups( 3, 0 );
+        staging.resize( 3 );
+        for( int i = 0; i < 3; ++i )
+            staging.transformElement( 11 )[i] = z[i];
+        OptixUtilCullParams params   = {};
+        const float         plane[4] = {0.f, 0.f, 1.f, 0.f};
+        std::memcpy( params.planes[0], plane, sizeof( plane ) );
+        params.numPlanes  = 1;
+        params.pixelScale = 540.f;
+        OptixUtilInstanceBuffer   output;
+        OptixUtilInstanceSpan     span;
+        std::vector<unsigned int> survivors;
+        OPTIX_UTIL_CHECK_SUCCESS( optixUtilCullInstances( staging.soa(), lodGroups.data(), 3, groups, 3, levels, 4,
+                                                          params, output, &span, &survivors ) );
+        OPTIX_UTIL_CHECK( span.count == 2 && survivors.size() == 2 && survivors[0] == 0 && survivors[1] == 1 );
+        OPTIX_UTIL_CHECK( span.count == 2 && span.data[0].traversableHandle == 100 );
+        OPTIX_UTIL_CHECK( span.count == 2 && span.data[1].traversableHandle == 101 && span.data[1].sbtOffset == 1 );
+    }
+
+    // Scalar and AVX2 agree on a random scene with sheared, non-uniformly scaled instances, instances with disabled
+    // transforms or visibility mask 0, and a group without levels.
+    const size_t             n = 100003;
+    OptixUtilInstanceStaging staging;
+    staging.resize( n );
+    std::vector<unsigned int>             lodGroups( n );
+    std::mt19937                          rng( 1 );
+    std::uniform_real_distribution<float> position( -1000.f, 1000.f );
+    std::uniform_real_distribution<float> entry( -2.f, 2.f );
+    for( size_t i = 0; i < n; ++i )
+    {
+        float m[12];
+        for( int k = 0; k < 12; ++k )
+            m[k] = entry( rng );
+        m[3]  = position( rng );
+        m[7]  = 0.1f * position( rng );
+        m[11] = position( rng );
+        staging.setTransform( i, m );
+        lodGroups[i] = (unsigned int)( i % 3 );
+        if( i % 1001 == 0 )
+            staging.flags()[i] = OPTIX_INSTANCE_FLAG_DISABLE_TRANSFORM;
+        if( i % 997 == 0 )
+            staging.visibilityMask()[i] = 0;
+    }
+
+    // 90 degree frustum looking down +z from the origin.
+    OptixUtilCullParams params       = {};
+    const float         planes[5][4] = {{0.f, 0.f, 1.f, 0.f},
+                                        {0.7071f, 0.f, 0.7071f, 0.f},
+                                        {-0.7071f, 0.f, 0.7071f, 0.f},
+                                        {0.f, 0.7071f, 0.7071f, 0.f},
+                                        {0.f, -0.7071f, 0.7071f, 0.f}};
+    std::memcpy( params.planes, planes, sizeof( planes ) );
+    params.numPlanes    = 5;
+    params.maxDistance  = 800.f;
+    params.pixelScale   = 540.f;
+    params.minPixelSize = 2.f;
+
+    OptixUtilInstanceBuffer   output[2];
+    OptixUtilInstanceSpan     span[2];
+    std::vector<unsigned int> survivors[2];
+    OptixUtilCullScratch      scratch;
+    for( int k = 0; k < 2; ++k )
+        OPTIX_UTIL_CHECK_SUCCESS( optixUtilCullInstances( staging.soa(), lodGroups.data(), n, groups, 3, levels, 4,
+                                                          params, output[k], &span[k], &survivors[k], &scratch, 0,
+                                                          k ? OPTIX_UTIL_SIMD_ISA_AVX2 : OPTIX_UTIL_SIMD_ISA_SCALAR ) );
+    OPTIX_UTIL_CHECK( span[0].count > 0 && span[0].count < n && span[0].count == span[1].count );
+    OPTIX_UTIL_CHECK( survivors[0] == survivors[1] );
+    OPTIX_UTIL_CHECK( span[0].count == span[1].count
+                      && std::memcmp( span[0].data, span[1].data, span[0].count * sizeof( OptixInstance ) ) == 0 );
+    bool valid = true;
+    for( size_t i = 0; i < survivors[0].size(); ++i )
+        valid = valid && lodGroups[survivors[0][i]] != 2 && staging.visibilityMask()[survivors[0][i]] != 0;
+    OPTIX_UTIL_CHECK( valid );
+
+    // Edge cases: more than 6 planes and out-of-range group indices are rejected, empty batches succeed.
+    OptixUtilCullParams tooMany = params;
+    tooMany.numPlanes           = 7;
+    OPTIX_UTIL_CHECK( optixUtilCullInstances( staging.soa(), lodGroups.data(), n, groups, 3, levels, 4, tooMany,
+                                              output[0], &span[0] )
+                      == OPTIX_ERROR_INVALID_VALUE );
+    OPTIX_UTIL_CHECK( optixUtilCullInstances( staging.soa(), lodGroups.data(), n, groups, 2, levels, 4, params,
+                                              output[0], &span[0] )
+                      == OPTIX_ERROR_INVALID_VALUE );
+    OPTIX_UTIL_CHECK_SUCCESS( optixUtilCullInstances( staging.soa(), nullptr, 0, groups, 3, levels, 4, params,
+                                                      output[0], &span[0] ) );
+    OPTIX_UTIL_CHECK( span[0].count == 0 );
+
+    return optix_util_test::finish();
+}
@@ -0,0 +1,138 @@
+#include "optix_util_test.h"
+
+#include <optix_util_instance_sort.h>
+
+#include <algorithm>
+#include <cstdlib>
+#include <cstring>
+#include <random>
+#include <vector>
+
+static OptixInstance translatedInstance( float x, float y, float z, unsigned int id )
+{
+    OptixInstance instance;
+    std::memset( &instance, 0, sizeof( instance ) );
+    instance.transform[0] = instance.transform[5] = instance.transform[10] = 1.f;
+    instance.transform[3]  = x;
+    instance.transform[7]  = y;
+    instance.transform[11] = z;
+    instance.instanceId    = id;
+    return instance;
+}
+
+int main()
+{
+    using namespace optix_util_impl;
+
+    // Known answer: the corners of a cube, listed in reverse Morton order (x is the most significant axis).
+    {
+        std::vector<OptixInstance> corners, sorted( 8 );
+        for( int c = 7; c >= 0; --c )
+            corners.push_back( translatedInstance( (float)( c >> 2 & 1 ), (float)( c >> 1 & 1 ), (float)( c & 1 ),
+                                                   (unsigned int)c ) );
+        unsigned int permutation[8];
+        OPTIX_UTIL_CHECK_SUCCESS( optixUtilSortInstances( corners.data(), 8, nullptr, OPTIX_UTIL_SPATIAL_CURVE_MORTON,
+                                                          sorted.data(), permutation ) );
+        for( unsigned int i = 0; i < 8; ++i )
+            OPTIX_UTIL_CHECK( sorted[i].instanceId == i && permutation[i] == 7 - i );
+    }
+
+    // The Hilbert curve visits every cell of an aligned 32^3 block once, moving to a face neighbour in each step.
+    {
+        const int        side = 32;
+        std::vector<int> cellOfCode( side * side * side, -1 );
+        bool             bijective = true;
+        for( int x = 0; x < side; ++x )
+            for( int y = 0; y < side; ++y )
+                for( int z = 0; z < side; ++z )
+                {
+                    const uint32_t code = hilbertCode( x, y, z );
+                    bijective           = bijective && code < cellOfCode.size() && cellOfCode[code] < 0;
+                    if( code < cellOfCode.size() )
+                        cellOfCode[code] = ( x * side + y ) * side + z;
+                }
+        OPTIX_UTIL_CHECK( bijective );
+        bool adjacent = bijective;
+        for( size_t c = 1; c < cellOfCode.size() && adjacent; ++c )
+        {
+            const int a = cellOfCode[c - 1], b = cellOfCode[c];
+            const int distance = std::abs( a / ( side * side ) - b / ( side * side ) )
+                                 + std::abs( a / side % side - b / side % side ) + std::abs( a % side - b % side );
+            adjacent           = distance == 1;
+        }
+        OPTIX_UTIL_CHECK( adjacent );
+    }
+
+    // Scalar and AVX2 keys give the same permutation, the output follows the curve and instances move as a whole.
+    const size_t                          n = 100003;
+    std::mt19937                          rng( 1 );
+    std::uniform_real_distribution<float> uniform( -1000.f, 1000.f );
+    std::vector<OptixInstance>            instances( n );
+    for( size_t i = 0; i < n; ++i )
+        instances[i] = translatedInstance( uniform( rng ), uniform( rng ), uniform( rng ), (unsigned int)i );
+    float lo[3] = {1e30f, 1e30f, 1e30f}, hi[3] = {-1e30f, -1e30f, -1e30f};
+    for( size_t i = 0; i < n; ++i )
+        for( int k = 0; k < 3; ++k )
+        {
+            lo[k] = std::min( lo[k], instances[i].transform[4 * k + 3] );
+            hi[k] = std::max( hi[k], instances[i].transform[4 * k + 3] );
+        }
+
+    OptixUtilSortScratch scratch;
+    for( int curve = OPTIX_UTIL_SPATIAL_CURVE_MORTON; curve <= OPTIX_UTIL_SPATIAL_CURVE_HILBERT; ++curve )
+    {
+        std::vector<unsigned int>  permutation[2];
+        std::vector<OptixInstance> sorted( n );
+        for( int k = 0; k < 2; ++k )
+        {
+            const OptixUtilSimdIsa isa = k ? OPTIX_UTIL_SIMD_ISA_AVX2 : OPTIX_UTIL_SIMD_ISA_SCALAR;
+            permutation[k].resize( n );
+            OPTIX_UTIL_CHECK_SUCCESS( optixUtilSortInstances( instances.data(), n, nullptr,
+                                                              (OptixUtilSpatialCurve)curve, sorted.data(),
+                                                              permutation[k].data(), &scratch, 0, isa ) );
+        }
+        OPTIX_UTIL_CHECK( permutation[0] == permutation[1] );
+
+        std::vector<char> seen( n, 0 );
+        bool              valid    = true;
+        uint32_t          previous = 0;
+        for( size_t i = 0; i < n; ++i )
+        {
+            valid = valid && permutation[0][i] < n && !seen[permutation[0][i]]++;
+            valid = valid && sorted[i].instanceId == permutation[0][i];
+            uint32_t q[3];
+            for( int k = 0; k < 3; ++k )
+                q[k] = quantizeAxis( sorted[i].transform[4 * k + 3], lo[k], 1024.f / ( hi[k] - lo[k] ) );
+            const uint32_t code = curve ? hilbertCode( q[0], q[1], q[2] ) : mortonCode( q[0], q[1], q[2] );
+            valid               = valid && code >= previous;
+            previous            = code;
+        }
+        OPTIX_UTIL_CHECK( valid );
+    }
+
+    // Other per-instance arrays follow with the permutation.
+    std::vector<unsigned int>  permutation( n );
+    std::vector<OptixInstance> sorted( n );
+    OPTIX_UTIL_CHECK_SUCCESS( optixUtilSortInstances( instances.data(), n, nullptr, OPTIX_UTIL_SPATIAL_CURVE_HILBERT,
+                                                      sorted.data(), permutation.data() ) );
+    std::vector<unsigned int> ids( n ), reordered( n );
+    for( size_t i = 0; i < n; ++i )
+        ids[i] = instances[i].instanceId;
+    OPTIX_UTIL_CHECK_SUCCESS( optixUtilApplyPermutation( ids.data(), permutation.data(), n, reordered.data() ) );
+    bool same = true;
+    for( size_t i = 0; i < n; ++i )
+        same = same && reordered[i] == sorted[i].instanceId;
+    OPTIX_UTIL_CHECK( same );
+
+    // Edge cases: overlapping output, unknown curves and out-of-range permutations are rejected.
+    OPTIX_UTIL_CHECK( optixUtilSortInstances( instances.data(), n, nullptr, OPTIX_UTIL_SPATIAL_CURVE_MORTON,
+                                              instances.data() + 1 )
+                      == OPTIX_ERROR_INVALID_VALUE );
+    OPTIX_UTIL_CHECK( optixUtilSortInstances( instances.data(), n, nullptr, (OptixUtilSpatialCurve)2, sorted.data() )
+                      == OPTIX_ERROR_INVALID_VALUE );
+    permutation[0] = (unsigned int)n;
+    OPTIX_UTIL_CHECK( optixUtilApplyPermutation( ids.data(), permutation.data(), n, reordered.data() )
+                      == OPTIX_ERROR_INVALID_VALUE );
+
+    return optix_util_test::finish();
+}
@@ -0,0 +1,114 @@
+#include "optix_util_test.h"
+
+#include <optix_util_instance_update.h>
+
+#include <cmath>
+#include <cstring>
+#include <initializer_list>
+#include <vector>
+
+static OptixUtilInstanceUploadReport   report;
+static std::vector<OptixUtilCopyRange> ranges;
+
+static bool hasRanges( std::initializer_list<size_t> bounds )
+{
+    if( ranges.size() * 2 != bounds.size() )
+        return false;
+    const size_t* b = bounds.begin();
+    for( const OptixUtilCopyRange& range : ranges )
+    {
+        if( range.offsetInBytes != b[0] * sizeof( OptixInstance )
+            || range.sizeInBytes != ( b[1] - b[0] ) * sizeof( OptixInstance ) )
+            return false;
+        b += 2;
+    }
+    return true;
+}
+
+static void move( OptixUtilInstanceStore& store, size_t i, int axis, float distance )
+{
+    float m[12];
+    std::memcpy( m, store.get( i ).transform, sizeof( m ) );
+    m[4 * axis + 3] += distance;
+    store.setTransform( i, m );
+}
+
+int main()
+{
+    // 1000 unit cubes spaced 3 units apart along x.
+    const size_t           n = 1000;
+    OptixUtilInstanceStore store;
+    store.resize( n );
+    for( size_t i = 0; i < n; ++i )
+    {
+        OptixInstance instance = {};
+        optixUtilSetIdentityMatrix( instance.transform );
+        instance.transform[3] = (float)i * 3.f;
+        instance.instanceId   = (unsigned int)i;
+        store.set( i, instance );
+        store.setChildBounds( i, {-1.f, -1.f, -1.f, 1.f, 1.f, 1.f} );
+    }
+
+    OptixUtilInstanceUpdatePolicy policy = {};
+    policy.mergeGapInInstances           = 2;
+
+    // The first upload after a resize is a full build.
+    OPTIX_UTIL_CHECK_SUCCESS( optixUtilPrepareInstanceUpload( store, policy, ranges, &report ) );
+    OPTIX_UTIL_CHECK( report.operation == OPTIX_BUILD_OPERATION_BUILD && hasRanges( {0, n} ) );
+    OPTIX_UTIL_CHECK( report.numDirty == n && report.bytesToUpload == n * sizeof( OptixInstance ) );
+
+    // Known answer: small moves give an update with merged ranges. Writing an unchanged transform is not a change.
+    for( size_t i : {5, 7, 8, 20, 999} )
+        move( store, i, 1, 0.5f );
+    store.setTransform( 30, store.get( 30 ).transform );
+    OPTIX_UTIL_CHECK_SUCCESS( optixUtilPrepareInstanceUpload( store, policy, ranges, &report ) );
+    OPTIX_UTIL_CHECK( report.operation == OPTIX_BUILD_OPERATION_UPDATE && report.numDirty == 5 );
+    OPTIX_UTIL_CHECK( hasRanges( {5, 9, 20, 21, 999, 1000} ) );
+    OPTIX_UTIL_CHECK( report.bytesToUpload == 6 * sizeof( OptixInstance ) && !store.isDirty( 5 ) );
+
+    // Dirty runs spanning a word of dirty bits stay one range.
+    move( store, 63, 2, 0.1f );
+    move( store, 64, 2, 0.1f );
+    OPTIX_UTIL_CHECK_SUCCESS( optixUtilPrepareInstanceUpload( store, policy, ranges, &report ) );
+    OPTIX_UTIL_CHECK( report.operation == OPTIX_BUILD_OPERATION_UPDATE && hasRanges( {63, 65} ) );
+
+    // Large moves of few instances grow the bounds, but stay below the default limit of 0.5.
+    for( size_t i = 0; i < 100; ++i )
+        move( store, i, 1, 10.f );
+    OPTIX_UTIL_CHECK_SUCCESS( optixUtilPrepareInstanceUpload( store, policy, ranges, &report ) );
+    OPTIX_UTIL_CHECK( report.operation == OPTIX_BUILD_OPERATION_UPDATE && hasRanges( {0, 100} ) );
+    OPTIX_UTIL_CHECK( report.boundsGrowth > 0.3f && report.boundsGrowth < 0.5f );
+
+    // A stricter bounds limit, too many dirty instances or too many consecutive updates force a rebuild.
+    OptixUtilInstanceUpdatePolicy strict = policy;
+    strict.maxBoundsGrowth               = 0.3f;
+    move( store, 500, 1, 0.01f );
+    OPTIX_UTIL_CHECK_SUCCESS( optixUtilPrepareInstanceUpload( store, strict, ranges, &report ) );
+    OPTIX_UTIL_CHECK( report.operation == OPTIX_BUILD_OPERATION_BUILD );
+
+    for( size_t i = 0; i < 400; ++i )
+        move( store, i, 2, 0.1f );
+    OPTIX_UTIL_CHECK_SUCCESS( optixUtilPrepareInstanceUpload( store, policy, ranges, &report ) );
+    OPTIX_UTIL_CHECK( report.operation == OPTIX_BUILD_OPERATION_BUILD );
+    OPTIX_UTIL_CHECK( std::fabs( report.dirtyFraction - 0.4 ) < 1e-6 );
+
+    OptixUtilInstanceUpdatePolicy limited = policy;
+    limited.maxConsecutiveUpdates         = 1;
+    move( store, 1, 2, 0.1f );
+    OPTIX_UTIL_CHECK_SUCCESS( optixUtilPrepareInstanceUpload( store, limited, ranges, &report ) );
+    OPTIX_UTIL_CHECK( report.operation == OPTIX_BUILD_OPERATION_UPDATE );
+    move( store, 1, 2, 0.1f );
+    OPTIX_UTIL_CHECK_SUCCESS( optixUtilPrepareInstanceUpload( store, limited, ranges, &report ) );
+    OPTIX_UTIL_CHECK( report.operation == OPTIX_BUILD_OPERATION_BUILD );
+
+    // Edge case: no changes upload nothing.
+    OPTIX_UTIL_CHECK_SUCCESS( optixUtilPrepareInstanceUpload( store, policy, ranges, &report ) );
+    OPTIX_UTIL_CHECK( ranges.empty() && report.numDirty == 0 && report.bytesToUpload == 0 );
+
+    const OptixUtilInstanceUploadStats& stats = store.stats();
+    OPTIX_UTIL_CHECK( stats.numBuilds == 4 && stats.numUpdates == 5 );
+    OPTIX_UTIL_CHECK( stats.bytesFullUpload == 9 * n * sizeof( OptixInstance ) );
+    OPTIX_UTIL_CHECK( stats.bytesUploaded == ( n + 6 + 2 + 100 + 1 + 400 + 1 + 1 ) * sizeof( OptixInstance ) );
+
+    return optix_util_test::finish();
+}
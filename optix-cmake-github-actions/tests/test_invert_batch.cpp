@@ -0,0 +1,155 @@
+#include "optix_util_test.h"
+
+#include <optix_util_invert_batch.h>
+
+#include <cmath>
+#include <random>
+#include <vector>
+
+struct MatrixBatch
+{
+    std::vector<float> storage[12];
+    OptixUtilMatrixSoA soa;
+
+    explicit MatrixBatch( size_t n )
+    {
+        for( int k = 0; k < 12; ++k )
+        {
+            storage[k].assign( n, 0.f );
+            soa.element[k] = storage[k].data();
+        }
+    }
+
+    void set( size_t i, const float* m )
+    {
+        for( int k = 0; k < 12; ++k )
+            storage[k][i] = m[k];
+    }
+};
+
+int main()
+{
+    // Known answer: scale ( 2, 4, 8 ) followed by translation ( 1, 2, 3 ).
+    const float m[12]   = {2.f, 0.f, 0.f, 1.f, 0.f, 4.f, 0.f, 2.f, 0.f, 0.f, 8.f, 3.f};
+    const float ref[12] = {0.5f, 0.f, 0.f, -0.5f, 0.f, 0.25f, 0.f, -0.5f, 0.f, 0.f, 0.125f, -0.375f};
+    for( int isa = OPTIX_UTIL_SIMD_ISA_SCALAR; isa <= OPTIX_UTIL_SIMD_ISA_AVX512; ++isa )
+    {
+        const size_t n = 37;
+        MatrixBatch  in( n ), out( n );
+        for( size_t i = 0; i < n; ++i )
+            in.set( i, m );
+        size_t numSingular = 1;
+        OPTIX_UTIL_CHECK_SUCCESS( optixUtilInvertMatrixBatch( in.soa, out.soa, n, nullptr, &numSingular,
+                                                              OPTIX_UTIL_DEFAULT_SINGULAR_THRESHOLD, 0,
+                                                              (OptixUtilSimdIsa)isa ) );
+        OPTIX_UTIL_CHECK( numSingular == 0 );
+        for( size_t i = 0; i < n; ++i )
+            for( int k = 0; k < 12; ++k )
+                OPTIX_UTIL_CHECK( out.storage[k][i] == ref[k] );
+    }
+
+    // Uniformly scaled rotations are not flagged, however large or small the scale, as long as det is a normal float.
+    // Matrices with two equal rows are flagged. Scalar and SIMD agree on both.
+    const float  scales[]  = {1e-12f, 1e-9f, 3e-8f, 1e-3f, 1.f, 1e3f, 3e6f, 1e7f, 1e12f};
+    const size_t numScales = sizeof( scales ) / sizeof( scales[0] );
+    const size_t n         = 1003;
+    std::mt19937 rng( 1 );
+    std::uniform_real_distribution<float> uniform( -1.f, 1.f );
+    MatrixBatch                           in( n );
+    std::vector<unsigned char>            expected( n );
+    for( size_t i = 0; i < n; ++i )
+    {
+        const float s     = scales[i % numScales];
+        const float angle = 3.f * uniform( rng );
+        const float c = std::cos( angle ) * s, d = std::sin( angle ) * s;
+        float       r[12] = {c, -d, 0.f, uniform( rng ), d, c, 0.f, uniform( rng ), 0.f, 0.f, s, uniform( rng )};
+        expected[i] = i % 7 == 3;
+        if( expected[i] )
+            for( int k = 0; k < 3; ++k )
+                r[8 + k] = r[4 + k];
+        in.set( i, r );
+    }
+
+    size_t expectedSingular = 0;
+    for( size_t i = 0; i < n; ++i )
+        expectedSingular += expected[i];
+
+    std::vector<float> scalar[12];
+    for( int isa = OPTIX_UTIL_SIMD_ISA_SCALAR; isa <= OPTIX_UTIL_SIMD_ISA_AVX512; ++isa )
+    {
+        MatrixBatch                out( n );
+        std::vector<unsigned char> flags( n, 2 );
+        size_t                     numSingular = 0;
+        OPTIX_UTIL_CHECK_SUCCESS( optixUtilInvertMatrixBatch( in.soa, out.soa, n, flags.data(), &numSingular,
+                                                              OPTIX_UTIL_DEFAULT_SINGULAR_THRESHOLD, 0,
+                                                              (OptixUtilSimdIsa)isa ) );
+        OPTIX_UTIL_CHECK( numSingular == expectedSingular );
+        OPTIX_UTIL_CHECK( flags == expected );
+
+        OptixUtilInverseAccuracyReport report;
+        OPTIX_UTIL_CHECK_SUCCESS( optixUtilMeasureInverseAccuracy( in.soa, out.soa, n, flags.data(), &report ) );
+        OPTIX_UTIL_CHECK( report.numCompared == n - expectedSingular );
+        OPTIX_UTIL_CHECK( report.maxRelError < 1e-4 );
+
+        if( isa == OPTIX_UTIL_SIMD_ISA_SCALAR )
+            for( int k = 0; k < 12; ++k )
+                scalar[k] = out.storage[k];
+        float maxError = 0.f;
+        for( size_t i = 0; i < n; ++i )
+            for( int k = 0; k < 12; ++k )
+            {
+                const float a = out.storage[k][i], b = scalar[k][i];
+                maxError      = std::max( maxError, std::fabs( a - b ) / std::max( std::fabs( b ), 1.f ) );
+            }
+        OPTIX_UTIL_CHECK( maxError < 1e-5f );
+    }
+
+    // Static transforms go through the same kernels.
+    std::vector<OptixStaticTransform> transforms( 2 );
+    std::memcpy( transforms[0].transform, m, sizeof( m ) );
+    std::memcpy( transforms[1].transform, m, sizeof( m ) );
+    transforms[1].transform[0] = 0.f;
+    unsigned char flags[2];
+    size_t        numSingular = 0;
+    OPTIX_UTIL_CHECK_SUCCESS( optixUtilComputeStaticTransformInverses( transforms.data(), 2, flags, &numSingular ) );
+    OPTIX_UTIL_CHECK( numSingular == 1 && flags[0] == 0 && flags[1] == 1 );
+    OPTIX_UTIL_CHECK( std::memcmp( transforms[0].invTransform, ref, sizeof( ref ) ) == 0 );
+
+    // Singular lanes with NaN or inf elements get an all-zero inverse with every instruction set, like the scalar
+    // kernel, although their cofactors are NaN. Every third matrix is regular.
+    const int linear[9] = {0, 1, 2, 4, 5, 6, 8, 9, 10};
+    bool      zeroed    = true;
+    for( int isa = OPTIX_UTIL_SIMD_ISA_SCALAR; isa <= OPTIX_UTIL_SIMD_ISA_AVX512; ++isa )
+    {
+        const size_t count = 37;
+        MatrixBatch  special( count ), out( count );
+        for( size_t i = 0; i < count; ++i )
+        {
+            special.set( i, m );
+            if( i % 3 == 1 )
+                special.storage[linear[i / 3 % 9]][i] = i % 2 ? INFINITY : std::nanf( "" );
+            else if( i % 3 == 2 )
+                special.storage[3][i] = special.storage[10][i] = -INFINITY;
+        }
+        OPTIX_UTIL_CHECK_SUCCESS( optixUtilInvertMatrixBatch( special.soa, out.soa, count, nullptr, &numSingular,
+                                                              OPTIX_UTIL_DEFAULT_SINGULAR_THRESHOLD, 0,
+                                                              (OptixUtilSimdIsa)isa ) );
+        OPTIX_UTIL_CHECK( numSingular == 24 );
+        for( size_t i = 0; i < count; ++i )
+            for( int k = 0; k < 12; ++k )
+                zeroed = zeroed && out.storage[k][i] == ( i % 3 == 0 ? ref[k] : 0.f );
+    }
+    OPTIX_UTIL_CHECK( zeroed );
+
+    // Edge cases: NaN input is flagged, negative thresholds are rejected, empty batches succeed.
+    MatrixBatch single( 1 ), inverse( 1 );
+    single.set( 0, m );
+    single.storage[5][0] = std::nanf( "" );
+    OPTIX_UTIL_CHECK_SUCCESS( optixUtilInvertMatrixBatch( single.soa, inverse.soa, 1, flags, &numSingular ) );
+    OPTIX_UTIL_CHECK( numSingular == 1 && flags[0] == 1 );
+    OPTIX_UTIL_CHECK( optixUtilInvertMatrixBatch( single.soa, inverse.soa, 1, nullptr, nullptr, -1.f )
+                      == OPTIX_ERROR_INVALID_VALUE );
+    OPTIX_UTIL_CHECK_SUCCESS( optixUtilInvertMatrixBatch( single.soa, inverse.soa, 0 ) );
+
+    return optix_util_test::finish();
+}
@@ -0,0 +1,157 @@
+#include "optix_util_test.h"
+
+#include <optix_util_mesh_partition.h>
+
+#include <algorithm>
+#include <vector>
+
+using optix_util_test::isAccelImage;
+
+/// Grid of side x side vertices in the z = 0 plane, with the triangles of side - 1 squared quads.
+struct GridMesh
+{
+    std::vector<float>        vertices;
+    std::vector<unsigned int> indices;
+
+    GridMesh( unsigned int side, float offsetX )
+    {
+        for( unsigned int v = 0; v < side * side; ++v )
+            vertices.insert( vertices.end(), {offsetX + (float)( v % side ), (float)( v / side ), 0.0f} );
+        for( unsigned int y = 0; y + 1 < side; ++y )
+            for( unsigned int x = 0; x + 1 < side; ++x )
+            {
+                const unsigned int v = y * side + x;
+                indices.insert( indices.end(), {v, v + 1, v + side + 1, v, v + side + 1, v + side} );
+            }
+    }
+
+    OptixUtilMeshInput input() const
+    {
+        return {vertices.data(), (unsigned int)vertices.size() / 3, 0, indices.data(),
+                (unsigned int)indices.size() / 3};
+    }
+};
+
+int main()
+{
+    // Known answer: two 20 x 20 patches 100 units apart, with their triangles interleaved in the input. Two
+    // partitions take one patch each, keep the input order and map back to the input triangles.
+    const GridMesh            left( 20, 0.0f ), right( 20, 100.0f );
+    const unsigned int        patchTriangles = 2 * 19 * 19;
+    std::vector<float>        vertices( left.vertices );
+    std::vector<unsigned int> indices;
+    vertices.insert( vertices.end(), right.vertices.begin(), right.vertices.end() );
+    for( unsigned int t = 0; t < patchTriangles; ++t )
+    {
+        indices.insert( indices.end(), &left.indices[t * 3], &left.indices[t * 3 + 3] );
+        for( int corner = 0; corner < 3; ++corner )
+            indices.push_back( right.indices[t * 3 + corner] + 400 );
+    }
+    OptixUtilMeshInput           mesh = {vertices.data(), 800, 0, indices.data(), 2 * patchTriangles};
+    OptixUtilPartitionedMesh     partitioned;
+    OptixUtilMeshPartitionReport report;
+    OPTIX_UTIL_CHECK_SUCCESS( optixUtilPartitionMesh( mesh, 2, partitioned, &report ) );
+    OPTIX_UTIL_CHECK( partitioned.partitions.size() == 2 && report.numPartitions == 2 );
+    OPTIX_UTIL_CHECK( report.minPartitionTriangles == patchTriangles );
+    OPTIX_UTIL_CHECK( report.maxPartitionTriangles == patchTriangles );
+    OPTIX_UTIL_CHECK( report.surfaceAreaRatio < 0.5f );
+    bool mapped = true;
+    for( const OptixUtilMeshPartition& partition : partitioned.partitions )
+    {
+        const bool isLeft = partition.bounds.maxX == 19.0f;
+        mapped = mapped && ( isLeft || ( partition.bounds.minX == 100.0f && partition.bounds.maxX == 119.0f ) );
+        for( unsigned int i = partition.firstTriangle; i < partition.firstTriangle + partition.numTriangles; ++i )
+        {
+            const unsigned int id = partitioned.triangleIds[i];
+            mapped = mapped && id % 2 == ( isLeft ? 0u : 1u );
+            mapped = mapped && ( i == partition.firstTriangle || partitioned.triangleIds[i - 1] < id );
+            mapped = mapped && std::equal( &indices[id * 3], &indices[id * 3 + 3], &partitioned.indices[i * 3] );
+        }
+    }
+    OPTIX_UTIL_CHECK( mapped );
+
+    // One build input per partition, with primitiveIndexOffset at the first triangle of the partition.
+    const unsigned int flags[1] = {OPTIX_GEOMETRY_FLAG_NONE};
+    OptixBuildInput    inputs[2];
+    OPTIX_UTIL_CHECK_SUCCESS( optixUtilGetPartitionBuildInputs( partitioned, 0x10000, 0x20000, flags, inputs ) );
+    OPTIX_UTIL_CHECK( inputs[1].triangleArray.primitiveIndexOffset == patchTriangles );
+    OPTIX_UTIL_CHECK( inputs[1].triangleArray.indexBuffer == 0x20000 + patchTriangles * 12 );
+    OPTIX_UTIL_CHECK( inputs[1].triangleArray.numIndexTriplets == patchTriangles );
+    OPTIX_UTIL_CHECK( *inputs[0].triangleArray.vertexBuffers == 0x10000 && inputs[0].triangleArray.numVertices == 800 );
+
+    // Build with the stubs: one compacted GAS per partition under an IAS. Moving the vertices of the right patch
+    // refits its partition only.
+    const OptixFunctionTable  api          = optix_util_test::stubFunctionTable();
+    OptixUtilAccelMemoryPool  pool( optixUtilHostAllocator() );
+    OptixAccelBuildOptions    gasOptions   = {};
+    OptixInstance             instance     = {};
+    OptixUtilGasBatchOptions  batchOptions = {0, 0};
+    OptixUtilPartitionedAccel accel;
+    gasOptions.buildFlags   = OPTIX_BUILD_FLAG_ALLOW_COMPACTION | OPTIX_BUILD_FLAG_ALLOW_UPDATE;
+    instance.visibilityMask = 255;
+    OPTIX_UTIL_CHECK_SUCCESS( optixUtilBuildPartitionedAccel( api, nullptr, nullptr, inputs, 2, gasOptions, instance,
+                                                              pool, optixUtilHostReadback(), optixUtilHostUpload(),
+                                                              batchOptions, accel ) );
+    OPTIX_UTIL_CHECK( accel.instances.size() == 2 && accel.instances[1].traversableHandle == accel.gas.handles[1] );
+    OPTIX_UTIL_CHECK( accel.instances[1].visibilityMask == 255 && accel.handle == accel.iasBuffer );
+    OPTIX_UTIL_CHECK( isAccelImage( accel.gas.buffers[0], patchTriangles ) && isAccelImage( accel.iasBuffer, 2 ) );
+
+    std::vector<unsigned int> affected;
+    OPTIX_UTIL_CHECK_SUCCESS( optixUtilFindAffectedPartitions( partitioned, 400, 400, affected ) );
+    OPTIX_UTIL_CHECK( affected.size() == 1 && partitioned.partitions[affected[0]].bounds.minX == 100.0f );
+    const OptixTraversableHandle handle = accel.gas.handles[affected[0]];
+    OPTIX_UTIL_CHECK_SUCCESS( optixUtilUpdatePartitionedAccel( api, nullptr, nullptr, inputs, affected.data(), 1,
+                                                               pool, accel ) );
+    OPTIX_UTIL_CHECK( accel.gas.handles[affected[0]] == handle );
+    const unsigned int outOfRange = 2;
+    OPTIX_UTIL_CHECK( optixUtilUpdatePartitionedAccel( api, nullptr, nullptr, inputs, &outOfRange, 1, pool, accel )
+                      == OPTIX_ERROR_INVALID_VALUE );
+    OPTIX_UTIL_CHECK_SUCCESS( optixUtilReleasePartitionedAccel( pool, accel ) );
+    OPTIX_UTIL_CHECK( pool.freeBytes() == pool.allocatedBytes() );
+
+    // A mesh of several parallel tasks, large enough for the cell table, partitions the same with any thread count.
+    // Every triangle lands in exactly one partition, and partitions are balanced.
+    const GridMesh           grid( 900, 0.0f );
+    OptixUtilPartitionedMesh serial, parallel;
+    OPTIX_UTIL_CHECK_SUCCESS( optixUtilPartitionMesh( grid.input(), 16, serial, nullptr, 1 ) );
+    OPTIX_UTIL_CHECK_SUCCESS( optixUtilPartitionMesh( grid.input(), 16, parallel, &report, 4 ) );
+    OPTIX_UTIL_CHECK( serial.indices == parallel.indices && serial.triangleIds == parallel.triangleIds );
+    OPTIX_UTIL_CHECK( report.numTriangles == 2 * 899 * 899 && report.numPartitions == 16 );
+    OPTIX_UTIL_CHECK( report.maxPartitionTriangles < report.numTriangles / 16 * 5 / 4 );
+    std::vector<unsigned int> ids( parallel.triangleIds );
+    std::sort( ids.begin(), ids.end() );
+    bool permutation = true;
+    for( unsigned int i = 0; i < ids.size(); ++i )
+        permutation = permutation && ids[i] == i;
+    OPTIX_UTIL_CHECK( permutation );
+
+    // Edge cases: out of range indices, also in a later task, and meshes without indices that lack vertices are
+    // rejected.
+    indices[5] = 800;
+    OPTIX_UTIL_CHECK( optixUtilPartitionMesh( mesh, 2, partitioned ) == OPTIX_ERROR_INVALID_VALUE );
+    indices[5] = 399;
+    OPTIX_UTIL_CHECK_SUCCESS( optixUtilPartitionMesh( mesh, 2, partitioned ) );
+    GridMesh damaged( grid );
+    damaged.indices[3 * 1500000 + 1] = ~0u;
+    OPTIX_UTIL_CHECK( optixUtilPartitionMesh( damaged.input(), 16, parallel, nullptr, 4 )
+                      == OPTIX_ERROR_INVALID_VALUE );
+    OptixUtilMeshInput unindexed = {vertices.data(), 800, 0, nullptr, 267};
+    OPTIX_UTIL_CHECK( optixUtilPartitionMesh( unindexed, 2, partitioned ) == OPTIX_ERROR_INVALID_VALUE );
+    unindexed.numTriangles = 266;
+    OPTIX_UTIL_CHECK_SUCCESS( optixUtilPartitionMesh( unindexed, 2, partitioned ) );
+    OPTIX_UTIL_CHECK( optixUtilPartitionMesh( mesh, 0, partitioned ) == OPTIX_ERROR_INVALID_VALUE );
+
+    // Partition counts: static meshes get 16M triangles per partition, meshes updated every frame 1M.
+    OptixUtilPartitionPolicy policy = {};
+    OPTIX_UTIL_CHECK( optixUtilChoosePartitionCount( 100000000, policy ) == 6 );
+    policy.updateFrequency = 1.0f;
+    OPTIX_UTIL_CHECK( optixUtilChoosePartitionCount( 100000000, policy ) == 96 );
+    policy.updateFrequency = 0.5f;
+    OPTIX_UTIL_CHECK( optixUtilChoosePartitionCount( 100000000, policy ) == 24 );
+    policy.minPartitions = 32;
+    OPTIX_UTIL_CHECK( optixUtilChoosePartitionCount( 100000000, policy ) == 32 );
+    OPTIX_UTIL_CHECK( optixUtilChoosePartitionCount( 5, policy ) == 5 );
+    OPTIX_UTIL_CHECK( optixUtilChoosePartitionCount( 0, policy ) == 1 );
+
+    return optix_util_test::finish();
+}
@@ -0,0 +1,128 @@
+#include "optix_util_test.h"
+
+#include <optix_util_mesh_prep.h>
+
+#include <algorithm>
+#include <random>
+#include <vector>
+
+static std::vector<unsigned int> weld( const std::vector<float>& vertices, float tolerance,
+                                       unsigned int maxThreads = 0 )
+{
+    OptixUtilMeshInput              mesh = {vertices.data(), (unsigned int)( vertices.size() / 3 ), 0, nullptr, 0};
+    std::vector<unsigned int>       rep( mesh.numVertices );
+    const optix_util_impl::WeldGrid grid( mesh, tolerance, maxThreads );
+    grid.weld( rep.data(), maxThreads );
+    return rep;
+}
+
+int main()
+{
+    // Pairs within the tolerance are welded across cell borders. With cells as large as the tolerance, 0.3 only
+    // searched the cells towards 0 and missed 1.2.
+    {
+        const std::vector<float> straddling = {1.2f, 0.f, 0.f, 0.3f, 0.f, 0.f, 1.9f, 5.f, 0.f, 2.6f, 5.f, 0.f};
+        const std::vector<unsigned int> rep = weld( straddling, 1.f );
+        OPTIX_UTIL_CHECK( rep[0] == 0 && rep[1] == 0 && rep[2] == 2 && rep[3] == 2 );
+        const std::vector<float>        apart = {1.2f, 0.f, 0.f, 0.1f, 0.f, 0.f};
+        const std::vector<unsigned int> kept  = weld( apart, 1.f );
+        OPTIX_UTIL_CHECK( kept[0] == 0 && kept[1] == 1 );
+    }
+
+    // Chains weld to one vertex: with a < b < c, a ~ c and b ~ c but a !~ b, b only finds c as a neighbour, and used
+    // to stay separate while c welded to a.
+    {
+        const std::vector<float>        chain = {0.f, 0.f, 0.f, 1.6f, 0.f, 0.f, 0.8f, 0.f, 0.f};
+        const std::vector<unsigned int> rep   = weld( chain, 1.f );
+        OPTIX_UTIL_CHECK( rep[0] == 0 && rep[1] == 0 && rep[2] == 0 );
+    }
+
+    // Every vertex gets the smallest index of its connected component of vertices within the tolerance, compared with
+    // a brute-force search on a dense random cloud with many pairs near the tolerance.
+    {
+        const size_t                          n = 3000;
+        std::mt19937                          rng( 1 );
+        std::uniform_real_distribution<float> uniform( -10.f, 10.f );
+        std::vector<float>                    cloud( 3 * n );
+        for( float& c : cloud )
+            c = uniform( rng );
+        const float                     tolerance = 0.7f;
+        const std::vector<unsigned int> rep       = weld( cloud, tolerance );
+
+        // Relabels every pair within the tolerance to the smaller label until nothing changes.
+        auto close = [&]( size_t a, size_t b ) {
+            const float dx = cloud[3 * a] - cloud[3 * b], dy = cloud[3 * a + 1] - cloud[3 * b + 1];
+            const float dz = cloud[3 * a + 2] - cloud[3 * b + 2];
+            return dx * dx + dy * dy + dz * dz <= tolerance * tolerance;
+        };
+        std::vector<unsigned int> expected( n );
+        for( size_t a = 0; a < n; ++a )
+            expected[a] = (unsigned int)a;
+        for( bool changed = true; changed; )
+        {
+            changed = false;
+            for( size_t a = 0; a < n; ++a )
+                for( size_t b = 0; b < a; ++b )
+                    if( expected[a] != expected[b] && close( a, b ) )
+                    {
+                        expected[a] = expected[b] = std::min( expected[a], expected[b] );
+                        changed                   = true;
+                    }
+        }
+        size_t mismatches = 0, chained = 0;
+        for( size_t a = 0; a < n; ++a )
+        {
+            mismatches += rep[a] != expected[a];
+            chained += expected[a] != a && !close( a, expected[a] );
+        }
+        OPTIX_UTIL_CHECK( mismatches == 0 && chained > 0 );
+    }
+
+    // 200000 vertices, enough for parallel welding. Any thread count gives the serial representatives.
+    {
+        const size_t                          n = 200000;
+        std::mt19937                          rng( 2 );
+        std::uniform_real_distribution<float> uniform( -50.f, 50.f );
+        std::vector<float>                    cloud( 3 * n );
+        for( float& c : cloud )
+            c = uniform( rng );
+        OPTIX_UTIL_CHECK( weld( cloud, 1.f, 1 ) == weld( cloud, 1.f, 4 ) );
+    }
+
+    // Known answer: a quad as two unindexed triangles welds to 4 vertices in one cluster with 16-bit indices. Without
+    // a tolerance, -0 and 0 are the same position.
+    {
+        const float quad[18]             = {0.f,  0.f, 0.f, 1.f, 0.f, 0.f, 1.f, 1.f, 0.f,
+                                            -0.f, 0.f, 0.f, 1.f, 1.f, 0.f, 0.f, 1.f, 0.f};
+        OptixUtilMeshInput       mesh    = {quad, 6, 0, nullptr, 2};
+        OptixUtilMeshPrepOptions options = {0.f, 0, 0, 0};
+        OptixUtilPreparedMesh    prepared;
+        OptixUtilMeshPrepReport  report;
+        OPTIX_UTIL_CHECK_SUCCESS( optixUtilPrepareMesh( mesh, options, prepared, &report ) );
+        const unsigned short expected[6] = {0, 1, 2, 0, 2, 3};
+        OPTIX_UTIL_CHECK( report.numWeldedVertices == 4 && report.numOutputVertices == 4 && report.numClusters == 1 );
+        OPTIX_UTIL_CHECK( prepared.indices == std::vector<unsigned short>( expected, expected + 6 ) );
+        OPTIX_UTIL_CHECK( prepared.vertices.size() == 16 && prepared.vertices[4] == 1.f );
+        OPTIX_UTIL_CHECK( prepared.vertices[3] == 0.f && prepared.vertices[7] == 0.f );
+        OPTIX_UTIL_CHECK( report.inputBytes == 6 * 12 && report.outputBytes == 4 * 16 + 6 * 2 );
+    }
+
+    // Edge cases: welding a triangle to a point removes it on request, out-of-range indices and negative tolerances
+    // are rejected.
+    {
+        const float              points[9] = {0.f, 0.f, 0.f, 0.01f, 0.f, 0.f, 0.f, 0.01f, 0.f};
+        const unsigned int       indices[3] = {0, 1, 2}, invalid[3] = {0, 1, 3};
+        OptixUtilMeshInput       mesh       = {points, 3, 0, indices, 1};
+        OptixUtilMeshPrepOptions options    = {0.1f, 0, 1, 0};
+        OptixUtilPreparedMesh    prepared;
+        OPTIX_UTIL_CHECK_SUCCESS( optixUtilPrepareMesh( mesh, options, prepared ) );
+        OPTIX_UTIL_CHECK( prepared.indices.empty() && prepared.clusters.empty() );
+        options.weldTolerance = -1.f;
+        OPTIX_UTIL_CHECK( optixUtilPrepareMesh( mesh, options, prepared ) == OPTIX_ERROR_INVALID_VALUE );
+        options.weldTolerance = 0.1f;
+        mesh.indices          = invalid;
+        OPTIX_UTIL_CHECK( optixUtilPrepareMesh( mesh, options, prepared ) == OPTIX_ERROR_INVALID_VALUE );
+    }
+
+    return optix_util_test::finish();
+}
@@ -0,0 +1,151 @@
+#include "optix_util_test.h"
+
+#include <optix_util_module_cache.h>
+
+#include <atomic>
+#include <chrono>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+
+using optix_util_test::deviceContext;
+
+static std::atomic<int>    s_inFlight( 0 );
+static std::atomic<int>    s_maxInFlight( 0 );
+static std::atomic<size_t> s_numCompiled( 0 );
+static std::atomic<size_t> s_numDestroyed( 0 );
+static std::atomic<bool>   s_failFlaky( true );
+static std::mutex          s_orderMutex;
+static std::vector<size_t> s_compileOrder;
+
+/// Stub of optixModuleCreateFromPTX(): takes 20 ms, so concurrent compilations overlap, and records the PTX sizes in
+/// compile order. PTX starting with "flaky" fails with a log while s_failFlaky is set. Modules are distinct handles.
+static OptixResult moduleCreateFromPTX( OptixDeviceContext,
+                                        const OptixModuleCompileOptions*,
+                                        const OptixPipelineCompileOptions*,
+                                        const char*  ptx,
+                                        size_t       ptxSize,
+                                        char*        logString,
+                                        size_t*      logStringSize,
+                                        OptixModule* module )
+{
+    const int inFlight = ++s_inFlight;
+    for( int seen = s_maxInFlight; inFlight > seen && !s_maxInFlight.compare_exchange_weak( seen, inFlight ); )
+    {
+    }
+    std::this_thread::sleep_for( std::chrono::milliseconds( 20 ) );
+    {
+        std::lock_guard<std::mutex> lock( s_orderMutex );
+        s_compileOrder.push_back( ptxSize );
+    }
+    --s_inFlight;
+
+    if( s_failFlaky && std::string( ptx, ptxSize ).compare( 0, 5, "flaky" ) == 0 )
+    {
+        const char message[] = "invalid instruction";
+        std::memcpy( logString, message, sizeof( message ) );
+        *logStringSize = sizeof( message );
+        return OPTIX_ERROR_INVALID_PTX;
+    }
+    *logStringSize = 0;
+    *module        = reinterpret_cast<OptixModule>( ++s_numCompiled * 16 );
+    return OPTIX_SUCCESS;
+}
+
+static OptixResult moduleDestroy( OptixModule )
+{
+    ++s_numDestroyed;
+    return OPTIX_SUCCESS;
+}
+
+int main()
+{
+    OptixFunctionTable api       = optix_util_test::stubFunctionTable();
+    api.optixModuleCreateFromPTX = moduleCreateFromPTX;
+    api.optixModuleDestroy       = moduleDestroy;
+
+    // Known answer: keys follow the option values, not their addresses, and change with the PTX and bound values.
+    OptixModuleCompileOptions   moduleOptions   = {};
+    OptixPipelineCompileOptions pipelineOptions = {};
+    moduleOptions.optLevel                           = OPTIX_COMPILE_OPTIMIZATION_LEVEL_3;
+    pipelineOptions.numPayloadValues                 = 2;
+    pipelineOptions.pipelineLaunchParamsVariableName = "params";
+
+    OptixModuleCompileOptions otherModuleOptions = moduleOptions;
+    const std::string         ptx( "module a" ), samePtx( ptx );
+    const uint64_t            key =
+        optixUtilComputeModuleCacheKey( moduleOptions, pipelineOptions, ptx.data(), ptx.size() );
+    OPTIX_UTIL_CHECK( key == optixUtilComputeModuleCacheKey( otherModuleOptions, pipelineOptions, samePtx.data(),
+                                                             samePtx.size() ) );
+    OPTIX_UTIL_CHECK( key != optixUtilComputeModuleCacheKey( moduleOptions, pipelineOptions, "module b", 8 ) );
+    const int                         boundValue = 1;
+    OptixModuleCompileBoundValueEntry bound      = {};
+    bound.sizeInBytes                            = sizeof( boundValue );
+    bound.boundValuePtr                          = &boundValue;
+    otherModuleOptions.boundValues               = &bound;
+    otherModuleOptions.numBoundValues            = 1;
+    OPTIX_UTIL_CHECK( key != optixUtilComputeModuleCacheKey( otherModuleOptions, pipelineOptions, ptx.data(),
+                                                             ptx.size() ) );
+
+    // 8 distinct modules of different sizes, 3 duplicates and one module that fails to compile, on 3 threads.
+    // Duplicates share the module of their first request, the failure is reported and not cached.
+    std::vector<std::string> sources;
+    for( int m = 0; m < 8; ++m )
+        sources.push_back( "module " + std::to_string( m ) + std::string( 100 * ( m * 5 % 8 ), ' ' ) );
+    sources.push_back( "flaky module" );
+    std::vector<OptixUtilModuleRequest> requests;
+    for( size_t s : {0, 1, 2, 3, 4, 5, 6, 7, 2, 5, 2, 8} )
+        requests.push_back( {&moduleOptions, &pipelineOptions, sources[s].c_str(), 0} );
+    const size_t                       count = requests.size();
+    std::vector<OptixUtilModuleResult> results( count );
+    OptixUtilModuleCache               cache;
+    OptixUtilModuleCompileReport       report;
+    OPTIX_UTIL_CHECK( optixUtilCompileModules( api, deviceContext( 1 ), cache, requests.data(), count, results.data(),
+                                               &report, 3 )
+                      == OPTIX_ERROR_INVALID_PTX );
+    OPTIX_UTIL_CHECK( report.numRequests == 12 && report.numHits == 0 && report.numDeduplicated == 3 );
+    OPTIX_UTIL_CHECK( report.numCompiled == 9 && report.numFailed == 1 && s_numCompiled == 8 );
+    OPTIX_UTIL_CHECK( s_maxInFlight == 3 && cache.size() == 8 );
+    OPTIX_UTIL_CHECK( results[10].module == results[2].module && results[10].cacheHit && !results[2].cacheHit );
+    OPTIX_UTIL_CHECK( results[2].key == results[8].key && results[2].module != results[3].module );
+    OPTIX_UTIL_CHECK( results[11].result == OPTIX_ERROR_INVALID_PTX && !results[11].module );
+    OPTIX_UTIL_CHECK( !cache.find( results[11].key ) && cache.find( results[4].key ) == results[4].module );
+    OPTIX_UTIL_CHECK( cache.errorLog() == "request 11:\ninvalid instruction\n" );
+
+    // Second pass: all modules that compiled are hits, and the failed request is compiled again.
+    s_failFlaky = false;
+    OPTIX_UTIL_CHECK_SUCCESS( optixUtilCompileModules( api, deviceContext( 1 ), cache, requests.data(), count,
+                                                       results.data(), &report, 3 ) );
+    OPTIX_UTIL_CHECK( report.numHits == 11 && report.numCompiled == 1 && report.numFailed == 0 );
+    OPTIX_UTIL_CHECK( s_numCompiled == 9 && cache.size() == 9 && cache.errorLog().empty() );
+    OPTIX_UTIL_CHECK( results[11].result == OPTIX_SUCCESS && !results[11].cacheHit && results[11].module );
+    OPTIX_UTIL_CHECK( results[0].cacheHit && results[0].compileMilliseconds == 0.0 && report.savedMilliseconds > 0.0 );
+    OPTIX_UTIL_CHECK( cache.stats().numHits == 14 && cache.stats().numMisses == 10 && cache.stats().numFailed == 1 );
+
+    // Misses are compiled largest PTX first.
+    OptixUtilModuleCache serial;
+    s_compileOrder.clear();
+    OPTIX_UTIL_CHECK_SUCCESS( optixUtilCompileModules( api, deviceContext( 2 ), serial, requests.data(), 8,
+                                                       results.data(), nullptr, 1 ) );
+    bool largestFirst = s_compileOrder.size() == 8;
+    for( size_t i = 1; i < s_compileOrder.size(); ++i )
+        largestFirst = largestFirst && s_compileOrder[i - 1] > s_compileOrder[i];
+    OPTIX_UTIL_CHECK( largestFirst );
+
+    // Edge cases: missing PTX and a cache of another context are rejected, empty batches succeed.
+    requests[3].ptx = nullptr;
+    OPTIX_UTIL_CHECK( optixUtilCompileModules( api, deviceContext( 1 ), cache, requests.data(), count, results.data() )
+                      == OPTIX_ERROR_INVALID_VALUE );
+    OPTIX_UTIL_CHECK( optixUtilCompileModules( api, deviceContext( 2 ), cache, nullptr, 0, nullptr )
+                      == OPTIX_ERROR_INVALID_VALUE );
+    OPTIX_UTIL_CHECK_SUCCESS( optixUtilCompileModules( api, deviceContext( 1 ), cache, nullptr, 0, nullptr ) );
+
+    // Releasing destroys every cached module once and unbinds the context.
+    OPTIX_UTIL_CHECK_SUCCESS( optixUtilReleaseModuleCache( api, cache ) );
+    OPTIX_UTIL_CHECK( s_numDestroyed == 9 && cache.size() == 0 );
+    OPTIX_UTIL_CHECK_SUCCESS( optixUtilCompileModules( api, deviceContext( 2 ), cache, nullptr, 0, nullptr ) );
+    OPTIX_UTIL_CHECK_SUCCESS( optixUtilReleaseModuleCache( api, serial ) );
+
+    return optix_util_test::finish();
+}
@@ -0,0 +1,100 @@
+#include "optix_util_test.h"
+
+#include <optix_util_motion_bounds.h>
+
+#include <cmath>
+#include <vector>
+
+/// True if inner lies within outer.
+static bool containsAabb( const OptixAabb& outer, const OptixAabb& inner )
+{
+    return outer.minX <= inner.minX && outer.minY <= inner.minY && outer.minZ <= inner.minZ
+           && outer.maxX >= inner.maxX && outer.maxY >= inner.maxY && outer.maxZ >= inner.maxZ;
+}
+
+/// Identity SRT key with a rotation of angle about z and a translation along x.
+static OptixSRTData srtKey( float angle, float tx )
+{
+    return {1.f, 0.f, 0.f, 0.f, 1.f, 0.f, 0.f, 1.f, 0.f, 0.f, 0.f, std::sin( angle / 2 ), std::cos( angle / 2 ),
+            tx,  0.f, 0.f};
+}
+
+int main()
+{
+    using optix_util_impl::transformAabb;
+
+    const OptixAabb              unit    = {-1.f, -1.f, -1.f, 1.f, 1.f, 1.f};
+    OptixUtilMotionBoundsOptions options = {0.01f, 0, 1};
+    OptixUtilMotionBoundsReport  report;
+    OptixAabb                    bounds;
+
+    // Known answers: a static scale and translation, and a matrix translation whose key union is exact.
+    OptixStaticTransform static_   = {};
+    const float          scale[12] = {2.f, 0.f, 0.f, 1.f, 0.f, 2.f, 0.f, 2.f, 0.f, 0.f, 2.f, 3.f};
+    std::memcpy( static_.transform, scale, sizeof( scale ) );
+    OptixUtilMotionBoundsInput input = {OPTIX_TRAVERSABLE_TYPE_STATIC_TRANSFORM, &static_, unit};
+    OPTIX_UTIL_CHECK_SUCCESS( optixUtilComputeMotionBounds( &input, 1, options, &bounds, &report ) );
+    OPTIX_UTIL_CHECK( std::fabs( bounds.minX + 1.f ) < 1e-5f && std::fabs( bounds.maxZ - 5.f ) < 1e-5f );
+    OPTIX_UTIL_CHECK( containsAabb( bounds, {-1.f, 0.f, 1.f, 3.f, 4.f, 5.f} ) );
+
+    OptixMatrixMotionTransform matrix    = {};
+    const float                moved[12] = {1.f, 0.f, 0.f, 10.f, 0.f, 1.f, 0.f, 0.f, 0.f, 0.f, 1.f, 0.f};
+    optixUtilSetIdentityMatrix( matrix.transform[0] );
+    std::memcpy( matrix.transform[1], moved, sizeof( moved ) );
+    matrix.motionOptions.numKeys = 2;
+    input                        = {OPTIX_TRAVERSABLE_TYPE_MATRIX_MOTION_TRANSFORM, &matrix, unit};
+    OPTIX_UTIL_CHECK_SUCCESS( optixUtilComputeMotionBounds( &input, 1, options, &bounds, &report ) );
+    OPTIX_UTIL_CHECK( containsAabb( bounds, {-1.f, -1.f, -1.f, 11.f, 1.f, 1.f} ) && bounds.maxX < 11.001f );
+    OPTIX_UTIL_CHECK( report.volume >= report.keyUnionVolume && report.numSubIntervals == 1 );
+
+    // Half a turn about z of a box 5 units off the axis. The key boxes lie on the x axis, but the box sweeps through
+    // y = 5 at mid-motion. The bounds contain the box at 1000 interpolated times and stay within the tolerance.
+    OptixSRTMotionTransform srt     = {};
+    const OptixAabb         offAxis = {4.9f, -0.1f, -0.1f, 5.1f, 0.1f, 0.1f};
+    srt.motionOptions.numKeys       = 2;
+    srt.srtData[0]                  = srtKey( 0.f, 0.f );
+    srt.srtData[1]                  = srtKey( 3.14159265f, 0.f );
+    input                           = {OPTIX_TRAVERSABLE_TYPE_SRT_MOTION_TRANSFORM, &srt, offAxis};
+    OPTIX_UTIL_CHECK_SUCCESS( optixUtilComputeMotionBounds( &input, 1, options, &bounds, &report ) );
+    bool contained = true;
+    for( int i = 0; i <= 1000; ++i )
+    {
+        OptixSRTData key;
+        float        m[12];
+        optixUtilInterpolateSrtKey( key, srt.srtData[0], srt.srtData[1], i / 1000.f );
+        optixUtilGetMatrixFromSrt( m, key );
+        contained = contained && containsAabb( bounds, transformAabb( m, offAxis ) );
+    }
+    OPTIX_UTIL_CHECK( contained && bounds.maxY > 5.09f && bounds.maxY < 5.1f + 2 * options.tolerance );
+    OPTIX_UTIL_CHECK( report.keyUnionVolume < report.sampledVolume && report.sampledVolume <= report.volume );
+    OPTIX_UTIL_CHECK( report.numSubIntervals > 2 );
+
+    // Parallel inputs give the same bounds as serial ones. A translation under SRT motion is not subdivided.
+    std::vector<OptixSRTMotionTransform>    transforms( 1000, srt );
+    std::vector<OptixUtilMotionBoundsInput> inputs( 1000 );
+    for( size_t i = 0; i < inputs.size(); ++i )
+    {
+        transforms[i].srtData[1] = srtKey( 0.003f * i, 0.01f * i );
+        inputs[i]                = {OPTIX_TRAVERSABLE_TYPE_SRT_MOTION_TRANSFORM, &transforms[i], offAxis};
+    }
+    std::vector<OptixAabb>                   serial( inputs.size() ), parallel( inputs.size() );
+    std::vector<OptixUtilMotionBoundsReport> reports( inputs.size() );
+    OPTIX_UTIL_CHECK_SUCCESS( optixUtilComputeMotionBounds( inputs.data(), inputs.size(), options, serial.data() ) );
+    options.maxThreads = 4;
+    OPTIX_UTIL_CHECK_SUCCESS(
+        optixUtilComputeMotionBounds( inputs.data(), inputs.size(), options, parallel.data(), reports.data() ) );
+    OPTIX_UTIL_CHECK( std::memcmp( serial.data(), parallel.data(), serial.size() * sizeof( OptixAabb ) ) == 0 );
+    OPTIX_UTIL_CHECK( reports[0].numSubIntervals == 1 && reports[999].numSubIntervals > 1 );
+
+    // Edge cases: missing transforms, unknown traversable types and negative tolerances are rejected.
+    input = {OPTIX_TRAVERSABLE_TYPE_SRT_MOTION_TRANSFORM, nullptr, unit};
+    OPTIX_UTIL_CHECK( optixUtilComputeMotionBounds( &input, 1, options, &bounds ) == OPTIX_ERROR_INVALID_VALUE );
+    input = {(OptixTraversableType)0, &srt, unit};
+    OPTIX_UTIL_CHECK( optixUtilComputeMotionBounds( &input, 1, options, &bounds ) == OPTIX_ERROR_INVALID_VALUE );
+    options.tolerance = -1.f;
+    input             = {OPTIX_TRAVERSABLE_TYPE_SRT_MOTION_TRANSFORM, &srt, unit};
+    OPTIX_UTIL_CHECK( optixUtilComputeMotionBounds( &input, 1, options, &bounds ) == OPTIX_ERROR_INVALID_VALUE );
+    OPTIX_UTIL_CHECK_SUCCESS( optixUtilComputeMotionBounds( nullptr, 0, options, nullptr ) );
+
+    return optix_util_test::finish();
+}
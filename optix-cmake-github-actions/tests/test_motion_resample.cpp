@@ -0,0 +1,110 @@
+#include "optix_util_test.h"
+
+#include <optix_util_motion_resample.h>
+
+#include <cmath>
+#include <vector>
+
+int main()
+{
+    // Source: 40 keys at non-uniform times t = u^2, rotating 1.5 radians about z while translating 3 units along x.
+    const unsigned int n = 40;
+    float              times[n];
+    OptixSRTData       srt[n];
+    std::vector<float> matrices( 12 * n );
+    for( unsigned int i = 0; i < n; ++i )
+    {
+        const float u = (float)i / ( n - 1 );
+        times[i]      = u * u;
+        const float a = 1.5f * times[i];
+        const OptixSRTData key = {1.f, 0.f, 0.f, 0.f, 1.f, 0.f, 0.f, 1.f, 0.f, 0.f, 0.f, std::sin( a / 2 ),
+                                  std::cos( a / 2 ), 3.f * times[i], 0.f, 0.f};
+        srt[i] = key;
+        optixUtilGetMatrixFromSrt( &matrices[12 * i], srt[i] );
+    }
+
+    OptixUtilMotionResampleOptions options = {};
+    options.tolerance                      = 0.01f;
+    options.bounds                         = {-1.f, -1.f, -1.f, 1.f, 1.f, 1.f};
+
+    // Known answer: a translation linear in time needs exactly 2 keys, whatever the source key times.
+    {
+        std::vector<float> linear( 12 * n );
+        for( unsigned int i = 0; i < n; ++i )
+        {
+            const float m[12] = {1.f, 0.f, 0.f, 3.f * times[i], 0.f, 1.f, 0.f, -times[i], 0.f, 0.f, 1.f, 0.f};
+            std::memcpy( &linear[12 * i], m, sizeof( m ) );
+        }
+        std::vector<float>            out;
+        OptixMotionOptions            motion;
+        OptixUtilMotionResampleReport report;
+        OPTIX_UTIL_CHECK_SUCCESS( optixUtilResampleMatrixMotionKeys( times, linear.data(), n, options, out, &motion,
+                                                                     &report ) );
+        OPTIX_UTIL_CHECK( motion.numKeys == 2 && motion.timeBegin == 0.f && motion.timeEnd == 1.f );
+        OPTIX_UTIL_CHECK( report.withinTolerance && report.maxError < 1e-5f );
+        OPTIX_UTIL_CHECK( out.size() == 24 && out[3] == 0.f && out[15] == 3.f );
+    }
+
+    // The rotation needs more keys. The search returns a count within the tolerance, and one key less is not.
+    for( int kind = 0; kind < 2; ++kind )
+    {
+        std::vector<float>            outMatrices;
+        std::vector<OptixSRTData>     outSrt;
+        OptixMotionOptions            motion;
+        OptixUtilMotionResampleReport report;
+        auto resample = [&]( const OptixUtilMotionResampleOptions& o ) {
+            return kind ? optixUtilResampleSrtMotionKeys( times, srt, n, o, outSrt, &motion, &report ) :
+                          optixUtilResampleMatrixMotionKeys( times, matrices.data(), n, o, outMatrices, &motion,
+                                                             &report );
+        };
+        OPTIX_UTIL_CHECK_SUCCESS( resample( options ) );
+        const unsigned int numKeys = report.outputKeyCount;
+        OPTIX_UTIL_CHECK( report.withinTolerance && report.maxError <= options.tolerance );
+        OPTIX_UTIL_CHECK( motion.numKeys == report.outputKeyCount && report.outputKeyCount > 2 );
+        OPTIX_UTIL_CHECK( kind ? outSrt.size() == motion.numKeys : outMatrices.size() == 12u * motion.numKeys );
+
+        OptixUtilMotionResampleOptions capped = options;
+        capped.maxKeys                        = numKeys - 1;
+        OPTIX_UTIL_CHECK_SUCCESS( resample( capped ) );
+        OPTIX_UTIL_CHECK( !report.withinTolerance && report.outputKeyCount == capped.maxKeys );
+
+        // Unreachable tolerances stop at the default cap, or at 65535 for larger caps, without trying every count.
+        OptixUtilMotionResampleOptions exact = options;
+        exact.tolerance                      = 1e-9f;
+        OPTIX_UTIL_CHECK_SUCCESS( resample( exact ) );
+        OPTIX_UTIL_CHECK( report.outputKeyCount == OPTIX_UTIL_DEFAULT_MAX_MOTION_KEYS && !report.withinTolerance );
+        exact.maxKeys = 100000;
+        OPTIX_UTIL_CHECK_SUCCESS( resample( exact ) );
+        OPTIX_UTIL_CHECK( report.outputKeyCount <= 65535 && motion.numKeys == report.outputKeyCount );
+    }
+
+    // Emitted transforms start at OPTIX_TRANSFORM_BYTE_ALIGNMENT offsets and hold the resampled keys.
+    std::vector<float>         outMatrices;
+    OptixMotionOptions         motion;
+    std::vector<unsigned char> blob( 1 );
+    size_t                     offset = 0;
+    OPTIX_UTIL_CHECK_SUCCESS( optixUtilResampleMatrixMotionKeys( times, matrices.data(), n, options, outMatrices,
+                                                                 &motion ) );
+    OPTIX_UTIL_CHECK_SUCCESS( optixUtilAppendMatrixMotionTransform( blob, 7, motion, outMatrices.data(), &offset ) );
+    OPTIX_UTIL_CHECK( offset == OPTIX_TRANSFORM_BYTE_ALIGNMENT );
+    OPTIX_UTIL_CHECK( blob.size() == offset + optixUtilMatrixMotionTransformSize( motion.numKeys ) );
+    OptixMatrixMotionTransform header;
+    std::memcpy( &header, &blob[offset], sizeof( header ) );
+    OPTIX_UTIL_CHECK( header.child == 7 && header.motionOptions.numKeys == motion.numKeys );
+    OPTIX_UTIL_CHECK( std::memcmp( &blob[offset + offsetof( OptixMatrixMotionTransform, transform )],
+                                   outMatrices.data(), sizeof( float ) * outMatrices.size() ) == 0 );
+
+    // Edge cases: decreasing times, a single key and negative tolerances are rejected.
+    float                     badTimes[2] = {1.f, 0.f};
+    std::vector<OptixSRTData> outSrt;
+    OPTIX_UTIL_CHECK( optixUtilResampleSrtMotionKeys( badTimes, srt, 2, options, outSrt, &motion )
+                      == OPTIX_ERROR_INVALID_VALUE );
+    OPTIX_UTIL_CHECK( optixUtilResampleSrtMotionKeys( times, srt, 1, options, outSrt, &motion )
+                      == OPTIX_ERROR_INVALID_VALUE );
+    OptixUtilMotionResampleOptions negative = options;
+    negative.tolerance                      = -1.f;
+    OPTIX_UTIL_CHECK( optixUtilResampleSrtMotionKeys( times, srt, n, negative, outSrt, &motion )
+                      == OPTIX_ERROR_INVALID_VALUE );
+
+    return optix_util_test::finish();
+}
@@ -0,0 +1,182 @@
+#include "optix_util_test.h"
+
+#include <optix_util_refit_policy.h>
+
+#include <cmath>
+#include <cstdio>
+#include <cstring>
+#include <string>
+#include <vector>
+
+/// Indexed grid of 2 * r * r triangles on the unit square in the z = 0 plane.
+struct Grid
+{
+    unsigned int              r;
+    std::vector<float>        vertices;
+    std::vector<unsigned int> indices;
+
+    explicit Grid( unsigned int resolution )
+        : r( resolution )
+        , vertices( ( r + 1 ) * ( r + 1 ) * 3 )
+    {
+        for( unsigned int y = 0; y <= r; ++y )
+            for( unsigned int x = 0; x <= r; ++x )
+                set( x, y, (float)x / r, (float)y / r, 0.f );
+        for( unsigned int y = 0; y < r; ++y )
+        {
+            for( unsigned int x = 0; x < r; ++x )
+            {
+                const unsigned int v = y * ( r + 1 ) + x;
+                indices.insert( indices.end(), {v, v + 1, v + r + 1, v + 1, v + r + 2, v + r + 1} );
+            }
+        }
+    }
+
+    void set( unsigned int x, unsigned int y, float px, float py, float pz )
+    {
+        float* p = &vertices[( y * ( r + 1 ) + x ) * 3];
+        p[0]     = px;
+        p[1]     = py;
+        p[2]     = pz;
+    }
+
+    OptixUtilMeshInput mesh() const
+    {
+        return {vertices.data(), ( r + 1 ) * ( r + 1 ), 0, indices.data(), 2 * r * r};
+    }
+};
+
+int main()
+{
+    OptixUtilRefitPolicy  policy = {};
+    OptixUtilRefitTracker tracker;
+    OptixUtilRefitReport  report;
+
+    // Known answer: the first decision builds, and rigid motion with uniform scaling refits with no inflation and no
+    // relative displacement.
+    Grid grid( 32 );
+    OPTIX_UTIL_CHECK_SUCCESS( optixUtilDecideRefit( tracker, grid.mesh(), policy, &report ) );
+    OPTIX_UTIL_CHECK( report.operation == OPTIX_BUILD_OPERATION_BUILD );
+    OPTIX_UTIL_CHECK( report.reason == OPTIX_UTIL_REFIT_REASON_NEW_GEOMETRY && report.consecutiveRefits == 0 );
+    OPTIX_UTIL_CHECK( tracker.memoryInBytes() >= 16 * 2048 );
+    for( size_t i = 0; i < grid.vertices.size(); ++i )
+        grid.vertices[i] = 2.f * grid.vertices[i] + ( i % 3 == 0 ? 5.f : 0.f );
+    OPTIX_UTIL_CHECK_SUCCESS( optixUtilDecideRefit( tracker, grid.mesh(), policy, &report ) );
+    OPTIX_UTIL_CHECK( report.operation == OPTIX_BUILD_OPERATION_UPDATE );
+    OPTIX_UTIL_CHECK( report.reason == OPTIX_UTIL_REFIT_REASON_NONE );
+    OPTIX_UTIL_CHECK( report.boundsInflation < 1e-5f && report.relativeDisplacement < 1e-5f );
+    OPTIX_UTIL_CHECK( report.maxDisplacement > 1.f && report.consecutiveRefits == 1 );
+
+    // Lifting half of the grid moves the triangles apart from each other without stretching most clusters.
+    Grid                  lifted( 32 );
+    OptixUtilRefitTracker liftedTracker;
+    OPTIX_UTIL_CHECK_SUCCESS( optixUtilDecideRefit( liftedTracker, lifted.mesh(), policy ) );
+    for( unsigned int y = 0; y <= 32; ++y )
+        for( unsigned int x = 17; x <= 32; ++x )
+            lifted.set( x, y, x / 32.f, y / 32.f, 0.5f );
+    OPTIX_UTIL_CHECK_SUCCESS( optixUtilDecideRefit( liftedTracker, lifted.mesh(), policy, &report ) );
+    OPTIX_UTIL_CHECK( report.reason == OPTIX_UTIL_REFIT_REASON_DISPLACEMENT && report.relativeDisplacement > 0.1f );
+    OPTIX_UTIL_CHECK( report.boundsInflation < 0.5f && liftedTracker.consecutiveRefits() == 0 );
+
+    // Swapping columns stretches every triangle across the grid, which inflates the clusters.
+    Grid                  swapped( 32 );
+    OptixUtilRefitTracker swappedTracker;
+    OPTIX_UTIL_CHECK_SUCCESS( optixUtilDecideRefit( swappedTracker, swapped.mesh(), policy ) );
+    for( unsigned int y = 0; y <= 32; ++y )
+        for( unsigned int x = 0; x <= 32; ++x )
+            swapped.set( x, y, ( x * 13 % 33 ) / 32.f, y / 32.f, 0.f );
+    OPTIX_UTIL_CHECK_SUCCESS( optixUtilDecideRefit( swappedTracker, swapped.mesh(), policy, &report ) );
+    OPTIX_UTIL_CHECK( report.reason == OPTIX_UTIL_REFIT_REASON_BOUNDS_INFLATION && report.boundsInflation > 0.5f );
+
+    // The refit limit forces a build after maxConsecutiveRefits refits, and a reset or a new triangle count builds.
+    policy.maxConsecutiveRefits = 2;
+    OptixUtilRefitReason reasons[4];
+    for( int i = 0; i < 4; ++i )
+    {
+        OPTIX_UTIL_CHECK_SUCCESS( optixUtilDecideRefit( tracker, grid.mesh(), policy, &report ) );
+        reasons[i] = report.reason;
+    }
+    OPTIX_UTIL_CHECK( reasons[0] == OPTIX_UTIL_REFIT_REASON_NONE && reasons[1] == OPTIX_UTIL_REFIT_REASON_MAX_REFITS );
+    OPTIX_UTIL_CHECK( reasons[2] == OPTIX_UTIL_REFIT_REASON_NONE && reasons[3] == OPTIX_UTIL_REFIT_REASON_NONE );
+    tracker.reset();
+    OPTIX_UTIL_CHECK_SUCCESS( optixUtilDecideRefit( tracker, grid.mesh(), policy, &report ) );
+    OPTIX_UTIL_CHECK( report.reason == OPTIX_UTIL_REFIT_REASON_NEW_GEOMETRY );
+    OptixUtilMeshInput fewer = grid.mesh();
+    fewer.numTriangles -= 1;
+    OPTIX_UTIL_CHECK_SUCCESS( optixUtilDecideRefit( tracker, fewer, policy, &report ) );
+    OPTIX_UTIL_CHECK( report.reason == OPTIX_UTIL_REFIT_REASON_NEW_GEOMETRY );
+
+    // 131072 triangles, enough for parallel processing. Any thread count gives the serial statistics.
+    policy = {};
+    Grid                  large( 256 );
+    OptixUtilRefitTracker serialTracker, parallelTracker;
+    OptixUtilRefitReport  serialReport, parallelReport;
+    OPTIX_UTIL_CHECK_SUCCESS( optixUtilDecideRefit( serialTracker, large.mesh(), policy, nullptr, 1 ) );
+    OPTIX_UTIL_CHECK_SUCCESS( optixUtilDecideRefit( parallelTracker, large.mesh(), policy, nullptr, 4 ) );
+    for( unsigned int y = 0; y <= 256; ++y )
+        for( unsigned int x = 0; x <= 256; ++x )
+            large.set( x, y, x / 256.f, y / 256.f, 0.05f * std::sin( 0.1f * x ) * std::cos( 0.07f * y ) );
+    OPTIX_UTIL_CHECK_SUCCESS( optixUtilDecideRefit( serialTracker, large.mesh(), policy, &serialReport, 1 ) );
+    OPTIX_UTIL_CHECK_SUCCESS( optixUtilDecideRefit( parallelTracker, large.mesh(), policy, &parallelReport, 4 ) );
+    OPTIX_UTIL_CHECK( serialReport.reason == parallelReport.reason );
+    OPTIX_UTIL_CHECK( serialReport.boundsInflation == parallelReport.boundsInflation );
+    OPTIX_UTIL_CHECK( serialReport.relativeDisplacement == parallelReport.relativeDisplacement );
+    OPTIX_UTIL_CHECK( serialReport.maxDisplacement == parallelReport.maxDisplacement );
+    OPTIX_UTIL_CHECK( serialReport.relativeDisplacement > 0.f && serialReport.boundsInflation > 0.f );
+
+    // Batches log one entry per GAS, and the temp memory follows the operation of each GAS.
+    OptixUtilRefitTracker               trackers[3];
+    const OptixUtilMeshInput            meshes[3] = {grid.mesh(), lifted.mesh(), swapped.mesh()};
+    OptixUtilRefitReport                reports[3];
+    std::vector<OptixUtilRefitLogEntry> log;
+    OPTIX_UTIL_CHECK_SUCCESS( optixUtilDecideRefits( trackers, meshes, 3, policy, reports, &log, 7 ) );
+    OPTIX_UTIL_CHECK_SUCCESS( optixUtilDecideRefits( trackers, meshes, 3, policy, reports, &log, 8 ) );
+    OPTIX_UTIL_CHECK( log.size() == 6 && log[5].frame == 8 && log[5].gasIndex == 2 );
+    OPTIX_UTIL_CHECK( reports[0].operation == OPTIX_BUILD_OPERATION_UPDATE );
+    const OptixAccelBufferSizes sizes[3] = {{1000, 300, 20}, {2000, 500, 40}, {3000, 700, 60}};
+    size_t                      tempSizes[3], maxTemp, totalTemp;
+    reports[1].operation = OPTIX_BUILD_OPERATION_BUILD;
+    OPTIX_UTIL_CHECK_SUCCESS( optixUtilComputeRefitTempSizes( reports, sizes, 3, tempSizes, maxTemp, &totalTemp ) );
+    OPTIX_UTIL_CHECK( tempSizes[0] == 20 && tempSizes[1] == 500 && maxTemp == 500 && totalTemp == 580 );
+
+    // The log is written as tab separated text.
+    FILE* file = std::tmpfile();
+    OPTIX_UTIL_CHECK( file != nullptr );
+    if( file )
+    {
+        OPTIX_UTIL_CHECK_SUCCESS( optixUtilWriteRefitLog( file, log.data(), 1, 1 ) );
+        std::rewind( file );
+        char text[256] = {};
+        OPTIX_UTIL_CHECK( std::fread( text, 1, sizeof( text ) - 1, file ) > 0 );
+        std::fclose( file );
+        OPTIX_UTIL_CHECK( std::string( text ).compare( 0, 10, "frame\tgas\t" ) == 0 );
+        OPTIX_UTIL_CHECK( std::strstr( text, "\n7\t0\tbuild\tnew geometry\t" ) != nullptr );
+    }
+
+    // Edge cases: missing vertices, short strides, out of range indices, too few vertices for a non-indexed mesh,
+    // missing batch arrays and files are rejected. Empty batches and triangle soups with enough vertices succeed.
+    OptixUtilMeshInput invalid = grid.mesh();
+    invalid.vertices           = nullptr;
+    OPTIX_UTIL_CHECK( optixUtilDecideRefit( tracker, invalid, policy ) == OPTIX_ERROR_INVALID_VALUE );
+    invalid                     = grid.mesh();
+    invalid.vertexStrideInBytes = 8;
+    OPTIX_UTIL_CHECK( optixUtilDecideRefit( tracker, invalid, policy ) == OPTIX_ERROR_INVALID_VALUE );
+    Grid broken( 4 );
+    broken.indices[17] = 25;
+    OPTIX_UTIL_CHECK( optixUtilDecideRefit( tracker, broken.mesh(), policy ) == OPTIX_ERROR_INVALID_VALUE );
+    invalid              = grid.mesh();
+    invalid.indices      = nullptr;
+    invalid.numTriangles = invalid.numVertices / 3 + 1;
+    OPTIX_UTIL_CHECK( optixUtilDecideRefit( tracker, invalid, policy ) == OPTIX_ERROR_INVALID_VALUE );
+    invalid.numTriangles = invalid.numVertices / 3;
+    OptixUtilRefitTracker soup;
+    OPTIX_UTIL_CHECK_SUCCESS( optixUtilDecideRefit( soup, invalid, policy ) );
+    OPTIX_UTIL_CHECK( optixUtilDecideRefits( nullptr, meshes, 3, policy, reports ) == OPTIX_ERROR_INVALID_VALUE );
+    OPTIX_UTIL_CHECK_SUCCESS( optixUtilDecideRefits( nullptr, nullptr, 0, policy, nullptr ) );
+    OPTIX_UTIL_CHECK( optixUtilComputeRefitTempSizes( nullptr, sizes, 3, tempSizes, maxTemp )
+                      == OPTIX_ERROR_INVALID_VALUE );
+    OPTIX_UTIL_CHECK( optixUtilWriteRefitLog( nullptr, log.data(), 1, 1 ) == OPTIX_ERROR_INVALID_VALUE );
+    OPTIX_UTIL_CHECK( std::strcmp( optixUtilRefitReasonString( (OptixUtilRefitReason)99 ), "unknown" ) == 0 );
+
+    return optix_util_test::finish();
+}
@@ -0,0 +1,138 @@
+#include "optix_util_test.h"
+
+#include <optix_util_sbt_builder.h>
+
+#include <cstring>
+#include <vector>
+
+using optix_util_test::headerProgramGroup;
+using optix_util_test::programGroup;
+
+struct RaygenData
+{
+    float eye[3];
+};
+
+struct MissData
+{
+    float color[4];
+};
+
+struct HitgroupData
+{
+    unsigned int material;
+    float        scale;
+};
+
+struct ExceptionData
+{
+    int code;
+};
+
+typedef OptixUtilSbtBuilder<RaygenData, MissData, HitgroupData, OptixUtilSbtEmptyData, ExceptionData> Builder;
+
+static_assert( sizeof( OptixUtilSbtRecord<OptixUtilSbtEmptyData> ) == 32, "records without data are the header" );
+static_assert( sizeof( Builder::RaygenRecord ) == 48 && sizeof( Builder::HitgroupRecord ) == 48,
+               "record strides are rounded up to OPTIX_SBT_RECORD_ALIGNMENT" );
+
+/// 16 byte aligned storage for the blob.
+struct Block
+{
+    alignas( OPTIX_SBT_RECORD_ALIGNMENT ) unsigned char bytes[OPTIX_SBT_RECORD_ALIGNMENT];
+};
+
+int main()
+{
+    const OptixFunctionTable api = optix_util_test::stubFunctionTable();
+
+    // Known answer: the sections follow each other in the order raygen, exception, miss, hitgroup, callables, and the
+    // table points into the blob at its device address. Headers and data are written, the padding is zero.
+    Builder builder;
+    builder.setRaygen( programGroup( 1 ), {{1.f, 2.f, 3.f}} );
+    builder.setException( programGroup( 2 ), {7} );
+    builder.addMiss( programGroup( 3 ), {{0.f, 0.f, 0.f, 1.f}} );
+    OPTIX_UTIL_CHECK( builder.addMiss( programGroup( 4 ) ) == 1 );
+    for( unsigned int i = 0; i < 3; ++i )
+        OPTIX_UTIL_CHECK( builder.addHitgroup( programGroup( 5 + i % 2 ), {i, 0.5f * i} ) == i );
+    builder.addCallables( programGroup( 7 ) );
+    builder.addCallables( programGroup( 8 ) );
+    size_t offsets[6];
+    builder.sectionOffsets( offsets );
+    const size_t expectedOffsets[6] = {0, 48, 96, 192, 336, 400};
+    OPTIX_UTIL_CHECK( std::memcmp( offsets, expectedOffsets, sizeof( offsets ) ) == 0 && builder.sizeInBytes() == 400 );
+
+    std::vector<Block> blob( 400 / sizeof( Block ) );
+    std::memset( blob.data(), 0xcd, 400 );
+    const unsigned char*    bytes = blob[0].bytes;
+    OptixShaderBindingTable sbt;
+    OptixUtilSbtBuildReport report;
+    OPTIX_UTIL_CHECK_SUCCESS( optixUtilWriteSbt( builder, api, blob.data(), 0x10000, sbt, &report ) );
+    OPTIX_UTIL_CHECK( sbt.raygenRecord == 0x10000 && sbt.exceptionRecord == 0x10030 );
+    OPTIX_UTIL_CHECK( sbt.missRecordBase == 0x10060 && sbt.missRecordStrideInBytes == 48 && sbt.missRecordCount == 2 );
+    OPTIX_UTIL_CHECK( sbt.hitgroupRecordBase == 0x100c0 && sbt.hitgroupRecordStrideInBytes == 48 );
+    OPTIX_UTIL_CHECK( sbt.hitgroupRecordCount == 3 && sbt.callablesRecordBase == 0x10150 );
+    OPTIX_UTIL_CHECK( sbt.callablesRecordStrideInBytes == 32 && sbt.callablesRecordCount == 2 );
+    OPTIX_UTIL_CHECK( report.numRecords == 9 && report.numProgramGroups == 8 && report.sizeInBytes == 400 );
+    const uintptr_t expectedGroups[9] = {1, 2, 3, 4, 5, 6, 5, 7, 8};
+    const size_t    recordOffsets[9]  = {0, 48, 96, 144, 192, 240, 288, 336, 368};
+    bool            headers           = true;
+    for( int r = 0; r < 9; ++r )
+    {
+        const uint64_t expected = (uintptr_t)programGroup( expectedGroups[r] );
+        headers                 = headers && headerProgramGroup( bytes + recordOffsets[r] ) == expected;
+    }
+    OPTIX_UTIL_CHECK( headers );
+    RaygenData   raygen;
+    HitgroupData hitgroup;
+    std::memcpy( &raygen, bytes + OPTIX_SBT_RECORD_HEADER_SIZE, sizeof( raygen ) );
+    std::memcpy( &hitgroup, bytes + 288 + OPTIX_SBT_RECORD_HEADER_SIZE, sizeof( hitgroup ) );
+    OPTIX_UTIL_CHECK( raygen.eye[2] == 3.f && hitgroup.material == 2 && hitgroup.scale == 1.f );
+    bool padding = true;
+    for( size_t b = 288 + OPTIX_SBT_RECORD_HEADER_SIZE + sizeof( HitgroupData ); b < 336; ++b )
+        padding = padding && bytes[b] == 0;
+    OPTIX_UTIL_CHECK( padding && bytes[44] == 0 );
+
+    // findOrAdd returns the record with the same program group and data, and adds one if either differs.
+    Builder dedup;
+    dedup.setRaygen( programGroup( 1 ) );
+    const unsigned int first = dedup.findOrAddHitgroup( programGroup( 5 ), {1, 1.f} );
+    OPTIX_UTIL_CHECK( dedup.findOrAddHitgroup( programGroup( 5 ), {1, 1.f} ) == first );
+    OPTIX_UTIL_CHECK( dedup.findOrAddHitgroup( programGroup( 5 ), {2, 1.f} ) == first + 1 );
+    OPTIX_UTIL_CHECK( dedup.findOrAddHitgroup( programGroup( 6 ), {1, 1.f} ) == first + 2 );
+    OPTIX_UTIL_CHECK( dedup.addHitgroup( programGroup( 5 ), {1, 1.f} ) == first + 3 );
+    OPTIX_UTIL_CHECK( dedup.findOrAddCallables( programGroup( 7 ) ) == dedup.findOrAddCallables( programGroup( 7 ) ) );
+    OPTIX_UTIL_CHECK( dedup.numHitgroupRecords() == 4 && dedup.numCallablesRecords() == 1 );
+    OPTIX_UTIL_CHECK( dedup.numDeduplicated() == 2 );
+    std::vector<Block> dedupBlob( dedup.sizeInBytes() / sizeof( Block ) );
+    OPTIX_UTIL_CHECK_SUCCESS( optixUtilWriteSbt( dedup, api, dedupBlob.data(), 0, sbt, &report ) );
+    OPTIX_UTIL_CHECK( report.numDeduplicated == 2 && report.numRecords == 6 );
+    OPTIX_UTIL_CHECK( sbt.missRecordBase == 0 && sbt.missRecordCount == 0 && sbt.exceptionRecord == 0 );
+
+    // 20000 hitgroups over 100 program groups, enough for parallel assembly. Any thread count writes the serial blob.
+    Builder large;
+    large.setRaygen( programGroup( 1 ) );
+    large.addMiss( programGroup( 2 ) );
+    large.reserveHitgroups( 20000 );
+    for( unsigned int i = 0; i < 20000; ++i )
+        large.addHitgroup( programGroup( 10 + i * 7 % 100 ), {i, 0.25f * i} );
+    std::vector<Block> serial( large.sizeInBytes() / sizeof( Block ) ), parallel( serial.size() );
+    std::memset( serial.data(), 0xab, large.sizeInBytes() );
+    OPTIX_UTIL_CHECK_SUCCESS( optixUtilWriteSbt( large, api, serial.data(), 0x20000, sbt, &report, 1 ) );
+    OPTIX_UTIL_CHECK( report.numProgramGroups == 102 && report.numRecords == 20002 );
+    OPTIX_UTIL_CHECK_SUCCESS( optixUtilWriteSbt( large, api, parallel.data(), 0x20000, sbt, &report, 4 ) );
+    OPTIX_UTIL_CHECK( std::memcmp( serial.data(), parallel.data(), large.sizeInBytes() ) == 0 );
+    const unsigned char* last = serial[0].bytes + ( sbt.hitgroupRecordBase - 0x20000 ) + 19999 * 48;
+    std::memcpy( &hitgroup, last + OPTIX_SBT_RECORD_HEADER_SIZE, sizeof( hitgroup ) );
+    OPTIX_UTIL_CHECK( hitgroup.material == 19999 && headerProgramGroup( last ) == (uintptr_t)programGroup( 103 ) );
+
+    // Edge cases: a missing raygen record and misaligned blobs or device addresses are rejected. Clearing removes
+    // all records.
+    OPTIX_UTIL_CHECK( optixUtilWriteSbt( builder, api, blob[0].bytes + 8, 0x10000, sbt ) == OPTIX_ERROR_INVALID_VALUE );
+    OPTIX_UTIL_CHECK( optixUtilWriteSbt( builder, api, blob.data(), 0x10008, sbt ) == OPTIX_ERROR_INVALID_VALUE );
+    OPTIX_UTIL_CHECK( optixUtilWriteSbt( builder, api, nullptr, 0x10000, sbt ) == OPTIX_ERROR_INVALID_VALUE );
+    builder.clear();
+    OPTIX_UTIL_CHECK( builder.sizeInBytes() == 0 && !builder.hasRaygen() && builder.numDeduplicated() == 0 );
+    OPTIX_UTIL_CHECK( optixUtilWriteSbt( builder, api, blob.data(), 0x10000, sbt ) == OPTIX_ERROR_INVALID_VALUE );
+
+    return optix_util_test::finish();
+}
@@ -0,0 +1,142 @@
+#include "optix_util_test.h"
+
+#include <optix_util_sbt_builder.h>
+#include <optix_util_sbt_header_cache.h>
+#include <optix_util_sbt_update.h>
+
+#include <cstring>
+#include <vector>
+
+using optix_util_test::headerProgramGroup;
+using optix_util_test::programGroup;
+
+struct Material
+{
+    float color[4];
+};
+
+/// 16 byte aligned storage for record arrays.
+struct Block
+{
+    alignas( OPTIX_SBT_RECORD_ALIGNMENT ) unsigned char bytes[OPTIX_SBT_RECORD_ALIGNMENT];
+};
+
+static OptixResult failingPackHeader( OptixProgramGroup, void* )
+{
+    return OPTIX_ERROR_INVALID_VALUE;
+}
+
+static OptixResult destroyProgramGroup( OptixProgramGroup )
+{
+    return OPTIX_SUCCESS;
+}
+
+int main()
+{
+    // Known answer: a header is packed on the first request only and matches optixSbtRecordPackHeader().
+    OptixFunctionTable      api = optix_util_test::stubFunctionTable();
+    OptixUtilSbtHeaderCache cache;
+    const char*             header = nullptr;
+    char                    expected[OPTIX_SBT_RECORD_HEADER_SIZE];
+    optix_util_test::packHeader( programGroup( 7 ), expected );
+    OPTIX_UTIL_CHECK_SUCCESS( cache.get( api, programGroup( 7 ), &header ) );
+    OPTIX_UTIL_CHECK( std::memcmp( header, expected, OPTIX_SBT_RECORD_HEADER_SIZE ) == 0 );
+    OPTIX_UTIL_CHECK_SUCCESS( cache.get( api, programGroup( 7 ), &header ) );
+    OPTIX_UTIL_CHECK( cache.size() == 1 && cache.numPacked() == 1 );
+
+    // 200000 records of 48 bytes over 300 program groups in runs of 1 to 7 records, enough for several threads and
+    // several rehashes. The vector stores agree with a memcpy of the packed header and leave the data untouched, with
+    // any thread count.
+    const size_t                   count = 200000, stride = 48;
+    std::vector<OptixProgramGroup> programGroups( count );
+    for( size_t i = 0, run = 0; i < count; ++run )
+        for( size_t k = 0; k < 1 + run % 7 && i < count; ++k, ++i )
+            programGroups[i] = programGroup( 1 + run * 37 % 300 );
+    std::vector<Block>            serial( count * stride / sizeof( Block ) ), parallel( serial.size() );
+    OptixUtilSbtHeaderWriteReport report;
+    std::memset( serial.data(), 0xab, count * stride );
+    std::memset( parallel.data(), 0xab, count * stride );
+    OPTIX_UTIL_CHECK_SUCCESS(
+        optixUtilWriteSbtHeaders( cache, api, programGroups.data(), count, serial.data(), stride, &report, 1 ) );
+    OPTIX_UTIL_CHECK( report.numRecords == count && report.numPacked == 299 && cache.size() == 300 );
+    OptixUtilSbtHeaderCache fresh;
+    OPTIX_UTIL_CHECK_SUCCESS(
+        optixUtilWriteSbtHeaders( fresh, api, programGroups.data(), count, parallel.data(), stride, &report, 4 ) );
+    OPTIX_UTIL_CHECK( report.numPacked == 300 && fresh.size() == 300 );
+    OPTIX_UTIL_CHECK( std::memcmp( serial.data(), parallel.data(), count * stride ) == 0 );
+    bool agree = true;
+    for( size_t i = 0; i < count; ++i )
+    {
+        const unsigned char* record = serial[0].bytes + i * stride;
+        optix_util_test::packHeader( programGroups[i], expected );
+        agree = agree && std::memcmp( record, expected, OPTIX_SBT_RECORD_HEADER_SIZE ) == 0;
+        agree = agree && record[OPTIX_SBT_RECORD_HEADER_SIZE] == 0xab && record[stride - 1] == 0xab;
+    }
+    OPTIX_UTIL_CHECK( agree );
+    OPTIX_UTIL_CHECK_SUCCESS(
+        optixUtilWriteSbtHeaders( cache, api, programGroups.data(), count, serial.data(), stride, &report ) );
+    OPTIX_UTIL_CHECK( report.numPacked == 0 );
+
+    // A cache shared by builds and table uploads packs each program group once over all of them.
+    OptixUtilSbtBuilder<OptixUtilSbtEmptyData, Material, Material> builder;
+    builder.setRaygen( programGroup( 1 ) );
+    builder.addMiss( programGroup( 2 ), {{0.f, 0.f, 0.f, 1.f}} );
+    for( unsigned int i = 0; i < 1000; ++i )
+        builder.addHitgroup( programGroup( 400 + i % 5 ), {{(float)i, 0.f, 0.f, 1.f}} );
+    std::vector<Block>      blob( builder.sizeInBytes() / sizeof( Block ) );
+    OptixShaderBindingTable sbt;
+    OptixUtilSbtBuildReport buildReport;
+    OptixUtilSbtHeaderCache shared;
+    OPTIX_UTIL_CHECK_SUCCESS( optixUtilWriteSbt( builder, api, blob.data(), 0x1000, sbt, &buildReport, 0, &shared ) );
+    OPTIX_UTIL_CHECK( buildReport.numProgramGroups == 7 && buildReport.numRecords == 1002 );
+    OPTIX_UTIL_CHECK_SUCCESS( optixUtilWriteSbt( builder, api, blob.data(), 0x1000, sbt, &buildReport, 0, &shared ) );
+    OPTIX_UTIL_CHECK( buildReport.numProgramGroups == 0 && shared.size() == 7 );
+    const unsigned char* hitgroup = blob[0].bytes + ( sbt.hitgroupRecordBase - 0x1000 ) + 999 * 48;
+    float                color;
+    std::memcpy( &color, hitgroup + OPTIX_SBT_RECORD_HEADER_SIZE, sizeof( color ) );
+    OPTIX_UTIL_CHECK( headerProgramGroup( hitgroup ) == (uintptr_t)programGroup( 404 ) && color == 999.f );
+    OPTIX_UTIL_CHECK_SUCCESS( optixUtilWriteSbt( builder, api, blob.data(), 0x1000, sbt, &buildReport ) );
+    OPTIX_UTIL_CHECK( buildReport.numProgramGroups == 7 );
+
+    OptixUtilSbtTable<Material>     table;
+    std::vector<OptixUtilCopyRange> ranges;
+    OptixUtilSbtUploadReport        uploadReport;
+    for( unsigned int i = 0; i < 100; ++i )
+        table.add( programGroup( 400 + i % 6 ), {{(float)i, 0.f, 0.f, 1.f}} );
+    OPTIX_UTIL_CHECK_SUCCESS( optixUtilPrepareSbtUpload( table, api, 0, ranges, &uploadReport, &shared ) );
+    OPTIX_UTIL_CHECK( uploadReport.numHeadersPacked == 1 && shared.size() == 8 );
+    OPTIX_UTIL_CHECK( headerProgramGroup( table.records()[5].header ) == (uintptr_t)programGroup( 405 ) );
+
+    // Destroying a program group drops its header, so a program group reusing the handle is packed again.
+    api.optixProgramGroupDestroy = destroyProgramGroup;
+    OPTIX_UTIL_CHECK_SUCCESS( optixUtilDestroyProgramGroup( shared, api, programGroup( 402 ) ) );
+    OPTIX_UTIL_CHECK( shared.size() == 7 );
+    OPTIX_UTIL_CHECK_SUCCESS( optixUtilWriteSbt( builder, api, blob.data(), 0x1000, sbt, &buildReport, 0, &shared ) );
+    OPTIX_UTIL_CHECK( buildReport.numProgramGroups == 1 && shared.size() == 8 );
+    shared.invalidate( programGroup( 999 ) );
+    OPTIX_UTIL_CHECK( shared.size() == 8 );
+
+    // Edge cases: strides that are not a multiple of the alignment or shorter than the header, misaligned records and
+    // missing arrays are rejected. Failed packs are returned and not cached.
+    OPTIX_UTIL_CHECK( optixUtilWriteSbtHeaders( cache, api, programGroups.data(), 10, serial.data(), 40 )
+                      == OPTIX_ERROR_INVALID_VALUE );
+    OPTIX_UTIL_CHECK( optixUtilWriteSbtHeaders( cache, api, programGroups.data(), 10, serial.data(), 16 )
+                      == OPTIX_ERROR_INVALID_VALUE );
+    OPTIX_UTIL_CHECK( optixUtilWriteSbtHeaders( cache, api, programGroups.data(), 10, serial[0].bytes + 8, 48 )
+                      == OPTIX_ERROR_INVALID_VALUE );
+    OPTIX_UTIL_CHECK( optixUtilWriteSbtHeaders( cache, api, nullptr, 10, serial.data(), 48 )
+                      == OPTIX_ERROR_INVALID_VALUE );
+    OPTIX_UTIL_CHECK_SUCCESS( optixUtilWriteSbtHeaders( cache, api, nullptr, 0, nullptr, 48 ) );
+    OptixFunctionTable failing       = api;
+    failing.optixSbtRecordPackHeader = failingPackHeader;
+    const OptixProgramGroup unknown  = programGroup( 1000 );
+    OPTIX_UTIL_CHECK( optixUtilWriteSbtHeaders( cache, failing, &unknown, 1, serial.data(), 48 )
+                      == OPTIX_ERROR_INVALID_VALUE );
+    OPTIX_UTIL_CHECK( cache.get( failing, unknown, &header ) == OPTIX_ERROR_INVALID_VALUE && cache.size() == 300 );
+    builder.addHitgroup( unknown );
+    blob.resize( builder.sizeInBytes() / sizeof( Block ) );
+    OPTIX_UTIL_CHECK( optixUtilWriteSbt( builder, failing, blob.data(), 0x1000, sbt, nullptr, 0, &shared )
+                      == OPTIX_ERROR_INVALID_VALUE );
+
+    return optix_util_test::finish();
+}
@@ -0,0 +1,108 @@
+#include "optix_util_test.h"
+
+#include <optix_util_sbt_registry.h>
+
+#include <cstring>
+#include <vector>
+
+using optix_util_test::programGroup;
+
+int main()
+{
+    // Two ray types and 8 bytes of record data. Material 2 is identical to material 0 and binding 2 to binding 0.
+    OptixUtilSbtRegistry registry( 2, 8 );
+    double               d1 = 1.0, d2 = 2.0;
+    OptixUtilSbtHitgroup m0[2] = {{programGroup( 1 ), &d1}, {programGroup( 3 ), nullptr}};
+    OptixUtilSbtHitgroup m1[2] = {{programGroup( 2 ), &d2}, {programGroup( 3 ), nullptr}};
+    OptixUtilSbtHitgroup m2[2] = {{programGroup( 1 ), &d1}, {programGroup( 3 ), nullptr}};
+    const unsigned int   a = registry.addMaterial( m0 ), b = registry.addMaterial( m1 ), c = registry.addMaterial( m2 );
+    OPTIX_UTIL_CHECK( a == 0 && b == 1 && c == 0 );
+
+    const unsigned int slots0[3] = {a, b, a}, slots1[1] = {b}, slots2[3] = {a, b, a};
+    const unsigned int b0 = registry.addBinding( slots0, 3 );
+    const unsigned int b1 = registry.addBinding( slots1, 1 );
+    const unsigned int b2 = registry.addBinding( slots2, 3 );
+    OPTIX_UTIL_CHECK( b0 == 0 && b1 == 1 && b2 == 0 );
+    const unsigned int invalid[1] = {5};
+    OPTIX_UTIL_CHECK( registry.addBinding( invalid, 1 ) == ~0u );
+
+    // Known answer: binding 0 owns records [0, 6), binding 1 owns [6, 8).
+    OPTIX_UTIL_CHECK( registry.sbtOffset( b0 ) == 0 && registry.sbtOffset( b1 ) == 6 );
+    OPTIX_UTIL_CHECK( registry.numRecords() == 8 && registry.recordStrideInBytes() == 48 );
+
+    // Categories tested by the same rays share a bit: camera and decal are only tested together.
+    enum
+    {
+        CAMERA     = 0,
+        SHADOW     = 1,
+        REFLECTION = 2,
+        DECAL      = 5,
+        HIDDEN     = 7
+    };
+    const unsigned int cameraRay     = registry.addRayVisibility( ( 1u << CAMERA ) | ( 1u << DECAL ) );
+    const unsigned int shadowRay     = registry.addRayVisibility( 1u << SHADOW );
+    const unsigned int reflectionRay =
+        registry.addRayVisibility( ( 1u << CAMERA ) | ( 1u << REFLECTION ) | ( 1u << DECAL ) );
+    unsigned int rayMasks[3];
+    OPTIX_UTIL_CHECK( optixUtilPackSbtVisibility( registry, 1, nullptr ) == OPTIX_ERROR_INVALID_VALUE );
+    OPTIX_UTIL_CHECK_SUCCESS( optixUtilPackSbtVisibility( registry, 8, rayMasks ) );
+    const unsigned char* bits = registry.categoryBits();
+    OPTIX_UTIL_CHECK( bits[CAMERA] == bits[DECAL] && bits[CAMERA] != bits[SHADOW] && bits[REFLECTION] != bits[CAMERA] );
+    OPTIX_UTIL_CHECK( bits[HIDDEN] == 255 );
+    OPTIX_UTIL_CHECK( rayMasks[cameraRay] == 1u << bits[CAMERA] && rayMasks[shadowRay] == 1u << bits[SHADOW] );
+    OPTIX_UTIL_CHECK( rayMasks[reflectionRay] == ( ( 1u << bits[CAMERA] ) | ( 1u << bits[REFLECTION] ) ) );
+
+    // The first update writes every instance, later ones only the changed instances.
+    const size_t n = 100000;
+    registry.resizeInstances( n );
+    std::vector<unsigned int> offsets( n ), masks( n );
+    for( size_t i = 0; i < n; ++i )
+    {
+        const uint64_t categories = i % 3 == 0 ? ( 1ull << CAMERA ) | ( 1ull << SHADOW ) : 1ull << DECAL;
+        registry.setInstance( i, i % 2 ? b0 : b1, categories );
+    }
+    size_t written = 0;
+    OPTIX_UTIL_CHECK_SUCCESS( optixUtilUpdateInstanceSbt( registry, offsets.data(), masks.data(), &written ) );
+    OPTIX_UTIL_CHECK( written == n && offsets[0] == 6 && offsets[1] == 0 );
+    OPTIX_UTIL_CHECK( masks[0] == ( ( 1u << bits[CAMERA] ) | ( 1u << bits[SHADOW] ) ) );
+    OPTIX_UTIL_CHECK( masks[1] == 1u << bits[DECAL] );
+
+    OPTIX_UTIL_CHECK( !registry.setInstance( 5, 9, 0 ) );
+    registry.setInstance( 5, b0, 0 );
+    registry.setInstance( 7, b0, 1ull << HIDDEN );
+    registry.setInstance( 9, b0, 1ull << DECAL );
+    registry.setInstance( 60000, b1, 1ull << REFLECTION );
+    OPTIX_UTIL_CHECK_SUCCESS( optixUtilUpdateInstanceSbt( registry, offsets.data(), masks.data(), &written ) );
+    OPTIX_UTIL_CHECK( written == 4 );
+    OPTIX_UTIL_CHECK( masks[5] == 0 && masks[7] == 0 && masks[9] == 1u << bits[DECAL] );
+    OPTIX_UTIL_CHECK( masks[60000] == 1u << bits[REFLECTION] );
+    OPTIX_UTIL_CHECK( offsets[60000] == 6 );
+
+    // Records: one header per distinct program group, data copied at registration, null data zero-filled.
+    OptixFunctionTable api = optix_util_test::stubFunctionTable();
+    std::vector<char>  records( registry.numRecords() * registry.recordStrideInBytes(), 7 );
+    OPTIX_UTIL_CHECK_SUCCESS( optixUtilWriteHitgroupRecords( registry, api, records.data() ) );
+    const uint64_t expectedGroups[8] = {1, 3, 2, 3, 1, 3, 2, 3};
+    const double   expectedData[8]   = {1.0, 0.0, 2.0, 0.0, 1.0, 0.0, 2.0, 0.0};
+    for( size_t r = 0; r < 8; ++r )
+    {
+        const char* record = &records[r * registry.recordStrideInBytes()];
+        double      data;
+        std::memcpy( &data, record + OPTIX_SBT_RECORD_HEADER_SIZE, sizeof( data ) );
+        OPTIX_UTIL_CHECK( optix_util_test::headerProgramGroup( record ) == expectedGroups[r] * 16 );
+        OPTIX_UTIL_CHECK( data == expectedData[r] );
+    }
+
+    // A shared header cache packs the three program groups once over repeated writes.
+    OptixUtilSbtHeaderCache cache;
+    std::vector<char>       cached( records.size() );
+    OPTIX_UTIL_CHECK_SUCCESS( optixUtilWriteHitgroupRecords( registry, api, cached.data(), 0, &cache ) );
+    OPTIX_UTIL_CHECK_SUCCESS( optixUtilWriteHitgroupRecords( registry, api, cached.data(), 0, &cache ) );
+    OPTIX_UTIL_CHECK( cache.size() == 3 && cache.numPacked() == 3 && cached == records );
+
+    const OptixUtilSbtRegistryStats stats = registry.stats();
+    OPTIX_UTIL_CHECK( stats.numMaterials == 2 && stats.numBindings == 2 && stats.numRecords == 8 );
+    OPTIX_UTIL_CHECK( stats.numDistinctRecords == 3 && stats.numDeduplicated == 2 );
+
+    return optix_util_test::finish();
+}
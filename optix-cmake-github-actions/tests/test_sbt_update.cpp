@@ -0,0 +1,82 @@
+#include "optix_util_test.h"
+
+#include <optix_util_sbt_update.h>
+
+#include <vector>
+
+using optix_util_test::headerProgramGroup;
+using optix_util_test::programGroup;
+
+struct Material
+{
+    float color[4];
+};
+
+static OptixResult failingPackHeader( OptixProgramGroup, void* )
+{
+    return OPTIX_ERROR_INVALID_VALUE;
+}
+
+int main()
+{
+    // 100 records over 3 program groups. The first upload allocates the device array and packs each group once.
+    const OptixFunctionTable        api = optix_util_test::stubFunctionTable();
+    OptixUtilSbtTable<Material>     table;
+    std::vector<OptixUtilCopyRange> ranges;
+    OptixUtilSbtUploadReport        report;
+    for( unsigned int i = 0; i < 100; ++i )
+        OPTIX_UTIL_CHECK( table.add( programGroup( 1 + i % 3 ), {{(float)i, 0.f, 0.f, 1.f}} ) == i );
+    OPTIX_UTIL_CHECK( OptixUtilSbtTable<Material>::strideInBytes == 48 );
+    OPTIX_UTIL_CHECK_SUCCESS( optixUtilPrepareSbtUpload( table, api, 0, ranges, &report ) );
+    OPTIX_UTIL_CHECK( report.reallocate && report.capacityInBytes == 100 * 48 && report.numDirty == 100 );
+    OPTIX_UTIL_CHECK( report.numHeadersPacked == 3 && report.bytesToUpload == 100 * 48 );
+    OPTIX_UTIL_CHECK( ranges.size() == 1 && ranges[0].offsetInBytes == 0 && ranges[0].sizeInBytes == 100 * 48 );
+    bool headers = true;
+    for( unsigned int i = 0; i < 100; ++i )
+        headers = headers && headerProgramGroup( table.records()[i].header ) == (uintptr_t)programGroup( 1 + i % 3 );
+    OPTIX_UTIL_CHECK( headers );
+
+    // Known answer: unchanged data is not uploaded, changed records within the merge gap share a copy.
+    OPTIX_UTIL_CHECK_SUCCESS( optixUtilPrepareSbtUpload( table, api, 0, ranges, &report ) );
+    OPTIX_UTIL_CHECK( !report.reallocate && report.numDirty == 0 && ranges.empty() );
+    table.setData( 10, {{1.f, 1.f, 1.f, 1.f}} );
+    table.setData( 12, {{2.f, 1.f, 1.f, 1.f}} );
+    table.setData( 40, {{3.f, 1.f, 1.f, 1.f}} );
+    table.setData( 41, table.data( 41 ) );
+    table.setProgramGroup( 5, programGroup( 4 ) );
+    OPTIX_UTIL_CHECK( table.isDirty( 10 ) && !table.isDirty( 41 ) );
+    OPTIX_UTIL_CHECK_SUCCESS( optixUtilPrepareSbtUpload( table, api, 1, ranges, &report ) );
+    OPTIX_UTIL_CHECK( report.numDirty == 4 && report.numHeadersPacked == 1 && ranges.size() == 3 );
+    OPTIX_UTIL_CHECK( ranges[0].offsetInBytes == 5 * 48 && ranges[0].sizeInBytes == 48 );
+    OPTIX_UTIL_CHECK( ranges[1].offsetInBytes == 10 * 48 && ranges[1].sizeInBytes == 3 * 48 );
+    OPTIX_UTIL_CHECK( ranges[2].offsetInBytes == 40 * 48 && report.bytesToUpload == 5 * 48 );
+    OPTIX_UTIL_CHECK( headerProgramGroup( table.records()[5].header ) == (uintptr_t)programGroup( 4 ) );
+
+    // Removed indices are reused once. Repeated and out of range removes are ignored, so two additions after a double
+    // remove get distinct records.
+    OPTIX_UTIL_CHECK( table.remove( 7 ) && table.isRemoved( 7 ) );
+    OPTIX_UTIL_CHECK( !table.remove( 7 ) && !table.remove( 100 ) && !table.remove( ~0u ) );
+    const unsigned int reused = table.add( programGroup( 2 ) );
+    const unsigned int added  = table.add( programGroup( 2 ) );
+    OPTIX_UTIL_CHECK( reused == 7 && !table.isRemoved( 7 ) && added == 100 && table.size() == 101 );
+    OPTIX_UTIL_CHECK( table.remove( 7 ) && table.add( programGroup( 3 ) ) == 7 );
+
+    // Growth doubles the device capacity, and all records are uploaded at their offsets.
+    OPTIX_UTIL_CHECK_SUCCESS( optixUtilPrepareSbtUpload( table, api, 0, ranges, &report ) );
+    OPTIX_UTIL_CHECK( report.reallocate && report.capacityInBytes == 200 * 48 && table.deviceCapacity() == 200 );
+    OPTIX_UTIL_CHECK( ranges.size() == 1 && ranges[0].sizeInBytes == 101 * 48 );
+    OPTIX_UTIL_CHECK( headerProgramGroup( table.records()[7].header ) == (uintptr_t)programGroup( 3 ) );
+    table.invalidateDevice();
+    OPTIX_UTIL_CHECK_SUCCESS( optixUtilPrepareSbtUpload( table, api, 0, ranges, &report ) );
+    OPTIX_UTIL_CHECK( report.reallocate && report.capacityInBytes == 101 * 48 );
+    OPTIX_UTIL_CHECK( table.stats().numFrames == 5 && table.stats().numReallocations == 3 );
+    OPTIX_UTIL_CHECK( table.stats().bytesFullUpload == ( 3 * 100 + 2 * 101 ) * 48 );
+
+    // A failed header pack is returned.
+    OptixFunctionTable failing       = api;
+    failing.optixSbtRecordPackHeader = failingPackHeader;
+    table.setProgramGroup( 3, programGroup( 5 ) );
+    OPTIX_UTIL_CHECK( optixUtilPrepareSbtUpload( table, failing, 0, ranges ) == OPTIX_ERROR_INVALID_VALUE );
+
+    return optix_util_test::finish();
+}
@@ -0,0 +1,85 @@
+#include "optix_util_test.h"
+
+#include <optix_util_srt_batch.h>
+
+#include <cmath>
+#include <random>
+#include <vector>
+
+static float relativeError( float a, float b )
+{
+    return std::fabs( a - b ) / ( 1.f + std::fabs( b ) );
+}
+
+int main()
+{
+    // Known answer: scale ( 2, 3, 4 ), 90 degrees about z, translation ( 1, 2, 3 ).
+    const float  h       = std::sqrt( 0.5f );
+    OptixSRTData srt     = {2.f, 0.f, 0.f, 0.f, 3.f, 0.f, 0.f, 4.f, 0.f, 0.f, 0.f, h, h, 1.f, 2.f, 3.f};
+    const float  ref[12] = {0.f, -3.f, 0.f, 1.f, 2.f, 0.f, 0.f, 2.f, 0.f, 0.f, 4.f, 3.f};
+    for( int isa = OPTIX_UTIL_SIMD_ISA_SCALAR; isa <= OPTIX_UTIL_SIMD_ISA_AVX512; ++isa )
+    {
+        std::vector<OptixSRTData> keys( 37, srt );
+        std::vector<float>        m( 37 * 12 );
+        OPTIX_UTIL_CHECK_SUCCESS( optixUtilConvertSrtToMatrixBatch( keys.data(), keys.size(), m.data(), 0,
+                                                                     (OptixUtilSimdIsa)isa ) );
+        for( size_t i = 0; i < keys.size(); ++i )
+            for( int k = 0; k < 12; ++k )
+                OPTIX_UTIL_CHECK( relativeError( m[i * 12 + k], ref[k] ) < 1e-6f );
+    }
+
+    // Scalar and SIMD agree for random keys, both layouts, with a count that leaves a tail, and leave the padding of
+    // strided output untouched.
+    const size_t              n = 1003;
+    std::mt19937              rng( 1 );
+    std::uniform_real_distribution<float> uniform( -2.f, 2.f );
+    std::vector<OptixSRTData> keys( n );
+    std::vector<float>        fields[16];
+    for( int k = 0; k < 16; ++k )
+        fields[k].resize( n );
+    for( size_t i = 0; i < n; ++i )
+    {
+        float* f = &keys[i].sx;
+        for( int k = 0; k < 16; ++k )
+            fields[k][i] = f[k] = uniform( rng );
+    }
+    OptixUtilSRTDataSoA soa;
+    const float**       soaFields = reinterpret_cast<const float**>( &soa );
+    for( int k = 0; k < 16; ++k )
+        soaFields[k] = fields[k].data();
+
+    std::vector<float> scalar( n * 12 );
+    for( size_t i = 0; i < n; ++i )
+        optixUtilGetMatrixFromSrt( &scalar[i * 12], keys[i] );
+
+    for( int isa = OPTIX_UTIL_SIMD_ISA_SCALAR; isa <= OPTIX_UTIL_SIMD_ISA_AVX512; ++isa )
+    {
+        for( int layout = 0; layout < 2; ++layout )
+        {
+            std::vector<float> out( n * 20, -7.f );
+            const OptixResult  result =
+                layout ? optixUtilConvertSrtToMatrixBatch( soa, n, out.data(), 80, (OptixUtilSimdIsa)isa ) :
+                         optixUtilConvertSrtToMatrixBatch( keys.data(), n, out.data(), 80, (OptixUtilSimdIsa)isa );
+            OPTIX_UTIL_CHECK_SUCCESS( result );
+            float maxError = 0.f;
+            bool  padding  = true;
+            for( size_t i = 0; i < n; ++i )
+            {
+                for( int k = 0; k < 12; ++k )
+                    maxError = std::max( maxError, relativeError( out[i * 20 + k], scalar[i * 12 + k] ) );
+                for( int k = 12; k < 20; ++k )
+                    padding = padding && out[i * 20 + k] == -7.f;
+            }
+            OPTIX_UTIL_CHECK( maxError < 1e-4f );
+            OPTIX_UTIL_CHECK( padding );
+        }
+    }
+
+    // Edge cases: strides below 48 bytes or not a multiple of 4 are rejected, empty batches succeed.
+    float m[12];
+    OPTIX_UTIL_CHECK( optixUtilConvertSrtToMatrixBatch( &srt, 1, m, 44 ) == OPTIX_ERROR_INVALID_VALUE );
+    OPTIX_UTIL_CHECK( optixUtilConvertSrtToMatrixBatch( &srt, 1, m, 50 ) == OPTIX_ERROR_INVALID_VALUE );
+    OPTIX_UTIL_CHECK_SUCCESS( optixUtilConvertSrtToMatrixBatch( static_cast<const OptixSRTData*>( nullptr ), 0, m ) );
+
+    return optix_util_test::finish();
+}
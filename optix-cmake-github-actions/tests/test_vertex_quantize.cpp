@@ -0,0 +1,94 @@
+#include "optix_util_test.h"
+
+#include <optix_util_vertex_quantize.h>
+
+#include <cmath>
+#include <vector>
+
+int main()
+{
+    using optix_util_impl::floatToHalf;
+    using optix_util_impl::halfToFloat;
+
+    // Known answers of the half conversion, with ties rounding to even, and a round trip of all finite halfs.
+    OPTIX_UTIL_CHECK( floatToHalf( 1.0f ) == 0x3c00 && floatToHalf( -2.0f ) == 0xc000 );
+    OPTIX_UTIL_CHECK( floatToHalf( 65504.0f ) == 0x7bff && floatToHalf( 65520.0f ) == 0x7c00 );
+    OPTIX_UTIL_CHECK( floatToHalf( std::ldexp( 1.0f, -24 ) ) == 0x0001 && floatToHalf( 1e-9f ) == 0 );
+    OPTIX_UTIL_CHECK( floatToHalf( 1.0f + std::ldexp( 1.0f, -11 ) ) == 0x3c00 );
+    OPTIX_UTIL_CHECK( floatToHalf( 1.0f + 3 * std::ldexp( 1.0f, -11 ) ) == 0x3c02 );
+    bool roundTrip = true;
+    for( unsigned int h = 0; h < 0x10000; ++h )
+        if( ( h & 0x7c00 ) != 0x7c00 )
+            roundTrip = roundTrip && floatToHalf( halfToFloat( (unsigned short)h ) ) == h;
+    OPTIX_UTIL_CHECK( roundTrip );
+
+    // Known answer: the corners of a box map to -32767 and 32767, and the preTransform maps them back.
+    const float                vertices[6] = {0.f, 0.f, 0.f, 2.f, 4.f, 6.f};
+    OptixUtilQuantizeInput     input       = {vertices, 2, 0, nullptr};
+    OptixUtilQuantizedVertices box;
+    OPTIX_UTIL_CHECK_SUCCESS( optixUtilQuantizeVertices( &input, 1, OPTIX_VERTEX_FORMAT_SNORM16_3, &box ) );
+    OPTIX_UTIL_CHECK( (short)box.data[0] == -32767 && (short)box.data[5] == 32767 && box.maxError == 0.f );
+    OPTIX_UTIL_CHECK( box.preTransform[0] == 1.f && box.preTransform[5] == 2.f && box.preTransform[10] == 3.f );
+    OPTIX_UTIL_CHECK( box.preTransform[3] == 1.f && box.preTransform[7] == 2.f && box.preTransform[11] == 3.f );
+    OPTIX_UTIL_CHECK( box.vertexStrideInBytes == 6 && box.numVertices == 2 );
+
+    // 1003 vertices, not a multiple of the SIMD width, packed and with a 16 byte stride. Every instruction set gives
+    // the scalar result bit for bit, and the errors stay within the documented bounds.
+    const unsigned int n = 1003;
+    std::vector<float> strided( n * 4 );
+    for( unsigned int i = 0; i < n; ++i )
+    {
+        strided[i * 4]     = 100.0f * std::sin( 0.37f * i );
+        strided[i * 4 + 1] = 0.01f * i - 3.0f;
+        strided[i * 4 + 2] = 1000.0f + 5.0f * std::cos( 1.3f * i );
+    }
+    std::vector<float> packed( n * 3 );
+    for( unsigned int i = 0; i < n; ++i )
+        std::memcpy( &packed[i * 3], &strided[i * 4], 3 * sizeof( float ) );
+    const OptixUtilQuantizeInput inputs[2] = {{packed.data(), n, 0, nullptr}, {strided.data(), n, 16, nullptr}};
+    for( OptixVertexFormat format : {OPTIX_VERTEX_FORMAT_SNORM16_3, OPTIX_VERTEX_FORMAT_HALF3} )
+    {
+        OptixUtilQuantizedVertices reference[2], outputs[2];
+        OPTIX_UTIL_CHECK_SUCCESS(
+            optixUtilQuantizeVertices( inputs, 2, format, reference, 1, OPTIX_UTIL_SIMD_ISA_SCALAR ) );
+        OPTIX_UTIL_CHECK( reference[0].data == reference[1].data );
+        const float bound = format == OPTIX_VERTEX_FORMAT_SNORM16_3 ? 1.6e-5f : 2.5e-4f;
+        for( int k = 0; k < 3; ++k )
+            OPTIX_UTIL_CHECK( reference[0].maxAxisError[k] <= bound * reference[0].preTransform[k * 5] );
+        for( int isa = OPTIX_UTIL_SIMD_ISA_AVX2; isa <= OPTIX_UTIL_SIMD_ISA_AVX512; ++isa )
+        {
+            OPTIX_UTIL_CHECK_SUCCESS(
+                optixUtilQuantizeVertices( inputs, 2, format, outputs, 2, (OptixUtilSimdIsa)isa ) );
+            for( int m = 0; m < 2; ++m )
+            {
+                OPTIX_UTIL_CHECK( outputs[m].data == reference[m].data );
+                OPTIX_UTIL_CHECK( std::memcmp( outputs[m].maxAxisError, reference[m].maxAxisError, 12 ) == 0 );
+            }
+        }
+    }
+
+    // Edge cases: empty and flat meshes quantize, non-finite positions, bad strides and formats are rejected, and the
+    // preTransform must be aligned.
+    OptixUtilQuantizeInput edge = {nullptr, 0, 0, nullptr};
+    OPTIX_UTIL_CHECK_SUCCESS( optixUtilQuantizeVertices( &edge, 1, OPTIX_VERTEX_FORMAT_HALF3, &box ) );
+    const float flat[6] = {1.f, 2.f, 3.f, 1.f, 2.f, 3.f};
+    edge                = {flat, 2, 0, nullptr};
+    OPTIX_UTIL_CHECK_SUCCESS( optixUtilQuantizeVertices( &edge, 1, OPTIX_VERTEX_FORMAT_SNORM16_3, &box ) );
+    OPTIX_UTIL_CHECK( box.data[0] == 0 && box.maxError == 0.f && box.preTransform[3] == 1.f );
+    const float infinite[3] = {1.f, INFINITY, 0.f};
+    edge                    = {infinite, 1, 0, nullptr};
+    OPTIX_UTIL_CHECK( optixUtilQuantizeVertices( &edge, 1, OPTIX_VERTEX_FORMAT_HALF3, &box )
+                      == OPTIX_ERROR_INVALID_VALUE );
+    edge = {vertices, 1, 10, nullptr};
+    OPTIX_UTIL_CHECK( optixUtilQuantizeVertices( &edge, 1, OPTIX_VERTEX_FORMAT_HALF3, &box )
+                      == OPTIX_ERROR_INVALID_VALUE );
+    OPTIX_UTIL_CHECK( optixUtilQuantizeVertices( &input, 1, OPTIX_VERTEX_FORMAT_FLOAT3, &box )
+                      == OPTIX_ERROR_INVALID_VALUE );
+    OptixBuildInputTriangleArray triangles = {};
+    OPTIX_UTIL_CHECK( optixUtilSetQuantizedVertices( triangles, box, 0x1008 ) == OPTIX_ERROR_INVALID_VALUE );
+    OPTIX_UTIL_CHECK_SUCCESS( optixUtilSetQuantizedVertices( triangles, box, 0x1000 ) );
+    OPTIX_UTIL_CHECK( triangles.vertexFormat == OPTIX_VERTEX_FORMAT_SNORM16_3 && triangles.preTransform == 0x1000 );
+    OPTIX_UTIL_CHECK( triangles.transformFormat == OPTIX_TRANSFORM_FORMAT_MATRIX_FLOAT12 );
+
+    return optix_util_test::finish();
+}